@@ -0,0 +1,388 @@
+/**
+ * arena.c - Per-request bump allocator for batch and daemon modes
+ *
+ * A daemon request or a batch window allocates a handful of short-lived
+ * buffers (passwd lookups, username copies, helper environments) and
+ * frees them again before the next one. arena_begin() hands out a copy of
+ * the caller's operations whose calloc() bumps a pointer through the
+ * arena's chunks and whose free() leaves arena memory alone, and
+ * arena_end() rewinds everything at once, so a long run reuses the same
+ * chunks instead of churning the heap.
+ *
+ * The scoped hooks find the arena through a thread-local pointer: threads
+ * that did not call arena_begin() (the batch resolvers, passwd helpers)
+ * get memory from the base operations the arena was built from, and
+ * free() hands anything no arena owns back to them. Every arena with
+ * chunks is on a process-wide list, so arena memory freed on another
+ * thread or after arena_end() is still recognised. Memory that must
+ * outlive the request is allocated between arena_suspend() and
+ * arena_resume().
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+/* Usable size of a chunk when arena_init() is given 0 */
+#define ARENA_CHUNK_DEFAULT (64 * 1024)
+
+/* Every allocation is aligned for any object, as with calloc(3) */
+#define ARENA_ALIGN alignof(max_align_t)
+
+/**
+ * struct arena_chunk - One block the arena bumps through
+ * @next: Newer chunk
+ * @size: Usable bytes after the header
+ * @used: Bytes handed out
+ */
+struct arena_chunk {
+  struct arena_chunk *next;
+  size_t size;
+  size_t used;
+};
+
+/* Chunk header, rounded up so the data after it stays aligned */
+#define ARENA_HEADER                                                           \
+  ((sizeof(struct arena_chunk) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+/* Arena arena_begin() made active on this thread, NULL for none */
+static _Thread_local arena_t *active_arena = NULL;
+
+/* calloc() and free() of a base, as copied from struct syscall_ops */
+typedef void *(*arena_calloc_fn)(size_t nmemb, size_t size);
+typedef void (*arena_free_fn)(void *ptr);
+
+/*
+ * Base operations of the latest arena_begin(), for memory no arena hands
+ * out: every arena in a process is built from the same operations
+ */
+static _Atomic(arena_calloc_fn) hook_base_calloc = NULL;
+static _Atomic(arena_free_fn) hook_base_free = NULL;
+
+/* Arenas that may own chunks, linked through @registered_next */
+static arena_t *registry = NULL;
+static mtx_t registry_lock;
+static once_flag registry_once = ONCE_FLAG_INIT;
+
+/*
+ * Forward declarations for internal functions
+ *
+ * We can use nonnull on static functions because they can only be called
+ * from inside here and we're careful to check the pointers in our visible
+ * function(s).
+ */
+static void *arena_alloc(arena_t *arena, size_t nmemb, size_t size)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static bool arena_owns(const arena_t *arena, const void *ptr)
+    __attribute__((nonnull(1)));
+static bool arena_registry_owns(const void *ptr, const arena_t *skip)
+    __attribute__((nonnull(1)));
+static void arena_register(arena_t *arena) __attribute__((nonnull));
+static void arena_unregister(arena_t *arena) __attribute__((nonnull));
+static void registry_init(void);
+static void *arena_hook_calloc(size_t nmemb, size_t size)
+    __attribute__((warn_unused_result));
+static void arena_hook_free(void *ptr);
+
+/**
+ * arena_alloc - Hand out zeroed memory from the arena
+ * @arena: Arena to allocate from
+ * @nmemb: Number of elements
+ * @size: Size of each element
+ *
+ * A request that does not fit moves on to the next chunk kept from an
+ * earlier request, or to a new one at the end of the list; requests
+ * larger than a chunk get a chunk of their own.
+ *
+ * Return: Zeroed memory on success, NULL on error (errno ENOMEM)
+ */
+static void *arena_alloc(arena_t *arena, size_t nmemb, size_t size) {
+  if (size != 0 && nmemb > SIZE_MAX / size) {
+    errno = ENOMEM;
+    return NULL;
+  }
+  size_t bytes = nmemb * size;
+  if (bytes > SIZE_MAX - ARENA_HEADER - ARENA_ALIGN) {
+    errno = ENOMEM;
+    return NULL;
+  }
+  /* Round up, and give zero-sized requests a unique pointer too */
+  bytes = bytes == 0 ? ARENA_ALIGN : (bytes + ARENA_ALIGN - 1) &
+                                         ~(ARENA_ALIGN - 1);
+
+  struct arena_chunk *chunk = arena->current;
+  while (chunk != NULL && chunk->size - chunk->used < bytes) {
+    chunk = chunk->next;
+  }
+  if (chunk == NULL) {
+    size_t usable = bytes > arena->chunk_size ? bytes : arena->chunk_size;
+    chunk = arena->base_calloc(1, ARENA_HEADER + usable);
+    if (chunk == NULL) {
+      errno = ENOMEM;
+      return NULL;
+    }
+    chunk->size = usable;
+
+    /* Other threads may be walking the chunks in arena_registry_owns() */
+    (void)mtx_lock(&registry_lock);
+    struct arena_chunk **link = &arena->chunks;
+    while (*link != NULL) {
+      link = &(*link)->next;
+    }
+    *link = chunk;
+    (void)mtx_unlock(&registry_lock);
+  }
+  arena->current = chunk;
+
+  unsigned char *ptr = (unsigned char *)chunk + ARENA_HEADER + chunk->used;
+  chunk->used += bytes;
+  (void)memset(ptr, 0, bytes);
+  return ptr;
+}
+
+/**
+ * arena_owns - Check whether @ptr was handed out by @arena
+ * @arena: Arena to look in
+ * @ptr: Pointer to check, may be NULL
+ *
+ * Return: true if @ptr lies inside one of the arena's chunks
+ */
+static bool arena_owns(const arena_t *arena, const void *ptr) {
+  uintptr_t addr = (uintptr_t)ptr;
+  for (const struct arena_chunk *chunk = arena->chunks; chunk != NULL;
+       chunk = chunk->next) {
+    uintptr_t data = (uintptr_t)chunk + ARENA_HEADER;
+    if (addr >= data && addr < data + chunk->size) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * registry_init - Set up the lock guarding the arena registry
+ *
+ * Run through call_once().
+ */
+static void registry_init(void) {
+  // LCOV_EXCL_START
+  if (mtx_init(&registry_lock, mtx_plain) != thrd_success) {
+    abort();
+  }
+  // LCOV_EXCL_STOP
+}
+
+/**
+ * arena_registry_owns - Check whether any arena handed out @ptr
+ * @ptr: Pointer to check
+ * @skip: Arena already checked by the caller, may be NULL
+ *
+ * Return: true if @ptr lies inside a chunk of a registered arena
+ */
+static bool arena_registry_owns(const void *ptr, const arena_t *skip) {
+  bool owned = false;
+
+  (void)mtx_lock(&registry_lock);
+  for (const arena_t *arena = registry; arena != NULL && !owned;
+       arena = arena->registered_next) {
+    owned = arena != skip && arena_owns(arena, ptr);
+  }
+  (void)mtx_unlock(&registry_lock);
+  return owned;
+}
+
+/**
+ * arena_register - Put @arena on the registry if it is not there yet
+ * @arena: Arena about to hand out memory
+ */
+static void arena_register(arena_t *arena) {
+  call_once(&registry_once, registry_init);
+  (void)mtx_lock(&registry_lock);
+  if (!arena->registered) {
+    arena->registered_next = registry;
+    registry = arena;
+    arena->registered = true;
+  }
+  (void)mtx_unlock(&registry_lock);
+}
+
+/**
+ * arena_unregister - Take @arena off the registry
+ * @arena: Arena whose chunks are about to be released
+ */
+static void arena_unregister(arena_t *arena) {
+  (void)mtx_lock(&registry_lock);
+  for (arena_t **link = &registry; *link != NULL;
+       link = &(*link)->registered_next) {
+    if (*link == arena) {
+      *link = arena->registered_next;
+      break;
+    }
+  }
+  arena->registered_next = NULL;
+  arena->registered = false;
+  (void)mtx_unlock(&registry_lock);
+}
+
+/**
+ * arena_hook_calloc - calloc() of the operations from arena_begin()
+ * @nmemb: Number of elements
+ * @size: Size of each element
+ *
+ * Return: Arena memory, or memory from the base operations on a thread
+ *         with no active arena
+ */
+static void *arena_hook_calloc(size_t nmemb, size_t size) {
+  if (active_arena == NULL) {
+    return atomic_load(&hook_base_calloc)(nmemb, size);
+  }
+  return arena_alloc(active_arena, nmemb, size);
+}
+
+/**
+ * arena_hook_free - free() of the operations from arena_begin()
+ * @ptr: Memory to release, may be NULL
+ *
+ * Arena memory is released by arena_end(), whichever thread frees it;
+ * anything else goes to the base operations.
+ */
+static void arena_hook_free(void *ptr) {
+  if (ptr == NULL ||
+      (active_arena != NULL && arena_owns(active_arena, ptr)) ||
+      arena_registry_owns(ptr, active_arena)) {
+    return;
+  }
+  atomic_load(&hook_base_free)(ptr);
+}
+
+/**
+ * arena_init - Set up an empty arena
+ * @arena: Arena to set up
+ * @ops: Operations whose calloc() and free() provide the chunks
+ * @chunk_size: Usable size of a chunk, 0 for the default
+ *
+ * Nothing is allocated until the first request needs it, and a failing
+ * @ops->calloc makes every arena allocation fail with ENOMEM.
+ */
+void arena_init(arena_t *arena, const struct syscall_ops *ops,
+                size_t chunk_size) {
+  if (arena == NULL || ops == NULL) {
+    return;
+  }
+
+  *arena = (arena_t){
+      .chunk_size = chunk_size != 0 ? chunk_size : ARENA_CHUNK_DEFAULT,
+      .base_calloc = ops->calloc,
+      .base_free = ops->free,
+  };
+}
+
+/**
+ * arena_begin - Start a request whose memory comes from @arena
+ * @arena: Arena from arena_init()
+ * @ops: Operations to scope
+ * @scoped: Set to a copy of @ops allocating from @arena
+ *
+ * Pass @scoped to everything the request calls and end it with
+ * arena_end() on the same thread. Without an arena @scoped is a plain
+ * copy of @ops.
+ */
+void arena_begin(arena_t *arena, const struct syscall_ops *ops,
+                 struct syscall_ops *scoped) {
+  if (ops == NULL || scoped == NULL) {
+    return;
+  }
+
+  *scoped = *ops;
+  if (arena == NULL || arena->base_calloc == NULL) {
+    return;
+  }
+
+  arena_register(arena);
+  atomic_store(&hook_base_calloc, arena->base_calloc);
+  atomic_store(&hook_base_free, arena->base_free);
+  scoped->calloc = arena_hook_calloc;
+  scoped->free = arena_hook_free;
+  arena->outer = active_arena;
+  active_arena = arena;
+}
+
+/**
+ * arena_end - Release everything the request allocated from @arena
+ * @arena: Arena passed to arena_begin()
+ *
+ * The chunks are rewound, not freed, so after the first few requests the
+ * arena holds what the largest one needed and allocates nothing more.
+ */
+void arena_end(arena_t *arena) {
+  if (arena == NULL || arena->base_calloc == NULL) {
+    return;
+  }
+  if (active_arena == arena) {
+    active_arena = arena->outer;
+  }
+  arena->outer = NULL;
+
+  for (struct arena_chunk *chunk = arena->chunks; chunk != NULL;
+       chunk = chunk->next) {
+    chunk->used = 0;
+  }
+  arena->current = arena->chunks;
+}
+
+/**
+ * arena_destroy - Release every chunk of @arena
+ * @arena: Arena from arena_init(), not between arena_begin() and
+ *         arena_end()
+ *
+ * The arena stays set up and can serve further requests.
+ */
+void arena_destroy(arena_t *arena) {
+  if (arena == NULL || arena->base_free == NULL) {
+    return;
+  }
+
+  arena_end(arena);
+  if (arena->registered) {
+    arena_unregister(arena);
+  }
+  while (arena->chunks != NULL) {
+    struct arena_chunk *next = arena->chunks->next;
+    arena->base_free(arena->chunks);
+    arena->chunks = next;
+  }
+  arena->current = NULL;
+}
+
+/**
+ * arena_suspend - Stop allocating from this thread's arena for a while
+ *
+ * For memory that must outlive the request, such as a job handed to a
+ * thread that may still hold it after the request ended, or entries a
+ * batch transaction keeps until it commits.
+ *
+ * Return: The arena to pass to arena_resume(), NULL if none was active
+ */
+arena_t *arena_suspend(void) {
+  arena_t *arena = active_arena;
+  active_arena = NULL;
+  return arena;
+}
+
+/**
+ * arena_resume - Undo arena_suspend()
+ * @arena: Value arena_suspend() returned, may be NULL
+ */
+void arena_resume(arena_t *arena) { active_arena = arena; }
@@ -0,0 +1,715 @@
+/**
+ * audit.c - Consistency audit of the subordinate ID databases
+ *
+ * Loads every entry of /etc/subuid and/or /etc/subgid into an array of
+ * half-open intervals and reports problems an administrator should look
+ * at before trusting the files:
+ *
+ *   overlap        Two owners share part of a range
+ *   mismatch       An eligible user's range is not what calc_subid_range()
+ *                  gives for that UID
+ *   uid-range      A range intrudes into [UID_MIN, UID_MAX]
+ *   unknown-owner  The owner does not resolve to an account
+ *   malformed      The line cannot be parsed
+ *
+ * Overlaps are found by sorting the intervals once and sweeping them, so
+ * the audit is O(n log n) in the number of entries rather than comparing
+ * every pair. Owner names are resolved against a sorted copy of the
+ * passwd database taken with one getpwent(3) walk, with getpwnam_r(3) as
+ * the fallback for NSS sources that do not enumerate.
+ *
+ * Each finding is one tab-separated line on the output stream:
+ *
+ *   kind <TAB> path:line <TAB> owner:start:count <TAB> detail
+ *
+ * followed by one "summary" line per database.
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <pwd.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Initial element count of every growable buffer */
+enum { AUDIT_INITIAL_CAP = 256 };
+
+/* Room for the detail column of a finding */
+enum { AUDIT_DETAIL_LEN = 128 };
+
+/**
+ * struct audit_entry_t - One database entry as an interval
+ * @start: First subordinate ID
+ * @end: One past the last subordinate ID
+ * @owner: Offset of the owner field in the owner arena
+ * @line: Line number in the database
+ * @uid: UID of the owner, valid when @resolved
+ * @resolved: The owner resolved to an account
+ */
+typedef struct {
+  uint64_t start;
+  uint64_t end;
+  size_t owner;
+  size_t line;
+  uint32_t uid;
+  bool resolved;
+} audit_entry_t;
+
+/**
+ * struct audit_db_t - Entries loaded from one database
+ * @path: Database path
+ * @entries: Entry storage
+ * @len: Entries in use
+ * @cap: Entries allocated
+ * @owners: Owner fields, NUL-terminated back to back
+ * @owners_len: Bytes of @owners in use
+ * @owners_cap: Bytes of @owners allocated
+ */
+typedef struct {
+  const char *path;
+  audit_entry_t *entries;
+  size_t len;
+  size_t cap;
+  char *owners;
+  size_t owners_len;
+  size_t owners_cap;
+} audit_db_t;
+
+/**
+ * struct audit_user_t - One account of the passwd index
+ * @name: Account name, valid once the index is sorted
+ * @offset: Offset of the name in the name arena
+ * @uid: UID of the account
+ */
+typedef struct {
+  const char *name;
+  size_t offset;
+  uint32_t uid;
+} audit_user_t;
+
+/**
+ * struct audit_passwd_t - Sorted passwd index shared by both databases
+ * @users: Accounts sorted by name
+ * @len: Accounts in use
+ * @cap: Accounts allocated
+ * @names: Account names, NUL-terminated back to back
+ * @names_len: Bytes of @names in use
+ * @names_cap: Bytes of @names allocated
+ * @loaded: The passwd database has been walked
+ * @buf: getpwnam_r(3) buffer for the fallback lookup
+ * @buf_size: Size of @buf
+ */
+typedef struct {
+  audit_user_t *users;
+  size_t len;
+  size_t cap;
+  char *names;
+  size_t names_len;
+  size_t names_cap;
+  bool loaded;
+  char *buf;
+  size_t buf_size;
+} audit_passwd_t;
+
+/*
+ * Forward declarations for internal functions
+ *
+ * We can use nonnull on static functions because they can only be called
+ * from inside here and we're careful to check the pointers in our visible
+ * function(s).
+ */
+static void *grow_buffer(const struct syscall_ops *ops, void *old,
+                         size_t used, size_t *cap, size_t need, size_t size)
+    __attribute__((nonnull(1, 4))) __attribute__((warn_unused_result));
+static int arena_append(const struct syscall_ops *ops, char **arena,
+                        size_t *len, size_t *cap, const char *str,
+                        size_t *offset) __attribute__((nonnull))
+__attribute__((warn_unused_result));
+static int compare_users(const void *a, const void *b)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static int compare_user_key(const void *key, const void *member)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static int compare_entries(const void *a, const void *b)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static int load_passwd(const struct syscall_ops *ops, audit_passwd_t *pw,
+                       bool debug) __attribute__((nonnull))
+__attribute__((warn_unused_result));
+static int resolve_owner(const struct syscall_ops *ops, audit_passwd_t *pw,
+                         const char *owner, uint32_t *uid, bool debug)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static void report(FILE *out, const char *kind, const audit_db_t *db,
+                   size_t line, const audit_entry_t *entry,
+                   const char *detail) __attribute__((nonnull(1, 2, 3, 6)));
+static int load_db(const struct syscall_ops *ops, audit_db_t *db, FILE *out,
+                   size_t *findings, bool debug) __attribute__((nonnull))
+__attribute__((warn_unused_result));
+static int check_entries(const struct syscall_ops *ops, const config_t *config,
+                         const subid_config_t *subid_cfg, audit_db_t *db,
+                         audit_passwd_t *pw, FILE *out, size_t *findings,
+                         bool debug) __attribute__((nonnull))
+__attribute__((warn_unused_result));
+static void check_overlaps(audit_db_t *db, FILE *out, size_t *findings)
+    __attribute__((nonnull));
+static int audit_db(const struct syscall_ops *ops, const config_t *config,
+                    subid_mode_t mode, audit_passwd_t *pw, FILE *out,
+                    size_t *findings, bool debug) __attribute__((nonnull))
+__attribute__((warn_unused_result));
+
+/**
+ * grow_buffer - Make room for @need elements in a growable buffer
+ * @ops: Operations structure (needed for calloc)
+ * @old: Current buffer, or NULL
+ * @used: Elements of @old in use
+ * @cap: Elements allocated, updated when the buffer grows
+ * @need: Elements required
+ * @size: Size of one element
+ *
+ * Doubles the capacity until @need fits and copies the used part across.
+ * On failure @old is left untouched for the caller to free.
+ *
+ * Return: Buffer to use from now on, NULL on allocation failure
+ */
+static void *grow_buffer(const struct syscall_ops *ops, void *old,
+                         size_t used, size_t *cap, size_t need, size_t size) {
+  if (old != NULL && need <= *cap) {
+    return old;
+  }
+
+  size_t grown_cap = *cap == 0 ? AUDIT_INITIAL_CAP : *cap;
+  while (grown_cap < need) {
+    grown_cap *= 2;
+  }
+
+  void *grown = ops->calloc(grown_cap, size);
+  if (grown == NULL) {
+    errno = ENOMEM;
+    (void)fprintf(stderr, "%s: error: memory allocation failed\n",
+                  PROJECT_NAME);
+    return NULL;
+  }
+  if (used > 0) {
+    memcpy(grown, old, used * size);
+  }
+  ops->free(old);
+  *cap = grown_cap;
+  return grown;
+}
+
+/**
+ * arena_append - Copy a string to the end of a string arena
+ * @ops: Operations structure (needed for calloc)
+ * @arena: Arena, grown as needed
+ * @len: Bytes of @arena in use
+ * @cap: Bytes of @arena allocated
+ * @str: String to copy
+ * @offset: Set to the offset of the copy
+ *
+ * Offsets stay valid when the arena moves, pointers into it do not.
+ *
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int arena_append(const struct syscall_ops *ops, char **arena,
+                        size_t *len, size_t *cap, const char *str,
+                        size_t *offset) {
+  size_t size = strlen(str) + 1;
+  char *grown = grow_buffer(ops, *arena, *len, cap, *len + size, 1);
+  if (grown == NULL) {
+    return -1;
+  }
+  *arena = grown;
+  memcpy(*arena + *len, str, size);
+  *offset = *len;
+  *len += size;
+  return 0;
+}
+
+/**
+ * compare_users - qsort(3) comparator for audit_user_t by name
+ */
+static int compare_users(const void *a, const void *b) {
+  const audit_user_t *ua = a;
+  const audit_user_t *ub = b;
+  return strcmp(ua->name, ub->name);
+}
+
+/**
+ * compare_user_key - bsearch(3) comparator of a name against audit_user_t
+ */
+static int compare_user_key(const void *key, const void *member) {
+  const audit_user_t *user = member;
+  return strcmp(key, user->name);
+}
+
+/**
+ * compare_entries - qsort(3) comparator for audit_entry_t by interval
+ *
+ * Orders by start, then by end, then by line so the output is stable.
+ */
+static int compare_entries(const void *a, const void *b) {
+  const audit_entry_t *ea = a;
+  const audit_entry_t *eb = b;
+  if (ea->start != eb->start) {
+    return ea->start < eb->start ? -1 : 1;
+  }
+  if (ea->end != eb->end) {
+    return ea->end < eb->end ? -1 : 1;
+  }
+  if (ea->line != eb->line) {
+    return ea->line < eb->line ? -1 : 1;
+  }
+  return 0;
+}
+
+/**
+ * load_passwd - Build the sorted passwd index
+ * @ops: Operations structure for system call abstraction
+ * @pw: Index to fill
+ * @debug: Enable debug output
+ *
+ * Walks the passwd database once with getpwent(3). An enumeration error
+ * is not fatal: names missing from the index still go through
+ * getpwnam_r(3) in resolve_owner().
+ *
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int load_passwd(const struct syscall_ops *ops, audit_passwd_t *pw,
+                       bool debug) {
+  int ret = 0;
+  const struct passwd *entry = NULL;
+
+  pw->loaded = true;
+
+  ops->setpwent();
+  for (;;) {
+    /* getpwent(3) only reports errors through errno */
+    errno = 0;
+    entry = ops->getpwent();
+    if (entry == NULL) {
+      break;
+    }
+    if (entry->pw_name == NULL || entry->pw_name[0] == '\0') {
+      continue;
+    }
+
+    audit_user_t *users = grow_buffer(ops, pw->users, pw->len, &pw->cap,
+                                      pw->len + 1, sizeof(*users));
+    if (users == NULL) {
+      ret = -1;
+      break;
+    }
+    pw->users = users;
+
+    size_t offset = 0;
+    if (arena_append(ops, &pw->names, &pw->names_len, &pw->names_cap,
+                     entry->pw_name, &offset) != 0) {
+      ret = -1;
+      break;
+    }
+    pw->users[pw->len++] =
+        (audit_user_t){.offset = offset, .uid = (uint32_t)entry->pw_uid};
+  }
+
+  /* ENOENT is how some NSS modules spell "no more entries" */
+  int saved_errno = errno;
+  ops->endpwent();
+  if (ret != 0) {
+    return -1;
+  }
+  if (saved_errno != 0 && saved_errno != ENOENT && debug) {
+    (void)fprintf(stderr,
+                  "%s: debug: passwd enumeration stopped early: %s\n",
+                  PROJECT_NAME, strerror(saved_errno));
+  }
+
+  /* The arena no longer moves, so the names can be pointed at */
+  for (size_t i = 0; i < pw->len; i++) {
+    pw->users[i].name = pw->names + pw->users[i].offset;
+  }
+  if (pw->len > 1) {
+    qsort(pw->users, pw->len, sizeof(*pw->users), compare_users);
+  }
+
+  if (debug) {
+    (void)fprintf(stderr, "%s: debug: indexed %zu passwd entries\n",
+                  PROJECT_NAME, pw->len);
+  }
+  return 0;
+}
+
+/**
+ * resolve_owner - Map a database owner field to a UID
+ * @ops: Operations structure for system call abstraction
+ * @pw: Passwd index, loaded on first use
+ * @owner: Owner field (username or decimal UID, see subuid(5))
+ * @uid: Set to the UID of @owner
+ * @debug: Enable debug output
+ *
+ * Return: 0 if resolved, 1 if @owner is not an account, -1 on error
+ */
+static int resolve_owner(const struct syscall_ops *ops, audit_passwd_t *pw,
+                         const char *owner, uint32_t *uid, bool debug) {
+  if (parse_uint32_strict(owner, uid) == 0) {
+    return 0;
+  }
+
+  if (!pw->loaded && load_passwd(ops, pw, debug) != 0) {
+    return -1;
+  }
+
+  const audit_user_t *user = NULL;
+  if (pw->len > 0) {
+    user = bsearch(owner, pw->users, pw->len, sizeof(*pw->users),
+                   compare_user_key);
+  }
+  if (user != NULL) {
+    *uid = user->uid;
+    return 0;
+  }
+
+  /* Not enumerated: ask NSS directly */
+  if (pw->buf == NULL) {
+    long bufsize = sysconf(_SC_GETPW_R_SIZE_MAX);
+    // LCOV_EXCL_START
+    if (bufsize <= 0) {
+      bufsize = MAX_LINE_LEN;
+    }
+    // LCOV_EXCL_STOP
+    pw->buf = ops->calloc(1, (size_t)bufsize);
+    if (pw->buf == NULL) {
+      errno = ENOMEM;
+      (void)fprintf(stderr, "%s: error: memory allocation failed\n",
+                    PROJECT_NAME);
+      return -1;
+    }
+    pw->buf_size = (size_t)bufsize;
+  }
+
+  struct passwd pwd = {0};
+  struct passwd *result = NULL;
+  int ret = ops->getpwnam_r(owner, &pwd, pw->buf, pw->buf_size, &result);
+  if (ret != 0 || result == NULL) {
+    if (debug) {
+      (void)fprintf(stderr, "%s: debug: cannot resolve owner '%s'\n",
+                    PROJECT_NAME, owner);
+    }
+    return 1;
+  }
+
+  *uid = (uint32_t)result->pw_uid;
+  return 0;
+}
+
+/**
+ * report - Write one finding
+ * @out: Output stream
+ * @kind: Finding kind (first column)
+ * @db: Database the finding is about
+ * @line: Line number in @db
+ * @entry: Entry the finding is about, NULL if the line did not parse
+ * @detail: Last column
+ */
+static void report(FILE *out, const char *kind, const audit_db_t *db,
+                   size_t line, const audit_entry_t *entry,
+                   const char *detail) {
+  if (entry == NULL) {
+    (void)fprintf(out, "%s\t%s:%zu\t-\t%s\n", kind, db->path, line, detail);
+    return;
+  }
+  (void)fprintf(out, "%s\t%s:%zu\t%s:%llu:%llu\t%s\n", kind, db->path, line,
+                db->owners + entry->owner, (unsigned long long)entry->start,
+                (unsigned long long)(entry->end - entry->start), detail);
+}
+
+/**
+ * load_db - Read every entry of a database
+ * @ops: Operations structure for system call abstraction
+ * @db: Database to fill, with @db->path set
+ * @out: Output stream for malformed line findings
+ * @findings: Finding counter to update
+ * @debug: Enable debug output
+ *
+ * A missing database simply has no entries.
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int load_db(const struct syscall_ops *ops, audit_db_t *db, FILE *out,
+                   size_t *findings, bool debug) {
+  FILE *fp = subid_db_open(ops, db->path, debug);
+  if (fp == NULL) {
+    return errno == ENOENT ? 0 : -1;
+  }
+
+  char line[MAX_LINE_LEN] = {0};
+  size_t lineno = 0;
+  bool continuation = false;
+  int ret = 0;
+  while (ops->fgets(line, sizeof(line), fp) != NULL) {
+    size_t len = strlen(line);
+    bool complete = len > 0 && line[len - 1] == '\n';
+
+    /* Tail of an overlong line: skip until its newline */
+    if (continuation) {
+      continuation = !complete;
+      continue;
+    }
+    lineno++;
+    if (!complete && len == sizeof(line) - 1) {
+      report(out, "malformed", db, lineno, NULL, "overlong line");
+      (*findings)++;
+      continuation = true;
+      continue;
+    }
+
+    const char *owner = NULL;
+    uint32_t start = 0;
+    uint32_t count = 0;
+    int parsed = subid_db_parse_line(line, &owner, &start, &count);
+    if (parsed == 1) {
+      continue;
+    }
+    if (parsed != 0) {
+      report(out, "malformed", db, lineno, NULL, "unparseable entry");
+      (*findings)++;
+      continue;
+    }
+
+    audit_entry_t *entries = grow_buffer(ops, db->entries, db->len, &db->cap,
+                                         db->len + 1, sizeof(*entries));
+    if (entries == NULL) {
+      ret = -1;
+      break;
+    }
+    db->entries = entries;
+
+    size_t offset = 0;
+    if (arena_append(ops, &db->owners, &db->owners_len, &db->owners_cap,
+                     owner, &offset) != 0) {
+      ret = -1;
+      break;
+    }
+    db->entries[db->len++] = (audit_entry_t){
+        .start = start,
+        .end = (uint64_t)start + count,
+        .owner = offset,
+        .line = lineno,
+    };
+  }
+
+  (void)ops->fclose(fp);
+
+  if (debug && ret == 0) {
+    (void)fprintf(stderr, "%s: debug: %s: loaded %zu entries\n",
+                  PROJECT_NAME, db->path, db->len);
+  }
+  return ret;
+}
+
+/**
+ * check_entries - Report per-entry findings in file order
+ * @ops: Operations structure for system call abstraction
+ * @config: Loaded configuration
+ * @subid_cfg: Range configuration of this database
+ * @db: Loaded database
+ * @pw: Passwd index
+ * @out: Output stream
+ * @findings: Finding counter to update
+ * @debug: Enable debug output
+ *
+ * Resolves every owner, which check_overlaps() relies on to tell a
+ * user's own ranges apart from someone else's.
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int check_entries(const struct syscall_ops *ops, const config_t *config,
+                         const subid_config_t *subid_cfg, audit_db_t *db,
+                         audit_passwd_t *pw, FILE *out, size_t *findings,
+                         bool debug) {
+  char detail[AUDIT_DETAIL_LEN] = {0};
+
+  for (size_t i = 0; i < db->len; i++) {
+    audit_entry_t *entry = &db->entries[i];
+    const char *owner = db->owners + entry->owner;
+
+    if (entry->start <= config->uid_max && entry->end > config->uid_min) {
+      (void)snprintf(detail, sizeof(detail), "%s %u %s %u",
+                     config->key_uid_min, config->uid_min,
+                     config->key_uid_max, config->uid_max);
+      report(out, "uid-range", db, entry->line, entry, detail);
+      (*findings)++;
+    }
+
+    int resolved = resolve_owner(ops, pw, owner, &entry->uid, debug);
+    if (resolved < 0) {
+      return -1;
+    }
+    if (resolved > 0) {
+      report(out, "unknown-owner", db, entry->line, entry, "no such user");
+      (*findings)++;
+      continue;
+    }
+    entry->resolved = true;
+
+    if (entry->uid < config->uid_min || entry->uid > config->uid_max) {
+      continue;
+    }
+
+    uint32_t start = 0;
+    if (calc_subid_range(entry->uid, config->uid_min, subid_cfg,
+                         config->allow_subid_wrap, &start) != 0) {
+      (void)snprintf(detail, sizeof(detail), "UID %u expected none",
+                     entry->uid);
+      report(out, "mismatch", db, entry->line, entry, detail);
+      (*findings)++;
+      continue;
+    }
+
+    uint64_t count = entry->end - entry->start;
+    uint32_t want = calc_subid_count(entry->uid, subid_cfg);
+    if (entry->start != start || count != want) {
+      (void)snprintf(detail, sizeof(detail), "UID %u expected %u:%u",
+                     entry->uid, start, want);
+      report(out, "mismatch", db, entry->line, entry, detail);
+      (*findings)++;
+    }
+  }
+  return 0;
+}
+
+/**
+ * check_overlaps - Report entries that overlap another owner's entry
+ * @db: Loaded database, owners already resolved by check_entries()
+ * @out: Output stream
+ * @findings: Finding counter to update
+ *
+ * After sorting by start, an entry overlaps an earlier one exactly when
+ * it starts before the furthest end seen so far, so one pass that keeps
+ * the entry reaching furthest finds every overlapping entry. Each is
+ * reported once, against that furthest-reaching entry. Ranges of the
+ * same owner (by name, or by UID when both resolved) are not reported.
+ */
+static void check_overlaps(audit_db_t *db, FILE *out, size_t *findings) {
+  char detail[AUDIT_DETAIL_LEN] = {0};
+
+  if (db->len < 2) {
+    return;
+  }
+  qsort(db->entries, db->len, sizeof(*db->entries), compare_entries);
+
+  const audit_entry_t *reach = &db->entries[0];
+  for (size_t i = 1; i < db->len; i++) {
+    const audit_entry_t *entry = &db->entries[i];
+
+    if (entry->start < reach->end) {
+      const char *owner = db->owners + entry->owner;
+      const char *other = db->owners + reach->owner;
+      bool same = strcmp(owner, other) == 0 ||
+                  (entry->resolved && reach->resolved &&
+                   entry->uid == reach->uid);
+      if (!same) {
+        (void)snprintf(detail, sizeof(detail), "line %zu %s:%llu:%llu",
+                       reach->line, other, (unsigned long long)reach->start,
+                       (unsigned long long)(reach->end - reach->start));
+        report(out, "overlap", db, entry->line, entry, detail);
+        (*findings)++;
+      }
+    }
+
+    if (entry->end > reach->end) {
+      reach = entry;
+    }
+  }
+}
+
+/**
+ * audit_db - Audit one database
+ * @ops: Operations structure for system call abstraction
+ * @config: Loaded configuration
+ * @mode: SUBUID or SUBGID
+ * @pw: Passwd index shared between databases
+ * @out: Output stream
+ * @findings: Finding counter to update
+ * @debug: Enable debug output
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int audit_db(const struct syscall_ops *ops, const config_t *config,
+                    subid_mode_t mode, audit_passwd_t *pw, FILE *out,
+                    size_t *findings, bool debug) {
+  audit_db_t db = {0};
+  const subid_config_t *subid_cfg =
+      mode == SUBUID ? &config->subuid : &config->subgid;
+  size_t before = *findings;
+
+  db.path = subid_db_path(mode);
+  if (db.path == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: invalid mode\n", PROJECT_NAME);
+    return -1;
+  }
+
+  int ret = load_db(ops, &db, out, findings, debug);
+  if (ret == 0) {
+    ret = check_entries(ops, config, subid_cfg, &db, pw, out, findings,
+                        debug);
+  }
+  if (ret == 0) {
+    check_overlaps(&db, out, findings);
+    (void)fprintf(out, "summary\t%s\t%zu entries\t%zu findings\n", db.path,
+                  db.len, *findings - before);
+  }
+
+  ops->free(db.entries);
+  ops->free(db.owners);
+  return ret;
+}
+
+/**
+ * audit_run - Audit the subordinate ID databases selected by @opts
+ * @ops: Operations structure for system call abstraction
+ * @config: Loaded configuration
+ * @opts: Runtime options (selects --subuid and/or --subgid)
+ * @out: Output stream for findings and summaries
+ * @findings: Set to the total number of findings
+ *
+ * Nothing is modified. Takes no lock either: the databases are replaced
+ * by rename(2), so each is read as one consistent version.
+ *
+ * Return: 0 if the audit completed (whatever it found), -1 on error
+ */
+int audit_run(const struct syscall_ops *ops, const config_t *config,
+              const options_t *opts, FILE *out, size_t *findings) {
+  if (ops == NULL || config == NULL || opts == NULL || out == NULL ||
+      findings == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: NULL parameter in audit_run\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  *findings = 0;
+
+  audit_passwd_t pw = {0};
+  int ret = 0;
+  if (opts->do_subuid &&
+      audit_db(ops, config, SUBUID, &pw, out, findings, opts->debug) != 0) {
+    ret = -1;
+  }
+  if (ret == 0 && opts->do_subgid &&
+      audit_db(ops, config, SUBGID, &pw, out, findings, opts->debug) != 0) {
+    ret = -1;
+  }
+
+  ops->free(pw.users);
+  ops->free(pw.names);
+  ops->free(pw.buf);
+  return ret;
+}
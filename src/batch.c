@@ -0,0 +1,788 @@
+/**
+ * batch.c - Batch mode: enroll many users in one invocation
+ *
+ * Configuration is loaded once by the caller; each entry is then resolved
+ * and passed through enroll_user() independently so a bad account only
+ * fails its own entry, not the whole batch.
+ *
+ * With --jobs N the entries are gathered into windows of
+ * N * RESOLVE_WINDOW_PER_JOB, resolved in parallel by resolve_pool_run()
+ * and then enrolled and reported in input order by this thread alone.
+ * When SKIP_IF_EXISTS asks getsubids(1), a window's checks are also run
+ * up to N at a time by check_subid_exists_many() before that.
+ *
+ * Each entry (each window with --jobs) allocates from an arena that is
+ * reset afterwards, so a long batch keeps reusing the same memory.
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <pwd.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * struct batch_window_t - Entries waiting for parallel resolution
+ * @slots: Slot per entry
+ * @names: Username buffer per slot, @username_size bytes each
+ * @copies: Copy of each slot's entry, NULL when entries are referenced
+ * @users: Resolved username per slot, NULL where resolution failed
+ * @exists: getsubids(1) answers per slot and mode (SUBID_MODES each)
+ * @arena: Memory for one entry, or one window of entries
+ * @username_size: Size of each buffer in @names
+ * @len: Slots in use
+ * @cap: Slots allocated, 0 when entries are resolved one at a time
+ */
+typedef struct {
+  resolve_slot_t *slots;
+  char *names;
+  char **copies;
+  const char **users;
+  int *exists;
+  arena_t arena;
+  size_t username_size;
+  size_t len;
+  size_t cap;
+} batch_window_t;
+
+/*
+ * Forward declarations for internal functions
+ *
+ * We can use nonnull on static functions because they can only be called
+ * from inside here and we're careful to check the pointers in our visible
+ * function(s).
+ */
+static char *alloc_username_buffer(const struct syscall_ops *ops,
+                                   size_t *size_out)
+    __attribute__((nonnull(1, 2))) __attribute__((warn_unused_result));
+static int process_entry(const struct syscall_ops *ops, const config_t *config,
+                         const options_t *opts, const char *entry,
+                         char *username, size_t username_size,
+                         subid_txn_t *txn, batch_stats_t *stats)
+    __attribute__((nonnull(1, 2, 3, 4, 5, 8)))
+    __attribute__((warn_unused_result));
+static int record_result(const char *entry, int ret, batch_stats_t *stats)
+    __attribute__((nonnull(1, 3)));
+static int enroll_passwd_entry(const struct syscall_ops *ops,
+                               const config_t *config, const options_t *opts,
+                               const struct passwd *pw, char *username,
+                               size_t username_size, subid_txn_t *txn,
+                               batch_stats_t *stats)
+    __attribute__((nonnull(1, 2, 3, 4, 5, 8)))
+    __attribute__((warn_unused_result));
+static subid_txn_t *batch_txn(const config_t *config, const options_t *opts,
+                              subid_txn_t *storage)
+    __attribute__((nonnull(1, 2, 3))) __attribute__((warn_unused_result));
+static int batch_commit(const struct syscall_ops *ops, const config_t *config,
+                        const options_t *opts, subid_txn_t *txn,
+                        batch_stats_t *stats)
+    __attribute__((nonnull(1, 2, 3, 5))) __attribute__((warn_unused_result));
+static int window_init(const struct syscall_ops *ops, const options_t *opts,
+                       size_t username_size, bool copy,
+                       batch_window_t *window)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static int window_entry(const struct syscall_ops *ops, const config_t *config,
+                        const options_t *opts, batch_window_t *window,
+                        const char *entry, char *username,
+                        size_t username_size, subid_txn_t *txn,
+                        batch_stats_t *stats)
+    __attribute__((nonnull(1, 2, 3, 4, 5, 6, 9)))
+    __attribute__((warn_unused_result));
+static int window_flush(const struct syscall_ops *ops, const config_t *config,
+                        const options_t *opts, batch_window_t *window,
+                        subid_txn_t *txn, batch_stats_t *stats)
+    __attribute__((nonnull(1, 2, 3, 4, 6)))
+    __attribute__((warn_unused_result));
+static void window_precheck(const struct syscall_ops *ops,
+                            const config_t *config, const options_t *opts,
+                            batch_window_t *window) __attribute__((nonnull));
+static void window_free(const struct syscall_ops *ops,
+                        batch_window_t *window) __attribute__((nonnull));
+
+/**
+ * alloc_username_buffer - Allocate a buffer large enough for any username
+ * @ops: Operations structure (needed for calloc)
+ * @size_out: Set to the size of the returned buffer
+ *
+ * Sized once per batch from _SC_LOGIN_NAME_MAX so entries reuse it.
+ *
+ * Return: Zeroed buffer on success (caller must free()), NULL on error
+ */
+static char *alloc_username_buffer(const struct syscall_ops *ops,
+                                   size_t *size_out) {
+  long name_max = sysconf(_SC_LOGIN_NAME_MAX);
+  // LCOV_EXCL_START
+  if (name_max <= 0) {
+    errno = ENOSYS;
+    (void)fprintf(stderr, "%s: error: invalid _SC_LOGIN_NAME_MAX: %ld\n",
+                  PROJECT_NAME, name_max);
+    return NULL;
+  }
+  // LCOV_EXCL_STOP
+
+  /* +1 for NUL terminator */
+  size_t size = (size_t)name_max + 1;
+  char *buf = ops->calloc(size, sizeof(*buf));
+  if (buf == NULL) {
+    errno = ENOMEM;
+    (void)fprintf(stderr, "%s: error: memory allocation failed\n",
+                  PROJECT_NAME);
+    return NULL;
+  }
+
+  *size_out = size;
+  return buf;
+}
+
+/**
+ * process_entry - Resolve and enroll a single batch entry
+ * @ops: Operations structure for system call abstraction
+ * @config: Loaded configuration
+ * @opts: Runtime options
+ * @entry: Username or UID string
+ * @username: Scratch buffer for the resolved username
+ * @username_size: Size of @username
+ * @txn: Transaction for deferred writes, or NULL
+ * @stats: Summary counters to update
+ *
+ * Return: 0 if the entry succeeded, -1 if it failed
+ */
+static int process_entry(const struct syscall_ops *ops, const config_t *config,
+                         const options_t *opts, const char *entry,
+                         char *username, size_t username_size,
+                         subid_txn_t *txn, batch_stats_t *stats) {
+  uint32_t uid = 0;
+  int ret = -1;
+
+  if (resolve_user(ops, entry, &uid, username, username_size,
+                   config->resolve_timeout_ms, opts->debug) == 0) {
+    ret = enroll_user_deferred(ops, username, uid, config, opts, txn);
+  }
+
+  return record_result(entry, ret, stats);
+}
+
+/**
+ * record_result - Count and report the outcome of one batch entry
+ * @entry: Entry as given by the user (or the passwd name)
+ * @ret: Result of processing @entry
+ * @stats: Summary counters to update
+ *
+ * Prints one status line per entry to stdout so callers can tell
+ * exactly which accounts failed.
+ *
+ * Return: @ret, for tail calls
+ */
+static int record_result(const char *entry, int ret, batch_stats_t *stats) {
+  stats->total++;
+
+  if (ret == 0) {
+    stats->ok++;
+    (void)printf("%s: batch: %s: ok\n", PROJECT_NAME, entry);
+  } else {
+    stats->failed++;
+    (void)printf("%s: batch: %s: failed\n", PROJECT_NAME, entry);
+  }
+
+  return ret;
+}
+
+/**
+ * enroll_passwd_entry - Enroll one account returned by getpwent(3)
+ * @ops: Operations structure for system call abstraction
+ * @config: Loaded configuration
+ * @opts: Runtime options
+ * @pw: Account, already known to be inside [UID_MIN, UID_MAX]
+ * @username: Buffer the name is copied into
+ * @username_size: Size of @username
+ * @txn: Transaction for deferred writes, or NULL
+ * @stats: Summary counters to update
+ *
+ * The name is copied out of the getpwent(3) static storage and held to the
+ * same naming rules as a name given on the command line, since NSS
+ * backends will happily return names usermod(8) would reject.
+ *
+ * Return: 0 if the entry succeeded, -1 if it failed
+ */
+static int enroll_passwd_entry(const struct syscall_ops *ops,
+                               const config_t *config, const options_t *opts,
+                               const struct passwd *pw, char *username,
+                               size_t username_size, subid_txn_t *txn,
+                               batch_stats_t *stats) {
+  const char *name = pw->pw_name != NULL ? pw->pw_name : "";
+  int ret = -1;
+
+  int written = snprintf(username, username_size, "%s", name);
+  if (written < 0 || (size_t)written >= username_size) {
+    (void)fprintf(stderr, "%s: error: username too long for UID %u\n",
+                  PROJECT_NAME, (uint32_t)pw->pw_uid);
+  } else if (validate_username(username) == 0) {
+    ret = enroll_user_deferred(ops, username, (uint32_t)pw->pw_uid, config,
+                               opts, txn);
+  }
+
+  return record_result(username, ret, stats);
+}
+
+/**
+ * batch_txn - Select the transaction a batch defers its writes to
+ * @config: Loaded configuration
+ * @opts: Runtime options
+ * @storage: Zeroed transaction owned by the caller
+ *
+ * Only the native writer can defer; usermod(8) is still run per range.
+ *
+ * Return: @storage for SUBID_WRITER files or spool outside noop mode,
+ *         else NULL
+ */
+static subid_txn_t *batch_txn(const config_t *config, const options_t *opts,
+                              subid_txn_t *storage) {
+  if (config->subid_writer == SUBID_WRITER_USERMOD || opts->noop) {
+    return NULL;
+  }
+  return storage;
+}
+
+/**
+ * batch_commit - Write the ranges a batch queued and release them
+ * @ops: Operations structure for system call abstraction
+ * @config: Loaded configuration (selects the spool for SUBID_WRITER spool)
+ * @opts: Runtime options
+ * @txn: Transaction from batch_txn(), may be NULL
+ * @stats: Summary counters to update
+ *
+ * Entries are reported "ok" once their ranges are queued. If the final
+ * write fails, every user that queued a range is moved from ok to failed
+ * so the summary and exit status reflect what actually reached disk.
+ *
+ * Return: 0 on success, -1 if the commit failed
+ */
+static int batch_commit(const struct syscall_ops *ops, const config_t *config,
+                        const options_t *opts, subid_txn_t *txn,
+                        batch_stats_t *stats) {
+  if (txn == NULL) {
+    return 0;
+  }
+
+  int ret = 0;
+  size_t users = txn->users;
+  uint64_t started = stats_now();
+  int commit = config->subid_writer == SUBID_WRITER_SPOOL
+                   ? subid_spool_commit(ops, STAMP_DIR, txn, opts->debug)
+                   : subid_txn_commit(ops, txn, opts->debug);
+  stats_phase_add(STATS_WRITE, started);
+  if (commit != 0) {
+    (void)fprintf(stderr,
+                  "%s: error: batch: ranges for %zu queued users were not "
+                  "written\n",
+                  PROJECT_NAME, users);
+    stats->ok -= users;
+    stats->failed += users;
+    ret = -1;
+  }
+
+  subid_txn_free(ops, txn);
+  return ret;
+}
+
+/**
+ * window_init - Prepare the parallel resolution window for a batch
+ * @ops: Operations structure (needed for calloc)
+ * @opts: Runtime options (@opts->jobs sizes the window)
+ * @username_size: Size of each username buffer
+ * @copy: Copy entries, for input whose storage is reused
+ * @window: Zeroed window to set up
+ *
+ * Leaves @window->cap at 0 without --jobs, and when the window cannot be
+ * allocated, so the batch falls back to resolving entries in turn.
+ *
+ * Return: 0 (allocation failures only cost the parallelism)
+ */
+static int window_init(const struct syscall_ops *ops, const options_t *opts,
+                       size_t username_size, bool copy,
+                       batch_window_t *window) {
+  *window = (batch_window_t){.username_size = username_size};
+  arena_init(&window->arena, ops, 0);
+  if (opts->jobs <= 1) {
+    return 0;
+  }
+
+  size_t cap = (size_t)opts->jobs * RESOLVE_WINDOW_PER_JOB;
+  window->slots = ops->calloc(cap, sizeof(*window->slots));
+  window->names = ops->calloc(cap, username_size);
+  window->users = ops->calloc(cap, sizeof(*window->users));
+  window->exists = ops->calloc(cap * SUBID_MODES, sizeof(*window->exists));
+  if (copy) {
+    window->copies = ops->calloc(cap, sizeof(*window->copies));
+  }
+  if (window->slots == NULL || window->names == NULL ||
+      window->users == NULL || window->exists == NULL ||
+      (copy && window->copies == NULL)) {
+    if (opts->debug) {
+      (void)fprintf(stderr,
+                    "%s: debug: batch: no memory for --jobs, resolving "
+                    "entries in turn\n",
+                    PROJECT_NAME);
+    }
+    window_free(ops, window);
+    return 0;
+  }
+
+  for (size_t i = 0; i < cap; i++) {
+    window->slots[i].username = window->names + i * username_size;
+    window->exists[i * SUBID_MODES + SUBUID] = -1;
+    window->exists[i * SUBID_MODES + SUBGID] = -1;
+  }
+  window->cap = cap;
+  return 0;
+}
+
+/**
+ * window_entry - Process or queue one batch entry
+ * @ops: Operations structure for system call abstraction
+ * @config: Loaded configuration
+ * @opts: Runtime options
+ * @window: Window from window_init()
+ * @entry: Username or UID string
+ * @username: Scratch buffer for entries resolved in turn
+ * @username_size: Size of @username
+ * @txn: Transaction for deferred writes, or NULL
+ * @stats: Summary counters to update
+ *
+ * Without a window the entry is processed at once; otherwise it is queued
+ * and the window is flushed when full.
+ *
+ * Return: 0 if nothing failed yet, -1 if an entry failed
+ */
+static int window_entry(const struct syscall_ops *ops, const config_t *config,
+                        const options_t *opts, batch_window_t *window,
+                        const char *entry, char *username,
+                        size_t username_size, subid_txn_t *txn,
+                        batch_stats_t *stats) {
+  if (window->cap == 0) {
+    struct syscall_ops scoped;
+    arena_begin(&window->arena, ops, &scoped);
+    int ret = process_entry(&scoped, config, opts, entry, username,
+                            username_size, txn, stats);
+    arena_end(&window->arena);
+    return ret;
+  }
+
+  const char *queued = entry;
+  if (window->copies != NULL) {
+    size_t len = strlen(entry) + 1;
+    char *copy = ops->calloc(len, sizeof(*copy));
+    if (copy == NULL) {
+      (void)fprintf(stderr, "%s: error: memory allocation failed\n",
+                    PROJECT_NAME);
+      return record_result(entry, -1, stats);
+    }
+    (void)memcpy(copy, entry, len);
+    window->copies[window->len] = copy;
+    queued = copy;
+  }
+
+  window->slots[window->len++].entry = queued;
+  if (window->len < window->cap) {
+    return 0;
+  }
+  return window_flush(ops, config, opts, window, txn, stats);
+}
+
+/**
+ * window_flush - Resolve the queued entries, then enroll them in order
+ * @ops: Operations structure for system call abstraction
+ * @config: Loaded configuration
+ * @opts: Runtime options
+ * @window: Window holding the queued entries
+ * @txn: Transaction for deferred writes, or NULL
+ * @stats: Summary counters to update
+ *
+ * Entries that failed to resolve in parallel are run through
+ * process_entry() again, which prints exactly the diagnostics a serial
+ * run would and gives transient NSS errors a second chance. The others
+ * are prechecked by window_precheck() and enrolled with its answers.
+ * Everything the window allocates comes from @window->arena and is
+ * released at once at the end.
+ *
+ * Return: 0 if every entry succeeded, -1 if any entry failed
+ */
+static int window_flush(const struct syscall_ops *ops, const config_t *config,
+                        const options_t *opts, batch_window_t *window,
+                        subid_txn_t *txn, batch_stats_t *stats) {
+  if (window->len == 0) {
+    return 0;
+  }
+
+  int ret = 0;
+  struct syscall_ops scoped;
+  arena_begin(&window->arena, ops, &scoped);
+
+  if (resolve_pool_run(&scoped, window->slots, window->len, opts->jobs,
+                       window->username_size,
+                       config->resolve_timeout_ms) != 0) {
+    // LCOV_EXCL_START
+    for (size_t i = 0; i < window->len; i++) {
+      window->slots[i].error = EINVAL;
+    }
+    // LCOV_EXCL_STOP
+  }
+
+  window_precheck(&scoped, config, opts, window);
+
+  for (size_t i = 0; i < window->len; i++) {
+    resolve_slot_t *slot = &window->slots[i];
+    int *exists = &window->exists[i * SUBID_MODES];
+    int entry_ret = -1;
+
+    if (slot->error != 0) {
+      entry_ret = process_entry(&scoped, config, opts, slot->entry,
+                                slot->username, window->username_size, txn,
+                                stats);
+    } else {
+      if (opts->debug) {
+        (void)fprintf(stderr, "%s: debug: resolved %s to %s (UID: %u)\n",
+                      PROJECT_NAME, slot->entry, slot->username, slot->uid);
+      }
+      entry_ret = record_result(
+          slot->entry,
+          enroll_user_prechecked(&scoped, slot->username, slot->uid, config,
+                                 opts, exists, txn),
+          stats);
+    }
+    exists[SUBUID] = -1;
+    exists[SUBGID] = -1;
+    if (entry_ret != 0) {
+      ret = -1;
+    }
+
+    if (window->copies != NULL) {
+      ops->free(window->copies[i]);
+      window->copies[i] = NULL;
+    }
+    *slot = (resolve_slot_t){.username = slot->username};
+  }
+
+  arena_end(&window->arena);
+  window->len = 0;
+  return ret;
+}
+
+/**
+ * window_precheck - Run a window's getsubids(1) checks side by side
+ * @ops: Operations structure for system call abstraction
+ * @config: Loaded configuration
+ * @opts: Runtime options (@opts->jobs helpers run at a time)
+ * @window: Window whose slots have been resolved
+ *
+ * Only when SKIP_IF_EXISTS would spawn getsubids(1) for every entry.
+ * Debug runs keep spawning them in turn so their output stays in order.
+ * Answers that could not be had stay -1 and are asked again in order.
+ */
+static void window_precheck(const struct syscall_ops *ops,
+                            const config_t *config, const options_t *opts,
+                            batch_window_t *window) {
+  if (!config->skip_if_exists || config->skip_if_exact ||
+      config->subid_backend != SUBID_BACKEND_GETSUBIDS || opts->debug) {
+    return;
+  }
+
+  int answers[RESOLVE_JOBS_MAX * RESOLVE_WINDOW_PER_JOB];
+  for (size_t i = 0; i < window->len; i++) {
+    window->users[i] =
+        window->slots[i].error == 0 ? window->slots[i].username : NULL;
+  }
+
+  static const subid_mode_t modes[] = {SUBUID, SUBGID};
+  for (size_t m = 0; m < SUBID_MODES; m++) {
+    if (!(modes[m] == SUBUID ? opts->do_subuid : opts->do_subgid)) {
+      continue;
+    }
+    check_subid_exists_many(ops, window->users, window->len, modes[m],
+                            opts->jobs, answers);
+    for (size_t i = 0; i < window->len; i++) {
+      window->exists[i * SUBID_MODES + modes[m]] = answers[i];
+    }
+  }
+}
+
+/**
+ * window_free - Release a window
+ * @ops: Operations structure (needed for free)
+ * @window: Window from window_init(), already flushed
+ */
+static void window_free(const struct syscall_ops *ops,
+                        batch_window_t *window) {
+  arena_destroy(&window->arena);
+  ops->free(window->slots);
+  ops->free(window->names);
+  ops->free(window->copies);
+  ops->free(window->users);
+  ops->free(window->exists);
+  window->slots = NULL;
+  window->names = NULL;
+  window->copies = NULL;
+  window->users = NULL;
+  window->exists = NULL;
+  window->cap = 0;
+}
+
+/**
+ * batch_read_entry - Read the next non-blank batch entry from a stream
+ * @fp: Input stream
+ * @delim: Entry separator ('\n' or '\0')
+ * @line: getdelim(3) buffer, reused across calls (caller must free())
+ * @cap: Capacity of @line, maintained by getdelim(3)
+ *
+ * Entries are normalized like configuration lines: comments stripped and
+ * surrounding whitespace trimmed. Blank entries are skipped.
+ *
+ * Return: Pointer into @line for the entry, or NULL at end of input or on
+ *         error (check ferror(@fp) to distinguish)
+ */
+char *batch_read_entry(FILE *fp, int delim, char **line, size_t *cap) {
+  if (fp == NULL || line == NULL || cap == NULL) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  while (getdelim(line, cap, delim, fp) >= 0) {
+    /* Drop the separator itself; normalize handles the newline case */
+    size_t len = strlen(*line);
+    if (len > 0 && (*line)[len - 1] == (char)delim) {
+      (*line)[len - 1] = '\0';
+    }
+
+    char *entry = normalize_config_line(*line);
+    if (*entry != '\0') {
+      return entry;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * batch_run_args - Enroll every positional argument as a batch entry
+ * @ops: Operations structure for system call abstraction
+ * @config: Loaded configuration
+ * @opts: Runtime options (@opts->user_args holds the entries)
+ * @stats: Summary counters to update
+ *
+ * Return: 0 if every entry succeeded, -1 if any entry failed
+ */
+int batch_run_args(const struct syscall_ops *ops, const config_t *config,
+                   const options_t *opts, batch_stats_t *stats) {
+  if (ops == NULL || config == NULL || opts == NULL || stats == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: NULL parameter in batch_run_args\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  size_t username_size = 0;
+  char *username = alloc_username_buffer(ops, &username_size);
+  if (username == NULL) {
+    return -1;
+  }
+
+  subid_txn_t storage = {0};
+  subid_txn_t *txn = batch_txn(config, opts, &storage);
+  batch_window_t window = {0};
+  int ret = window_init(ops, opts, username_size, false, &window);
+  for (int i = 0; i < opts->user_argc; i++) {
+    if (window_entry(ops, config, opts, &window, opts->user_args[i],
+                     username, username_size, txn, stats) != 0) {
+      ret = -1;
+    }
+  }
+  if (window_flush(ops, config, opts, &window, txn, stats) != 0) {
+    ret = -1;
+  }
+
+  if (batch_commit(ops, config, opts, txn, stats) != 0) {
+    ret = -1;
+  }
+
+  window_free(ops, &window);
+  ops->free(username);
+  return ret;
+}
+
+/**
+ * batch_run_stream - Enroll every entry read from a stream
+ * @ops: Operations structure for system call abstraction
+ * @config: Loaded configuration
+ * @opts: Runtime options (@opts->null_sep selects the separator)
+ * @fp: Input stream (file or stdin)
+ * @stats: Summary counters to update
+ *
+ * Entries are read and processed one at a time (one window at a time with
+ * --jobs), so memory use does not grow with the size of the input.
+ *
+ * Return: 0 if every entry succeeded, -1 if any entry failed or the
+ *         stream could not be read
+ */
+int batch_run_stream(const struct syscall_ops *ops, const config_t *config,
+                     const options_t *opts, FILE *fp, batch_stats_t *stats) {
+  if (ops == NULL || config == NULL || opts == NULL || fp == NULL ||
+      stats == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: NULL parameter in batch_run_stream\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  size_t username_size = 0;
+  char *username = alloc_username_buffer(ops, &username_size);
+  if (username == NULL) {
+    return -1;
+  }
+
+  int delim = opts->null_sep ? '\0' : '\n';
+  char *line = NULL;
+  size_t cap = 0;
+  subid_txn_t storage = {0};
+  subid_txn_t *txn = batch_txn(config, opts, &storage);
+  batch_window_t window = {0};
+  int ret = window_init(ops, opts, username_size, true, &window);
+
+  const char *entry = NULL;
+  while ((entry = batch_read_entry(fp, delim, &line, &cap)) != NULL) {
+    if (window_entry(ops, config, opts, &window, entry, username,
+                     username_size, txn, stats) != 0) {
+      ret = -1;
+    }
+  }
+
+  if (ferror(fp)) {
+    (void)fprintf(stderr, "%s: error: failed reading batch input: %s\n",
+                  PROJECT_NAME, strerror(errno));
+    ret = -1;
+  }
+  if (window_flush(ops, config, opts, &window, txn, stats) != 0) {
+    ret = -1;
+  }
+
+  /* Entries read before a stream error are still recorded */
+  if (batch_commit(ops, config, opts, txn, stats) != 0) {
+    ret = -1;
+  }
+
+  window_free(ops, &window);
+  ops->free(line);
+  ops->free(username);
+  return ret;
+}
+
+/**
+ * batch_print_summary - Print batch totals
+ * @stats: Summary counters
+ * @out: Output stream
+ */
+void batch_print_summary(const batch_stats_t *stats, FILE *out) {
+  if (stats == NULL || out == NULL) {
+    return;
+  }
+
+  (void)fprintf(out, "%s: batch: %zu processed, %zu ok, %zu failed\n",
+                PROJECT_NAME, stats->total, stats->ok, stats->failed);
+}
+
+/**
+ * batch_run_all_eligible - Enroll every account with UID_MIN <= UID <= UID_MAX
+ * @ops: Operations structure for system call abstraction
+ * @config: Loaded configuration
+ * @opts: Runtime options
+ * @stats: Summary counters to update
+ *
+ * Walks the passwd database with getpwent(3), so whatever NSS provides
+ * (files, sssd, LDAP) is covered. Each account is enrolled as soon as it
+ * is returned rather than collected first, so memory use stays flat no
+ * matter how many accounts the directory holds. Accounts outside the
+ * configured UID range are skipped without being counted.
+ *
+ * Return: 0 if every eligible account succeeded, -1 if any failed or the
+ *         enumeration ended with an error
+ */
+int batch_run_all_eligible(const struct syscall_ops *ops,
+                           const config_t *config, const options_t *opts,
+                           batch_stats_t *stats) {
+  if (ops == NULL || config == NULL || opts == NULL || stats == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr,
+                  "%s: error: NULL parameter in batch_run_all_eligible\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  size_t username_size = 0;
+  char *username = alloc_username_buffer(ops, &username_size);
+  if (username == NULL) {
+    return -1;
+  }
+
+  subid_txn_t storage = {0};
+  subid_txn_t *txn = batch_txn(config, opts, &storage);
+  arena_t arena;
+  arena_init(&arena, ops, 0);
+  int ret = 0;
+  const struct passwd *pw = NULL;
+
+  ops->setpwent();
+  for (;;) {
+    /* getpwent(3) only reports errors through errno */
+    errno = 0;
+    pw = ops->getpwent();
+    if (pw == NULL) {
+      break;
+    }
+
+    uint32_t uid = (uint32_t)pw->pw_uid;
+    if (uid < config->uid_min || uid > config->uid_max) {
+      continue;
+    }
+
+    if (opts->debug) {
+      (void)fprintf(stderr, "%s: debug: eligible account: %s (UID: %u)\n",
+                    PROJECT_NAME, pw->pw_name != NULL ? pw->pw_name : "",
+                    uid);
+    }
+
+    struct syscall_ops scoped;
+    arena_begin(&arena, ops, &scoped);
+    if (enroll_passwd_entry(&scoped, config, opts, pw, username,
+                            username_size, txn, stats) != 0) {
+      ret = -1;
+    }
+    arena_end(&arena);
+  }
+
+  /* ENOENT is how some NSS modules spell "no more entries" */
+  int saved_errno = errno;
+  ops->endpwent();
+  if (saved_errno != 0 && saved_errno != ENOENT) {
+    errno = saved_errno;
+    (void)fprintf(stderr, "%s: error: failed enumerating passwd database: %s\n",
+                  PROJECT_NAME, strerror(saved_errno));
+    ret = -1;
+  }
+
+  /* getpwent(3) is closed first so no NSS handle is held under the locks */
+  if (batch_commit(ops, config, opts, txn, stats) != 0) {
+    ret = -1;
+  }
+
+  arena_destroy(&arena);
+  ops->free(username);
+  return ret;
+}
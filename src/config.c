@@ -1,5 +1,10 @@
 /**
  * config.c - Configuration file loading and parsing
+ *
+ * Files are read in large blocks and tokenized in place; keys are found by
+ * binary search in a table built once per load from the key_* names in
+ * config_t, so a large, mostly irrelevant login.defs costs one read(2) per
+ * block and a handful of string compares per line.
  */
 
 /* clang-format off */
@@ -13,12 +18,84 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <stdalign.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/stat.h>
+#include <unistd.h>
+
+/* Bytes read per read(2); must exceed MAX_LINE_LEN so a line always fits */
+enum { CONFIG_READ_SIZE = 16384 };
+
+_Static_assert(CONFIG_READ_SIZE > MAX_LINE_LEN,
+               "CONFIG_READ_SIZE must hold at least one full line");
+
+/* Bytes of directory entries read per getdents64(2) call */
+enum { CONFIG_DENTS_SIZE = 8192 };
+
+/* Initial size of the buffer collecting drop-in names */
+enum { CONFIG_NAMES_INITIAL = 1024 };
+
+/**
+ * enum config_key_kind_t - How the value of a configuration key is parsed
+ * @CONFIG_KEY_UINT32: Strict unsigned decimal
+ * @CONFIG_KEY_COUNT: Strict unsigned decimal no larger than MAX_RANGES
+ * @CONFIG_KEY_BOOL: parse_bool()
+ * @CONFIG_KEY_BACKEND: getsubids or files
+ * @CONFIG_KEY_WRITER: usermod or files
+ * @CONFIG_KEY_BANDS: Comma-separated UID_LO-UID_HI:COUNT list, or "none"
+ */
+typedef enum {
+  CONFIG_KEY_UINT32,
+  CONFIG_KEY_COUNT,
+  CONFIG_KEY_BOOL,
+  CONFIG_KEY_BACKEND,
+  CONFIG_KEY_WRITER,
+  CONFIG_KEY_BANDS
+} config_key_kind_t;
+
+/**
+ * struct config_key_t - One recognised configuration key
+ * @name: Key name, one of the key_* literals in config_t
+ * @kind: How the value is parsed
+ * @field: Field in config_t the value is stored in, of the type @kind implies
+ */
+typedef struct {
+  const char *name;
+  config_key_kind_t kind;
+  void *field;
+} config_key_t;
+
+/* Number of keys in config_t */
+enum { CONFIG_KEY_MAX = 16 };
+
+/**
+ * struct config_key_table_t - Keys sorted by name for bsearch(3)
+ * @keys: Entries
+ * @len: Number of entries used
+ */
+typedef struct {
+  config_key_t keys[CONFIG_KEY_MAX];
+  size_t len;
+} config_key_table_t;
+
+/**
+ * struct conf_names_t - Drop-in names collected in one directory pass
+ * @buf: Names back to back, each terminated by a NUL
+ * @len: Bytes of @buf in use
+ * @size: Size of @buf
+ * @count: Number of names in @buf
+ */
+typedef struct {
+  char *buf;
+  size_t len;
+  size_t size;
+  size_t count;
+} conf_names_t;
 
 /**
  * Forward declarations for internal functions
@@ -28,84 +105,80 @@
  * function(s).
  *
  */
-static FILE *safe_open_config(const struct syscall_ops *ops,
-                              const char *filepath, bool debug)
+static int check_config_fd(const struct syscall_ops *ops, int fd,
+                           const char *filepath)
+    __attribute__((nonnull(1, 3))) __attribute__((warn_unused_result));
+static int safe_open_config(const struct syscall_ops *ops,
+                            const char *filepath, bool debug)
+    __attribute__((nonnull(1, 2))) __attribute__((warn_unused_result));
+static int add_conf_name(const struct syscall_ops *ops, conf_names_t *names,
+                         const char *name)
+    __attribute__((nonnull(1, 2, 3))) __attribute__((warn_unused_result));
+static int collect_conf_names(const struct syscall_ops *ops, int dirfd,
+                              const char *dirpath, conf_names_t *names)
+    __attribute__((nonnull(1, 3, 4))) __attribute__((warn_unused_result));
+static int compare_conf_names(const void *a, const void *b)
+    __attribute__((nonnull(1, 2))) __attribute__((warn_unused_result));
+static const char **sort_conf_names(const struct syscall_ops *ops,
+                                    const conf_names_t *names)
     __attribute__((nonnull(1, 2))) __attribute__((warn_unused_result));
-static int load_config_from_dir(const struct syscall_ops *ops, config_t *config,
+static int load_config_from_dir(const struct syscall_ops *ops,
+                                const config_key_table_t *table,
                                 const char *dirpath, bool debug)
     __attribute__((nonnull(1, 2, 3))) __attribute__((warn_unused_result));
-static void apply_config_value(const char *key, const char *value,
-                               config_t *config, const char *filepath)
+static int compare_config_keys(const void *a, const void *b)
+    __attribute__((nonnull(1, 2))) __attribute__((warn_unused_result));
+static int compare_config_key_name(const void *name, const void *entry)
+    __attribute__((nonnull(1, 2))) __attribute__((warn_unused_result));
+static void add_config_key(config_key_table_t *table, const char *name,
+                           config_key_kind_t kind, void *field)
+    __attribute__((nonnull(1, 2, 4)));
+static void build_config_key_table(config_t *config, config_key_table_t *table)
+    __attribute__((nonnull(1, 2)));
+static int compare_bands(const void *a, const void *b)
+    __attribute__((nonnull(1, 2))) __attribute__((warn_unused_result));
+static int parse_band(char *item, subid_band_t *band)
+    __attribute__((nonnull(1, 2))) __attribute__((warn_unused_result));
+static void parse_bands(const config_key_t *entry, const char *value,
+                        const char *filepath) __attribute__((nonnull(1, 2, 3)));
+static void apply_config_value(const config_key_t *entry, const char *value,
+                               const char *filepath)
     __attribute__((nonnull(1, 2, 3)));
+static void print_bands(const subid_config_t *subid_cfg, FILE *out,
+                        const char *prefix) __attribute__((nonnull(1, 2, 3)));
+static void parse_config_line(const config_key_table_t *table, char *line,
+                              size_t len, const char *filepath, bool debug)
+    __attribute__((nonnull(1, 2, 4)));
+static void parse_config_fd(const struct syscall_ops *ops, int fd,
+                            const char *filepath,
+                            const config_key_table_t *table, bool debug)
+    __attribute__((nonnull(1, 3, 4)));
 static void parse_config_file(const struct syscall_ops *ops,
-                              const char *filepath, config_t *config,
-                              bool debug) __attribute__((nonnull(1, 2, 3)));
+                              const char *filepath,
+                              const config_key_table_t *table, bool debug)
+    __attribute__((nonnull(1, 2, 3)));
 
 /**
- * safe_open_config - Safely open configuration file with security checks
+ * check_config_fd - Apply the configuration file checks to an opened file
  * @ops: Operations structure for system call abstraction (kernel-style ops
  * pattern)
- * @filepath: Path to configuration file (may be a symlink)
- * @debug: Enable debug output
+ * @fd: Descriptor of the opened file, closed if a check fails
+ * @filepath: Path of the file, for messages
  *
- * Performs security validation:
- * 1. Path validation (no traversal)
- * 2. Open file (follows symlinks if present)
- * 3. Target must be regular file (not device, directory, etc.)
- * 4. Target must be owned by root (UID 0)
- * 5. Target must not be world-writable
+ * The target must be a regular file (not device, directory, etc.) owned by
+ * root (UID 0) and must not be world-writable. The checks use fstat() on
+ * @fd, so they hold for exactly the file that is read afterwards.
  *
- * Follows symlinks during open(), then performs all security checks on the
- * opened file descriptor via fstat() to verify the target file meets security
- * requirements. This eliminates TOCTOU races since checks are performed on
- * the already-opened fd. Finally converts fd to FILE* via fdopen() for use
- * with fgets().
- *
- * Return: FILE pointer on success, NULL on error or non-existent file
+ * Return: @fd on success, -1 on error (@fd closed)
  */
-static FILE *safe_open_config(const struct syscall_ops *ops,
-                              const char *filepath, bool debug) {
-  // LCOV_EXCL_START
-  if (validate_path(filepath) != 0) {
-    /* should be impossible to get here */
-    errno = EINVAL;
-    return NULL;
-  }
-  // LCOV_EXCL_STOP
-
-  if (debug) {
-    (void)fprintf(stderr, "%s: debug: opening config file: %s\n", PROJECT_NAME,
-                  filepath);
-  }
-
-  /*
-   * Open file, following symlinks in path and final component
-   * fstat() on the opened fd checks security properties of the target,
-   * eliminating TOCTOU races
-   */
-  int fd = ops->open(filepath, O_RDONLY);
-  if (fd < 0) {
-    if (errno != ENOENT) {
-      (void)fprintf(stderr, "%s: error: cannot open %s: %s\n", PROJECT_NAME,
-                    filepath, strerror(errno));
-      return NULL;
-    }
-
-    /* Not an error: file doesn't exist (root might create it later) */
-    if (debug) {
-      (void)fprintf(stderr, "%s: debug: config file does not exist: %s\n",
-                    PROJECT_NAME, filepath);
-    }
-    return NULL;
-  }
-
-  /* Get file info after opening (avoid TOCTOU) - use fstat on fd */
+static int check_config_fd(const struct syscall_ops *ops, int fd,
+                           const char *filepath) {
   struct stat st = {0};
   if (ops->fstat(fd, &st) != 0) {
     (void)fprintf(stderr, "%s: error: cannot fstat %s: %s\n", PROJECT_NAME,
                   filepath, strerror(errno));
     (void)ops->close(fd);
-    return NULL;
+    return -1;
   }
 
   /* Target must be regular file (not fifo, device, etc.) */
@@ -145,7 +218,7 @@ static FILE *safe_open_config(const struct syscall_ops *ops,
 
     errno = EBADF;
     (void)ops->close(fd);
-    return NULL;
+    return -1;
   }
 
   /* Target file must be owned by root for security */
@@ -154,7 +227,7 @@ static FILE *safe_open_config(const struct syscall_ops *ops,
     (void)fprintf(stderr, "%s: error: %s must be owned by root (uid 0)\n",
                   PROJECT_NAME, filepath);
     (void)ops->close(fd);
-    return NULL;
+    return -1;
   }
 
   /* Target file must not be world-writable */
@@ -164,202 +237,703 @@ static FILE *safe_open_config(const struct syscall_ops *ops,
                   "%s: error: config file %s is world-writable (mode %04o)\n",
                   PROJECT_NAME, filepath, st.st_mode & 07777);
     (void)ops->close(fd);
-    return NULL;
+    return -1;
   }
 
-  /* Convert fd to FILE* for use with fgets */
-  FILE *fp = ops->fdopen(fd, "r");
-  if (fp == NULL) {
-    errno = EBADF;
-    (void)fprintf(stderr, "%s: error: cannot fdopen %s: %s\n", PROJECT_NAME,
-                  filepath, strerror(errno));
-    (void)ops->close(fd);
-    return NULL;
+  return fd;
+}
+
+/**
+ * safe_open_config - Safely open configuration file with security checks
+ * @ops: Operations structure for system call abstraction (kernel-style ops
+ * pattern)
+ * @filepath: Path to configuration file (may be a symlink)
+ * @debug: Enable debug output
+ *
+ * Performs security validation:
+ * 1. Path validation (no traversal)
+ * 2. Open file (follows symlinks if present)
+ * 3. Target must be regular file (not device, directory, etc.)
+ * 4. Target must be owned by root (UID 0)
+ * 5. Target must not be world-writable
+ *
+ * Follows symlinks during open(), then performs all security checks on the
+ * opened file descriptor via fstat() to verify the target file meets security
+ * requirements. This eliminates TOCTOU races since checks are performed on
+ * the already-opened fd, which is then read directly.
+ *
+ * Return: File descriptor on success, -1 on error or non-existent file
+ */
+static int safe_open_config(const struct syscall_ops *ops,
+                            const char *filepath, bool debug) {
+  // LCOV_EXCL_START
+  if (validate_path(filepath) != 0) {
+    /* should be impossible to get here */
+    errno = EINVAL;
+    return -1;
+  }
+  // LCOV_EXCL_STOP
+
+  if (debug) {
+    (void)fprintf(stderr, "%s: debug: opening config file: %s\n", PROJECT_NAME,
+                  filepath);
+  }
+
+  /*
+   * Open file, following symlinks in path and final component
+   * check_config_fd() uses fstat() on the opened fd to check the target,
+   * eliminating TOCTOU races
+   */
+  int fd = ops->open(filepath, O_RDONLY);
+  if (fd < 0) {
+    if (errno != ENOENT) {
+      (void)fprintf(stderr, "%s: error: cannot open %s: %s\n", PROJECT_NAME,
+                    filepath, strerror(errno));
+      return -1;
+    }
+
+    /* Not an error: file doesn't exist (root might create it later) */
+    if (debug) {
+      (void)fprintf(stderr, "%s: debug: config file does not exist: %s\n",
+                    PROJECT_NAME, filepath);
+    }
+    return -1;
+  }
+
+  return check_config_fd(ops, fd, filepath);
+}
+
+/**
+ * compare_config_keys - qsort(3) comparator for config_key_t by name
+ * @a: First entry
+ * @b: Second entry
+ *
+ * Return: strcmp() of the names
+ */
+static int compare_config_keys(const void *a, const void *b) {
+  const config_key_t *ka = a;
+  const config_key_t *kb = b;
+  return strcmp(ka->name, kb->name);
+}
+
+/**
+ * compare_config_key_name - bsearch(3) comparator of a name to an entry
+ * @name: Key name being looked up
+ * @entry: Table entry
+ *
+ * Return: strcmp() of @name and the entry's name
+ */
+static int compare_config_key_name(const void *name, const void *entry) {
+  const config_key_t *key = entry;
+  return strcmp(name, key->name);
+}
+
+/**
+ * add_config_key - Append a key to the table
+ * @table: Table being built
+ * @name: Key name
+ * @kind: How the value is parsed
+ * @field: Destination field
+ */
+static void add_config_key(config_key_table_t *table, const char *name,
+                           config_key_kind_t kind, void *field) {
+  // LCOV_EXCL_START
+  if (table->len >= CONFIG_KEY_MAX) {
+    /* CONFIG_KEY_MAX out of sync with build_config_key_table() */
+    return;
   }
+  // LCOV_EXCL_STOP
+  table->keys[table->len++] =
+      (config_key_t){.name = name, .kind = kind, .field = field};
+}
 
-  /* fd now owned by fp, don't close fd! */
-  return fp;
+/**
+ * build_config_key_table - Index every key of @config for lookup
+ * @config: Configuration the values are stored in
+ * @table: Table to fill, sorted by key name on return
+ *
+ * The names are the key_* members, so the table always agrees with
+ * config_factory() and print_configuration().
+ */
+static void build_config_key_table(config_t *config,
+                                   config_key_table_t *table) {
+  table->len = 0;
+
+  /* UID range configuration */
+  add_config_key(table, config->key_uid_min, CONFIG_KEY_UINT32,
+                 &config->uid_min);
+  add_config_key(table, config->key_uid_max, CONFIG_KEY_UINT32,
+                 &config->uid_max);
+
+  /* Sub UID and Sub GID configuration */
+  subid_config_t *const sections[] = {&config->subuid, &config->subgid};
+  for (size_t i = 0; i < sizeof(sections) / sizeof(sections[0]); i++) {
+    add_config_key(table, sections[i]->key_min, CONFIG_KEY_UINT32,
+                   &sections[i]->min_val);
+    add_config_key(table, sections[i]->key_max, CONFIG_KEY_UINT32,
+                   &sections[i]->max_val);
+    add_config_key(table, sections[i]->key_count, CONFIG_KEY_COUNT,
+                   &sections[i]->count_val);
+    add_config_key(table, sections[i]->key_bands, CONFIG_KEY_BANDS,
+                   sections[i]);
+  }
+
+  /* Boolean options */
+  add_config_key(table, config->key_skip_if_exists, CONFIG_KEY_BOOL,
+                 &config->skip_if_exists);
+  add_config_key(table, config->key_allow_subid_wrap, CONFIG_KEY_BOOL,
+                 &config->allow_subid_wrap);
+  add_config_key(table, config->key_skip_if_exact, CONFIG_KEY_BOOL,
+                 &config->skip_if_exact);
+
+  /* Existence check backend and how new ranges are written */
+  add_config_key(table, config->key_subid_backend, CONFIG_KEY_BACKEND,
+                 &config->subid_backend);
+  add_config_key(table, config->key_subid_writer, CONFIG_KEY_WRITER,
+                 &config->subid_writer);
+
+  /* passwd lookup deadline */
+  add_config_key(table, config->key_resolve_timeout_ms, CONFIG_KEY_UINT32,
+                 &config->resolve_timeout_ms);
+
+  qsort(table->keys, table->len, sizeof(table->keys[0]), compare_config_keys);
+}
+
+/**
+ * compare_bands - qsort(3) comparator for subid_band_t by first UID
+ * @a: First band
+ * @b: Second band
+ *
+ * Return: <0, 0 or >0 as @a starts before, with or after @b
+ */
+static int compare_bands(const void *a, const void *b) {
+  const subid_band_t *ba = a;
+  const subid_band_t *bb = b;
+  return (ba->uid_lo > bb->uid_lo) - (ba->uid_lo < bb->uid_lo);
 }
 
 /**
- * apply_config_value - Apply a parsed key-value pair to configuration
- * @key: Configuration key
+ * parse_band - Parse one UID_LO-UID_HI:COUNT item in place
+ * @item: NUL-terminated item, modified in place
+ * @band: Set to the band on success
+ *
+ * Return: 0 on success, -1 on error (errno ERANGE for a count above
+ *         MAX_RANGES, EINVAL otherwise)
+ */
+static int parse_band(char *item, subid_band_t *band) {
+  char *dash = strchr(item, '-');
+  char *colon = strchr(item, ':');
+  if (dash == NULL || colon == NULL || colon < dash) {
+    errno = EINVAL;
+    return -1;
+  }
+  *dash = '\0';
+  *colon = '\0';
+
+  subid_band_t parsed = {0};
+  if (parse_uint32_strict(item, &parsed.uid_lo) != 0 ||
+      parse_uint32_strict(dash + 1, &parsed.uid_hi) != 0 ||
+      parse_uint32_strict(colon + 1, &parsed.count) != 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (parsed.count > MAX_RANGES) {
+    errno = ERANGE;
+    return -1;
+  }
+
+  *band = parsed;
+  return 0;
+}
+
+/**
+ * parse_bands - Replace the bands of a subordinate ID type
+ * @entry: Table entry the key matched, @entry->field the subid_config_t
+ * @value: Comma-separated UID_LO-UID_HI:COUNT items, or "none"
+ * @filepath: Source filepath (for error messages)
+ *
+ * The whole list is one value, so a later file replaces it rather than
+ * adding to it, and "none" takes every band away again. The bands are
+ * stored sorted by first UID; whether they overlap or fit the UID range
+ * is only known once every file is read, see validate_subid_bands().
+ * An invalid list is reported and ignored like any other invalid value.
+ */
+static void parse_bands(const config_key_t *entry, const char *value,
+                        const char *filepath) {
+  subid_config_t *subid_cfg = entry->field;
+
+  if (strcasecmp(value, "none") == 0) {
+    subid_cfg->band_count = 0;
+    return;
+  }
+
+  /* Lines are shorter than MAX_LINE_LEN, so the value always fits */
+  char buf[MAX_LINE_LEN] = {0};
+  (void)snprintf(buf, sizeof(buf), "%s", value);
+
+  subid_band_t bands[SUBID_BANDS_MAX] = {{0}};
+  size_t len = 0;
+  char *item = buf;
+  for (;;) {
+    size_t item_len = strcspn(item, ",");
+    bool last = item[item_len] == '\0';
+    item[item_len] = '\0';
+
+    if (len == SUBID_BANDS_MAX) {
+      errno = EINVAL;
+      (void)fprintf(stderr,
+                    "%s: error: file %s %s lists more than %d bands\n",
+                    PROJECT_NAME, filepath, entry->name, SUBID_BANDS_MAX);
+      return;
+    }
+    if (parse_band(item, &bands[len]) != 0) {
+      if (errno == ERANGE) {
+        (void)fprintf(stderr,
+                      "%s: error: file %s %s count exceeds defined limit "
+                      "of %u\n",
+                      PROJECT_NAME, filepath, entry->name, MAX_RANGES);
+      } else {
+        (void)fprintf(stderr,
+                      "%s: error: file %s %s %s is not a list of "
+                      "UID_LO-UID_HI:COUNT\n",
+                      PROJECT_NAME, filepath, entry->name, value);
+      }
+      return;
+    }
+    len++;
+
+    if (last) {
+      break;
+    }
+    item += item_len + 1;
+  }
+
+  qsort(bands, len, sizeof(bands[0]), compare_bands);
+  (void)memcpy(subid_cfg->bands, bands, sizeof(bands));
+  subid_cfg->band_count = len;
+}
+
+/**
+ * apply_config_value - Apply a parsed value to its configuration field
+ * @entry: Table entry the key matched
  * @value: Configuration value string
- * @config: Configuration structure to update
  * @filepath: Source filepath (for error messages)
  *
- * Matches key against known configuration parameters and updates the
- * corresponding field in the config structure. Invalid values are silently
- * ignored to handle mixed config files like login.defs.
+ * Invalid values are silently ignored to handle mixed config files like
+ * login.defs.
  *
  * For count values, enforces MAX_RANGES limit and logs errors on overflow.
  * Last value wins for repeated keys (no warning).
  */
-static void apply_config_value(const char *key, const char *value,
-                               config_t *config, const char *filepath) {
+static void apply_config_value(const config_key_t *entry, const char *value,
+                               const char *filepath) {
   uint32_t val = 0;
 
-  /* UID range configuration */
-  if (strcmp(key, config->key_uid_min) == 0) {
-    if (parse_uint32_strict(value, &val) == 0) {
-      config->uid_min = val;
-    }
-  } else if (strcmp(key, config->key_uid_max) == 0) {
-    if (parse_uint32_strict(value, &val) == 0) {
-      config->uid_max = val;
-    }
-  }
-  /* Sub UID configuration */
-  else if (strcmp(key, config->subuid.key_min) == 0) {
+  switch (entry->kind) {
+  case CONFIG_KEY_UINT32:
     if (parse_uint32_strict(value, &val) == 0) {
-      config->subuid.min_val = val;
+      *(uint32_t *)entry->field = val;
     }
-  } else if (strcmp(key, config->subuid.key_max) == 0) {
-    if (parse_uint32_strict(value, &val) == 0) {
-      config->subuid.max_val = val;
-    }
-  } else if (strcmp(key, config->subuid.key_count) == 0) {
+    break;
+  case CONFIG_KEY_COUNT:
     if (parse_uint32_strict(value, &val) == 0) {
       if (val <= MAX_RANGES) {
-        config->subuid.count_val = val;
+        *(uint32_t *)entry->field = val;
       } else {
         errno = ERANGE;
         (void)fprintf(stderr,
                       "%s: error: file %s %s %u exceeds defined "
                       "limit of %u\n",
-                      PROJECT_NAME, filepath, config->subuid.key_count, val,
-                      MAX_RANGES);
+                      PROJECT_NAME, filepath, entry->name, val, MAX_RANGES);
       }
     }
+    break;
+  case CONFIG_KEY_BOOL: {
+    bool *flag = entry->field;
+    *flag = parse_bool(value, *flag);
+    break;
   }
-  /* Sub GID configuration */
-  else if (strcmp(key, config->subgid.key_min) == 0) {
-    if (parse_uint32_strict(value, &val) == 0) {
-      config->subgid.min_val = val;
+  case CONFIG_KEY_BACKEND:
+    if (strcasecmp(value, "getsubids") == 0) {
+      *(subid_backend_t *)entry->field = SUBID_BACKEND_GETSUBIDS;
+    } else if (strcasecmp(value, "files") == 0) {
+      *(subid_backend_t *)entry->field = SUBID_BACKEND_FILES;
+    } else {
+      errno = EINVAL;
+      (void)fprintf(stderr,
+                    "%s: error: file %s %s %s is not one of getsubids, "
+                    "files\n",
+                    PROJECT_NAME, filepath, entry->name, value);
     }
-  } else if (strcmp(key, config->subgid.key_max) == 0) {
-    if (parse_uint32_strict(value, &val) == 0) {
-      config->subgid.max_val = val;
+    break;
+  case CONFIG_KEY_WRITER:
+    if (strcasecmp(value, "usermod") == 0) {
+      *(subid_writer_t *)entry->field = SUBID_WRITER_USERMOD;
+    } else if (strcasecmp(value, "files") == 0) {
+      *(subid_writer_t *)entry->field = SUBID_WRITER_FILES;
+    } else if (strcasecmp(value, "spool") == 0) {
+      *(subid_writer_t *)entry->field = SUBID_WRITER_SPOOL;
+    } else {
+      errno = EINVAL;
+      (void)fprintf(stderr,
+                    "%s: error: file %s %s %s is not one of usermod, "
+                    "files, spool\n",
+                    PROJECT_NAME, filepath, entry->name, value);
     }
-  } else if (strcmp(key, config->subgid.key_count) == 0) {
-    if (parse_uint32_strict(value, &val) == 0) {
-      if (val <= MAX_RANGES) {
-        config->subgid.count_val = val;
-      } else {
-        errno = ERANGE;
-        (void)fprintf(stderr,
-                      "%s: error: file %s %s %u exceeds defined "
-                      "limit of %u\n",
-                      PROJECT_NAME, filepath, config->subgid.key_count, val,
-                      MAX_RANGES);
-      }
+    break;
+  case CONFIG_KEY_BANDS:
+    parse_bands(entry, value, filepath);
+    break;
+  // LCOV_EXCL_START
+  default:
+    break;
+    // LCOV_EXCL_STOP
+  }
+}
+
+/**
+ * parse_config_line - Parse one KEY VALUE line in place
+ * @table: Recognised keys
+ * @line: NUL-terminated line without its newline, modified in place
+ * @len: Length of @line
+ * @filepath: Source filepath (for messages)
+ * @debug: Enable debug output
+ *
+ * Lines are normalized (comments stripped, whitespace trimmed) before
+ * parsing. Lines of MAX_LINE_LEN bytes or more are skipped in full.
+ */
+static void parse_config_line(const config_key_table_t *table, char *line,
+                              size_t len, const char *filepath, bool debug) {
+  if (len >= MAX_LINE_LEN) {
+    if (debug) {
+      (void)fprintf(stderr, "%s: debug: %s: skipping overlong line\n",
+                    PROJECT_NAME, filepath);
     }
+    return;
   }
-  /* Boolean options */
-  else if (strcmp(key, config->key_skip_if_exists) == 0) {
-    config->skip_if_exists = parse_bool(value, config->skip_if_exists);
-  } else if (strcmp(key, config->key_allow_subid_wrap) == 0) {
-    config->allow_subid_wrap = parse_bool(value, config->allow_subid_wrap);
+
+  /* Normalize: strip comments and trim whitespace */
+  char *clean = normalize_config_line(line);
+
+  /* Skip blank lines */
+  if (*clean == '\0') {
+    return;
+  }
+
+  /* Parse KEY VALUE format (whitespace-separated) */
+  char *key = clean;
+  char *value = key;
+
+  /* Find first whitespace to split key and value */
+  while (*value && !isspace((unsigned char)*value)) {
+    value++;
+  }
+
+  /* If no whitespace found, skip line (key without value) */
+  if (*value == '\0') {
+    if (debug) {
+      (void)fprintf(stderr, "%s: debug: skipping key without value: %s\n",
+                    PROJECT_NAME, key);
+    }
+    return;
+  }
+
+  /* Null-terminate key and advance to value */
+  *value = '\0';
+  value++;
+
+  /* Skip whitespace before value */
+  while (*value && isspace((unsigned char)*value)) {
+    value++;
+  }
+
+  /* Apply configuration if value is not empty */
+  if (*value == '\0') {
+    return;
   }
 
   /* Silently ignore unknown keys for compatibility with login.defs */
+  const config_key_t *entry = bsearch(key, table->keys, table->len,
+                                      sizeof(table->keys[0]),
+                                      compare_config_key_name);
+  if (entry != NULL) {
+    apply_config_value(entry, value, filepath);
+  }
+}
+
+/**
+ * parse_config_fd - Parse an opened configuration file
+ * @ops: Structure for system call abstraction (kernel-style ops pattern)
+ * @fd: Descriptor that passed check_config_fd(), closed on return
+ * @filepath: Path of the file, for messages
+ * @table: Recognised keys, pointing into the configuration being loaded
+ * @debug: Enable debug output
+ *
+ * Reads the file in CONFIG_READ_SIZE blocks and parses each line where it
+ * lies in the buffer; only an incomplete last line is moved to the front
+ * before the next read. Invalid lines are silently skipped to handle
+ * mixed config files like login.defs. A read error stops parsing, keeping
+ * the values already applied.
+ */
+static void parse_config_fd(const struct syscall_ops *ops, int fd,
+                            const char *filepath,
+                            const config_key_table_t *table, bool debug) {
+  if (debug) {
+    (void)fprintf(stderr, "%s: debug: parsing config file: %s\n", PROJECT_NAME,
+                  filepath);
+  }
+
+  /* +1 so a final line without newline can still be terminated */
+  char buf[CONFIG_READ_SIZE + 1];
+  size_t have = 0;
+  bool skipping = false; /* Discarding the rest of an overlong line */
+  uint64_t lines = 0;
+  uint64_t bytes = 0;
+
+  for (;;) {
+    ssize_t n = ops->read(fd, buf + have, CONFIG_READ_SIZE - have);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      (void)fprintf(stderr, "%s: error: cannot read %s: %s\n", PROJECT_NAME,
+                    filepath, strerror(errno));
+      break;
+    }
+
+    have += (size_t)n;
+    bytes += (uint64_t)n;
+    char *line = buf;
+    const char *end = buf + have;
+    char *newline = NULL;
+    while ((newline = memchr(line, '\n', (size_t)(end - line))) != NULL) {
+      *newline = '\0';
+      lines++;
+      if (skipping) {
+        skipping = false;
+      } else {
+        parse_config_line(table, line, (size_t)(newline - line), filepath,
+                          debug);
+      }
+      line = newline + 1;
+    }
+
+    size_t rest = (size_t)(end - line);
+    if (n == 0) {
+      /* Last line without a trailing newline */
+      if (rest > 0 && !skipping) {
+        lines++;
+        line[rest] = '\0';
+        parse_config_line(table, line, rest, filepath, debug);
+      }
+      break;
+    }
+
+    if (!skipping && rest >= MAX_LINE_LEN) {
+      /* Too long whatever follows: report once, drop until newline */
+      parse_config_line(table, line, rest, filepath, debug);
+      skipping = true;
+    }
+    if (skipping) {
+      have = 0;
+    } else {
+      (void)memmove(buf, line, rest);
+      have = rest;
+    }
+  }
+
+  stats_count(STATS_FILES, 1);
+  stats_count(STATS_LINES, lines);
+  stats_count(STATS_BYTES, bytes);
+  (void)ops->close(fd);
 }
 
 /**
  * parse_config_file - Parse configuration file and update config structure
  * @ops: Structure for system call abstraction (kernel-style ops pattern)
  * @filepath: Path to configuration file
- * @config: Configuration structure to update
+ * @table: Recognised keys, pointing into the configuration being loaded
  * @debug: Enable debug output
  *
- * Parses KEY VALUE pairs from config file. Lines are normalized (comments
- * stripped, whitespace trimmed) before parsing. Invalid lines are silently
- * skipped to handle mixed config files like login.defs.
- *
  * File must pass security validation (root-owned, not world-writable).
  * Non-existent files are silently skipped (not an error).
  */
 static void parse_config_file(const struct syscall_ops *ops,
-                              const char *filepath, config_t *config,
-                              bool debug) {
-  FILE *fp = safe_open_config(ops, filepath, debug);
-  if (fp == NULL) {
+                              const char *filepath,
+                              const config_key_table_t *table, bool debug) {
+  int fd = safe_open_config(ops, filepath, debug);
+  if (fd < 0) {
     return; /* File doesn't exist or failed security checks */
   }
 
-  if (debug) {
-    (void)fprintf(stderr, "%s: debug: parsing config file: %s\n", PROJECT_NAME,
-                  filepath);
-  }
+  parse_config_fd(ops, fd, filepath, table, debug);
+}
 
-  char line[MAX_LINE_LEN] = {0};
-  while (ops->fgets(line, sizeof(line), fp) != NULL) {
-    /* Normalize: strip comments and trim whitespace */
-    char *clean = normalize_config_line(line);
+/**
+ * add_conf_name - Append a drop-in name to the collected names
+ * @ops: Operations structure; calloc() and free() grow the buffer
+ * @names: Names collected so far
+ * @name: Name to append
+ *
+ * The buffer doubles when it fills, so a directory of any size costs a
+ * handful of allocations rather than one per entry.
+ *
+ * Return: 0 on success, -1 on error (errno ENOMEM)
+ */
+static int add_conf_name(const struct syscall_ops *ops, conf_names_t *names,
+                         const char *name) {
+  size_t need = strlen(name) + 1;
 
-    /* Skip blank lines */
-    if (*clean == '\0') {
-      continue;
+  if (names->size - names->len < need) {
+    size_t size = names->size != 0 ? names->size : CONFIG_NAMES_INITIAL;
+    while (size - names->len < need) {
+      // LCOV_EXCL_START
+      if (size > SIZE_MAX / 2) {
+        errno = ENOMEM;
+        return -1;
+      }
+      // LCOV_EXCL_STOP
+      size *= 2;
     }
 
-    /* Parse KEY VALUE format (whitespace-separated) */
-    char *key = clean;
-    char *value = key;
-
-    /* Find first whitespace to split key and value */
-    while (*value && !isspace((unsigned char)*value)) {
-      value++;
+    char *buf = ops->calloc(size, 1);
+    if (buf == NULL) {
+      errno = ENOMEM;
+      return -1;
     }
+    if (names->len > 0) {
+      (void)memcpy(buf, names->buf, names->len);
+    }
+    ops->free(names->buf);
+    names->buf = buf;
+    names->size = size;
+  }
 
-    /* If no whitespace found, skip line (key without value) */
-    if (*value == '\0') {
-      if (debug) {
-        (void)fprintf(stderr, "%s: debug: skipping key without value: %s\n",
-                      PROJECT_NAME, key);
+  (void)memcpy(names->buf + names->len, name, need);
+  names->len += need;
+  names->count++;
+  return 0;
+}
+
+/**
+ * collect_conf_names - Read the .conf names of a directory in one pass
+ * @ops: Operations structure for system call abstraction (kernel-style ops
+ * pattern)
+ * @dirfd: Directory opened by load_config_from_dir()
+ * @dirpath: Path of the directory, for messages
+ * @names: Zeroed on entry, set to the names accepted by filter_conf_name()
+ *
+ * Entries come straight from getdents64(2) into a buffer on the stack;
+ * only the names kept are copied, into @names. Release @names->buf with
+ * ops->free() whatever the result.
+ *
+ * Return: 0 on success, -1 on error (message printed, errno set)
+ */
+static int collect_conf_names(const struct syscall_ops *ops, int dirfd,
+                              const char *dirpath, conf_names_t *names) {
+  alignas(struct dirent64) unsigned char dents[CONFIG_DENTS_SIZE];
+
+  for (;;) {
+    ssize_t n = ops->getdents64(dirfd, dents, sizeof(dents));
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
       }
-      continue;
+      (void)fprintf(stderr, "%s: error: cannot scan directory %s: %s\n",
+                    PROJECT_NAME, dirpath, strerror(errno));
+      return -1;
+    }
+    if (n == 0) {
+      return 0;
     }
 
-    /* Null-terminate key and advance to value */
-    *value = '\0';
-    value++;
+    size_t off = 0;
+    while (off < (size_t)n) {
+      const struct dirent64 *entry = (const void *)(dents + off);
+      if (entry->d_reclen == 0) {
+        /* A record that does not advance would loop forever */
+        errno = EIO;
+        (void)fprintf(stderr,
+                      "%s: error: cannot scan directory %s: bad entry\n",
+                      PROJECT_NAME, dirpath);
+        return -1;
+      }
+      off += entry->d_reclen;
 
-    /* Skip whitespace before value */
-    while (*value && isspace((unsigned char)*value)) {
-      value++;
+      if (filter_conf_name(entry->d_name) &&
+          add_conf_name(ops, names, entry->d_name) != 0) {
+        (void)fprintf(stderr,
+                      "%s: error: cannot scan directory %s: %s\n",
+                      PROJECT_NAME, dirpath, strerror(errno));
+        return -1;
+      }
     }
+  }
+}
 
-    /* Apply configuration if value is not empty */
-    if (*value != '\0') {
-      apply_config_value(key, value, config, filepath);
-    }
+/**
+ * compare_conf_names - qsort(3) comparator for drop-in names
+ * @a: First name
+ * @b: Second name
+ *
+ * Nothing calls setlocale(3), so strcmp() orders names as alphasort(3)
+ * did.
+ *
+ * Return: strcmp() of the names
+ */
+static int compare_conf_names(const void *a, const void *b) {
+  return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+/**
+ * sort_conf_names - Put collected drop-in names in processing order
+ * @ops: Operations structure; calloc() allocates the array
+ * @names: Names from collect_conf_names(), at least one
+ *
+ * Return: @names->count pointers into @names->buf in strcmp() order, to
+ *         release with ops->free(); NULL on error (errno ENOMEM)
+ */
+static const char **sort_conf_names(const struct syscall_ops *ops,
+                                    const conf_names_t *names) {
+  const char **sorted = ops->calloc(names->count, sizeof(*sorted));
+  if (sorted == NULL) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  const char *name = names->buf;
+  for (size_t i = 0; i < names->count; i++) {
+    sorted[i] = name;
+    name += strlen(name) + 1;
   }
 
-  (void)ops->fclose(fp);
+  qsort(sorted, names->count, sizeof(*sorted), compare_conf_names);
+  return sorted;
 }
 
 /**
  * load_config_from_dir - Load configuration from drop-in directory
  * @ops: Operations structure for system call abstraction (kernel-style ops
  * pattern)
- * @config: Configuration structure to update
+ * @table: Recognised keys, pointing into the configuration being loaded
  * @dirpath: Path to directory containing .conf files
  * @debug: Enable debug output
  *
- * Validates directory security (root-owned, not world-writable), then
- * scans for .conf files and processes them in alphabetical order.
- * Non-existent directory is not an error (returns 0).
+ * Opens the directory once, following a symlink as validate_config_dir()
+ * does, and checks the descriptor (root-owned, not world-writable). The
+ * .conf names are read from it in a single getdents64(2) pass, and each
+ * file is opened with openat(2) relative to it in alphabetical order, so
+ * renaming or replacing @dirpath after the check changes nothing that is
+ * read. Non-existent directory is not an error (returns 0).
  * Security violations or other errors return -1.
  *
  * Return: 0 on success, -1 on error
  */
-static int load_config_from_dir(const struct syscall_ops *ops, config_t *config,
+static int load_config_from_dir(const struct syscall_ops *ops,
+                                const config_key_table_t *table,
                                 const char *dirpath, bool debug) {
-  /*
-   * Validate directory security before processing
-   * This function handles ENOENT gracefully (returns 0)
-   */
-  if (validate_config_dir(ops, dirpath, debug) != 0) {
+  if (validate_path(dirpath) != 0) {
+    /* errno already set by validate_path */
     return -1;
   }
 
@@ -368,75 +942,59 @@ static int load_config_from_dir(const struct syscall_ops *ops, config_t *config,
                   PROJECT_NAME, dirpath);
   }
 
-  /*
-   * Scan directory for .conf files
-   * scandir() handles ENOENT by returning -1 with errno == ENOENT
-   * This is the ONLY place we need to check for ENOENT in this function
-   */
-  struct dirent **namelist = NULL;
-  int n = ops->scandir(dirpath, &namelist, filter_conf_files, alphasort);
-
-  if (n < 0) {
+  int dirfd =
+      ops->openat(AT_FDCWD, dirpath, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dirfd < 0) {
     if (errno == ENOENT) {
-      /*
-       * Directory doesn't exist - this is fine
-       * validate_config_dir already logged this in debug mode
-       */
+      /* Directory doesn't exist - this is fine */
+      if (debug) {
+        (void)fprintf(stderr,
+                      "%s: debug: config directory does not exist: %s\n",
+                      PROJECT_NAME, dirpath);
+      }
       return 0;
     }
-    /* Other scandir errors are real problems */
-    (void)fprintf(stderr, "%s: error: cannot scan directory %s: %s\n",
+    (void)fprintf(stderr, "%s: error: cannot open config directory %s: %s\n",
                   PROJECT_NAME, dirpath, strerror(errno));
     return -1;
   }
 
-  if (debug && n > 0) {
-    (void)fprintf(stderr, "%s: debug: found %d config file%s in %s\n",
-                  PROJECT_NAME, n, n == 1 ? "" : "s", dirpath);
-  }
+  conf_names_t names = {0};
+  const char **sorted = NULL;
+  int saved_errno = 0;
 
-  /* Process each file in sorted order */
-  for (int i = 0; i < n; i++) {
-    const char *name = namelist[i]->d_name;
-
-    /*
-     * Defense-in-depth: Validate filename before constructing path
-     * This catches malicious entries even if filter_conf_files was bypassed
-     */
+  if (validate_config_dir_fd(ops, dirfd, dirpath) != 0 ||
+      collect_conf_names(ops, dirfd, dirpath, &names) != 0) {
+    saved_errno = errno;
+  } else if (names.count > 0 &&
+             (sorted = sort_conf_names(ops, &names)) == NULL) {
+    saved_errno = errno;
+    (void)fprintf(stderr, "%s: error: cannot sort directory %s: %s\n",
+                  PROJECT_NAME, dirpath, strerror(errno));
+  }
+  if (saved_errno != 0) {
+    ops->free(names.buf);
+    (void)ops->close(dirfd);
+    errno = saved_errno;
+    return -1;
+  }
 
-    /* Reject filenames containing path separators */
-    if (strchr(name, '/') != NULL) {
-      if (debug) {
-        (void)fprintf(stderr,
-                      "%s: debug: skipping filename with path separator: %s\n",
-                      PROJECT_NAME, name);
-      }
-      (void)free(namelist[i]);
-      continue;
-    }
+  if (debug && names.count > 0) {
+    (void)fprintf(stderr, "%s: debug: found %zu config file%s in %s\n",
+                  PROJECT_NAME, names.count, names.count == 1 ? "" : "s",
+                  dirpath);
+  }
 
-    /* Reject filenames starting with path traversal */
-    if (name[0] == '.' && name[1] == '.') {
-      if (debug) {
-        (void)fprintf(stderr,
-                      "%s: debug: skipping filename with path traversal: %s\n",
-                      PROJECT_NAME, name);
-      }
-      (void)free(namelist[i]);
-      continue;
-    }
+  /* Process each file in sorted order */
+  for (size_t i = 0; i < names.count; i++) {
+    const char *name = sorted[i];
 
+    /* The full path is only for messages; the file is opened by name */
     char filepath[PATH_MAX] = {0};
-
-    /*
-     * Use snprintf for safe string formatting
-     * Check return value to detect truncation
-     */
     int ret = snprintf(filepath, sizeof(filepath), "%s/%s", dirpath, name);
     if (ret < 0 || (size_t)ret >= sizeof(filepath)) {
       (void)fprintf(stderr, "%s: error: path too long: %s/%s\n", PROJECT_NAME,
                     dirpath, name);
-      (void)free(namelist[i]);
       continue;
     }
 
@@ -445,11 +1003,33 @@ static int load_config_from_dir(const struct syscall_ops *ops, config_t *config,
                     PROJECT_NAME, filepath);
     }
 
-    (void)parse_config_file(ops, filepath, config, debug);
-    (void)free(namelist[i]);
+    /*
+     * filter_conf_name() kept only plain names, so this cannot leave the
+     * directory; symlinks to files are followed and checked like any
+     * other configuration file
+     */
+    int fd = ops->openat(dirfd, name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      if (errno != ENOENT) {
+        (void)fprintf(stderr, "%s: error: cannot open %s: %s\n",
+                      PROJECT_NAME, filepath, strerror(errno));
+      } else if (debug) {
+        /* Removed since the directory was read */
+        (void)fprintf(stderr, "%s: debug: config file does not exist: %s\n",
+                      PROJECT_NAME, filepath);
+      }
+      continue;
+    }
+
+    fd = check_config_fd(ops, fd, filepath);
+    if (fd >= 0) {
+      parse_config_fd(ops, fd, filepath, table, debug);
+    }
   }
 
-  (void)free(namelist);
+  ops->free(sorted);
+  ops->free(names.buf);
+  (void)ops->close(dirfd);
   return 0;
 }
 
@@ -480,6 +1060,7 @@ void config_factory(config_t *config) {
   config->subuid.max_val = 600100000;
   config->subuid.key_count = "SUB_UID_COUNT";
   config->subuid.count_val = 65536;
+  config->subuid.key_bands = "SUB_UID_BANDS";
 
   config->subgid.type = SUBGID;
   config->subgid.key_min = "SUB_GID_MIN";
@@ -488,11 +1069,20 @@ void config_factory(config_t *config) {
   config->subgid.max_val = 600100000;
   config->subgid.key_count = "SUB_GID_COUNT";
   config->subgid.count_val = 65536;
+  config->subgid.key_bands = "SUB_GID_BANDS";
 
   config->key_skip_if_exists = "SKIP_IF_EXISTS";
   config->skip_if_exists = true;
   config->key_allow_subid_wrap = "ALLOW_SUBID_WRAP";
   config->allow_subid_wrap = false;
+  config->key_subid_backend = "SUBID_BACKEND";
+  config->subid_backend = SUBID_BACKEND_GETSUBIDS;
+  config->key_subid_writer = "SUBID_WRITER";
+  config->subid_writer = SUBID_WRITER_USERMOD;
+  config->key_skip_if_exact = "SKIP_IF_EXACT";
+  config->skip_if_exact = false;
+  config->key_resolve_timeout_ms = "RESOLVE_TIMEOUT_MS";
+  config->resolve_timeout_ms = 0;
 }
 
 /**
@@ -511,6 +1101,10 @@ void config_factory(config_t *config) {
  * Missing files are silently skipped. Configuration files must be
  * owned by root and not world-writable.
  *
+ * Once everything is read the UID bands are checked and their segment
+ * tables built. Bands that overlap or leave the UID range would make the
+ * ranges ambiguous, so they fail the whole load instead of being ignored.
+ *
  * Return: 0 on success, -1 on error
  */
 int load_configuration(const struct syscall_ops *ops, config_t *config,
@@ -535,20 +1129,56 @@ int load_configuration(const struct syscall_ops *ops, config_t *config,
     print_configuration(config, stderr, PROJECT_NAME ": debug: ");
   }
 
+  /* Index the keys once for every file below */
+  config_key_table_t table = {0};
+  build_config_key_table(config, &table);
+
   /* Load from login.defs */
-  (void)parse_config_file(ops, LOGIN_DEFS_PATH, config, debug);
+  (void)parse_config_file(ops, LOGIN_DEFS_PATH, &table, debug);
 
   /* Override with main config file */
-  (void)parse_config_file(ops, CONFIG_FILE_PATH, config, debug);
+  (void)parse_config_file(ops, CONFIG_FILE_PATH, &table, debug);
 
   /* Override with drop-in configs */
-  if (load_config_from_dir(ops, config, CONFIG_DROPIN_DIR_PATH, debug) != 0) {
+  if (load_config_from_dir(ops, &table, CONFIG_DROPIN_DIR_PATH, debug) != 0) {
     return -1;
   }
 
+  /* UID bands, now that UID_MIN and UID_MAX are final */
+  subid_config_t *const sections[] = {&config->subuid, &config->subgid};
+  for (size_t i = 0; i < sizeof(sections) / sizeof(sections[0]); i++) {
+    if (validate_subid_bands(config, sections[i]) != 0) {
+      return -1;
+    }
+    subid_segments_build(sections[i], config->uid_min);
+  }
+
   return 0;
 }
 
+/**
+ * print_bands - Print the bands of one subordinate ID type
+ * @subid_cfg: Subordinate ID configuration
+ * @out: FILE stream to print to
+ * @prefix: String prepended to the line
+ *
+ * Printed in the syntax the key takes, so the line can be pasted back.
+ */
+static void print_bands(const subid_config_t *subid_cfg, FILE *out,
+                        const char *prefix) {
+  (void)fprintf(out, "%s  %s:\t", prefix, subid_cfg->key_bands);
+  if (subid_cfg->band_count == 0) {
+    (void)fprintf(out, "none\n");
+    return;
+  }
+  for (size_t i = 0; i < subid_cfg->band_count; i++) {
+    (void)fprintf(out, "%s%u-%u:%u", i > 0 ? "," : "",
+                  subid_cfg->bands[i].uid_lo, subid_cfg->bands[i].uid_hi,
+                  subid_cfg->bands[i].count);
+  }
+  (void)fprintf(out, "\n");
+}
+
 /**
  * print_configuration - Print parsed configuration to output stream
  * @config: Configuration to print
@@ -584,14 +1214,27 @@ void print_configuration(const config_t *config, FILE *out,
                 config->subuid.max_val);
   (void)fprintf(out, "%s  %s:\t%u\n", p, config->subuid.key_count,
                 config->subuid.count_val);
+  print_bands(&config->subuid, out, p);
   (void)fprintf(out, "%s  %s:\t\t%u\n", p, config->subgid.key_min,
                 config->subgid.min_val);
   (void)fprintf(out, "%s  %s:\t\t%u\n", p, config->subgid.key_max,
                 config->subgid.max_val);
   (void)fprintf(out, "%s  %s:\t%u\n", p, config->subgid.key_count,
                 config->subgid.count_val);
+  print_bands(&config->subgid, out, p);
   (void)fprintf(out, "%s  %s:\t%s\n", p, config->key_skip_if_exists,
                 config->skip_if_exists ? "yes" : "no");
   (void)fprintf(out, "%s  %s:\t%s\n", p, config->key_allow_subid_wrap,
                 config->allow_subid_wrap ? "yes" : "no");
+  (void)fprintf(out, "%s  %s:\t%s\n", p, config->key_skip_if_exact,
+                config->skip_if_exact ? "yes" : "no");
+  (void)fprintf(out, "%s  %s:\t%s\n", p, config->key_subid_backend,
+                config->subid_backend == SUBID_BACKEND_FILES ? "files"
+                                                             : "getsubids");
+  (void)fprintf(out, "%s  %s:\t%s\n", p, config->key_subid_writer,
+                config->subid_writer == SUBID_WRITER_SPOOL   ? "spool"
+                : config->subid_writer == SUBID_WRITER_FILES ? "files"
+                                                             : "usermod");
+  (void)fprintf(out, "%s  %s:\t%u\n", p, config->key_resolve_timeout_ms,
+                config->resolve_timeout_ms);
 }
@@ -0,0 +1,360 @@
+/**
+ * config_cache.c - Binary snapshot of the resolved configuration
+ *
+ * load_configuration() line-parses all of login.defs, the main config file
+ * and every drop-in on each run. The resolved values are small and fixed,
+ * so they are kept in <dir>/config.cache (dir is STAMP_DIR) keyed on the
+ * stamp_fingerprint() of those same sources; while the key matches, the
+ * files are not opened at all.
+ *
+ * The snapshot holds values only. The key names in config_t are string
+ * literals and always come from config_factory().
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* File name of the snapshot inside the cache directory */
+#define CONFIG_CACHE_NAME "config.cache"
+
+/* "SSCF" little-endian, then the layout version of struct config_snapshot */
+enum { SNAPSHOT_MAGIC = 0x46435353, SNAPSHOT_VERSION = 3 };
+
+/**
+ * struct config_snapshot - On-disk layout of the cache
+ * @magic: SNAPSHOT_MAGIC
+ * @version: SNAPSHOT_VERSION
+ * @fingerprint: stamp_fingerprint() the values were loaded under
+ * @uid_min: config_t.uid_min
+ * @uid_max: config_t.uid_max
+ * @subuid_min: config_t.subuid.min_val
+ * @subuid_max: config_t.subuid.max_val
+ * @subuid_count: config_t.subuid.count_val
+ * @subgid_min: config_t.subgid.min_val
+ * @subgid_max: config_t.subgid.max_val
+ * @subgid_count: config_t.subgid.count_val
+ * @skip_if_exists: config_t.skip_if_exists
+ * @allow_subid_wrap: config_t.allow_subid_wrap
+ * @skip_if_exact: config_t.skip_if_exact
+ * @subid_backend: config_t.subid_backend
+ * @subid_writer: config_t.subid_writer
+ * @resolve_timeout_ms: config_t.resolve_timeout_ms
+ * @subuid_band_count: config_t.subuid.band_count
+ * @subuid_bands: config_t.subuid.bands
+ * @subgid_band_count: config_t.subgid.band_count
+ * @subgid_bands: config_t.subgid.bands
+ * @checksum: hash_fnv1a() of everything before it
+ *
+ * Written in host byte order; it never leaves the machine. The segment
+ * tables are not stored, they are rebuilt from the bands on a hit.
+ */
+struct config_snapshot {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t fingerprint;
+  uint32_t uid_min;
+  uint32_t uid_max;
+  uint32_t subuid_min;
+  uint32_t subuid_max;
+  uint32_t subuid_count;
+  uint32_t subgid_min;
+  uint32_t subgid_max;
+  uint32_t subgid_count;
+  uint32_t skip_if_exists;
+  uint32_t allow_subid_wrap;
+  uint32_t skip_if_exact;
+  uint32_t subid_backend;
+  uint32_t subid_writer;
+  uint32_t resolve_timeout_ms;
+  uint32_t subuid_band_count;
+  subid_band_t subuid_bands[SUBID_BANDS_MAX];
+  uint32_t subgid_band_count;
+  subid_band_t subgid_bands[SUBID_BANDS_MAX];
+  uint64_t checksum;
+};
+
+_Static_assert(sizeof(struct config_snapshot) == 472,
+               "config_snapshot must not contain padding");
+
+/*
+ * Forward declarations for internal functions
+ *
+ * We can use nonnull on static functions because they can only be called
+ * from inside here and we're careful to check the pointers in our visible
+ * function(s).
+ */
+static int cache_path(char *out, size_t size, const char *dir, bool tmp)
+    __attribute__((nonnull(1, 3))) __attribute__((warn_unused_result));
+static uint64_t snapshot_checksum(const struct config_snapshot *snap)
+    __attribute__((nonnull(1))) __attribute__((warn_unused_result));
+static int snapshot_valid(const struct config_snapshot *snap,
+                          uint64_t fingerprint) __attribute__((nonnull(1)))
+__attribute__((warn_unused_result));
+
+/**
+ * cache_path - Build the snapshot path
+ * @out: Output buffer
+ * @size: Size of @out
+ * @dir: Cache directory
+ * @tmp: Build this process's temporary name used while writing instead
+ *
+ * Return: 0 on success, -1 if the path does not fit
+ */
+static int cache_path(char *out, size_t size, const char *dir, bool tmp) {
+  int len = tmp ? snprintf(out, size, "%s/%s.%ld.tmp", dir, CONFIG_CACHE_NAME,
+                           (long)getpid())
+                : snprintf(out, size, "%s/%s", dir, CONFIG_CACHE_NAME);
+  if (len < 0 || (size_t)len >= size) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * snapshot_checksum - Checksum a snapshot
+ * @snap: Snapshot
+ *
+ * Return: FNV-1a hash of every field before @snap->checksum
+ */
+static uint64_t snapshot_checksum(const struct config_snapshot *snap) {
+  return hash_fnv1a(snap, offsetof(struct config_snapshot, checksum),
+                    FNV1A_64_INIT);
+}
+
+/**
+ * snapshot_valid - Check a snapshot read from disk
+ * @snap: Snapshot
+ * @fingerprint: Current stamp_fingerprint()
+ *
+ * Return: 1 if @snap is intact and current, 0 otherwise
+ */
+static int snapshot_valid(const struct config_snapshot *snap,
+                          uint64_t fingerprint) {
+  return snap->magic == SNAPSHOT_MAGIC && snap->version == SNAPSHOT_VERSION &&
+         snap->fingerprint == fingerprint &&
+         snap->checksum == snapshot_checksum(snap) &&
+         snap->skip_if_exists <= 1 && snap->allow_subid_wrap <= 1 &&
+         snap->skip_if_exact <= 1 &&
+         snap->subid_backend <= SUBID_BACKEND_FILES &&
+         snap->subid_writer <= SUBID_WRITER_SPOOL &&
+         snap->subuid_band_count <= SUBID_BANDS_MAX &&
+         snap->subgid_band_count <= SUBID_BANDS_MAX;
+}
+
+/**
+ * config_cache_load - Restore the configuration from the snapshot
+ * @ops: Operations structure for system call abstraction
+ * @dir: Cache directory (STAMP_DIR)
+ * @fingerprint: Current stamp_fingerprint()
+ * @config: Set to the cached configuration on a hit
+ * @debug: Enable debug output
+ *
+ * The snapshot must pass the same checks safe_open_config() applies to
+ * configuration files: a regular file owned by root and not
+ * world-writable. Anything else, or a snapshot taken under another
+ * fingerprint, is a miss and @config is left untouched.
+ *
+ * Return: 1 on a hit, 0 on a miss (including errors)
+ */
+int config_cache_load(const struct syscall_ops *ops, const char *dir,
+                      uint64_t fingerprint, config_t *config, bool debug) {
+  if (ops == NULL || dir == NULL || config == NULL) {
+    return 0;
+  }
+
+  char path[PATH_MAX] = {0};
+  if (cache_path(path, sizeof(path), dir, false) != 0) {
+    return 0;
+  }
+
+  int fd = ops->open(path, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+  if (fd < 0) {
+    if (debug) {
+      (void)fprintf(stderr, "%s: debug: no config snapshot %s: %s\n",
+                    PROJECT_NAME, path, strerror(errno));
+    }
+    return 0;
+  }
+
+  struct stat st = {0};
+  struct config_snapshot snap = {0};
+  ssize_t len = -1;
+  if (ops->fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_uid == 0 &&
+      (st.st_mode & S_IWOTH) == 0) {
+    len = ops->read(fd, &snap, sizeof(snap));
+  } else if (debug) {
+    (void)fprintf(stderr, "%s: debug: ignoring untrusted config snapshot %s\n",
+                  PROJECT_NAME, path);
+  }
+  (void)ops->close(fd);
+
+  if (len != (ssize_t)sizeof(snap) || snapshot_valid(&snap, fingerprint) == 0) {
+    if (debug && len >= 0) {
+      (void)fprintf(stderr, "%s: debug: config snapshot %s is out of date\n",
+                    PROJECT_NAME, path);
+    }
+    return 0;
+  }
+
+  config_t loaded = {0};
+  config_factory(&loaded);
+  loaded.uid_min = snap.uid_min;
+  loaded.uid_max = snap.uid_max;
+  loaded.subuid.min_val = snap.subuid_min;
+  loaded.subuid.max_val = snap.subuid_max;
+  loaded.subuid.count_val = snap.subuid_count;
+  loaded.subgid.min_val = snap.subgid_min;
+  loaded.subgid.max_val = snap.subgid_max;
+  loaded.subgid.count_val = snap.subgid_count;
+  loaded.skip_if_exists = snap.skip_if_exists != 0;
+  loaded.allow_subid_wrap = snap.allow_subid_wrap != 0;
+  loaded.skip_if_exact = snap.skip_if_exact != 0;
+  loaded.subid_backend = (subid_backend_t)snap.subid_backend;
+  loaded.subid_writer = (subid_writer_t)snap.subid_writer;
+  loaded.resolve_timeout_ms = snap.resolve_timeout_ms;
+  loaded.subuid.band_count = snap.subuid_band_count;
+  (void)memcpy(loaded.subuid.bands, snap.subuid_bands,
+               sizeof(snap.subuid_bands));
+  loaded.subgid.band_count = snap.subgid_band_count;
+  (void)memcpy(loaded.subgid.bands, snap.subgid_bands,
+               sizeof(snap.subgid_bands));
+
+  /* Segment tables are rebuilt as load_configuration() builds them; bands
+   * it would reject make a miss */
+  if (validate_subid_bands(&loaded, &loaded.subuid) != 0 ||
+      validate_subid_bands(&loaded, &loaded.subgid) != 0) {
+    return 0;
+  }
+  subid_segments_build(&loaded.subuid, loaded.uid_min);
+  subid_segments_build(&loaded.subgid, loaded.uid_min);
+
+  *config = loaded;
+
+  if (debug) {
+    (void)fprintf(stderr, "%s: debug: using config snapshot %s\n",
+                  PROJECT_NAME, path);
+  }
+  return 1;
+}
+
+/**
+ * config_cache_store - Save a freshly loaded configuration
+ * @ops: Operations structure for system call abstraction
+ * @dir: Cache directory (STAMP_DIR), created if missing
+ * @fingerprint: stamp_fingerprint() taken before @config was loaded
+ * @config: Configuration returned by load_configuration()
+ * @debug: Enable debug output
+ *
+ * Written to a temporary name of this process's own and renamed into
+ * place, so parallel runs storing at once never share a file. The
+ * snapshot is an optimisation only, so failures (an unprivileged caller
+ * cannot create @dir) are reported under @debug alone. A fingerprint
+ * taken before the load can only make a racing edit miss the next time,
+ * never hide it.
+ *
+ * Return: 0 on success, -1 on error
+ */
+int config_cache_store(const struct syscall_ops *ops, const char *dir,
+                       uint64_t fingerprint, const config_t *config,
+                       bool debug) {
+  if (ops == NULL || dir == NULL || config == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  char path[PATH_MAX] = {0};
+  char tmppath[PATH_MAX] = {0};
+  if (cache_path(path, sizeof(path), dir, false) != 0 ||
+      cache_path(tmppath, sizeof(tmppath), dir, true) != 0) {
+    return -1;
+  }
+
+  struct config_snapshot snap = {
+      .magic = SNAPSHOT_MAGIC,
+      .version = SNAPSHOT_VERSION,
+      .fingerprint = fingerprint,
+      .uid_min = config->uid_min,
+      .uid_max = config->uid_max,
+      .subuid_min = config->subuid.min_val,
+      .subuid_max = config->subuid.max_val,
+      .subuid_count = config->subuid.count_val,
+      .subgid_min = config->subgid.min_val,
+      .subgid_max = config->subgid.max_val,
+      .subgid_count = config->subgid.count_val,
+      .skip_if_exists = config->skip_if_exists ? 1U : 0U,
+      .allow_subid_wrap = config->allow_subid_wrap ? 1U : 0U,
+      .skip_if_exact = config->skip_if_exact ? 1U : 0U,
+      .subid_backend = (uint32_t)config->subid_backend,
+      .subid_writer = (uint32_t)config->subid_writer,
+      .resolve_timeout_ms = config->resolve_timeout_ms,
+      .subuid_band_count = (uint32_t)config->subuid.band_count,
+      .subgid_band_count = (uint32_t)config->subgid.band_count,
+      .checksum = 0,
+  };
+  (void)memcpy(snap.subuid_bands, config->subuid.bands,
+               sizeof(snap.subuid_bands));
+  (void)memcpy(snap.subgid_bands, config->subgid.bands,
+               sizeof(snap.subgid_bands));
+  snap.checksum = snapshot_checksum(&snap);
+
+  if (ops->mkdir(dir, 0755) != 0 && errno != EEXIST) {
+    if (debug) {
+      (void)fprintf(stderr, "%s: debug: cannot create %s: %s\n", PROJECT_NAME,
+                    dir, strerror(errno));
+    }
+    return -1;
+  }
+
+  int flags = O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC | O_NOFOLLOW;
+  int fd = ops->open(tmppath, flags, 0644);
+  if (fd < 0 && errno == EEXIST) {
+    /* Left behind by a crashed run whose PID we now have */
+    (void)ops->unlink(tmppath);
+    fd = ops->open(tmppath, flags, 0644);
+  }
+  if (fd < 0) {
+    if (debug) {
+      (void)fprintf(stderr, "%s: debug: cannot create %s: %s\n", PROJECT_NAME,
+                    tmppath, strerror(errno));
+    }
+    return -1;
+  }
+
+  ssize_t written = ops->write(fd, &snap, sizeof(snap));
+  if (written == (ssize_t)sizeof(snap) && ops->fsync(fd) != 0) {
+    written = -1;
+  }
+  int close_ret = ops->close(fd);
+  if (written != (ssize_t)sizeof(snap) || close_ret != 0 ||
+      ops->rename(tmppath, path) != 0) {
+    int saved_errno = errno;
+    (void)ops->unlink(tmppath);
+    if (debug) {
+      (void)fprintf(stderr, "%s: debug: cannot write %s: %s\n", PROJECT_NAME,
+                    path, strerror(saved_errno));
+    }
+    errno = saved_errno;
+    return -1;
+  }
+
+  if (debug) {
+    (void)fprintf(stderr, "%s: debug: wrote config snapshot %s\n",
+                  PROJECT_NAME, path);
+  }
+  return 0;
+}
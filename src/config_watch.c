@@ -0,0 +1,282 @@
+/**
+ * config_watch.c - inotify watches on the configuration sources
+ *
+ * The daemon keeps one parsed configuration for its whole life and needs
+ * to know when login.defs, the main config file or a drop-in changes.
+ * Files are usually replaced by rename(2) rather than rewritten, which
+ * drops a watch on the file itself, so the directory holding each file is
+ * watched and events are filtered by name. The drop-in directory is
+ * watched as a whole, and its parent catches it being created or removed.
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+/* Slots of config_watch_t.wd and config_watch_t.name */
+enum {
+  WATCH_LOGIN_DEFS,
+  WATCH_CONFIG_FILE,
+  WATCH_DROPIN_PARENT,
+  WATCH_DROPIN
+};
+
+/* Anything that can change what load_configuration() would read */
+#define WATCH_MASK                                                             \
+  (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE |     \
+   IN_ATTRIB)
+
+/* Drained per read(2); holds many events of the longest name */
+enum { WATCH_BUF_SIZE = 4096 };
+
+_Static_assert(CONFIG_WATCH_MAX == WATCH_DROPIN + 1,
+               "CONFIG_WATCH_MAX must cover every watch slot");
+
+/*
+ * Forward declarations for internal functions
+ *
+ * We can use nonnull on static functions because they can only be called
+ * from inside here and we're careful to check the pointers in our visible
+ * function(s).
+ */
+static int watch_parent(config_watch_t *watch, size_t slot, const char *path,
+                        bool debug) __attribute__((nonnull(1, 3)))
+__attribute__((warn_unused_result));
+static void watch_dropin(config_watch_t *watch, bool debug)
+    __attribute__((nonnull(1)));
+static bool event_matches(const config_watch_t *watch,
+                          const struct inotify_event *ev, bool debug)
+    __attribute__((nonnull(1, 2))) __attribute__((warn_unused_result));
+
+/**
+ * watch_parent - Watch the directory holding @path for changes to it
+ * @watch: Watch set
+ * @slot: Slot to record the watch in
+ * @path: Absolute path of the file or directory of interest
+ * @debug: Enable debug output
+ *
+ * Return: 0 on success, -1 if the directory cannot be watched
+ */
+static int watch_parent(config_watch_t *watch, size_t slot, const char *path,
+                        bool debug) {
+  const char *slash = strrchr(path, '/');
+  char dir[PATH_MAX] = {0};
+  size_t len = slash == NULL ? 0 : (size_t)(slash - path);
+
+  if (slash == NULL || slash[1] == '\0' || len >= sizeof(dir)) {
+    errno = EINVAL;
+    return -1;
+  }
+  (void)memcpy(dir, path, len);
+  dir[len] = '\0';
+  if (len == 0) {
+    dir[0] = '/';
+  }
+
+  watch->name[slot] = slash + 1;
+  watch->wd[slot] = inotify_add_watch(watch->fd, dir, WATCH_MASK);
+  if (watch->wd[slot] < 0) {
+    if (debug) {
+      (void)fprintf(stderr, "%s: debug: cannot watch %s: %s\n", PROJECT_NAME,
+                    dir, strerror(errno));
+    }
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * watch_dropin - (Re)add the watch on the drop-in directory
+ * @watch: Watch set
+ * @debug: Enable debug output
+ *
+ * A missing directory is not an error: its parent is watched and this is
+ * called again when it appears.
+ */
+static void watch_dropin(config_watch_t *watch, bool debug) {
+  watch->name[WATCH_DROPIN] = NULL;
+  watch->wd[WATCH_DROPIN] = inotify_add_watch(
+      watch->fd, watch->dropin_dir, WATCH_MASK | IN_ONLYDIR);
+  if (watch->wd[WATCH_DROPIN] < 0 && debug) {
+    (void)fprintf(stderr, "%s: debug: not watching %s: %s\n", PROJECT_NAME,
+                  watch->dropin_dir, strerror(errno));
+  }
+}
+
+/**
+ * event_matches - Whether an event concerns a configuration source
+ * @watch: Watch set
+ * @ev: Event read from the inotify descriptor
+ * @debug: Enable debug output
+ *
+ * Return: true if the configuration may have changed
+ */
+static bool event_matches(const config_watch_t *watch,
+                          const struct inotify_event *ev, bool debug) {
+  for (size_t i = 0; i < CONFIG_WATCH_MAX; i++) {
+    if (watch->wd[i] < 0 || ev->wd != watch->wd[i]) {
+      continue;
+    }
+    if (watch->name[i] == NULL ||
+        (ev->len > 0 && strcmp(ev->name, watch->name[i]) == 0)) {
+      if (debug) {
+        (void)fprintf(stderr, "%s: debug: configuration source changed: %s\n",
+                      PROJECT_NAME,
+                      ev->len > 0 ? ev->name : watch->dropin_dir);
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * config_watch_open - Start watching the configuration sources
+ * @watch: Watch set to initialize
+ * @login_defs: Path of login.defs (LOGIN_DEFS_PATH)
+ * @config_file: Path of the main config file (CONFIG_FILE_PATH)
+ * @dropin_dir: Path of the drop-in directory (CONFIG_DROPIN_DIR_PATH)
+ * @debug: Enable debug output
+ *
+ * The paths are referenced, not copied. Without a watch on every
+ * directory that can hold a source the set would miss changes, so that is
+ * an error; config_watch_close() is always safe afterwards.
+ *
+ * Return: 0 on success, -1 on error
+ */
+int config_watch_open(config_watch_t *watch, const char *login_defs,
+                      const char *config_file, const char *dropin_dir,
+                      bool debug) {
+  if (watch == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  watch->fd = -1;
+  for (size_t i = 0; i < CONFIG_WATCH_MAX; i++) {
+    watch->wd[i] = -1;
+    watch->name[i] = NULL;
+  }
+  watch->dropin_dir = dropin_dir;
+
+  if (login_defs == NULL || config_file == NULL || dropin_dir == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (watch->fd < 0) {
+    (void)fprintf(stderr, "%s: warning: inotify unavailable: %s\n",
+                  PROJECT_NAME, strerror(errno));
+    return -1;
+  }
+
+  if (watch_parent(watch, WATCH_LOGIN_DEFS, login_defs, debug) != 0 ||
+      watch_parent(watch, WATCH_CONFIG_FILE, config_file, debug) != 0 ||
+      watch_parent(watch, WATCH_DROPIN_PARENT, dropin_dir, debug) != 0) {
+    int saved_errno = errno;
+    config_watch_close(watch);
+    errno = saved_errno;
+    return -1;
+  }
+  watch_dropin(watch, debug);
+
+  return 0;
+}
+
+/**
+ * config_watch_changed - Drain pending events
+ * @watch: Watch set from config_watch_open()
+ * @debug: Enable debug output
+ *
+ * Reads every queued event, so a burst of writes from one edit is
+ * reported once. A drop-in directory that appears is picked up here.
+ *
+ * Return: 1 if a source may have changed, 0 if not, -1 on error
+ */
+int config_watch_changed(config_watch_t *watch, bool debug) {
+  if (watch == NULL || watch->fd < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  char buf[WATCH_BUF_SIZE]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+  bool changed = false;
+
+  for (;;) {
+    ssize_t n = read(watch->fd, buf, sizeof(buf));
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN) {
+        break;
+      }
+      // LCOV_EXCL_START
+      (void)fprintf(stderr, "%s: error: cannot read inotify events: %s\n",
+                    PROJECT_NAME, strerror(errno));
+      return -1;
+      // LCOV_EXCL_STOP
+    }
+
+    for (size_t off = 0; off + sizeof(struct inotify_event) <= (size_t)n;) {
+      const struct inotify_event *ev =
+          (const struct inotify_event *)(const void *)(buf + off);
+      off += sizeof(*ev) + ev->len;
+
+      if (event_matches(watch, ev, debug)) {
+        changed = true;
+      }
+      if (ev->mask & IN_IGNORED && ev->wd == watch->wd[WATCH_DROPIN]) {
+        /* Drop-in directory removed or renamed away */
+        watch->wd[WATCH_DROPIN] = -1;
+        changed = true;
+      }
+      if (ev->wd == watch->wd[WATCH_DROPIN_PARENT] &&
+          watch->wd[WATCH_DROPIN] < 0 && ev->len > 0 &&
+          strcmp(ev->name, watch->name[WATCH_DROPIN_PARENT]) == 0) {
+        watch_dropin(watch, debug);
+      }
+    }
+  }
+
+  return changed ? 1 : 0;
+}
+
+/**
+ * config_watch_fd - Descriptor to poll(2) for POLLIN
+ * @watch: Watch set
+ *
+ * Return: The inotify descriptor, -1 if @watch is not open
+ */
+int config_watch_fd(const config_watch_t *watch) {
+  return watch == NULL ? -1 : watch->fd;
+}
+
+/**
+ * config_watch_close - Stop watching
+ * @watch: Watch set, may be closed already
+ */
+void config_watch_close(config_watch_t *watch) {
+  if (watch == NULL) {
+    return;
+  }
+  if (watch->fd >= 0) {
+    (void)close(watch->fd);
+  }
+  watch->fd = -1;
+  for (size_t i = 0; i < CONFIG_WATCH_MAX; i++) {
+    watch->wd[i] = -1;
+  }
+}
@@ -0,0 +1,666 @@
+/**
+ * daemon.c - Long-lived assignment service on a unix socket
+ *
+ * Without the daemon every login runs systemctl, a polkit check, a oneshot
+ * unit and a fresh process that parses the configuration again. With
+ * --daemon one process keeps the parsed config_t in memory and serves
+ * "ensure my ranges" requests on DAEMON_SOCKET_PATH. The caller is
+ * identified by SO_PEERCRED, so a user can only ever ask for their own
+ * UID and no polkit rule is involved.
+ *
+ * The protocol is one line each way:
+ *
+ *   client: "ensure\n"
+ *   daemon: "ok\n" once the ranges are in place, or "error <reason>\n"
+ *
+ * Requests are served one at a time; the databases are rewritten under
+ * the shadow-utils lock anyway, so there is nothing to gain from
+ * parallelism and a queue keeps memory bounded under a login burst.
+ * Anyone may connect, so a client gets DAEMON_REQUEST_TIMEOUT_MS in all
+ * to send its request and is dropped after that: a peer dribbling bytes
+ * or connecting idle cannot hold up the logins queued behind it.
+ * A request is already queued once it is written, so a client may stop
+ * waiting for the reply at any point and the ranges are still committed.
+ *
+ * Configuration changes are picked up through config_watch.c between
+ * requests: a new config_t is loaded next to the active one and replaces
+ * it only once it loaded cleanly, so a request never sees a mixture.
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/* Only request understood by the daemon */
+#define DAEMON_REQUEST_ENSURE "ensure"
+
+/* Reply prefixes */
+#define DAEMON_REPLY_OK "ok"
+#define DAEMON_REPLY_ERROR "error"
+
+/* First descriptor passed by systemd socket activation (sd_listen_fds(3)) */
+enum { LISTEN_FDS_START = 3 };
+
+/* Longest request or reply line and a stalled peer's allowance per I/O */
+enum { DAEMON_MSG_MAX = 256, DAEMON_IO_TIMEOUT_SEC = 5 };
+
+/* Time a client has from being accepted to sending its whole request */
+enum { DAEMON_REQUEST_TIMEOUT_MS = 1000 };
+
+/*
+ * Forward declarations for internal functions
+ *
+ * We can use nonnull on static functions because they can only be called
+ * from inside here and we're careful to check the pointers in our visible
+ * function(s).
+ */
+static int activated_fd(bool debug) __attribute__((warn_unused_result));
+static int read_line(const struct syscall_ops *ops, int fd, char *buf,
+                     size_t size, uint64_t deadline)
+    __attribute__((nonnull(1, 3))) __attribute__((warn_unused_result));
+static int send_reply(const struct syscall_ops *ops, int fd, int error)
+    __attribute__((nonnull(1)));
+static void set_send_timeout(int fd, int seconds);
+static void refresh_config(const struct syscall_ops *ops, config_t *config,
+                           uint64_t *fingerprint, bool *have_fingerprint,
+                           bool debug) __attribute__((nonnull(1, 2, 3, 4)));
+
+/**
+ * activated_fd - Take the listening socket handed over by systemd
+ * @debug: Enable debug output
+ *
+ * Implements the LISTEN_PID/LISTEN_FDS side of sd_listen_fds(3) without
+ * linking libsystemd. The variables are removed so spawned helpers do not
+ * see them.
+ *
+ * Return: The socket, or -1 if the process was not socket activated
+ */
+static int activated_fd(bool debug) {
+  const char *pid_str = getenv("LISTEN_PID");
+  const char *fds_str = getenv("LISTEN_FDS");
+  uint32_t pid = 0;
+  uint32_t fds = 0;
+
+  if (pid_str == NULL || fds_str == NULL ||
+      parse_uint32_strict(pid_str, &pid) != 0 ||
+      parse_uint32_strict(fds_str, &fds) != 0 || pid != (uint32_t)getpid()) {
+    return -1;
+  }
+
+  (void)unsetenv("LISTEN_PID");
+  (void)unsetenv("LISTEN_FDS");
+  (void)unsetenv("LISTEN_FDNAMES");
+
+  struct stat st = {0};
+  if (fds != 1 || fstat(LISTEN_FDS_START, &st) != 0 || !S_ISSOCK(st.st_mode)) {
+    (void)fprintf(stderr,
+                  "%s: error: expected exactly one listening socket from "
+                  "systemd, got %u\n",
+                  PROJECT_NAME, fds);
+    return -1;
+  }
+
+  (void)fcntl(LISTEN_FDS_START, F_SETFD, FD_CLOEXEC);
+  if (debug) {
+    (void)fprintf(stderr, "%s: debug: using socket passed by systemd\n",
+                  PROJECT_NAME);
+  }
+  return LISTEN_FDS_START;
+}
+
+/**
+ * daemon_listen - Get the socket to serve requests on
+ * @path: Socket path to bind when not socket activated
+ * @activated: Set to whether the socket came from systemd
+ * @debug: Enable debug output
+ *
+ * Under systemd the socket unit owns @path and passes the socket in.
+ * Started by hand, @path is (re)created with mode 0666: every user may
+ * connect, SO_PEERCRED decides what they get.
+ *
+ * Return: Listening socket on success, -1 on error
+ */
+int daemon_listen(const char *path, bool *activated, bool debug) {
+  if (path == NULL || activated == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: NULL parameter in daemon_listen\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  int fd = activated_fd(debug);
+  *activated = fd >= 0;
+  if (fd >= 0) {
+    return fd;
+  }
+
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    errno = ENAMETOOLONG;
+    (void)fprintf(stderr, "%s: error: socket path %s is too long\n",
+                  PROJECT_NAME, path);
+    return -1;
+  }
+  (void)memcpy(addr.sun_path, path, strlen(path) + 1);
+
+  fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  // LCOV_EXCL_START
+  if (fd < 0) {
+    (void)fprintf(stderr, "%s: error: cannot create socket: %s\n",
+                  PROJECT_NAME, strerror(errno));
+    return -1;
+  }
+  // LCOV_EXCL_STOP
+
+  /* A socket left behind by a previous instance would make bind() fail */
+  (void)unlink(path);
+  if (bind(fd, (const struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      chmod(path, 0666) != 0 || listen(fd, SOMAXCONN) != 0) {
+    int saved_errno = errno;
+    (void)fprintf(stderr, "%s: error: cannot listen on %s: %s\n",
+                  PROJECT_NAME, path, strerror(saved_errno));
+    (void)close(fd);
+    errno = saved_errno;
+    return -1;
+  }
+
+  if (debug) {
+    (void)fprintf(stderr, "%s: debug: listening on %s\n", PROJECT_NAME, path);
+  }
+  return fd;
+}
+
+/**
+ * read_line - Read one newline-terminated line from a socket
+ * @ops: Operations structure for system call abstraction
+ * @fd: Connected socket
+ * @buf: Output buffer, NUL-terminated without the newline on success
+ * @size: Size of @buf
+ * @deadline: stats_now() by which the whole line must have arrived
+ *
+ * The deadline covers the line, not each read, so a peer sending a byte
+ * at a time gets no longer than one sending it all at once. Each side
+ * sends a single line, so anything after the newline is discarded.
+ *
+ * Return: 0 on success, -1 on error, end of stream, an overlong line or
+ *         when @deadline passed (errno ETIMEDOUT)
+ */
+static int read_line(const struct syscall_ops *ops, int fd, char *buf,
+                     size_t size, uint64_t deadline) {
+  size_t len = 0;
+
+  while (len + 1 < size) {
+    uint64_t now = stats_now();
+    if (now >= deadline) {
+      errno = ETIMEDOUT;
+      return -1;
+    }
+
+    struct pollfd pfd = {.fd = fd, .events = POLLIN, .revents = 0};
+    int ready = poll(&pfd, 1, (int)((deadline - now + 999) / 1000));
+    if (ready < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ready <= 0) {
+      /* Nothing yet: the deadline check above decides */
+      if (ready == 0) {
+        continue;
+      }
+      return -1; // LCOV_EXCL_LINE
+    }
+
+    ssize_t n = ops->read(fd, buf + len, size - 1 - len);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      if (n == 0) {
+        errno = ECONNRESET;
+      }
+      return -1;
+    }
+
+    char *newline = memchr(buf + len, '\n', (size_t)n);
+    if (newline != NULL) {
+      *newline = '\0';
+      return 0;
+    }
+    len += (size_t)n;
+  }
+
+  errno = EMSGSIZE;
+  return -1;
+}
+
+/**
+ * send_reply - Tell the peer how its request went
+ * @ops: Operations structure for system call abstraction
+ * @fd: Connected socket
+ * @error: 0 for success, otherwise the errno describing the failure
+ *
+ * Return: 0 on success, -1 if the reply could not be written
+ */
+static int send_reply(const struct syscall_ops *ops, int fd, int error) {
+  char reply[DAEMON_MSG_MAX] = {0};
+  int len = error == 0 ? snprintf(reply, sizeof(reply), "%s\n", DAEMON_REPLY_OK)
+                       : snprintf(reply, sizeof(reply), "%s %s\n",
+                                  DAEMON_REPLY_ERROR, strerror(error));
+  // LCOV_EXCL_START
+  if (len < 0 || (size_t)len >= sizeof(reply)) {
+    errno = EOVERFLOW;
+    return -1;
+  }
+  // LCOV_EXCL_STOP
+
+  ssize_t written = ops->write(fd, reply, (size_t)len);
+  if (written != (ssize_t)len) {
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * daemon_handle_client - Serve one connected client
+ * @ops: Operations structure for system call abstraction
+ * @fd: Connected socket
+ * @config: Configuration in use
+ * @opts: Runtime options (modes, --noop, --stamp-cache, --debug)
+ * @fingerprint: stamp_fingerprint() of @config's sources, or NULL
+ * @username: Scratch buffer for the peer's username
+ * @username_size: Size of @username
+ *
+ * Enrolls the UID the kernel reports for the peer and replies once the
+ * ranges are in place. The peer has DAEMON_REQUEST_TIMEOUT_MS from being
+ * handed over to send its request; after that it is dropped unanswered.
+ * With --stamp-cache a current STAMP_DIR/<uid> lets the request be
+ * answered after enroll_user_check() has found the ranges in the
+ * databases, without spawning any helper. The stamp alone is never
+ * trusted: an "ok" sends --request on its way without a commit to wait
+ * for.
+ *
+ * Return: 0 if the peer's ranges are in place, -1 otherwise
+ */
+int daemon_handle_client(const struct syscall_ops *ops, int fd,
+                         const config_t *config, const options_t *opts,
+                         const uint64_t *fingerprint, char *username,
+                         size_t username_size) {
+  if (ops == NULL || config == NULL || opts == NULL || username == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr,
+                  "%s: error: NULL parameter in daemon_handle_client\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  uint64_t deadline =
+      stats_now() + (uint64_t)DAEMON_REQUEST_TIMEOUT_MS * 1000;
+  struct ucred cred = {0};
+  socklen_t cred_len = sizeof(cred);
+  if (ops->getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) != 0 ||
+      cred_len != sizeof(cred)) {
+    int saved_errno = errno;
+    (void)fprintf(stderr, "%s: error: cannot identify client: %s\n",
+                  PROJECT_NAME, strerror(saved_errno));
+    (void)send_reply(ops, fd, saved_errno);
+    errno = saved_errno;
+    return -1;
+  }
+
+  char request[DAEMON_MSG_MAX] = {0};
+  if (read_line(ops, fd, request, sizeof(request), deadline) != 0) {
+    if (opts->debug) {
+      (void)fprintf(stderr, "%s: debug: no request from UID %u: %s\n",
+                    PROJECT_NAME, (unsigned int)cred.uid, strerror(errno));
+    }
+    return -1;
+  }
+  if (strcmp(request, DAEMON_REQUEST_ENSURE) != 0) {
+    (void)fprintf(stderr, "%s: error: unknown request from UID %u\n",
+                  PROJECT_NAME, (unsigned int)cred.uid);
+    (void)send_reply(ops, fd, EBADMSG);
+    errno = EBADMSG;
+    return -1;
+  }
+
+  char uid_str[UINT32_DECIMAL_MAX_LEN + 1] = {0};
+  uint32_t uid = 0;
+  (void)snprintf(uid_str, sizeof(uid_str), "%u", (unsigned int)cred.uid);
+  if (resolve_user(ops, uid_str, &uid, username, username_size,
+                   config->resolve_timeout_ms, opts->debug) != 0) {
+    int saved_errno = errno;
+    (void)send_reply(ops, fd, saved_errno);
+    errno = saved_errno;
+    return -1;
+  }
+
+  if (opts->debug) {
+    (void)fprintf(stderr, "%s: debug: request from %s (UID: %u)\n",
+                  PROJECT_NAME, username, uid);
+  }
+
+  bool use_stamp = opts->stamp_cache && !opts->noop && fingerprint != NULL;
+  if (use_stamp &&
+      stamp_check(ops, STAMP_DIR, uid, username, opts, *fingerprint) == 1 &&
+      enroll_user_check(ops, username, uid, config, opts) == 1) {
+    if (opts->debug) {
+      (void)fprintf(stderr, "%s: debug: %s already done, skipping\n",
+                    PROJECT_NAME, username);
+    }
+    return send_reply(ops, fd, 0);
+  }
+
+  if (enroll_user(ops, username, uid, config, opts) != 0) {
+    int saved_errno = errno != 0 ? errno : EIO;
+    (void)send_reply(ops, fd, saved_errno);
+    errno = saved_errno;
+    return -1;
+  }
+
+  if (use_stamp && stamp_write(ops, STAMP_DIR, uid, username, config, opts,
+                               *fingerprint) != 0) {
+    (void)fprintf(stderr, "%s: warning: stamp cache not updated for %s\n",
+                  PROJECT_NAME, username);
+  }
+
+  return send_reply(ops, fd, 0);
+}
+
+/**
+ * set_send_timeout - Bound how long a peer may stall a write
+ * @fd: Connected socket
+ * @seconds: Timeout
+ *
+ * Reads are bounded by read_line()'s deadline instead.
+ */
+static void set_send_timeout(int fd, int seconds) {
+  struct timeval tv = {.tv_sec = seconds, .tv_usec = 0};
+  (void)setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+/**
+ * refresh_config - Reload the configuration if its sources changed
+ * @ops: Operations structure for system call abstraction
+ * @config: Configuration in use, replaced on a successful reload
+ * @fingerprint: Fingerprint @config was loaded under, updated with it
+ * @have_fingerprint: Whether @fingerprint is valid
+ * @debug: Enable debug output
+ *
+ * The fingerprint filters out events that changed nothing load_configuration()
+ * would read (a touch of an unrelated file, an editor's swap file). A
+ * reload that fails keeps the previous configuration, so a half-edited
+ * file cannot take the service down.
+ */
+static void refresh_config(const struct syscall_ops *ops, config_t *config,
+                           uint64_t *fingerprint, bool *have_fingerprint,
+                           bool debug) {
+  uint64_t current = 0;
+  if (stamp_fingerprint(ops, &current, debug) != 0) {
+    *have_fingerprint = false;
+    return;
+  }
+  if (*have_fingerprint && current == *fingerprint) {
+    return;
+  }
+
+  config_t fresh = {0};
+  if (load_configuration(ops, &fresh, debug) != 0) {
+    (void)fprintf(stderr,
+                  "%s: warning: configuration changed but failed to load, "
+                  "keeping the previous one\n",
+                  PROJECT_NAME);
+    return;
+  }
+
+  if (debug) {
+    (void)fprintf(stderr, "%s: debug: configuration reloaded\n",
+                  PROJECT_NAME);
+  }
+  *config = fresh;
+  *fingerprint = current;
+  *have_fingerprint = true;
+}
+
+/**
+ * daemon_serve - Accept and serve clients until idle
+ * @ops: Operations structure for system call abstraction
+ * @listen_fd: Socket from daemon_listen()
+ * @config: Loaded configuration, reloaded in place when its sources change
+ * @opts: Runtime options
+ * @fingerprint: stamp_fingerprint() @config was loaded under, or NULL
+ * @idle_timeout_ms: Return after this long without a client, -1 for never
+ *
+ * The configuration sources are watched with inotify and reloaded when
+ * they change, so edits take effect on the next request without a
+ * restart. Without inotify they are re-fingerprinted before each client
+ * instead. Each request allocates from an arena that is reset once it
+ * has been answered. With --stats every request is reported on its own.
+ *
+ * Return: 0 after an idle timeout, -1 on error
+ */
+int daemon_serve(const struct syscall_ops *ops, int listen_fd,
+                 config_t *config, const options_t *opts,
+                 const uint64_t *fingerprint, int idle_timeout_ms) {
+  if (ops == NULL || config == NULL || opts == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: NULL parameter in daemon_serve\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  long name_max = sysconf(_SC_LOGIN_NAME_MAX);
+  // LCOV_EXCL_START
+  if (name_max <= 0) {
+    errno = ENOSYS;
+    (void)fprintf(stderr, "%s: error: invalid _SC_LOGIN_NAME_MAX: %ld\n",
+                  PROJECT_NAME, name_max);
+    return -1;
+  }
+  // LCOV_EXCL_STOP
+
+  /* +1 for NUL terminator */
+  size_t username_size = (size_t)name_max + 1;
+  char *username = ops->calloc(username_size, sizeof(*username));
+  if (username == NULL) {
+    errno = ENOMEM;
+    (void)fprintf(stderr, "%s: error: memory allocation failed\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  /* A client hanging up early must not kill the daemon */
+  (void)signal(SIGPIPE, SIG_IGN);
+
+  config_watch_t watch = {0};
+  bool watching = config_watch_open(&watch, LOGIN_DEFS_PATH, CONFIG_FILE_PATH,
+                                    CONFIG_DROPIN_DIR_PATH, opts->debug) == 0;
+  if (!watching) {
+    (void)fprintf(stderr,
+                  "%s: warning: cannot watch the configuration, checking it "
+                  "on every request\n",
+                  PROJECT_NAME);
+  }
+
+  uint64_t current = fingerprint != NULL ? *fingerprint : 0;
+  bool have_fingerprint = fingerprint != NULL;
+  arena_t arena;
+  arena_init(&arena, ops, 0);
+  /* The initial load belongs to no request */
+  stats_reset();
+  int ret = 0;
+  for (;;) {
+    struct pollfd pfd[2] = {
+        {.fd = listen_fd, .events = POLLIN, .revents = 0},
+        {.fd = config_watch_fd(&watch), .events = POLLIN, .revents = 0}};
+    int ready = poll(pfd, watching ? 2 : 1, idle_timeout_ms);
+    if (ready == 0) {
+      if (opts->debug) {
+        (void)fprintf(stderr, "%s: debug: idle, exiting\n", PROJECT_NAME);
+      }
+      break;
+    }
+
+    if (ready > 0 && watching && (pfd[1].revents & POLLIN) != 0) {
+      int changed = config_watch_changed(&watch, opts->debug);
+      if (changed < 0) {
+        /* Fall back to checking on every request from now on */
+        config_watch_close(&watch);
+        watching = false;
+      }
+      if (changed != 0) {
+        refresh_config(ops, config, &current, &have_fingerprint, opts->debug);
+      }
+      if ((pfd[0].revents & POLLIN) == 0) {
+        continue;
+      }
+    }
+
+    int fd = ready < 0 ? -1 : accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED || errno == EAGAIN) {
+        continue;
+      }
+      (void)fprintf(stderr, "%s: error: cannot accept connection: %s\n",
+                    PROJECT_NAME, strerror(errno));
+      ret = -1;
+      break;
+    }
+
+    set_send_timeout(fd, DAEMON_IO_TIMEOUT_SEC);
+    if (!watching) {
+      refresh_config(ops, config, &current, &have_fingerprint, opts->debug);
+    }
+    struct syscall_ops scoped;
+    arena_begin(&arena, ops, &scoped);
+    uint64_t started = stats_now();
+    username[0] = '\0';
+    int served = daemon_handle_client(&scoped, fd, config, opts,
+                                      have_fingerprint ? &current : NULL,
+                                      username, username_size);
+    if (served != 0 && opts->debug) {
+      (void)fprintf(stderr, "%s: debug: request failed\n", PROJECT_NAME);
+    }
+    if (opts->stats != 0) {
+      /* Each request is reported on its own, reloads included */
+      stats_phase_add(STATS_TOTAL, started);
+      stats_report(opts->stats, username,
+                   served == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+      stats_reset();
+    }
+    arena_end(&arena);
+    (void)close(fd);
+  }
+
+  arena_destroy(&arena);
+  config_watch_close(&watch);
+  ops->free(username);
+  return ret;
+}
+
+/**
+ * daemon_request - Ask the daemon to ensure the caller's ranges
+ * @path: Daemon socket path
+ * @timeout_sec: Wait at most this long for the reply, 0 not to wait
+ * @debug: Enable debug output
+ *
+ * The daemon commits the ranges whether or not the caller is still there
+ * to hear about it, so giving up early only gives up the answer.
+ *
+ * Return: 0 once the caller's ranges are in place (or the request is
+ *         queued, with no @timeout_sec), -1 on error or when @timeout_sec
+ *         ran out (errno ETIMEDOUT)
+ */
+int daemon_request(const char *path, unsigned int timeout_sec, bool debug) {
+  if (path == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: NULL parameter in daemon_request\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    errno = ENAMETOOLONG;
+    (void)fprintf(stderr, "%s: error: socket path %s is too long\n",
+                  PROJECT_NAME, path);
+    return -1;
+  }
+  (void)memcpy(addr.sun_path, path, strlen(path) + 1);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  // LCOV_EXCL_START
+  if (fd < 0) {
+    (void)fprintf(stderr, "%s: error: cannot create socket: %s\n",
+                  PROJECT_NAME, strerror(errno));
+    return -1;
+  }
+  // LCOV_EXCL_STOP
+
+  if (connect(fd, (const struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    int saved_errno = errno;
+    (void)fprintf(stderr, "%s: error: cannot connect to %s: %s\n",
+                  PROJECT_NAME, path, strerror(saved_errno));
+    (void)close(fd);
+    errno = saved_errno;
+    return -1;
+  }
+  set_send_timeout(fd, DAEMON_IO_TIMEOUT_SEC);
+
+  if (debug) {
+    (void)fprintf(stderr, "%s: debug: sending request to %s\n", PROJECT_NAME,
+                  path);
+  }
+
+  static const char request[] = DAEMON_REQUEST_ENSURE "\n";
+  char reply[DAEMON_MSG_MAX] = {0};
+  int ret = -1;
+  if (write(fd, request, sizeof(request) - 1) !=
+      (ssize_t)(sizeof(request) - 1)) {
+    (void)fprintf(stderr, "%s: error: cannot send request to %s: %s\n",
+                  PROJECT_NAME, path, strerror(errno));
+  } else if (timeout_sec == 0) {
+    if (debug) {
+      (void)fprintf(stderr, "%s: debug: request queued, not waiting\n",
+                    PROJECT_NAME);
+    }
+    ret = 0;
+  } else if (read_line(&syscall_ops_default, fd, reply, sizeof(reply),
+                       stats_now() + (uint64_t)timeout_sec * 1000000) != 0) {
+    if (errno == ETIMEDOUT) {
+      (void)fprintf(stderr,
+                    "%s: error: no reply from %s within %u seconds, the "
+                    "request stays queued\n",
+                    PROJECT_NAME, path, timeout_sec);
+    } else {
+      (void)fprintf(stderr, "%s: error: no reply from %s: %s\n",
+                    PROJECT_NAME, path, strerror(errno));
+    }
+  } else if (strcmp(reply, DAEMON_REPLY_OK) == 0) {
+    ret = 0;
+  } else {
+    errno = EIO;
+    (void)fprintf(stderr, "%s: error: daemon replied: %s\n", PROJECT_NAME,
+                  reply);
+  }
+
+  int saved_errno = errno;
+  (void)close(fd);
+  errno = saved_errno;
+  return ret;
+}
@@ -0,0 +1,666 @@
+/**
+ * enroll.c - Per-user subordinate ID enrollment pipeline
+ *
+ * Shared by single-user invocations and batch mode so that every entry
+ * runs through exactly the same validate -> check -> calculate -> assign
+ * sequence against an already loaded configuration. Both modes are
+ * checked and calculated before either is assigned, so a failure never
+ * leaves a user with only one of its ranges.
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*
+ * Existing ranges SKIP_IF_EXACT compares without allocating; a user with
+ * more is looked up again into a buffer large enough for all of them
+ */
+enum { EXACT_LOOKUP_MAX = 16 };
+
+/*
+ * Forward declarations for internal functions
+ *
+ * We can use nonnull on static functions because they can only be called
+ * from inside here and we're careful to check the pointers in our visible
+ * function(s).
+ */
+static int plan_mode(const struct syscall_ops *ops, const char *username,
+                     uint32_t uid, const config_t *config, subid_mode_t mode,
+                     const options_t *opts, int known, subid_range_t *range,
+                     bool *needed)
+    __attribute__((nonnull(1, 2, 4, 6, 8, 9)))
+    __attribute__((warn_unused_result));
+static int assign_native(const struct syscall_ops *ops, const char *username,
+                         subid_mode_t mode, const subid_range_t *range,
+                         const options_t *opts, subid_txn_t *txn)
+    __attribute__((nonnull(1, 2, 4, 5, 6))) __attribute__((warn_unused_result));
+static int lookup_exact(const struct syscall_ops *ops, const char *username,
+                        uint32_t uid, subid_mode_t mode, const char *mode_str,
+                        const subid_range_t *want, size_t *found, bool debug)
+    __attribute__((nonnull(1, 2, 5, 6, 7))) __attribute__((warn_unused_result));
+static int check_exact(const struct syscall_ops *ops, const char *username,
+                       uint32_t uid, subid_mode_t mode, const char *mode_str,
+                       const subid_range_t *want, bool debug)
+    __attribute__((nonnull(1, 2, 5, 6))) __attribute__((warn_unused_result));
+static int mode_config(const config_t *config, subid_mode_t mode,
+                       const char **mode_str, const subid_config_t **subid_cfg)
+    __attribute__((nonnull(1, 3, 4))) __attribute__((warn_unused_result));
+static int check_mode(const struct syscall_ops *ops, const char *username,
+                      uint32_t uid, const config_t *config, subid_mode_t mode,
+                      bool debug) __attribute__((nonnull(1, 2, 4)))
+__attribute__((warn_unused_result));
+
+/**
+ * mode_config - Select the per-mode configuration
+ * @config: Configuration
+ * @mode: SUBUID or SUBGID
+ * @mode_str: Set to "subuid" or "subgid"
+ * @subid_cfg: Set to the matching section of @config
+ *
+ * Return: 0 on success, -1 on an invalid @mode
+ */
+static int mode_config(const config_t *config, subid_mode_t mode,
+                       const char **mode_str,
+                       const subid_config_t **subid_cfg) {
+  switch (mode) {
+  case SUBUID:
+    *mode_str = "subuid";
+    *subid_cfg = &config->subuid;
+    return 0;
+  case SUBGID:
+    *mode_str = "subgid";
+    *subid_cfg = &config->subgid;
+    return 0;
+  default:
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: invalid mode\n", PROJECT_NAME);
+    return -1;
+  }
+}
+
+/**
+ * lookup_exact - Look for the calculated range among a user's ranges
+ * @ops: Operations structure for system call abstraction
+ * @username: Username to check
+ * @uid: UID of @username
+ * @mode: SUBUID or SUBGID
+ * @mode_str: "subuid" or "subgid", for messages
+ * @want: Range calc_subid_range() produced for @uid
+ * @found: Set to the number of ranges the user has
+ * @debug: Enable debug output
+ *
+ * Reads the database in-process (see subid_db_lookup()), so the common
+ * case of a returning user costs no helper process at all. Every range
+ * is compared: past EXACT_LOOKUP_MAX the lookup is repeated into a
+ * buffer sized for all of them.
+ *
+ * Return: 1 if @want is already assigned, 0 if not, -1 on error
+ */
+static int lookup_exact(const struct syscall_ops *ops, const char *username,
+                        uint32_t uid, subid_mode_t mode, const char *mode_str,
+                        const subid_range_t *want, size_t *found, bool debug) {
+  subid_range_t local[EXACT_LOOKUP_MAX] = {0};
+  subid_range_t *ranges = local;
+  size_t max = EXACT_LOOKUP_MAX;
+  int ret = 0;
+
+  *found = 0;
+  while (ranges != NULL) {
+    if (subid_db_lookup(ops, subid_db_path(mode), username, uid, ranges, max,
+                        found, debug) != 0) {
+      (void)fprintf(stderr,
+                    "%s: error: could not read %s database to compare "
+                    "ranges for user %s\n",
+                    PROJECT_NAME, mode_str, username);
+      ret = -1;
+      break;
+    }
+    if (*found <= max) {
+      break;
+    }
+
+    /* Grew past the buffer: look again with room for every range */
+    if (ranges != local) {
+      ops->free(ranges);
+    }
+    max = *found;
+    ranges = ops->calloc(max, sizeof(*ranges));
+  }
+  if (ranges == NULL) {
+    errno = ENOMEM;
+    (void)fprintf(stderr, "%s: error: memory allocation failed\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  for (size_t i = 0; ret == 0 && i < *found; i++) {
+    if (ranges[i].start == want->start && ranges[i].count == want->count) {
+      if (debug) {
+        (void)fprintf(stderr,
+                      "%s: debug: user %s already has %s range %u:%u\n",
+                      PROJECT_NAME, username, mode_str, want->start,
+                      want->count);
+      }
+      ret = 1;
+    }
+  }
+
+  if (ranges != local) {
+    ops->free(ranges);
+  }
+  return ret;
+}
+
+/**
+ * check_exact - Compare a user's existing ranges with the calculated one
+ * @ops: Operations structure for system call abstraction
+ * @username: Username to check
+ * @uid: UID of @username
+ * @mode: SUBUID or SUBGID
+ * @mode_str: "subuid" or "subgid", for messages
+ * @want: Range calc_subid_range() produced for @uid
+ * @debug: Enable debug output
+ *
+ * Return: 1 if @want is already assigned, 0 if the user has no ranges,
+ *         -1 if the user has other ranges (errno EEXIST) or on error
+ */
+static int check_exact(const struct syscall_ops *ops, const char *username,
+                       uint32_t uid, subid_mode_t mode, const char *mode_str,
+                       const subid_range_t *want, bool debug) {
+  size_t found = 0;
+  int match =
+      lookup_exact(ops, username, uid, mode, mode_str, want, &found, debug);
+  if (match != 0 || found == 0) {
+    return match;
+  }
+
+  errno = EEXIST;
+  (void)fprintf(stderr,
+                "%s: error: user %s has %zu %s range(s), none matching "
+                "calculated range %u:%u; not adding another\n",
+                PROJECT_NAME, username, found, mode_str, want->start,
+                want->count);
+  return -1;
+}
+
+/**
+ * assign_native - Queue a range for the native writer (files or spool)
+ * @ops: Operations structure for system call abstraction
+ * @username: Username to assign to
+ * @mode: SUBUID or SUBGID
+ * @range: Range to assign
+ * @opts: Runtime options
+ * @txn: Transaction the range is added to
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int assign_native(const struct syscall_ops *ops, const char *username,
+                         subid_mode_t mode, const subid_range_t *range,
+                         const options_t *opts, subid_txn_t *txn) {
+  if (opts->noop) {
+    (void)printf("%s: noop: would add to %s: %s:%u:%u\n", PROJECT_NAME,
+                 subid_db_path(mode), username, range->start, range->count);
+    return 0;
+  }
+
+  if (opts->debug) {
+    (void)fprintf(stderr, "%s: debug: queueing %s:%u:%u for %s\n",
+                  PROJECT_NAME, username, range->start, range->count,
+                  subid_db_path(mode));
+  }
+
+  return subid_txn_add(ops, txn, mode, username, range->start, range->count);
+}
+
+/**
+ * plan_mode - Decide what a single mode (subuid or subgid) needs
+ * @ops: Operations structure for system call abstraction
+ * @username: Username to process
+ * @uid: User's UID
+ * @config: Configuration
+ * @mode: SUBUID or SUBGID
+ * @opts: Runtime options
+ * @known: getsubids(1) answer already at hand (1 or 0), -1 to ask it
+ * @range: Set to the range to assign when @needed
+ * @needed: Set to whether a range must be assigned
+ *
+ * Runs every step that can fail before anything is written:
+ * 1. Validate UID doesn't overlap subordinate range
+ * 2. Check if user already has subordinate IDs (if SKIP_IF_EXISTS), via
+ *    SUBID_BACKEND with getsubids(1) (or @known) as the fallback
+ * 3. Calculate subordinate ID range
+ * 4. With SKIP_IF_EXACT, compare it with the existing ranges instead of
+ *    step 2: an exact match needs nothing, any other range is an error
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int plan_mode(const struct syscall_ops *ops, const char *username,
+                     uint32_t uid, const config_t *config, subid_mode_t mode,
+                     const options_t *opts, int known, subid_range_t *range,
+                     bool *needed) {
+  const char *mode_str = NULL;
+  const subid_config_t *subid_cfg = NULL;
+
+  *needed = false;
+
+  if (mode_config(config, mode, &mode_str, &subid_cfg) != 0) {
+    return -1;
+  }
+
+  if (opts->debug) {
+    (void)fprintf(stderr, "%s: debug: processing mode: %s\n", PROJECT_NAME,
+                  mode_str);
+  }
+
+  /* Validate UID doesn't overlap with subordinate ID range */
+  if (validate_uid_subid_overlap(uid, subid_cfg) != 0) {
+    return -1;
+  }
+
+  /* Check if subordinate IDs already exist (if configured) */
+  if (config->skip_if_exists && !config->skip_if_exact) {
+    int exists = -1;
+    if (config->subid_backend == SUBID_BACKEND_FILES) {
+      exists = subid_db_check_exists(ops, username, uid, mode, opts->debug);
+      if (exists < 0) {
+        (void)fprintf(stderr,
+                      "%s: warning: could not read %s database, falling "
+                      "back to getsubids\n",
+                      PROJECT_NAME, mode_str);
+      }
+    }
+    if (exists < 0) {
+      exists = known;
+    }
+    if (exists < 0) {
+      exists = check_subid_exists(ops, username, mode, opts->debug);
+    }
+    if (exists < 0) {
+      (void)fprintf(stderr,
+                    "%s: warning: could not check existing %ss for user "
+                    "%s giving up\n",
+                    PROJECT_NAME, mode_str, username);
+      return -1;
+    } else if (exists > 0) {
+      if (opts->debug) {
+        (void)fprintf(stderr, "%s: debug: user %s already has %ss assigned\n",
+                      PROJECT_NAME, username, mode_str);
+      }
+      return 0;
+    }
+  }
+
+  /* Calculate subordinate ID range start */
+  if (opts->debug) {
+    (void)fprintf(stderr, "%s: debug: calculating %s range for UID %u\n",
+                  PROJECT_NAME, mode_str, uid);
+  }
+
+  uint32_t start = 0; /* value actually managed by calc_subid_range */
+  if (calc_subid_range(uid, config->uid_min, subid_cfg,
+                       config->allow_subid_wrap, &start) != 0) {
+    return -1;
+  }
+
+  *range = (subid_range_t){.start = start,
+                           .count = calc_subid_count(uid, subid_cfg)};
+
+  if (opts->debug) {
+    (void)fprintf(stderr, "%s: debug: calculated range: %u:%u\n", PROJECT_NAME,
+                  range->start, range->count);
+  }
+
+  /* Compare against what is already assigned (if configured) */
+  if (config->skip_if_exact) {
+    int match = check_exact(ops, username, uid, mode, mode_str, range,
+                            opts->debug);
+    if (match != 0) {
+      return match > 0 ? 0 : -1;
+    }
+  }
+
+  *needed = true;
+  return 0;
+}
+
+/**
+ * check_mode - Decide in-process whether a mode already needs nothing
+ * @ops: Operations structure for system call abstraction
+ * @username: Username to check
+ * @uid: User's UID
+ * @config: Configuration
+ * @mode: SUBUID or SUBGID
+ * @debug: Enable debug output
+ *
+ * Mirrors plan_mode() without ever spawning a helper: the database is
+ * read directly whatever SUBID_BACKEND says. A user that already has the
+ * calculated range needs nothing; with SKIP_IF_EXISTS (and not
+ * SKIP_IF_EXACT) any existing range is enough.
+ *
+ * Return: 1 if nothing is needed, 0 if a range must be assigned, -1 on
+ *         error (including a mismatch plan_mode() would reject)
+ */
+static int check_mode(const struct syscall_ops *ops, const char *username,
+                      uint32_t uid, const config_t *config, subid_mode_t mode,
+                      bool debug) {
+  const char *mode_str = NULL;
+  const subid_config_t *subid_cfg = NULL;
+
+  if (mode_config(config, mode, &mode_str, &subid_cfg) != 0) {
+    return -1;
+  }
+
+  if (validate_uid_subid_overlap(uid, subid_cfg) != 0) {
+    return -1;
+  }
+
+  uint32_t start = 0;
+  if (calc_subid_range(uid, config->uid_min, subid_cfg,
+                       config->allow_subid_wrap, &start) != 0) {
+    return -1;
+  }
+
+  subid_range_t want = {.start = start,
+                        .count = calc_subid_count(uid, subid_cfg)};
+  if (config->skip_if_exact) {
+    return check_exact(ops, username, uid, mode, mode_str, &want, debug);
+  }
+
+  size_t found = 0;
+  int match =
+      lookup_exact(ops, username, uid, mode, mode_str, &want, &found, debug);
+  if (match != 0 || found == 0) {
+    return match;
+  }
+
+  if (config->skip_if_exists) {
+    if (debug) {
+      (void)fprintf(stderr, "%s: debug: user %s already has %ss assigned\n",
+                    PROJECT_NAME, username, mode_str);
+    }
+    return 1;
+  }
+
+  return 0;
+}
+
+/**
+ * enroll_user_check - Report whether enroll_user() would change anything
+ * @ops: Operations structure for system call abstraction
+ * @username: Resolved username
+ * @uid: Resolved UID for @username
+ * @config: Loaded configuration
+ * @opts: Runtime options (selects --subuid and/or --subgid)
+ *
+ * Used by --check-only and --condition. Nothing is written and no helper
+ * is spawned, so this runs without privileges beyond reading the
+ * databases.
+ *
+ * Return: 1 if every requested range is in place, 0 if work is needed,
+ *         -1 on error
+ */
+int enroll_user_check(const struct syscall_ops *ops, const char *username,
+                      uint32_t uid, const config_t *config,
+                      const options_t *opts) {
+  if (ops == NULL || username == NULL || config == NULL || opts == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: NULL parameter in enroll_user_check\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  if (validate_uid_range(uid, config) != 0) {
+    return -1;
+  }
+
+  uint64_t started = stats_now();
+  int done = 1;
+  if (opts->do_subuid) {
+    done = check_mode(ops, username, uid, config, SUBUID, opts->debug);
+  }
+  if (done == 1 && opts->do_subgid) {
+    done = check_mode(ops, username, uid, config, SUBGID, opts->debug);
+  }
+  stats_phase_add(STATS_CHECK, started);
+
+  if (opts->debug && done >= 0) {
+    (void)fprintf(stderr, "%s: debug: user %s %s\n", PROJECT_NAME, username,
+                  done == 1 ? "needs nothing" : "needs a range");
+  }
+  return done;
+}
+
+/**
+ * enroll_user_deferred - enroll_user() that may leave writes to the caller
+ * @ops: Operations structure for system call abstraction
+ * @username: Resolved username
+ * @uid: Resolved UID for @username
+ * @config: Loaded configuration
+ * @opts: Runtime options (selects --subuid and/or --subgid)
+ * @txn: Transaction collecting new ranges, or NULL to write immediately
+ *
+ * With SUBID_WRITER files or spool and a @txn, new ranges are only queued
+ * and the caller commits them with subid_txn_commit(), so a batch takes
+ * the database locks and rewrites each file once instead of once per user.
+ * Without a @txn, SUBID_WRITER spool commits through subid_spool_commit()
+ * so concurrent runs share the rewrite.
+ * @txn->users counts the users that queued at least one range.
+ *
+ * Ranges are calculated from the UID alone, so deferring the write cannot
+ * change the outcome for any user.
+ *
+ * Return: 0 on success, -1 on error
+ */
+int enroll_user_deferred(const struct syscall_ops *ops, const char *username,
+                         uint32_t uid, const config_t *config,
+                         const options_t *opts, subid_txn_t *txn) {
+  return enroll_user_prechecked(ops, username, uid, config, opts, NULL, txn);
+}
+
+/**
+ * enroll_user_prechecked - enroll_user_deferred() with getsubids(1) answers
+ * @ops: Operations structure for system call abstraction
+ * @username: Resolved username
+ * @uid: Resolved UID for @username
+ * @config: Loaded configuration
+ * @opts: Runtime options (selects --subuid and/or --subgid)
+ * @exists: check_subid_exists_many() results indexed by SUBUID and SUBGID,
+ *          -1 where unknown, or NULL
+ * @txn: Transaction collecting new ranges, or NULL to write immediately
+ *
+ * Lets a batch run the SKIP_IF_EXISTS getsubids(1) checks of many users
+ * side by side and hand the answers in here, where they stand in for the
+ * helper plan_mode() would otherwise spawn. Unknown answers are asked
+ * again, so failures are reported exactly as without @exists.
+ *
+ * Return: 0 on success, -1 on error
+ */
+int enroll_user_prechecked(const struct syscall_ops *ops,
+                           const char *username, uint32_t uid,
+                           const config_t *config, const options_t *opts,
+                           const int exists[SUBID_MODES], subid_txn_t *txn) {
+  if (ops == NULL || username == NULL || config == NULL || opts == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: NULL parameter in enroll_user\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  /* Validate UID is in allowed range */
+  if (validate_uid_range(uid, config) != 0) {
+    return -1;
+  }
+
+  /* Plan both modes before writing anything */
+  subid_range_t subuid = {0};
+  subid_range_t subgid = {0};
+  bool need_subuid = false;
+  bool need_subgid = false;
+
+  uint64_t started = stats_now();
+  int planned = 0;
+  if (opts->do_subuid) {
+    planned = plan_mode(ops, username, uid, config, SUBUID, opts,
+                        exists != NULL ? exists[SUBUID] : -1, &subuid,
+                        &need_subuid);
+  }
+  if (planned == 0 && opts->do_subgid) {
+    planned = plan_mode(ops, username, uid, config, SUBGID, opts,
+                        exists != NULL ? exists[SUBGID] : -1, &subgid,
+                        &need_subgid);
+  }
+  stats_phase_add(STATS_CHECK, started);
+  if (planned != 0) {
+    return -1;
+  }
+
+  if (!need_subuid && !need_subgid) {
+    return 0;
+  }
+
+  /* One usermod call applies both ranges, or neither */
+  started = stats_now();
+  if (config->subid_writer == SUBID_WRITER_USERMOD) {
+    int ret = set_subid_ranges(ops, username, need_subuid ? &subuid : NULL,
+                               need_subgid ? &subgid : NULL, opts->noop,
+                               opts->debug);
+    /* usermod(8) replaced the databases, so their indexes are stale */
+    if (ret == 0 && !opts->noop && need_subuid) {
+      (void)subid_index_refresh(ops, SUBID_INDEX_DIR, subid_db_path(SUBUID),
+                                opts->debug);
+    }
+    if (ret == 0 && !opts->noop && need_subgid) {
+      (void)subid_index_refresh(ops, SUBID_INDEX_DIR, subid_db_path(SUBGID),
+                                opts->debug);
+    }
+    stats_phase_add(STATS_WRITE, started);
+    return ret;
+  }
+
+  subid_txn_t local = {0};
+  subid_txn_t *target = txn != NULL ? txn : &local;
+  size_t subuid_mark = target->subuid.len;
+  size_t subgid_mark = target->subgid.len;
+  int ret = 0;
+
+  if (need_subuid) {
+    ret = assign_native(ops, username, SUBUID, &subuid, opts, target);
+  }
+  if (ret == 0 && need_subgid) {
+    ret = assign_native(ops, username, SUBGID, &subgid, opts, target);
+  }
+
+  if (txn == NULL) {
+    if (ret == 0 && config->subid_writer == SUBID_WRITER_SPOOL) {
+      ret = subid_spool_commit(ops, STAMP_DIR, &local, opts->debug);
+    } else if (ret == 0) {
+      ret = subid_txn_commit(ops, &local, opts->debug);
+    }
+    subid_txn_free(ops, &local);
+  } else if (ret != 0) {
+    /* A failed user must not leave half of its ranges behind */
+    subid_txn_truncate(ops, txn, subuid_mark, subgid_mark);
+  } else if (txn->subuid.len > subuid_mark || txn->subgid.len > subgid_mark) {
+    txn->users++;
+  }
+
+  stats_phase_add(STATS_WRITE, started);
+  return ret;
+}
+
+/**
+ * enroll_user - Ensure a resolved user has the requested subordinate ranges
+ * @ops: Operations structure for system call abstraction
+ * @username: Resolved username
+ * @uid: Resolved UID for @username
+ * @config: Loaded configuration
+ * @opts: Runtime options (selects --subuid and/or --subgid)
+ *
+ * Validates that @uid is eligible, plans each requested mode and then
+ * assigns every needed range with a single usermod(8) call (or a single
+ * native write, see SUBID_WRITER). The configuration is only read, so one
+ * loaded config may be reused for any number of users.
+ *
+ * Return: 0 on success, -1 on error
+ */
+int enroll_user(const struct syscall_ops *ops, const char *username,
+                uint32_t uid, const config_t *config, const options_t *opts) {
+  return enroll_user_deferred(ops, username, uid, config, opts, NULL);
+}
+
+/**
+ * enroll_session - Ensure the ranges of a user who is logging in
+ * @ops: Operations structure for system call abstraction
+ * @user: Username or UID as handed over by the login service
+ * @config: Loaded configuration
+ * @opts: Runtime options (selects --subuid and/or --subgid)
+ *
+ * The in-process pipeline behind pam_static_subid.so: resolve, then the
+ * enroll_user_check() fast path, which spawns nothing, and only when that
+ * finds work the full enroll_user(). Accounts outside [UID_MIN, UID_MAX]
+ * (root, system users) are not an error, they simply get no ranges.
+ *
+ * Return: 0 if the ranges are in place, 1 if @user is not eligible,
+ *         -1 on error
+ */
+int enroll_session(const struct syscall_ops *ops, const char *user,
+                   const config_t *config, const options_t *opts) {
+  if (ops == NULL || user == NULL || config == NULL || opts == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: NULL parameter in enroll_session\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  long name_max = sysconf(_SC_LOGIN_NAME_MAX);
+  // LCOV_EXCL_START
+  if (name_max <= 0) {
+    errno = ENOSYS;
+    (void)fprintf(stderr, "%s: error: invalid _SC_LOGIN_NAME_MAX: %ld\n",
+                  PROJECT_NAME, name_max);
+    return -1;
+  }
+  // LCOV_EXCL_STOP
+
+  /* +1 for NUL terminator */
+  size_t size = (size_t)name_max + 1;
+  char *username = ops->calloc(size, sizeof(*username));
+  if (username == NULL) {
+    errno = ENOMEM;
+    (void)fprintf(stderr, "%s: error: memory allocation failed\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  uint32_t uid = 0;
+  int ret = resolve_user(ops, user, &uid, username, size,
+                         config->resolve_timeout_ms, opts->debug);
+  if (ret == 0 && (uid < config->uid_min || uid > config->uid_max)) {
+    if (opts->debug) {
+      (void)fprintf(stderr,
+                    "%s: debug: %s (UID: %u) is outside [%u, %u], "
+                    "nothing to do\n",
+                    PROJECT_NAME, username, uid, config->uid_min,
+                    config->uid_max);
+    }
+    ret = 1;
+  } else if (ret == 0 &&
+             enroll_user_check(ops, username, uid, config, opts) != 1) {
+    ret = enroll_user(ops, username, uid, config, opts);
+  }
+
+  int saved_errno = errno;
+  ops->free(username);
+  errno = saved_errno;
+  return ret;
+}
@@ -0,0 +1,689 @@
+/**
+ * export.c - Full subuid(5)/subgid(5) table generation (--export)
+ *
+ * Writes the table static-subid would produce for a set of users without
+ * touching /etc: every eligible passwd account, the users named on the
+ * command line, or a list read from a file or stdin. The result is meant
+ * to be baked into images or distributed over NFS.
+ *
+ * Users are collected first and sorted by UID, so consecutive UIDs form
+ * bands whose ranges come from one calc_subid_range_batch() call instead
+ * of a validated calculation per user. Lines are formatted by hand into
+ * a large buffer that is handed to write(2) whole, which keeps the cost
+ * per line to a few memcpy()s and the system calls to one per buffer.
+ *
+ * A file is written next to its final name and renamed over it once
+ * complete, so readers see either the old or the new table. Nothing is
+ * written at all if any user fails.
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pwd.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Initial element count of the user list */
+enum { EXPORT_INITIAL_CAP = 1024 };
+
+/* Output buffer size, flushed with one write(2) when full */
+enum { EXPORT_BUF_SIZE = 64 * 1024 };
+
+/* Mode of an exported file (matches shadow-utils for /etc/subuid) */
+#define EXPORT_FILE_MODE 0644
+
+/**
+ * struct export_user_t - One user to export
+ * @uid: UID of the user
+ * @name: Offset of the username in the name arena
+ */
+typedef struct {
+  uint32_t uid;
+  size_t name;
+} export_user_t;
+
+/**
+ * struct export_list_t - Users collected for the table
+ * @users: User storage
+ * @len: Users in use
+ * @cap: Users allocated
+ * @names: Usernames, NUL-terminated back to back
+ * @names_len: Bytes of @names in use
+ * @names_cap: Bytes of @names allocated
+ * @failed: Number of entries that could not be added
+ */
+typedef struct {
+  export_user_t *users;
+  size_t len;
+  size_t cap;
+  char *names;
+  size_t names_len;
+  size_t names_cap;
+  size_t failed;
+} export_list_t;
+
+/**
+ * struct export_out_t - Buffered output descriptor
+ * @fd: Descriptor written to
+ * @path: Name for messages
+ * @len: Bytes of @buf in use
+ * @buf: Pending output
+ */
+typedef struct {
+  int fd;
+  const char *path;
+  size_t len;
+  char buf[EXPORT_BUF_SIZE];
+} export_out_t;
+
+/*
+ * Forward declarations for internal functions
+ *
+ * We can use nonnull on static functions because they can only be called
+ * from inside here and we're careful to check the pointers in our visible
+ * function(s).
+ */
+static int grow(const struct syscall_ops *ops, void **buf, size_t used,
+                size_t *cap, size_t need, size_t size)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static int list_add(const struct syscall_ops *ops, export_list_t *list,
+                    const char *name, uint32_t uid) __attribute__((nonnull))
+__attribute__((warn_unused_result));
+static void list_add_entry(const struct syscall_ops *ops,
+                           const config_t *config, export_list_t *list,
+                           const char *entry, char *username,
+                           size_t username_size, bool debug)
+    __attribute__((nonnull));
+static int collect_eligible(const struct syscall_ops *ops,
+                            const config_t *config, export_list_t *list,
+                            bool debug) __attribute__((nonnull))
+__attribute__((warn_unused_result));
+static int compare_users(const void *a, const void *b)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static void list_dedup(export_list_t *list) __attribute__((nonnull));
+static int calc_starts(const config_t *config,
+                       const subid_config_t *subid_cfg,
+                       const export_list_t *list, uint32_t *starts)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static int out_flush(const struct syscall_ops *ops, export_out_t *out)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static int out_append(const struct syscall_ops *ops, export_out_t *out,
+                      const char *data, size_t len) __attribute__((nonnull))
+__attribute__((warn_unused_result));
+static size_t format_u32(char *dst, uint32_t value) __attribute__((nonnull));
+static int write_table(const struct syscall_ops *ops, export_out_t *out,
+                       const export_list_t *list, const uint32_t *starts,
+                       const subid_config_t *subid_cfg)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static int export_to_file(const struct syscall_ops *ops, export_out_t *out,
+                          const char *path, const export_list_t *list,
+                          const uint32_t *starts,
+                          const subid_config_t *subid_cfg, bool debug)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+
+/**
+ * grow - Make room for @need elements in a calloc(3)ed buffer
+ * @ops: Operations structure (needed for calloc)
+ * @buf: Buffer, replaced when it grows
+ * @used: Elements of @buf in use
+ * @cap: Elements allocated, updated when the buffer grows
+ * @need: Elements required
+ * @size: Size of one element
+ *
+ * Return: 0 on success, -1 on allocation failure (@buf untouched)
+ */
+static int grow(const struct syscall_ops *ops, void **buf, size_t used,
+                size_t *cap, size_t need, size_t size) {
+  if (*buf != NULL && need <= *cap) {
+    return 0;
+  }
+
+  size_t grown_cap = *cap == 0 ? EXPORT_INITIAL_CAP : *cap;
+  while (grown_cap < need) {
+    grown_cap *= 2;
+  }
+
+  void *grown = ops->calloc(grown_cap, size);
+  if (grown == NULL) {
+    errno = ENOMEM;
+    (void)fprintf(stderr, "%s: error: memory allocation failed\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+  if (used > 0) {
+    memcpy(grown, *buf, used * size);
+  }
+  ops->free(*buf);
+  *buf = grown;
+  *cap = grown_cap;
+  return 0;
+}
+
+/**
+ * list_add - Append a user to the list
+ * @ops: Operations structure (needed for calloc)
+ * @list: List to grow
+ * @name: Username, copied
+ * @uid: UID of @name
+ *
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int list_add(const struct syscall_ops *ops, export_list_t *list,
+                    const char *name, uint32_t uid) {
+  size_t size = strlen(name) + 1;
+  void *users = list->users;
+  void *names = list->names;
+
+  if (grow(ops, &users, list->len, &list->cap, list->len + 1,
+           sizeof(*list->users)) != 0) {
+    return -1;
+  }
+  list->users = users;
+  if (grow(ops, &names, list->names_len, &list->names_cap,
+           list->names_len + size, 1) != 0) {
+    return -1;
+  }
+  list->names = names;
+
+  memcpy(list->names + list->names_len, name, size);
+  list->users[list->len++] =
+      (export_user_t){.uid = uid, .name = list->names_len};
+  list->names_len += size;
+  return 0;
+}
+
+/**
+ * list_add_entry - Resolve a name-list entry and add it
+ * @ops: Operations structure for system call abstraction
+ * @config: Loaded configuration
+ * @list: List to grow
+ * @entry: Username or UID
+ * @username: Buffer for the resolved name
+ * @username_size: Size of @username
+ * @debug: Enable debug output
+ *
+ * Entries are held to the same rules as a normal run: the user must exist
+ * and be inside [UID_MIN, UID_MAX]. A failure is counted in @list->failed
+ * with the reason on stderr.
+ */
+static void list_add_entry(const struct syscall_ops *ops,
+                           const config_t *config, export_list_t *list,
+                           const char *entry, char *username,
+                           size_t username_size, bool debug) {
+  uint32_t uid = 0;
+
+  if (resolve_user(ops, entry, &uid, username, username_size,
+                   config->resolve_timeout_ms, debug) != 0 ||
+      validate_uid_range(uid, config) != 0 ||
+      list_add(ops, list, username, uid) != 0) {
+    (void)fprintf(stderr, "%s: error: export: %s: failed\n", PROJECT_NAME,
+                  entry);
+    list->failed++;
+  }
+}
+
+/**
+ * collect_eligible - Add every passwd account inside [UID_MIN, UID_MAX]
+ * @ops: Operations structure for system call abstraction
+ * @config: Loaded configuration
+ * @list: List to grow
+ * @debug: Enable debug output
+ *
+ * Names usermod(8) would reject are counted as failures, as in batch mode.
+ *
+ * Return: 0 on success, -1 if the enumeration failed
+ */
+static int collect_eligible(const struct syscall_ops *ops,
+                            const config_t *config, export_list_t *list,
+                            bool debug) {
+  int ret = 0;
+  const struct passwd *pw = NULL;
+
+  ops->setpwent();
+  for (;;) {
+    /* getpwent(3) only reports errors through errno */
+    errno = 0;
+    pw = ops->getpwent();
+    if (pw == NULL) {
+      break;
+    }
+
+    uint32_t uid = (uint32_t)pw->pw_uid;
+    if (uid < config->uid_min || uid > config->uid_max) {
+      continue;
+    }
+
+    const char *name = pw->pw_name != NULL ? pw->pw_name : "";
+    if (validate_username(name) != 0) {
+      (void)fprintf(stderr, "%s: error: export: UID %u: invalid username\n",
+                    PROJECT_NAME, uid);
+      list->failed++;
+      continue;
+    }
+    if (list_add(ops, list, name, uid) != 0) {
+      ret = -1;
+      break;
+    }
+  }
+
+  /* ENOENT is how some NSS modules spell "no more entries" */
+  int saved_errno = errno;
+  ops->endpwent();
+  if (ret == 0 && saved_errno != 0 && saved_errno != ENOENT) {
+    errno = saved_errno;
+    (void)fprintf(stderr, "%s: error: failed enumerating passwd database: %s\n",
+                  PROJECT_NAME, strerror(saved_errno));
+    ret = -1;
+  }
+
+  if (debug) {
+    (void)fprintf(stderr, "%s: debug: export: %zu eligible accounts\n",
+                  PROJECT_NAME, list->len);
+  }
+  return ret;
+}
+
+/**
+ * compare_users - qsort(3) comparator for export_user_t by UID
+ *
+ * Ties keep input order, so the output does not depend on qsort(3).
+ */
+static int compare_users(const void *a, const void *b) {
+  const export_user_t *ua = a;
+  const export_user_t *ub = b;
+  if (ua->uid != ub->uid) {
+    return ua->uid < ub->uid ? -1 : 1;
+  }
+  if (ua->name != ub->name) {
+    return ua->name < ub->name ? -1 : 1;
+  }
+  return 0;
+}
+
+/**
+ * list_dedup - Drop users listed more than once
+ * @list: Users sorted by UID
+ *
+ * A name list may give the same user by name and by UID; the table gets
+ * one line for it. Different names sharing a UID all stay.
+ */
+static void list_dedup(export_list_t *list) {
+  size_t kept = 0;
+  for (size_t i = 0; i < list->len; i++) {
+    bool seen = false;
+    for (size_t j = kept; j > 0 && list->users[j - 1].uid == list->users[i].uid;
+         j--) {
+      if (strcmp(list->names + list->users[j - 1].name,
+                 list->names + list->users[i].name) == 0) {
+        seen = true;
+        break;
+      }
+    }
+    if (!seen) {
+      list->users[kept++] = list->users[i];
+    }
+  }
+  list->len = kept;
+}
+
+/**
+ * calc_starts - Calculate the range start of every listed user
+ * @config: Loaded configuration
+ * @subid_cfg: Range configuration of the exported table
+ * @list: Users sorted by UID
+ * @starts: Output, one start per user
+ *
+ * Each run of consecutive UIDs is one calc_subid_range_batch() call
+ * written straight into @starts; users sharing a UID share its start.
+ * Runs are split at duplicates, so a band never contains a UID twice.
+ *
+ * Return: 0 on success, -1 if any range cannot be calculated
+ */
+static int calc_starts(const config_t *config,
+                       const subid_config_t *subid_cfg,
+                       const export_list_t *list, uint32_t *starts) {
+  size_t i = 0;
+  while (i < list->len) {
+    if (i > 0 && list->users[i].uid == list->users[i - 1].uid) {
+      starts[i] = starts[i - 1];
+      i++;
+      continue;
+    }
+
+    size_t run = 1;
+    while (i + run < list->len &&
+           list->users[i + run].uid == list->users[i + run - 1].uid + 1) {
+      run++;
+    }
+
+    if (calc_subid_range_batch(list->users[i].uid, run, config->uid_min,
+                               subid_cfg, config->allow_subid_wrap,
+                               &starts[i]) != 0) {
+      (void)fprintf(stderr,
+                    "%s: error: export: cannot calculate ranges for UIDs "
+                    "%u-%u\n",
+                    PROJECT_NAME, list->users[i].uid,
+                    list->users[i + run - 1].uid);
+      return -1;
+    }
+    i += run;
+  }
+  return 0;
+}
+
+/**
+ * out_flush - Write the pending output
+ * @ops: Operations structure for system call abstraction
+ * @out: Output
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int out_flush(const struct syscall_ops *ops, export_out_t *out) {
+  size_t done = 0;
+  while (done < out->len) {
+    ssize_t written = ops->write(out->fd, out->buf + done, out->len - done);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      (void)fprintf(stderr, "%s: error: cannot write %s: %s\n", PROJECT_NAME,
+                    out->path, strerror(errno));
+      return -1;
+    }
+    done += (size_t)written;
+  }
+  out->len = 0;
+  return 0;
+}
+
+/**
+ * out_append - Add bytes to the output, flushing when the buffer is full
+ * @ops: Operations structure for system call abstraction
+ * @out: Output
+ * @data: Bytes to add
+ * @len: Number of bytes, at most EXPORT_BUF_SIZE
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int out_append(const struct syscall_ops *ops, export_out_t *out,
+                      const char *data, size_t len) {
+  if (out->len + len > sizeof(out->buf) && out_flush(ops, out) != 0) {
+    return -1;
+  }
+  memcpy(out->buf + out->len, data, len);
+  out->len += len;
+  return 0;
+}
+
+/**
+ * format_u32 - Write @value in decimal, without NUL
+ * @dst: Destination, at least UINT32_DECIMAL_MAX_LEN bytes
+ * @value: Value to format
+ *
+ * Return: Number of digits written
+ */
+static size_t format_u32(char *dst, uint32_t value) {
+  char digits[UINT32_DECIMAL_MAX_LEN] = {0};
+  size_t n = 0;
+  do {
+    digits[n++] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+
+  for (size_t i = 0; i < n; i++) {
+    dst[i] = digits[n - 1 - i];
+  }
+  return n;
+}
+
+/**
+ * write_table - Format every line of the table into @out
+ * @ops: Operations structure for system call abstraction
+ * @out: Output
+ * @list: Users sorted by UID
+ * @starts: Start of range per user
+ * @subid_cfg: Subordinate ID configuration, for the count of each user
+ *
+ * The users are sorted by UID, so the count only changes at a band
+ * boundary and is formatted again only there.
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int write_table(const struct syscall_ops *ops, export_out_t *out,
+                       const export_list_t *list, const uint32_t *starts,
+                       const subid_config_t *subid_cfg) {
+  /* ":<start>:<count>\n" */
+  char tail[2 * UINT32_DECIMAL_MAX_LEN + 3] = {0};
+  char count_str[UINT32_DECIMAL_MAX_LEN] = {0};
+  uint32_t count = 0;
+  size_t count_len = 0;
+
+  for (size_t i = 0; i < list->len; i++) {
+    const char *name = list->names + list->users[i].name;
+    size_t len = 0;
+
+    uint32_t want = calc_subid_count(list->users[i].uid, subid_cfg);
+    if (count_len == 0 || want != count) {
+      count = want;
+      count_len = format_u32(count_str, count);
+    }
+
+    tail[len++] = ':';
+    len += format_u32(tail + len, starts[i]);
+    tail[len++] = ':';
+    memcpy(tail + len, count_str, count_len);
+    len += count_len;
+    tail[len++] = '\n';
+
+    if (out_append(ops, out, name, strlen(name)) != 0 ||
+        out_append(ops, out, tail, len) != 0) {
+      return -1;
+    }
+  }
+  return out_flush(ops, out);
+}
+
+/**
+ * export_to_file - Write the table to <path>.<pid>+ and rename it to @path
+ * @ops: Operations structure for system call abstraction
+ * @out: Output buffer to use
+ * @path: Final path
+ * @list: Users sorted by UID
+ * @starts: Start of range per user
+ * @subid_cfg: Subordinate ID configuration, for the count of each user
+ * @debug: Enable debug output
+ *
+ * Return: 0 on success, -1 on error (nothing left behind)
+ */
+static int export_to_file(const struct syscall_ops *ops, export_out_t *out,
+                          const char *path, const export_list_t *list,
+                          const uint32_t *starts,
+                          const subid_config_t *subid_cfg, bool debug) {
+  char tmppath[PATH_MAX] = {0};
+  int len = snprintf(tmppath, sizeof(tmppath), "%s.%ld+", path,
+                     (long)getpid());
+  if (len < 0 || (size_t)len >= sizeof(tmppath)) {
+    errno = ENAMETOOLONG;
+    (void)fprintf(stderr, "%s: error: path too long: %s\n", PROJECT_NAME,
+                  path);
+    return -1;
+  }
+
+  out->fd = ops->open(tmppath, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC |
+                                   O_NOFOLLOW,
+                      EXPORT_FILE_MODE);
+  if (out->fd < 0) {
+    (void)fprintf(stderr, "%s: error: cannot create %s: %s\n", PROJECT_NAME,
+                  tmppath, strerror(errno));
+    return -1;
+  }
+  out->path = tmppath;
+
+  int ret = 0;
+  if (ops->fchmod(out->fd, EXPORT_FILE_MODE) != 0) {
+    (void)fprintf(stderr, "%s: error: cannot chmod %s: %s\n", PROJECT_NAME,
+                  tmppath, strerror(errno));
+    ret = -1;
+  } else if (write_table(ops, out, list, starts, subid_cfg) != 0) {
+    ret = -1;
+  } else if (ops->fsync(out->fd) != 0) {
+    (void)fprintf(stderr, "%s: error: cannot fsync %s: %s\n", PROJECT_NAME,
+                  tmppath, strerror(errno));
+    ret = -1;
+  }
+
+  if (ops->close(out->fd) != 0 && ret == 0) {
+    (void)fprintf(stderr, "%s: error: cannot close %s: %s\n", PROJECT_NAME,
+                  tmppath, strerror(errno));
+    ret = -1;
+  }
+
+  if (ret == 0 && ops->rename(tmppath, path) != 0) {
+    (void)fprintf(stderr, "%s: error: cannot rename %s to %s: %s\n",
+                  PROJECT_NAME, tmppath, path, strerror(errno));
+    ret = -1;
+  }
+
+  if (ret != 0) {
+    int saved_errno = errno;
+    (void)ops->unlink(tmppath);
+    errno = saved_errno;
+  } else if (debug) {
+    (void)fprintf(stderr, "%s: debug: export: wrote %zu entries to %s\n",
+                  PROJECT_NAME, list->len, path);
+  }
+  return ret;
+}
+
+/**
+ * export_run - Write the table for the users selected by @opts
+ * @ops: Operations structure for system call abstraction
+ * @config: Loaded configuration
+ * @opts: Runtime options (@opts->export_path, --subgid, the user source)
+ * @in: Name list to read, one entry per line, or NULL
+ *
+ * Users come from @in when given, else from the positional arguments,
+ * else from the passwd database. The table goes to @opts->export_path,
+ * or to standard output for "-".
+ *
+ * Return: 0 on success, -1 on error (nothing written)
+ */
+int export_run(const struct syscall_ops *ops, const config_t *config,
+               const options_t *opts, FILE *in) {
+  if (ops == NULL || config == NULL || opts == NULL ||
+      opts->export_path == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: NULL parameter in export_run\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  const subid_config_t *subid_cfg =
+      opts->do_subgid ? &config->subgid : &config->subuid;
+  export_list_t list = {0};
+  int ret = 0;
+
+  if (in != NULL || opts->user_argc > 0) {
+    long name_max = sysconf(_SC_LOGIN_NAME_MAX);
+    // LCOV_EXCL_START
+    if (name_max <= 0) {
+      errno = ENOSYS;
+      (void)fprintf(stderr, "%s: error: invalid _SC_LOGIN_NAME_MAX: %ld\n",
+                    PROJECT_NAME, name_max);
+      return -1;
+    }
+    // LCOV_EXCL_STOP
+
+    /* +1 for NUL terminator */
+    size_t username_size = (size_t)name_max + 1;
+    char *username = ops->calloc(username_size, sizeof(*username));
+    if (username == NULL) {
+      errno = ENOMEM;
+      (void)fprintf(stderr, "%s: error: memory allocation failed\n",
+                    PROJECT_NAME);
+      return -1;
+    }
+
+    if (in != NULL) {
+      char *line = NULL;
+      size_t cap = 0;
+      const char *entry = NULL;
+      int delim = opts->null_sep ? '\0' : '\n';
+      while ((entry = batch_read_entry(in, delim, &line, &cap)) != NULL) {
+        list_add_entry(ops, config, &list, entry, username, username_size,
+                       opts->debug);
+      }
+      if (ferror(in)) {
+        (void)fprintf(stderr, "%s: error: failed reading name list\n",
+                      PROJECT_NAME);
+        ret = -1;
+      }
+      ops->free(line);
+    } else {
+      for (int i = 0; i < opts->user_argc; i++) {
+        list_add_entry(ops, config, &list, opts->user_args[i], username,
+                       username_size, opts->debug);
+      }
+    }
+    ops->free(username);
+  } else {
+    ret = collect_eligible(ops, config, &list, opts->debug);
+  }
+
+  if (ret == 0 && list.failed > 0) {
+    (void)fprintf(stderr, "%s: error: export: %zu entries failed, nothing "
+                          "written\n",
+                  PROJECT_NAME, list.failed);
+    ret = -1;
+  }
+
+  if (ret == 0 && list.len > 1) {
+    qsort(list.users, list.len, sizeof(*list.users), compare_users);
+    list_dedup(&list);
+  }
+
+  uint32_t *starts = NULL;
+  export_out_t *out = NULL;
+  if (ret == 0) {
+    starts = ops->calloc(list.len > 0 ? list.len : 1, sizeof(*starts));
+    out = ops->calloc(1, sizeof(*out));
+    if (starts == NULL || out == NULL) {
+      errno = ENOMEM;
+      (void)fprintf(stderr, "%s: error: memory allocation failed\n",
+                    PROJECT_NAME);
+      ret = -1;
+    }
+  }
+
+  if (ret == 0) {
+    ret = calc_starts(config, subid_cfg, &list, starts);
+  }
+
+  if (ret == 0) {
+    if (strcmp(opts->export_path, "-") == 0) {
+      out->fd = STDOUT_FILENO;
+      out->path = "standard output";
+      ret = write_table(ops, out, &list, starts, subid_cfg);
+    } else {
+      ret = export_to_file(ops, out, opts->export_path, &list, starts,
+                           subid_cfg, opts->debug);
+    }
+  }
+
+  ops->free(out);
+  ops->free(starts);
+  ops->free(list.users);
+  ops->free(list.names);
+  return ret;
+}
@@ -0,0 +1,236 @@
+/**
+ * libsubid_static_subid.c - shadow-utils subid provider module
+ *
+ * Built as libsubid_static_subid.so and loaded by libsubid when
+ * nsswitch.conf(5) has
+ *
+ *   subid: static_subid
+ *
+ * after which newuidmap(1), newgidmap(1), getsubids(1) and everything
+ * else using libsubid get their ranges from the formula (see
+ * nss_subid.c) instead of /etc/subuid and /etc/subgid. Nothing is ever
+ * written, so no user needs to be enrolled at login.
+ *
+ * The configuration is loaded once per process, from the snapshot in
+ * STAMP_DIR when it is current and from the sources otherwise; the
+ * snapshot is never written from here since the caller may be setuid.
+ *
+ * The types below mirror shadow-utils' lib/subid.h, which is not
+ * installed; they are part of its module ABI and cannot change. Only the
+ * shadow_subid_* symbols are exported from the module.
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <threads.h>
+
+/* enum subid_type from shadow-utils lib/subid.h */
+enum subid_type {
+  ID_TYPE_UID = 1,
+  ID_TYPE_GID = 2,
+};
+
+/* enum subid_status from shadow-utils lib/subid.h */
+enum subid_status {
+  SUBID_STATUS_SUCCESS = 0,
+  SUBID_STATUS_UNKNOWN_USER = 1,
+  SUBID_STATUS_ERROR_CONN = 2,
+  SUBID_STATUS_ERROR = 3,
+};
+
+/* struct subid_range from shadow-utils lib/subid.h */
+struct subid_range {
+  unsigned long start;
+  unsigned long count;
+};
+
+/* The owner list is handed to libsubid as uid_t without copying */
+_Static_assert(sizeof(uid_t) == sizeof(uint32_t), "uid_t must be 32 bits");
+
+#define SUBID_EXPORT __attribute__((visibility("default")))
+
+/* Module entry points, looked up by name with dlsym(3) */
+SUBID_EXPORT enum subid_status
+shadow_subid_has_range(const char *owner, unsigned long start,
+                       unsigned long count, enum subid_type idtype,
+                       bool *result);
+SUBID_EXPORT enum subid_status
+shadow_subid_list_owner_ranges(const char *owner, enum subid_type id_type,
+                               struct subid_range **ranges, int *count);
+SUBID_EXPORT enum subid_status
+shadow_subid_find_subid_owners(unsigned long id, enum subid_type id_type,
+                               uid_t **uids, int *count);
+SUBID_EXPORT void shadow_subid_free(void *ptr);
+
+/* Configuration shared by every call, loaded by load_once() */
+static config_t module_config = {0};
+static bool module_config_ok = false;
+static once_flag module_config_once = ONCE_FLAG_INIT;
+
+/* Forward declarations for internal functions */
+static void load_once(void);
+static const config_t *module_config_get(void)
+    __attribute__((warn_unused_result));
+static enum subid_status status_from_errno(int err)
+    __attribute__((warn_unused_result));
+
+/**
+ * load_once - Load the configuration into module_config
+ *
+ * Run through call_once(), so concurrent first calls load it only once.
+ */
+static void load_once(void) {
+  uint64_t fingerprint = 0;
+
+  if (stamp_fingerprint(&syscall_ops_default, &fingerprint, false) == 0 &&
+      config_cache_load(&syscall_ops_default, STAMP_DIR, fingerprint,
+                        &module_config, false) == 1) {
+    module_config_ok = true;
+    return;
+  }
+  module_config_ok =
+      load_configuration(&syscall_ops_default, &module_config, false) == 0;
+}
+
+/**
+ * module_config_get - The process-wide configuration
+ *
+ * Return: Loaded configuration, NULL if it could not be loaded
+ */
+static const config_t *module_config_get(void) {
+  call_once(&module_config_once, load_once);
+  return module_config_ok ? &module_config : NULL;
+}
+
+/**
+ * status_from_errno - Map a failure to the libsubid status
+ * @err: errno of the failure
+ *
+ * Return: SUBID_STATUS_UNKNOWN_USER for ENOENT, SUBID_STATUS_ERROR otherwise
+ */
+static enum subid_status status_from_errno(int err) {
+  return err == ENOENT ? SUBID_STATUS_UNKNOWN_USER : SUBID_STATUS_ERROR;
+}
+
+/**
+ * shadow_subid_has_range - May @owner map [@start, @start+@count)?
+ * @owner: Username
+ * @start: First ID asked for
+ * @count: Number of IDs asked for
+ * @idtype: ID_TYPE_UID or ID_TYPE_GID
+ * @result: Set to the answer
+ *
+ * Return: enum subid_status
+ */
+enum subid_status shadow_subid_has_range(const char *owner,
+                                         unsigned long start,
+                                         unsigned long count,
+                                         enum subid_type idtype,
+                                         bool *result) {
+  const config_t *config = module_config_get();
+  if (config == NULL || owner == NULL || result == NULL) {
+    return SUBID_STATUS_ERROR;
+  }
+
+  if (nss_subid_has_range(&syscall_ops_default, config, owner, start, count,
+                          idtype == ID_TYPE_GID, result) != 0) {
+    return status_from_errno(errno);
+  }
+  return SUBID_STATUS_SUCCESS;
+}
+
+/**
+ * shadow_subid_list_owner_ranges - Ranges of @owner
+ * @owner: Username
+ * @id_type: ID_TYPE_UID or ID_TYPE_GID
+ * @ranges: Set to a malloc(3)ed array (freed with shadow_subid_free())
+ * @count: Set to the number of ranges, 0 or 1
+ *
+ * Return: enum subid_status
+ */
+enum subid_status shadow_subid_list_owner_ranges(const char *owner,
+                                                 enum subid_type id_type,
+                                                 struct subid_range **ranges,
+                                                 int *count) {
+  const config_t *config = module_config_get();
+  if (config == NULL || owner == NULL || ranges == NULL || count == NULL) {
+    return SUBID_STATUS_ERROR;
+  }
+
+  subid_range_t range = {0};
+  size_t found = 0;
+  *ranges = NULL;
+  *count = 0;
+
+  if (nss_subid_range(&syscall_ops_default, config, owner,
+                      id_type == ID_TYPE_GID, &range, &found) != 0) {
+    return status_from_errno(errno);
+  }
+  if (found == 0) {
+    return SUBID_STATUS_SUCCESS;
+  }
+
+  *ranges = calloc(1, sizeof(**ranges));
+  if (*ranges == NULL) {
+    return SUBID_STATUS_ERROR;
+  }
+  (*ranges)[0] = (struct subid_range){.start = range.start,
+                                      .count = range.count};
+  *count = 1;
+  return SUBID_STATUS_SUCCESS;
+}
+
+/**
+ * shadow_subid_find_subid_owners - UIDs whose range contains @id
+ * @id: Subordinate ID
+ * @id_type: ID_TYPE_UID or ID_TYPE_GID
+ * @uids: Set to a malloc(3)ed array (freed with shadow_subid_free())
+ * @count: Set to the number of UIDs
+ *
+ * Return: enum subid_status
+ */
+enum subid_status shadow_subid_find_subid_owners(unsigned long id,
+                                                 enum subid_type id_type,
+                                                 uid_t **uids, int *count) {
+  const config_t *config = module_config_get();
+  if (config == NULL || uids == NULL || count == NULL) {
+    return SUBID_STATUS_ERROR;
+  }
+
+  uint32_t *list = NULL;
+  size_t found = 0;
+  *uids = NULL;
+  *count = 0;
+
+  if (nss_subid_owners(&syscall_ops_default, config, id,
+                       id_type == ID_TYPE_GID, &list, &found) != 0) {
+    return SUBID_STATUS_ERROR;
+  }
+  // LCOV_EXCL_START
+  if (found > INT_MAX) {
+    (void)free(list);
+    return SUBID_STATUS_ERROR;
+  }
+  // LCOV_EXCL_STOP
+
+  *uids = list;
+  *count = (int)found;
+  return SUBID_STATUS_SUCCESS;
+}
+
+/**
+ * shadow_subid_free - Release memory returned by this module
+ * @ptr: Array from shadow_subid_list_owner_ranges() or
+ *       shadow_subid_find_subid_owners()
+ */
+void shadow_subid_free(void *ptr) { (void)free(ptr); }
@@ -19,15 +19,78 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
+/*
+ * Exit statuses of --check-only and --condition. systemd skips the rest of
+ * a unit when an ExecCondition= command exits 1 through 254, so --condition
+ * reports "nothing to do" as 1 and lets the real run handle everything else.
+ */
+enum {
+  CHECK_EXIT_NEEDED = 2,
+  CONDITION_EXIT_RUN = EXIT_SUCCESS,
+  CONDITION_EXIT_SKIP = 1,
+};
+
+/* Exit status of --audit when the databases have findings */
+enum { AUDIT_EXIT_FINDINGS = 2 };
+
+/* Exit status of --owner-of when some ID belongs to no user */
+enum { OWNER_EXIT_UNOWNED = 2 };
+
+/* Exit status of --verify when the dumps have findings */
+enum { VERIFY_EXIT_FINDINGS = 2 };
+
+/* Exit status when NSS did not answer within RESOLVE_TIMEOUT_MS */
+enum { RESOLVE_EXIT_TIMEOUT = 3 };
+
+/* Exit status of --request and --wait when --timeout ran out first */
+enum { WAIT_EXIT_TIMEOUT = 3 };
+
+/* Longest --timeout, in seconds */
+enum { WAIT_TIMEOUT_MAX_SEC = 24 * 60 * 60 };
+
+/*
+ * A socket-activated daemon exits after this long without a client;
+ * systemd starts it again on the next connection
+ */
+enum { DAEMON_IDLE_TIMEOUT_MS = 5 * 60 * 1000 };
+
 /* Forward declarations for internal functions */
 static void print_help(bool dump_config, bool debug) __attribute__((cold));
 static int parse_arguments(int argc, char *argv[], options_t *opts)
     __attribute__((warn_unused_result));
-static int process_mode(const char *username, uint32_t uid,
-                        const config_t *config, subid_mode_t mode,
-                        const options_t *opts)
+static void finish(const options_t *opts, const char *username,
+                   uint64_t started, int status) __attribute__((noreturn));
+static int load_config(config_t *config, const options_t *opts,
+                       const uint64_t *fingerprint)
+    __attribute__((warn_unused_result));
+static int run_batch(const config_t *config, const options_t *opts)
+    __attribute__((warn_unused_result));
+static int check_exit(const options_t *opts, int done)
+    __attribute__((warn_unused_result));
+static int run_daemon(config_t *config, const options_t *opts,
+                      const uint64_t *fingerprint)
+    __attribute__((warn_unused_result));
+static int run_request(config_t *config, const options_t *opts,
+                       const uint64_t *fingerprint, char *username,
+                       size_t username_size)
+    __attribute__((warn_unused_result));
+static int run_wait(config_t *config, const options_t *opts,
+                    const uint64_t *fingerprint, char *username,
+                    size_t username_size) __attribute__((warn_unused_result));
+static int run_audit(config_t *config, const options_t *opts,
+                     const uint64_t *fingerprint)
+    __attribute__((warn_unused_result));
+static int run_owner_of(config_t *config, const options_t *opts,
+                        const uint64_t *fingerprint)
+    __attribute__((warn_unused_result));
+static int run_export(config_t *config, const options_t *opts,
+                      const uint64_t *fingerprint)
+    __attribute__((warn_unused_result));
+static int run_verify(config_t *config, const options_t *opts,
+                      const uint64_t *fingerprint)
     __attribute__((warn_unused_result));
 
 /**
@@ -40,6 +103,20 @@ static int process_mode(const char *username, uint32_t uid,
  */
 static void print_help(bool dump_config, bool debug) {
   (void)printf("Usage: %s [OPTIONS] <username|uid>\n", PROJECT_NAME);
+  (void)printf("       %s [OPTIONS] --batch [username|uid ...]\n",
+               PROJECT_NAME);
+  (void)printf("       %s [OPTIONS] --all-eligible\n", PROJECT_NAME);
+  (void)printf("       %s [OPTIONS] --daemon\n", PROJECT_NAME);
+  (void)printf("       %s [--subuid] [--subgid] [--timeout SECONDS] "
+               "--request\n",
+               PROJECT_NAME);
+  (void)printf("       %s [OPTIONS] --wait <username|uid>\n", PROJECT_NAME);
+  (void)printf("       %s [OPTIONS] --audit\n", PROJECT_NAME);
+  (void)printf("       %s [OPTIONS] --owner-of ID|-\n", PROJECT_NAME);
+  (void)printf("       %s [OPTIONS] --export FILE|- [--batch] "
+               "[username|uid ...]\n",
+               PROJECT_NAME);
+  (void)printf("       %s [OPTIONS] --verify [FILE ...]\n", PROJECT_NAME);
   (void)printf("Version: %s\n", VERSION);
   (void)printf("\n");
   (void)printf(
@@ -54,11 +131,61 @@ static void print_help(bool dump_config, bool debug) {
   (void)printf("  -h, --help\t\tDisplay this help and exit\n");
   (void)printf("  --dump-config\t\tUse only with --help to also print "
                "loaded configuration\n");
+  (void)printf("  --batch\t\tProcess every argument (or stdin) as a "
+               "separate user\n");
+  (void)printf("  --from-file FILE\tRead batch entries from FILE "
+               "('-' for stdin)\n");
+  (void)printf("  -0, --null\t\tBatch entries are NUL-separated\n");
+  (void)printf("  --all-eligible\tBatch over every account with UID_MIN <= "
+               "UID <= UID_MAX\n");
+  (void)printf("  --jobs N\t\tResolve up to N batch entries (or read N "
+               "--verify inputs) in\n\t\t\tparallel "
+               "(1-%d, default 1)\n",
+               RESOLVE_JOBS_MAX);
+  (void)printf("  --stamp-cache\t\tSkip users already done under the "
+               "current config\n");
+  (void)printf("  --check-only\t\tExit 0 if nothing to do, %d if work is "
+               "needed\n",
+               CHECK_EXIT_NEEDED);
+  (void)printf("  --condition\t\tLike --check-only, with ExecCondition= "
+               "exit codes\n");
+  (void)printf("  --daemon\t\tServe the UID of each client connecting to "
+               "%s\n",
+               DAEMON_SOCKET_PATH);
+  (void)printf("  --request\t\tAsk the daemon for the caller's own "
+               "ranges (with --subuid\n\t\t\tor --subgid, only if they "
+               "are not in place)\n");
+  (void)printf("  --wait\t\tBlock until the user's ranges are in place, "
+               "assign nothing\n");
+  (void)printf("  --timeout SECONDS\tWait at most SECONDS for --request or "
+               "--wait (default %d,\n\t\t\t0 queues the request without "
+               "waiting; exit %d when\n\t\t\tit runs out)\n",
+               WAIT_TIMEOUT_DEFAULT_SEC, WAIT_EXIT_TIMEOUT);
+  (void)printf("  --audit\t\tReport overlapping, non-deterministic and "
+               "misplaced ranges\n\t\t\t(exit %d if any are found)\n",
+               AUDIT_EXIT_FINDINGS);
+  (void)printf("  --owner-of ID\t\tPrint the user the subordinate ID is "
+               "calculated for\n\t\t\t('-' reads IDs from stdin, exit %d "
+               "if any has none)\n",
+               OWNER_EXIT_UNOWNED);
+  (void)printf("  --export FILE\t\tWrite the whole subuid or subgid table "
+               "to FILE ('-' for\n\t\t\tstdout) for the given users, batch "
+               "input or all eligible\n");
+  (void)printf("  --stats[=FORMAT]\tReport phase timings and counters as "
+               "json (stderr,\n\t\t\tdefault) and/or journal, "
+               "comma-separated\n");
+  (void)printf("  --verify\t\tCheck subuid or subgid dumps of many hosts "
+               "(FILE, tar or\n\t\t\t'==> HOST <==' stream, stdin by "
+               "default; exit %d if\n\t\t\tany differ)\n",
+               VERIFY_EXIT_FINDINGS);
   (void)printf("\n");
   (void)printf("Arguments:\n");
   (void)printf("  username\tUsername (must follow shadow-utils rules)\n");
   (void)printf("  uid\t\tNumeric UID\n");
   (void)printf("\n");
+  (void)printf("In batch mode configuration is loaded once and each user "
+               "gets its own\nstatus line followed by a summary.\n");
+  (void)printf("\n");
   (void)printf("Both --subuid and --subgid can be specified together.\n");
   (void)printf("Use getsubids (from shadow-utils) to look for existing "
                "assigned ranges.\n");
@@ -72,9 +199,17 @@ static void print_help(bool dump_config, bool debug) {
 
   if (dump_config) {
     config_t config = {0};
-    if (load_configuration(&syscall_ops_default, &config, debug) == 0) {
+    uint64_t fingerprint = 0;
+    bool cached =
+        stamp_fingerprint(&syscall_ops_default, &fingerprint, debug) == 0 &&
+        config_cache_load(&syscall_ops_default, STAMP_DIR, fingerprint,
+                          &config, debug) == 1;
+    if (cached ||
+        load_configuration(&syscall_ops_default, &config, debug) == 0) {
       (void)printf("Parsed Configuration (including defaults):\n");
       (void)print_configuration(&config, stdout, NULL);
+      (void)printf("\nConfiguration snapshot %s/config.cache: %s\n",
+                   STAMP_DIR, cached ? "used" : "not used");
     } else {
       (void)fprintf(stderr,
                     "%s: error: failed to load configuration, try --debug\n",
@@ -109,7 +244,26 @@ static int parse_arguments(int argc, char *argv[], options_t *opts) {
       .noop = false,
       .help = false,
       .dump_config = false,
+      .batch = false,
+      .null_sep = false,
+      .batch_file = NULL,
+      .all_eligible = false,
+      .stamp_cache = false,
+      .check_only = false,
+      .condition = false,
+      .daemon = false,
+      .request = false,
+      .audit = false,
+      .owner_of = NULL,
+      .export_path = NULL,
+      .jobs = 1,
+      .stats = 0,
+      .verify = false,
+      .wait = false,
+      .timeout = WAIT_TIMEOUT_DEFAULT_SEC,
       .user_arg = NULL,
+      .user_args = NULL,
+      .user_argc = 0,
   };
 
   static struct option long_options[] = {
@@ -119,11 +273,29 @@ static int parse_arguments(int argc, char *argv[], options_t *opts) {
       {"noop", no_argument, NULL, 'n'},
       {"help", no_argument, NULL, 'h'},
       {"dump-config", no_argument, NULL, 1001},
+      {"batch", no_argument, NULL, 1002},
+      {"from-file", required_argument, NULL, 1003},
+      {"null", no_argument, NULL, '0'},
+      {"all-eligible", no_argument, NULL, 1004},
+      {"stamp-cache", no_argument, NULL, 1005},
+      {"check-only", no_argument, NULL, 1006},
+      {"condition", no_argument, NULL, 1007},
+      {"daemon", no_argument, NULL, 1008},
+      {"request", no_argument, NULL, 1009},
+      {"audit", no_argument, NULL, 1010},
+      {"owner-of", required_argument, NULL, 1011},
+      {"export", required_argument, NULL, 1012},
+      {"jobs", required_argument, NULL, 1013},
+      {"stats", optional_argument, NULL, 1014},
+      {"verify", no_argument, NULL, 1015},
+      {"wait", no_argument, NULL, 1016},
+      {"timeout", required_argument, NULL, 1017},
       {"version", no_argument, NULL, 1000},
       {NULL, 0, NULL, 0}};
 
+  bool timeout_given = false;
   int opt = 0;
-  while ((opt = getopt_long(argc, argv, "ugdnh", long_options, NULL)) != -1) {
+  while ((opt = getopt_long(argc, argv, "ugdnh0", long_options, NULL)) != -1) {
     switch (opt) {
     case 'u':
       opts->do_subuid = true;
@@ -143,6 +315,87 @@ static int parse_arguments(int argc, char *argv[], options_t *opts) {
     case 1001: /* --dump-config */
       opts->dump_config = true;
       break;
+    case 1002: /* --batch */
+      opts->batch = true;
+      break;
+    case 1003: /* --from-file */
+      opts->batch = true;
+      opts->batch_file = optarg;
+      break;
+    case '0':
+      opts->null_sep = true;
+      break;
+    case 1004: /* --all-eligible */
+      opts->batch = true;
+      opts->all_eligible = true;
+      break;
+    case 1005: /* --stamp-cache */
+      opts->stamp_cache = true;
+      break;
+    case 1006: /* --check-only */
+      opts->check_only = true;
+      break;
+    case 1007: /* --condition */
+      opts->check_only = true;
+      opts->condition = true;
+      break;
+    case 1008: /* --daemon */
+      opts->daemon = true;
+      break;
+    case 1009: /* --request */
+      opts->request = true;
+      break;
+    case 1010: /* --audit */
+      opts->audit = true;
+      break;
+    case 1011: /* --owner-of */
+      opts->owner_of = optarg;
+      break;
+    case 1012: /* --export */
+      opts->export_path = optarg;
+      break;
+    case 1013: { /* --jobs */
+      uint32_t jobs = 0;
+      if (parse_uint32_strict(optarg, &jobs) != 0 || jobs == 0 ||
+          jobs > RESOLVE_JOBS_MAX) {
+        errno = EINVAL;
+        (void)fprintf(stderr,
+                      "%s: error: --jobs must be between 1 and %d: %s\n",
+                      PROJECT_NAME, RESOLVE_JOBS_MAX, optarg);
+        return -1;
+      }
+      opts->jobs = jobs;
+      break;
+    }
+    case 1014: /* --stats */
+      if (stats_parse_formats(optarg, &opts->stats) != 0) {
+        (void)fprintf(stderr,
+                      "%s: error: --stats takes json, journal or both: %s\n",
+                      PROJECT_NAME, optarg);
+        return -1;
+      }
+      break;
+    case 1015: /* --verify */
+      opts->verify = true;
+      break;
+    case 1016: /* --wait */
+      opts->wait = true;
+      break;
+    case 1017: { /* --timeout */
+      uint32_t timeout = 0;
+      if (parse_uint32_strict(optarg, &timeout) != 0 ||
+          timeout > WAIT_TIMEOUT_MAX_SEC) {
+        errno = EINVAL;
+        (void)fprintf(stderr,
+                      "%s: error: --timeout must be between 0 and %d "
+                      "seconds: %s\n",
+                      PROJECT_NAME, WAIT_TIMEOUT_MAX_SEC, optarg);
+        return -1;
+      }
+      opts->timeout = timeout;
+      timeout_given = true;
+      break;
+    }
     case 1000: /* --version */
       (void)printf("%s: version %s\n", PROJECT_NAME, VERSION);
       exit(EXIT_SUCCESS);
@@ -159,21 +412,249 @@ static int parse_arguments(int argc, char *argv[], options_t *opts) {
     return -1;
   }
 
-  /* Check for user argument (unless --help) */
+  /* -0 only changes how batch input is split */
+  if (opts->null_sep && !opts->batch) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: --null only valid in batch mode\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  /* Only batch entries are resolved in parallel; --export resolves its own */
+  if (opts->jobs > 1 && !opts->verify &&
+      (!opts->batch || opts->export_path != NULL)) {
+    errno = EINVAL;
+    (void)fprintf(stderr,
+                  "%s: error: --jobs only valid in batch mode without "
+                  "--export, or with --verify\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  if (opts->batch_file != NULL && optind < argc) {
+    errno = EINVAL;
+    (void)fprintf(stderr,
+                  "%s: error: --from-file cannot be combined with user "
+                  "arguments\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  /* --all-eligible takes its entries from the passwd database only */
+  if (opts->all_eligible &&
+      (optind < argc || opts->batch_file != NULL || opts->null_sep)) {
+    errno = EINVAL;
+    (void)fprintf(stderr,
+                  "%s: error: --all-eligible cannot be combined with user "
+                  "arguments, --from-file or --null\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  /* Stamps are per UID; batch runs load the configuration only once */
+  if (opts->stamp_cache && opts->batch) {
+    errno = EINVAL;
+    (void)fprintf(stderr,
+                  "%s: error: --stamp-cache cannot be combined with batch "
+                  "mode\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  if (opts->check_only && opts->batch) {
+    errno = EINVAL;
+    (void)fprintf(stderr,
+                  "%s: error: --check-only cannot be combined with batch "
+                  "mode\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  /* The daemon serves its peers, --request always asks for the caller */
+  if ((opts->daemon || opts->request) &&
+      (opts->batch || opts->check_only || optind < argc)) {
+    errno = EINVAL;
+    (void)fprintf(stderr,
+                  "%s: error: --daemon and --request cannot be combined with "
+                  "batch mode, --check-only or user arguments\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  if (opts->daemon && opts->request) {
+    errno = EINVAL;
+    (void)fprintf(stderr,
+                  "%s: error: --daemon and --request are mutually "
+                  "exclusive\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  /* The audit reads whole databases and never assigns anything */
+  if (opts->audit && (opts->batch || opts->check_only || opts->daemon ||
+                      opts->request || opts->stamp_cache || optind < argc)) {
+    errno = EINVAL;
+    (void)fprintf(stderr,
+                  "%s: error: --audit cannot be combined with batch mode, "
+                  "--check-only, --stamp-cache, --daemon, --request or user "
+                  "arguments\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  /* The owner is calculated, not looked up, and only for one kind of ID */
+  if (opts->owner_of != NULL &&
+      (opts->batch || opts->check_only || opts->daemon || opts->request ||
+       opts->stamp_cache || opts->audit || optind < argc)) {
+    errno = EINVAL;
+    (void)fprintf(stderr,
+                  "%s: error: --owner-of cannot be combined with batch mode, "
+                  "--check-only, --stamp-cache, --daemon, --request, --audit "
+                  "or user arguments\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  if (opts->owner_of != NULL && opts->do_subuid && opts->do_subgid) {
+    errno = EINVAL;
+    (void)fprintf(stderr,
+                  "%s: error: --owner-of takes only one of --subuid or "
+                  "--subgid\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  /* A table covers its users and one database, it changes no state */
+  if (opts->export_path != NULL &&
+      (opts->check_only || opts->daemon || opts->request ||
+       opts->stamp_cache || opts->audit || opts->owner_of != NULL)) {
+    errno = EINVAL;
+    (void)fprintf(stderr,
+                  "%s: error: --export cannot be combined with --check-only, "
+                  "--stamp-cache, --daemon, --request, --audit or "
+                  "--owner-of\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  if (opts->export_path != NULL && opts->do_subuid == opts->do_subgid &&
+      !opts->help) {
+    errno = EINVAL;
+    (void)fprintf(stderr,
+                  "%s: error: --export takes exactly one of --subuid or "
+                  "--subgid\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  /* The arguments are dumps from other hosts, nothing here is assigned */
+  if (opts->verify &&
+      (opts->batch || opts->check_only || opts->daemon || opts->request ||
+       opts->stamp_cache || opts->audit || opts->owner_of != NULL ||
+       opts->export_path != NULL)) {
+    errno = EINVAL;
+    (void)fprintf(stderr,
+                  "%s: error: --verify cannot be combined with batch mode, "
+                  "--check-only, --stamp-cache, --daemon, --request, --audit, "
+                  "--owner-of or --export\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  /* One dump holds one kind of ID */
+  if (opts->verify && opts->do_subuid == opts->do_subgid && !opts->help) {
+    errno = EINVAL;
+    (void)fprintf(stderr,
+                  "%s: error: --verify takes exactly one of --subuid or "
+                  "--subgid\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  /* Waiting watches another run commit, it takes one user and no writes */
+  if (opts->wait &&
+      (opts->batch || opts->check_only || opts->daemon || opts->request ||
+       opts->stamp_cache || opts->audit || opts->owner_of != NULL ||
+       opts->export_path != NULL || opts->verify)) {
+    errno = EINVAL;
+    (void)fprintf(stderr,
+                  "%s: error: --wait cannot be combined with batch mode, "
+                  "--check-only, --stamp-cache, --daemon, --request, --audit, "
+                  "--owner-of, --export or --verify\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  if (timeout_given && !opts->request && !opts->wait) {
+    errno = EINVAL;
+    (void)fprintf(stderr,
+                  "%s: error: --timeout only valid with --request or "
+                  "--wait\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  /* Only runs that enroll users have phases worth reporting */
+  if (opts->stats != 0 &&
+      (opts->request || opts->audit || opts->owner_of != NULL ||
+       opts->export_path != NULL || opts->verify || opts->wait)) {
+    errno = EINVAL;
+    (void)fprintf(stderr,
+                  "%s: error: --stats cannot be combined with --request, "
+                  "--audit, --owner-of, --export, --verify or --wait\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  /* Check for user argument (unless --help, batch input or a non-user mode) */
   if (optind >= argc) {
-    if (!opts->help) {
+    if (!opts->help && !opts->batch && !opts->daemon && !opts->request &&
+        !opts->audit && opts->owner_of == NULL &&
+        opts->export_path == NULL && !opts->verify) {
       errno = EINVAL;
       (void)fprintf(stderr, "%s: error: missing username or UID argument\n",
                     PROJECT_NAME);
       return -1;
     }
+  } else {
+    opts->user_arg = argv[optind];
+    opts->user_args = &argv[optind];
+    opts->user_argc = argc - optind;
+  }
+
+  if (opts->help) {
     return 0;
   }
 
-  opts->user_arg = argv[optind];
+  if (opts->user_argc > 1 && !opts->batch && opts->export_path == NULL &&
+      !opts->verify) {
+    errno = EINVAL;
+    (void)fprintf(stderr,
+                  "%s: error: multiple users given, use --batch to process "
+                  "them all\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  /* Without --subuid or --subgid the audit covers both databases */
+  if (opts->audit && !opts->do_subuid && !opts->do_subgid) {
+    opts->do_subuid = true;
+    opts->do_subgid = true;
+  }
+
+  /* Without --subuid or --subgid the wait is for both ranges */
+  if (opts->wait && !opts->do_subuid && !opts->do_subgid) {
+    opts->do_subuid = true;
+    opts->do_subgid = true;
+  }
+
+  /* IDs are subordinate UIDs unless --subgid says otherwise */
+  if (opts->owner_of != NULL && !opts->do_subgid) {
+    opts->do_subuid = true;
+  }
 
-  /* Verify at least one mode was specified */
-  if (!opts->do_subuid && !opts->do_subgid && !opts->help) {
+  /* Verify at least one mode was specified (the daemon picks for --request) */
+  if (!opts->do_subuid && !opts->do_subgid && !opts->help && !opts->request) {
     errno = EINVAL;
     (void)fprintf(stderr, "%s: error: must specify --subuid and/or --subgid\n",
                   PROJECT_NAME);
@@ -184,102 +665,340 @@ static int parse_arguments(int argc, char *argv[], options_t *opts) {
 }
 
 /**
- * process_mode - Process single mode (subuid or subgid)
- * @username: Username to process
- * @uid: User's UID
- * @config: Configuration
- * @mode: SUBUID or SUBGID
+ * load_config - Load configuration from all sources, with debug output
+ * @config: Configuration structure to populate
  * @opts: Runtime options
+ * @fingerprint: stamp_fingerprint() of the sources, or NULL if unavailable
  *
- * Handles the complete workflow for assigning one type of subordinate ID:
- * 1. Validate UID doesn't overlap subordinate range
- * 2. Check if user already has subordinate IDs (if SKIP_IF_EXISTS)
- * 3. Calculate subordinate ID range
- * 4. Assign range via usermod
+ * With a @fingerprint the snapshot in STAMP_DIR is used when current, and
+ * refreshed after a full load otherwise (except under --noop).
  *
- * Return: 0 on success, -1 on error
+ * Return: 0 on success, -1 on error (message already printed)
  */
-static int process_mode(const char *username, uint32_t uid,
-                        const config_t *config, subid_mode_t mode,
-                        const options_t *opts) {
-  if (username == NULL || config == NULL || opts == NULL) {
-    errno = EINVAL;
-    (void)fprintf(stderr, "%s: error: NULL parameter in process_mode\n",
+static int load_config(config_t *config, const options_t *opts,
+                       const uint64_t *fingerprint) {
+  if (opts->debug) {
+    (void)fprintf(stderr, "%s: debug: loading configuration\n", PROJECT_NAME);
+  }
+
+  uint64_t started = stats_now();
+  if (fingerprint != NULL &&
+      config_cache_load(&syscall_ops_default, STAMP_DIR, *fingerprint, config,
+                        opts->debug) == 1) {
+    /* Parsed values restored, nothing else to do */
+  } else if (load_configuration(&syscall_ops_default, config, opts->debug) !=
+             0) {
+    stats_phase_add(STATS_CONFIG, started);
+    (void)fprintf(stderr, "%s: error: failed to load configuration\n",
                   PROJECT_NAME);
     return -1;
+  } else if (fingerprint != NULL && !opts->noop) {
+    /* Only an optimisation, failures are reported under --debug */
+    (void)config_cache_store(&syscall_ops_default, STAMP_DIR, *fingerprint,
+                             config, opts->debug);
   }
+  stats_phase_add(STATS_CONFIG, started);
 
-  const char *mode_str = NULL;
-  const subid_config_t *subid_cfg = NULL;
+  if (opts->debug) {
+    (void)fprintf(stderr, "\n");
+    (void)fprintf(stderr, "Parsed Configuration (including defaults):\n");
+    (void)print_configuration(config, stderr, NULL);
+    (void)fprintf(stderr, "\n");
+  }
 
-  switch (mode) {
-  case SUBUID:
-    mode_str = "subuid";
-    subid_cfg = &config->subuid;
-    break;
-  case SUBGID:
-    mode_str = "subgid";
-    subid_cfg = &config->subgid;
-    break;
-  default:
-    errno = EINVAL;
-    (void)fprintf(stderr, "%s: error: invalid mode\n", PROJECT_NAME);
-    return -1;
+  return 0;
+}
+
+/**
+ * run_batch - Enroll every batch entry against one loaded configuration
+ * @config: Loaded configuration
+ * @opts: Runtime options
+ *
+ * Entries come from the passwd database with --all-eligible, from the
+ * positional arguments if any were given, otherwise from --from-file (or
+ * stdin when no file, or "-", was named). A summary is always printed,
+ * even when some entries failed.
+ *
+ * Return: 0 if every entry succeeded, -1 otherwise
+ */
+static int run_batch(const config_t *config, const options_t *opts) {
+  batch_stats_t stats = {0};
+  int ret = 0;
+
+  /* Every helper of the batch shares one environment and file actions */
+  (void)spawn_ctx_install(&syscall_ops_default, opts->debug);
+
+  if (opts->all_eligible) {
+    ret = batch_run_all_eligible(&syscall_ops_default, config, opts, &stats);
+  } else if (opts->user_argc > 0) {
+    ret = batch_run_args(&syscall_ops_default, config, opts, &stats);
+  } else if (opts->batch_file == NULL || strcmp(opts->batch_file, "-") == 0) {
+    ret = batch_run_stream(&syscall_ops_default, config, opts, stdin, &stats);
+  } else {
+    FILE *fp = fopen(opts->batch_file, "r");
+    if (fp == NULL) {
+      (void)fprintf(stderr, "%s: error: cannot open %s: %s\n", PROJECT_NAME,
+                    opts->batch_file, strerror(errno));
+      return -1;
+    }
+    ret = batch_run_stream(&syscall_ops_default, config, opts, fp, &stats);
+    (void)fclose(fp);
   }
 
-  if (opts->debug) {
-    (void)fprintf(stderr, "%s: debug: processing mode: %s\n", PROJECT_NAME,
-                  mode_str);
+  batch_print_summary(&stats, stdout);
+  return ret;
+}
+
+/**
+ * check_exit - Map a check result to the --check-only/--condition status
+ * @opts: Runtime options
+ * @done: 1 if nothing is needed, 0 if work is needed, -1 on error
+ *
+ * Under --condition an error lets the real run go ahead, so it is
+ * reported there (and fails the unit) instead of being silently skipped.
+ *
+ * Return: Process exit status
+ */
+static int check_exit(const options_t *opts, int done) {
+  if (opts->condition) {
+    return done == 1 ? CONDITION_EXIT_SKIP : CONDITION_EXIT_RUN;
   }
+  if (done < 0) {
+    return EXIT_FAILURE;
+  }
+  return done == 1 ? EXIT_SUCCESS : CHECK_EXIT_NEEDED;
+}
 
-  /* Validate UID doesn't overlap with subordinate ID range */
-  if (validate_uid_subid_overlap(uid, subid_cfg) != 0) {
+/**
+ * finish - Report --stats for the run and exit
+ * @opts: Runtime options
+ * @username: User the run was for, NULL if none was resolved
+ * @started: stats_now() at the start of the run
+ * @status: Process exit status
+ */
+static void finish(const options_t *opts, const char *username,
+                   uint64_t started, int status) {
+  if (opts->stats != 0) {
+    stats_phase_add(STATS_TOTAL, started);
+    stats_report(opts->stats, username, status);
+  }
+  exit(status);
+}
+
+/**
+ * run_daemon - Load configuration once and serve clients
+ * @config: Configuration structure to populate
+ * @opts: Runtime options
+ * @fingerprint: stamp_fingerprint() of the sources, or NULL if unavailable
+ *
+ * Socket activated, the daemon exits after DAEMON_IDLE_TIMEOUT_MS without
+ * a client; started by hand it runs until killed.
+ *
+ * Return: 0 on an idle exit, -1 on error (message already printed)
+ */
+static int run_daemon(config_t *config, const options_t *opts,
+                      const uint64_t *fingerprint) {
+  if (load_config(config, opts, fingerprint) != 0) {
     return -1;
   }
 
-  /* Check if subordinate IDs already exist (if configured) */
-  if (config->skip_if_exists) {
-    int exists =
-        check_subid_exists(&syscall_ops_default, username, mode, opts->debug);
-    if (exists < 0) {
-      (void)fprintf(stderr,
-                    "%s: warning: could not check existing %ss for user "
-                    "%s giving up\n",
-                    PROJECT_NAME, mode_str, username);
-      return -1;
-    } else if (exists > 0) {
+  bool activated = false;
+  int fd = daemon_listen(DAEMON_SOCKET_PATH, &activated, opts->debug);
+  if (fd < 0) {
+    return -1;
+  }
+
+  /* After daemon_listen() has dropped the socket activation variables */
+  (void)spawn_ctx_install(&syscall_ops_default, opts->debug);
+
+  int ret = daemon_serve(&syscall_ops_default, fd, config, opts, fingerprint,
+                         activated ? DAEMON_IDLE_TIMEOUT_MS : -1);
+  (void)close(fd);
+  return ret;
+}
+
+/**
+ * run_request - Make sure the caller's ranges are in place via the daemon
+ * @config: Configuration structure to populate
+ * @opts: Runtime options
+ * @fingerprint: stamp_fingerprint() of the sources, or NULL if unavailable
+ * @username: Scratch buffer for the caller's username
+ * @username_size: Size of @username
+ *
+ * With --subuid or --subgid those ranges are checked first, unprivileged
+ * and in this process, and a session whose ranges are in place never
+ * queues behind other logins at the daemon. Anything in the way of that
+ * check only sends the request anyway.
+ *
+ * Return: Exit status: 0 once the ranges are in place, WAIT_EXIT_TIMEOUT
+ *         when --timeout ran out first, EXIT_FAILURE on error
+ */
+static int run_request(config_t *config, const options_t *opts,
+                       const uint64_t *fingerprint, char *username,
+                       size_t username_size) {
+  if (opts->do_subuid || opts->do_subgid) {
+    char uid_str[UINT32_DECIMAL_MAX_LEN + 1] = {0};
+    uint32_t uid = 0;
+    (void)snprintf(uid_str, sizeof(uid_str), "%u", (unsigned int)getuid());
+    if (load_config(config, opts, fingerprint) == 0 &&
+        resolve_user(&syscall_ops_default, uid_str, &uid, username,
+                     username_size, config->resolve_timeout_ms,
+                     opts->debug) == 0 &&
+        enroll_user_check(&syscall_ops_default, username, uid, config,
+                          opts) == 1) {
       if (opts->debug) {
-        (void)fprintf(stderr, "%s: debug: user %s already has %ss assigned\n",
-                      PROJECT_NAME, username, mode_str);
+        (void)fprintf(stderr, "%s: debug: ranges in place, not asking\n",
+                      PROJECT_NAME);
       }
-      return 0;
+      return EXIT_SUCCESS;
     }
   }
 
-  /* Calculate subordinate ID range start */
-  if (opts->debug) {
-    (void)fprintf(stderr, "%s: debug: calculating %s range for UID %u\n",
-                  PROJECT_NAME, mode_str, uid);
+  if (daemon_request(DAEMON_SOCKET_PATH, opts->timeout, opts->debug) == 0) {
+    return EXIT_SUCCESS;
   }
+  return errno == ETIMEDOUT ? WAIT_EXIT_TIMEOUT : EXIT_FAILURE;
+}
 
-  uint32_t start = 0; /* value actually managed by calc_subid_range */
-  if (calc_subid_range(uid, config->uid_min, subid_cfg,
-                       config->allow_subid_wrap, &start) != 0) {
+/**
+ * run_wait - Block until the user's ranges have been committed
+ * @config: Configuration structure to populate
+ * @opts: Runtime options
+ * @fingerprint: stamp_fingerprint() of the sources, or NULL if unavailable
+ * @username: Scratch buffer for the resolved username
+ * @username_size: Size of @username
+ *
+ * Return: Exit status: 0 once the ranges are in place, WAIT_EXIT_TIMEOUT
+ *         when --timeout (or the user lookup) ran out, EXIT_FAILURE on error
+ */
+static int run_wait(config_t *config, const options_t *opts,
+                    const uint64_t *fingerprint, char *username,
+                    size_t username_size) {
+  uint32_t uid = 0;
+  if (load_config(config, opts, fingerprint) != 0) {
+    return EXIT_FAILURE;
+  }
+  if (resolve_user(&syscall_ops_default, opts->user_arg, &uid, username,
+                   username_size, config->resolve_timeout_ms,
+                   opts->debug) != 0) {
+    return errno == ETIMEDOUT ? RESOLVE_EXIT_TIMEOUT : EXIT_FAILURE;
+  }
+
+  if (wait_for_ranges(&syscall_ops_default, username, uid, config, opts,
+                      opts->timeout * 1000U) == 0) {
+    return EXIT_SUCCESS;
+  }
+  return errno == ETIMEDOUT ? WAIT_EXIT_TIMEOUT : EXIT_FAILURE;
+}
+
+/**
+ * run_audit - Audit the subordinate ID databases against the configuration
+ * @config: Configuration structure to populate
+ * @opts: Runtime options
+ * @fingerprint: stamp_fingerprint() of the sources, or NULL if unavailable
+ *
+ * Findings go to stdout; a clean audit prints only the summaries.
+ *
+ * Return: 0 if clean, 1 on findings, -1 on error (message already printed)
+ */
+static int run_audit(config_t *config, const options_t *opts,
+                     const uint64_t *fingerprint) {
+  if (load_config(config, opts, fingerprint) != 0) {
+    return -1;
+  }
+
+  size_t findings = 0;
+  if (audit_run(&syscall_ops_default, config, opts, stdout, &findings) != 0) {
     return -1;
   }
 
   if (opts->debug) {
-    (void)fprintf(stderr, "%s: debug: calculated range: %u:%u\n", PROJECT_NAME,
-                  start, subid_cfg->count_val);
+    (void)fprintf(stderr, "%s: debug: audit found %zu problems\n",
+                  PROJECT_NAME, findings);
   }
+  return findings > 0 ? 1 : 0;
+}
 
-  /* Assign subordinate ID range */
-  if (set_subid_range(&syscall_ops_default, username, mode, start,
-                      subid_cfg->count_val, opts->noop, opts->debug) != 0) {
+/**
+ * run_owner_of - Print the owner of one subordinate ID or a stream of them
+ * @config: Configuration structure to populate
+ * @opts: Runtime options
+ * @fingerprint: stamp_fingerprint() of the sources, or NULL if unavailable
+ *
+ * Return: 0 if every ID has an owner, 1 if some do not, -1 on error
+ */
+static int run_owner_of(config_t *config, const options_t *opts,
+                        const uint64_t *fingerprint) {
+  if (load_config(config, opts, fingerprint) != 0) {
     return -1;
   }
 
-  return 0;
+  return owner_run(&syscall_ops_default, config, opts, stdin, stdout);
+}
+
+/**
+ * run_export - Write the subuid or subgid table for the selected users
+ * @config: Configuration structure to populate
+ * @opts: Runtime options
+ * @fingerprint: stamp_fingerprint() of the sources, or NULL if unavailable
+ *
+ * Users are chosen as in run_batch(), except that without --batch and
+ * without user arguments every eligible account is exported.
+ *
+ * Return: 0 on success, -1 on error (message already printed)
+ */
+static int run_export(config_t *config, const options_t *opts,
+                      const uint64_t *fingerprint) {
+  if (load_config(config, opts, fingerprint) != 0) {
+    return -1;
+  }
+
+  if (!opts->batch || opts->all_eligible || opts->user_argc > 0) {
+    return export_run(&syscall_ops_default, config, opts, NULL);
+  }
+  if (opts->batch_file == NULL || strcmp(opts->batch_file, "-") == 0) {
+    return export_run(&syscall_ops_default, config, opts, stdin);
+  }
+
+  FILE *fp = fopen(opts->batch_file, "r");
+  if (fp == NULL) {
+    (void)fprintf(stderr, "%s: error: cannot open %s: %s\n", PROJECT_NAME,
+                  opts->batch_file, strerror(errno));
+    return -1;
+  }
+  int ret = export_run(&syscall_ops_default, config, opts, fp);
+  (void)fclose(fp);
+  return ret;
+}
+
+/**
+ * run_verify - Check subid dumps collected from other hosts
+ * @config: Configuration structure to populate
+ * @opts: Runtime options, the input paths in @user_args
+ * @fingerprint: stamp_fingerprint() of the sources, or NULL if unavailable
+ *
+ * The ranges are calculated with this host's configuration, which must
+ * match the fleet's. Findings go to stdout.
+ *
+ * Return: 0 if clean, 1 on findings, -1 on error (message already printed)
+ */
+static int run_verify(config_t *config, const options_t *opts,
+                      const uint64_t *fingerprint) {
+  if (load_config(config, opts, fingerprint) != 0) {
+    return -1;
+  }
+
+  size_t findings = 0;
+  if (verify_run(&syscall_ops_default, config, opts, stdout, &findings) !=
+      0) {
+    return -1;
+  }
+
+  if (opts->debug) {
+    (void)fprintf(stderr, "%s: debug: verify found %zu problems\n",
+                  PROJECT_NAME, findings);
+  }
+  return findings > 0 ? 1 : 0;
 }
 
 /**
@@ -290,19 +1009,41 @@ static int process_mode(const char *username, uint32_t uid,
  * Main workflow:
  * 1. Parse command line arguments
  * 2. Handle --help (with optional --dump-config)
- * 3. Resolve user argument to UID and username
- * 4. Load configuration from multiple sources
- * 5. Validate UID is in allowed range
- * 6. Process --subuid if requested
- * 7. Process --subgid if requested
+ * 3. In batch mode, load configuration once and enroll every entry
+ * 4. Otherwise load configuration from multiple sources (or the snapshot
+ *    in STAMP_DIR), which sets the RESOLVE_TIMEOUT_MS deadline
+ * 5. Resolve user argument to UID and username
+ * 6. With --stamp-cache, stop early if STAMP_DIR/<uid> is current
+ * 7. Validate UID is in allowed range
+ * 8. Process --subuid and/or --subgid as requested
+ * 9. With --stamp-cache, record the successful run in STAMP_DIR/<uid>
+ *
+ * With --check-only (or --condition) step 8 only reports whether anything
+ * would be assigned and step 9 is skipped. --request hands the whole job to
+ * the daemon after step 2, unless with --subuid or --subgid it finds the
+ * caller's ranges already in place; --daemon runs steps 5 to 9 for every
+ * client and --wait repeats step 8's check until another run has
+ * committed the ranges.
+ * --audit loads the configuration and checks the databases instead, and
+ * --owner-of loads it to calculate who owns the given subordinate IDs.
+ * --export loads it to write a whole table without touching /etc.
+ * --verify loads it to check dumps of the same table from other hosts.
+ * With --stats, single-user and batch runs report their phase timings and
+ * counters on exit; the daemon reports every request.
  *
- * Return: 0 on success, 1 on error
+ * Return: 0 on success, 1 on error, 2 when --audit or --verify has
+ *         findings or an --owner-of ID has no owner, 3 when the user
+ *         lookup, --request or --wait timed out
  */
 int main(int argc, char *argv[]) {
+  uint64_t started = stats_now();
   options_t opts = {0};
   uint32_t uid = 0;
   config_t config = {0};
   char *username = NULL;
+  uint64_t fingerprint = 0;
+  bool have_fingerprint = false;
+  bool use_stamp = false;
 
   long name_max = sysconf(_SC_LOGIN_NAME_MAX);
   if (name_max <= 0) {
@@ -323,7 +1064,7 @@ int main(int argc, char *argv[]) {
   /* Parse command line arguments */
   if (parse_arguments(argc, argv, &opts) != 0) {
     print_help(false, false);
-    exit(EXIT_FAILURE);
+    exit(opts.condition ? CONDITION_EXIT_RUN : EXIT_FAILURE);
   }
 
   /* Handle --help (with optional --dump-config) */
@@ -337,57 +1078,140 @@ int main(int argc, char *argv[]) {
                   VERSION);
   }
 
-  /* Resolve user argument to UID and username */
-  if (resolve_user(&syscall_ops_default, opts.user_arg, &uid, username,
-                   username_size, opts.debug) != 0) {
-    exit(EXIT_FAILURE);
+  /* Keys the configuration snapshot and the --stamp-cache stamps */
+  have_fingerprint =
+      stamp_fingerprint(&syscall_ops_default, &fingerprint, opts.debug) == 0;
+
+  /* The daemon resolves, checks and enrolls the caller */
+  if (opts.request) {
+    exit(run_request(&config, &opts, have_fingerprint ? &fingerprint : NULL,
+                     username, username_size));
   }
 
-  if (opts.debug) {
-    (void)fprintf(stderr, "%s: debug: resolved user: %s (UID: %u)\n",
-                  PROJECT_NAME, username, uid);
+  /* Daemon mode: load configuration once, then serve every client */
+  if (opts.daemon) {
+    exit(run_daemon(&config, &opts, have_fingerprint ? &fingerprint : NULL) ==
+                 0
+             ? EXIT_SUCCESS
+             : EXIT_FAILURE);
   }
 
-  /* Load configuration from all sources */
-  if (opts.debug) {
-    (void)fprintf(stderr, "%s: debug: loading configuration\n", PROJECT_NAME);
+  /* Audit mode: check the databases, assign nothing */
+  if (opts.audit) {
+    int audit = run_audit(&config, &opts,
+                          have_fingerprint ? &fingerprint : NULL);
+    exit(audit < 0   ? EXIT_FAILURE
+         : audit > 0 ? AUDIT_EXIT_FINDINGS
+                     : EXIT_SUCCESS);
   }
 
-  if (load_configuration(&syscall_ops_default, &config, opts.debug) != 0) {
-    (void)fprintf(stderr, "%s: error: failed to load configuration\n",
-                  PROJECT_NAME);
-    exit(EXIT_FAILURE);
+  /* Reverse lookup: calculate owners, assign nothing */
+  if (opts.owner_of != NULL) {
+    int owned = run_owner_of(&config, &opts,
+                             have_fingerprint ? &fingerprint : NULL);
+    exit(owned < 0   ? EXIT_FAILURE
+         : owned > 0 ? OWNER_EXIT_UNOWNED
+                     : EXIT_SUCCESS);
   }
 
-  if (opts.debug) {
-    (void)fprintf(stderr, "\n");
-    (void)fprintf(stderr, "Parsed Configuration (including defaults):\n");
-    (void)print_configuration(&config, stderr, NULL);
-    (void)fprintf(stderr, "\n");
+  /* Wait for another run to commit the ranges, assign nothing */
+  if (opts.wait) {
+    exit(run_wait(&config, &opts, have_fingerprint ? &fingerprint : NULL,
+                  username, username_size));
   }
 
-  /* Validate UID is in allowed range */
-  if (validate_uid_range(uid, &config) != 0) {
-    exit(EXIT_FAILURE);
+  /* Fleet check: compare other hosts' dumps with the calculated ranges */
+  if (opts.verify) {
+    int verify = run_verify(&config, &opts,
+                            have_fingerprint ? &fingerprint : NULL);
+    exit(verify < 0   ? EXIT_FAILURE
+         : verify > 0 ? VERIFY_EXIT_FINDINGS
+                      : EXIT_SUCCESS);
+  }
+
+  /* Table export: calculate every range, write them out in one go */
+  if (opts.export_path != NULL) {
+    exit(run_export(&config, &opts, have_fingerprint ? &fingerprint : NULL) ==
+                 0
+             ? EXIT_SUCCESS
+             : EXIT_FAILURE);
   }
 
-  /* Process subuid if requested */
-  if (opts.do_subuid) {
-    if (process_mode(username, uid, &config, SUBUID, &opts) != 0) {
-      exit(EXIT_FAILURE);
+  /* Batch mode: load configuration once, then process every entry */
+  if (opts.batch) {
+    if (load_config(&config, &opts,
+                    have_fingerprint ? &fingerprint : NULL) != 0) {
+      finish(&opts, NULL, started, EXIT_FAILURE);
     }
+
+    finish(&opts, NULL, started,
+           run_batch(&config, &opts) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
   }
 
-  /* Process subgid if requested */
-  if (opts.do_subgid) {
-    if (process_mode(username, uid, &config, SUBGID, &opts) != 0) {
-      exit(EXIT_FAILURE);
+  /*
+   * Load configuration from all sources, it bounds the lookup below. This
+   * has to come before the stamp check: the stamp is found by UID, and
+   * turning the argument into a UID is the lookup RESOLVE_TIMEOUT_MS
+   * bounds. Whenever a stamp can be current, so is the snapshot (both are
+   * keyed on the fingerprint and the snapshot is stored first), so the
+   * fast path reads the snapshot and parses nothing.
+   */
+  if (load_config(&config, &opts, have_fingerprint ? &fingerprint : NULL) !=
+      0) {
+    finish(&opts, NULL, started,
+           opts.check_only ? check_exit(&opts, -1) : EXIT_FAILURE);
+  }
+
+  /* Resolve user argument to UID and username */
+  if (resolve_user(&syscall_ops_default, opts.user_arg, &uid, username,
+                   username_size, config.resolve_timeout_ms,
+                   opts.debug) != 0) {
+    if (errno == ETIMEDOUT && !opts.condition) {
+      finish(&opts, NULL, started, RESOLVE_EXIT_TIMEOUT);
+    }
+    finish(&opts, NULL, started,
+           opts.check_only ? check_exit(&opts, -1) : EXIT_FAILURE);
+  }
+
+  if (opts.debug) {
+    (void)fprintf(stderr, "%s: debug: resolved user: %s (UID: %u)\n",
+                  PROJECT_NAME, username, uid);
+  }
+
+  /* A current stamp means nothing changed since the last successful run */
+  use_stamp = opts.stamp_cache && !opts.noop && have_fingerprint;
+  if (use_stamp && stamp_check(&syscall_ops_default, STAMP_DIR, uid, username,
+                               &opts, fingerprint) == 1) {
+    if (opts.debug) {
+      (void)fprintf(stderr, "%s: debug: %s already done, skipping\n",
+                    PROJECT_NAME, username);
     }
+    finish(&opts, username, started,
+           opts.check_only ? check_exit(&opts, 1) : EXIT_SUCCESS);
+  }
+
+  /* Report without assigning anything or touching the stamp */
+  if (opts.check_only) {
+    finish(&opts, username, started,
+           check_exit(&opts, enroll_user_check(&syscall_ops_default, username,
+                                               uid, &config, &opts)));
+  }
+
+  /* Validate UID and process --subuid / --subgid as requested */
+  if (enroll_user(&syscall_ops_default, username, uid, &config, &opts) != 0) {
+    finish(&opts, username, started, EXIT_FAILURE);
+  }
+
+  /* The ranges are in place, a failed stamp only costs a full run next time */
+  if (use_stamp && stamp_write(&syscall_ops_default, STAMP_DIR, uid, username,
+                               &config, &opts, fingerprint) != 0) {
+    (void)fprintf(stderr, "%s: warning: stamp cache not updated for %s\n",
+                  PROJECT_NAME, username);
   }
 
   if (opts.debug) {
     (void)fprintf(stderr, "%s: debug: completed successfully\n", PROJECT_NAME);
   }
 
-  exit(EXIT_SUCCESS);
+  finish(&opts, username, started, EXIT_SUCCESS);
 }
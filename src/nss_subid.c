@@ -0,0 +1,228 @@
+/**
+ * nss_subid.c - Subordinate ID lookups answered from the formula
+ *
+ * The queries a shadow-utils subid provider has to answer, computed from
+ * the configuration alone: the range of an owner is calc_subid_range() of
+ * its UID and the owners of an ID come from calc_subid_owner(), so no
+ * subuid(5) or subgid(5) file is read or written. The shadow-utils ABI
+ * itself lives in libsubid_static_subid.c; keeping the logic here lets it
+ * be tested like any other module.
+ *
+ * An owner outside [UID_MIN, UID_MAX] exists but has no range, which is
+ * not an error; an owner the passwd database does not know fails with
+ * errno set to ENOENT.
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* Initial capacity of the owner list, doubled while it comes back truncated */
+enum { NSS_SUBID_INITIAL_OWNERS = 16 };
+
+/*
+ * Forward declarations for internal functions
+ *
+ * We can use nonnull on static functions because they can only be called
+ * from inside here and we're careful to check the pointers in our visible
+ * function(s).
+ */
+static int resolve_owner(const struct syscall_ops *ops, const config_t *config,
+                         const char *owner, uint32_t *uid)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+
+/**
+ * resolve_owner - Find the UID of a username or UID string
+ * @ops: Operations structure for system call abstraction
+ * @config: Loaded configuration (for RESOLVE_TIMEOUT_MS)
+ * @owner: Username or UID
+ * @uid: Set to the UID
+ *
+ * Return: 0 on success, -1 on error (errno ENOENT for an unknown owner)
+ */
+static int resolve_owner(const struct syscall_ops *ops, const config_t *config,
+                         const char *owner, uint32_t *uid) {
+  long name_max = sysconf(_SC_LOGIN_NAME_MAX);
+  // LCOV_EXCL_START
+  if (name_max <= 0) {
+    errno = ENOSYS;
+    (void)fprintf(stderr, "%s: error: invalid _SC_LOGIN_NAME_MAX: %ld\n",
+                  PROJECT_NAME, name_max);
+    return -1;
+  }
+  // LCOV_EXCL_STOP
+
+  /* +1 for NUL terminator */
+  size_t size = (size_t)name_max + 1;
+  char *username = ops->calloc(size, sizeof(*username));
+  if (username == NULL) {
+    errno = ENOMEM;
+    (void)fprintf(stderr, "%s: error: memory allocation failed\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  int ret = resolve_user(ops, owner, uid, username, size,
+                         config->resolve_timeout_ms, false);
+  int saved_errno = errno;
+  ops->free(username);
+  errno = saved_errno;
+  return ret;
+}
+
+/**
+ * nss_subid_range - Calculated range of an owner
+ * @ops: Operations structure for system call abstraction
+ * @config: Loaded configuration
+ * @owner: Username or UID
+ * @subgid: Use the subordinate GID configuration
+ * @range: Set to the range when @found is 1
+ * @found: Set to 1 if @owner has a range, to 0 if it is not eligible
+ *
+ * Return: 0 on success, -1 on error (errno ENOENT for an unknown owner)
+ */
+int nss_subid_range(const struct syscall_ops *ops, const config_t *config,
+                    const char *owner, bool subgid, subid_range_t *range,
+                    size_t *found) {
+  if (ops == NULL || config == NULL || owner == NULL || range == NULL ||
+      found == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: NULL parameter in nss_subid_range\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  const subid_config_t *subid_cfg = subgid ? &config->subgid : &config->subuid;
+  uint32_t uid = 0;
+  *found = 0;
+
+  if (resolve_owner(ops, config, owner, &uid) != 0) {
+    return -1;
+  }
+  if (uid < config->uid_min || uid > config->uid_max) {
+    return 0;
+  }
+
+  uint32_t start = 0;
+  if (calc_subid_range(uid, config->uid_min, subid_cfg,
+                       config->allow_subid_wrap, &start) != 0) {
+    return -1;
+  }
+
+  *range = (subid_range_t){.start = start,
+                           .count = calc_subid_count(uid, subid_cfg)};
+  *found = 1;
+  return 0;
+}
+
+/**
+ * nss_subid_has_range - Check that an owner may use [@start, @start+@count)
+ * @ops: Operations structure for system call abstraction
+ * @config: Loaded configuration
+ * @owner: Username or UID
+ * @start: First ID asked for
+ * @count: Number of IDs asked for
+ * @subgid: Use the subordinate GID configuration
+ * @result: Set to true if the IDs are inside the calculated range
+ *
+ * Return: 0 on success, -1 on error (errno ENOENT for an unknown owner)
+ */
+int nss_subid_has_range(const struct syscall_ops *ops, const config_t *config,
+                        const char *owner, uint64_t start, uint64_t count,
+                        bool subgid, bool *result) {
+  if (result == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr,
+                  "%s: error: NULL parameter in nss_subid_has_range\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  subid_range_t range = {0};
+  size_t found = 0;
+  *result = false;
+
+  if (nss_subid_range(ops, config, owner, subgid, &range, &found) != 0) {
+    return -1;
+  }
+
+  /* 64 bits cannot overflow on 32 bit IDs, whatever the caller passes */
+  uint64_t end = (uint64_t)range.start + range.count;
+  *result = found == 1 && start >= range.start && start <= end &&
+            count <= end - start;
+  return 0;
+}
+
+/**
+ * nss_subid_owners - UIDs whose calculated range contains @id
+ * @ops: Operations structure (needed for calloc)
+ * @config: Loaded configuration
+ * @id: Subordinate ID
+ * @subgid: Use the subordinate GID configuration
+ * @uids: Set to a calloc(3)ed list of UIDs (caller frees), NULL if none
+ * @found: Set to the number of UIDs in @uids
+ *
+ * Unlike --owner-of the list is never cut short, however often the ranges
+ * wrap; a UID is listed whether or not it has a passwd entry.
+ *
+ * Return: 0 on success, -1 on error
+ */
+int nss_subid_owners(const struct syscall_ops *ops, const config_t *config,
+                     uint64_t id, bool subgid, uint32_t **uids,
+                     size_t *found) {
+  if (ops == NULL || config == NULL || uids == NULL || found == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: NULL parameter in nss_subid_owners\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  const subid_config_t *subid_cfg = subgid ? &config->subgid : &config->subuid;
+  *uids = NULL;
+  *found = 0;
+
+  if (id > UINT32_MAX) {
+    return 0;
+  }
+
+  size_t max = NSS_SUBID_INITIAL_OWNERS;
+  for (;;) {
+    uint32_t *list = ops->calloc(max, sizeof(*list));
+    if (list == NULL) {
+      errno = ENOMEM;
+      (void)fprintf(stderr, "%s: error: memory allocation failed\n",
+                    PROJECT_NAME);
+      return -1;
+    }
+
+    size_t n = 0;
+    int more = calc_subid_owner((uint32_t)id, config->uid_min,
+                                config->uid_max, subid_cfg,
+                                config->allow_subid_wrap, list, max, &n);
+    if (more < 0) {
+      ops->free(list);
+      return -1;
+    }
+    if (more == 0) {
+      if (n == 0) {
+        ops->free(list);
+        list = NULL;
+      }
+      *uids = list;
+      *found = n;
+      return 0;
+    }
+
+    ops->free(list);
+    max *= 2;
+  }
+}
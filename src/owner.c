@@ -0,0 +1,364 @@
+/**
+ * owner.c - Reverse lookup of subordinate IDs (--owner-of)
+ *
+ * Maps a subordinate ID back to the user it was calculated for by
+ * inverting calc_subid_range() with calc_subid_owner(), so no subuid(5)
+ * or subgid(5) file is read. IDs can be given one at a time or streamed,
+ * e.g. from "find / -printf '%U\n'", in which case the same few UIDs come
+ * up again and again: their names are kept in a small hash table so NSS
+ * is asked only once per UID.
+ *
+ * Each ID produces one tab-separated line on the output stream:
+ *
+ *   id <TAB> uid[,uid...] <TAB> name[,name...]
+ *
+ * with "-" for an ID no user owns, or for a UID without an account. Only
+ * wrap mode can list more than one candidate.
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <pwd.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Candidates printed for one ID before the list is cut short with "..." */
+enum { OWNER_MAX_CANDIDATES = 16 };
+
+/* Initial slot count of the name cache, a power of two */
+enum { OWNER_CACHE_INITIAL_SLOTS = 64 };
+
+/* Name offset of a UID known to have no account */
+#define OWNER_NO_NAME SIZE_MAX
+
+/**
+ * struct owner_slot_t - One name cache slot
+ * @uid: Cached UID
+ * @name: Offset of the name in the name arena, or OWNER_NO_NAME
+ * @used: The slot holds an entry
+ */
+typedef struct {
+  uint32_t uid;
+  size_t name;
+  bool used;
+} owner_slot_t;
+
+/**
+ * struct owner_cache_t - UID to name cache, open addressing
+ * @slots: Slot storage, @size entries
+ * @size: Number of slots, a power of two
+ * @len: Slots in use
+ * @names: Names, NUL-terminated back to back
+ * @names_len: Bytes of @names in use
+ * @names_cap: Bytes of @names allocated
+ * @scratch: passwd_lookup() buffer shared by every lookup
+ * @timeout_ms: RESOLVE_TIMEOUT_MS for each lookup
+ */
+typedef struct {
+  owner_slot_t *slots;
+  size_t size;
+  size_t len;
+  char *names;
+  size_t names_len;
+  size_t names_cap;
+  passwd_buf_t scratch;
+  unsigned int timeout_ms;
+} owner_cache_t;
+
+/*
+ * Forward declarations for internal functions
+ *
+ * We can use nonnull on static functions because they can only be called
+ * from inside here and we're careful to check the pointers in our visible
+ * function(s).
+ */
+static owner_slot_t *cache_slot(owner_slot_t *slots, size_t size,
+                                uint32_t uid) __attribute__((nonnull))
+__attribute__((warn_unused_result));
+static int cache_grow(const struct syscall_ops *ops, owner_cache_t *cache)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static int cache_store_name(const struct syscall_ops *ops,
+                            owner_cache_t *cache, const char *name,
+                            size_t *offset) __attribute__((nonnull))
+__attribute__((warn_unused_result));
+static const char *cache_lookup(const struct syscall_ops *ops,
+                                owner_cache_t *cache, uint32_t uid,
+                                bool debug) __attribute__((nonnull));
+static int print_owner(const struct syscall_ops *ops, const config_t *config,
+                       const subid_config_t *subid_cfg, owner_cache_t *cache,
+                       uint32_t id, FILE *out, bool debug)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+
+/**
+ * cache_slot - Find the slot of @uid, or the empty slot it belongs in
+ * @slots: Slot storage
+ * @size: Number of slots, a power of two with at least one empty slot
+ * @uid: UID to look for
+ *
+ * Return: Slot holding @uid, or the first empty slot of its probe chain
+ */
+static owner_slot_t *cache_slot(owner_slot_t *slots, size_t size,
+                                uint32_t uid) {
+  /* An odd multiplier keeps consecutive UIDs in distinct slots */
+  size_t i = (size_t)((uid * 2654435769U) & (size - 1));
+  while (slots[i].used && slots[i].uid != uid) {
+    i = (i + 1) & (size - 1);
+  }
+  return &slots[i];
+}
+
+/**
+ * cache_grow - Double the slot count and rehash
+ * @ops: Operations structure (needed for calloc)
+ * @cache: Cache to grow
+ *
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int cache_grow(const struct syscall_ops *ops, owner_cache_t *cache) {
+  size_t size = cache->size == 0 ? OWNER_CACHE_INITIAL_SLOTS : cache->size * 2;
+  owner_slot_t *slots = ops->calloc(size, sizeof(*slots));
+  if (slots == NULL) {
+    errno = ENOMEM;
+    (void)fprintf(stderr, "%s: error: memory allocation failed\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  for (size_t i = 0; i < cache->size; i++) {
+    if (cache->slots[i].used) {
+      *cache_slot(slots, size, cache->slots[i].uid) = cache->slots[i];
+    }
+  }
+
+  ops->free(cache->slots);
+  cache->slots = slots;
+  cache->size = size;
+  return 0;
+}
+
+/**
+ * cache_store_name - Copy a name into the name arena
+ * @ops: Operations structure (needed for calloc)
+ * @cache: Cache owning the arena
+ * @name: Name to copy
+ * @offset: Set to the offset of the copy
+ *
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int cache_store_name(const struct syscall_ops *ops,
+                            owner_cache_t *cache, const char *name,
+                            size_t *offset) {
+  size_t size = strlen(name) + 1;
+
+  if (cache->names_len + size > cache->names_cap) {
+    size_t cap = cache->names_cap == 0 ? MAX_LINE_LEN : cache->names_cap;
+    while (cap < cache->names_len + size) {
+      cap *= 2;
+    }
+    char *names = ops->calloc(cap, sizeof(*names));
+    if (names == NULL) {
+      errno = ENOMEM;
+      (void)fprintf(stderr, "%s: error: memory allocation failed\n",
+                    PROJECT_NAME);
+      return -1;
+    }
+    if (cache->names_len > 0) {
+      memcpy(names, cache->names, cache->names_len);
+    }
+    ops->free(cache->names);
+    cache->names = names;
+    cache->names_cap = cap;
+  }
+
+  memcpy(cache->names + cache->names_len, name, size);
+  *offset = cache->names_len;
+  cache->names_len += size;
+  return 0;
+}
+
+/**
+ * cache_lookup - Name of @uid, asking NSS only on the first request
+ * @ops: Operations structure for system call abstraction
+ * @cache: Name cache
+ * @uid: UID to name
+ * @debug: Enable debug output
+ *
+ * A UID without an account is cached as such too; a failed lookup is not,
+ * so the next request asks again. If the cache cannot grow the lookup
+ * still answers, it just is not remembered.
+ *
+ * Return: Name (valid until the next lookup), or NULL if there is none
+ */
+static const char *cache_lookup(const struct syscall_ops *ops,
+                                owner_cache_t *cache, uint32_t uid,
+                                bool debug) {
+  /* Keep the load factor at or below one half */
+  uint32_t found_uid = 0;
+  const char *name = NULL;
+  if ((cache->len + 1) * 2 > cache->size && cache_grow(ops, cache) != 0) {
+    return passwd_lookup(ops, NULL, uid, cache->timeout_ms, &cache->scratch,
+                         &found_uid, &name) == 0
+               ? name
+               : NULL;
+  }
+
+  owner_slot_t *slot = cache_slot(cache->slots, cache->size, uid);
+  if (slot->used) {
+    return slot->name == OWNER_NO_NAME ? NULL : cache->names + slot->name;
+  }
+
+  if (debug) {
+    (void)fprintf(stderr, "%s: debug: looking up UID %u\n", PROJECT_NAME,
+                  uid);
+  }
+
+  size_t offset = OWNER_NO_NAME;
+  if (passwd_lookup(ops, NULL, uid, cache->timeout_ms, &cache->scratch,
+                    &found_uid, &name) != 0) {
+    if (errno != ENOENT) {
+      if (debug) {
+        (void)fprintf(stderr, "%s: debug: cannot look up UID %u: %s\n",
+                      PROJECT_NAME, uid, strerror(errno));
+      }
+      return NULL;
+    }
+  } else if (cache_store_name(ops, cache, name, &offset) != 0) {
+    return name;
+  }
+
+  *slot = (owner_slot_t){.uid = uid, .name = offset, .used = true};
+  cache->len++;
+  return offset == OWNER_NO_NAME ? NULL : cache->names + offset;
+}
+
+/**
+ * print_owner - Write the owner line of one ID
+ * @ops: Operations structure for system call abstraction
+ * @config: Loaded configuration
+ * @subid_cfg: Range configuration of the selected database
+ * @cache: Name cache
+ * @id: Subordinate ID
+ * @out: Output stream
+ * @debug: Enable debug output
+ *
+ * Return: 0 if the ID has an owner, 1 if not, -1 on error
+ */
+static int print_owner(const struct syscall_ops *ops, const config_t *config,
+                       const subid_config_t *subid_cfg, owner_cache_t *cache,
+                       uint32_t id, FILE *out, bool debug) {
+  uint32_t uids[OWNER_MAX_CANDIDATES] = {0};
+  size_t found = 0;
+
+  int more = calc_subid_owner(id, config->uid_min, config->uid_max, subid_cfg,
+                              config->allow_subid_wrap, uids,
+                              OWNER_MAX_CANDIDATES, &found);
+  if (more < 0) {
+    return -1;
+  }
+
+  if (found == 0) {
+    (void)fprintf(out, "%u\t-\t-\n", id);
+    return 1;
+  }
+
+  (void)fprintf(out, "%u\t", id);
+  for (size_t i = 0; i < found; i++) {
+    (void)fprintf(out, "%s%u", i > 0 ? "," : "", uids[i]);
+  }
+  (void)fputs(more ? ",...\t" : "\t", out);
+  for (size_t i = 0; i < found; i++) {
+    const char *name = cache_lookup(ops, cache, uids[i], debug);
+    (void)fprintf(out, "%s%s", i > 0 ? "," : "", name != NULL ? name : "-");
+  }
+  (void)fputs(more ? ",...\n" : "\n", out);
+  return 0;
+}
+
+/**
+ * owner_run - Print the owner of @opts->owner_of, or of every ID on @in
+ * @ops: Operations structure for system call abstraction
+ * @config: Loaded configuration
+ * @opts: Runtime options (--subgid selects the GID ranges)
+ * @in: Stream of IDs, one per line, read when @opts->owner_of is "-"
+ * @out: Output stream
+ *
+ * IDs on @in are read with batch_read_entry(), so blank lines and "#"
+ * comments are skipped. An entry that is not a number is reported on
+ * stderr and the stream carries on.
+ *
+ * Return: 0 if every ID has an owner, 1 if some do not, -1 on error
+ *         (including any entry that is not a number)
+ */
+int owner_run(const struct syscall_ops *ops, const config_t *config,
+              const options_t *opts, FILE *in, FILE *out) {
+  if (ops == NULL || config == NULL || opts == NULL ||
+      opts->owner_of == NULL || in == NULL || out == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: NULL parameter in owner_run\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  const subid_config_t *subid_cfg =
+      opts->do_subgid ? &config->subgid : &config->subuid;
+  owner_cache_t cache = {.timeout_ms = config->resolve_timeout_ms};
+  bool unowned = false;
+  int ret = 0;
+  uint32_t id = 0;
+
+  if (strcmp(opts->owner_of, "-") != 0) {
+    if (parse_uint32_strict(opts->owner_of, &id) != 0) {
+      errno = EINVAL;
+      (void)fprintf(stderr, "%s: error: invalid subordinate ID: %s\n",
+                    PROJECT_NAME, opts->owner_of);
+      return -1;
+    }
+    ret = print_owner(ops, config, subid_cfg, &cache, id, out, opts->debug);
+  } else {
+    char *line = NULL;
+    size_t cap = 0;
+    const char *entry = NULL;
+    while ((entry = batch_read_entry(in, '\n', &line, &cap)) != NULL) {
+      if (parse_uint32_strict(entry, &id) != 0) {
+        (void)fprintf(stderr, "%s: error: invalid subordinate ID: %s\n",
+                      PROJECT_NAME, entry);
+        ret = -1;
+        continue;
+      }
+      int owned =
+          print_owner(ops, config, subid_cfg, &cache, id, out, opts->debug);
+      if (owned < 0) {
+        ret = -1;
+        break;
+      }
+      unowned = unowned || owned > 0;
+    }
+    if (ferror(in)) {
+      (void)fprintf(stderr, "%s: error: failed reading subordinate IDs\n",
+                    PROJECT_NAME);
+      ret = -1;
+    }
+    ops->free(line);
+  }
+
+  if (opts->debug) {
+    (void)fprintf(stderr, "%s: debug: %zu distinct owners looked up\n",
+                  PROJECT_NAME, cache.len);
+  }
+
+  ops->free(cache.slots);
+  ops->free(cache.names);
+  passwd_buf_free(ops, &cache.scratch);
+  if (ret != 0) {
+    return ret;
+  }
+  return unowned ? 1 : 0;
+}
@@ -0,0 +1,170 @@
+/**
+ * pam_static_subid.c - PAM session module enrolling users at login
+ *
+ * Built as pam_static_subid.so when the PAM headers are available and
+ * stacked as
+ *
+ *   session optional pam_static_subid.so [subuid] [subgid] [debug]
+ *
+ * in the login services. pam_sm_open_session() runs enroll_session()
+ * in-process, so the ranges exist before the session starts and a user
+ * who already has them costs no spawn at all. Without "subuid" or
+ * "subgid" both are ensured.
+ *
+ * The configuration is reloaded for every session (from the snapshot in
+ * STAMP_DIR while it is current) so edits apply without restarting the
+ * service that loaded the module. Only the pam_sm_* symbols are exported.
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <syslog.h>
+
+#include <security/pam_ext.h>
+#include <security/pam_modules.h>
+
+#define PAM_EXPORT __attribute__((visibility("default")))
+
+/* Module entry points, looked up by name by libpam */
+PAM_EXPORT int pam_sm_open_session(pam_handle_t *pamh, int flags, int argc,
+                                   const char **argv);
+PAM_EXPORT int pam_sm_close_session(pam_handle_t *pamh, int flags, int argc,
+                                    const char **argv);
+
+/*
+ * Forward declarations for internal functions
+ *
+ * We can use nonnull on static functions because they can only be called
+ * from inside here and we're careful to check the pointers in our visible
+ * function(s).
+ */
+static void parse_module_args(pam_handle_t *pamh, int argc, const char **argv,
+                              options_t *opts) __attribute__((nonnull(1, 4)));
+static int module_load_config(config_t *config, bool debug)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+
+/**
+ * parse_module_args - Turn the module arguments into runtime options
+ * @pamh: PAM handle, for logging
+ * @argc: Number of module arguments
+ * @argv: Module arguments
+ * @opts: Options to fill
+ *
+ * Unknown arguments are logged and ignored, as PAM modules conventionally
+ * do, so a typo cannot lock anyone out.
+ */
+static void parse_module_args(pam_handle_t *pamh, int argc, const char **argv,
+                              options_t *opts) {
+  for (int i = 0; i < argc && argv != NULL; i++) {
+    if (strcmp(argv[i], "subuid") == 0) {
+      opts->do_subuid = true;
+    } else if (strcmp(argv[i], "subgid") == 0) {
+      opts->do_subgid = true;
+    } else if (strcmp(argv[i], "debug") == 0) {
+      opts->debug = true;
+    } else {
+      pam_syslog(pamh, LOG_ERR, "unknown option: %s", argv[i]);
+    }
+  }
+
+  if (!opts->do_subuid && !opts->do_subgid) {
+    opts->do_subuid = true;
+    opts->do_subgid = true;
+  }
+}
+
+/**
+ * module_load_config - Load the configuration for one session
+ * @config: Configuration to fill
+ * @debug: Enable debug output
+ *
+ * Same sources and snapshot handling as a plain run; PAM sessions open
+ * as root, so a stale snapshot is refreshed here too.
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int module_load_config(config_t *config, bool debug) {
+  uint64_t fingerprint = 0;
+  bool have_fingerprint =
+      stamp_fingerprint(&syscall_ops_default, &fingerprint, debug) == 0;
+
+  if (have_fingerprint &&
+      config_cache_load(&syscall_ops_default, STAMP_DIR, fingerprint, config,
+                        debug) == 1) {
+    return 0;
+  }
+  if (load_configuration(&syscall_ops_default, config, debug) != 0) {
+    return -1;
+  }
+  if (have_fingerprint) {
+    /* Only an optimisation, failures are reported under debug */
+    (void)config_cache_store(&syscall_ops_default, STAMP_DIR, fingerprint,
+                             config, debug);
+  }
+  return 0;
+}
+
+/**
+ * pam_sm_open_session - Ensure the user's ranges before the session starts
+ * @pamh: PAM handle
+ * @flags: PAM flags (unused)
+ * @argc: Number of module arguments
+ * @argv: Module arguments
+ *
+ * Return: PAM_SUCCESS when the ranges are in place, PAM_IGNORE for
+ *         accounts outside [UID_MIN, UID_MAX], PAM_SESSION_ERR otherwise
+ */
+int pam_sm_open_session(pam_handle_t *pamh, int flags, int argc,
+                        const char **argv) {
+  (void)flags;
+
+  options_t opts = {0};
+  parse_module_args(pamh, argc, argv, &opts);
+
+  const char *user = NULL;
+  if (pam_get_user(pamh, &user, NULL) != PAM_SUCCESS || user == NULL ||
+      *user == '\0') {
+    pam_syslog(pamh, LOG_ERR, "cannot determine the user");
+    return PAM_SESSION_ERR;
+  }
+
+  config_t config = {0};
+  if (module_load_config(&config, opts.debug) != 0) {
+    pam_syslog(pamh, LOG_ERR, "failed to load configuration");
+    return PAM_SESSION_ERR;
+  }
+
+  int ret = enroll_session(&syscall_ops_default, user, &config, &opts);
+  if (ret < 0) {
+    pam_syslog(pamh, LOG_ERR, "cannot ensure subordinate IDs for %s: %s",
+               user, strerror(errno));
+    return PAM_SESSION_ERR;
+  }
+  return ret == 0 ? PAM_SUCCESS : PAM_IGNORE;
+}
+
+/**
+ * pam_sm_close_session - Nothing to undo when a session ends
+ * @pamh: PAM handle (unused)
+ * @flags: PAM flags (unused)
+ * @argc: Number of module arguments (unused)
+ * @argv: Module arguments (unused)
+ *
+ * Return: PAM_SUCCESS
+ */
+int pam_sm_close_session(pam_handle_t *pamh, int flags, int argc,
+                         const char **argv) {
+  (void)pamh;
+  (void)flags;
+  (void)argc;
+  (void)argv;
+  return PAM_SUCCESS;
+}
@@ -0,0 +1,399 @@
+/**
+ * passwd.c - passwd database lookups with a deadline
+ *
+ * Every user lookup goes through the reentrant getpwnam_r(3) and
+ * getpwuid_r(3), growing the buffer on ERANGE, so the same code is safe in
+ * the daemon and on the batch resolver threads.
+ *
+ * With RESOLVE_TIMEOUT_MS set the lookup runs on a helper thread and the
+ * caller waits at most that long for it. NSS offers no way to cancel a
+ * lookup, so a helper that misses the deadline is left to finish on its
+ * own: it owns everything it touches and frees it when it is done.
+ *
+ * A hung backend would otherwise cost the daemon one stuck thread per
+ * request, so at most PASSWD_HELPERS_MAX helpers exist at a time. Once
+ * that many are outstanding, further timed lookups fail at once with
+ * ETIMEDOUT, exactly as if they had missed their deadline, until stuck
+ * helpers return.
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <pwd.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <threads.h>
+#include <time.h>
+#include <unistd.h>
+
+/* getpw*_r(3) buffer when sysconf(_SC_GETPW_R_SIZE_MAX) has no answer */
+#define PASSWD_BUF_DEFAULT 1024
+
+/* ERANGE doubles the buffer up to this size, after which the lookup fails */
+#define PASSWD_BUF_MAX (1024 * 1024)
+
+/* Helper threads alive, counted against PASSWD_HELPERS_MAX */
+static atomic_uint passwd_helpers = 0;
+
+/**
+ * struct passwd_job_t - A lookup handed to a helper thread
+ * @ops: Copy of the caller's operations, which may not outlive the wait
+ * @name: Copy of the username to look up, NULL to look up @uid
+ * @uid: UID to look up when @name is NULL
+ * @scratch: Helper's own getpw*_r(3) buffer
+ * @found_uid: UID found
+ * @found_name: Name found, points into @scratch
+ * @error: 0 or errno of the failed lookup
+ * @done: The helper has filled in the result
+ * @refs: Caller and helper each hold one, the last to let go frees the job
+ * @lock: Protects @done and the result
+ * @cond: Signalled when @done is set
+ */
+typedef struct {
+  struct syscall_ops ops;
+  char *name;
+  uint32_t uid;
+  passwd_buf_t scratch;
+  uint32_t found_uid;
+  const char *found_name;
+  int error;
+  bool done;
+  atomic_int refs;
+  mtx_t lock;
+  cnd_t cond;
+} passwd_job_t;
+
+/*
+ * Forward declarations for internal functions
+ *
+ * We can use nonnull on static functions because they can only be called
+ * from inside here and we're careful to check the pointers in our visible
+ * function(s).
+ */
+static int passwd_getpw(const struct syscall_ops *ops, const char *name,
+                        uint32_t uid, passwd_buf_t *scratch,
+                        uint32_t *uid_out, const char **name_out)
+    __attribute__((nonnull(1, 4, 5, 6))) __attribute__((warn_unused_result));
+static passwd_job_t *passwd_job_new(const struct syscall_ops *ops,
+                                    const char *name, uint32_t uid)
+    __attribute__((nonnull(1))) __attribute__((warn_unused_result));
+static void passwd_job_put(passwd_job_t *job) __attribute__((nonnull));
+static int passwd_job_run(void *arg) __attribute__((nonnull));
+static int passwd_copy_name(const struct syscall_ops *ops,
+                            passwd_buf_t *scratch, const char *name,
+                            const char **name_out)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+
+/**
+ * passwd_getpw - One lookup on the calling thread
+ * @ops: Operations structure (needed for getpw*_r and calloc)
+ * @name: Username to look up, NULL to look up @uid
+ * @uid: UID to look up when @name is NULL
+ * @scratch: Buffer, allocated or grown as needed
+ * @uid_out: Set to the UID found
+ * @name_out: Set to the name found, valid while @scratch is
+ *
+ * Return: 0 on success, -1 on error (errno set)
+ */
+static int passwd_getpw(const struct syscall_ops *ops, const char *name,
+                        uint32_t uid, passwd_buf_t *scratch,
+                        uint32_t *uid_out, const char **name_out) {
+  if (scratch->buf == NULL) {
+    long size = sysconf(_SC_GETPW_R_SIZE_MAX);
+    scratch->size = size > 0 ? (size_t)size : PASSWD_BUF_DEFAULT;
+    scratch->buf = ops->calloc(1, scratch->size);
+    if (scratch->buf == NULL) {
+      scratch->size = 0;
+      errno = ENOMEM;
+      return -1;
+    }
+  }
+
+  struct passwd pwd = {0};
+  struct passwd *result = NULL;
+  for (;;) {
+    int ret = name != NULL
+                  ? ops->getpwnam_r(name, &pwd, scratch->buf, scratch->size,
+                                    &result)
+                  : ops->getpwuid_r((uid_t)uid, &pwd, scratch->buf,
+                                    scratch->size, &result);
+    if (ret == 0) {
+      break;
+    }
+    if (ret != ERANGE || scratch->size >= PASSWD_BUF_MAX) {
+      errno = ret;
+      return -1;
+    }
+
+    /* Too small for this entry: start over with twice the room */
+    size_t size = scratch->size * 2;
+    char *grown = ops->calloc(1, size);
+    if (grown == NULL) {
+      errno = ENOMEM;
+      return -1;
+    }
+    ops->free(scratch->buf);
+    scratch->buf = grown;
+    scratch->size = size;
+  }
+
+  if (result == NULL) {
+    errno = ENOENT;
+    return -1;
+  }
+  /* Defensive check: pwd.pw_name must not be NULL */
+  if (pwd.pw_name == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  *uid_out = (uint32_t)pwd.pw_uid;
+  *name_out = pwd.pw_name;
+  return 0;
+}
+
+/**
+ * passwd_job_new - Set up a lookup for a helper thread
+ * @ops: Operations structure, copied into the job
+ * @name: Username to look up (copied), NULL to look up @uid
+ * @uid: UID to look up when @name is NULL
+ *
+ * Return: Job holding two references, NULL on error (errno set)
+ */
+static passwd_job_t *passwd_job_new(const struct syscall_ops *ops,
+                                    const char *name, uint32_t uid) {
+  passwd_job_t *job = ops->calloc(1, sizeof(*job));
+  if (job == NULL) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  job->ops = *ops;
+  job->uid = uid;
+  if (name != NULL) {
+    size_t len = strlen(name) + 1;
+    job->name = ops->calloc(len, sizeof(*job->name));
+    if (job->name == NULL) {
+      ops->free(job);
+      errno = ENOMEM;
+      return NULL;
+    }
+    (void)memcpy(job->name, name, len);
+  }
+
+  // LCOV_EXCL_START
+  if (mtx_init(&job->lock, mtx_plain) != thrd_success) {
+    ops->free(job->name);
+    ops->free(job);
+    errno = ENOMEM;
+    return NULL;
+  }
+  if (cnd_init(&job->cond) != thrd_success) {
+    mtx_destroy(&job->lock);
+    ops->free(job->name);
+    ops->free(job);
+    errno = ENOMEM;
+    return NULL;
+  }
+  // LCOV_EXCL_STOP
+
+  atomic_init(&job->refs, 2);
+  return job;
+}
+
+/**
+ * passwd_job_put - Drop one reference to @job, freeing it with the last
+ * @job: Job from passwd_job_new()
+ */
+static void passwd_job_put(passwd_job_t *job) {
+  if (atomic_fetch_sub(&job->refs, 1) != 1) {
+    return;
+  }
+
+  cnd_destroy(&job->cond);
+  mtx_destroy(&job->lock);
+  passwd_buf_free(&job->ops, &job->scratch);
+  job->ops.free(job->name);
+  job->ops.free(job);
+}
+
+/**
+ * passwd_job_run - Helper thread: do the lookup, then report it
+ * @arg: passwd_job_t
+ *
+ * Return: 0, as a thrd_start_t
+ */
+static int passwd_job_run(void *arg) {
+  passwd_job_t *job = arg;
+  uint32_t found_uid = 0;
+  const char *found_name = NULL;
+
+  int error = passwd_getpw(&job->ops, job->name, job->uid, &job->scratch,
+                           &found_uid, &found_name) == 0
+                  ? 0
+                  : errno;
+  (void)atomic_fetch_sub(&passwd_helpers, 1);
+
+  (void)mtx_lock(&job->lock);
+  job->found_uid = found_uid;
+  job->found_name = found_name;
+  job->error = error;
+  job->done = true;
+  (void)cnd_signal(&job->cond);
+  (void)mtx_unlock(&job->lock);
+
+  passwd_job_put(job);
+  return 0;
+}
+
+/**
+ * passwd_copy_name - Copy a helper's result into the caller's buffer
+ * @ops: Operations structure (needed for calloc)
+ * @scratch: Caller's buffer, grown if too small
+ * @name: Name to copy
+ * @name_out: Set to the copy
+ *
+ * Return: 0 on success, -1 on error (errno set)
+ */
+static int passwd_copy_name(const struct syscall_ops *ops,
+                            passwd_buf_t *scratch, const char *name,
+                            const char **name_out) {
+  size_t len = strlen(name) + 1;
+  if (scratch->size < len) {
+    char *buf = ops->calloc(1, len);
+    if (buf == NULL) {
+      errno = ENOMEM;
+      return -1;
+    }
+    ops->free(scratch->buf);
+    scratch->buf = buf;
+    scratch->size = len;
+  }
+
+  (void)memcpy(scratch->buf, name, len);
+  *name_out = scratch->buf;
+  return 0;
+}
+
+/**
+ * passwd_lookup - Look up a user by name or UID, within a deadline
+ * @ops: Operations structure for system call abstraction
+ * @name: Username to look up, NULL to look up @uid
+ * @uid: UID to look up when @name is NULL
+ * @timeout_ms: Deadline in milliseconds, 0 to wait as long as NSS takes
+ * @scratch: Zeroed or reused buffer, released with passwd_buf_free()
+ * @uid_out: Set to the UID found
+ * @name_out: Set to the name found, valid until @scratch is reused
+ *
+ * Nothing is printed, callers word the failure for their context.
+ *
+ * Return: 0 on success, -1 on error with errno ENOENT (no such user),
+ *         EINVAL (entry without a name), ETIMEDOUT (deadline missed, or
+ *         PASSWD_HELPERS_MAX helpers still stuck), ENOMEM or whatever
+ *         getpw*_r(3) reported
+ */
+int passwd_lookup(const struct syscall_ops *ops, const char *name,
+                  uint32_t uid, unsigned int timeout_ms,
+                  passwd_buf_t *scratch, uint32_t *uid_out,
+                  const char **name_out) {
+  if (ops == NULL || scratch == NULL || uid_out == NULL || name_out == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  *uid_out = 0;
+  *name_out = NULL;
+
+  if (timeout_ms == 0) {
+    return passwd_getpw(ops, name, uid, scratch, uid_out, name_out);
+  }
+
+  struct timespec deadline = {0};
+  (void)timespec_get(&deadline, TIME_UTC);
+  deadline.tv_sec += timeout_ms / 1000;
+  deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+  if (deadline.tv_nsec >= 1000000000L) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000L;
+  }
+
+  /* Every slot is taken by a helper NSS has not let go of yet */
+  if (atomic_fetch_add(&passwd_helpers, 1) >= PASSWD_HELPERS_MAX) {
+    (void)atomic_fetch_sub(&passwd_helpers, 1);
+    errno = ETIMEDOUT;
+    return -1;
+  }
+
+  /* The helper may still hold the job after a request's arena is reset */
+  arena_t *arena = arena_suspend();
+  passwd_job_t *job = passwd_job_new(ops, name, uid);
+  arena_resume(arena);
+  if (job == NULL) {
+    int saved_errno = errno;
+    (void)atomic_fetch_sub(&passwd_helpers, 1);
+    errno = saved_errno;
+    return -1;
+  }
+
+  thrd_t helper;
+  // LCOV_EXCL_START
+  if (thrd_create(&helper, passwd_job_run, job) != thrd_success) {
+    /* No thread to wait on: look up without the deadline */
+    (void)atomic_fetch_sub(&passwd_helpers, 1);
+    atomic_store(&job->refs, 1);
+    passwd_job_put(job);
+    return passwd_getpw(ops, name, uid, scratch, uid_out, name_out);
+  }
+  // LCOV_EXCL_STOP
+  (void)thrd_detach(helper);
+
+  (void)mtx_lock(&job->lock);
+  while (!job->done) {
+    /* thrd_timedout, or an error we cannot wait through either */
+    if (cnd_timedwait(&job->cond, &job->lock, &deadline) != thrd_success) {
+      break;
+    }
+  }
+
+  int ret = 0;
+  if (!job->done) {
+    errno = ETIMEDOUT;
+    ret = -1;
+  } else if (job->error != 0) {
+    errno = job->error;
+    ret = -1;
+  } else if (passwd_copy_name(ops, scratch, job->found_name, name_out) ==
+             0) {
+    *uid_out = job->found_uid;
+  } else {
+    ret = -1;
+  }
+  (void)mtx_unlock(&job->lock);
+
+  int saved_errno = errno;
+  passwd_job_put(job);
+  errno = saved_errno;
+  return ret;
+}
+
+/**
+ * passwd_buf_free - Release a passwd_lookup() buffer
+ * @ops: Operations structure the buffer was allocated with
+ * @scratch: Buffer, zeroed again on return
+ */
+void passwd_buf_free(const struct syscall_ops *ops, passwd_buf_t *scratch) {
+  if (ops == NULL || scratch == NULL) {
+    return;
+  }
+
+  ops->free(scratch->buf);
+  *scratch = (passwd_buf_t){0};
+}
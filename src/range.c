@@ -1,5 +1,11 @@
 /**
  * range.c - Subordinate ID range calculation
+ *
+ * Ranges are laid end to end in UID order, starting at min_val. With
+ * SUB_UID_BANDS/SUB_GID_BANDS the UIDs fall into segments that each have
+ * their own count per user; subid_segments_build() stores where each
+ * segment's ranges begin, so finding a range is a binary search over at
+ * most SUBID_SEGMENTS_MAX entries and one multiply.
  */
 
 /* clang-format off */
@@ -13,6 +19,131 @@
 #include <stdint.h>
 #include <stdio.h>
 
+/*
+ * Forward declarations for internal functions
+ *
+ * We can use nonnull on static functions because they can only be called
+ * from inside here and we're careful to check the pointers in our visible
+ * function(s).
+ */
+static const subid_segment_t *find_segment(const subid_config_t *subid_cfg,
+                                           uint32_t uid)
+    __attribute__((nonnull(1))) __attribute__((warn_unused_result));
+static uint32_t next_segment_uid(const subid_config_t *subid_cfg,
+                                 uint32_t uid)
+    __attribute__((nonnull(1))) __attribute__((warn_unused_result));
+static uint64_t logical_end(const subid_config_t *subid_cfg, uint32_t uid_min,
+                            uint32_t uid_max)
+    __attribute__((nonnull(1))) __attribute__((warn_unused_result));
+static uint32_t locate_owner(const subid_config_t *subid_cfg,
+                             uint32_t uid_min, uint64_t pos,
+                             uint64_t *range_start, uint32_t *count)
+    __attribute__((nonnull(1, 4, 5))) __attribute__((warn_unused_result));
+
+/*
+ * find_segment - Segment holding @uid
+ * @subid_cfg: Subordinate ID configuration with a segment table
+ * @uid: User ID
+ *
+ * Return: Last segment starting at or below @uid, NULL if there is no
+ *         table or @uid comes before all of it
+ */
+static const subid_segment_t *find_segment(const subid_config_t *subid_cfg,
+                                           uint32_t uid) {
+  size_t lo = 0;
+  size_t hi = subid_cfg->segment_count;
+
+  /* First segment starting above @uid */
+  while (lo < hi) {
+    size_t mid = lo + ((hi - lo) / 2);
+    if (subid_cfg->segments[mid].uid_lo <= uid) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo == 0 ? NULL : &subid_cfg->segments[lo - 1];
+}
+
+/*
+ * next_segment_uid - First UID past the segment holding @uid
+ * @subid_cfg: Subordinate ID configuration
+ * @uid: User ID
+ *
+ * Return: First UID of the next segment, 0 if @uid is in the last one or
+ *         there is no segment table (a later segment never starts at 0)
+ */
+static uint32_t next_segment_uid(const subid_config_t *subid_cfg,
+                                 uint32_t uid) {
+  const subid_segment_t *seg = find_segment(subid_cfg, uid);
+  const subid_segment_t *end =
+      subid_cfg->segments + subid_cfg->segment_count;
+  if (seg == NULL || seg + 1 == end) {
+    return 0;
+  }
+  return seg[1].uid_lo;
+}
+
+/*
+ * logical_end - Position just past the range of @uid_max, before wrapping
+ * @subid_cfg: Subordinate ID configuration
+ * @uid_min: Minimum UID from configuration
+ * @uid_max: Maximum UID from configuration, at least @uid_min
+ *
+ * Return: Sum of the counts of every UID in [@uid_min, @uid_max]
+ */
+static uint64_t logical_end(const subid_config_t *subid_cfg, uint32_t uid_min,
+                            uint32_t uid_max) {
+  const subid_segment_t *seg = find_segment(subid_cfg, uid_max);
+  if (seg == NULL) {
+    return ((uint64_t)uid_max - uid_min + 1) * subid_cfg->count_val;
+  }
+  return seg->offset + ((uint64_t)uid_max - seg->uid_lo + 1) * seg->count;
+}
+
+/*
+ * locate_owner - UID whose range covers logical position @pos
+ * @subid_cfg: Subordinate ID configuration
+ * @uid_min: Minimum UID from configuration
+ * @pos: Position relative to min_val before wrapping, below logical_end()
+ * @range_start: Set to the position the range starts at
+ * @count: Set to the size of the range
+ *
+ * The segment offsets increase with the UID, so the segment is found by
+ * a binary search on them and the UID inside it by one division.
+ *
+ * Return: The UID
+ */
+static uint32_t locate_owner(const subid_config_t *subid_cfg,
+                             uint32_t uid_min, uint64_t pos,
+                             uint64_t *range_start, uint32_t *count) {
+  uint32_t base = uid_min;
+  uint64_t offset = 0;
+  *count = subid_cfg->count_val;
+
+  if (subid_cfg->segment_count > 0) {
+    size_t lo = 0;
+    size_t hi = subid_cfg->segment_count;
+    while (lo < hi) {
+      size_t mid = lo + ((hi - lo) / 2);
+      if (subid_cfg->segments[mid].offset <= pos) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    /* segments[0].offset is 0, so lo is at least 1 */
+    const subid_segment_t *seg = &subid_cfg->segments[lo - 1];
+    base = seg->uid_lo;
+    offset = seg->offset;
+    *count = seg->count;
+  }
+
+  uint64_t index = (pos - offset) / *count;
+  *range_start = offset + (index * *count);
+  return base + (uint32_t)index;
+}
+
 /*
  * calc_subid_range - Calculate subordinate ID range for a user
  * @uid: User ID
@@ -28,7 +159,13 @@
  *   start_id       = min_val + logical_offset
  *   end_id         = start_id + count - 1
  *
- * The assigned range is always a single contiguous block of size `count`.
+ * With bands the UID's segment (see subid_segments_build()) supplies both
+ * the count and the starting point:
+ *   logical_offset = segment offset + (uid - segment uid_lo) * count
+ * which is the base formula when there is a single segment.
+ *
+ * The assigned range is always a single contiguous block of size `count`,
+ * as returned by calc_subid_count().
  *
  * Two operating modes exist:
  *
@@ -81,6 +218,21 @@ int calc_subid_range(uint32_t uid, uint32_t uid_min,
   }
 
   uint32_t count = subid_cfg->count_val;
+  uint32_t base = uid_min;
+  uint64_t seg_offset = 0;
+
+  if (subid_cfg->segment_count > 0) {
+    const subid_segment_t *seg = find_segment(subid_cfg, uid);
+    if (seg == NULL) {
+      errno = EINVAL;
+      (void)fprintf(stderr, "%s: error: UID %u less than uid_min %u\n",
+                    PROJECT_NAME, uid, subid_cfg->segments[0].uid_lo);
+      return -1;
+    }
+    count = seg->count;
+    base = seg->uid_lo;
+    seg_offset = seg->offset;
+  }
 
   /* Don't allocate a range of 0 entries, that makes no sense */
   if (count == 0) {
@@ -92,7 +244,7 @@ int calc_subid_range(uint32_t uid, uint32_t uid_min,
   uint32_t min_val = subid_cfg->min_val;
   uint32_t max_val = subid_cfg->max_val;
   uint32_t start_id = subid_cfg->min_val;
-  uint32_t uid_offset = uid - uid_min;
+  uint32_t uid_offset = uid - base;
 
   /*
    * Total available subordinate ID space.
@@ -113,7 +265,7 @@ int calc_subid_range(uint32_t uid, uint32_t uid_min,
                   "not enough space for any subid in range\n",
                   PROJECT_NAME, uid, subid_cfg->key_min, subid_cfg->min_val,
                   subid_cfg->key_max, subid_cfg->max_val, subid_cfg->key_count,
-                  subid_cfg->count_val);
+                  count);
 
     return -1;
   }
@@ -128,7 +280,9 @@ int calc_subid_range(uint32_t uid, uint32_t uid_min,
     uint32_t product = 0;
     uint32_t end_id = 0;
 
-    if (__builtin_mul_overflow(uid_offset, count, &product)) {
+    if (__builtin_mul_overflow(uid_offset, count, &product) ||
+        seg_offset > UINT32_MAX_VAL ||
+        __builtin_add_overflow(product, (uint32_t)seg_offset, &product)) {
       errno = ERANGE;
       (void)fprintf(stderr,
                     "%s: error: overflow calculating range for UID %u\n",
@@ -171,10 +325,316 @@ int calc_subid_range(uint32_t uid, uint32_t uid_min,
    *
    * Overflow is not detected — it is expected and desired.
    */
-  uint64_t logical_offset = (uint64_t)uid_offset * (uint64_t)count;
+  uint64_t logical_offset =
+      seg_offset + ((uint64_t)uid_offset * (uint64_t)count);
 
   start_id = min_val + (uint32_t)(logical_offset % space);
 
   *start_out = start_id;
   return 0;
 }
+
+/*
+ * calc_subid_owner - Find which UIDs calc_subid_range() gives @id to
+ * @id: Subordinate ID
+ * @uid_min: Minimum UID from configuration
+ * @uid_max: Maximum UID from configuration
+ * @subid_cfg: Subordinate ID configuration (min, max, count, segments)
+ * @allow_wrap: Ranges were calculated in wrap mode
+ * @uids: Output candidate UIDs, in increasing order
+ * @max: Capacity of @uids
+ * @found: Set to the number of UIDs stored in @uids
+ *
+ * Inverts the formula of calc_subid_range() without reading any file.
+ *
+ * In strict mode ranges never overlap, so there is at most one owner:
+ *   uid = uid_min + (id - min_val) / count
+ * provided that UID is at most uid_max and its range fits below max_val.
+ * With bands the segment is found first, by a binary search on the
+ * segment offsets, and the division is done inside it.
+ *
+ * In wrap mode the ranges are laid end to end on a line and folded onto
+ * the ring every `space` IDs, so each lap of the ring holds at most one
+ * range covering @id. Lap j puts @id at linear position
+ *   x = j * space + (id - min_val)
+ * whose range is the one covering x, but only if that range starts in
+ * lap j: a range straddling two laps is not folded back, it simply
+ * continues past max_val. The candidates are therefore bounded by the
+ * number of laps, (sum of all counts) / space + 1.
+ *
+ * Return: 0 if every owner is in @uids, 1 if there were more than @max,
+ *         -1 on error
+ */
+int calc_subid_owner(uint32_t id, uint32_t uid_min, uint32_t uid_max,
+                     const subid_config_t *subid_cfg, bool allow_wrap,
+                     uint32_t *uids, size_t max, size_t *found) {
+  if (!subid_cfg || !found || (!uids && max > 0)) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: NULL parameter in calc_subid_owner\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  *found = 0;
+
+  uint32_t count = subid_cfg->count_val;
+  if (count == 0) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: count_val is zero\n", PROJECT_NAME);
+    return -1;
+  }
+
+  /* Every band has to fit as well, or its ranges cannot be inverted */
+  uint32_t largest = count;
+  const char *largest_key = subid_cfg->key_count;
+  for (size_t i = 0; i < subid_cfg->segment_count; i++) {
+    if (subid_cfg->segments[i].count > largest) {
+      largest = subid_cfg->segments[i].count;
+      largest_key = subid_cfg->key_bands;
+    }
+  }
+
+  uint32_t min_val = subid_cfg->min_val;
+  uint32_t max_val = subid_cfg->max_val;
+  uint64_t space = (uint64_t)max_val - min_val + 1;
+  if (largest > space) {
+    errno = ERANGE;
+    (void)fprintf(stderr,
+                  "%s: error: %s=%u %s=%u %s=%u not enough space for any "
+                  "subid in range\n",
+                  PROJECT_NAME, subid_cfg->key_min, subid_cfg->min_val,
+                  subid_cfg->key_max, subid_cfg->max_val, largest_key,
+                  largest);
+    return -1;
+  }
+
+  if (id < min_val || uid_max < uid_min) {
+    return 0;
+  }
+
+  uint64_t total = logical_end(subid_cfg, uid_min, uid_max);
+  uint64_t pos = (uint64_t)id - min_val;
+  uint64_t range_start = 0;
+
+  /* STRICT MODE: one contiguous line of ranges, no overlaps */
+  if (!allow_wrap) {
+    if (id > max_val || pos >= total) {
+      return 0;
+    }
+    uint32_t uid = locate_owner(subid_cfg, uid_min, pos, &range_start, &count);
+    if (range_start + count - 1 > (uint64_t)max_val - min_val) {
+      return 0;
+    }
+    if (max == 0) {
+      return 1;
+    }
+    uids[0] = uid;
+    *found = 1;
+    return 0;
+  }
+
+  /* WRAP MODE: at most one candidate per lap of the ring */
+  for (uint64_t lap = 0;; lap++) {
+    uint64_t lap_start = 0;
+    uint64_t x = 0;
+    if (__builtin_mul_overflow(lap, space, &lap_start) ||
+        __builtin_add_overflow(lap_start, pos, &x) || x >= total) {
+      break;
+    }
+
+    uint32_t uid = locate_owner(subid_cfg, uid_min, x, &range_start, &count);
+    if (range_start < lap_start || range_start - lap_start >= space) {
+      continue;
+    }
+
+    if (*found == max) {
+      return 1;
+    }
+    uids[(*found)++] = uid;
+  }
+
+  return 0;
+}
+
+/*
+ * calc_subid_count - Number of subordinate IDs @uid is given
+ * @uid: User ID
+ * @subid_cfg: Subordinate ID configuration (count, segments)
+ *
+ * Return: The count of the band holding @uid, count_val outside every
+ *         band, 0 if @subid_cfg is NULL
+ */
+uint32_t calc_subid_count(uint32_t uid, const subid_config_t *subid_cfg) {
+  if (!subid_cfg) {
+    return 0;
+  }
+
+  const subid_segment_t *seg = find_segment(subid_cfg, uid);
+  return seg != NULL ? seg->count : subid_cfg->count_val;
+}
+
+/*
+ * subid_segments_build - Build the prefix-sum table of the bands
+ * @subid_cfg: Subordinate ID configuration with bands that passed
+ *             validate_subid_bands()
+ * @uid_min: Minimum UID from configuration
+ *
+ * Splits the UIDs from @uid_min upwards into segments: each band, the
+ * UIDs between two bands, and everything past the last band, the last
+ * two at count_val. Each segment records where its first range starts,
+ * the sum of the ranges of all UIDs before it, so calc_subid_range()
+ * never has to walk the bands. Without bands the table stays empty.
+ *
+ * Run after every change to the bands, count_val or @uid_min;
+ * load_configuration() and config_cache_load() do so.
+ */
+void subid_segments_build(subid_config_t *subid_cfg, uint32_t uid_min) {
+  if (!subid_cfg) {
+    return;
+  }
+
+  subid_cfg->segment_count = 0;
+  if (subid_cfg->band_count == 0) {
+    return;
+  }
+
+  uint32_t uid = uid_min;
+  uint64_t offset = 0;
+  size_t len = 0;
+  for (size_t i = 0; i < subid_cfg->band_count; i++) {
+    const subid_band_t *band = &subid_cfg->bands[i];
+    if (band->uid_lo > uid) {
+      subid_cfg->segments[len++] = (subid_segment_t){
+          .uid_lo = uid, .count = subid_cfg->count_val, .offset = offset};
+      offset += ((uint64_t)band->uid_lo - uid) * subid_cfg->count_val;
+    }
+    subid_cfg->segments[len++] = (subid_segment_t){
+        .uid_lo = band->uid_lo, .count = band->count, .offset = offset};
+    offset += ((uint64_t)band->uid_hi - band->uid_lo + 1) * band->count;
+
+    if (band->uid_hi == UINT32_MAX_VAL) {
+      /* Nothing past this band */
+      subid_cfg->segment_count = len;
+      return;
+    }
+    uid = band->uid_hi + 1;
+  }
+
+  subid_cfg->segments[len++] = (subid_segment_t){
+      .uid_lo = uid, .count = subid_cfg->count_val, .offset = offset};
+  subid_cfg->segment_count = len;
+}
+
+/*
+ * calc_subid_range_batch - calc_subid_range() for a whole band of UIDs
+ * @uid_first: First UID of the band
+ * @n: Number of consecutive UIDs
+ * @uid_min: Minimum UID from configuration
+ * @subid_cfg: Subordinate ID configuration (min, max, count, segments)
+ * @allow_wrap: Allow range calculation to wrap around using modulo
+ * @starts: Output start of range for UID @uid_first + i, @n entries
+ *
+ * Produces exactly what calc_subid_range() gives for each UID, but
+ * validates once per segment instead of per UID:
+ *
+ * The first UID of each segment the band crosses and the last UID of the
+ * band go through calc_subid_range() itself, so a band fails with the
+ * same message and errno as its first failing UID would. In strict mode
+ * the start is monotonic in the UID, so a last UID that fits proves that
+ * every UID before it fits as well, and the loop below needs no checks
+ * at all: start(i) = start(0) + i * count is a plain multiply-add the
+ * compiler can vectorize.
+ *
+ * In wrap mode start(i) = min_val + (offset(i) * count) mod space. Each
+ * step adds count, which is at most space, so the modulo reduces to one
+ * conditional subtraction and no division is done inside the loop.
+ *
+ * Return: 0 on success, -1 if any UID of the band fails (@starts is then
+ *         left untouched)
+ */
+int calc_subid_range_batch(uint32_t uid_first, size_t n, uint32_t uid_min,
+                           const subid_config_t *subid_cfg, bool allow_wrap,
+                           uint32_t *starts) {
+  if (!subid_cfg || !starts) {
+    errno = EINVAL;
+    (void)fprintf(stderr,
+                  "%s: error: NULL parameter in calc_subid_range_batch\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+  if (n == 0) {
+    return 0;
+  }
+
+  uint32_t uid_last = 0;
+  if (n - 1 > UINT32_MAX_VAL ||
+      __builtin_add_overflow(uid_first, (uint32_t)(n - 1), &uid_last)) {
+    errno = ERANGE;
+    (void)fprintf(stderr, "%s: error: UID band %u+%zu exceeds UID space\n",
+                  PROJECT_NAME, uid_first, n);
+    return -1;
+  }
+
+  /* Check every run before writing anything */
+  uint32_t first = 0;
+  uint32_t last = 0;
+  for (uint32_t uid = uid_first;;) {
+    if (calc_subid_range(uid, uid_min, subid_cfg, allow_wrap, &first) != 0) {
+      return -1;
+    }
+    uint32_t next = next_segment_uid(subid_cfg, uid);
+    if (next == 0 || next > uid_last) {
+      break;
+    }
+    uid = next;
+  }
+  if (calc_subid_range(uid_last, uid_min, subid_cfg, allow_wrap, &last) !=
+      0) {
+    return -1;
+  }
+
+  uint32_t min_val = subid_cfg->min_val;
+  uint32_t space = subid_cfg->max_val - min_val + 1;
+  size_t done = 0;
+  for (uint32_t uid = uid_first; done < n;) {
+    uint32_t next = next_segment_uid(subid_cfg, uid);
+    size_t run = next == 0 || next > uid_last ? n - done : next - uid;
+    uint32_t count = calc_subid_count(uid, subid_cfg);
+    uint32_t *out = starts + done;
+
+    // LCOV_EXCL_START
+    if (calc_subid_range(uid, uid_min, subid_cfg, allow_wrap, &first) != 0) {
+      /* Passed the same call above */
+      return -1;
+    }
+    // LCOV_EXCL_STOP
+
+    if (!allow_wrap) {
+      /*
+       * STRICT MODE
+       *
+       * start(n - 1) did not overflow, so no i * count below does either.
+       */
+      for (size_t i = 0; i < run; i++) {
+        out[i] = first + (uint32_t)i * count;
+      }
+    } else {
+      /*
+       * WRAP MODE
+       *
+       * Track offset(i) * count mod space incrementally. count <= space
+       * was checked by calc_subid_range(), so one subtraction normalizes
+       * a step.
+       */
+      uint32_t pos = first - min_val;
+      for (size_t i = 0; i < run; i++) {
+        out[i] = min_val + pos;
+        pos = pos >= space - count ? pos - (space - count) : pos + count;
+      }
+    }
+
+    done += run;
+    uid = next;
+  }
+  return 0;
+}
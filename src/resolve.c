@@ -0,0 +1,183 @@
+/**
+ * resolve.c - Parallel NSS resolution for batch mode
+ *
+ * With an LDAP or sssd backend each getpwnam_r(3) is a network round
+ * trip, so a serial batch spends most of its time waiting on NSS.
+ * resolve_pool_run() resolves a window of entries on up to @jobs threads
+ * (the caller's included), each claiming the next unresolved slot and
+ * reusing its own passwd_lookup() buffer. Nothing is printed and nothing is
+ * written here: the caller walks the slots in order afterwards, so output
+ * and exit status are the same as for a serial run.
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+/**
+ * struct resolve_pool_t - State shared by the resolver threads
+ * @ops: Operations structure for system call abstraction
+ * @slots: Entries to resolve
+ * @count: Number of @slots
+ * @username_size: Size of every slot's username buffer
+ * @timeout_ms: Deadline for each lookup, 0 for none
+ * @next: Index of the next unclaimed slot
+ */
+typedef struct {
+  const struct syscall_ops *ops;
+  resolve_slot_t *slots;
+  size_t count;
+  size_t username_size;
+  unsigned int timeout_ms;
+  atomic_size_t next;
+} resolve_pool_t;
+
+/*
+ * Forward declarations for internal functions
+ *
+ * We can use nonnull on static functions because they can only be called
+ * from inside here and we're careful to check the pointers in our visible
+ * function(s).
+ */
+static void resolve_one(const resolve_pool_t *pool, resolve_slot_t *slot,
+                        passwd_buf_t *scratch) __attribute__((nonnull));
+static int resolve_worker(void *arg) __attribute__((nonnull));
+
+/**
+ * resolve_one - Resolve one slot the way resolve_user() would
+ * @pool: Pool the slot belongs to
+ * @slot: Slot to fill in
+ * @scratch: Thread's passwd_lookup() buffer
+ *
+ * Numeric entries are UIDs, anything else must pass the username rules
+ * before NSS is asked about it. Failures only record their errno.
+ */
+static void resolve_one(const resolve_pool_t *pool, resolve_slot_t *slot,
+                        passwd_buf_t *scratch) {
+  uint32_t parsed_uid = 0;
+  bool by_uid = parse_uint32_strict(slot->entry, &parsed_uid) == 0;
+
+  if (!by_uid && validate_username_quiet(slot->entry) != 0) {
+    slot->error = errno;
+    return;
+  }
+
+  uint32_t found_uid = 0;
+  const char *found_name = NULL;
+  uint64_t started = stats_now();
+  int found = passwd_lookup(pool->ops, by_uid ? NULL : slot->entry,
+                            parsed_uid, pool->timeout_ms, scratch, &found_uid,
+                            &found_name);
+  stats_phase_add(STATS_RESOLVE, started);
+  if (found != 0) {
+    slot->error = errno;
+    return;
+  }
+
+  const char *name = by_uid ? found_name : slot->entry;
+  int written = snprintf(slot->username, pool->username_size, "%s", name);
+  if (written < 0 || (size_t)written >= pool->username_size) {
+    slot->error = ENAMETOOLONG;
+    return;
+  }
+
+  slot->uid = by_uid ? parsed_uid : found_uid;
+  slot->error = 0;
+}
+
+/**
+ * resolve_worker - Resolve slots until none are left
+ * @arg: resolve_pool_t shared with the other threads
+ *
+ * Return: 0, as a thrd_start_t
+ */
+static int resolve_worker(void *arg) {
+  resolve_pool_t *pool = arg;
+  passwd_buf_t scratch = {0};
+
+  for (;;) {
+    size_t i = atomic_fetch_add(&pool->next, 1);
+    if (i >= pool->count) {
+      break;
+    }
+    resolve_one(pool, &pool->slots[i], &scratch);
+  }
+
+  passwd_buf_free(pool->ops, &scratch);
+  return 0;
+}
+
+/**
+ * resolve_pool_run - Resolve batch entries on up to @jobs threads
+ * @ops: Operations structure for system call abstraction
+ * @slots: Entries to resolve, each with its own username buffer
+ * @count: Number of @slots
+ * @jobs: Maximum number of threads, the calling thread included
+ * @username_size: Size of every slot's username buffer
+ * @timeout_ms: RESOLVE_TIMEOUT_MS for each lookup, 0 for none
+ *
+ * Every slot ends with @error set: 0 and @username/@uid filled in, or the
+ * errno resolve_user() would have failed with. Threads that cannot be
+ * started only reduce the parallelism. Nothing is printed, so callers
+ * report failures in entry order, typically by retrying them through
+ * resolve_user().
+ *
+ * Return: 0 on success, -1 on invalid parameters
+ */
+int resolve_pool_run(const struct syscall_ops *ops, resolve_slot_t *slots,
+                     size_t count, unsigned int jobs, size_t username_size,
+                     unsigned int timeout_ms) {
+  if (ops == NULL || (slots == NULL && count > 0) || username_size == 0) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: invalid parameter in resolve_pool_run\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+  if (count == 0) {
+    return 0;
+  }
+
+  resolve_pool_t pool = {
+      .ops = ops,
+      .slots = slots,
+      .count = count,
+      .username_size = username_size,
+      .timeout_ms = timeout_ms,
+  };
+  atomic_init(&pool.next, 0);
+
+  size_t threads = jobs > RESOLVE_JOBS_MAX ? RESOLVE_JOBS_MAX : jobs;
+  if (threads > count) {
+    threads = count;
+  }
+
+  /* The calling thread is one of the workers */
+  thrd_t tids[RESOLVE_JOBS_MAX];
+  size_t started = 0;
+  while (started + 1 < threads) {
+    // LCOV_EXCL_START
+    if (thrd_create(&tids[started], resolve_worker, &pool) != thrd_success) {
+      break;
+    }
+    // LCOV_EXCL_STOP
+    started++;
+  }
+
+  (void)resolve_worker(&pool);
+  for (size_t i = 0; i < started; i++) {
+    (void)thrd_join(tids[i], NULL);
+  }
+
+  return 0;
+}
@@ -0,0 +1,343 @@
+/**
+ * spawn.c - Reusable state for spawning getsubids(1) and usermod(8)
+ *
+ * A helper needs a sanitized environment, file actions pointing its
+ * standard streams at /dev/null and a set of spawn attributes. None of
+ * that changes between helpers, so a spawn_ctx_t prepares it once and
+ * every spawn_helper() call reuses it.
+ *
+ * Batch and daemon runs install one context for the whole process with
+ * spawn_ctx_install(); elsewhere spawn_ctx_acquire() builds a short-lived
+ * one per call, preparing only the file actions that call needs.
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Allowlist: variables child processes legitimately need */
+static const char *const safe_environ_keys[] = {"LANG", "LC_ALL",
+                                                "LC_MESSAGES", "LC_CTYPE",
+                                                "TZ"};
+
+/* Number of entries in safe_environ_keys */
+#define SAFE_ENVIRON_KEYS                                                      \
+  (sizeof(safe_environ_keys) / sizeof(safe_environ_keys[0]))
+
+/* Context installed by spawn_ctx_install(), shared by every helper */
+static spawn_ctx_t process_ctx = {0};
+static bool process_ctx_ready = false;
+
+/*
+ * Forward declarations for internal functions
+ *
+ * We can use nonnull on static functions because they can only be called
+ * from inside here and we're careful to check the pointers in our visible
+ * function(s).
+ */
+static char **build_safe_environ(const struct syscall_ops *ops)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static const posix_spawn_file_actions_t *
+prepare_actions(const struct syscall_ops *ops, spawn_ctx_t *ctx, bool quiet)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+
+/**
+ * build_safe_environ - Build a sanitized environment for child processes
+ * @ops: Operations structure; ops->calloc is used for the array allocation
+ *
+ * Passes only variables needed for locale and timezone consistency.
+ * Explicitly excludes dynamic linker variables (LD_PRELOAD, LD_LIBRARY_PATH,
+ * etc.) and other environment injection vectors.
+ *
+ * environ is walked once; the first definition of each allowlisted
+ * variable wins, as with getenv(3). The returned array holds pointers
+ * directly into the original environ strings; the strings themselves are
+ * not copied and must not be freed.
+ *
+ * Context: The returned array is invalidated if environ is modified (e.g.
+ * by putenv/setenv) before it is passed to posix_spawn.
+ *
+ * Return: heap-allocated NULL-terminated char *[] on success, NULL on error
+ *         (ENOMEM). Release the array with ops->free().
+ */
+static char **build_safe_environ(const struct syscall_ops *ops) {
+  char **safe = ops->calloc(SAFE_ENVIRON_KEYS + 1, sizeof(char *));
+  if (safe == NULL) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  bool seen[SAFE_ENVIRON_KEYS] = {false};
+  size_t idx = 0;
+  for (char **ep = environ; ep != NULL && *ep != NULL; ep++) {
+    for (size_t i = 0; i < SAFE_ENVIRON_KEYS; i++) {
+      size_t klen = strlen(safe_environ_keys[i]);
+      if (!seen[i] && strncmp(*ep, safe_environ_keys[i], klen) == 0 &&
+          (*ep)[klen] == '=') {
+        seen[i] = true;
+        safe[idx++] = *ep;
+        break;
+      }
+    }
+  }
+
+  safe[idx] = NULL;
+  return safe;
+}
+
+/**
+ * prepare_actions - Return the file actions for a helper, preparing them
+ * @ops: Operations structure for system call abstraction
+ * @ctx: Context holding the file actions
+ * @quiet: Also send stdout and stderr to /dev/null
+ *
+ * stdin always reads /dev/null so no helper can wait on a TTY.
+ *
+ * Return: Prepared file actions, NULL on error (message printed)
+ */
+static const posix_spawn_file_actions_t *
+prepare_actions(const struct syscall_ops *ops, spawn_ctx_t *ctx, bool quiet) {
+  posix_spawn_file_actions_t *actions = quiet ? &ctx->quiet : &ctx->stdin_only;
+  bool *ready = quiet ? &ctx->have_quiet : &ctx->have_stdin_only;
+  if (*ready) {
+    return actions;
+  }
+
+  int ret = ops->posix_spawn_file_actions_init(actions);
+  if (ret != 0) {
+    errno = ret;
+    (void)fprintf(stderr,
+                  "%s: error: posix_spawn_file_actions_init failed: %s\n",
+                  PROJECT_NAME, strerror(ret));
+    return NULL;
+  }
+
+  ret = ops->posix_spawn_file_actions_addopen(actions, STDIN_FILENO,
+                                              "/dev/null", O_RDONLY, 0);
+  if (ret == 0 && quiet) {
+    ret = ops->posix_spawn_file_actions_addopen(actions, STDOUT_FILENO,
+                                                "/dev/null", O_WRONLY, 0);
+  }
+  if (ret == 0 && quiet) {
+    ret = ops->posix_spawn_file_actions_addopen(actions, STDERR_FILENO,
+                                                "/dev/null", O_WRONLY, 0);
+  }
+  if (ret != 0) {
+    ops->posix_spawn_file_actions_destroy(actions);
+    errno = ret;
+    (void)fprintf(stderr,
+                  "%s: error: posix_spawn_file_actions_addopen failed: %s\n",
+                  PROJECT_NAME, strerror(ret));
+    return NULL;
+  }
+
+  *ready = true;
+  return actions;
+}
+
+/**
+ * spawn_ctx_init - Prepare a context for spawning helpers
+ * @ops: Operations structure for system call abstraction
+ * @ctx: Context to initialise
+ *
+ * Builds the sanitized environment and the spawn attributes; the file
+ * actions are prepared by the first helper that needs them. Attributes
+ * are only a hint, so failing to set them up is not an error.
+ *
+ * Return: 0 on success, -1 on error (errno set)
+ */
+int spawn_ctx_init(const struct syscall_ops *ops, spawn_ctx_t *ctx) {
+  if (ops == NULL || ctx == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: invalid parameter in spawn_ctx_init\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+  *ctx = (spawn_ctx_t){0};
+
+  ctx->envp = build_safe_environ(ops);
+  if (ctx->envp == NULL) {
+    (void)fprintf(stderr, "%s: error: failed to build safe environment\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  if (ops->posix_spawnattr_init(&ctx->attr) == 0) {
+    ctx->have_attr = true;
+#ifdef POSIX_SPAWN_USEVFORK
+    /* glibc always spawns with clone(CLONE_VFORK) today, this is a hint */
+    if (ops->posix_spawnattr_setflags(&ctx->attr, POSIX_SPAWN_USEVFORK) !=
+        0) {
+      // LCOV_EXCL_START
+      (void)ops->posix_spawnattr_destroy(&ctx->attr);
+      ctx->have_attr = false;
+      // LCOV_EXCL_STOP
+    }
+#endif
+  }
+
+  return 0;
+}
+
+/**
+ * spawn_ctx_destroy - Release everything a context prepared
+ * @ops: Operations structure for system call abstraction
+ * @ctx: Context from spawn_ctx_init(), zeroed again on return
+ */
+void spawn_ctx_destroy(const struct syscall_ops *ops, spawn_ctx_t *ctx) {
+  if (ops == NULL || ctx == NULL) {
+    return;
+  }
+
+  if (ctx->have_quiet) {
+    ops->posix_spawn_file_actions_destroy(&ctx->quiet);
+  }
+  if (ctx->have_stdin_only) {
+    ops->posix_spawn_file_actions_destroy(&ctx->stdin_only);
+  }
+  if (ctx->have_attr) {
+    (void)ops->posix_spawnattr_destroy(&ctx->attr);
+  }
+  ops->free(ctx->envp);
+  *ctx = (spawn_ctx_t){0};
+}
+
+/**
+ * spawn_ctx_install - Prepare one context for every helper of this process
+ * @ops: Operations structure for system call abstraction
+ * @debug: Enable debug output
+ *
+ * Both sets of file actions are prepared up front, so the installed
+ * context is never modified afterwards. The environment is captured now:
+ * it must not change (setenv(3), putenv(3)) while the context is
+ * installed. Failing to install only costs the reuse.
+ *
+ * Return: 0 on success, -1 on error (helpers then build their own)
+ */
+int spawn_ctx_install(const struct syscall_ops *ops, bool debug) {
+  if (ops == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (process_ctx_ready) {
+    return 0;
+  }
+
+  if (spawn_ctx_init(ops, &process_ctx) != 0 ||
+      prepare_actions(ops, &process_ctx, true) == NULL ||
+      prepare_actions(ops, &process_ctx, false) == NULL) {
+    spawn_ctx_destroy(ops, &process_ctx);
+    if (debug) {
+      (void)fprintf(stderr,
+                    "%s: debug: no shared spawn context, preparing each "
+                    "helper on its own\n",
+                    PROJECT_NAME);
+    }
+    return -1;
+  }
+
+  process_ctx_ready = true;
+  return 0;
+}
+
+/**
+ * spawn_ctx_uninstall - Release the context from spawn_ctx_install()
+ * @ops: Operations structure for system call abstraction
+ */
+void spawn_ctx_uninstall(const struct syscall_ops *ops) {
+  if (ops == NULL || !process_ctx_ready) {
+    return;
+  }
+
+  spawn_ctx_destroy(ops, &process_ctx);
+  process_ctx_ready = false;
+}
+
+/**
+ * spawn_ctx_acquire - Find a context to spawn helpers with
+ * @ops: Operations structure for system call abstraction
+ * @local: Storage for a context of the caller's own
+ *
+ * Return: The installed context, else @local freshly initialised; NULL
+ *         on error (message printed). Hand it back to spawn_ctx_release().
+ */
+spawn_ctx_t *spawn_ctx_acquire(const struct syscall_ops *ops,
+                               spawn_ctx_t *local) {
+  if (ops == NULL || local == NULL) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if (process_ctx_ready) {
+    return &process_ctx;
+  }
+
+  return spawn_ctx_init(ops, local) == 0 ? local : NULL;
+}
+
+/**
+ * spawn_ctx_release - Hand back a context from spawn_ctx_acquire()
+ * @ops: Operations structure for system call abstraction
+ * @ctx: Context that was acquired, may be NULL
+ * @local: Storage passed to spawn_ctx_acquire()
+ *
+ * Only a context built in @local is destroyed; the installed one stays.
+ */
+void spawn_ctx_release(const struct syscall_ops *ops, spawn_ctx_t *ctx,
+                       spawn_ctx_t *local) {
+  if (ctx != NULL && ctx == local) {
+    spawn_ctx_destroy(ops, local);
+  }
+}
+
+/**
+ * spawn_helper - Start a helper with the context's environment
+ * @ops: Operations structure for system call abstraction
+ * @ctx: Context from spawn_ctx_acquire()
+ * @path: Absolute path of the helper (no PATH lookup)
+ * @argv: NULL-terminated argument vector
+ * @quiet: Send stdout and stderr to /dev/null as well as stdin
+ * @pid: Set to the child's PID
+ *
+ * Return: 0 on success, -1 on error (message printed, errno set)
+ */
+int spawn_helper(const struct syscall_ops *ops, spawn_ctx_t *ctx,
+                 const char *path, char *const argv[], bool quiet,
+                 pid_t *pid) {
+  if (ops == NULL || ctx == NULL || path == NULL || argv == NULL ||
+      pid == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: invalid parameter in spawn_helper\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  const posix_spawn_file_actions_t *actions =
+      prepare_actions(ops, ctx, quiet);
+  if (actions == NULL) {
+    return -1;
+  }
+
+  int ret = ops->posix_spawn(pid, path, actions,
+                             ctx->have_attr ? &ctx->attr : NULL, argv,
+                             ctx->envp);
+  if (ret != 0) {
+    errno = ret;
+    (void)fprintf(stderr, "%s: error: posix_spawn failed: %s\n", PROJECT_NAME,
+                  strerror(ret));
+    return -1;
+  }
+
+  stats_count(STATS_SPAWNS, 1);
+  return 0;
+}
@@ -0,0 +1,584 @@
+/**
+ * spool.c - Group commit of native writes across concurrent runs
+ *
+ * With SUBID_WRITER spool, a run that has ranges to record drops them into
+ * <dir>/spool/<pid>.req and then waits for an flock(2) on <dir>/spool/lock.
+ * Whoever holds the lock writes every request still pending with a single
+ * subid_txn_commit() and renames each one to <pid>.done or <pid>.fail.
+ * Runs that queued while that write was in progress usually find their
+ * request answered once they get the lock, so a burst of N logins costs a
+ * couple of rewrites of each database instead of N.
+ *
+ * The spool only orders runs of this tool among themselves; every rewrite
+ * still takes lckpwdf(3) and the per-file locks. Requests left by a
+ * process that is gone are discarded. Whenever the spool cannot be used
+ * the ranges are written directly, as SUBID_WRITER files would.
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Spool directory inside STAMP_DIR and the lock file inside it */
+#define SPOOL_SUBDIR "spool"
+#define SPOOL_LOCK_NAME "lock"
+
+/* Request states, as file name suffixes after the PID */
+#define SPOOL_TMP ".tmp"
+#define SPOOL_REQ ".req"
+#define SPOOL_DONE ".done"
+#define SPOOL_FAIL ".fail"
+
+/*
+ * Forward declarations for internal functions
+ *
+ * We can use nonnull on static functions because they can only be called
+ * from inside here and we're careful to check the pointers in our visible
+ * function(s).
+ */
+static int request_path(char *out, size_t size, const char *spool, long pid,
+                        const char *suffix) __attribute__((nonnull(1, 3, 5)))
+__attribute__((warn_unused_result));
+static int spool_prepare(const struct syscall_ops *ops, const char *dir,
+                         char *spool, size_t size, bool debug)
+    __attribute__((nonnull(1, 2, 3))) __attribute__((warn_unused_result));
+static int write_entries(FILE *out, char tag, const subid_entry_list_t *list)
+    __attribute__((nonnull(1, 3))) __attribute__((warn_unused_result));
+static int write_request(const struct syscall_ops *ops, const char *spool,
+                         const subid_txn_t *txn, bool debug)
+    __attribute__((nonnull(1, 2, 3))) __attribute__((warn_unused_result));
+static int read_request(const struct syscall_ops *ops, const char *path,
+                        subid_txn_t *txn) __attribute__((nonnull(1, 2, 3)))
+__attribute__((warn_unused_result));
+static int lock_spool(const struct syscall_ops *ops, const char *spool)
+    __attribute__((nonnull(1, 2))) __attribute__((warn_unused_result));
+static int own_outcome(const struct syscall_ops *ops, const char *spool,
+                       bool debug) __attribute__((nonnull(1, 2)))
+__attribute__((warn_unused_result));
+static int filter_requests(const struct dirent *entry)
+    __attribute__((nonnull(1))) __attribute__((warn_unused_result));
+static int flush_requests(const struct syscall_ops *ops, const char *spool,
+                          bool debug) __attribute__((nonnull(1, 2)))
+__attribute__((warn_unused_result));
+
+/**
+ * request_path - Build <spool>/<pid><suffix>
+ * @out: Output buffer
+ * @size: Size of @out
+ * @spool: Spool directory
+ * @pid: Process the request belongs to
+ * @suffix: One of SPOOL_TMP, SPOOL_REQ, SPOOL_DONE, SPOOL_FAIL
+ *
+ * Return: 0 on success, -1 if the result does not fit
+ */
+static int request_path(char *out, size_t size, const char *spool, long pid,
+                        const char *suffix) {
+  int ret = snprintf(out, size, "%s/%ld%s", spool, pid, suffix);
+  if (ret < 0 || (size_t)ret >= size) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * spool_prepare - Create the spool directory and check it is ours
+ * @ops: Operations structure for system call abstraction
+ * @dir: Parent directory (STAMP_DIR), created if missing
+ * @spool: Set to the spool directory path
+ * @size: Size of @spool
+ * @debug: Enable debug output
+ *
+ * Requests name the ranges to write into /etc, so the directory must be a
+ * real directory owned by us that nobody else can write to.
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int spool_prepare(const struct syscall_ops *ops, const char *dir,
+                         char *spool, size_t size, bool debug) {
+  int ret = snprintf(spool, size, "%s/%s", dir, SPOOL_SUBDIR);
+  if (ret < 0 || (size_t)ret >= size) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  if ((ops->mkdir(dir, 0755) != 0 && errno != EEXIST) ||
+      (ops->mkdir(spool, 0700) != 0 && errno != EEXIST)) {
+    return -1;
+  }
+
+  struct stat st = {0};
+  if (ops->lstat(spool, &st) != 0) {
+    return -1;
+  }
+  if (!S_ISDIR(st.st_mode) || st.st_uid != geteuid() ||
+      (st.st_mode & (S_IWGRP | S_IWOTH)) != 0) {
+    if (debug) {
+      (void)fprintf(stderr,
+                    "%s: debug: %s is not a private directory owned by UID "
+                    "%u\n",
+                    PROJECT_NAME, spool, (unsigned int)geteuid());
+    }
+    errno = EPERM;
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * write_entries - Append one database's entries to a request
+ * @out: Request stream
+ * @tag: 'u' for SUBUID_PATH, 'g' for SUBGID_PATH
+ * @list: Entries to write
+ *
+ * Return: 0 on success, -1 on write error
+ */
+static int write_entries(FILE *out, char tag, const subid_entry_list_t *list) {
+  for (size_t i = 0; i < list->len; i++) {
+    if (fprintf(out, "%c:%s:%u:%u\n", tag, list->entries[i].owner,
+                list->entries[i].start, list->entries[i].count) < 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * write_request - Publish our queued ranges as <spool>/<pid>.req
+ * @ops: Operations structure for system call abstraction
+ * @spool: Spool directory
+ * @txn: Ranges to publish
+ * @debug: Enable debug output
+ *
+ * The request is written under a temporary name and renamed into place,
+ * so a flushing run never reads half of it. Answers left for an earlier
+ * process with our PID are removed first so they cannot be mistaken for
+ * ours.
+ *
+ * Return: 0 on success, -1 on error (nothing left behind)
+ */
+static int write_request(const struct syscall_ops *ops, const char *spool,
+                         const subid_txn_t *txn, bool debug) {
+  char tmppath[PATH_MAX] = {0};
+  char path[PATH_MAX] = {0};
+  char done[PATH_MAX] = {0};
+  char fail[PATH_MAX] = {0};
+  long pid = (long)getpid();
+  if (request_path(tmppath, sizeof(tmppath), spool, pid, SPOOL_TMP) != 0 ||
+      request_path(path, sizeof(path), spool, pid, SPOOL_REQ) != 0 ||
+      request_path(done, sizeof(done), spool, pid, SPOOL_DONE) != 0 ||
+      request_path(fail, sizeof(fail), spool, pid, SPOOL_FAIL) != 0) {
+    return -1;
+  }
+  (void)ops->unlink(done);
+  (void)ops->unlink(fail);
+
+  int fd = ops->open(tmppath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC |
+                                  O_NOFOLLOW,
+                     0600);
+  if (fd < 0) {
+    return -1;
+  }
+  FILE *out = ops->fdopen(fd, "w");
+  if (out == NULL) {
+    int saved_errno = errno;
+    (void)ops->close(fd);
+    (void)ops->unlink(tmppath);
+    errno = saved_errno;
+    return -1;
+  }
+
+  /* fd now owned by out, don't close fd! */
+  int ret = 0;
+  if (write_entries(out, 'u', &txn->subuid) != 0 ||
+      write_entries(out, 'g', &txn->subgid) != 0 || fflush(out) != 0) {
+    ret = -1;
+  }
+  int saved_errno = errno;
+  if (ops->fclose(out) != 0 && ret == 0) {
+    ret = -1;
+    saved_errno = errno;
+  }
+  if (ret == 0 && ops->rename(tmppath, path) != 0) {
+    ret = -1;
+    saved_errno = errno;
+  }
+
+  if (ret != 0) {
+    (void)ops->unlink(tmppath);
+    errno = saved_errno;
+    return -1;
+  }
+
+  if (debug) {
+    (void)fprintf(stderr, "%s: debug: queued %zu ranges in %s\n",
+                  PROJECT_NAME, txn->subuid.len + txn->subgid.len, path);
+  }
+  return 0;
+}
+
+/**
+ * read_request - Add the ranges of a pending request to @txn
+ * @ops: Operations structure for system call abstraction
+ * @path: Request file
+ * @txn: Transaction to add to
+ *
+ * Every line is validated before anything is added, so a damaged request
+ * contributes nothing.
+ *
+ * Return: 0 on success, -1 on error (@txn unchanged)
+ */
+static int read_request(const struct syscall_ops *ops, const char *path,
+                        subid_txn_t *txn) {
+  int fd = ops->open(path, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+  if (fd < 0) {
+    return -1;
+  }
+  FILE *in = ops->fdopen(fd, "r");
+  if (in == NULL) {
+    int saved_errno = errno;
+    (void)ops->close(fd);
+    errno = saved_errno;
+    return -1;
+  }
+
+  size_t subuid_mark = txn->subuid.len;
+  size_t subgid_mark = txn->subgid.len;
+  char line[MAX_LINE_LEN] = {0};
+  int ret = 0;
+
+  while (ret == 0 && ops->fgets(line, sizeof(line), in) != NULL) {
+    const char *owner = NULL;
+    uint32_t start = 0;
+    uint32_t count = 0;
+    subid_mode_t mode = line[0] == 'g' ? SUBGID : SUBUID;
+
+    if ((line[0] != 'u' && line[0] != 'g') || line[1] != ':' ||
+        strchr(line, '\n') == NULL ||
+        subid_db_parse_line(line + 2, &owner, &start, &count) != 0 ||
+        validate_username(owner) != 0 || count == 0) {
+      errno = EINVAL;
+      ret = -1;
+    } else {
+      ret = subid_txn_add(ops, txn, mode, owner, start, count);
+    }
+  }
+  if (ret == 0 && ferror(in)) {
+    errno = EIO;
+    ret = -1;
+  }
+
+  int saved_errno = errno;
+  (void)ops->fclose(in);
+  if (ret != 0) {
+    subid_txn_truncate(ops, txn, subuid_mark, subgid_mark);
+  }
+  errno = saved_errno;
+  return ret;
+}
+
+/**
+ * lock_spool - Wait for our turn on <spool>/lock
+ * @ops: Operations structure for system call abstraction
+ * @spool: Spool directory
+ *
+ * Return: Locked descriptor (close it to unlock), -1 on error
+ */
+static int lock_spool(const struct syscall_ops *ops, const char *spool) {
+  char path[PATH_MAX] = {0};
+  int ret = snprintf(path, sizeof(path), "%s/%s", spool, SPOOL_LOCK_NAME);
+  if (ret < 0 || (size_t)ret >= sizeof(path)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  int fd = ops->open(path, O_RDWR | O_CREAT | O_CLOEXEC | O_NOFOLLOW, 0600);
+  if (fd < 0) {
+    return -1;
+  }
+
+  uint64_t started = stats_now();
+  while (ops->flock(fd, LOCK_EX) != 0) {
+    if (errno != EINTR) {
+      int saved_errno = errno;
+      (void)ops->close(fd);
+      errno = saved_errno;
+      return -1;
+    }
+  }
+  stats_phase_add(STATS_LOCK, started);
+  return fd;
+}
+
+/**
+ * own_outcome - Collect the answer to our request, if there is one
+ * @ops: Operations structure for system call abstraction
+ * @spool: Spool directory
+ * @debug: Enable debug output
+ *
+ * Called with the spool lock held. The answer file is removed.
+ *
+ * Return: 1 if our request is still pending, 0 if another run wrote it,
+ *         -1 if another run failed to write it (errno EIO)
+ */
+static int own_outcome(const struct syscall_ops *ops, const char *spool,
+                       bool debug) {
+  char path[PATH_MAX] = {0};
+  long pid = (long)getpid();
+  struct stat st = {0};
+
+  if (request_path(path, sizeof(path), spool, pid, SPOOL_REQ) != 0) {
+    return -1;
+  }
+  if (ops->lstat(path, &st) == 0) {
+    return 1;
+  }
+
+  if (request_path(path, sizeof(path), spool, pid, SPOOL_DONE) != 0) {
+    return -1;
+  }
+  if (ops->unlink(path) == 0) {
+    if (debug) {
+      (void)fprintf(stderr, "%s: debug: ranges written by another run\n",
+                    PROJECT_NAME);
+    }
+    return 0;
+  }
+
+  if (request_path(path, sizeof(path), spool, pid, SPOOL_FAIL) == 0) {
+    (void)ops->unlink(path);
+  }
+  (void)fprintf(stderr,
+                "%s: error: the group commit of our ranges failed, see the "
+                "log of the run that wrote it\n",
+                PROJECT_NAME);
+  errno = EIO;
+  return -1;
+}
+
+/**
+ * filter_requests - scandir() filter for pending requests
+ * @entry: Directory entry to check
+ *
+ * Return: 1 for "<digits>.req", 0 otherwise
+ */
+static int filter_requests(const struct dirent *entry) {
+  const char *name = entry->d_name;
+  size_t digits = strspn(name, "0123456789");
+  return digits > 0 && strcmp(name + digits, SPOOL_REQ) == 0;
+}
+
+/**
+ * flush_requests - Write every pending request with one commit
+ * @ops: Operations structure for system call abstraction
+ * @spool: Spool directory
+ * @debug: Enable debug output
+ *
+ * Called with the spool lock held when our own request is still pending.
+ * Each request is answered with <pid>.done or <pid>.fail; ours is simply
+ * removed and its result returned. A request that cannot be read fails on
+ * its own without holding up the others.
+ *
+ * Return: 0 if our ranges were written, -1 on error
+ */
+static int flush_requests(const struct syscall_ops *ops, const char *spool,
+                          bool debug) {
+  struct dirent **names = NULL;
+  int n = ops->scandir(spool, &names, filter_requests, alphasort);
+  if (n <= 0) {
+    ops->free(names);
+    errno = n == 0 ? ENOENT : errno;
+    return -1;
+  }
+
+  long self = (long)getpid();
+  bool *taken = ops->calloc((size_t)n, sizeof(*taken));
+  if (taken == NULL) {
+    char path[PATH_MAX] = {0};
+    (void)fprintf(stderr, "%s: error: memory allocation failed\n",
+                  PROJECT_NAME);
+    if (request_path(path, sizeof(path), spool, self, SPOOL_REQ) == 0) {
+      (void)ops->unlink(path);
+    }
+    for (int i = 0; i < n; i++) {
+      ops->free(names[i]);
+    }
+    ops->free(names);
+    errno = ENOMEM;
+    return -1;
+  }
+
+  subid_txn_t all = {0};
+  int own = -1;
+  int own_errno = ENOENT;
+  size_t requests = 0;
+
+  for (int i = 0; i < n; i++) {
+    char path[PATH_MAX] = {0};
+    uint32_t pid = 0;
+    char digits[UINT32_DECIMAL_MAX_LEN + 1] = {0};
+    size_t len = strspn(names[i]->d_name, "0123456789");
+
+    if (len >= sizeof(digits)) {
+      continue;
+    }
+    memcpy(digits, names[i]->d_name, len);
+    if (parse_uint32_strict(digits, &pid) != 0 || pid == 0 ||
+        pid > INT_MAX ||
+        request_path(path, sizeof(path), spool, (long)pid, SPOOL_REQ) != 0) {
+      continue;
+    }
+
+    /* Its owner gave up waiting or died, nobody wants the answer */
+    if ((long)pid != self && ops->kill((pid_t)pid, 0) != 0 &&
+        errno == ESRCH) {
+      if (debug) {
+        (void)fprintf(stderr, "%s: debug: discarding stale request %s\n",
+                      PROJECT_NAME, path);
+      }
+      (void)ops->unlink(path);
+      continue;
+    }
+
+    if (read_request(ops, path, &all) != 0) {
+      int saved_errno = errno;
+      (void)fprintf(stderr, "%s: warning: cannot read request %s: %s\n",
+                    PROJECT_NAME, path, strerror(saved_errno));
+      if ((long)pid == self) {
+        own_errno = saved_errno;
+        (void)ops->unlink(path);
+      } else {
+        char fail[PATH_MAX] = {0};
+        if (request_path(fail, sizeof(fail), spool, (long)pid, SPOOL_FAIL) !=
+                0 ||
+            ops->rename(path, fail) != 0) {
+          (void)ops->unlink(path);
+        }
+      }
+      continue;
+    }
+
+    taken[i] = true;
+    requests++;
+  }
+
+  if (debug) {
+    (void)fprintf(stderr, "%s: debug: writing %zu ranges from %zu requests\n",
+                  PROJECT_NAME, all.subuid.len + all.subgid.len, requests);
+  }
+  int ret = subid_txn_commit(ops, &all, debug);
+  int saved_errno = errno;
+
+  for (int i = 0; i < n; i++) {
+    char path[PATH_MAX] = {0};
+    char answer[PATH_MAX] = {0};
+    long pid = strtol(names[i]->d_name, NULL, 10);
+
+    if (taken[i] &&
+        request_path(path, sizeof(path), spool, pid, SPOOL_REQ) == 0) {
+      if (pid == self) {
+        own = ret;
+        own_errno = saved_errno;
+        (void)ops->unlink(path);
+      } else if (request_path(answer, sizeof(answer), spool, pid,
+                              ret == 0 ? SPOOL_DONE : SPOOL_FAIL) != 0 ||
+                 ops->rename(path, answer) != 0) {
+        (void)ops->unlink(path);
+      }
+    }
+    ops->free(names[i]);
+  }
+  ops->free(names);
+  ops->free(taken);
+  subid_txn_free(ops, &all);
+
+  if (own != 0) {
+    errno = own_errno;
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * subid_spool_commit - subid_txn_commit() shared with concurrent runs
+ * @ops: Operations structure for system call abstraction
+ * @dir: Directory holding the spool (STAMP_DIR), created if missing
+ * @txn: Transaction to commit
+ * @debug: Enable debug output
+ *
+ * Publishes @txn as a request, waits for the spool lock and then either
+ * finds the request already written by another run or writes it together
+ * with every other pending request. If the spool cannot be used at all
+ * @txn is committed directly.
+ *
+ * On success the queued entries are released and @txn can be reused.
+ *
+ * Return: 0 on success, -1 on error
+ */
+int subid_spool_commit(const struct syscall_ops *ops, const char *dir,
+                       subid_txn_t *txn, bool debug) {
+  if (ops == NULL || dir == NULL || txn == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: NULL parameter in subid_spool_commit\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  if (txn->subuid.len == 0 && txn->subgid.len == 0) {
+    return 0;
+  }
+
+  char spool[PATH_MAX] = {0};
+  if (spool_prepare(ops, dir, spool, sizeof(spool), debug) != 0 ||
+      write_request(ops, spool, txn, debug) != 0) {
+    (void)fprintf(stderr,
+                  "%s: warning: cannot use the spool in %s, writing "
+                  "directly: %s\n",
+                  PROJECT_NAME, dir, strerror(errno));
+    return subid_txn_commit(ops, txn, debug);
+  }
+
+  int lock_fd = lock_spool(ops, spool);
+  if (lock_fd < 0) {
+    (void)fprintf(stderr,
+                  "%s: warning: cannot lock the spool in %s, writing "
+                  "directly: %s\n",
+                  PROJECT_NAME, dir, strerror(errno));
+    char path[PATH_MAX] = {0};
+    if (request_path(path, sizeof(path), spool, (long)getpid(), SPOOL_REQ) ==
+        0) {
+      (void)ops->unlink(path);
+    }
+    return subid_txn_commit(ops, txn, debug);
+  }
+
+  int ret = own_outcome(ops, spool, debug);
+  if (ret > 0) {
+    ret = flush_requests(ops, spool, debug);
+  }
+
+  int saved_errno = errno;
+  (void)ops->close(lock_fd);
+  errno = saved_errno;
+
+  if (ret == 0) {
+    subid_txn_free(ops, txn);
+  }
+  return ret;
+}
@@ -0,0 +1,465 @@
+/**
+ * stamp.c - Per-UID "already done" stamp cache
+ *
+ * The per-session unit runs static-subid for every login although almost
+ * every run finds nothing to do. With --stamp-cache a successful run leaves
+ * STAMP_DIR/<uid> behind; the next run for that UID exits before any
+ * helper is spawned or database read, as long as the stamp still matches.
+ * The configuration comes from the snapshot keyed on the same fingerprint,
+ * so such a run parses nothing either; it is needed to bound the UID
+ * lookup with RESOLVE_TIMEOUT_MS.
+ *
+ * A stamp holds a fingerprint of every configuration source (path, inode,
+ * size, mtime and ctime of login.defs, the main config file, the drop-in
+ * directory and each drop-in), the requested modes and the username, so
+ * editing, adding or removing any config file, renaming the user or
+ * changing --subuid/--subgid invalidates it. The same stat(2) fields of
+ * SUBUID_PATH and SUBGID_PATH (for the requested modes) are part of the
+ * key as well, so a range removed by an admin or another tool turns the
+ * stamp stale instead of being vouched for; any other write to those
+ * files merely costs one more full run. STAMP_DIR lives on /run and is
+ * therefore cleared at boot.
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Stamp format version, bumped whenever the line layout changes */
+#define STAMP_VERSION "v2"
+
+/* Longest stamp line: version, fingerprint, modes, username, two ranges */
+enum { STAMP_MAX_LEN = 512 };
+
+/* Bits recorded for the requested modes */
+enum { STAMP_MODE_SUBUID = 1U << 0, STAMP_MODE_SUBGID = 1U << 1 };
+
+/*
+ * Forward declarations for internal functions
+ *
+ * We can use nonnull on static functions because they can only be called
+ * from inside here and we're careful to check the pointers in our visible
+ * function(s).
+ */
+static int hash_source(const struct syscall_ops *ops, const char *path,
+                       uint64_t *hash) __attribute__((nonnull(1, 2, 3)))
+__attribute__((warn_unused_result));
+static int hash_databases(const struct syscall_ops *ops,
+                          const options_t *opts, uint64_t *hash)
+    __attribute__((nonnull(1, 2, 3))) __attribute__((warn_unused_result));
+static int stamp_path(char *out, size_t size, const char *dir, uint32_t uid,
+                      bool tmp) __attribute__((nonnull(1, 3)))
+__attribute__((warn_unused_result));
+static int format_stamp(char *out, size_t size, uint64_t fingerprint,
+                        uint64_t databases, const char *username,
+                        const options_t *opts, const char *subuid,
+                        const char *subgid)
+    __attribute__((nonnull(1, 5, 6, 7, 8))) __attribute__((warn_unused_result));
+static void format_mode_range(char *out, size_t size, uint32_t uid,
+                              const config_t *config,
+                              const subid_config_t *subid_cfg, bool requested)
+    __attribute__((nonnull(1, 4, 5)));
+
+/**
+ * hash_source - Mix one configuration source into a fingerprint
+ * @ops: Operations structure for system call abstraction
+ * @path: File or directory
+ * @hash: Running FNV-1a hash, updated
+ *
+ * A missing source hashes differently from any existing one, so creating
+ * it later changes the fingerprint.
+ *
+ * Return: 0 on success, -1 if @path cannot be examined
+ */
+static int hash_source(const struct syscall_ops *ops, const char *path,
+                       uint64_t *hash) {
+  *hash = hash_fnv1a(path, strlen(path) + 1, *hash);
+
+  struct stat st = {0};
+  if (ops->stat(path, &st) != 0) {
+    if (errno == ENOENT) {
+      *hash = hash_fnv1a("-", 1, *hash);
+      return 0;
+    }
+    return -1;
+  }
+
+  const uint64_t fields[] = {
+      (uint64_t)st.st_dev,           (uint64_t)st.st_ino,
+      (uint64_t)st.st_size,          (uint64_t)st.st_mtim.tv_sec,
+      (uint64_t)st.st_mtim.tv_nsec,  (uint64_t)st.st_ctim.tv_sec,
+      (uint64_t)st.st_ctim.tv_nsec,
+  };
+  *hash = hash_fnv1a(fields, sizeof(fields), *hash);
+  return 0;
+}
+
+/**
+ * stamp_fingerprint - Fingerprint every configuration source
+ * @ops: Operations structure for system call abstraction
+ * @fingerprint: Set to the fingerprint on success
+ * @debug: Enable debug output
+ *
+ * Only stat(2) and one scandir(3) are used, so this is far cheaper than
+ * load_configuration(). The program version is mixed in as well, so an
+ * upgrade with different defaults also invalidates every stamp.
+ *
+ * Return: 0 on success, -1 on error (the cache is then not used)
+ */
+int stamp_fingerprint(const struct syscall_ops *ops, uint64_t *fingerprint,
+                      bool debug) {
+  if (ops == NULL || fingerprint == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: NULL parameter in stamp_fingerprint\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  uint64_t hash = hash_fnv1a(VERSION, strlen(VERSION), FNV1A_64_INIT);
+  const char *const sources[] = {LOGIN_DEFS_PATH, CONFIG_FILE_PATH,
+                                 CONFIG_DROPIN_DIR_PATH};
+  for (size_t i = 0; i < sizeof(sources) / sizeof(sources[0]); i++) {
+    if (hash_source(ops, sources[i], &hash) != 0) {
+      if (debug) {
+        (void)fprintf(stderr, "%s: debug: cannot stat %s: %s\n", PROJECT_NAME,
+                      sources[i], strerror(errno));
+      }
+      return -1;
+    }
+  }
+
+  struct dirent **namelist = NULL;
+  int n = ops->scandir(CONFIG_DROPIN_DIR_PATH, &namelist, filter_conf_files,
+                       alphasort);
+  if (n < 0) {
+    if (errno == ENOENT) {
+      *fingerprint = hash;
+      return 0;
+    }
+    if (debug) {
+      (void)fprintf(stderr, "%s: debug: cannot scan %s: %s\n", PROJECT_NAME,
+                    CONFIG_DROPIN_DIR_PATH, strerror(errno));
+    }
+    return -1;
+  }
+
+  int ret = 0;
+  for (int i = 0; i < n; i++) {
+    char path[PATH_MAX] = {0};
+    int len = snprintf(path, sizeof(path), "%s/%s", CONFIG_DROPIN_DIR_PATH,
+                       namelist[i]->d_name);
+    if (ret == 0 &&
+        (len < 0 || (size_t)len >= sizeof(path) ||
+         hash_source(ops, path, &hash) != 0)) {
+      ret = -1;
+    }
+    ops->free(namelist[i]);
+  }
+  ops->free(namelist);
+
+  if (ret == 0) {
+    *fingerprint = hash;
+  }
+  return ret;
+}
+
+/**
+ * hash_databases - Fingerprint the databases of the requested modes
+ * @ops: Operations structure for system call abstraction
+ * @opts: Runtime options (requested modes)
+ * @hash: Set to the fingerprint on success
+ *
+ * Return: 0 on success, -1 if a database cannot be examined
+ */
+static int hash_databases(const struct syscall_ops *ops,
+                          const options_t *opts, uint64_t *hash) {
+  uint64_t databases = FNV1A_64_INIT;
+  if ((opts->do_subuid && hash_source(ops, SUBUID_PATH, &databases) != 0) ||
+      (opts->do_subgid && hash_source(ops, SUBGID_PATH, &databases) != 0)) {
+    if (opts->debug) {
+      (void)fprintf(stderr, "%s: debug: cannot stat the databases: %s\n",
+                    PROJECT_NAME, strerror(errno));
+    }
+    return -1;
+  }
+  *hash = databases;
+  return 0;
+}
+
+/**
+ * stamp_path - Build the stamp path for a UID
+ * @out: Output buffer
+ * @size: Size of @out
+ * @dir: Stamp directory
+ * @uid: UID
+ * @tmp: Build this process's temporary name used while writing instead
+ *
+ * Return: 0 on success, -1 if the path does not fit
+ */
+static int stamp_path(char *out, size_t size, const char *dir, uint32_t uid,
+                      bool tmp) {
+  int len = tmp ? snprintf(out, size, "%s/.%u.%ld.tmp", dir, uid,
+                           (long)getpid())
+                : snprintf(out, size, "%s/%u", dir, uid);
+  if (len < 0 || (size_t)len >= size) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * format_stamp - Format a stamp line
+ * @out: Output buffer
+ * @size: Size of @out
+ * @fingerprint: Configuration fingerprint
+ * @databases: Fingerprint from hash_databases()
+ * @username: Username the UID resolved to
+ * @opts: Runtime options (requested modes)
+ * @subuid: Recorded subuid range ("start:count" or "-")
+ * @subgid: Recorded subgid range ("start:count" or "-")
+ *
+ * Everything before the ranges decides whether a stamp is current; the
+ * ranges are informational for whoever reads STAMP_DIR.
+ *
+ * Return: Length of the key prefix on success, -1 if it does not fit
+ */
+static int format_stamp(char *out, size_t size, uint64_t fingerprint,
+                        uint64_t databases, const char *username,
+                        const options_t *opts, const char *subuid,
+                        const char *subgid) {
+  unsigned int modes = (opts->do_subuid ? STAMP_MODE_SUBUID : 0U) |
+                       (opts->do_subgid ? STAMP_MODE_SUBGID : 0U);
+
+  int key_len = snprintf(out, size, "%s %016" PRIx64 " %016" PRIx64 " %u %s ",
+                         STAMP_VERSION, fingerprint, databases, modes,
+                         username);
+  if (key_len < 0 || (size_t)key_len >= size) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  int len = snprintf(out + key_len, size - (size_t)key_len, "%s %s\n", subuid,
+                     subgid);
+  if (len < 0 || (size_t)len >= size - (size_t)key_len) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  return key_len;
+}
+
+/**
+ * stamp_check - Look for a current stamp
+ * @ops: Operations structure for system call abstraction
+ * @dir: Stamp directory (STAMP_DIR)
+ * @uid: UID being processed
+ * @username: Username @uid resolved to
+ * @opts: Runtime options
+ * @fingerprint: Fingerprint from stamp_fingerprint()
+ *
+ * Stamps must be regular files owned by the effective user and writable
+ * only by it; anything else is ignored so an unexpected writer cannot make
+ * this tool skip a user. A stamp is only current while the databases are
+ * still the files it was written after.
+ *
+ * Return: 1 if a current stamp exists, 0 otherwise (including errors)
+ */
+int stamp_check(const struct syscall_ops *ops, const char *dir, uint32_t uid,
+                const char *username, const options_t *opts,
+                uint64_t fingerprint) {
+  if (ops == NULL || dir == NULL || username == NULL || opts == NULL) {
+    return 0;
+  }
+
+  uint64_t databases = 0;
+  if (hash_databases(ops, opts, &databases) != 0) {
+    return 0;
+  }
+
+  char path[PATH_MAX] = {0};
+  char want[STAMP_MAX_LEN] = {0};
+  int key_len = format_stamp(want, sizeof(want), fingerprint, databases,
+                             username, opts, "", "");
+  if (stamp_path(path, sizeof(path), dir, uid, false) != 0 || key_len < 0) {
+    return 0;
+  }
+
+  int fd = ops->open(path, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+  if (fd < 0) {
+    if (opts->debug) {
+      (void)fprintf(stderr, "%s: debug: no stamp %s: %s\n", PROJECT_NAME, path,
+                    strerror(errno));
+    }
+    return 0;
+  }
+
+  struct stat st = {0};
+  char have[STAMP_MAX_LEN] = {0};
+  ssize_t len = -1;
+  if (ops->fstat(fd, &st) == 0 && S_ISREG(st.st_mode) &&
+      st.st_uid == geteuid() && (st.st_mode & (S_IWGRP | S_IWOTH)) == 0) {
+    len = ops->read(fd, have, sizeof(have) - 1);
+  } else if (opts->debug) {
+    (void)fprintf(stderr, "%s: debug: ignoring untrusted stamp %s\n",
+                  PROJECT_NAME, path);
+  }
+  (void)ops->close(fd);
+
+  if (len < key_len || strncmp(have, want, (size_t)key_len) != 0) {
+    if (opts->debug && len >= 0) {
+      (void)fprintf(stderr, "%s: debug: stamp %s is out of date\n",
+                    PROJECT_NAME, path);
+    }
+    return 0;
+  }
+
+  if (opts->debug) {
+    (void)fprintf(stderr, "%s: debug: stamp %s is current\n", PROJECT_NAME,
+                  path);
+  }
+  return 1;
+}
+
+/**
+ * format_mode_range - Format the range recorded for one mode
+ * @out: Output buffer
+ * @size: Size of @out
+ * @uid: UID
+ * @config: Loaded configuration
+ * @subid_cfg: Subordinate ID configuration for the mode
+ * @requested: Whether the mode was requested
+ */
+static void format_mode_range(char *out, size_t size, uint32_t uid,
+                              const config_t *config,
+                              const subid_config_t *subid_cfg, bool requested) {
+  uint32_t start = 0;
+  if (!requested || calc_subid_range(uid, config->uid_min, subid_cfg,
+                                     config->allow_subid_wrap, &start) != 0) {
+    (void)snprintf(out, size, "-");
+    return;
+  }
+  (void)snprintf(out, size, "%u:%u", start, calc_subid_count(uid, subid_cfg));
+}
+
+/**
+ * stamp_write - Record that @uid is done for the current configuration
+ * @ops: Operations structure for system call abstraction
+ * @dir: Stamp directory (STAMP_DIR), created if missing
+ * @uid: UID that was processed successfully
+ * @username: Username @uid resolved to
+ * @config: Configuration the run used
+ * @opts: Runtime options
+ * @fingerprint: Fingerprint taken before @config was loaded
+ *
+ * The stamp is written to a temporary name of this process's own and
+ * renamed into place, so a concurrent reader never sees a partial line
+ * and concurrent writers for the same UID never share a file. Using the
+ * fingerprint from before the load means a config change that raced this
+ * run leaves a stale stamp, which only costs one more full run. The
+ * databases are examined here, after this run wrote them, so call this
+ * only once the ranges are in place.
+ *
+ * Return: 0 on success, -1 on error
+ */
+int stamp_write(const struct syscall_ops *ops, const char *dir, uint32_t uid,
+                const char *username, const config_t *config,
+                const options_t *opts, uint64_t fingerprint) {
+  if (ops == NULL || dir == NULL || username == NULL || config == NULL ||
+      opts == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: NULL parameter in stamp_write\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  char subuid[RANGE_STR_MAX] = {0};
+  char subgid[RANGE_STR_MAX] = {0};
+  format_mode_range(subuid, sizeof(subuid), uid, config, &config->subuid,
+                    opts->do_subuid);
+  format_mode_range(subgid, sizeof(subgid), uid, config, &config->subgid,
+                    opts->do_subgid);
+
+  uint64_t databases = 0;
+  if (hash_databases(ops, opts, &databases) != 0) {
+    int saved_errno = errno;
+    (void)fprintf(stderr, "%s: error: cannot examine the databases: %s\n",
+                  PROJECT_NAME, strerror(saved_errno));
+    errno = saved_errno;
+    return -1;
+  }
+
+  char line[STAMP_MAX_LEN] = {0};
+  char path[PATH_MAX] = {0};
+  char tmppath[PATH_MAX] = {0};
+  if (format_stamp(line, sizeof(line), fingerprint, databases, username, opts,
+                   subuid, subgid) < 0 ||
+      stamp_path(path, sizeof(path), dir, uid, false) != 0 ||
+      stamp_path(tmppath, sizeof(tmppath), dir, uid, true) != 0) {
+    (void)fprintf(stderr, "%s: error: stamp for UID %u too long\n",
+                  PROJECT_NAME, uid);
+    return -1;
+  }
+
+  if (ops->mkdir(dir, 0755) != 0 && errno != EEXIST) {
+    int saved_errno = errno;
+    (void)fprintf(stderr, "%s: error: cannot create %s: %s\n", PROJECT_NAME,
+                  dir, strerror(saved_errno));
+    errno = saved_errno;
+    return -1;
+  }
+
+  int flags = O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC | O_NOFOLLOW;
+  int fd = ops->open(tmppath, flags, 0644);
+  if (fd < 0 && errno == EEXIST) {
+    /* Left behind by a crashed run whose PID we now have */
+    (void)ops->unlink(tmppath);
+    fd = ops->open(tmppath, flags, 0644);
+  }
+  if (fd < 0) {
+    int saved_errno = errno;
+    (void)fprintf(stderr, "%s: error: cannot create %s: %s\n", PROJECT_NAME,
+                  tmppath, strerror(saved_errno));
+    errno = saved_errno;
+    return -1;
+  }
+
+  size_t len = strlen(line);
+  ssize_t written = ops->write(fd, line, len);
+  if (written >= 0 && (size_t)written == len && ops->fsync(fd) != 0) {
+    written = -1;
+  }
+  int saved_errno = errno;
+  int close_ret = ops->close(fd);
+  if (written < 0 || (size_t)written != len || close_ret != 0 ||
+      ops->rename(tmppath, path) != 0) {
+    if (written >= 0 && close_ret == 0) {
+      saved_errno = errno;
+    }
+    (void)ops->unlink(tmppath);
+    (void)fprintf(stderr, "%s: error: cannot write %s: %s\n", PROJECT_NAME,
+                  path, strerror(saved_errno));
+    errno = saved_errno;
+    return -1;
+  }
+
+  if (opts->debug) {
+    (void)fprintf(stderr, "%s: debug: wrote stamp %s\n", PROJECT_NAME, path);
+  }
+  return 0;
+}
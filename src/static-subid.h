@@ -37,6 +37,9 @@ _Static_assert(ULLONG_MAX >= 4294967295U,
 /* Maximum config line length - prevents DoS via large lines */
 #define MAX_LINE_LEN 1024
 
+/* FNV-1a 64-bit offset basis, the starting value for hash_fnv1a() */
+#define FNV1A_64_INIT UINT64_C(0xcbf29ce484222325)
+
 /* Compile-time validation of configuration */
 _Static_assert(MAX_RANGES > 0, "MAX_RANGES must be positive");
 _Static_assert(MAX_RANGES <= (UINT32_C(1) << 26),
@@ -49,26 +52,109 @@ _Static_assert(MAX_RANGES <= (UINT32_C(1) << 26),
  */
 typedef enum { SUBUID, SUBGID } subid_mode_t;
 
+/* Number of subid_mode_t values, for arrays indexed by mode */
+enum { SUBID_MODES = 2 };
+
+/* Most UID bands one SUB_UID_BANDS/SUB_GID_BANDS value can list */
+enum { SUBID_BANDS_MAX = 16 };
+
+/* Segments the bands split the UIDs into: each band, a gap before each
+ * band and the UIDs after the last one */
+enum { SUBID_SEGMENTS_MAX = (2 * SUBID_BANDS_MAX) + 1 };
+
+/**
+ * struct subid_band_t - UIDs given their own count per user
+ * @uid_lo: First UID of the band
+ * @uid_hi: Last UID of the band
+ * @count: Number of subordinate IDs per user in the band
+ */
+typedef struct {
+  uint32_t uid_lo;
+  uint32_t uid_hi;
+  uint32_t count;
+} subid_band_t;
+
+/**
+ * struct subid_segment_t - A run of UIDs sharing one count per user
+ * @uid_lo: First UID of the segment, the next segment starts past its last
+ * @count: Number of subordinate IDs per user
+ * @offset: Where the range of @uid_lo starts, relative to min_val, before
+ *          wrapping: the sum of all ranges of the segments before it
+ */
+typedef struct {
+  uint32_t uid_lo;
+  uint32_t count;
+  uint64_t offset;
+} subid_segment_t;
+
 /**
  * struct subid_config_t - Configuration for one type of subordinate ID
  * @type: What sort of subid does this cover
  * @key_min: Configuration key name for minimum value
  * @key_max: Configuration key name for maximum value
  * @key_count: Configuration key name for count per user
+ * @key_bands: Configuration key name for @bands
  * @min_val: Minimum subordinate ID value from configuration
  * @max_val: Maximum subordinate ID value from configuration
  * @count_val: Number of subordinate IDs per user from configuration
+ * @bands: UID bands with a count of their own, sorted by UID
+ * @band_count: Entries in @bands
+ * @segments: Prefix-sum table built from @bands by subid_segments_build(),
+ *            sorted by both UID and offset
+ * @segment_count: Entries in @segments, 0 when every UID gets @count_val
+ *
+ * UIDs outside every band keep @count_val. Ranges are laid out in UID
+ * order, so without bands @segments is not needed at all and the ranges
+ * are those of the plain (uid - uid_min) * count_val formula.
  */
 typedef struct {
   const char *key_min;   /* Is a string literal, never freed */
   const char *key_max;   /* Is a string literal, never freed */
   const char *key_count; /* Is a string literal, never freed */
+  const char *key_bands; /* Is a string literal, never freed */
   subid_mode_t type;     /* Is our mode enum */
   uint32_t min_val;
   uint32_t max_val;
   uint32_t count_val;
+  subid_band_t bands[SUBID_BANDS_MAX];
+  size_t band_count;
+  subid_segment_t segments[SUBID_SEGMENTS_MAX];
+  size_t segment_count;
 } subid_config_t;
 
+/**
+ * enum subid_backend_t - How existing subordinate ID assignments are checked
+ * @SUBID_BACKEND_GETSUBIDS: Spawn getsubids(1) (sees NSS subid providers)
+ * @SUBID_BACKEND_FILES: Read SUBUID_PATH/SUBGID_PATH in-process
+ */
+typedef enum {
+  SUBID_BACKEND_GETSUBIDS,
+  SUBID_BACKEND_FILES
+} subid_backend_t;
+
+/**
+ * enum subid_writer_t - How new subordinate ID ranges are recorded
+ * @SUBID_WRITER_USERMOD: Spawn usermod(8) once per range
+ * @SUBID_WRITER_FILES: Rewrite SUBUID_PATH/SUBGID_PATH in-process
+ * @SUBID_WRITER_SPOOL: As @SUBID_WRITER_FILES, with concurrent runs sharing
+ *                      one rewrite through the spool in STAMP_DIR
+ */
+typedef enum {
+  SUBID_WRITER_USERMOD,
+  SUBID_WRITER_FILES,
+  SUBID_WRITER_SPOOL
+} subid_writer_t;
+
+/**
+ * struct subid_range_t - One subordinate ID range as stored in subuid(5)
+ * @start: First subordinate ID
+ * @count: Number of subordinate IDs
+ */
+typedef struct {
+  uint32_t start;
+  uint32_t count;
+} subid_range_t;
+
 /**
  * struct config_t - Complete configuration parameters
  * @key_uid_min: Key for @uid_min
@@ -81,6 +167,15 @@ typedef struct {
  * @key_allow_subid_wrap: key for @allow_subid_wrap
  * @skip_if_exists: Skip assignment if user already has subordinate IDs
  * @allow_subid_wrap: Allow overlap in range calculation for large UIDs
+ * @key_subid_backend: key for @subid_backend
+ * @subid_backend: How existing assignments are checked for SKIP_IF_EXISTS
+ * @key_subid_writer: key for @subid_writer
+ * @subid_writer: How new ranges are recorded
+ * @key_skip_if_exact: key for @skip_if_exact
+ * @skip_if_exact: Compare existing ranges with the calculated one in-process
+ *                 (skip on an exact match, fail on any other range)
+ * @key_resolve_timeout_ms: key for @resolve_timeout_ms
+ * @resolve_timeout_ms: Deadline for each passwd lookup, 0 for none
  */
 typedef struct {
   const char *key_uid_min; /* Is a string literal, never freed */
@@ -93,8 +188,80 @@ typedef struct {
   const char *key_allow_subid_wrap; /* Is a string literal, never freed */
   bool skip_if_exists;
   bool allow_subid_wrap;
+  const char *key_subid_backend; /* Is a string literal, never freed */
+  subid_backend_t subid_backend;
+  const char *key_subid_writer; /* Is a string literal, never freed */
+  subid_writer_t subid_writer;
+  const char *key_skip_if_exact; /* Is a string literal, never freed */
+  bool skip_if_exact;
+  const char *key_resolve_timeout_ms; /* Is a string literal, never freed */
+  uint32_t resolve_timeout_ms;
 } config_t;
 
+/**
+ * struct subid_entry_t - A pending subuid(5)/subgid(5) line
+ * @owner: Username the range is assigned to (owned, freed by the txn)
+ * @start: First subordinate ID
+ * @count: Number of subordinate IDs
+ */
+typedef struct {
+  char *owner;
+  uint32_t start;
+  uint32_t count;
+} subid_entry_t;
+
+/**
+ * struct subid_entry_list_t - Growable array of pending entries
+ * @entries: Entry storage
+ * @len: Entries in use
+ * @cap: Entries allocated
+ */
+typedef struct {
+  subid_entry_t *entries;
+  size_t len;
+  size_t cap;
+} subid_entry_list_t;
+
+/**
+ * struct subid_txn_t - Ranges waiting to be written by the native writer
+ * @subuid: Entries for SUBUID_PATH
+ * @subgid: Entries for SUBGID_PATH
+ * @users: Number of users with at least one queued entry
+ *
+ * Lets batch mode record every user's ranges with one locked rewrite of
+ * each database instead of one rewrite per range. Zero-initialize before
+ * use and release with subid_txn_free().
+ */
+typedef struct {
+  subid_entry_list_t subuid;
+  subid_entry_list_t subgid;
+  size_t users;
+} subid_txn_t;
+
+/**
+ * struct subid_index_t - A subuid/subgid index mapped for lookups
+ * @map: Read-only mapping of the whole index file
+ * @size: Size of @map in bytes
+ *
+ * Filled by subid_index_open() and released with subid_index_close().
+ */
+typedef struct {
+  void *map;
+  size_t size;
+} subid_index_t;
+
+/**
+ * struct passwd_buf_t - Reusable getpw*_r(3) buffer for passwd_lookup()
+ * @buf: Buffer, NULL until the first lookup
+ * @size: Size of @buf
+ *
+ * Zero-initialize before use and release with passwd_buf_free().
+ */
+typedef struct {
+  char *buf;
+  size_t size;
+} passwd_buf_t;
+
 /**
  * struct options_t - Command-line options and runtime state
  * @do_subuid: Assign subordinate UIDs if true
@@ -103,9 +270,29 @@ typedef struct {
  * @noop: Show actions without executing them
  * @help: Display help and exit
  * @dump_config: Dump configuration after help (only valid with --help)
+ * @batch: Process many users in one invocation with a per-user summary
+ * @null_sep: Batch input entries are NUL-separated rather than one per line
+ * @batch_file: Batch input file ("-" for stdin), or NULL
+ * @all_eligible: Batch over every passwd account inside [UID_MIN, UID_MAX]
+ * @stamp_cache: Skip the run when STAMP_DIR/<uid> is current, write it after
+ * @check_only: Only report whether the user needs work, never assign
+ * @condition: With @check_only, use systemd ExecCondition= exit codes
+ * @daemon: Serve requests on DAEMON_SOCKET_PATH instead of a single user
+ * @request: Ask the daemon to ensure the caller's own ranges
+ * @audit: Check the subordinate ID databases instead of assigning ranges
+ * @owner_of: Subordinate ID to find the owner of ("-" for stdin), or NULL
+ * @export_path: Write the full subuid/subgid table here ("-" for stdout)
+ * @jobs: Batch entries resolved in parallel (1 resolves them in turn)
+ * @stats: STATS_FORMAT_* bits to report run statistics in, 0 for none
+ * @verify: Check subid dumps of many hosts (paths in @user_args)
+ * @wait: Block until the user's ranges are in place, assign nothing
+ * @timeout: Seconds --request and --wait block at most
  * @user_arg: User argument from command line (username or UID string)
+ * @user_args: All positional arguments (batch mode entries)
+ * @user_argc: Number of entries in @user_args
  *
- * The @user_arg pointer references argv memory and must not be freed.
+ * The @user_arg, @user_args, @batch_file, @owner_of and @export_path
+ * pointers reference argv memory and must not be freed.
  */
 typedef struct {
   bool do_subuid;
@@ -114,13 +301,224 @@ typedef struct {
   bool noop;
   bool help;
   bool dump_config;
-  const char *user_arg; /* Points into argv, never freed */
+  bool batch;
+  bool null_sep;
+  const char *batch_file;  /* Points into argv, never freed */
+  bool all_eligible;
+  bool stamp_cache;
+  bool check_only;
+  bool condition;
+  bool daemon;
+  bool request;
+  bool audit;
+  const char *owner_of;    /* Points into argv, never freed */
+  const char *export_path; /* Points into argv, never freed */
+  unsigned int jobs;
+  unsigned int stats;
+  bool verify;
+  bool wait;
+  unsigned int timeout;
+  const char *user_arg;    /* Points into argv, never freed */
+  char *const *user_args;  /* Points into argv, never freed */
+  int user_argc;
 } options_t;
 
+/* Watch slots: login.defs, main config, drop-in parent, drop-in directory */
+enum { CONFIG_WATCH_MAX = 4 };
+
+/**
+ * struct config_watch_t - inotify watches on the configuration sources
+ * @fd: inotify descriptor, -1 when closed
+ * @wd: Watch descriptor per slot, -1 if not watched
+ * @name: Entry name an event in the slot must carry, NULL for any
+ * @dropin_dir: Drop-in directory path, re-watched when it reappears
+ *
+ * The @name and @dropin_dir pointers reference the paths given to
+ * config_watch_open() and must not be freed.
+ */
+typedef struct {
+  int fd;
+  int wd[CONFIG_WATCH_MAX];
+  const char *name[CONFIG_WATCH_MAX]; /* Points into caller paths */
+  const char *dropin_dir;             /* Points into caller paths */
+} config_watch_t;
+
+/**
+ * struct batch_stats_t - Per-invocation batch mode summary
+ * @total: Number of entries processed
+ * @ok: Number of entries that completed successfully
+ * @failed: Number of entries that failed
+ */
+typedef struct {
+  size_t total;
+  size_t ok;
+  size_t failed;
+} batch_stats_t;
+
+/* Upper bound for --jobs; NSS backends gain nothing from more */
+enum { RESOLVE_JOBS_MAX = 64 };
+
+/* passwd_lookup() helper threads alive at once, stuck ones included */
+enum { PASSWD_HELPERS_MAX = 2 * RESOLVE_JOBS_MAX };
+
+/* Batch entries resolved ahead of the writer per job */
+enum { RESOLVE_WINDOW_PER_JOB = 16 };
+
+/* How long --request and --wait block without --timeout, in seconds */
+enum { WAIT_TIMEOUT_DEFAULT_SEC = 60 };
+
+/**
+ * struct resolve_slot_t - One batch entry handed to resolve_pool_run()
+ * @entry: Username or UID string as given by the user
+ * @username: Buffer the resolved username is written to
+ * @uid: Resolved UID
+ * @error: 0 once resolved, else the errno resolve_user() would have set
+ *
+ * @entry and @username are owned by the caller and must stay valid until
+ * resolve_pool_run() returns.
+ */
+typedef struct {
+  const char *entry;
+  char *username;
+  uint32_t uid;
+  int error;
+} resolve_slot_t;
+
+/**
+ * struct spawn_ctx_t - Prepared state for spawning helpers
+ * @envp: Sanitized environment, pointing into environ
+ * @quiet: stdin, stdout and stderr on /dev/null (getsubids(1))
+ * @stdin_only: Only stdin on /dev/null (usermod(8), getsubids(1) in debug)
+ * @attr: Spawn attributes (POSIX_SPAWN_USEVFORK where available)
+ * @have_quiet: @quiet is prepared
+ * @have_stdin_only: @stdin_only is prepared
+ * @have_attr: @attr is prepared, else helpers get the defaults
+ *
+ * Built by spawn_ctx_init(), which leaves the file actions to be prepared
+ * on first use, and reused for every helper so a batch does not rebuild
+ * them and the environment thousands of times.
+ */
+typedef struct {
+  char **envp;
+  posix_spawn_file_actions_t quiet;
+  posix_spawn_file_actions_t stdin_only;
+  posix_spawnattr_t attr;
+  bool have_quiet;
+  bool have_stdin_only;
+  bool have_attr;
+} spawn_ctx_t;
+
+/**
+ * struct arena_t - Bump allocator for memory that lives one request
+ * @chunks: Every chunk, oldest first
+ * @current: Chunk being bumped through
+ * @chunk_size: Usable size of a regular chunk
+ * @base_calloc: Allocator the chunks come from
+ * @base_free: Releases chunks from @base_calloc
+ * @outer: Arena that was active on this thread before arena_begin()
+ * @registered_next: Next arena on arena.c's process-wide registry
+ * @registered: Whether the arena is on that registry
+ *
+ * Between arena_begin() and arena_end() the scoped operations allocate
+ * from the arena and their free() is a no-op for its memory; arena_end()
+ * rewinds all of it at once and keeps the chunks for the next request.
+ * Set up with arena_init() and release with arena_destroy().
+ */
+typedef struct arena {
+  struct arena_chunk *chunks;
+  struct arena_chunk *current;
+  size_t chunk_size;
+  void *(*base_calloc)(size_t nmemb, size_t size);
+  void (*base_free)(void *ptr);
+  struct arena *outer;
+  struct arena *registered_next;
+  bool registered;
+} arena_t;
+
+/**
+ * enum stats_phase_t - Phases timed for --stats
+ * @STATS_CONFIG: Loading the configuration (or its snapshot)
+ * @STATS_RESOLVE: Resolving users through NSS
+ * @STATS_CHECK: Looking for ranges that are already assigned
+ * @STATS_WRITE: Writing new ranges (usermod(8) or the native writer)
+ * @STATS_LOCK: Waiting for lckpwdf(3) and the database locks, within
+ *              @STATS_WRITE
+ * @STATS_TOTAL: The whole run, or the whole daemon request
+ * @STATS_PHASES: Number of phases
+ */
+typedef enum {
+  STATS_CONFIG,
+  STATS_RESOLVE,
+  STATS_CHECK,
+  STATS_WRITE,
+  STATS_LOCK,
+  STATS_TOTAL,
+  STATS_PHASES
+} stats_phase_t;
+
+/**
+ * enum stats_counter_t - Work counted for --stats
+ * @STATS_SPAWNS: Helpers started (getsubids(1), usermod(8))
+ * @STATS_FILES: Configuration files parsed
+ * @STATS_LINES: Configuration lines parsed
+ * @STATS_BYTES: Configuration bytes read
+ * @STATS_COUNTERS: Number of counters
+ */
+typedef enum {
+  STATS_SPAWNS,
+  STATS_FILES,
+  STATS_LINES,
+  STATS_BYTES,
+  STATS_COUNTERS
+} stats_counter_t;
+
+/* Report formats selected by --stats, as bits */
+enum { STATS_FORMAT_JSON = 1U << 0, STATS_FORMAT_JOURNAL = 1U << 1 };
+
+/**
+ * struct stats_t - Snapshot of the --stats totals
+ * @usec: Microseconds spent per stats_phase_t
+ * @count: Value per stats_counter_t
+ */
+typedef struct {
+  uint64_t usec[STATS_PHASES];
+  uint64_t count[STATS_COUNTERS];
+} stats_t;
+
 /*
  * Function declarations
  */
 
+/* arena.c */
+void arena_init(arena_t *arena, const struct syscall_ops *ops,
+                size_t chunk_size);
+void arena_begin(arena_t *arena, const struct syscall_ops *ops,
+                 struct syscall_ops *scoped);
+void arena_end(arena_t *arena);
+void arena_destroy(arena_t *arena);
+arena_t *arena_suspend(void) __attribute__((warn_unused_result));
+void arena_resume(arena_t *arena);
+
+/* audit.c */
+int audit_run(const struct syscall_ops *ops, const config_t *config,
+              const options_t *opts, FILE *out, size_t *findings)
+    __attribute__((warn_unused_result));
+
+/* batch.c */
+char *batch_read_entry(FILE *fp, int delim, char **line, size_t *cap)
+    __attribute__((warn_unused_result));
+int batch_run_args(const struct syscall_ops *ops, const config_t *config,
+                   const options_t *opts, batch_stats_t *stats)
+    __attribute__((warn_unused_result));
+int batch_run_stream(const struct syscall_ops *ops, const config_t *config,
+                     const options_t *opts, FILE *fp, batch_stats_t *stats)
+    __attribute__((warn_unused_result));
+int batch_run_all_eligible(const struct syscall_ops *ops,
+                           const config_t *config, const options_t *opts,
+                           batch_stats_t *stats)
+    __attribute__((warn_unused_result));
+void batch_print_summary(const batch_stats_t *stats, FILE *out);
+
 /* config.c */
 void config_factory(config_t *config);
 int load_configuration(const struct syscall_ops *ops, config_t *config,
@@ -128,32 +526,240 @@ int load_configuration(const struct syscall_ops *ops, config_t *config,
 void print_configuration(const config_t *config, FILE *out, const char *prefix)
     __attribute__((cold));
 
+/* config_cache.c */
+int config_cache_load(const struct syscall_ops *ops, const char *dir,
+                      uint64_t fingerprint, config_t *config, bool debug)
+    __attribute__((warn_unused_result));
+int config_cache_store(const struct syscall_ops *ops, const char *dir,
+                       uint64_t fingerprint, const config_t *config,
+                       bool debug);
+
+/* config_watch.c */
+int config_watch_open(config_watch_t *watch, const char *login_defs,
+                      const char *config_file, const char *dropin_dir,
+                      bool debug) __attribute__((warn_unused_result));
+int config_watch_changed(config_watch_t *watch, bool debug)
+    __attribute__((warn_unused_result));
+int config_watch_fd(const config_watch_t *watch)
+    __attribute__((warn_unused_result));
+void config_watch_close(config_watch_t *watch);
+
+/* daemon.c */
+int daemon_listen(const char *path, bool *activated, bool debug)
+    __attribute__((warn_unused_result));
+int daemon_handle_client(const struct syscall_ops *ops, int fd,
+                         const config_t *config, const options_t *opts,
+                         const uint64_t *fingerprint, char *username,
+                         size_t username_size)
+    __attribute__((warn_unused_result));
+int daemon_serve(const struct syscall_ops *ops, int listen_fd,
+                 config_t *config, const options_t *opts,
+                 const uint64_t *fingerprint, int idle_timeout_ms)
+    __attribute__((warn_unused_result));
+int daemon_request(const char *path, unsigned int timeout_sec, bool debug)
+    __attribute__((warn_unused_result));
+
+/* enroll.c */
+int enroll_user(const struct syscall_ops *ops, const char *username,
+                uint32_t uid, const config_t *config, const options_t *opts)
+    __attribute__((warn_unused_result));
+int enroll_user_check(const struct syscall_ops *ops, const char *username,
+                      uint32_t uid, const config_t *config,
+                      const options_t *opts)
+    __attribute__((warn_unused_result));
+int enroll_user_deferred(const struct syscall_ops *ops, const char *username,
+                         uint32_t uid, const config_t *config,
+                         const options_t *opts, subid_txn_t *txn)
+    __attribute__((warn_unused_result));
+int enroll_user_prechecked(const struct syscall_ops *ops,
+                           const char *username, uint32_t uid,
+                           const config_t *config, const options_t *opts,
+                           const int exists[SUBID_MODES], subid_txn_t *txn)
+    __attribute__((warn_unused_result));
+int enroll_session(const struct syscall_ops *ops, const char *user,
+                   const config_t *config, const options_t *opts)
+    __attribute__((warn_unused_result));
+
+/* export.c */
+int export_run(const struct syscall_ops *ops, const config_t *config,
+               const options_t *opts, FILE *in)
+    __attribute__((warn_unused_result));
+
+/* nss_subid.c */
+int nss_subid_range(const struct syscall_ops *ops, const config_t *config,
+                    const char *owner, bool subgid, subid_range_t *range,
+                    size_t *found) __attribute__((warn_unused_result));
+int nss_subid_has_range(const struct syscall_ops *ops, const config_t *config,
+                        const char *owner, uint64_t start, uint64_t count,
+                        bool subgid, bool *result)
+    __attribute__((warn_unused_result));
+int nss_subid_owners(const struct syscall_ops *ops, const config_t *config,
+                     uint64_t id, bool subgid, uint32_t **uids,
+                     size_t *found) __attribute__((warn_unused_result));
+
+/* owner.c */
+int owner_run(const struct syscall_ops *ops, const config_t *config,
+              const options_t *opts, FILE *in, FILE *out)
+    __attribute__((warn_unused_result));
+
+/* passwd.c */
+int passwd_lookup(const struct syscall_ops *ops, const char *name,
+                  uint32_t uid, unsigned int timeout_ms,
+                  passwd_buf_t *scratch, uint32_t *uid_out,
+                  const char **name_out) __attribute__((warn_unused_result));
+void passwd_buf_free(const struct syscall_ops *ops, passwd_buf_t *scratch);
+
 /* range.c */
 int calc_subid_range(uint32_t uid, uint32_t uid_min,
                      const subid_config_t *subid_cfg, bool allow_wrap,
                      uint32_t *start_out) __attribute__((warn_unused_result));
+int calc_subid_range_batch(uint32_t uid_first, size_t n, uint32_t uid_min,
+                           const subid_config_t *subid_cfg, bool allow_wrap,
+                           uint32_t *starts)
+    __attribute__((warn_unused_result));
+int calc_subid_owner(uint32_t id, uint32_t uid_min, uint32_t uid_max,
+                     const subid_config_t *subid_cfg, bool allow_wrap,
+                     uint32_t *uids, size_t max, size_t *found)
+    __attribute__((warn_unused_result));
+uint32_t calc_subid_count(uint32_t uid, const subid_config_t *subid_cfg)
+    __attribute__((warn_unused_result));
+void subid_segments_build(subid_config_t *subid_cfg, uint32_t uid_min);
+
+/* resolve.c */
+int resolve_pool_run(const struct syscall_ops *ops, resolve_slot_t *slots,
+                     size_t count, unsigned int jobs, size_t username_size,
+                     unsigned int timeout_ms)
+    __attribute__((warn_unused_result));
+
+/* spawn.c */
+int spawn_ctx_init(const struct syscall_ops *ops, spawn_ctx_t *ctx)
+    __attribute__((warn_unused_result));
+void spawn_ctx_destroy(const struct syscall_ops *ops, spawn_ctx_t *ctx);
+int spawn_ctx_install(const struct syscall_ops *ops, bool debug);
+void spawn_ctx_uninstall(const struct syscall_ops *ops);
+spawn_ctx_t *spawn_ctx_acquire(const struct syscall_ops *ops,
+                               spawn_ctx_t *local)
+    __attribute__((warn_unused_result));
+void spawn_ctx_release(const struct syscall_ops *ops, spawn_ctx_t *ctx,
+                       spawn_ctx_t *local);
+int spawn_helper(const struct syscall_ops *ops, spawn_ctx_t *ctx,
+                 const char *path, char *const argv[], bool quiet,
+                 pid_t *pid) __attribute__((warn_unused_result));
+
+/* spool.c */
+int subid_spool_commit(const struct syscall_ops *ops, const char *dir,
+                       subid_txn_t *txn, bool debug)
+    __attribute__((warn_unused_result));
+
+/* stamp.c */
+int stamp_fingerprint(const struct syscall_ops *ops, uint64_t *fingerprint,
+                      bool debug) __attribute__((warn_unused_result));
+int stamp_check(const struct syscall_ops *ops, const char *dir, uint32_t uid,
+                const char *username, const options_t *opts,
+                uint64_t fingerprint) __attribute__((warn_unused_result));
+int stamp_write(const struct syscall_ops *ops, const char *dir, uint32_t uid,
+                const char *username, const config_t *config,
+                const options_t *opts, uint64_t fingerprint)
+    __attribute__((warn_unused_result));
+
+/* stats.c */
+uint64_t stats_now(void) __attribute__((warn_unused_result));
+void stats_phase_add(stats_phase_t phase, uint64_t start);
+void stats_count(stats_counter_t counter, uint64_t n);
+void stats_snapshot(stats_t *stats);
+void stats_reset(void);
+int stats_parse_formats(const char *arg, unsigned int *formats)
+    __attribute__((warn_unused_result));
+int stats_print_json(const stats_t *stats, const char *username, int status,
+                     FILE *fp);
+int stats_send_journal(const char *path, const stats_t *stats,
+                       const char *username, int status);
+void stats_report(unsigned int formats, const char *username, int status);
 
 /* subid.c */
 int check_subid_exists(const struct syscall_ops *ops, const char *username,
                        subid_mode_t mode, bool debug)
     __attribute__((warn_unused_result));
+void check_subid_exists_many(const struct syscall_ops *ops,
+                             const char *const *usernames, size_t count,
+                             subid_mode_t mode, unsigned int in_flight,
+                             int *results);
 int set_subid_range(const struct syscall_ops *ops, const char *username,
                     subid_mode_t mode, uint32_t start, uint32_t count,
                     bool noop, bool debug) __attribute__((warn_unused_result));
+int set_subid_ranges(const struct syscall_ops *ops, const char *username,
+                     const subid_range_t *subuid, const subid_range_t *subgid,
+                     bool noop, bool debug) __attribute__((warn_unused_result));
+
+/* subid_db.c */
+const char *subid_db_path(subid_mode_t mode)
+    __attribute__((warn_unused_result));
+FILE *subid_db_open(const struct syscall_ops *ops, const char *path,
+                    bool debug) __attribute__((warn_unused_result));
+int subid_db_parse_line(char *line, const char **owner, uint32_t *start,
+                        uint32_t *count) __attribute__((warn_unused_result));
+int subid_db_read_entry(const struct syscall_ops *ops, FILE *fp,
+                        const char *path, char *line, size_t size,
+                        const char **owner, uint32_t *start, uint32_t *count,
+                        bool debug) __attribute__((warn_unused_result));
+int subid_db_lookup(const struct syscall_ops *ops, const char *path,
+                    const char *username, uint32_t uid, subid_range_t *ranges,
+                    size_t max, size_t *found, bool debug)
+    __attribute__((warn_unused_result));
+int subid_db_check_exists(const struct syscall_ops *ops, const char *username,
+                          uint32_t uid, subid_mode_t mode, bool debug)
+    __attribute__((warn_unused_result));
+
+/* subid_index.c */
+int subid_index_open(const struct syscall_ops *ops, const char *dir,
+                     const char *db_path, subid_index_t *index, bool debug)
+    __attribute__((warn_unused_result));
+void subid_index_close(const struct syscall_ops *ops, subid_index_t *index);
+int subid_index_lookup(const subid_index_t *index, const char *username,
+                       uint32_t uid, subid_range_t *ranges, size_t max,
+                       size_t *found) __attribute__((warn_unused_result));
+int subid_index_refresh(const struct syscall_ops *ops, const char *dir,
+                        const char *db_path, bool debug);
+
+/* subid_write.c */
+int subid_db_lock(const struct syscall_ops *ops, const char *path, bool debug)
+    __attribute__((warn_unused_result));
+void subid_db_unlock(const struct syscall_ops *ops, const char *path,
+                     bool debug);
+int subid_db_rewrite(const struct syscall_ops *ops, const char *path,
+                     const subid_entry_t *entries, size_t n, bool debug)
+    __attribute__((warn_unused_result));
+int subid_txn_add(const struct syscall_ops *ops, subid_txn_t *txn,
+                  subid_mode_t mode, const char *owner, uint32_t start,
+                  uint32_t count) __attribute__((warn_unused_result));
+int subid_txn_commit(const struct syscall_ops *ops, subid_txn_t *txn,
+                     bool debug) __attribute__((warn_unused_result));
+void subid_txn_truncate(const struct syscall_ops *ops, subid_txn_t *txn,
+                        size_t subuid_len, size_t subgid_len);
+void subid_txn_free(const struct syscall_ops *ops, subid_txn_t *txn);
 
 /* util.c */
 int resolve_user(const struct syscall_ops *ops, const char *user_arg,
                  uint32_t *uid, char *username, size_t username_size,
-                 bool debug) __attribute__((warn_unused_result));
+                 unsigned int timeout_ms, bool debug)
+    __attribute__((warn_unused_result));
 int filter_conf_files(const struct dirent *entry)
     __attribute__((warn_unused_result));
+int filter_conf_name(const char *name) __attribute__((warn_unused_result));
 char *normalize_config_line(char *line) __attribute__((warn_unused_result));
+uint64_t hash_fnv1a(const void *data, size_t len, uint64_t hash)
+    __attribute__((warn_unused_result));
 
 /* validate.c */
 int validate_path(const char *path) __attribute__((warn_unused_result));
 int validate_config_dir(const struct syscall_ops *ops, const char *dirpath,
                         bool debug) __attribute__((warn_unused_result));
+int validate_config_dir_fd(const struct syscall_ops *ops, int fd,
+                           const char *dirpath)
+    __attribute__((warn_unused_result));
 int validate_username(const char *username) __attribute__((warn_unused_result));
+int validate_username_quiet(const char *username)
+    __attribute__((warn_unused_result));
 bool parse_bool(const char *str, bool default_val)
     __attribute__((warn_unused_result));
 int parse_uint32_strict(const char *str, uint32_t *result)
@@ -162,5 +768,19 @@ int validate_uid_range(uint32_t uid, const config_t *config)
     __attribute__((warn_unused_result));
 int validate_uid_subid_overlap(uint32_t uid, const subid_config_t *subid_cfg)
     __attribute__((warn_unused_result));
+int validate_subid_bands(const config_t *config,
+                         const subid_config_t *subid_cfg)
+    __attribute__((warn_unused_result));
+
+/* verify.c */
+int verify_run(const struct syscall_ops *ops, const config_t *config,
+               const options_t *opts, FILE *out, size_t *findings)
+    __attribute__((warn_unused_result));
+
+/* wait.c */
+int wait_for_ranges(const struct syscall_ops *ops, const char *username,
+                    uint32_t uid, const config_t *config,
+                    const options_t *opts, unsigned int timeout_ms)
+    __attribute__((warn_unused_result));
 
 #endif /* STATIC_SUBID_H */
@@ -0,0 +1,381 @@
+/**
+ * stats.c - Phase timings and work counters for --stats
+ *
+ * Every run keeps a process-wide set of monotonic phase timings (loading
+ * the configuration, resolving the user, checking existing ranges,
+ * writing them, waiting for locks) and counters (helpers spawned, config
+ * files and lines parsed, config bytes read). Recording is always on: a
+ * relaxed atomic add per event and a clock_gettime(2) vDSO call per
+ * phase, so --stats only decides whether the totals are reported.
+ *
+ * Reports are a single-line JSON object on stderr and/or one entry sent
+ * to journald with the native protocol, whose STATIC_SUBID_* fields can
+ * be graphed across a fleet without parsing messages. The protocol is
+ * spoken directly, as with socket activation in daemon.c, so there is no
+ * dependency on libsystemd.
+ *
+ * Phases are cumulative: a batch adds up every user and resolver threads
+ * add their lookups side by side, so phases may add up to more than
+ * STATS_TOTAL. STATS_LOCK is spent inside STATS_WRITE.
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+/* journald's native protocol socket, see systemd-journald.service(8) */
+#define JOURNAL_SOCKET_PATH "/run/systemd/journal/socket"
+
+/* Upper bound of one journal entry, every field included */
+enum { STATS_JOURNAL_MAX = 2048 };
+
+/* JSON key and journal field of each phase, indexed by stats_phase_t */
+static const struct {
+  const char *json;
+  const char *field;
+} phase_names[STATS_PHASES] = {
+    [STATS_CONFIG] = {"config_usec", "STATIC_SUBID_CONFIG_USEC"},
+    [STATS_RESOLVE] = {"resolve_usec", "STATIC_SUBID_RESOLVE_USEC"},
+    [STATS_CHECK] = {"check_usec", "STATIC_SUBID_CHECK_USEC"},
+    [STATS_WRITE] = {"write_usec", "STATIC_SUBID_WRITE_USEC"},
+    [STATS_LOCK] = {"lock_usec", "STATIC_SUBID_LOCK_USEC"},
+    [STATS_TOTAL] = {"total_usec", "STATIC_SUBID_TOTAL_USEC"},
+};
+
+/* JSON key and journal field of each counter, indexed by stats_counter_t */
+static const struct {
+  const char *json;
+  const char *field;
+} counter_names[STATS_COUNTERS] = {
+    [STATS_SPAWNS] = {"spawns", "STATIC_SUBID_SPAWNS"},
+    [STATS_FILES] = {"files_parsed", "STATIC_SUBID_FILES_PARSED"},
+    [STATS_LINES] = {"lines_parsed", "STATIC_SUBID_LINES_PARSED"},
+    [STATS_BYTES] = {"bytes_read", "STATIC_SUBID_BYTES_READ"},
+};
+
+/* Totals since the start of the process or the last stats_reset() */
+static _Atomic uint64_t phase_usec[STATS_PHASES];
+static _Atomic uint64_t counters[STATS_COUNTERS];
+
+/*
+ * Forward declarations for internal functions
+ *
+ * We can use nonnull on static functions because they can only be called
+ * from inside here and we're careful to check the pointers in our visible
+ * function(s).
+ */
+static void print_json_string(FILE *fp, const char *str)
+    __attribute__((nonnull));
+static int format_journal(char *buf, size_t size, const stats_t *stats,
+                          const char *username, int status)
+    __attribute__((nonnull(1, 3))) __attribute__((warn_unused_result));
+
+/**
+ * stats_now - Read the monotonic clock
+ *
+ * Return: Microseconds since an arbitrary point, for stats_phase_add()
+ */
+uint64_t stats_now(void) {
+  struct timespec now = {0};
+  (void)clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000U + (uint64_t)now.tv_nsec / 1000U;
+}
+
+/**
+ * stats_phase_add - Add the time since @start to a phase
+ * @phase: Phase to charge
+ * @start: stats_now() when the phase began
+ *
+ * Context: Safe from any thread.
+ */
+void stats_phase_add(stats_phase_t phase, uint64_t start) {
+  if (phase >= STATS_PHASES) {
+    return;
+  }
+
+  uint64_t now = stats_now();
+  (void)atomic_fetch_add_explicit(&phase_usec[phase],
+                                  now > start ? now - start : 0,
+                                  memory_order_relaxed);
+}
+
+/**
+ * stats_count - Add to a counter
+ * @counter: Counter to update
+ * @n: Amount to add
+ *
+ * Context: Safe from any thread.
+ */
+void stats_count(stats_counter_t counter, uint64_t n) {
+  if (counter >= STATS_COUNTERS) {
+    return;
+  }
+
+  (void)atomic_fetch_add_explicit(&counters[counter], n,
+                                  memory_order_relaxed);
+}
+
+/**
+ * stats_snapshot - Copy the current totals
+ * @stats: Set to the totals
+ */
+void stats_snapshot(stats_t *stats) {
+  if (stats == NULL) {
+    return;
+  }
+
+  for (size_t i = 0; i < STATS_PHASES; i++) {
+    stats->usec[i] = atomic_load_explicit(&phase_usec[i],
+                                          memory_order_relaxed);
+  }
+  for (size_t i = 0; i < STATS_COUNTERS; i++) {
+    stats->count[i] = atomic_load_explicit(&counters[i],
+                                           memory_order_relaxed);
+  }
+}
+
+/**
+ * stats_reset - Start counting from zero again
+ *
+ * The daemon reports every request on its own.
+ */
+void stats_reset(void) {
+  for (size_t i = 0; i < STATS_PHASES; i++) {
+    atomic_store_explicit(&phase_usec[i], 0, memory_order_relaxed);
+  }
+  for (size_t i = 0; i < STATS_COUNTERS; i++) {
+    atomic_store_explicit(&counters[i], 0, memory_order_relaxed);
+  }
+}
+
+/**
+ * stats_parse_formats - Parse the argument of --stats
+ * @arg: Comma-separated list of "json" and "journal", NULL for "json"
+ * @formats: Set to the STATS_FORMAT_* bits
+ *
+ * Return: 0 on success, -1 on an unknown or empty format (errno EINVAL)
+ */
+int stats_parse_formats(const char *arg, unsigned int *formats) {
+  if (formats == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (arg == NULL) {
+    *formats = STATS_FORMAT_JSON;
+    return 0;
+  }
+
+  unsigned int parsed = 0;
+  const char *item = arg;
+  for (;;) {
+    size_t len = strcspn(item, ",");
+    if (len == strlen("json") && strncmp(item, "json", len) == 0) {
+      parsed |= STATS_FORMAT_JSON;
+    } else if (len == strlen("journal") &&
+               strncmp(item, "journal", len) == 0) {
+      parsed |= STATS_FORMAT_JOURNAL;
+    } else {
+      errno = EINVAL;
+      return -1;
+    }
+    if (item[len] == '\0') {
+      break;
+    }
+    item += len + 1;
+  }
+
+  *formats = parsed;
+  return 0;
+}
+
+/**
+ * print_json_string - Print @str as a JSON string literal
+ * @fp: Stream to print to
+ * @str: String to quote
+ */
+static void print_json_string(FILE *fp, const char *str) {
+  (void)fputc('"', fp);
+  for (const unsigned char *p = (const unsigned char *)str; *p != '\0'; p++) {
+    if (*p == '"' || *p == '\\') {
+      (void)fprintf(fp, "\\%c", *p);
+    } else if (*p < 0x20) {
+      (void)fprintf(fp, "\\u%04x", (unsigned int)*p);
+    } else {
+      (void)fputc(*p, fp);
+    }
+  }
+  (void)fputc('"', fp);
+}
+
+/**
+ * stats_print_json - Print totals as a single-line JSON object
+ * @stats: Totals from stats_snapshot()
+ * @username: User the run was for, NULL or "" if none was resolved
+ * @status: Exit status (or request result) being reported
+ * @fp: Stream to print to
+ *
+ * Return: 0 on success, -1 on error (errno set)
+ */
+int stats_print_json(const stats_t *stats, const char *username, int status,
+                     FILE *fp) {
+  if (stats == NULL || fp == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  (void)fputc('{', fp);
+  if (username != NULL && username[0] != '\0') {
+    (void)fputs("\"user\":", fp);
+    print_json_string(fp, username);
+    (void)fputc(',', fp);
+  }
+  (void)fprintf(fp, "\"status\":%d", status);
+  for (size_t i = 0; i < STATS_PHASES; i++) {
+    (void)fprintf(fp, ",\"%s\":%" PRIu64, phase_names[i].json,
+                  stats->usec[i]);
+  }
+  for (size_t i = 0; i < STATS_COUNTERS; i++) {
+    (void)fprintf(fp, ",\"%s\":%" PRIu64, counter_names[i].json,
+                  stats->count[i]);
+  }
+  (void)fputs("}\n", fp);
+
+  return fflush(fp) == 0 ? 0 : -1;
+}
+
+/**
+ * format_journal - Build one journal entry in the native protocol
+ * @buf: Buffer for the entry
+ * @size: Size of @buf
+ * @stats: Totals from stats_snapshot()
+ * @username: User the run was for, NULL or "" if none was resolved
+ * @status: Exit status (or request result) being reported
+ *
+ * Every field is "KEY=value\n". A username holding a newline would need
+ * the protocol's binary form, so such a name is left out instead.
+ *
+ * Return: Length of the entry, -1 if it does not fit (errno EMSGSIZE)
+ */
+static int format_journal(char *buf, size_t size, const stats_t *stats,
+                          const char *username, int status) {
+  bool named = username != NULL && username[0] != '\0' &&
+               strchr(username, '\n') == NULL;
+  size_t len = 0;
+  int n = snprintf(buf, size,
+                   "MESSAGE=%s: %s%sstatus %d in %" PRIu64 " us\n"
+                   "PRIORITY=6\nSYSLOG_IDENTIFIER=%s\n"
+                   "STATIC_SUBID_STATUS=%d\n",
+                   PROJECT_NAME, named ? username : "", named ? ": " : "",
+                   status, stats->usec[STATS_TOTAL], PROJECT_NAME, status);
+  if (n >= 0) {
+    len = (size_t)n;
+  }
+  if (n >= 0 && len < size && named) {
+    n = snprintf(buf + len, size - len, "STATIC_SUBID_USER=%s\n", username);
+    len += n >= 0 ? (size_t)n : 0;
+  }
+  for (size_t i = 0; i < STATS_PHASES && n >= 0 && len < size; i++) {
+    n = snprintf(buf + len, size - len, "%s=%" PRIu64 "\n",
+                 phase_names[i].field, stats->usec[i]);
+    len += n >= 0 ? (size_t)n : 0;
+  }
+  for (size_t i = 0; i < STATS_COUNTERS && n >= 0 && len < size; i++) {
+    n = snprintf(buf + len, size - len, "%s=%" PRIu64 "\n",
+                 counter_names[i].field, stats->count[i]);
+    len += n >= 0 ? (size_t)n : 0;
+  }
+
+  if (n < 0 || len >= size) {
+    errno = EMSGSIZE;
+    return -1;
+  }
+  return (int)len;
+}
+
+/**
+ * stats_send_journal - Send totals to journald as one structured entry
+ * @path: journald socket, NULL for JOURNAL_SOCKET_PATH
+ * @stats: Totals from stats_snapshot()
+ * @username: User the run was for, NULL or "" if none was resolved
+ * @status: Exit status (or request result) being reported
+ *
+ * Return: 0 on success, -1 on error (errno set)
+ */
+int stats_send_journal(const char *path, const stats_t *stats,
+                       const char *username, int status) {
+  if (stats == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (path == NULL) {
+    path = JOURNAL_SOCKET_PATH;
+  }
+
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  (void)memcpy(addr.sun_path, path, strlen(path) + 1);
+
+  char entry[STATS_JOURNAL_MAX];
+  int len = format_journal(entry, sizeof(entry), stats, username, status);
+  if (len < 0) {
+    return -1;
+  }
+
+  int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return -1; // LCOV_EXCL_LINE
+  }
+
+  ssize_t sent = sendto(fd, entry, (size_t)len, MSG_NOSIGNAL,
+                        (const struct sockaddr *)&addr, sizeof(addr));
+  int saved_errno = errno;
+  (void)close(fd);
+  errno = saved_errno;
+  return sent == (ssize_t)len ? 0 : -1;
+}
+
+/**
+ * stats_report - Report the totals in the requested formats
+ * @formats: STATS_FORMAT_* bits, nothing is reported for 0
+ * @username: User the run was for, NULL or "" if none was resolved
+ * @status: Exit status (or request result) being reported
+ *
+ * JSON goes to stderr, next to the other diagnostics, so stdout keeps
+ * carrying only the results. A journal that cannot be reached is a
+ * warning, never a failure of the run.
+ */
+void stats_report(unsigned int formats, const char *username, int status) {
+  if (formats == 0) {
+    return;
+  }
+
+  stats_t stats = {0};
+  stats_snapshot(&stats);
+
+  if ((formats & STATS_FORMAT_JSON) != 0) {
+    (void)stats_print_json(&stats, username, status, stderr);
+  }
+  if ((formats & STATS_FORMAT_JOURNAL) != 0 &&
+      stats_send_journal(NULL, &stats, username, status) != 0) {
+    (void)fprintf(stderr, "%s: warning: cannot send stats to the journal: "
+                          "%s\n",
+                  PROJECT_NAME, strerror(errno));
+  }
+}
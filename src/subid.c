@@ -9,72 +9,36 @@
 /* clang-format on */
 
 #include <errno.h>
-#include <fcntl.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 #include <sys/wait.h>
-#include <unistd.h>
 
-/**
- * build_safe_environ - Build a sanitized environment for child processes
- *
- * Passes only variables needed for locale and timezone consistency.
- * Explicitly excludes dynamic linker variables (LD_PRELOAD, LD_LIBRARY_PATH,
- * etc.) and other environment injection vectors.
- *
- * The returned array holds pointers directly into the original environ
- * strings; the strings themselves are not copied and must not be freed.
- * Only the array itself should be freed by the caller.
- *
- * Context: Should be called immediately before posix_spawn. The returned
- * array is invalidated if environ is modified (e.g. by putenv/setenv)
- * between this call and posix_spawn.
- *
- * @ops: Operations structure; ops->calloc is used for the array allocation
- *
- * Return: heap-allocated NULL-terminated char *[] on success, NULL on error
- *         (ENOMEM). Caller must free() the array.
- */
-static char **build_safe_environ(const struct syscall_ops *ops) {
-  /* Allowlist: variables child processes legitimately need */
-  static const char *const allowed[] = {"LANG",     "LC_ALL", "LC_MESSAGES",
-                                        "LC_CTYPE", "TZ",     NULL};
+/* "usermod" + two flag/range pairs + username + NULL */
+enum { USERMOD_ARGV_MAX = 7 };
 
-  /* Count allowlisted vars present in environ */
-  size_t count = 0;
-  for (size_t i = 0; allowed[i] != NULL; i++) {
-    if (getenv(allowed[i]) != NULL)
-      count++;
-  }
-
-  char **safe = ops->calloc(count + 1, sizeof(char *));
-  if (safe == NULL)
-    return NULL;
+/* "getsubids" + optional "-g" + username + NULL */
+enum { GETSUBIDS_ARGV_MAX = 4 };
 
-  size_t idx = 0;
-  for (size_t i = 0; allowed[i] != NULL; i++) {
-    if (getenv(allowed[i]) == NULL)
-      continue;
-    /*
-     * Walk environ directly to get the "KEY=VALUE" string pointer without
-     * allocating a copy. This avoids a double-lookup and keeps the array
-     * pointing into the original environ.
-     */
-    size_t klen = strlen(allowed[i]);
-    for (char **ep = environ; *ep != NULL; ep++) {
-      if (strncmp(*ep, allowed[i], klen) == 0 && (*ep)[klen] == '=') {
-        safe[idx++] = *ep;
-        break;
-      }
-    }
-  }
-  safe[idx] = NULL;
-  return safe;
-}
+/*
+ * Forward declarations for internal functions
+ *
+ * We can use nonnull on static functions because they can only be called
+ * from inside here and we're careful to check the pointers in our visible
+ * function(s).
+ */
+static int format_range(const subid_range_t *range, char *out, size_t size)
+    __attribute__((nonnull(1, 2))) __attribute__((warn_unused_result));
+static void print_usermod_command(FILE *out, const char *prefix,
+                                  char *const argv[])
+    __attribute__((nonnull(1, 2, 3)));
+static void getsubids_argv(char *argv[GETSUBIDS_ARGV_MAX],
+                           const char *username, subid_mode_t mode)
+    __attribute__((nonnull));
+static int getsubids_reap(const struct syscall_ops *ops, pid_t pid)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
 
 /**
  * check_subid_exists - Check if user already has subordinate IDs assigned
@@ -123,91 +87,20 @@ int check_subid_exists(const struct syscall_ops *ops, const char *username,
                   PROJECT_NAME, mode_str, username);
   }
 
-  /* Build argument list for getsubids */
-  /*
-   * POSIX API LIMITATION: posix_spawn takes char *const argv[] instead of
-   * const char *const argv[] for historical reasons. We must cast away const
-   * even though posix_spawn won't modify the strings. Disable cast-qual
-   * warning for this section.
-   *
-   * Yes, this is ugly.
-   */
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wcast-qual"
-  char *argv[4] = {NULL, NULL, NULL, NULL};
-  argv[0] = (char *)"getsubids";
-  if (mode == SUBGID) {
-    argv[1] = (char *)"-g";
-    argv[2] = (char *)username;
-    argv[3] = NULL;
-  } else {
-    argv[1] = (char *)username;
-    argv[2] = NULL;
-  }
-#pragma GCC diagnostic pop
-
-  /* Set up file actions to redirect stdin and stdout to /dev/null */
-  posix_spawn_file_actions_t actions;
-  int ret = ops->posix_spawn_file_actions_init(&actions);
-  if (ret != 0) {
-    (void)fprintf(stderr,
-                  "%s: error: posix_spawn_file_actions_init failed: %s\n",
-                  PROJECT_NAME, strerror(ret));
-    return -1;
-  }
-
-  /*
-   * Redirect stdin, stdout, and stderr to /dev/null, return code is our signal
-   */
-  ret = ops->posix_spawn_file_actions_addopen(&actions, STDIN_FILENO,
-                                              "/dev/null", O_RDONLY, 0);
-  if (ret != 0) {
-    ops->posix_spawn_file_actions_destroy(&actions);
-    (void)fprintf(stderr,
-                  "%s: error: posix_spawn_file_actions_addopen failed: %s\n",
-                  PROJECT_NAME, strerror(ret));
-    return -1;
-  }
-
-  if (!debug) {
-    ret = ops->posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO,
-                                                "/dev/null", O_WRONLY, 0);
-    if (ret != 0) {
-      ops->posix_spawn_file_actions_destroy(&actions);
-      (void)fprintf(stderr,
-                    "%s: error: posix_spawn_file_actions_addopen failed: %s\n",
-                    PROJECT_NAME, strerror(ret));
-      return -1;
-    }
+  char *argv[GETSUBIDS_ARGV_MAX];
+  getsubids_argv(argv, username, mode);
 
-    ret = ops->posix_spawn_file_actions_addopen(&actions, STDERR_FILENO,
-                                                "/dev/null", O_WRONLY, 0);
-    if (ret != 0) {
-      ops->posix_spawn_file_actions_destroy(&actions);
-      (void)fprintf(stderr,
-                    "%s: error: posix_spawn_file_actions_addopen failed: %s\n",
-                    PROJECT_NAME, strerror(ret));
-      return -1;
-    }
-  }
-
-  /* Spawn the child process with a sanitized environment */
-  char **safe_env = build_safe_environ(ops);
-  if (safe_env == NULL) {
-    ops->posix_spawn_file_actions_destroy(&actions);
-    (void)fprintf(stderr, "%s: error: failed to build safe environment\n",
-                  PROJECT_NAME);
+  /* Quiet unless debugging, the exit code is our signal */
+  spawn_ctx_t local;
+  spawn_ctx_t *ctx = spawn_ctx_acquire(ops, &local);
+  if (ctx == NULL) {
     return -1;
   }
 
   pid_t pid;
-  ret = ops->posix_spawn(&pid, GETSUBIDS_PATH, &actions, NULL, argv, safe_env);
-  ops->posix_spawn_file_actions_destroy(&actions);
-  free(safe_env);
-
+  int ret = spawn_helper(ops, ctx, GETSUBIDS_PATH, argv, !debug, &pid);
+  spawn_ctx_release(ops, ctx, &local);
   if (ret != 0) {
-    (void)fprintf(stderr, "%s: error: posix_spawn failed: %s\n", PROJECT_NAME,
-                  strerror(ret));
     return -1;
   }
 
@@ -248,47 +141,135 @@ int check_subid_exists(const struct syscall_ops *ops, const char *username,
 }
 
 /**
- * set_subid_range - Assign subordinate ID range to user using usermod
- * @ops: Operations structure for system call abstraction (kernel-style ops
- * pattern)
- * @username: Username to assign range to
- * @mode: SUBUID or SUBGID
- * @start: Start of subordinate ID range
- * @count: Number of IDs in range
- * @noop: If true, print command but don't execute
- * @debug: If true, print debug messages to stderr
- *
- * Uses usermod(8) with --add-subuids or --add-subgids to assign the
- * specified subordinate ID range. Converts range from (start, count)
- * format to "start-end" format required by usermod.
- *
- * Note:
- * - Closes stdin in child to prevent TTY interaction
- * - Preserves stdout and stderr so usermod output/errors are visible
- * - Uses absolute path to avoid PATH injection
- * - Validates usermod exit code and reports errors clearly
- *
- * Note: usermod is smart enough to not add subids for a user
- * if that user already has that exact subid set. This does
- * not check for overlap with either this user or any other.
+ * getsubids_argv - Build the getsubids(1) argument vector for a user
+ * @argv: Vector to fill, NULL-terminated
+ * @username: Username to look up
+ * @mode: SUBUID or SUBGID ("-g")
+ */
+static void getsubids_argv(char *argv[GETSUBIDS_ARGV_MAX],
+                           const char *username, subid_mode_t mode) {
+  /*
+   * POSIX API LIMITATION: posix_spawn takes char *const argv[] instead of
+   * const char *const argv[] for historical reasons. We must cast away const
+   * even though posix_spawn won't modify the strings. Disable cast-qual
+   * warning for this section.
+   *
+   * Yes, this is ugly.
+   */
+  size_t argc = 0;
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wcast-qual"
+  argv[argc++] = (char *)"getsubids";
+  if (mode == SUBGID) {
+    argv[argc++] = (char *)"-g";
+  }
+  argv[argc++] = (char *)username;
+#pragma GCC diagnostic pop
+  argv[argc] = NULL;
+}
+
+/**
+ * getsubids_reap - Wait for one getsubids(1) and read its answer
+ * @ops: Operations structure for system call abstraction
+ * @pid: Child to wait for
  *
- * Return: 0 on success, -1 on error
+ * Return: 1 if ranges exist, 0 if not, -1 if the answer is unknown
  */
-int set_subid_range(const struct syscall_ops *ops, const char *username,
-                    subid_mode_t mode, uint32_t start, uint32_t count,
-                    bool noop, bool debug) {
-  if (ops == NULL) {
-    errno = EINVAL;
-    (void)fprintf(stderr, "%s: error: ops is NULL\n", PROJECT_NAME);
+static int getsubids_reap(const struct syscall_ops *ops, pid_t pid) {
+  int status = 0;
+  if (ops->waitpid(pid, &status, 0) < 0 || !WIFEXITED(status)) {
     return -1;
   }
-  if (username == NULL) {
-    errno = EINVAL;
-    (void)fprintf(stderr, "%s: error: username is NULL\n", PROJECT_NAME);
+
+  switch (WEXITSTATUS(status)) {
+  case 0:
+    return 1;
+  case 1:
+    return 0;
+  default:
     return -1;
   }
+}
 
-  if (count == 0) {
+/**
+ * check_subid_exists_many - check_subid_exists() for many users at once
+ * @ops: Operations structure for system call abstraction
+ * @usernames: Users to check, NULL entries are skipped
+ * @count: Number of @usernames
+ * @mode: SUBUID or SUBGID
+ * @in_flight: Most getsubids(1) children running at a time
+ * @results: Set per user to 1 (exists), 0 (does not) or -1 (unknown)
+ *
+ * getsubids(1) only reads, so up to @in_flight of them run side by side
+ * and are reaped oldest first; a batch pays roughly one helper's latency
+ * per @in_flight users instead of per user. Their output always goes to
+ * /dev/null and only spawn failures are printed, so callers rerun
+ * check_subid_exists() for every -1 to get its diagnostics in order.
+ */
+void check_subid_exists_many(const struct syscall_ops *ops,
+                             const char *const *usernames, size_t count,
+                             subid_mode_t mode, unsigned int in_flight,
+                             int *results) {
+  if (results == NULL) {
+    return;
+  }
+  for (size_t i = 0; i < count; i++) {
+    results[i] = -1;
+  }
+  if (ops == NULL || usernames == NULL || (mode != SUBUID && mode != SUBGID)) {
+    return;
+  }
+
+  spawn_ctx_t local;
+  spawn_ctx_t *ctx = spawn_ctx_acquire(ops, &local);
+  if (ctx == NULL) {
+    return;
+  }
+
+  size_t limit = in_flight == 0                 ? 1
+                 : in_flight > RESOLVE_JOBS_MAX ? RESOLVE_JOBS_MAX
+                                                : in_flight;
+  pid_t pids[RESOLVE_JOBS_MAX];
+  size_t owners[RESOLVE_JOBS_MAX];
+  size_t head = 0;
+  size_t running = 0;
+
+  for (size_t i = 0; i <= count; i++) {
+    /* Reap the oldest child when full, and everything at the end */
+    while (running > 0 && (running == limit || i == count)) {
+      results[owners[head]] = getsubids_reap(ops, pids[head]);
+      head = (head + 1) % limit;
+      running--;
+    }
+    if (i == count || usernames[i] == NULL) {
+      continue;
+    }
+
+    char *argv[GETSUBIDS_ARGV_MAX];
+    getsubids_argv(argv, usernames[i], mode);
+
+    size_t tail = (head + running) % limit;
+    if (spawn_helper(ops, ctx, GETSUBIDS_PATH, argv, true, &pids[tail]) !=
+        0) {
+      continue;
+    }
+    owners[tail] = i;
+    running++;
+  }
+
+  spawn_ctx_release(ops, ctx, &local);
+}
+
+/**
+ * format_range - Format a range the way usermod(8) expects it
+ * @range: Range to format
+ * @out: Output buffer ("start-end")
+ * @size: Size of @out
+ *
+ * Return: 0 on success, -1 on error (zero count or overflow)
+ */
+static int format_range(const subid_range_t *range, char *out, size_t size) {
+  if (range->count == 0) {
     errno = EINVAL;
     (void)fprintf(stderr, "%s: error: count cannot be zero\n", PROJECT_NAME);
     return -1;
@@ -303,19 +284,18 @@ int set_subid_range(const struct syscall_ops *ops, const char *username,
    * before we get here, but we defend independently so this function's
    * contract holds regardless of caller.
    */
-  if ((uint64_t)start + (uint64_t)count - 1 > UINT32_MAX) {
+  if ((uint64_t)range->start + (uint64_t)range->count - 1 > UINT32_MAX) {
     errno = EINVAL;
     (void)fprintf(stderr,
                   "%s: error: subid range overflow: start=%u count=%u\n",
-                  PROJECT_NAME, start, count);
+                  PROJECT_NAME, range->start, range->count);
     return -1;
   }
-  uint32_t end_id = start + count - 1;
+  uint32_t end_id = range->start + range->count - 1;
 
-  char range_str[RANGE_STR_MAX] = {0};
-  int ret = snprintf(range_str, sizeof(range_str), "%u-%u", start, end_id);
+  int ret = snprintf(out, size, "%u-%u", range->start, end_id);
   // LCOV_EXCL_START
-  if (ret < 0 || (size_t)ret >= sizeof(range_str)) {
+  if (ret < 0 || (size_t)ret >= size) {
     errno = EINVAL;
     (void)fprintf(stderr, "%s: error: range string formatting failed\n",
                   PROJECT_NAME);
@@ -323,35 +303,100 @@ int set_subid_range(const struct syscall_ops *ops, const char *username,
   }
   // LCOV_EXCL_STOP
 
-  const char *flag = NULL;
-  const char *mode_str = NULL;
-  if (mode == SUBUID) {
-    flag = "--add-subuids";
-    mode_str = "subuid";
-  } else if (mode == SUBGID) {
-    flag = "--add-subgids";
-    mode_str = "subgid";
-  } else {
+  return 0;
+}
+
+/**
+ * print_usermod_command - Print the usermod command line being run
+ * @out: Output stream
+ * @prefix: Message prefix ("noop: would execute" / "debug: will execute")
+ * @argv: NULL-terminated usermod arguments, argv[0] is skipped
+ */
+static void print_usermod_command(FILE *out, const char *prefix,
+                                  char *const argv[]) {
+  (void)fprintf(out, "%s: %s: %s", PROJECT_NAME, prefix, USERMOD_PATH);
+  for (size_t i = 1; argv[i] != NULL; i++) {
+    (void)fprintf(out, " %s", argv[i]);
+  }
+  (void)fputc('\n', out);
+}
+
+/**
+ * set_subid_ranges - Assign subordinate UID and/or GID ranges in one call
+ * @ops: Operations structure for system call abstraction (kernel-style ops
+ * pattern)
+ * @username: Username to assign ranges to
+ * @subuid: Subordinate UID range, or NULL to leave subuids alone
+ * @subgid: Subordinate GID range, or NULL to leave subgids alone
+ * @noop: If true, print command but don't execute
+ * @debug: If true, print debug messages to stderr
+ *
+ * Uses usermod(8) with --add-subuids and/or --add-subgids to assign the
+ * specified ranges. Passing both flags to one usermod run takes the
+ * shadow locks once and applies both ranges or neither, instead of
+ * leaving a user with only a subuid range when the second call fails.
+ * Converts ranges from (start, count) format to "start-end" format
+ * required by usermod.
+ *
+ * Note:
+ * - Closes stdin in child to prevent TTY interaction
+ * - Preserves stdout and stderr so usermod output/errors are visible
+ * - Uses absolute path to avoid PATH injection
+ * - Validates usermod exit code and reports errors clearly
+ *
+ * Note: usermod is smart enough to not add subids for a user
+ * if that user already has that exact subid set. This does
+ * not check for overlap with either this user or any other.
+ *
+ * Return: 0 on success, -1 on error
+ */
+int set_subid_ranges(const struct syscall_ops *ops, const char *username,
+                     const subid_range_t *subuid, const subid_range_t *subgid,
+                     bool noop, bool debug) {
+  if (ops == NULL) {
     errno = EINVAL;
-    (void)fprintf(stderr, "%s: error: invalid mode\n", PROJECT_NAME);
+    (void)fprintf(stderr, "%s: error: ops is NULL\n", PROJECT_NAME);
     return -1;
   }
-
-  if (debug) {
-    (void)fprintf(stderr,
-                  "%s: debug: assigning %s range %s (%u:%u) to user %s\n",
-                  PROJECT_NAME, mode_str, range_str, start, count, username);
+  if (username == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: username is NULL\n", PROJECT_NAME);
+    return -1;
+  }
+  if (subuid == NULL && subgid == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: no range to assign\n", PROJECT_NAME);
+    return -1;
   }
 
-  if (noop) {
-    (void)printf("%s: noop: would execute: %s %s %s %s\n", PROJECT_NAME,
-                 USERMOD_PATH, flag, range_str, username);
-    return 0;
+  char subuid_str[RANGE_STR_MAX] = {0};
+  char subgid_str[RANGE_STR_MAX] = {0};
+  if ((subuid != NULL &&
+       format_range(subuid, subuid_str, sizeof(subuid_str)) != 0) ||
+      (subgid != NULL &&
+       format_range(subgid, subgid_str, sizeof(subgid_str)) != 0)) {
+    return -1;
   }
 
+  const char *mode_str = subuid == NULL   ? "subgid"
+                         : subgid == NULL ? "subuid"
+                                          : "subuid and subgid";
+
   if (debug) {
-    (void)fprintf(stderr, "%s: debug: will execute: %s %s %s %s\n",
-                  PROJECT_NAME, USERMOD_PATH, flag, range_str, username);
+    if (subuid != NULL) {
+      (void)fprintf(stderr,
+                    "%s: debug: assigning subuid range %s (%u:%u) to user "
+                    "%s\n",
+                    PROJECT_NAME, subuid_str, subuid->start, subuid->count,
+                    username);
+    }
+    if (subgid != NULL) {
+      (void)fprintf(stderr,
+                    "%s: debug: assigning subgid range %s (%u:%u) to user "
+                    "%s\n",
+                    PROJECT_NAME, subgid_str, subgid->start, subgid->count,
+                    username);
+    }
   }
 
   /* Build argument list for usermod */
@@ -363,49 +408,43 @@ int set_subid_range(const struct syscall_ops *ops, const char *username,
    *
    * Yes, this is ugly.
    */
+  char *argv[USERMOD_ARGV_MAX] = {0};
+  size_t argc = 0;
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wcast-qual"
-  char *argv[] = {(char *)"usermod", (char *)flag, (char *)range_str,
-                  (char *)username, NULL};
+  argv[argc++] = (char *)"usermod";
+  if (subuid != NULL) {
+    argv[argc++] = (char *)"--add-subuids";
+    argv[argc++] = subuid_str;
+  }
+  if (subgid != NULL) {
+    argv[argc++] = (char *)"--add-subgids";
+    argv[argc++] = subgid_str;
+  }
+  argv[argc++] = (char *)username;
 #pragma GCC diagnostic pop
+  argv[argc] = NULL;
 
-  /* Set up file actions - close stdin, keep stdout/stderr */
-  posix_spawn_file_actions_t actions;
-  ret = ops->posix_spawn_file_actions_init(&actions);
-  if (ret != 0) {
-    (void)fprintf(stderr,
-                  "%s: error: posix_spawn_file_actions_init failed: %s\n",
-                  PROJECT_NAME, strerror(ret));
-    return -1;
+  if (noop) {
+    print_usermod_command(stdout, "noop: would execute", argv);
+    return 0;
   }
 
-  ret = ops->posix_spawn_file_actions_addopen(&actions, STDIN_FILENO,
-                                              "/dev/null", O_RDONLY, 0);
-  if (ret != 0) {
-    ops->posix_spawn_file_actions_destroy(&actions);
-    (void)fprintf(stderr,
-                  "%s: error: posix_spawn_file_actions_addopen failed: %s\n",
-                  PROJECT_NAME, strerror(ret));
-    return -1;
+  if (debug) {
+    print_usermod_command(stderr, "debug: will execute", argv);
   }
 
-  /* Spawn the child process with a sanitized environment */
-  char **safe_env = build_safe_environ(ops);
-  if (safe_env == NULL) {
-    ops->posix_spawn_file_actions_destroy(&actions);
-    (void)fprintf(stderr, "%s: error: failed to build safe environment\n",
-                  PROJECT_NAME);
+  /* stdin on /dev/null, stdout/stderr kept so usermod errors are seen */
+  spawn_ctx_t local;
+  spawn_ctx_t *ctx = spawn_ctx_acquire(ops, &local);
+  if (ctx == NULL) {
     return -1;
   }
 
   pid_t pid;
-  ret = ops->posix_spawn(&pid, USERMOD_PATH, &actions, NULL, argv, safe_env);
-  ops->posix_spawn_file_actions_destroy(&actions);
-  free(safe_env);
-
+  int ret = spawn_helper(ops, ctx, USERMOD_PATH, argv, false, &pid);
+  spawn_ctx_release(ops, ctx, &local);
   if (ret != 0) {
-    (void)fprintf(stderr, "%s: error: posix_spawn failed: %s\n", PROJECT_NAME,
-                  strerror(ret));
     return -1;
   }
 
@@ -435,7 +474,8 @@ int set_subid_range(const struct syscall_ops *ops, const char *username,
 
   if (exit_code == 0) {
     if (debug) {
-      (void)fprintf(stderr, "%s: debug: successfully assigned %s range to %s\n",
+      (void)fprintf(stderr,
+                    "%s: debug: successfully assigned %s range to %s\n",
                     PROJECT_NAME, mode_str, username);
     }
     return 0; /* Success */
@@ -446,3 +486,35 @@ int set_subid_range(const struct syscall_ops *ops, const char *username,
     return -1;
   }
 }
+
+/**
+ * set_subid_range - Assign one subordinate ID range to a user
+ * @ops: Operations structure for system call abstraction (kernel-style ops
+ * pattern)
+ * @username: Username to assign range to
+ * @mode: SUBUID or SUBGID
+ * @start: Start of subordinate ID range
+ * @count: Number of IDs in range
+ * @noop: If true, print command but don't execute
+ * @debug: If true, print debug messages to stderr
+ *
+ * Single-mode wrapper around set_subid_ranges().
+ *
+ * Return: 0 on success, -1 on error
+ */
+int set_subid_range(const struct syscall_ops *ops, const char *username,
+                    subid_mode_t mode, uint32_t start, uint32_t count,
+                    bool noop, bool debug) {
+  const subid_range_t range = {.start = start, .count = count};
+
+  switch (mode) {
+  case SUBUID:
+    return set_subid_ranges(ops, username, &range, NULL, noop, debug);
+  case SUBGID:
+    return set_subid_ranges(ops, username, NULL, &range, noop, debug);
+  default:
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: invalid mode\n", PROJECT_NAME);
+    return -1;
+  }
+}
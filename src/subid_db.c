@@ -0,0 +1,353 @@
+/**
+ * subid_db.c - In-process access to the subordinate ID databases
+ *
+ * Reads /etc/subuid and /etc/subgid directly instead of spawning
+ * getsubids(1). The files hold one "owner:start:count" entry per line,
+ * where owner is either a username or a numeric UID (see subuid(5)).
+ *
+ * Only the local files are consulted. Sites that publish subordinate IDs
+ * through an NSS subid provider (e.g. sssd) must keep the getsubids
+ * backend, which goes through libsubid and therefore sees those sources.
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/*
+ * Forward declarations for internal functions
+ *
+ * We can use nonnull on static functions because they can only be called
+ * from inside here and we're careful to check the pointers in our visible
+ * function(s).
+ */
+static bool owner_matches(const char *owner, const char *username,
+                          const char *uid_str) __attribute__((nonnull(1, 2, 3)))
+__attribute__((warn_unused_result));
+
+/**
+ * subid_db_open - Open a subordinate ID database for reading
+ * @ops: Operations structure for system call abstraction
+ * @path: Database path
+ * @debug: Enable debug output
+ *
+ * The file is opened first and checked via fstat() on the descriptor so
+ * the checks apply to the file actually read. Only regular files are
+ * accepted. A missing database is reported as ENOENT without an error
+ * message since shadow-utils creates it on first use.
+ *
+ * Return: FILE pointer on success, NULL on error (errno set)
+ */
+FILE *subid_db_open(const struct syscall_ops *ops, const char *path,
+                    bool debug) {
+  if (ops == NULL || path == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: NULL parameter in subid_db_open\n",
+                  PROJECT_NAME);
+    return NULL;
+  }
+
+  int fd = ops->open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    if (errno == ENOENT) {
+      if (debug) {
+        (void)fprintf(stderr, "%s: debug: %s does not exist\n", PROJECT_NAME,
+                      path);
+      }
+      errno = ENOENT;
+      return NULL;
+    }
+    int saved_errno = errno;
+    (void)fprintf(stderr, "%s: error: cannot open %s: %s\n", PROJECT_NAME,
+                  path, strerror(saved_errno));
+    errno = saved_errno;
+    return NULL;
+  }
+
+  struct stat st = {0};
+  if (ops->fstat(fd, &st) != 0) {
+    int saved_errno = errno;
+    (void)fprintf(stderr, "%s: error: cannot fstat %s: %s\n", PROJECT_NAME,
+                  path, strerror(saved_errno));
+    (void)ops->close(fd);
+    errno = saved_errno;
+    return NULL;
+  }
+
+  if (!S_ISREG(st.st_mode)) {
+    (void)fprintf(stderr, "%s: error: %s is not a regular file\n",
+                  PROJECT_NAME, path);
+    (void)ops->close(fd);
+    errno = EBADF;
+    return NULL;
+  }
+
+  FILE *fp = ops->fdopen(fd, "r");
+  if (fp == NULL) {
+    (void)fprintf(stderr, "%s: error: cannot fdopen %s: %s\n", PROJECT_NAME,
+                  path, strerror(errno));
+    (void)ops->close(fd);
+    errno = EBADF;
+    return NULL;
+  }
+
+  /* fd now owned by fp, don't close fd! */
+  return fp;
+}
+
+/**
+ * owner_matches - Check whether a database owner field names our user
+ * @owner: Owner field from the database
+ * @username: Username being checked
+ * @uid_str: Decimal UID of @username
+ *
+ * Return: true if @owner is @username or @uid_str
+ */
+static bool owner_matches(const char *owner, const char *username,
+                          const char *uid_str) {
+  return strcmp(owner, username) == 0 || strcmp(owner, uid_str) == 0;
+}
+
+/**
+ * subid_db_path - Database path for a mode
+ * @mode: SUBUID or SUBGID
+ *
+ * Return: SUBUID_PATH or SUBGID_PATH, NULL for an invalid mode
+ */
+const char *subid_db_path(subid_mode_t mode) {
+  switch (mode) {
+  case SUBUID:
+    return SUBUID_PATH;
+  case SUBGID:
+    return SUBGID_PATH;
+  default:
+    return NULL;
+  }
+}
+
+/**
+ * subid_db_parse_line - Split one database line into its fields
+ * @line: Line to parse, modified in place (':' separators replaced)
+ * @owner: Set to the owner field inside @line
+ * @start: Set to the first subordinate ID
+ * @count: Set to the number of subordinate IDs
+ *
+ * Lines are normalized like configuration lines first, so trailing
+ * newlines, surrounding whitespace and '#' comments are ignored.
+ *
+ * Return: 0 on success, 1 for a blank line, -1 for a malformed line
+ */
+int subid_db_parse_line(char *line, const char **owner, uint32_t *start,
+                        uint32_t *count) {
+  if (line == NULL || owner == NULL || start == NULL || count == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  char *clean = normalize_config_line(line);
+  if (*clean == '\0') {
+    return 1;
+  }
+
+  char *start_str = strchr(clean, ':');
+  if (start_str == NULL || start_str == clean) {
+    errno = EINVAL;
+    return -1;
+  }
+  *start_str++ = '\0';
+
+  char *count_str = strchr(start_str, ':');
+  if (count_str == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  *count_str++ = '\0';
+
+  if (parse_uint32_strict(start_str, start) != 0 ||
+      parse_uint32_strict(count_str, count) != 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  *owner = clean;
+  return 0;
+}
+
+/**
+ * subid_db_read_entry - Read the next well-formed entry of a database
+ * @ops: Operations structure for system call abstraction
+ * @fp: Database opened with subid_db_open()
+ * @path: Database path, for debug output
+ * @line: Line buffer the fields point into
+ * @size: Size of @line
+ * @owner: Set to the owner field inside @line
+ * @start: Set to the first subordinate ID
+ * @count: Set to the number of subordinate IDs
+ * @debug: Enable debug output
+ *
+ * Malformed lines are skipped, matching shadow-utils which ignores them
+ * as well. Lines longer than @size - 1 are skipped in full.
+ *
+ * Return: 1 if an entry was read, 0 at end of file
+ */
+int subid_db_read_entry(const struct syscall_ops *ops, FILE *fp,
+                        const char *path, char *line, size_t size,
+                        const char **owner, uint32_t *start, uint32_t *count,
+                        bool debug) {
+  if (ops == NULL || fp == NULL || path == NULL || line == NULL ||
+      size < 2 || size > INT_MAX || owner == NULL || start == NULL ||
+      count == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: NULL parameter in subid_db_read_entry\n",
+                  PROJECT_NAME);
+    return 0;
+  }
+
+  bool continuation = false;
+  while (ops->fgets(line, (int)size, fp) != NULL) {
+    size_t len = strlen(line);
+    bool complete = len > 0 && line[len - 1] == '\n';
+
+    /* Tail of an overlong line: skip until its newline */
+    if (continuation) {
+      continuation = !complete;
+      continue;
+    }
+    if (!complete && len == size - 1) {
+      if (debug) {
+        (void)fprintf(stderr, "%s: debug: %s: skipping overlong line\n",
+                      PROJECT_NAME, path);
+      }
+      continuation = true;
+      continue;
+    }
+
+    if (subid_db_parse_line(line, owner, start, count) == 0) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * subid_db_lookup - Collect the ranges a database assigns to a user
+ * @ops: Operations structure for system call abstraction
+ * @path: Database path (SUBUID_PATH or SUBGID_PATH)
+ * @username: Username to look for
+ * @uid: UID of @username (entries may be keyed by either)
+ * @ranges: Array filled with the first @max matching ranges, may be NULL
+ *          when @max is 0
+ * @max: Capacity of @ranges
+ * @found: Set to the total number of matching entries, which may exceed @max
+ * @debug: Enable debug output
+ *
+ * A current index in SUBID_INDEX_DIR answers without reading @path at
+ * all; otherwise the file is scanned with subid_db_read_entry(). Both
+ * give the same ranges in the same order.
+ * A database that does not exist holds no ranges.
+ *
+ * Return: 0 on success, -1 on error
+ */
+int subid_db_lookup(const struct syscall_ops *ops, const char *path,
+                    const char *username, uint32_t uid, subid_range_t *ranges,
+                    size_t max, size_t *found, bool debug) {
+  if (ops == NULL || path == NULL || username == NULL || found == NULL ||
+      (ranges == NULL && max > 0)) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: NULL parameter in subid_db_lookup\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  *found = 0;
+
+  subid_index_t index = {0};
+  if (subid_index_open(ops, SUBID_INDEX_DIR, path, &index, debug) == 1) {
+    int ret = subid_index_lookup(&index, username, uid, ranges, max, found);
+    subid_index_close(ops, &index);
+    if (ret == 0) {
+      if (debug) {
+        (void)fprintf(stderr, "%s: debug: %s: index has %zu range(s) for %s\n",
+                      PROJECT_NAME, path, *found, username);
+      }
+      return 0;
+    }
+    *found = 0;
+  }
+
+  char uid_str[UINT32_DECIMAL_MAX_LEN + 1] = {0};
+  (void)snprintf(uid_str, sizeof(uid_str), "%u", uid);
+
+  FILE *fp = subid_db_open(ops, path, debug);
+  if (fp == NULL) {
+    return errno == ENOENT ? 0 : -1;
+  }
+
+  char line[MAX_LINE_LEN] = {0};
+  const char *owner = NULL;
+  uint32_t start = 0;
+  uint32_t count = 0;
+  while (subid_db_read_entry(ops, fp, path, line, sizeof(line), &owner,
+                             &start, &count, debug) == 1) {
+    if (!owner_matches(owner, username, uid_str)) {
+      continue;
+    }
+
+    if (*found < max) {
+      ranges[*found] = (subid_range_t){.start = start, .count = count};
+    }
+    (*found)++;
+
+    if (debug) {
+      (void)fprintf(stderr, "%s: debug: %s: %s has range %u:%u\n",
+                    PROJECT_NAME, path, username, start, count);
+    }
+  }
+
+  (void)ops->fclose(fp);
+  return 0;
+}
+
+/**
+ * subid_db_check_exists - In-process equivalent of check_subid_exists()
+ * @ops: Operations structure for system call abstraction
+ * @username: Username to check
+ * @uid: UID of @username
+ * @mode: SUBUID or SUBGID
+ * @debug: Enable debug output
+ *
+ * Return: 1 if exists, 0 if not exists, -1 on error
+ */
+int subid_db_check_exists(const struct syscall_ops *ops, const char *username,
+                          uint32_t uid, subid_mode_t mode, bool debug) {
+  const char *path = subid_db_path(mode);
+  if (path == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: invalid mode\n", PROJECT_NAME);
+    return -1;
+  }
+
+  if (debug) {
+    (void)fprintf(stderr, "%s: debug: checking %s for %s\n", PROJECT_NAME,
+                  path, username != NULL ? username : "(null)");
+  }
+
+  size_t found = 0;
+  if (subid_db_lookup(ops, path, username, uid, NULL, 0, &found, debug) != 0) {
+    return -1;
+  }
+
+  return found > 0 ? 1 : 0;
+}
@@ -0,0 +1,920 @@
+/**
+ * subid_index.c - Binary lookup index for the subordinate ID databases
+ *
+ * subid_db_lookup() otherwise scans every line of /etc/subuid or
+ * /etc/subgid. When SUBID_INDEX_DIR exists, each write by this tool (a
+ * native rewrite or a usermod(8) call) also leaves <dir>/subuid.index or
+ * <dir>/subgid.index behind, and readers map it read-only instead:
+ *
+ *   header    struct subid_index_header
+ *   entries   struct subid_index_entry[entries], sorted by start
+ *   buckets   uint32_t[buckets], first entry of each owner hash chain
+ *   names     owner fields, NUL-terminated
+ *
+ * Lookups by owner walk one hash chain. The header records the identity
+ * of the text file it was built from (device, inode, size, mtime and
+ * ctime); an index that no longer matches, is damaged or is not a
+ * root-owned regular file is ignored and the text file is read as before.
+ * Nothing here ever has to be right for the databases themselves to be
+ * right.
+ *
+ * The index holds the same entries subid_db_read_entry() yields, so both
+ * paths agree on malformed and overlong lines.
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Suffix of an index file, after the basename of its database */
+#define SUBID_INDEX_SUFFIX ".index"
+
+/* "SSIX" little-endian, then the layout version of the index file */
+enum { INDEX_MAGIC = 0x58495353, INDEX_VERSION = 2 };
+
+/* End of a hash chain or empty bucket */
+#define INDEX_NONE UINT32_MAX
+
+/* Initial capacities of the builder's arrays, doubled as they fill */
+enum { INDEX_INITIAL_ENTRIES = 64, INDEX_INITIAL_NAMES = 1024 };
+
+/**
+ * struct subid_index_header - Start of an index file
+ * @magic: INDEX_MAGIC
+ * @version: INDEX_VERSION
+ * @db_dev: st_dev of the database the index was built from
+ * @db_ino: st_ino of the database
+ * @db_size: st_size of the database
+ * @db_mtime_sec: st_mtim.tv_sec of the database
+ * @db_mtime_nsec: st_mtim.tv_nsec of the database
+ * @db_ctime_sec: st_ctim.tv_sec of the database
+ * @db_ctime_nsec: st_ctim.tv_nsec of the database
+ * @entries: Number of entries
+ * @buckets: Number of hash buckets, a power of two
+ * @names_size: Size of the names area in bytes
+ * @reserved: Zero, keeps @checksum aligned without implicit padding
+ * @checksum: hash_fnv1a() of everything before it
+ *
+ * Written in host byte order; it never leaves the machine.
+ */
+struct subid_index_header {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t db_dev;
+  uint64_t db_ino;
+  int64_t db_size;
+  int64_t db_mtime_sec;
+  int64_t db_mtime_nsec;
+  int64_t db_ctime_sec;
+  int64_t db_ctime_nsec;
+  uint32_t entries;
+  uint32_t buckets;
+  uint32_t names_size;
+  uint32_t reserved;
+  uint64_t checksum;
+};
+
+_Static_assert(sizeof(struct subid_index_header) == 88,
+               "subid_index_header must not contain padding");
+
+/**
+ * struct subid_index_entry - One database line
+ * @start: First subordinate ID
+ * @count: Number of subordinate IDs
+ * @owner: Offset of the owner field in the names area
+ * @seq: Position of the line among the database's entries
+ * @next: Next entry of the same hash chain, INDEX_NONE at the end; chains
+ *        run in @seq order so lookups return ranges in file order
+ * @reserved: Zero
+ */
+struct subid_index_entry {
+  uint32_t start;
+  uint32_t count;
+  uint32_t owner;
+  uint32_t seq;
+  uint32_t next;
+  uint32_t reserved;
+};
+
+_Static_assert(sizeof(struct subid_index_entry) == 24,
+               "subid_index_entry must not contain padding");
+
+/**
+ * struct index_builder - Entries collected from a database
+ * @entries: Entries in file order, later sorted by start
+ * @len: Entries in use
+ * @cap: Entries allocated
+ * @names: Owner fields, NUL-terminated
+ * @names_len: Bytes of @names in use
+ * @names_cap: Bytes of @names allocated
+ */
+struct index_builder {
+  struct subid_index_entry *entries;
+  size_t len;
+  size_t cap;
+  char *names;
+  size_t names_len;
+  size_t names_cap;
+};
+
+/*
+ * Forward declarations for internal functions
+ *
+ * We can use nonnull on static functions because they can only be called
+ * from inside here and we're careful to check the pointers in our visible
+ * function(s).
+ */
+static int index_path(char *out, size_t size, const char *dir,
+                      const char *db_path, bool tmp) __attribute__((nonnull))
+__attribute__((warn_unused_result));
+static uint64_t header_checksum(const struct subid_index_header *header)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static bool header_matches(const struct subid_index_header *header,
+                           const struct stat *st) __attribute__((nonnull))
+__attribute__((warn_unused_result));
+static size_t index_file_size(const struct subid_index_header *header)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static const struct subid_index_header *
+index_header(const subid_index_t *index) __attribute__((nonnull))
+__attribute__((warn_unused_result));
+static const struct subid_index_entry *
+index_entries(const subid_index_t *index) __attribute__((nonnull))
+__attribute__((warn_unused_result));
+static const uint32_t *index_buckets(const subid_index_t *index)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static const char *index_names(const subid_index_t *index)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static uint32_t owner_bucket(const char *owner, uint32_t buckets)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static int chain_next(const subid_index_t *index, uint32_t pos, uint32_t *next)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static int builder_add(const struct syscall_ops *ops,
+                       struct index_builder *builder, const char *owner,
+                       uint32_t start, uint32_t count) __attribute__((nonnull))
+__attribute__((warn_unused_result));
+static void builder_free(const struct syscall_ops *ops,
+                         struct index_builder *builder)
+    __attribute__((nonnull));
+static int builder_read(const struct syscall_ops *ops, const char *db_path,
+                        struct index_builder *builder, struct stat *st,
+                        bool debug) __attribute__((nonnull))
+__attribute__((warn_unused_result));
+static int compare_entries(const void *a, const void *b)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static unsigned char *builder_serialize(const struct syscall_ops *ops,
+                                        struct index_builder *builder,
+                                        const struct stat *st, size_t *size)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static int write_all(const struct syscall_ops *ops, int fd,
+                     const unsigned char *data, size_t size)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static int index_store(const struct syscall_ops *ops, const char *dir,
+                       const char *db_path, const unsigned char *data,
+                       size_t size, bool debug) __attribute__((nonnull))
+__attribute__((warn_unused_result));
+
+/**
+ * index_path - Build the index path of a database
+ * @out: Output buffer
+ * @size: Size of @out
+ * @dir: Index directory
+ * @db_path: Database path, whose basename names the index
+ * @tmp: Build the temporary name used while writing instead
+ *
+ * Return: 0 on success, -1 if the path does not fit
+ */
+static int index_path(char *out, size_t size, const char *dir,
+                      const char *db_path, bool tmp) {
+  const char *base = strrchr(db_path, '/');
+  base = base != NULL ? base + 1 : db_path;
+
+  int len = snprintf(out, size, "%s/%s%s%s", dir, base, SUBID_INDEX_SUFFIX,
+                     tmp ? ".tmp" : "");
+  if (len < 0 || (size_t)len >= size || *base == '\0') {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * header_checksum - Checksum an index header
+ * @header: Header
+ *
+ * Return: FNV-1a hash of every field before @header->checksum
+ */
+static uint64_t header_checksum(const struct subid_index_header *header) {
+  return hash_fnv1a(header, offsetof(struct subid_index_header, checksum),
+                    FNV1A_64_INIT);
+}
+
+/**
+ * header_matches - Check that an index was built from the current database
+ * @header: Index header
+ * @st: stat() of the database now
+ *
+ * Return: true if every recorded attribute is unchanged
+ */
+static bool header_matches(const struct subid_index_header *header,
+                           const struct stat *st) {
+  return header->db_dev == (uint64_t)st->st_dev &&
+         header->db_ino == (uint64_t)st->st_ino &&
+         header->db_size == (int64_t)st->st_size &&
+         header->db_mtime_sec == (int64_t)st->st_mtim.tv_sec &&
+         header->db_mtime_nsec == (int64_t)st->st_mtim.tv_nsec &&
+         header->db_ctime_sec == (int64_t)st->st_ctim.tv_sec &&
+         header->db_ctime_nsec == (int64_t)st->st_ctim.tv_nsec;
+}
+
+/**
+ * index_file_size - Size an index with this header must have
+ * @header: Index header
+ *
+ * Every count is 32 bits, so the sum cannot overflow 64 bits.
+ *
+ * Return: Size in bytes
+ */
+static size_t index_file_size(const struct subid_index_header *header) {
+  return sizeof(*header) +
+         (size_t)header->entries * sizeof(struct subid_index_entry) +
+         (size_t)header->buckets * sizeof(uint32_t) + header->names_size;
+}
+
+/**
+ * index_header - Header of a mapped index
+ * @index: Open index
+ *
+ * Return: Pointer into the mapping
+ */
+static const struct subid_index_header *
+index_header(const subid_index_t *index) {
+  return (const struct subid_index_header *)index->map;
+}
+
+/**
+ * index_entries - Entry array of a mapped index
+ * @index: Open index
+ *
+ * Return: Pointer into the mapping
+ */
+static const struct subid_index_entry *
+index_entries(const subid_index_t *index) {
+  return (const struct subid_index_entry *)(index_header(index) + 1);
+}
+
+/**
+ * index_buckets - Bucket array of a mapped index
+ * @index: Open index
+ *
+ * Return: Pointer into the mapping
+ */
+static const uint32_t *index_buckets(const subid_index_t *index) {
+  return (const uint32_t *)(index_entries(index) +
+                            index_header(index)->entries);
+}
+
+/**
+ * index_names - Names area of a mapped index
+ * @index: Open index
+ *
+ * Return: Pointer into the mapping
+ */
+static const char *index_names(const subid_index_t *index) {
+  return (const char *)(index_buckets(index) + index_header(index)->buckets);
+}
+
+/**
+ * owner_bucket - Hash bucket of an owner field
+ * @owner: Username or decimal UID as written in the database
+ * @buckets: Number of buckets, a power of two
+ *
+ * Return: Bucket number
+ */
+static uint32_t owner_bucket(const char *owner, uint32_t buckets) {
+  return (uint32_t)(hash_fnv1a(owner, strlen(owner), FNV1A_64_INIT) &
+                    (buckets - 1));
+}
+
+/**
+ * chain_next - Follow a hash chain one step
+ * @index: Open index
+ * @pos: Current entry
+ * @next: Set to the next entry, INDEX_NONE at the end of the chain
+ *
+ * Chains must move forward in file order, so a damaged index cannot make
+ * a lookup loop.
+ *
+ * Return: 0 on success, -1 if the link is invalid (errno EBADMSG)
+ */
+static int chain_next(const subid_index_t *index, uint32_t pos,
+                      uint32_t *next) {
+  const struct subid_index_header *header = index_header(index);
+  const struct subid_index_entry *entries = index_entries(index);
+
+  *next = entries[pos].next;
+  if (*next == INDEX_NONE) {
+    return 0;
+  }
+  if (*next >= header->entries || entries[*next].seq <= entries[pos].seq) {
+    errno = EBADMSG;
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * subid_index_open - Map the index of a database if it is current
+ * @ops: Operations structure for system call abstraction
+ * @dir: Index directory (SUBID_INDEX_DIR)
+ * @db_path: Database the index was built from
+ * @index: Set to the mapping on success
+ * @debug: Enable debug output
+ *
+ * The index must be a regular file owned by root and not world-writable,
+ * its header must be intact and describe @db_path as it is now, and its
+ * size must be exactly what the header says. Owner offsets and bucket
+ * heads are checked here as well, so lookups only have to follow chains.
+ *
+ * Return: 1 if @index is ready for lookups, 0 if the database has to be
+ *         read instead (including errors)
+ */
+int subid_index_open(const struct syscall_ops *ops, const char *dir,
+                     const char *db_path, subid_index_t *index, bool debug) {
+  if (ops == NULL || dir == NULL || db_path == NULL || index == NULL) {
+    return 0;
+  }
+
+  *index = (subid_index_t){0};
+
+  /* Without an index this costs one stat() and never an open() */
+  char path[PATH_MAX] = {0};
+  struct stat st = {0};
+  struct stat db_st = {0};
+  if (index_path(path, sizeof(path), dir, db_path, false) != 0 ||
+      ops->stat(path, &st) != 0 || ops->stat(db_path, &db_st) != 0) {
+    return 0;
+  }
+
+  int fd = ops->open(path, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+  if (fd < 0) {
+    if (debug && errno != ENOENT) {
+      (void)fprintf(stderr, "%s: debug: cannot open index %s: %s\n",
+                    PROJECT_NAME, path, strerror(errno));
+    }
+    return 0;
+  }
+
+  if (ops->fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_uid != 0 ||
+      (st.st_mode & S_IWOTH) != 0 ||
+      (size_t)st.st_size < sizeof(struct subid_index_header)) {
+    if (debug) {
+      (void)fprintf(stderr, "%s: debug: ignoring untrusted index %s\n",
+                    PROJECT_NAME, path);
+    }
+    (void)ops->close(fd);
+    return 0;
+  }
+
+  size_t size = (size_t)st.st_size;
+  void *map = ops->mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  (void)ops->close(fd);
+  if (map == MAP_FAILED) {
+    if (debug) {
+      (void)fprintf(stderr, "%s: debug: cannot map index %s: %s\n",
+                    PROJECT_NAME, path, strerror(errno));
+    }
+    return 0;
+  }
+
+  index->map = map;
+  index->size = size;
+
+  const struct subid_index_header *header = index_header(index);
+  bool valid = header->magic == INDEX_MAGIC &&
+               header->version == INDEX_VERSION &&
+               header->checksum == header_checksum(header) &&
+               header->buckets > 0 &&
+               (header->buckets & (header->buckets - 1)) == 0 &&
+               index_file_size(header) == size &&
+               (header->entries == 0 ||
+                (header->names_size > 0 &&
+                 index_names(index)[header->names_size - 1] == '\0'));
+
+  for (uint32_t i = 0; valid && i < header->entries; i++) {
+    valid = index_entries(index)[i].owner < header->names_size;
+  }
+  for (uint32_t i = 0; valid && i < header->buckets; i++) {
+    uint32_t head = index_buckets(index)[i];
+    valid = head == INDEX_NONE || head < header->entries;
+  }
+
+  if (!valid) {
+    if (debug) {
+      (void)fprintf(stderr, "%s: debug: ignoring damaged index %s\n",
+                    PROJECT_NAME, path);
+    }
+    subid_index_close(ops, index);
+    return 0;
+  }
+
+  if (!header_matches(header, &db_st)) {
+    if (debug) {
+      (void)fprintf(stderr, "%s: debug: index %s is out of date\n",
+                    PROJECT_NAME, path);
+    }
+    subid_index_close(ops, index);
+    return 0;
+  }
+
+  return 1;
+}
+
+/**
+ * subid_index_close - Unmap an index
+ * @ops: Operations structure for system call abstraction
+ * @index: Index from subid_index_open() (may be NULL or unmapped)
+ */
+void subid_index_close(const struct syscall_ops *ops, subid_index_t *index) {
+  if (ops == NULL || index == NULL || index->map == NULL) {
+    return;
+  }
+
+  (void)ops->munmap(index->map, index->size);
+  *index = (subid_index_t){0};
+}
+
+/**
+ * subid_index_lookup - Collect the ranges an index assigns to a user
+ * @index: Open index
+ * @username: Username to look for
+ * @uid: UID of @username (entries may be keyed by either)
+ * @ranges: Array filled with the first @max matching ranges, may be NULL
+ *          when @max is 0
+ * @max: Capacity of @ranges
+ * @found: Set to the total number of matching entries, which may exceed @max
+ *
+ * Same contract as subid_db_lookup(): ranges come back in file order.
+ * The username and the UID may hash to different chains, which are
+ * merged on their line numbers.
+ *
+ * Return: 0 on success, -1 on error (errno EBADMSG for a damaged index)
+ */
+int subid_index_lookup(const subid_index_t *index, const char *username,
+                       uint32_t uid, subid_range_t *ranges, size_t max,
+                       size_t *found) {
+  if (index == NULL || index->map == NULL || username == NULL ||
+      found == NULL || (ranges == NULL && max > 0)) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: NULL parameter in subid_index_lookup\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  *found = 0;
+
+  char uid_str[UINT32_DECIMAL_MAX_LEN + 1] = {0};
+  (void)snprintf(uid_str, sizeof(uid_str), "%u", uid);
+
+  const struct subid_index_header *header = index_header(index);
+  const struct subid_index_entry *entries = index_entries(index);
+  const uint32_t *buckets = index_buckets(index);
+  const char *names = index_names(index);
+
+  uint32_t name_bucket = owner_bucket(username, header->buckets);
+  uint32_t uid_bucket = owner_bucket(uid_str, header->buckets);
+  uint32_t a = buckets[name_bucket];
+  uint32_t b = uid_bucket != name_bucket ? buckets[uid_bucket] : INDEX_NONE;
+
+  while (a != INDEX_NONE || b != INDEX_NONE) {
+    uint32_t *chain = &a;
+    if (a == INDEX_NONE ||
+        (b != INDEX_NONE && entries[b].seq < entries[a].seq)) {
+      chain = &b;
+    }
+
+    const struct subid_index_entry *entry = &entries[*chain];
+    if (chain_next(index, *chain, chain) != 0) {
+      *found = 0;
+      return -1;
+    }
+
+    const char *owner = names + entry->owner;
+    if (strcmp(owner, username) != 0 && strcmp(owner, uid_str) != 0) {
+      continue;
+    }
+
+    if (*found < max) {
+      ranges[*found] =
+          (subid_range_t){.start = entry->start, .count = entry->count};
+    }
+    (*found)++;
+  }
+
+  return 0;
+}
+
+/**
+ * builder_add - Append one database entry
+ * @ops: Operations structure (needed for calloc)
+ * @builder: Builder
+ * @owner: Owner field
+ * @start: First subordinate ID
+ * @count: Number of subordinate IDs
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int builder_add(const struct syscall_ops *ops,
+                       struct index_builder *builder, const char *owner,
+                       uint32_t start, uint32_t count) {
+  size_t owner_len = strlen(owner) + 1;
+
+  /* Every offset and count in the file is 32 bits */
+  if (builder->len >= INDEX_NONE ||
+      builder->names_len + owner_len > UINT32_MAX) {
+    errno = EOVERFLOW;
+    (void)fprintf(stderr, "%s: error: too many entries to index\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  if (builder->len == builder->cap) {
+    size_t cap = builder->cap == 0 ? INDEX_INITIAL_ENTRIES : builder->cap * 2;
+    struct subid_index_entry *grown = ops->calloc(cap, sizeof(*grown));
+    if (grown == NULL) {
+      errno = ENOMEM;
+      (void)fprintf(stderr, "%s: error: memory allocation failed\n",
+                    PROJECT_NAME);
+      return -1;
+    }
+    if (builder->len > 0) {
+      (void)memcpy(grown, builder->entries,
+                   builder->len * sizeof(*builder->entries));
+    }
+    ops->free(builder->entries);
+    builder->entries = grown;
+    builder->cap = cap;
+  }
+
+  if (builder->names_len + owner_len > builder->names_cap) {
+    size_t cap =
+        builder->names_cap == 0 ? INDEX_INITIAL_NAMES : builder->names_cap * 2;
+    while (cap < builder->names_len + owner_len) {
+      cap *= 2;
+    }
+    char *grown = ops->calloc(cap, sizeof(*grown));
+    if (grown == NULL) {
+      errno = ENOMEM;
+      (void)fprintf(stderr, "%s: error: memory allocation failed\n",
+                    PROJECT_NAME);
+      return -1;
+    }
+    if (builder->names_len > 0) {
+      (void)memcpy(grown, builder->names, builder->names_len);
+    }
+    ops->free(builder->names);
+    builder->names = grown;
+    builder->names_cap = cap;
+  }
+
+  (void)memcpy(builder->names + builder->names_len, owner, owner_len);
+  builder->entries[builder->len] = (struct subid_index_entry){
+      .start = start,
+      .count = count,
+      .owner = (uint32_t)builder->names_len,
+      .seq = (uint32_t)builder->len,
+      .next = INDEX_NONE,
+  };
+  builder->names_len += owner_len;
+  builder->len++;
+  return 0;
+}
+
+/**
+ * builder_free - Release a builder's memory
+ * @ops: Operations structure (needed for free)
+ * @builder: Builder
+ */
+static void builder_free(const struct syscall_ops *ops,
+                         struct index_builder *builder) {
+  ops->free(builder->entries);
+  ops->free(builder->names);
+  *builder = (struct index_builder){0};
+}
+
+/**
+ * builder_read - Collect every entry of a database
+ * @ops: Operations structure for system call abstraction
+ * @db_path: Database path
+ * @builder: Builder, empty
+ * @st: Set to fstat() of the database as it was read
+ * @debug: Enable debug output
+ *
+ * Return: 0 on success, -1 on error (errno ENOENT if there is no database)
+ */
+static int builder_read(const struct syscall_ops *ops, const char *db_path,
+                        struct index_builder *builder, struct stat *st,
+                        bool debug) {
+  FILE *fp = subid_db_open(ops, db_path, debug);
+  if (fp == NULL) {
+    return -1;
+  }
+
+  if (ops->fstat(fileno(fp), st) != 0) {
+    int saved_errno = errno;
+    (void)ops->fclose(fp);
+    errno = saved_errno;
+    return -1;
+  }
+
+  char line[MAX_LINE_LEN] = {0};
+  const char *owner = NULL;
+  uint32_t start = 0;
+  uint32_t count = 0;
+  int ret = 0;
+  while (ret == 0 && subid_db_read_entry(ops, fp, db_path, line, sizeof(line),
+                                         &owner, &start, &count, debug) == 1) {
+    ret = builder_add(ops, builder, owner, start, count);
+  }
+
+  int saved_errno = errno;
+  (void)ops->fclose(fp);
+  errno = saved_errno;
+  return ret;
+}
+
+/**
+ * compare_entries - qsort() comparator ordering entries by start
+ * @a: First entry
+ * @b: Second entry
+ *
+ * Ties keep file order, so the sort is deterministic.
+ *
+ * Return: <0, 0 or >0 like strcmp()
+ */
+static int compare_entries(const void *a, const void *b) {
+  const struct subid_index_entry *x = a;
+  const struct subid_index_entry *y = b;
+
+  if (x->start != y->start) {
+    return x->start < y->start ? -1 : 1;
+  }
+  return x->seq < y->seq ? -1 : x->seq > y->seq ? 1 : 0;
+}
+
+/**
+ * builder_serialize - Lay out the index file in memory
+ * @ops: Operations structure (needed for calloc)
+ * @builder: Builder holding the database's entries, sorted here
+ * @st: fstat() of the database the entries came from
+ * @size: Set to the size of the returned buffer
+ *
+ * Return: calloc(3)ed file contents (caller frees), NULL on error
+ */
+static unsigned char *builder_serialize(const struct syscall_ops *ops,
+                                        struct index_builder *builder,
+                                        const struct stat *st, size_t *size) {
+  uint32_t buckets = 1;
+  while (buckets < builder->len) {
+    buckets *= 2;
+  }
+
+  struct subid_index_header header = {
+      .magic = INDEX_MAGIC,
+      .version = INDEX_VERSION,
+      .db_dev = (uint64_t)st->st_dev,
+      .db_ino = (uint64_t)st->st_ino,
+      .db_size = (int64_t)st->st_size,
+      .db_mtime_sec = (int64_t)st->st_mtim.tv_sec,
+      .db_mtime_nsec = (int64_t)st->st_mtim.tv_nsec,
+      .db_ctime_sec = (int64_t)st->st_ctim.tv_sec,
+      .db_ctime_nsec = (int64_t)st->st_ctim.tv_nsec,
+      .entries = (uint32_t)builder->len,
+      .buckets = buckets,
+      .names_size = (uint32_t)builder->names_len,
+      .reserved = 0,
+      .checksum = 0,
+  };
+  header.checksum = header_checksum(&header);
+
+  *size = index_file_size(&header);
+  unsigned char *data = ops->calloc(*size, sizeof(*data));
+  uint32_t *by_seq = ops->calloc(builder->len + 1, sizeof(*by_seq));
+  if (data == NULL || by_seq == NULL) {
+    ops->free(data);
+    ops->free(by_seq);
+    errno = ENOMEM;
+    (void)fprintf(stderr, "%s: error: memory allocation failed\n",
+                  PROJECT_NAME);
+    return NULL;
+  }
+
+  if (builder->len > 0) {
+    qsort(builder->entries, builder->len, sizeof(*builder->entries),
+          compare_entries);
+  }
+
+  for (size_t i = 0; i < builder->len; i++) {
+    by_seq[builder->entries[i].seq] = (uint32_t)i;
+  }
+
+  (void)memcpy(data, &header, sizeof(header));
+  struct subid_index_entry *entries =
+      (struct subid_index_entry *)(data + sizeof(header));
+  uint32_t *heads = (uint32_t *)(entries + builder->len);
+  char *names = (char *)(heads + buckets);
+  for (uint32_t i = 0; i < buckets; i++) {
+    heads[i] = INDEX_NONE;
+  }
+
+  /* Prepend in reverse file order so every chain ends up in file order */
+  for (size_t seq = builder->len; seq > 0; seq--) {
+    struct subid_index_entry *entry = &builder->entries[by_seq[seq - 1]];
+    uint32_t bucket = owner_bucket(builder->names + entry->owner, buckets);
+    entry->next = heads[bucket];
+    heads[bucket] = by_seq[seq - 1];
+  }
+
+  if (builder->len > 0) {
+    (void)memcpy(entries, builder->entries,
+                 builder->len * sizeof(*builder->entries));
+    (void)memcpy(names, builder->names, builder->names_len);
+  }
+
+  ops->free(by_seq);
+  return data;
+}
+
+/**
+ * write_all - Write a whole buffer, retrying short writes
+ * @ops: Operations structure for system call abstraction
+ * @fd: Descriptor
+ * @data: Buffer
+ * @size: Bytes to write
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int write_all(const struct syscall_ops *ops, int fd,
+                     const unsigned char *data, size_t size) {
+  while (size > 0) {
+    ssize_t written = ops->write(fd, data, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    // LCOV_EXCL_START
+    if (written == 0) {
+      errno = EIO;
+      return -1;
+    }
+    // LCOV_EXCL_STOP
+    data += written;
+    size -= (size_t)written;
+  }
+  return 0;
+}
+
+/**
+ * index_store - Replace the index file atomically
+ * @ops: Operations structure for system call abstraction
+ * @dir: Index directory
+ * @db_path: Database the index describes
+ * @data: File contents
+ * @size: Size of @data
+ * @debug: Enable debug output
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int index_store(const struct syscall_ops *ops, const char *dir,
+                       const char *db_path, const unsigned char *data,
+                       size_t size, bool debug) {
+  char path[PATH_MAX] = {0};
+  char tmppath[PATH_MAX] = {0};
+  if (index_path(path, sizeof(path), dir, db_path, false) != 0 ||
+      index_path(tmppath, sizeof(tmppath), dir, db_path, true) != 0) {
+    return -1;
+  }
+
+  int fd = ops->open(tmppath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC |
+                                  O_NOFOLLOW,
+                     0644);
+  if (fd < 0) {
+    if (debug) {
+      (void)fprintf(stderr, "%s: debug: cannot create %s: %s\n", PROJECT_NAME,
+                    tmppath, strerror(errno));
+    }
+    return -1;
+  }
+
+  int ret = write_all(ops, fd, data, size);
+  if (ret == 0) {
+    ret = ops->fsync(fd);
+  }
+  int saved_errno = errno;
+  if (ops->close(fd) != 0 && ret == 0) {
+    ret = -1;
+    saved_errno = errno;
+  }
+  if (ret == 0 && ops->rename(tmppath, path) != 0) {
+    ret = -1;
+    saved_errno = errno;
+  }
+
+  if (ret != 0) {
+    (void)ops->unlink(tmppath);
+    if (debug) {
+      (void)fprintf(stderr, "%s: debug: cannot write %s: %s\n", PROJECT_NAME,
+                    path, strerror(saved_errno));
+    }
+    errno = saved_errno;
+    return -1;
+  }
+
+  if (debug) {
+    (void)fprintf(stderr, "%s: debug: wrote index %s\n", PROJECT_NAME, path);
+  }
+  return 0;
+}
+
+/**
+ * subid_index_refresh - Rebuild the index of a database if it is stale
+ * @ops: Operations structure for system call abstraction
+ * @dir: Index directory (SUBID_INDEX_DIR)
+ * @db_path: Database to index
+ * @debug: Enable debug output
+ *
+ * Called by the native writer with the database still locked, and after
+ * usermod(8) has replaced it. The index records the identity of the file
+ * it was read from, so a rebuild racing another writer only leaves an
+ * index readers ignore as stale. A missing
+ * @dir means indexes are not wanted and is not an error; @dir is never
+ * created here. An index that is already current is left alone. The
+ * index is an optimisation only, so failures are reported under @debug
+ * alone and readers fall back to the database.
+ *
+ * Return: 0 on success (including nothing to do), -1 on error
+ */
+int subid_index_refresh(const struct syscall_ops *ops, const char *dir,
+                        const char *db_path, bool debug) {
+  if (ops == NULL || dir == NULL || db_path == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  struct stat dir_st = {0};
+  if (ops->stat(dir, &dir_st) != 0 || !S_ISDIR(dir_st.st_mode)) {
+    if (debug) {
+      (void)fprintf(stderr, "%s: debug: %s missing, not indexing %s\n",
+                    PROJECT_NAME, dir, db_path);
+    }
+    return 0;
+  }
+
+  subid_index_t current = {0};
+  if (subid_index_open(ops, dir, db_path, &current, false) == 1) {
+    subid_index_close(ops, &current);
+    return 0;
+  }
+
+  struct index_builder builder = {0};
+  struct stat st = {0};
+  if (builder_read(ops, db_path, &builder, &st, debug) != 0) {
+    int saved_errno = errno;
+    builder_free(ops, &builder);
+    if (debug) {
+      (void)fprintf(stderr, "%s: debug: cannot index %s: %s\n", PROJECT_NAME,
+                    db_path, strerror(saved_errno));
+    }
+    errno = saved_errno;
+    return -1;
+  }
+
+  size_t size = 0;
+  unsigned char *data = builder_serialize(ops, &builder, &st, &size);
+  builder_free(ops, &builder);
+  if (data == NULL) {
+    return -1;
+  }
+
+  int ret = index_store(ops, dir, db_path, data, size, debug);
+  int saved_errno = errno;
+  ops->free(data);
+  errno = saved_errno;
+  return ret;
+}
@@ -0,0 +1,1023 @@
+/**
+ * subid_write.c - Native locked writer for the subordinate ID databases
+ *
+ * Records new ranges in /etc/subuid and /etc/subgid without spawning
+ * usermod(8) (SUBID_WRITER files). The shadow-utils locking protocol is
+ * followed so usermod, useradd and this writer exclude each other:
+ *
+ * 1. lckpwdf(3), the global shadow lock
+ * 2. <db>.lock, a per-file lock created exclusively and holding our PID
+ *
+ * The database is then copied to <db>+ with the new entries appended,
+ * fsync'ed and renamed over the original, so readers only ever see the
+ * complete old or the complete new file. Entries that are already present
+ * are not added again, matching usermod's behaviour for identical ranges.
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Room for any pid_t in decimal plus NUL */
+enum { PID_STR_MAX = 24 };
+
+/* One retry after removing a stale lock, then give up like usermod does */
+enum { LOCK_ATTEMPTS = 2 };
+
+/* Initial capacity of a subid_entry_list_t */
+enum { TXN_INITIAL_CAP = 16 };
+
+/* Mode for a database created from scratch (matches shadow-utils) */
+#define SUBID_DB_DEFAULT_MODE 0644
+
+/**
+ * struct pending_index_t - Hash index over pending entries by owner
+ * @slots: Open-addressed table of chain heads (entry index + 1, 0 = empty)
+ * @next: Per-entry chain link to the next entry with the same owner
+ * @mask: Table size - 1 (table size is a power of two)
+ *
+ * Lets the rewrite compare every existing line against all pending entries
+ * in O(1) so a batch costs one pass over the file regardless of size.
+ */
+typedef struct {
+  size_t *slots;
+  size_t *next;
+  size_t mask;
+} pending_index_t;
+
+/*
+ * Forward declarations for internal functions
+ *
+ * We can use nonnull on static functions because they can only be called
+ * from inside here and we're careful to check the pointers in our visible
+ * function(s).
+ */
+static int build_path(char *out, size_t size, const char *path,
+                      const char *suffix) __attribute__((nonnull(1, 3, 4)))
+__attribute__((warn_unused_result));
+static bool lock_is_stale(const struct syscall_ops *ops, const char *lockpath)
+    __attribute__((nonnull(1, 2))) __attribute__((warn_unused_result));
+static int index_init(const struct syscall_ops *ops, pending_index_t *idx,
+                      const subid_entry_t *entries, size_t n, bool *present)
+    __attribute__((nonnull(1, 2, 3, 5))) __attribute__((warn_unused_result));
+static size_t *index_find(const pending_index_t *idx,
+                          const subid_entry_t *entries, const char *owner)
+    __attribute__((nonnull(1, 2, 3))) __attribute__((warn_unused_result));
+static void index_mark(const pending_index_t *idx,
+                       const subid_entry_t *entries, const char *owner,
+                       uint32_t start, uint32_t count, bool *present)
+    __attribute__((nonnull(1, 2, 3, 6)));
+static void index_free(const struct syscall_ops *ops, pending_index_t *idx)
+    __attribute__((nonnull));
+static void sync_parent_dir(const struct syscall_ops *ops, const char *path,
+                            bool debug) __attribute__((nonnull(1, 2)));
+static int write_error(const char *what, const char *path)
+    __attribute__((nonnull(1, 2)));
+static int open_original(const struct syscall_ops *ops, const char *path,
+                         struct stat *st, FILE **in)
+    __attribute__((nonnull(1, 2, 3, 4))) __attribute__((warn_unused_result));
+static int create_tmp(const struct syscall_ops *ops, const char *path,
+                      const char *tmppath, const struct stat *st, FILE **out)
+    __attribute__((nonnull(1, 2, 3, 4, 5))) __attribute__((warn_unused_result));
+static int copy_existing(const struct syscall_ops *ops, const char *path,
+                         FILE *in, FILE *out, const pending_index_t *idx,
+                         const subid_entry_t *entries, bool *present,
+                         bool *ends_with_newline)
+    __attribute__((nonnull(1, 2, 4, 5, 6, 7, 8)))
+    __attribute__((warn_unused_result));
+static int append_missing(FILE *out, const char *path,
+                          const subid_entry_t *entries, size_t n,
+                          const bool *present, bool ends_with_newline,
+                          bool debug, size_t *appended)
+    __attribute__((nonnull(1, 2, 3, 5, 8))) __attribute__((warn_unused_result));
+static int install_tmp(const struct syscall_ops *ops, FILE *out,
+                       const char *path, const char *tmppath)
+    __attribute__((nonnull(1, 2, 3, 4))) __attribute__((warn_unused_result));
+static int txn_list_append(const struct syscall_ops *ops,
+                           subid_entry_list_t *list, const char *owner,
+                           uint32_t start, uint32_t count)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static void txn_list_clear(const struct syscall_ops *ops,
+                           subid_entry_list_t *list)
+    __attribute__((nonnull(1, 2)));
+static void txn_list_truncate(const struct syscall_ops *ops,
+                              subid_entry_list_t *list, size_t len)
+    __attribute__((nonnull(1, 2)));
+
+/**
+ * build_path - Append a suffix to a database path
+ * @out: Output buffer
+ * @size: Size of @out
+ * @path: Database path
+ * @suffix: Suffix (".lock" or "+")
+ *
+ * Return: 0 on success, -1 if the result does not fit (errno ENAMETOOLONG)
+ */
+static int build_path(char *out, size_t size, const char *path,
+                      const char *suffix) {
+  int ret = snprintf(out, size, "%s%s", path, suffix);
+  if (ret < 0 || (size_t)ret >= size) {
+    errno = ENAMETOOLONG;
+    (void)fprintf(stderr, "%s: error: path too long: %s%s\n", PROJECT_NAME,
+                  path, suffix);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * lock_is_stale - Check whether an existing lock file's owner is gone
+ * @ops: Operations structure for system call abstraction
+ * @lockpath: Lock file path
+ *
+ * A lock is stale when it holds a valid PID for which kill(pid, 0) reports
+ * ESRCH, the same test shadow-utils applies. A lock that disappeared while
+ * we looked also counts, so the caller simply retries. Anything we cannot
+ * interpret is treated as held.
+ *
+ * Return: true if the lock may be removed
+ */
+static bool lock_is_stale(const struct syscall_ops *ops, const char *lockpath) {
+  int fd = ops->open(lockpath, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+  if (fd < 0) {
+    return errno == ENOENT;
+  }
+
+  char buf[PID_STR_MAX] = {0};
+  ssize_t len = ops->read(fd, buf, sizeof(buf) - 1);
+  (void)ops->close(fd);
+  if (len <= 0) {
+    return false;
+  }
+  buf[len] = '\0';
+
+  uint32_t pid = 0;
+  if (parse_uint32_strict(normalize_config_line(buf), &pid) != 0 || pid == 0 ||
+      pid > INT_MAX) {
+    return false;
+  }
+
+  if (ops->kill((pid_t)pid, 0) == 0) {
+    return false;
+  }
+  return errno == ESRCH;
+}
+
+/**
+ * subid_db_lock - Take the shadow-utils per-file lock on a database
+ * @ops: Operations structure for system call abstraction
+ * @path: Database path; the lock is @path with ".lock" appended
+ * @debug: Enable debug output
+ *
+ * The caller is expected to hold lckpwdf(3) already. Fails instead of
+ * waiting when another live process holds the lock, as usermod does.
+ *
+ * Return: 0 on success, -1 on error (EBUSY if held by another process)
+ */
+int subid_db_lock(const struct syscall_ops *ops, const char *path,
+                  bool debug) {
+  if (ops == NULL || path == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: NULL parameter in subid_db_lock\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  char lockpath[PATH_MAX] = {0};
+  if (build_path(lockpath, sizeof(lockpath), path, ".lock") != 0) {
+    return -1;
+  }
+
+  char pid_str[PID_STR_MAX] = {0};
+  int pid_len = snprintf(pid_str, sizeof(pid_str), "%ld", (long)getpid());
+  // LCOV_EXCL_START
+  if (pid_len < 0 || (size_t)pid_len >= sizeof(pid_str)) {
+    errno = EINVAL;
+    return -1;
+  }
+  // LCOV_EXCL_STOP
+
+  for (int attempt = 0; attempt < LOCK_ATTEMPTS; attempt++) {
+    int fd = ops->open(lockpath, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC |
+                                     O_NOFOLLOW,
+                       0600);
+    if (fd >= 0) {
+      ssize_t written = ops->write(fd, pid_str, (size_t)pid_len);
+      int saved_errno = errno;
+      if (ops->close(fd) != 0 && written == pid_len) {
+        written = -1;
+        saved_errno = errno;
+      }
+      if (written != pid_len) {
+        (void)ops->unlink(lockpath);
+        errno = written < 0 ? saved_errno : EIO;
+        (void)fprintf(stderr, "%s: error: cannot write lock file %s: %s\n",
+                      PROJECT_NAME, lockpath, strerror(errno));
+        return -1;
+      }
+
+      if (debug) {
+        (void)fprintf(stderr, "%s: debug: locked %s\n", PROJECT_NAME, path);
+      }
+      return 0;
+    }
+
+    if (errno != EEXIST) {
+      int saved_errno = errno;
+      (void)fprintf(stderr, "%s: error: cannot create lock file %s: %s\n",
+                    PROJECT_NAME, lockpath, strerror(saved_errno));
+      errno = saved_errno;
+      return -1;
+    }
+
+    if (!lock_is_stale(ops, lockpath)) {
+      break;
+    }
+
+    if (debug) {
+      (void)fprintf(stderr, "%s: debug: removing stale lock %s\n",
+                    PROJECT_NAME, lockpath);
+    }
+    if (ops->unlink(lockpath) != 0 && errno != ENOENT) {
+      int saved_errno = errno;
+      (void)fprintf(stderr, "%s: error: cannot remove stale lock %s: %s\n",
+                    PROJECT_NAME, lockpath, strerror(saved_errno));
+      errno = saved_errno;
+      return -1;
+    }
+  }
+
+  errno = EBUSY;
+  (void)fprintf(stderr,
+                "%s: error: %s is locked by another process, try again "
+                "later\n",
+                PROJECT_NAME, path);
+  return -1;
+}
+
+/**
+ * subid_db_unlock - Release a lock taken by subid_db_lock()
+ * @ops: Operations structure for system call abstraction
+ * @path: Database path
+ * @debug: Enable debug output
+ */
+void subid_db_unlock(const struct syscall_ops *ops, const char *path,
+                     bool debug) {
+  if (ops == NULL || path == NULL) {
+    return;
+  }
+
+  char lockpath[PATH_MAX] = {0};
+  if (build_path(lockpath, sizeof(lockpath), path, ".lock") != 0) {
+    return;
+  }
+
+  if (ops->unlink(lockpath) != 0) {
+    (void)fprintf(stderr, "%s: warning: cannot remove lock file %s: %s\n",
+                  PROJECT_NAME, lockpath, strerror(errno));
+    return;
+  }
+
+  if (debug) {
+    (void)fprintf(stderr, "%s: debug: unlocked %s\n", PROJECT_NAME, path);
+  }
+}
+
+/**
+ * index_init - Build the owner index and drop duplicate pending entries
+ * @ops: Operations structure (needed for calloc)
+ * @idx: Index to initialize
+ * @entries: Pending entries
+ * @n: Number of entries (> 0)
+ * @present: Per-entry flags; duplicates of an earlier entry are set true
+ *
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int index_init(const struct syscall_ops *ops, pending_index_t *idx,
+                      const subid_entry_t *entries, size_t n, bool *present) {
+  size_t size = 1;
+  while (size < n * 2) {
+    size <<= 1;
+  }
+
+  *idx = (pending_index_t){0};
+  idx->slots = ops->calloc(size, sizeof(*idx->slots));
+  idx->next = ops->calloc(n, sizeof(*idx->next));
+  if (idx->slots == NULL || idx->next == NULL) {
+    index_free(ops, idx);
+    errno = ENOMEM;
+    (void)fprintf(stderr, "%s: error: memory allocation failed\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+  idx->mask = size - 1;
+
+  for (size_t i = 0; i < n; i++) {
+    size_t *slot = index_find(idx, entries, entries[i].owner);
+
+    for (size_t j = *slot; j != 0; j = idx->next[j - 1]) {
+      if (entries[j - 1].start == entries[i].start &&
+          entries[j - 1].count == entries[i].count) {
+        present[i] = true;
+        break;
+      }
+    }
+    if (present[i]) {
+      continue;
+    }
+
+    idx->next[i] = *slot;
+    *slot = i + 1;
+  }
+
+  return 0;
+}
+
+/**
+ * index_find - Locate the slot for an owner
+ * @idx: Index
+ * @entries: Pending entries the index refers to
+ * @owner: Owner to look up
+ *
+ * Return: Slot holding @owner's chain head, or the empty slot where it
+ *         would be inserted
+ */
+static size_t *index_find(const pending_index_t *idx,
+                          const subid_entry_t *entries, const char *owner) {
+  size_t pos = (size_t)hash_fnv1a(owner, strlen(owner), FNV1A_64_INIT) &
+               idx->mask;
+
+  while (idx->slots[pos] != 0 &&
+         strcmp(entries[idx->slots[pos] - 1].owner, owner) != 0) {
+    pos = (pos + 1) & idx->mask;
+  }
+
+  return &idx->slots[pos];
+}
+
+/**
+ * index_mark - Flag pending entries matching an existing database line
+ * @idx: Index
+ * @entries: Pending entries
+ * @owner: Owner field of the existing line
+ * @start: Start of the existing range
+ * @count: Count of the existing range
+ * @present: Per-entry flags to update
+ */
+static void index_mark(const pending_index_t *idx,
+                       const subid_entry_t *entries, const char *owner,
+                       uint32_t start, uint32_t count, bool *present) {
+  const size_t *slot = index_find(idx, entries, owner);
+
+  for (size_t j = *slot; j != 0; j = idx->next[j - 1]) {
+    if (entries[j - 1].start == start && entries[j - 1].count == count) {
+      present[j - 1] = true;
+    }
+  }
+}
+
+/**
+ * index_free - Release index storage
+ * @ops: Operations structure (needed for free)
+ * @idx: Index
+ */
+static void index_free(const struct syscall_ops *ops, pending_index_t *idx) {
+  ops->free(idx->slots);
+  ops->free(idx->next);
+  *idx = (pending_index_t){0};
+}
+
+/**
+ * sync_parent_dir - fsync the directory containing @path
+ * @ops: Operations structure for system call abstraction
+ * @path: File whose directory entry changed
+ * @debug: Enable debug output
+ *
+ * Makes the rename durable. The new file is already in place when this
+ * runs, so failures are only warnings.
+ */
+static void sync_parent_dir(const struct syscall_ops *ops, const char *path,
+                            bool debug) {
+  char dir[PATH_MAX] = {0};
+  int ret = snprintf(dir, sizeof(dir), "%s", path);
+  // LCOV_EXCL_START
+  if (ret < 0 || (size_t)ret >= sizeof(dir)) {
+    return;
+  }
+  // LCOV_EXCL_STOP
+
+  char *slash = strrchr(dir, '/');
+  if (slash == NULL) {
+    (void)snprintf(dir, sizeof(dir), ".");
+  } else if (slash == dir) {
+    dir[1] = '\0';
+  } else {
+    *slash = '\0';
+  }
+
+  int fd = ops->open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0 || ops->fsync(fd) != 0) {
+    (void)fprintf(stderr, "%s: warning: cannot sync directory %s: %s\n",
+                  PROJECT_NAME, dir, strerror(errno));
+  } else if (debug) {
+    (void)fprintf(stderr, "%s: debug: synced directory %s\n", PROJECT_NAME,
+                  dir);
+  }
+
+  if (fd >= 0) {
+    (void)ops->close(fd);
+  }
+}
+
+/**
+ * write_error - Report a failed step of a database rewrite
+ * @what: Step that failed, phrased to read "cannot <what> <path>"
+ * @path: Database path
+ *
+ * errno is preserved for the caller.
+ *
+ * Return: -1, for tail calls
+ */
+static int write_error(const char *what, const char *path) {
+  int saved_errno = errno;
+  (void)fprintf(stderr, "%s: error: cannot %s %s: %s\n", PROJECT_NAME, what,
+                path, strerror(saved_errno));
+  errno = saved_errno;
+  return -1;
+}
+
+/**
+ * open_original - Open the database about to be rewritten
+ * @ops: Operations structure for system call abstraction
+ * @path: Database path
+ * @st: Set to the file's attributes; left alone if it does not exist
+ * @in: Set to the open stream, or NULL if the database does not exist
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int open_original(const struct syscall_ops *ops, const char *path,
+                         struct stat *st, FILE **in) {
+  *in = NULL;
+
+  int fd = ops->open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return errno == ENOENT ? 0 : write_error("open", path);
+  }
+
+  if (ops->fstat(fd, st) != 0) {
+    (void)write_error("fstat", path);
+    (void)ops->close(fd);
+    return -1;
+  }
+
+  if (!S_ISREG(st->st_mode)) {
+    (void)ops->close(fd);
+    errno = EBADF;
+    return write_error("rewrite non-regular file", path);
+  }
+
+  *in = ops->fdopen(fd, "r");
+  if (*in == NULL) {
+    (void)write_error("fdopen", path);
+    (void)ops->close(fd);
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * create_tmp - Create <db>+ with the original's owner and mode
+ * @ops: Operations structure for system call abstraction
+ * @path: Database path
+ * @tmppath: Temporary file path
+ * @st: Attributes to copy
+ * @out: Set to the stream for the new contents
+ *
+ * A leftover <db>+ can only come from a writer that died holding the lock,
+ * so it is removed first. The file is created 0600 and only opened up to
+ * the original mode once it belongs to the original owner.
+ *
+ * Return: 0 on success, -1 on error (nothing left behind)
+ */
+static int create_tmp(const struct syscall_ops *ops, const char *path,
+                      const char *tmppath, const struct stat *st, FILE **out) {
+  *out = NULL;
+
+  if (ops->unlink(tmppath) != 0 && errno != ENOENT) {
+    return write_error("remove stale temporary file for", path);
+  }
+
+  int fd = ops->open(tmppath, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC |
+                                  O_NOFOLLOW,
+                     0600);
+  if (fd < 0) {
+    return write_error("create temporary file for", path);
+  }
+
+  if (ops->fchown(fd, st->st_uid, st->st_gid) != 0 ||
+      ops->fchmod(fd, st->st_mode & 07777) != 0) {
+    (void)write_error("set owner and mode of temporary file for", path);
+  } else if ((*out = ops->fdopen(fd, "w")) == NULL) {
+    (void)write_error("fdopen temporary file for", path);
+  } else {
+    /* fd now owned by *out, don't close fd! */
+    return 0;
+  }
+
+  int saved_errno = errno;
+  (void)ops->close(fd);
+  (void)ops->unlink(tmppath);
+  errno = saved_errno;
+  return -1;
+}
+
+/**
+ * copy_existing - Copy the current database and note entries already in it
+ * @ops: Operations structure for system call abstraction
+ * @path: Database path
+ * @in: Current database, may be NULL if it does not exist
+ * @out: New contents
+ * @idx: Index over the pending entries
+ * @entries: Pending entries
+ * @present: Per-entry flags set for entries found in @in
+ * @ends_with_newline: Set to whether the copy ends with a newline
+ *
+ * Lines are copied byte for byte, including comments and lines this tool
+ * cannot parse, so the rewrite never loses anything shadow-utils wrote.
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int copy_existing(const struct syscall_ops *ops, const char *path,
+                         FILE *in, FILE *out, const pending_index_t *idx,
+                         const subid_entry_t *entries, bool *present,
+                         bool *ends_with_newline) {
+  *ends_with_newline = true;
+  if (in == NULL) {
+    return 0;
+  }
+
+  char line[MAX_LINE_LEN] = {0};
+  char scratch[MAX_LINE_LEN] = {0};
+  bool continuation = false;
+  while (ops->fgets(line, sizeof(line), in) != NULL) {
+    size_t len = strlen(line);
+    bool complete = len > 0 && line[len - 1] == '\n';
+
+    if (fputs(line, out) == EOF) {
+      return write_error("write temporary file for", path);
+    }
+    *ends_with_newline = complete;
+
+    /* Tail of an overlong line: copied, never matched */
+    if (continuation) {
+      continuation = !complete;
+      continue;
+    }
+    if (!complete && len == sizeof(line) - 1) {
+      continuation = true;
+      continue;
+    }
+
+    memcpy(scratch, line, len + 1);
+    const char *owner = NULL;
+    uint32_t start = 0;
+    uint32_t count = 0;
+    if (subid_db_parse_line(scratch, &owner, &start, &count) == 0) {
+      index_mark(idx, entries, owner, start, count, present);
+    }
+  }
+
+  if (ferror(in)) {
+    errno = EIO;
+    return write_error("read", path);
+  }
+
+  return 0;
+}
+
+/**
+ * append_missing - Append pending entries not already in the database
+ * @out: New contents
+ * @path: Database path
+ * @entries: Pending entries
+ * @n: Number of entries
+ * @present: Per-entry flags from index_init() and copy_existing()
+ * @ends_with_newline: Whether the copy so far ends with a newline
+ * @debug: Enable debug output
+ * @appended: Set to the number of entries written
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int append_missing(FILE *out, const char *path,
+                          const subid_entry_t *entries, size_t n,
+                          const bool *present, bool ends_with_newline,
+                          bool debug, size_t *appended) {
+  *appended = 0;
+
+  for (size_t i = 0; i < n; i++) {
+    if (present[i]) {
+      continue;
+    }
+
+    /* Don't glue our entry onto an unterminated last line */
+    if (!ends_with_newline && fputc('\n', out) == EOF) {
+      return write_error("write temporary file for", path);
+    }
+    ends_with_newline = true;
+
+    if (fprintf(out, "%s:%u:%u\n", entries[i].owner, entries[i].start,
+                entries[i].count) < 0) {
+      return write_error("write temporary file for", path);
+    }
+    (*appended)++;
+
+    if (debug) {
+      (void)fprintf(stderr, "%s: debug: %s: adding %s:%u:%u\n", PROJECT_NAME,
+                    path, entries[i].owner, entries[i].start,
+                    entries[i].count);
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * install_tmp - Make <db>+ durable and rename it over the database
+ * @ops: Operations structure for system call abstraction
+ * @out: New contents, always closed
+ * @path: Database path
+ * @tmppath: Temporary file path, removed on failure
+ *
+ * Return: 0 on success, -1 on error (database unchanged)
+ */
+static int install_tmp(const struct syscall_ops *ops, FILE *out,
+                       const char *path, const char *tmppath) {
+  int ret = 0;
+
+  if (fflush(out) != 0 || ferror(out)) {
+    ret = write_error("write temporary file for", path);
+  } else if (ops->fsync(fileno(out)) != 0) {
+    ret = write_error("fsync temporary file for", path);
+  }
+
+  if (ops->fclose(out) != 0 && ret == 0) {
+    ret = write_error("close temporary file for", path);
+  }
+
+  if (ret == 0 && ops->rename(tmppath, path) != 0) {
+    ret = write_error("rename temporary file over", path);
+  }
+
+  if (ret != 0) {
+    int saved_errno = errno;
+    (void)ops->unlink(tmppath);
+    errno = saved_errno;
+  }
+
+  return ret;
+}
+
+/**
+ * subid_db_rewrite - Atomically add entries to a locked database
+ * @ops: Operations structure for system call abstraction
+ * @path: Database path (SUBUID_PATH or SUBGID_PATH)
+ * @entries: Entries to add
+ * @n: Number of entries
+ * @debug: Enable debug output
+ *
+ * The caller must hold the locks (lckpwdf and subid_db_lock()). Existing
+ * lines are copied verbatim, then every entry not already present is
+ * appended. The copy keeps the original's owner and mode; a database that
+ * does not exist yet is created root-owned with mode 0644. When nothing
+ * needs adding the database is left untouched.
+ *
+ * Return: 0 on success, -1 on error (database unchanged)
+ */
+int subid_db_rewrite(const struct syscall_ops *ops, const char *path,
+                     const subid_entry_t *entries, size_t n, bool debug) {
+  if (ops == NULL || path == NULL || (entries == NULL && n > 0)) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: NULL parameter in subid_db_rewrite\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+  if (n == 0) {
+    return 0;
+  }
+
+  char tmppath[PATH_MAX] = {0};
+  if (build_path(tmppath, sizeof(tmppath), path, "+") != 0) {
+    return -1;
+  }
+
+  bool *present = ops->calloc(n, sizeof(*present));
+  if (present == NULL) {
+    errno = ENOMEM;
+    (void)fprintf(stderr, "%s: error: memory allocation failed\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  pending_index_t idx = {0};
+  if (index_init(ops, &idx, entries, n, present) != 0) {
+    ops->free(present);
+    return -1;
+  }
+
+  struct stat st = {.st_mode = S_IFREG | SUBID_DB_DEFAULT_MODE};
+  FILE *in = NULL;
+  FILE *out = NULL;
+  bool ends_with_newline = true;
+  size_t appended = 0;
+
+  int ret = open_original(ops, path, &st, &in);
+  if (ret == 0) {
+    ret = create_tmp(ops, path, tmppath, &st, &out);
+  }
+  if (ret == 0) {
+    ret = copy_existing(ops, path, in, out, &idx, entries, present,
+                        &ends_with_newline);
+  }
+  if (ret == 0) {
+    ret = append_missing(out, path, entries, n, present, ends_with_newline,
+                         debug, &appended);
+  }
+
+  if (in != NULL) {
+    (void)ops->fclose(in);
+  }
+
+  if (ret == 0 && appended > 0) {
+    ret = install_tmp(ops, out, path, tmppath);
+    if (ret == 0) {
+      sync_parent_dir(ops, path, debug);
+    }
+  } else if (out != NULL) {
+    int saved_errno = errno;
+    (void)ops->fclose(out);
+    (void)ops->unlink(tmppath);
+    errno = saved_errno;
+
+    if (ret == 0 && debug) {
+      (void)fprintf(stderr, "%s: debug: %s: all entries already present\n",
+                    PROJECT_NAME, path);
+    }
+  }
+
+  index_free(ops, &idx);
+  ops->free(present);
+  return ret;
+}
+
+/**
+ * subid_txn_add - Queue a range for the native writer
+ * @ops: Operations structure (needed for calloc)
+ * @txn: Transaction to add to
+ * @mode: SUBUID or SUBGID
+ * @owner: Username (copied)
+ * @start: First subordinate ID
+ * @count: Number of subordinate IDs
+ *
+ * Return: 0 on success, -1 on error
+ */
+int subid_txn_add(const struct syscall_ops *ops, subid_txn_t *txn,
+                  subid_mode_t mode, const char *owner, uint32_t start,
+                  uint32_t count) {
+  if (ops == NULL || txn == NULL || owner == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: NULL parameter in subid_txn_add\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  subid_entry_list_t *list = NULL;
+  switch (mode) {
+  case SUBUID:
+    list = &txn->subuid;
+    break;
+  case SUBGID:
+    list = &txn->subgid;
+    break;
+  default:
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: invalid mode\n", PROJECT_NAME);
+    return -1;
+  }
+
+  /* Queued entries are freed at commit, after any request's arena */
+  arena_t *arena = arena_suspend();
+  int ret = txn_list_append(ops, list, owner, start, count);
+  arena_resume(arena);
+  return ret;
+}
+
+/**
+ * txn_list_append - Copy one entry onto a transaction list
+ * @ops: Operations structure (needed for calloc)
+ * @list: List to grow
+ * @owner: Username (copied)
+ * @start: First subordinate ID
+ * @count: Number of subordinate IDs
+ *
+ * Return: 0 on success, -1 on error (message printed)
+ */
+static int txn_list_append(const struct syscall_ops *ops,
+                           subid_entry_list_t *list, const char *owner,
+                           uint32_t start, uint32_t count) {
+  if (list->len == list->cap) {
+    size_t cap = list->cap == 0 ? TXN_INITIAL_CAP : list->cap * 2;
+    subid_entry_t *grown = ops->calloc(cap, sizeof(*grown));
+    if (grown == NULL) {
+      errno = ENOMEM;
+      (void)fprintf(stderr, "%s: error: memory allocation failed\n",
+                    PROJECT_NAME);
+      return -1;
+    }
+    if (list->len > 0) {
+      memcpy(grown, list->entries, list->len * sizeof(*grown));
+    }
+    ops->free(list->entries);
+    list->entries = grown;
+    list->cap = cap;
+  }
+
+  size_t len = strlen(owner);
+  char *copy = ops->calloc(len + 1, sizeof(*copy));
+  if (copy == NULL) {
+    errno = ENOMEM;
+    (void)fprintf(stderr, "%s: error: memory allocation failed\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+  memcpy(copy, owner, len);
+
+  list->entries[list->len++] =
+      (subid_entry_t){.owner = copy, .start = start, .count = count};
+  return 0;
+}
+
+/**
+ * txn_list_clear - Free every entry in a list, keeping it usable
+ * @ops: Operations structure the entries were allocated through
+ * @list: List to clear
+ */
+static void txn_list_clear(const struct syscall_ops *ops,
+                           subid_entry_list_t *list) {
+  for (size_t i = 0; i < list->len; i++) {
+    ops->free(list->entries[i].owner);
+  }
+  ops->free(list->entries);
+  *list = (subid_entry_list_t){0};
+}
+
+/**
+ * txn_list_truncate - Drop entries past @len
+ * @ops: Operations structure the entries were allocated through
+ * @list: List to shorten
+ * @len: Number of entries to keep
+ */
+static void txn_list_truncate(const struct syscall_ops *ops,
+                              subid_entry_list_t *list, size_t len) {
+  while (list->len > len) {
+    list->len--;
+    ops->free(list->entries[list->len].owner);
+    list->entries[list->len].owner = NULL;
+  }
+}
+
+/**
+ * subid_txn_truncate - Discard entries queued after a known point
+ * @ops: Operations structure the entries were queued with
+ * @txn: Transaction
+ * @subuid_len: Number of subuid entries to keep
+ * @subgid_len: Number of subgid entries to keep
+ *
+ * Used to drop the ranges of a user whose enrollment failed part way.
+ */
+void subid_txn_truncate(const struct syscall_ops *ops, subid_txn_t *txn,
+                        size_t subuid_len, size_t subgid_len) {
+  if (ops == NULL || txn == NULL) {
+    return;
+  }
+
+  txn_list_truncate(ops, &txn->subuid, subuid_len);
+  txn_list_truncate(ops, &txn->subgid, subgid_len);
+}
+
+/**
+ * subid_txn_commit - Write every queued range under one set of locks
+ * @ops: Operations structure for system call abstraction
+ * @txn: Transaction to commit
+ * @debug: Enable debug output
+ *
+ * Takes lckpwdf(3) once, then locks, rewrites and unlocks each database
+ * that has queued entries. Each database is replaced atomically, but the
+ * two are independent: if the subgid rewrite fails after the subuid one
+ * succeeded, the subuid entries stay. Re-running is safe since entries
+ * that are already present are skipped.
+ *
+ * Each rewritten database also gets its index in SUBID_INDEX_DIR rebuilt
+ * before it is unlocked (see subid_index_refresh()).
+ *
+ * On success the queued entries are released and @txn can be reused.
+ *
+ * Return: 0 on success, -1 on error
+ */
+int subid_txn_commit(const struct syscall_ops *ops, subid_txn_t *txn,
+                     bool debug) {
+  if (ops == NULL || txn == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: NULL parameter in subid_txn_commit\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  if (txn->subuid.len == 0 && txn->subgid.len == 0) {
+    return 0;
+  }
+
+  uint64_t started = stats_now();
+  int locked = ops->lckpwdf();
+  stats_phase_add(STATS_LOCK, started);
+  if (locked != 0) {
+    int saved_errno = errno;
+    (void)fprintf(stderr,
+                  "%s: error: cannot lock the shadow databases: %s\n",
+                  PROJECT_NAME, strerror(saved_errno));
+    errno = saved_errno;
+    return -1;
+  }
+
+  const struct {
+    subid_mode_t mode;
+    subid_entry_list_t *list;
+  } dbs[] = {{SUBUID, &txn->subuid}, {SUBGID, &txn->subgid}};
+
+  int ret = 0;
+  for (size_t i = 0; i < sizeof(dbs) / sizeof(dbs[0]) && ret == 0; i++) {
+    if (dbs[i].list->len == 0) {
+      continue;
+    }
+
+    const char *path = subid_db_path(dbs[i].mode);
+    started = stats_now();
+    locked = subid_db_lock(ops, path, debug);
+    stats_phase_add(STATS_LOCK, started);
+    if (locked != 0) {
+      ret = -1;
+      break;
+    }
+    ret = subid_db_rewrite(ops, path, dbs[i].list->entries, dbs[i].list->len,
+                           debug);
+    if (ret == 0) {
+      (void)subid_index_refresh(ops, SUBID_INDEX_DIR, path, debug);
+    }
+    int saved_errno = errno;
+    subid_db_unlock(ops, path, debug);
+    errno = saved_errno;
+
+    if (ret == 0) {
+      txn_list_clear(ops, dbs[i].list);
+    }
+  }
+
+  int saved_errno = errno;
+  (void)ops->ulckpwdf();
+  errno = saved_errno;
+
+  if (ret == 0) {
+    txn->users = 0;
+  }
+  return ret;
+}
+
+/**
+ * subid_txn_free - Release all memory held by a transaction
+ * @ops: Operations structure the entries were queued with
+ * @txn: Transaction (may be NULL)
+ *
+ * Uncommitted entries are discarded.
+ */
+void subid_txn_free(const struct syscall_ops *ops, subid_txn_t *txn) {
+  if (ops == NULL || txn == NULL) {
+    return;
+  }
+
+  txn_list_clear(ops, &txn->subuid);
+  txn_list_clear(ops, &txn->subgid);
+  txn->users = 0;
+}
@@ -27,6 +27,8 @@
 #include <pwd.h>
 #include <spawn.h>
 #include <stdio.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
@@ -53,7 +55,7 @@
  *
  * Access members via pointer:
  *   ops->posix_spawn(...)
- *   ops->getpwuid(uid)
+ *   ops->getpwuid_r(uid, &pwd, buf, size, &result)
  *   ops->open(path, flags)
  */
 struct syscall_ops {
@@ -77,6 +79,67 @@ struct syscall_ops {
                  int (*filter)(const struct dirent *),
                  int (*compar)(const struct dirent **, const struct dirent **));
 
+  /*
+   * Drop-in directories are opened once and read with getdents64(2); each
+   * entry is then opened relative to that descriptor, so renaming the
+   * directory after it was checked cannot swap the files read from it.
+   */
+  int (*openat)(int dirfd, const char *pathname, int flags, ...);
+  ssize_t (*getdents64)(int fd, void *dirp, size_t count);
+
+  /*
+   * Database write operations
+   *
+   * WHY WE NEED THESE:
+   * The native subid writer (SUBID_WRITER files) takes the shadow-utils
+   * locks and replaces /etc/subuid and /etc/subgid atomically. Tests need
+   * to inject failures at every step (lock held, short write, fsync or
+   * rename failing) without touching the real databases.
+   *
+   * lckpwdf/ulckpwdf take the same global lock as shadow-utils; kill is
+   * only used with signal 0 to detect a stale per-file lock.
+   */
+  ssize_t (*read)(int fd, void *buf, size_t count);
+  ssize_t (*write)(int fd, const void *buf, size_t count);
+  int (*fsync)(int fd);
+  int (*fchown)(int fd, uid_t owner, gid_t group);
+  int (*fchmod)(int fd, mode_t mode);
+  int (*rename)(const char *oldpath, const char *newpath);
+  int (*unlink)(const char *pathname);
+  int (*kill)(pid_t pid, int sig);
+  int (*lckpwdf)(void);
+  int (*ulckpwdf)(void);
+
+  /*
+   * Stamp cache operations
+   *
+   * WHY WE NEED THESE:
+   * The optional stamp cache creates its directory under /run on first
+   * use. Tests point it at a private directory instead.
+   */
+  int (*mkdir)(const char *pathname, mode_t mode);
+
+  /*
+   * Daemon operations
+   *
+   * WHY WE NEED THESE:
+   * The daemon (--daemon) serves whichever UID the kernel reports for the
+   * connected peer through SO_PEERCRED. Tests substitute the credentials
+   * to exercise eligible and ineligible callers over a socketpair.
+   */
+  int (*getsockopt)(int sockfd, int level, int optname,
+                    void *restrict optval, socklen_t *restrict optlen);
+
+  /*
+   * Group commit operations
+   *
+   * WHY WE NEED THESE:
+   * Concurrent runs with SUBID_WRITER spool queue their ranges and take
+   * turns on an flock(2) so one of them writes everything pending. Tests
+   * exercise the leader and waiter paths without a second process.
+   */
+  int (*flock)(int fd, int operation);
+
   /*
    * User database operations
    *
@@ -86,12 +149,22 @@ struct syscall_ops {
    * requiring actual system users.
    *
    * THREAD SAFETY:
-   * getpwnam_r is the reentrant version (vs getpwnam).
-   * getpwuid is non-reentrant but simple for read-only access.
+   * Only the reentrant getpwnam_r/getpwuid_r are used for lookups, since
+   * they run in the daemon, on the batch resolver threads and on the
+   * RESOLVE_TIMEOUT_MS helper threads (see passwd.c).
+   *
+   * ENUMERATION:
+   * setpwent/getpwent/endpwent walk every account NSS knows about
+   * (--all-eligible). They share one process-wide cursor, so only a
+   * single enumeration may be in progress at a time.
    */
-  struct passwd *(*getpwuid)(uid_t uid);
+  int (*getpwuid_r)(uid_t uid, struct passwd *pwd, char *buf, size_t buflen,
+                    struct passwd **result);
   int (*getpwnam_r)(const char *name, struct passwd *pwd, char *buf,
                     size_t buflen, struct passwd **result);
+  void (*setpwent)(void);
+  struct passwd *(*getpwent)(void);
+  void (*endpwent)(void);
 
   /*
    * Process management (using posix_spawn)
@@ -123,6 +196,9 @@ struct syscall_ops {
   int (*posix_spawn_file_actions_addopen)(
       posix_spawn_file_actions_t *restrict file_actions, int fd,
       const char *restrict path, int oflag, mode_t mode);
+  int (*posix_spawnattr_init)(posix_spawnattr_t *attr);
+  int (*posix_spawnattr_destroy)(posix_spawnattr_t *attr);
+  int (*posix_spawnattr_setflags)(posix_spawnattr_t *attr, short flags);
   pid_t (*waitpid)(pid_t pid, int *wstatus, int options);
 
   /*
@@ -130,9 +206,24 @@ struct syscall_ops {
    *
    * WHY WE NEED THESE:
    * Must ensure our memory allocation checks have tests for
-   * when allocation fails.
+   * when allocation fails. free() is paired with calloc() so a
+   * per-request arena can take over both (see arena.c); it must also
+   * accept memory from the C library, such as scandir(3) results.
    */
   void *(*calloc)(size_t nmemb, size_t size);
+  void (*free)(void *ptr);
+
+  /*
+   * Memory mapped files
+   *
+   * WHY WE NEED THESE:
+   * The subid index is mapped read-only so a lookup touches only the
+   * pages it needs. Tests fail the mapping to exercise the fallback to
+   * the text databases.
+   */
+  void *(*mmap)(void *addr, size_t length, int prot, int flags, int fd,
+                off_t offset);
+  int (*munmap)(void *addr, size_t length);
 };
 
 /**
@@ -159,7 +250,7 @@ struct syscall_ops {
  * TEST USAGE (override specific operations):
  *   // Copy default, then override specific fields
  *   struct syscall_ops test_ops = syscall_ops_default;
- *   test_ops.getpwuid = mock_getpwuid;
+ *   test_ops.getpwuid_r = mock_getpwuid_r;
  *   test_ops.posix_spawn = mock_posix_spawn;
  *
  *   // Use in test
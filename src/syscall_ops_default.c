@@ -21,9 +21,14 @@
 #include <dirent.h>
 #include <fcntl.h>
 #include <pwd.h>
+#include <shadow.h>
+#include <signal.h>
 #include <spawn.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -70,13 +75,51 @@ const struct syscall_ops syscall_ops_default = {
     .fclose = fclose,
     .fgets = fgets,
     .scandir = scandir,
+    .openat = openat,
+    .getdents64 = getdents64,
+
+    /*
+     * Database write operations
+     * Direct mapping to POSIX I/O and the shadow(3) lock functions
+     */
+    .read = read,
+    .write = write,
+    .fsync = fsync,
+    .fchown = fchown,
+    .fchmod = fchmod,
+    .rename = rename,
+    .unlink = unlink,
+    .kill = kill,
+    .lckpwdf = lckpwdf,
+    .ulckpwdf = ulckpwdf,
+
+    /*
+     * Stamp cache operations
+     * Direct mapping to mkdir(2)
+     */
+    .mkdir = mkdir,
+
+    /*
+     * Daemon operations
+     * Direct mapping to getsockopt(2)
+     */
+    .getsockopt = getsockopt,
+
+    /*
+     * Group commit operations
+     * Direct mapping to flock(2)
+     */
+    .flock = flock,
 
     /*
      * User database operations
      * Maps to NSS-backed user lookup functions
      */
-    .getpwuid = getpwuid,
+    .getpwuid_r = getpwuid_r,
     .getpwnam_r = getpwnam_r,
+    .setpwent = setpwent,
+    .getpwent = getpwent,
+    .endpwent = endpwent,
 
     /*
      * Process management (using posix_spawn)
@@ -86,6 +129,9 @@ const struct syscall_ops syscall_ops_default = {
     .posix_spawn_file_actions_init = posix_spawn_file_actions_init,
     .posix_spawn_file_actions_destroy = posix_spawn_file_actions_destroy,
     .posix_spawn_file_actions_addopen = posix_spawn_file_actions_addopen,
+    .posix_spawnattr_init = posix_spawnattr_init,
+    .posix_spawnattr_destroy = posix_spawnattr_destroy,
+    .posix_spawnattr_setflags = posix_spawnattr_setflags,
     .waitpid = waitpid,
 
     /*
@@ -93,4 +139,12 @@ const struct syscall_ops syscall_ops_default = {
      * Maps to standard C library allocator
      */
     .calloc = calloc,
+    .free = free,
+
+    /*
+     * Memory mapped files
+     * Direct mapping to mmap(2) and munmap(2)
+     */
+    .mmap = mmap,
+    .munmap = munmap,
 };
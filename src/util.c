@@ -26,9 +26,13 @@
  * from inside here and we're careful to check the pointers in our visible
  * function(s).
  * */
-static int lookup_user(const struct syscall_ops *ops, const char *username,
-                       uint32_t *uid_out) __attribute__((nonnull(1, 2, 3)))
+static int lookup_uid(const struct syscall_ops *ops, uint32_t uid,
+                      char *username, size_t username_size,
+                      unsigned int timeout_ms) __attribute__((nonnull(1, 3)))
 __attribute__((warn_unused_result));
+static int lookup_user(const struct syscall_ops *ops, const char *username,
+                       uint32_t *uid_out, unsigned int timeout_ms)
+    __attribute__((nonnull(1, 2, 3))) __attribute__((warn_unused_result));
 
 /**
  * resolve_user - Resolve user argument to UID and username
@@ -38,6 +42,7 @@ __attribute__((warn_unused_result));
  * @uid: Pointer to store resolved UID
  * @username: Buffer to store resolved username
  * @username_size: Size of username buffer
+ * @timeout_ms: RESOLVE_TIMEOUT_MS, 0 to wait for NSS as long as it takes
  * @debug: Enable debug output
  *
  * Tries to parse user_arg as UID first. If that succeeds, looks up
@@ -45,10 +50,11 @@ __attribute__((warn_unused_result));
  * looks up the UID.
  *
  * Return: 0 on success with uid and username populated, -1 on error
+ *         (errno ETIMEDOUT when NSS did not answer within @timeout_ms)
  */
 int resolve_user(const struct syscall_ops *ops, const char *user_arg,
                  uint32_t *uid, char *username, size_t username_size,
-                 bool debug) {
+                 unsigned int timeout_ms, bool debug) {
   if (ops == NULL) {
     errno = EINVAL;
     (void)fprintf(stderr, "%s: error: ops is NULL\n", PROJECT_NAME);
@@ -88,28 +94,12 @@ int resolve_user(const struct syscall_ops *ops, const char *user_arg,
     }
 
     /* Look up username for this UID */
-    struct passwd *pwd = ops->getpwuid(parsed_uid);
-    if (pwd == NULL) {
-      errno = ENOENT;
-      (void)fprintf(stderr, "%s: error: no user found with UID %u\n",
-                    PROJECT_NAME, parsed_uid);
-      return -1;
-    }
-
-    /* Defensive check: pwd->pw_name must not be NULL */
-    if (pwd->pw_name == NULL) {
-      errno = EINVAL;
-      (void)fprintf(stderr, "%s: error: user lookup returned NULL username\n",
-                    PROJECT_NAME);
-      return -1;
-    }
-
-    /* Copy username using snprintf for safety */
-    int ret = snprintf(username, username_size, "%s", pwd->pw_name);
-    if (ret < 0 || (size_t)ret >= username_size) {
-      errno = ENAMETOOLONG;
-      (void)fprintf(stderr, "%s: error: username %s too long\n", PROJECT_NAME,
-                    pwd->pw_name);
+    uint64_t started = stats_now();
+    int found = lookup_uid(ops, parsed_uid, username, username_size,
+                           timeout_ms);
+    stats_phase_add(STATS_RESOLVE, started);
+    if (found != 0) {
+      /* errno already set by lookup_uid */
       return -1;
     }
 
@@ -135,7 +125,10 @@ int resolve_user(const struct syscall_ops *ops, const char *user_arg,
   }
 
   /* Look up UID for this username */
-  if (lookup_user(ops, user_arg, uid) != 0) {
+  uint64_t started = stats_now();
+  int found = lookup_user(ops, user_arg, uid, timeout_ms);
+  stats_phase_add(STATS_RESOLVE, started);
+  if (found != 0) {
     /* errno already set by lookup_user */
     return -1;
   }
@@ -158,76 +151,103 @@ int resolve_user(const struct syscall_ops *ops, const char *user_arg,
 }
 
 /**
- * lookup_user - Look up UID for username using getpwnam_r
- * @ops: Operations structure (needed for getpwnam_r and calloc/free)
- * @username: Username to look up
- * @uid_out: Pointer to store found UID
+ * lookup_uid - Look up the username of a UID using getpwuid_r
+ * @ops: Operations structure (needed for getpwuid_r and calloc/free)
+ * @uid: UID to look up
+ * @username: Buffer to copy the name into
+ * @username_size: Size of @username
+ * @timeout_ms: Deadline for the lookup, 0 for none
  *
- * Performs thread-safe username lookup using getpwnam_r(3).
- * Buffer size is determined at runtime via sysconf() and allocated
- * on the heap (not stack, since size is runtime-determined).
- *
- * Return: 0 on success, -1 if user not found or error
+ * Return: 0 on success, -1 if there is no such user or on error
  */
-static int lookup_user(const struct syscall_ops *ops, const char *username,
-                       uint32_t *uid_out) {
-  *uid_out = 0;
-
-  /* Query recommended buffer size at runtime */
-  long bufsize = sysconf(_SC_GETPW_R_SIZE_MAX);
-  // LCOV_EXCL_START
-  if (bufsize == -1) {
-    /*
-     * Your system is too messed up to run on with any confidence
-     */
-    errno = ENOSYS;
-    (void)fprintf(stderr, "%s: error: sysconf(_SC_GETPW_R_SIZE_MAX) failed\n",
-                  PROJECT_NAME);
-    return -1;
-  }
-  // LCOV_EXCL_STOP
-
-  /* Allocate on heap since size is runtime-determined - use calloc to zero */
-  char *buf = ops->calloc(1, (size_t)bufsize);
-  if (buf == NULL) {
-    errno = ENOMEM;
-    (void)fprintf(stderr, "%s: error: memory allocation failed\n",
-                  PROJECT_NAME);
+static int lookup_uid(const struct syscall_ops *ops, uint32_t uid,
+                      char *username, size_t username_size,
+                      unsigned int timeout_ms) {
+  passwd_buf_t scratch = {0};
+  uint32_t found_uid = 0;
+  const char *name = NULL;
+
+  if (passwd_lookup(ops, NULL, uid, timeout_ms, &scratch, &found_uid,
+                    &name) != 0) {
+    int saved_errno = errno;
+    if (saved_errno == ENOENT) {
+      (void)fprintf(stderr, "%s: error: no user found with UID %u\n",
+                    PROJECT_NAME, uid);
+    } else if (saved_errno == EINVAL) {
+      (void)fprintf(stderr,
+                    "%s: error: user lookup returned NULL username\n",
+                    PROJECT_NAME);
+    } else if (saved_errno == ETIMEDOUT) {
+      (void)fprintf(stderr,
+                    "%s: error: no answer for UID %u within %u ms\n",
+                    PROJECT_NAME, uid, timeout_ms);
+    } else {
+      (void)fprintf(stderr, "%s: error: failed to look up UID %u: %s\n",
+                    PROJECT_NAME, uid, strerror(saved_errno));
+    }
+    passwd_buf_free(ops, &scratch);
+    errno = saved_errno;
     return -1;
   }
 
-  struct passwd pwd = {0};
-  struct passwd *result = NULL;
-
-  int ret = ops->getpwnam_r(username, &pwd, buf, (size_t)bufsize, &result);
-
-  if (ret != 0) {
-    errno = ret;
-    (void)fprintf(stderr, "%s: error: failed to look up user '%s': %s\n",
-                  PROJECT_NAME, username, strerror(ret));
-    (void)free(buf);
+  /* Copy username using snprintf for safety */
+  int ret = snprintf(username, username_size, "%s", name);
+  if (ret < 0 || (size_t)ret >= username_size) {
+    (void)fprintf(stderr, "%s: error: username %s too long\n", PROJECT_NAME,
+                  name);
+    passwd_buf_free(ops, &scratch);
+    errno = ENAMETOOLONG;
     return -1;
   }
 
-  if (result == NULL) {
-    errno = ENOENT;
-    (void)fprintf(stderr, "%s: error: user not found: %s\n", PROJECT_NAME,
-                  username);
-    (void)free(buf);
-    return -1;
-  }
+  passwd_buf_free(ops, &scratch);
+  return 0;
+}
 
-  /* Defensive check: pwd.pw_name must not be NULL */
-  if (pwd.pw_name == NULL) {
-    errno = EINVAL;
-    (void)fprintf(stderr, "%s: error: user lookup returned NULL username\n",
-                  PROJECT_NAME);
-    (void)free(buf);
+/**
+ * lookup_user - Look up UID for username using getpwnam_r
+ * @ops: Operations structure (needed for getpwnam_r and calloc/free)
+ * @username: Username to look up
+ * @uid_out: Pointer to store found UID
+ * @timeout_ms: Deadline for the lookup, 0 for none
+ *
+ * Performs thread-safe username lookup using getpwnam_r(3). The buffer
+ * starts at sysconf(_SC_GETPW_R_SIZE_MAX) and grows on ERANGE.
+ *
+ * Return: 0 on success, -1 if user not found or error
+ */
+static int lookup_user(const struct syscall_ops *ops, const char *username,
+                       uint32_t *uid_out, unsigned int timeout_ms) {
+  passwd_buf_t scratch = {0};
+  const char *name = NULL;
+
+  if (passwd_lookup(ops, username, 0, timeout_ms, &scratch, uid_out,
+                    &name) != 0) {
+    int saved_errno = errno;
+    if (saved_errno == ENOENT) {
+      (void)fprintf(stderr, "%s: error: user not found: %s\n", PROJECT_NAME,
+                    username);
+    } else if (saved_errno == EINVAL) {
+      (void)fprintf(stderr,
+                    "%s: error: user lookup returned NULL username\n",
+                    PROJECT_NAME);
+    } else if (saved_errno == ETIMEDOUT) {
+      (void)fprintf(stderr,
+                    "%s: error: no answer for user '%s' within %u ms\n",
+                    PROJECT_NAME, username, timeout_ms);
+    } else if (saved_errno == ENOMEM) {
+      (void)fprintf(stderr, "%s: error: memory allocation failed\n",
+                    PROJECT_NAME);
+    } else {
+      (void)fprintf(stderr, "%s: error: failed to look up user '%s': %s\n",
+                    PROJECT_NAME, username, strerror(saved_errno));
+    }
+    passwd_buf_free(ops, &scratch);
+    errno = saved_errno;
     return -1;
   }
 
-  *uid_out = pwd.pw_uid;
-  (void)free(buf);
+  passwd_buf_free(ops, &scratch);
   return 0;
 }
 
@@ -283,7 +303,22 @@ int filter_conf_files(const struct dirent *entry) {
     return 0;
   }
 
-  const char *name = entry->d_name;
+  return filter_conf_name(entry->d_name);
+}
+
+/**
+ * filter_conf_name - Select .conf files by name
+ * @name: Directory entry name to check
+ *
+ * The filter_conf_files() test for callers reading directory entries
+ * themselves, such as with getdents64(2).
+ *
+ * Return: 1 to include the entry, 0 to skip
+ */
+int filter_conf_name(const char *name) {
+  if (name == NULL) {
+    return 0;
+  }
 
   /* Reject any dotfile (includes "." and "..") */
   if (name[0] == '.') {
@@ -303,3 +338,25 @@ int filter_conf_files(const struct dirent *entry) {
 
   return 0;
 }
+
+/**
+ * hash_fnv1a - Fold bytes into a 64-bit FNV-1a hash
+ * @data: Bytes to hash
+ * @len: Number of bytes in @data
+ * @hash: Running hash (FNV1A_64_INIT to start a new one)
+ *
+ * Not cryptographic; used for hash tables and change detection only.
+ * Chaining calls hashes the concatenation of their inputs.
+ *
+ * Return: Updated hash
+ */
+uint64_t hash_fnv1a(const void *data, size_t len, uint64_t hash) {
+  const unsigned char *p = data;
+
+  for (size_t i = 0; i < len; i++) {
+    hash ^= p[i];
+    hash *= UINT64_C(0x100000001b3);
+  }
+
+  return hash;
+}
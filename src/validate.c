@@ -91,6 +91,50 @@ int validate_path(const char *path) {
   return 0;
 }
 
+/**
+ * check_config_dir_stat - Apply the configuration directory checks
+ * @st: Status of the directory (symlinks followed)
+ * @dirpath: Path of the directory, for messages
+ *
+ * The target must be a directory owned by root (UID 0) and must not be
+ * world-writable (S_IWOTH).
+ *
+ * Return: 0 if @st passes, -1 on security error (errno set)
+ */
+static int check_config_dir_stat(const struct stat *st, const char *dirpath) {
+  /* Must be a directory */
+  if (!S_ISDIR(st->st_mode)) {
+    errno = ENOTDIR;
+    (void)fprintf(
+        stderr,
+        "%s: error: config path %s is not a directory (or link to one)\n",
+        PROJECT_NAME, dirpath);
+    return -1;
+  }
+
+  /* Must be owned by root (UID 0) */
+  if (st->st_uid != 0) {
+    errno = EPERM;
+    (void)fprintf(stderr,
+                  "%s: error: config directory %s not owned by root (owned by "
+                  "UID %u)\n",
+                  PROJECT_NAME, dirpath, st->st_uid);
+    return -1;
+  }
+
+  /* Must not be world-writable */
+  if (st->st_mode & S_IWOTH) {
+    errno = EPERM;
+    (void)fprintf(
+        stderr,
+        "%s: error: config directory %s is world-writable (mode %04o)\n",
+        PROJECT_NAME, dirpath, st->st_mode & 07777);
+    return -1;
+  }
+
+  return 0;
+}
+
 /**
  * validate_config_dir - Validate configuration directory security
  * @ops: Operations structure for system call abstraction (kernel-style ops
@@ -147,37 +191,41 @@ int validate_config_dir(const struct syscall_ops *ops, const char *dirpath,
     return -1;
   }
 
-  /* Must be a directory */
-  if (!S_ISDIR(st.st_mode)) {
-    errno = ENOTDIR;
-    (void)fprintf(
-        stderr,
-        "%s: error: config path %s is not a directory (or link to one)\n",
-        PROJECT_NAME, dirpath);
-    return -1;
-  }
+  return check_config_dir_stat(&st, dirpath);
+}
 
-  /* Must be owned by root (UID 0) */
-  if (st.st_uid != 0) {
-    errno = EPERM;
+/**
+ * validate_config_dir_fd - Validate an opened configuration directory
+ * @ops: Operations structure for system call abstraction (kernel-style ops
+ * pattern)
+ * @fd: Descriptor of the directory, opened following symlinks
+ * @dirpath: Path @fd was opened from, for messages
+ *
+ * Same checks as validate_config_dir(), made with fstat() on @fd so they
+ * hold for the directory the caller goes on to read, whatever happens to
+ * @dirpath in the meantime.
+ *
+ * Return: 0 on success, -1 on security error (errno set)
+ */
+int validate_config_dir_fd(const struct syscall_ops *ops, int fd,
+                           const char *dirpath) {
+  if (ops == NULL || dirpath == NULL) {
+    errno = EINVAL;
     (void)fprintf(stderr,
-                  "%s: error: config directory %s not owned by root (owned by "
-                  "UID %u)\n",
-                  PROJECT_NAME, dirpath, st.st_uid);
+                  "%s: error: invalid parameter in validate_config_dir_fd\n",
+                  PROJECT_NAME);
     return -1;
   }
 
-  /* Must not be world-writable */
-  if (st.st_mode & S_IWOTH) {
-    errno = EPERM;
-    (void)fprintf(
-        stderr,
-        "%s: error: config directory %s is world-writable (mode %04o)\n",
-        PROJECT_NAME, dirpath, st.st_mode & 07777);
+  struct stat st = {0};
+  if (ops->fstat(fd, &st) != 0) {
+    /* errno already set by fstat */
+    (void)fprintf(stderr, "%s: error: cannot stat config directory %s: %s\n",
+                  PROJECT_NAME, dirpath, strerror(errno));
     return -1;
   }
 
-  return 0;
+  return check_config_dir_stat(&st, dirpath);
 }
 
 /**
@@ -205,28 +253,27 @@ static inline bool is_valid_username_char(char c, size_t pos, size_t len) {
 }
 
 /**
- * validate_username - Validate username per shadow-utils rules
+ * check_username - Validate username per shadow-utils rules
  * @username: Username to validate
+ * @report: Print the reason a name is rejected to stderr
  *
- * Validates according to useradd(8) restrictions:
- * - Must start with lowercase letter or underscore
- * - May contain lowercase, digits, underscore, hyphen, dollar
- * - Cannot end with hyphen
- * - Cannot contain path traversal
- * - Cannot be "." or ".."
- * - Must not exceed LOGIN_NAME_MAX (runtime limit)
+ * Shared by validate_username() and validate_username_quiet().
  *
  * Return: 0 if valid, -1 if invalid
  */
-int validate_username(const char *username) {
+static int check_username(const char *username, bool report) {
   if (username == NULL) {
     errno = EINVAL;
-    (void)fprintf(stderr, "%s: error: username is NULL\n", PROJECT_NAME);
+    if (report) {
+      (void)fprintf(stderr, "%s: error: username is NULL\n", PROJECT_NAME);
+    }
     return -1;
   }
   if (*username == '\0') {
     errno = EINVAL;
-    (void)fprintf(stderr, "%s: error: username is empty\n", PROJECT_NAME);
+    if (report) {
+      (void)fprintf(stderr, "%s: error: username is empty\n", PROJECT_NAME);
+    }
     return -1;
   }
 
@@ -245,26 +292,32 @@ int validate_username(const char *username) {
   size_t len = strlen(username);
   if (len >= (size_t)name_max) {
     errno = ENAMETOOLONG;
-    (void)fprintf(stderr,
-                  "%s: error: username exceeds LOGIN_NAME_MAX (%ld): %s\n",
-                  PROJECT_NAME, name_max, username);
+    if (report) {
+      (void)fprintf(stderr,
+                    "%s: error: username exceeds LOGIN_NAME_MAX (%ld): %s\n",
+                    PROJECT_NAME, name_max, username);
+    }
     return -1;
   }
 
   /* Check for path traversal attempts */
   if (strstr(username, "/") != NULL) {
     errno = EINVAL;
-    (void)fprintf(stderr,
-                  "%s: error: username contains traversal sequence: %s\n",
-                  PROJECT_NAME, username);
+    if (report) {
+      (void)fprintf(stderr,
+                    "%s: error: username contains traversal sequence: %s\n",
+                    PROJECT_NAME, username);
+    }
     return -1;
   }
 
   /* Check for command injection attempts */
   if (strstr(username, ";") != NULL) {
     errno = EINVAL;
-    (void)fprintf(stderr, "%s: error: username contains ';': %s\n",
-                  PROJECT_NAME, username);
+    if (report) {
+      (void)fprintf(stderr, "%s: error: username contains ';': %s\n",
+                    PROJECT_NAME, username);
+    }
     return -1;
   }
 
@@ -272,10 +325,12 @@ int validate_username(const char *username) {
   for (size_t i = 0; i < len; i++) {
     if (!is_valid_username_char(username[i], i, len)) {
       errno = EINVAL;
-      (void)fprintf(stderr,
-                    "%s: error: invalid character '%c' at position %zu in "
-                    "username: %s\n",
-                    PROJECT_NAME, username[i], i, username);
+      if (report) {
+        (void)fprintf(stderr,
+                      "%s: error: invalid character '%c' at position %zu in "
+                      "username: %s\n",
+                      PROJECT_NAME, username[i], i, username);
+      }
       return -1;
     }
   }
@@ -283,14 +338,48 @@ int validate_username(const char *username) {
   /* Username cannot end with hyphen (historical restriction) */
   if (username[len - 1] == '-') {
     errno = EINVAL;
-    (void)fprintf(stderr, "%s: error: username cannot end with hyphen: %s\n",
-                  PROJECT_NAME, username);
+    if (report) {
+      (void)fprintf(stderr,
+                    "%s: error: username cannot end with hyphen: %s\n",
+                    PROJECT_NAME, username);
+    }
     return -1;
   }
 
   return 0;
 }
 
+/**
+ * validate_username - Validate username per shadow-utils rules
+ * @username: Username to validate
+ *
+ * Validates according to useradd(8) restrictions:
+ * - Must start with lowercase letter or underscore
+ * - May contain lowercase, digits, underscore, hyphen, dollar
+ * - Cannot end with hyphen
+ * - Cannot contain path traversal
+ * - Cannot be "." or ".."
+ * - Must not exceed LOGIN_NAME_MAX (runtime limit)
+ *
+ * Return: 0 if valid, -1 if invalid
+ */
+int validate_username(const char *username) {
+  return check_username(username, true);
+}
+
+/**
+ * validate_username_quiet - validate_username() without the diagnostics
+ * @username: Username to validate
+ *
+ * For callers that cannot write to stderr in order, such as the batch
+ * resolver threads; errno is set exactly as validate_username() sets it.
+ *
+ * Return: 0 if valid, -1 if invalid
+ */
+int validate_username_quiet(const char *username) {
+  return check_username(username, false);
+}
+
 /**
  * parse_bool - Parse boolean value from string
  * @str: String to parse
@@ -484,3 +573,83 @@ int validate_uid_subid_overlap(uint32_t uid, const subid_config_t *subid_cfg) {
 
   return 0;
 }
+
+/**
+ * validate_subid_bands - Check the UID bands of one subordinate ID type
+ * @config: Configuration with the UID range
+ * @subid_cfg: Subordinate ID configuration holding the bands
+ *
+ * Run once when the configuration is loaded, so calc_subid_range() can
+ * trust the segment table built from the bands. Every band must lie
+ * inside [UID_MIN, UID_MAX] with a count between 1 and the size of the
+ * subordinate ID space, and no two bands may share a UID: the bands are
+ * sorted by their first UID, so comparing neighbours is enough. Nothing
+ * has compared the space's bounds yet, so a reversed space is rejected
+ * here before its size is taken.
+ *
+ * Return: 0 if the bands are usable, -1 otherwise (errno EINVAL)
+ */
+int validate_subid_bands(const config_t *config,
+                         const subid_config_t *subid_cfg) {
+  if (config == NULL || subid_cfg == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: NULL parameter in validate_subid_bands\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  // LCOV_EXCL_START
+  if (subid_cfg->band_count > SUBID_BANDS_MAX) {
+    /* The parser never stores more */
+    errno = EINVAL;
+    return -1;
+  }
+  // LCOV_EXCL_STOP
+
+  if (subid_cfg->band_count > 0 && subid_cfg->max_val < subid_cfg->min_val) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: %s set but %s-%s %u-%u is empty\n",
+                  PROJECT_NAME, subid_cfg->key_bands, subid_cfg->key_min,
+                  subid_cfg->key_max, subid_cfg->min_val, subid_cfg->max_val);
+    return -1;
+  }
+
+  uint64_t space = (uint64_t)subid_cfg->max_val - subid_cfg->min_val + 1;
+  for (size_t i = 0; i < subid_cfg->band_count; i++) {
+    const subid_band_t *band = &subid_cfg->bands[i];
+
+    if (band->uid_lo > band->uid_hi || band->uid_lo < config->uid_min ||
+        band->uid_hi > config->uid_max) {
+      errno = EINVAL;
+      (void)fprintf(stderr,
+                    "%s: error: %s band %u-%u is not inside %s-%s %u-%u\n",
+                    PROJECT_NAME, subid_cfg->key_bands, band->uid_lo,
+                    band->uid_hi, config->key_uid_min, config->key_uid_max,
+                    config->uid_min, config->uid_max);
+      return -1;
+    }
+
+    if (band->count == 0 || band->count > space) {
+      errno = EINVAL;
+      (void)fprintf(stderr,
+                    "%s: error: %s band %u-%u count %u does not fit %s-%s "
+                    "%u-%u\n",
+                    PROJECT_NAME, subid_cfg->key_bands, band->uid_lo,
+                    band->uid_hi, band->count, subid_cfg->key_min,
+                    subid_cfg->key_max, subid_cfg->min_val,
+                    subid_cfg->max_val);
+      return -1;
+    }
+
+    if (i > 0 && band->uid_lo <= subid_cfg->bands[i - 1].uid_hi) {
+      errno = EINVAL;
+      (void)fprintf(stderr, "%s: error: %s band %u-%u overlaps band %u-%u\n",
+                    PROJECT_NAME, subid_cfg->key_bands, band->uid_lo,
+                    band->uid_hi, subid_cfg->bands[i - 1].uid_lo,
+                    subid_cfg->bands[i - 1].uid_hi);
+      return -1;
+    }
+  }
+
+  return 0;
+}
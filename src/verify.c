@@ -0,0 +1,1199 @@
+/**
+ * verify.c - Fleet consistency check over collected subuid/subgid dumps
+ *
+ * Every host should hold the same range for the same UID. --verify reads
+ * the subuid (or subgid) files collected from many hosts and compares
+ * each entry with the range calc_subid_range() gives for its owner:
+ *
+ *   mismatch       The range is not the calculated one for that UID
+ *   overlap        Two owners share part of a range on one host
+ *   unknown-owner  The owner does not resolve to an account
+ *   malformed      The line cannot be parsed
+ *   missing        A user listed on some hosts is absent from others
+ *
+ * An input is a plain dump (the host is its path), a stream of dumps
+ * each introduced by a "==> HOST <==" line, as head(1) and tail(1) print
+ * for several files, or a tar archive with one member per host (the host
+ * is the member name). Findings use the columns of --audit, with HOST in
+ * place of the database path.
+ *
+ * Owners are kept in one hash table shared by every input, holding each
+ * distinct user's UID, calculated range and number of hosts listing it;
+ * a host's own entries are only held while that host is checked. Memory
+ * therefore grows with the number of users and the size of the largest
+ * host, not with the total number of lines. With --jobs inputs are read
+ * on several threads, each checking whole hosts.
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <unistd.h>
+
+/* Bytes read from an input at a time */
+enum { VERIFY_READ_SIZE = 64 * 1024 };
+
+/* Initial element count of every growable buffer */
+enum { VERIFY_INITIAL_CAP = 256 };
+
+/* Initial number of user table slots, a power of two */
+enum { VERIFY_TABLE_INITIAL = 1024 };
+
+/* Longest host name kept, longer ones are truncated */
+enum { VERIFY_HOST_MAX = 256 };
+
+/* Room for the detail column of a finding */
+enum { VERIFY_DETAIL_LEN = 128 };
+
+/* tar(5) block size and the header fields read here */
+enum {
+  TAR_BLOCK = 512,
+  TAR_NAME_OFF = 0,
+  TAR_NAME_LEN = 100,
+  TAR_SIZE_OFF = 124,
+  TAR_SIZE_LEN = 12,
+  TAR_TYPE_OFF = 156,
+  TAR_MAGIC_OFF = 257,
+  TAR_PREFIX_OFF = 345,
+  TAR_PREFIX_LEN = 155
+};
+
+/* Line opening the next host of a concatenated stream */
+#define VERIFY_HEADER_OPEN "==> "
+#define VERIFY_HEADER_CLOSE " <=="
+
+/**
+ * struct verify_entry_t - One line of a host's dump
+ * @start: First subordinate ID
+ * @end: One past the last subordinate ID
+ * @owner: Offset of the owner field in the host's owner arena
+ * @name: Owner field, set once the host has been read
+ * @line: Line number within the host's dump
+ * @problem: Why the line did not parse, NULL for an entry
+ * @uid: UID of the owner, valid when @resolved
+ * @expected: Calculated start, valid when @calculable
+ * @resolved: The owner resolved to an account
+ * @eligible: @uid lies within [UID_MIN, UID_MAX]
+ * @calculable: A range could be calculated for @uid
+ */
+typedef struct {
+  uint64_t start;
+  uint64_t end;
+  size_t owner;
+  const char *name;
+  size_t line;
+  const char *problem;
+  uint32_t uid;
+  uint32_t expected;
+  bool resolved;
+  bool eligible;
+  bool calculable;
+} verify_entry_t;
+
+/**
+ * struct verify_user_t - One distinct owner across the fleet
+ * @hash: hash_fnv1a() of the name
+ * @name: Offset of the name in the table's arena, plus one; 0 when free
+ * @hosts: Hosts whose dump lists the user
+ * @uid: UID of the user, valid when @resolved
+ * @expected: Calculated start, valid when @calculable
+ * @resolved: The name resolved to an account
+ * @eligible: @uid lies within [UID_MIN, UID_MAX]
+ * @calculable: A range could be calculated for @uid
+ */
+typedef struct {
+  uint64_t hash;
+  size_t name;
+  size_t hosts;
+  uint32_t uid;
+  uint32_t expected;
+  bool resolved;
+  bool eligible;
+  bool calculable;
+} verify_user_t;
+
+/**
+ * struct verify_ctx_t - State shared by every thread of a run
+ * @ops: Operations structure for system call abstraction
+ * @config: Loaded configuration
+ * @subid_cfg: Range configuration of the verified database
+ * @out: Output stream
+ * @debug: Enable debug output
+ * @inputs: Paths to read ("-" for stdin)
+ * @count: Number of @inputs
+ * @next: Index of the next unclaimed input
+ * @failed: Some input could not be read to the end
+ * @table_lock: Protects the user table, @hosts and @scratch
+ * @users: User table, open addressing
+ * @slots: Slots in @users, a power of two
+ * @used: Slots in use
+ * @names: User names, NUL-terminated back to back
+ * @names_len: Bytes of @names in use
+ * @names_cap: Bytes of @names allocated
+ * @hosts: Hosts checked so far
+ * @scratch: passwd_lookup() buffer
+ * @out_lock: Protects @out and @findings
+ * @findings: Findings reported so far
+ */
+typedef struct {
+  const struct syscall_ops *ops;
+  const config_t *config;
+  const subid_config_t *subid_cfg;
+  FILE *out;
+  bool debug;
+  char *const *inputs;
+  size_t count;
+  atomic_size_t next;
+  atomic_bool failed;
+  mtx_t table_lock;
+  verify_user_t *users;
+  size_t slots;
+  size_t used;
+  char *names;
+  size_t names_len;
+  size_t names_cap;
+  size_t hosts;
+  passwd_buf_t scratch;
+  mtx_t out_lock;
+  size_t findings;
+} verify_ctx_t;
+
+/**
+ * struct verify_worker_t - One thread's input and host buffers
+ * @fd: Input being read
+ * @buf: Read buffer
+ * @pos: Offset of the first unconsumed byte in @buf
+ * @len: Bytes of @buf filled
+ * @eof: The input has no more data
+ * @bounded: Reading a tar member, stop after @limit bytes
+ * @limit: Bytes left in the tar member
+ * @host: Host being read
+ * @entries: Lines of @host
+ * @len_entries: Entries in use
+ * @cap_entries: Entries allocated
+ * @order: @entries sorted by owner name
+ * @cap_order: Elements of @order allocated
+ * @owners: Owner fields, NUL-terminated back to back
+ * @owners_len: Bytes of @owners in use
+ * @owners_cap: Bytes of @owners allocated
+ */
+typedef struct {
+  int fd;
+  char buf[VERIFY_READ_SIZE];
+  size_t pos;
+  size_t len;
+  bool eof;
+  bool bounded;
+  uint64_t limit;
+  char host[VERIFY_HOST_MAX];
+  verify_entry_t *entries;
+  size_t len_entries;
+  size_t cap_entries;
+  verify_entry_t **order;
+  size_t cap_order;
+  char *owners;
+  size_t owners_len;
+  size_t owners_cap;
+} verify_worker_t;
+
+/**
+ * struct verify_missing_t - A user absent from some hosts
+ * @name: User name
+ * @hosts: Hosts whose dump lists the user
+ */
+typedef struct {
+  const char *name;
+  size_t hosts;
+} verify_missing_t;
+
+/*
+ * Forward declarations for internal functions
+ *
+ * We can use nonnull on static functions because they can only be called
+ * from inside here and we're careful to check the pointers in our visible
+ * function(s).
+ */
+static void *grow_array(const struct syscall_ops *ops, void *old,
+                        size_t used, size_t *cap, size_t need, size_t size)
+    __attribute__((nonnull(1, 4))) __attribute__((warn_unused_result));
+static int reader_fill(const struct syscall_ops *ops, verify_worker_t *w)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static int reader_line(const struct syscall_ops *ops, verify_worker_t *w,
+                       char *line, size_t size, bool *overlong)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static int reader_take(const struct syscall_ops *ops, verify_worker_t *w,
+                       char *dst, uint64_t n) __attribute__((nonnull(1, 2)))
+__attribute__((warn_unused_result));
+static int compare_names(const void *a, const void *b)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static int compare_entries(const void *a, const void *b)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static verify_user_t *find_user(verify_ctx_t *ctx, const char *name)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static int grow_table(verify_ctx_t *ctx) __attribute__((nonnull))
+__attribute__((warn_unused_result));
+static int add_line(verify_ctx_t *ctx, verify_worker_t *w, char *line,
+                    size_t lineno, bool overlong) __attribute__((nonnull))
+__attribute__((warn_unused_result));
+static int merge_host(verify_ctx_t *ctx, verify_worker_t *w)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static void report(verify_ctx_t *ctx, const char *kind, const char *host,
+                   const verify_entry_t *entry, const char *detail)
+    __attribute__((nonnull));
+static void report_host(verify_ctx_t *ctx, verify_worker_t *w)
+    __attribute__((nonnull));
+static int finish_host(verify_ctx_t *ctx, verify_worker_t *w)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static void start_host(verify_worker_t *w, const char *name, size_t len)
+    __attribute__((nonnull));
+static int read_text(verify_ctx_t *ctx, verify_worker_t *w, const char *path)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static int tar_size(const char *field, uint64_t *size)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static int read_tar(verify_ctx_t *ctx, verify_worker_t *w, const char *path)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static int read_input(verify_ctx_t *ctx, verify_worker_t *w,
+                      const char *path) __attribute__((nonnull))
+__attribute__((warn_unused_result));
+static int verify_worker(void *arg) __attribute__((nonnull));
+static int compare_missing(const void *a, const void *b)
+    __attribute__((nonnull)) __attribute__((warn_unused_result));
+static int report_missing(verify_ctx_t *ctx) __attribute__((nonnull))
+__attribute__((warn_unused_result));
+
+/**
+ * grow_array - Make room for @need elements in a growable buffer
+ * @ops: Operations structure (needed for calloc)
+ * @old: Current buffer, or NULL
+ * @used: Elements of @old in use
+ * @cap: Elements allocated, updated when the buffer grows
+ * @need: Elements required
+ * @size: Size of one element
+ *
+ * On failure @old is left untouched for the caller to free.
+ *
+ * Return: Buffer to use from now on, NULL on allocation failure
+ */
+static void *grow_array(const struct syscall_ops *ops, void *old,
+                        size_t used, size_t *cap, size_t need, size_t size) {
+  if (old != NULL && need <= *cap) {
+    return old;
+  }
+
+  size_t grown_cap = *cap == 0 ? VERIFY_INITIAL_CAP : *cap;
+  while (grown_cap < need) {
+    grown_cap *= 2;
+  }
+
+  void *grown = ops->calloc(grown_cap, size);
+  if (grown == NULL) {
+    errno = ENOMEM;
+    (void)fprintf(stderr, "%s: error: memory allocation failed\n",
+                  PROJECT_NAME);
+    return NULL;
+  }
+  if (used > 0) {
+    memcpy(grown, old, used * size);
+  }
+  ops->free(old);
+  *cap = grown_cap;
+  return grown;
+}
+
+/**
+ * reader_fill - Read more of the input once the buffer is used up
+ * @ops: Operations structure for system call abstraction
+ * @w: Worker reading the input
+ *
+ * Return: 0 on success (@w->eof set at the end), -1 on a read error
+ */
+static int reader_fill(const struct syscall_ops *ops, verify_worker_t *w) {
+  if (w->pos < w->len || w->eof) {
+    return 0;
+  }
+
+  w->pos = 0;
+  w->len = 0;
+  for (;;) {
+    ssize_t n = ops->read(w->fd, w->buf, sizeof(w->buf));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      return -1;
+    }
+    w->len = (size_t)n;
+    w->eof = n == 0;
+    return 0;
+  }
+}
+
+/**
+ * reader_line - Read the next line of the input or tar member
+ * @ops: Operations structure for system call abstraction
+ * @w: Worker reading the input
+ * @line: Buffer for the line, without its newline
+ * @size: Size of @line
+ * @overlong: Set when the line did not fit and was cut short
+ *
+ * Return: 1 for a line, 0 at the end of the input or member, -1 on error
+ */
+static int reader_line(const struct syscall_ops *ops, verify_worker_t *w,
+                       char *line, size_t size, bool *overlong) {
+  size_t used = 0;
+  bool any = false;
+
+  *overlong = false;
+  while (!w->bounded || w->limit > 0) {
+    if (reader_fill(ops, w) != 0) {
+      return -1;
+    }
+    if (w->pos == w->len) {
+      break;
+    }
+
+    size_t avail = w->len - w->pos;
+    if (w->bounded && avail > w->limit) {
+      avail = (size_t)w->limit;
+    }
+    const char *start = w->buf + w->pos;
+    const char *newline = memchr(start, '\n', avail);
+    size_t take = newline != NULL ? (size_t)(newline - start) + 1 : avail;
+    size_t copy = newline != NULL ? take - 1 : take;
+    if (copy > size - 1 - used) {
+      copy = size - 1 - used;
+      *overlong = true;
+    }
+    memcpy(line + used, start, copy);
+    used += copy;
+    w->pos += take;
+    if (w->bounded) {
+      w->limit -= take;
+    }
+    any = true;
+    if (newline != NULL) {
+      break;
+    }
+  }
+
+  line[used] = '\0';
+  return any ? 1 : 0;
+}
+
+/**
+ * reader_take - Consume exactly @n bytes of the input
+ * @ops: Operations structure for system call abstraction
+ * @w: Worker reading the input
+ * @dst: Where to copy them, NULL to skip them
+ * @n: Number of bytes
+ *
+ * Return: 0 on success, -1 on a read error or a truncated input (EIO)
+ */
+static int reader_take(const struct syscall_ops *ops, verify_worker_t *w,
+                       char *dst, uint64_t n) {
+  while (n > 0) {
+    if (reader_fill(ops, w) != 0) {
+      return -1;
+    }
+    if (w->pos == w->len) {
+      errno = EIO;
+      return -1;
+    }
+
+    size_t take = w->len - w->pos;
+    if (take > n) {
+      take = (size_t)n;
+    }
+    if (dst != NULL) {
+      memcpy(dst, w->buf + w->pos, take);
+      dst += take;
+    }
+    w->pos += take;
+    n -= take;
+  }
+  return 0;
+}
+
+/**
+ * compare_names - qsort(3) comparator for entry pointers by owner name
+ *
+ * Ties keep line order so every owner's entries stay in file order.
+ */
+static int compare_names(const void *a, const void *b) {
+  const verify_entry_t *ea = *(const verify_entry_t *const *)a;
+  const verify_entry_t *eb = *(const verify_entry_t *const *)b;
+  int cmp = strcmp(ea->name, eb->name);
+  if (cmp != 0) {
+    return cmp;
+  }
+  return ea->line < eb->line ? -1 : ea->line > eb->line;
+}
+
+/**
+ * compare_entries - qsort(3) comparator for verify_entry_t by interval
+ *
+ * Orders by start, then by end, then by line so the output is stable.
+ */
+static int compare_entries(const void *a, const void *b) {
+  const verify_entry_t *ea = a;
+  const verify_entry_t *eb = b;
+  if (ea->start != eb->start) {
+    return ea->start < eb->start ? -1 : 1;
+  }
+  if (ea->end != eb->end) {
+    return ea->end < eb->end ? -1 : 1;
+  }
+  return ea->line < eb->line ? -1 : ea->line > eb->line;
+}
+
+/**
+ * find_user - Find the slot of @name in the user table
+ * @ctx: Run state, table_lock held
+ * @name: Owner name
+ *
+ * Return: The user's slot, or the free slot where it belongs
+ */
+static verify_user_t *find_user(verify_ctx_t *ctx, const char *name) {
+  uint64_t hash = hash_fnv1a(name, strlen(name), FNV1A_64_INIT);
+  size_t mask = ctx->slots - 1;
+
+  for (size_t i = (size_t)hash & mask;; i = (i + 1) & mask) {
+    verify_user_t *user = &ctx->users[i];
+    if (user->name == 0) {
+      user->hash = hash;
+      return user;
+    }
+    if (user->hash == hash &&
+        strcmp(ctx->names + user->name - 1, name) == 0) {
+      return user;
+    }
+  }
+}
+
+/**
+ * grow_table - Double the user table once it is 3/4 full
+ * @ctx: Run state, table_lock held
+ *
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int grow_table(verify_ctx_t *ctx) {
+  if (ctx->users != NULL && (ctx->used + 1) * 4 <= ctx->slots * 3) {
+    return 0;
+  }
+
+  size_t slots = ctx->slots == 0 ? VERIFY_TABLE_INITIAL : ctx->slots * 2;
+  verify_user_t *users = ctx->ops->calloc(slots, sizeof(*users));
+  if (users == NULL) {
+    errno = ENOMEM;
+    (void)fprintf(stderr, "%s: error: memory allocation failed\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  size_t mask = slots - 1;
+  for (size_t i = 0; i < ctx->slots; i++) {
+    const verify_user_t *user = &ctx->users[i];
+    if (user->name == 0) {
+      continue;
+    }
+    size_t j = (size_t)user->hash & mask;
+    while (users[j].name != 0) {
+      j = (j + 1) & mask;
+    }
+    users[j] = *user;
+  }
+
+  ctx->ops->free(ctx->users);
+  ctx->users = users;
+  ctx->slots = slots;
+  return 0;
+}
+
+/**
+ * add_line - Add one line of the current host
+ * @ctx: Run state
+ * @w: Worker reading the host
+ * @line: Line without its newline, modified in place
+ * @lineno: Line number within the host's dump
+ * @overlong: The line was cut short
+ *
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int add_line(verify_ctx_t *ctx, verify_worker_t *w, char *line,
+                    size_t lineno, bool overlong) {
+  const char *owner = NULL;
+  uint32_t start = 0;
+  uint32_t count = 0;
+  const char *problem = NULL;
+
+  if (overlong) {
+    problem = "overlong line";
+  } else {
+    int parsed = subid_db_parse_line(line, &owner, &start, &count);
+    if (parsed == 1) {
+      return 0;
+    }
+    if (parsed != 0) {
+      problem = "unparseable entry";
+    }
+  }
+
+  verify_entry_t *entries =
+      grow_array(ctx->ops, w->entries, w->len_entries, &w->cap_entries,
+                 w->len_entries + 1, sizeof(*entries));
+  if (entries == NULL) {
+    return -1;
+  }
+  w->entries = entries;
+
+  size_t offset = 0;
+  if (problem == NULL) {
+    size_t size = strlen(owner) + 1;
+    char *owners = grow_array(ctx->ops, w->owners, w->owners_len,
+                              &w->owners_cap, w->owners_len + size, 1);
+    if (owners == NULL) {
+      return -1;
+    }
+    w->owners = owners;
+    memcpy(w->owners + w->owners_len, owner, size);
+    offset = w->owners_len;
+    w->owners_len += size;
+  }
+
+  w->entries[w->len_entries++] = (verify_entry_t){
+      .start = start,
+      .end = (uint64_t)start + count,
+      .owner = offset,
+      .line = lineno,
+      .problem = problem,
+  };
+  return 0;
+}
+
+/**
+ * merge_host - Count the host's owners in the user table
+ * @ctx: Run state
+ * @w: Worker holding the host, every line read
+ *
+ * Each distinct owner of the host is looked up once, resolved and given
+ * its calculated range the first time any host lists it, and the answer
+ * is copied into the host's entries.
+ *
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int merge_host(verify_ctx_t *ctx, verify_worker_t *w) {
+  verify_entry_t **order = grow_array(ctx->ops, w->order, 0, &w->cap_order,
+                                      w->len_entries, sizeof(*order));
+  if (order == NULL) {
+    return -1;
+  }
+  w->order = order;
+
+  /* The arena no longer moves, so the names can be pointed at */
+  size_t n = 0;
+  for (size_t i = 0; i < w->len_entries; i++) {
+    verify_entry_t *entry = &w->entries[i];
+    if (entry->problem == NULL) {
+      entry->name = w->owners + entry->owner;
+      order[n++] = entry;
+    }
+  }
+  if (n > 1) {
+    qsort(order, n, sizeof(*order), compare_names);
+  }
+
+  int ret = 0;
+  (void)mtx_lock(&ctx->table_lock);
+  ctx->hosts++;
+  for (size_t i = 0; i < n && ret == 0;) {
+    const char *name = order[i]->name;
+    if (grow_table(ctx) != 0) {
+      ret = -1;
+      break;
+    }
+
+    verify_user_t *user = find_user(ctx, name);
+    if (user->name == 0) {
+      size_t size = strlen(name) + 1;
+      char *names = grow_array(ctx->ops, ctx->names, ctx->names_len,
+                               &ctx->names_cap, ctx->names_len + size, 1);
+      if (names == NULL) {
+        ret = -1;
+        break;
+      }
+      ctx->names = names;
+      memcpy(ctx->names + ctx->names_len, name, size);
+      user->name = ctx->names_len + 1;
+      ctx->names_len += size;
+      ctx->used++;
+
+      const char *found = NULL;
+      user->resolved =
+          parse_uint32_strict(name, &user->uid) == 0 ||
+          (validate_username_quiet(name) == 0 &&
+           passwd_lookup(ctx->ops, name, 0, ctx->config->resolve_timeout_ms,
+                         &ctx->scratch, &user->uid, &found) == 0);
+      user->eligible = user->resolved && user->uid >= ctx->config->uid_min &&
+                       user->uid <= ctx->config->uid_max;
+      user->calculable =
+          user->eligible &&
+          calc_subid_range(user->uid, ctx->config->uid_min, ctx->subid_cfg,
+                           ctx->config->allow_subid_wrap,
+                           &user->expected) == 0;
+    }
+    user->hosts++;
+
+    /* Every entry of this owner, listed once or more on the host */
+    for (; i < n && strcmp(order[i]->name, name) == 0; i++) {
+      order[i]->uid = user->uid;
+      order[i]->expected = user->expected;
+      order[i]->resolved = user->resolved;
+      order[i]->eligible = user->eligible;
+      order[i]->calculable = user->calculable;
+    }
+  }
+  (void)mtx_unlock(&ctx->table_lock);
+  return ret;
+}
+
+/**
+ * report - Write one finding, out_lock held
+ * @ctx: Run state
+ * @kind: Finding kind (first column)
+ * @host: Host the finding is about
+ * @entry: Line the finding is about
+ * @detail: Last column
+ */
+static void report(verify_ctx_t *ctx, const char *kind, const char *host,
+                   const verify_entry_t *entry, const char *detail) {
+  if (entry->problem != NULL) {
+    (void)fprintf(ctx->out, "%s\t%s:%zu\t-\t%s\n", kind, host, entry->line,
+                  detail);
+  } else {
+    (void)fprintf(ctx->out, "%s\t%s:%zu\t%s:%llu:%llu\t%s\n", kind, host,
+                  entry->line, entry->name,
+                  (unsigned long long)entry->start,
+                  (unsigned long long)(entry->end - entry->start), detail);
+  }
+  ctx->findings++;
+}
+
+/**
+ * report_host - Report every finding of one host
+ * @ctx: Run state
+ * @w: Worker holding the host, merged into the user table
+ *
+ * Per-line findings come in file order, overlaps after them. Overlaps
+ * are found as in --audit: after sorting by start, an entry overlaps an
+ * earlier one exactly when it starts before the furthest end seen so far.
+ * Ranges of the same owner (by name, or by UID when both resolved) are
+ * not reported.
+ */
+static void report_host(verify_ctx_t *ctx, verify_worker_t *w) {
+  char detail[VERIFY_DETAIL_LEN] = {0};
+  const subid_config_t *subid_cfg = ctx->subid_cfg;
+
+  (void)mtx_lock(&ctx->out_lock);
+  size_t before = ctx->findings;
+  size_t entries = 0;
+
+  for (size_t i = 0; i < w->len_entries; i++) {
+    const verify_entry_t *entry = &w->entries[i];
+    if (entry->problem != NULL) {
+      report(ctx, "malformed", w->host, entry, entry->problem);
+      continue;
+    }
+    entries++;
+
+    if (!entry->resolved) {
+      report(ctx, "unknown-owner", w->host, entry, "no such user");
+    } else if (entry->eligible && !entry->calculable) {
+      (void)snprintf(detail, sizeof(detail), "UID %u expected none",
+                     entry->uid);
+      report(ctx, "mismatch", w->host, entry, detail);
+    } else if (entry->eligible &&
+               (entry->start != entry->expected ||
+                entry->end - entry->start !=
+                    calc_subid_count(entry->uid, subid_cfg))) {
+      (void)snprintf(detail, sizeof(detail), "UID %u expected %u:%u",
+                     entry->uid, entry->expected,
+                     calc_subid_count(entry->uid, subid_cfg));
+      report(ctx, "mismatch", w->host, entry, detail);
+    }
+  }
+
+  /* Malformed lines sort to the front with an empty interval */
+  if (w->len_entries > 1) {
+    qsort(w->entries, w->len_entries, sizeof(*w->entries), compare_entries);
+  }
+  const verify_entry_t *reach = NULL;
+  for (size_t i = 0; i < w->len_entries; i++) {
+    const verify_entry_t *entry = &w->entries[i];
+    if (entry->problem != NULL) {
+      continue;
+    }
+    if (reach != NULL && entry->start < reach->end &&
+        strcmp(entry->name, reach->name) != 0 &&
+        !(entry->resolved && reach->resolved && entry->uid == reach->uid)) {
+      (void)snprintf(detail, sizeof(detail), "line %zu %s:%llu:%llu",
+                     reach->line, reach->name,
+                     (unsigned long long)reach->start,
+                     (unsigned long long)(reach->end - reach->start));
+      report(ctx, "overlap", w->host, entry, detail);
+    }
+    if (reach == NULL || entry->end > reach->end) {
+      reach = entry;
+    }
+  }
+
+  (void)fprintf(ctx->out, "summary\t%s\t%zu entries\t%zu findings\n",
+                w->host, entries, ctx->findings - before);
+  (void)mtx_unlock(&ctx->out_lock);
+}
+
+/**
+ * finish_host - Check the host just read and make room for the next
+ * @ctx: Run state
+ * @w: Worker holding the host
+ *
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int finish_host(verify_ctx_t *ctx, verify_worker_t *w) {
+  int ret = merge_host(ctx, w);
+  if (ret == 0) {
+    report_host(ctx, w);
+  }
+  if (ctx->debug) {
+    (void)fprintf(stderr, "%s: debug: verified %s: %zu lines\n",
+                  PROJECT_NAME, w->host, w->len_entries);
+  }
+
+  w->len_entries = 0;
+  w->owners_len = 0;
+  return ret;
+}
+
+/**
+ * start_host - Name the host whose lines follow
+ * @w: Worker reading the host
+ * @name: Host name, need not be NUL-terminated
+ * @len: Length of @name
+ */
+static void start_host(verify_worker_t *w, const char *name, size_t len) {
+  if (len >= sizeof(w->host)) {
+    len = sizeof(w->host) - 1;
+  }
+  memcpy(w->host, name, len);
+  w->host[len] = '\0';
+}
+
+/**
+ * read_text - Check a plain dump or a stream of "==> HOST <==" sections
+ * @ctx: Run state
+ * @w: Worker reading the input
+ * @path: Input path, the host of lines before any header
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int read_text(verify_ctx_t *ctx, verify_worker_t *w, const char *path) {
+  char line[MAX_LINE_LEN] = {0};
+  size_t open_len = strlen(VERIFY_HEADER_OPEN);
+  size_t close_len = strlen(VERIFY_HEADER_CLOSE);
+  bool pending = false; /* Lines (or a header) of an unchecked host seen */
+  size_t lineno = 0;
+  bool overlong = false;
+  int got = 0;
+
+  start_host(w, path, strlen(path));
+  while ((got = reader_line(ctx->ops, w, line, sizeof(line), &overlong)) ==
+         1) {
+    size_t len = strlen(line);
+    if (!overlong && len > open_len + close_len &&
+        strncmp(line, VERIFY_HEADER_OPEN, open_len) == 0 &&
+        strcmp(line + len - close_len, VERIFY_HEADER_CLOSE) == 0) {
+      if (pending && finish_host(ctx, w) != 0) {
+        return -1;
+      }
+      start_host(w, line + open_len, len - open_len - close_len);
+      pending = true;
+      lineno = 0;
+      continue;
+    }
+
+    pending = true;
+    if (add_line(ctx, w, line, ++lineno, overlong) != 0) {
+      return -1;
+    }
+  }
+  if (got < 0) {
+    return -1;
+  }
+
+  return pending ? finish_host(ctx, w) : 0;
+}
+
+/**
+ * tar_size - Parse the octal size field of a tar header
+ * @field: TAR_SIZE_LEN bytes, NUL- or space-terminated
+ * @size: Set to the member size
+ *
+ * Return: 0 on success, -1 for a field this reader does not understand
+ */
+static int tar_size(const char *field, uint64_t *size) {
+  uint64_t value = 0;
+  size_t i = 0;
+
+  while (i < TAR_SIZE_LEN && field[i] == ' ') {
+    i++;
+  }
+  size_t digits = 0;
+  for (; i < TAR_SIZE_LEN && field[i] >= '0' && field[i] <= '7'; i++) {
+    value = value * 8 + (uint64_t)(field[i] - '0');
+    digits++;
+  }
+  if (digits == 0 ||
+      (i < TAR_SIZE_LEN && field[i] != '\0' && field[i] != ' ')) {
+    return -1;
+  }
+
+  *size = value;
+  return 0;
+}
+
+/**
+ * read_tar - Check every regular member of a tar archive as one host
+ * @ctx: Run state
+ * @w: Worker reading the input, positioned at the first header
+ * @path: Input path, for messages
+ *
+ * ustar names are joined from the prefix and name fields, and GNU long
+ * names are honoured; a leading "./" is dropped. Other members (pax
+ * headers, directories, links) are skipped.
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int read_tar(verify_ctx_t *ctx, verify_worker_t *w, const char *path) {
+  char header[TAR_BLOCK];
+  char longname[VERIFY_HOST_MAX] = {0};
+  char line[MAX_LINE_LEN] = {0};
+
+  for (;;) {
+    if (reader_fill(ctx->ops, w) != 0) {
+      return -1;
+    }
+    if (w->pos == w->len) {
+      return 0; /* No end-of-archive blocks, nothing is lost */
+    }
+    if (reader_take(ctx->ops, w, header, sizeof(header)) != 0) {
+      return -1;
+    }
+    if (header[0] == '\0') {
+      return 0;
+    }
+
+    uint64_t size = 0;
+    if (tar_size(header + TAR_SIZE_OFF, &size) != 0) {
+      errno = EINVAL;
+      (void)fprintf(stderr, "%s: error: %s: unsupported tar header\n",
+                    PROJECT_NAME, path);
+      return -1;
+    }
+    uint64_t padding = (TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK;
+    char type = header[TAR_TYPE_OFF];
+
+    if (type == 'L') {
+      uint64_t keep = size < sizeof(longname) ? size : sizeof(longname) - 1;
+      (void)memset(longname, 0, sizeof(longname));
+      if (reader_take(ctx->ops, w, longname, keep) != 0 ||
+          reader_take(ctx->ops, w, NULL, size - keep + padding) != 0) {
+        return -1;
+      }
+      continue;
+    }
+    if (type != '0' && type != '\0') {
+      longname[0] = '\0';
+      if (reader_take(ctx->ops, w, NULL, size + padding) != 0) {
+        return -1;
+      }
+      continue;
+    }
+
+    char name[TAR_PREFIX_LEN + 1 + TAR_NAME_LEN + 1] = {0};
+    if (longname[0] != '\0') {
+      (void)snprintf(name, sizeof(name), "%s", longname);
+    } else if (header[TAR_PREFIX_OFF] != '\0') {
+      (void)snprintf(name, sizeof(name), "%.*s/%.*s", TAR_PREFIX_LEN,
+                     header + TAR_PREFIX_OFF, TAR_NAME_LEN,
+                     header + TAR_NAME_OFF);
+    } else {
+      (void)snprintf(name, sizeof(name), "%.*s", TAR_NAME_LEN,
+                     header + TAR_NAME_OFF);
+    }
+    longname[0] = '\0';
+    const char *host = strncmp(name, "./", 2) == 0 ? name + 2 : name;
+    start_host(w, host, strlen(host));
+
+    w->bounded = true;
+    w->limit = size;
+    size_t lineno = 0;
+    bool overlong = false;
+    int got = 0;
+    while ((got = reader_line(ctx->ops, w, line, sizeof(line), &overlong)) ==
+           1) {
+      if (add_line(ctx, w, line, ++lineno, overlong) != 0) {
+        got = -1;
+        break;
+      }
+    }
+    uint64_t rest = w->limit;
+    w->bounded = false;
+    if (got < 0 || finish_host(ctx, w) != 0 ||
+        reader_take(ctx->ops, w, NULL, rest + padding) != 0) {
+      return -1;
+    }
+  }
+}
+
+/**
+ * read_input - Check every host of one input
+ * @ctx: Run state
+ * @w: Worker to read with
+ * @path: Input path, "-" for stdin
+ *
+ * Return: 0 on success, -1 on error (message printed)
+ */
+static int read_input(verify_ctx_t *ctx, verify_worker_t *w,
+                      const char *path) {
+  bool is_stdin = strcmp(path, "-") == 0;
+  w->fd = is_stdin ? STDIN_FILENO
+                   : ctx->ops->open(path, O_RDONLY | O_CLOEXEC);
+  if (w->fd < 0) {
+    (void)fprintf(stderr, "%s: error: cannot open %s: %s\n", PROJECT_NAME,
+                  path, strerror(errno));
+    return -1;
+  }
+  w->pos = 0;
+  w->len = 0;
+  w->eof = false;
+  w->bounded = false;
+
+  /* A tar archive starts with a header block carrying the ustar magic */
+  int ret = 0;
+  while (ret == 0 && w->len < TAR_BLOCK && !w->eof) {
+    ssize_t n = ctx->ops->read(w->fd, w->buf + w->len, TAR_BLOCK - w->len);
+    if (n < 0 && errno != EINTR) {
+      ret = -1;
+    }
+    if (n > 0) {
+      w->len += (size_t)n;
+    }
+    w->eof = n == 0;
+  }
+  if (ret == 0) {
+    bool tar = w->len == TAR_BLOCK &&
+               memcmp(w->buf + TAR_MAGIC_OFF, "ustar", 5) == 0;
+    ret = tar ? read_tar(ctx, w, path) : read_text(ctx, w, path);
+  }
+
+  int saved_errno = errno;
+  if (!is_stdin) {
+    (void)ctx->ops->close(w->fd);
+  }
+  if (ret != 0) {
+    (void)fprintf(stderr, "%s: error: cannot verify %s: %s\n", PROJECT_NAME,
+                  path, strerror(saved_errno));
+  }
+  errno = saved_errno;
+  return ret;
+}
+
+/**
+ * compare_missing - qsort(3) comparator for verify_missing_t by name
+ */
+static int compare_missing(const void *a, const void *b) {
+  const verify_missing_t *ma = a;
+  const verify_missing_t *mb = b;
+  return strcmp(ma->name, mb->name);
+}
+
+/**
+ * verify_worker - Check inputs until none are left
+ * @arg: verify_ctx_t shared with the other threads
+ *
+ * Return: 0, as a thrd_start_t
+ */
+static int verify_worker(void *arg) {
+  verify_ctx_t *ctx = arg;
+  verify_worker_t *w = ctx->ops->calloc(1, sizeof(*w));
+  if (w == NULL) {
+    atomic_store(&ctx->failed, true);
+    return 0;
+  }
+
+  for (;;) {
+    size_t i = atomic_fetch_add(&ctx->next, 1);
+    if (i >= ctx->count) {
+      break;
+    }
+    if (read_input(ctx, w, ctx->inputs[i]) != 0) {
+      atomic_store(&ctx->failed, true);
+    }
+  }
+
+  ctx->ops->free(w->entries);
+  ctx->ops->free(w->order);
+  ctx->ops->free(w->owners);
+  ctx->ops->free(w);
+  return 0;
+}
+
+/**
+ * report_missing - Report users absent from some of the hosts, by name
+ * @ctx: Run state, every worker finished
+ *
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int report_missing(verify_ctx_t *ctx) {
+  size_t missing = 0;
+  for (size_t i = 0; i < ctx->slots; i++) {
+    if (ctx->users[i].name != 0 && ctx->users[i].hosts < ctx->hosts) {
+      missing++;
+    }
+  }
+  if (missing == 0) {
+    return 0;
+  }
+
+  verify_missing_t *list = ctx->ops->calloc(missing, sizeof(*list));
+  if (list == NULL) {
+    errno = ENOMEM;
+    (void)fprintf(stderr, "%s: error: memory allocation failed\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+  size_t n = 0;
+  for (size_t i = 0; i < ctx->slots; i++) {
+    const verify_user_t *user = &ctx->users[i];
+    if (user->name != 0 && user->hosts < ctx->hosts) {
+      list[n++] = (verify_missing_t){
+          .name = ctx->names + user->name - 1,
+          .hosts = user->hosts,
+      };
+    }
+  }
+  if (n > 1) {
+    qsort(list, n, sizeof(*list), compare_missing);
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    (void)fprintf(ctx->out, "missing\t-\t%s\tabsent from %zu of %zu hosts\n",
+                  list[i].name, ctx->hosts - list[i].hosts, ctx->hosts);
+  }
+  ctx->findings += n;
+
+  ctx->ops->free(list);
+  return 0;
+}
+
+/**
+ * verify_run - Check subid dumps collected from many hosts
+ * @ops: Operations structure for system call abstraction
+ * @config: Loaded configuration
+ * @opts: Runtime options (inputs in @user_args, exactly one of --subuid
+ *        and --subgid, --jobs)
+ * @out: Output stream for findings and summaries
+ * @findings: Set to the total number of findings
+ *
+ * With no inputs stdin is read. An input that cannot be read is reported
+ * and the others are still checked, but the run then fails.
+ *
+ * Return: 0 if every input was checked (whatever was found), -1 on error
+ */
+int verify_run(const struct syscall_ops *ops, const config_t *config,
+               const options_t *opts, FILE *out, size_t *findings) {
+  if (ops == NULL || config == NULL || opts == NULL || out == NULL ||
+      findings == NULL || opts->do_subuid == opts->do_subgid) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: invalid parameter in verify_run\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  char dash[] = "-";
+  char *const from_stdin[] = {dash, NULL};
+  verify_ctx_t ctx = {
+      .ops = ops,
+      .config = config,
+      .subid_cfg = opts->do_subuid ? &config->subuid : &config->subgid,
+      .out = out,
+      .debug = opts->debug,
+      .inputs = opts->user_argc > 0 ? opts->user_args : from_stdin,
+      .count = opts->user_argc > 0 ? (size_t)opts->user_argc : 1,
+  };
+  atomic_init(&ctx.next, 0);
+  atomic_init(&ctx.failed, false);
+  *findings = 0;
+
+  if (mtx_init(&ctx.table_lock, mtx_plain) != thrd_success) {
+    // LCOV_EXCL_START
+    errno = ENOMEM;
+    return -1;
+    // LCOV_EXCL_STOP
+  }
+  if (mtx_init(&ctx.out_lock, mtx_plain) != thrd_success) {
+    // LCOV_EXCL_START
+    mtx_destroy(&ctx.table_lock);
+    errno = ENOMEM;
+    return -1;
+    // LCOV_EXCL_STOP
+  }
+
+  unsigned int jobs = opts->jobs == 0 ? 1 : opts->jobs;
+  size_t threads = jobs > RESOLVE_JOBS_MAX ? RESOLVE_JOBS_MAX : jobs;
+  if (threads > ctx.count) {
+    threads = ctx.count;
+  }
+
+  /* The calling thread is one of the workers */
+  thrd_t tids[RESOLVE_JOBS_MAX];
+  size_t started = 0;
+  while (started + 1 < threads) {
+    // LCOV_EXCL_START
+    if (thrd_create(&tids[started], verify_worker, &ctx) != thrd_success) {
+      break;
+    }
+    // LCOV_EXCL_STOP
+    started++;
+  }
+  (void)verify_worker(&ctx);
+  for (size_t i = 0; i < started; i++) {
+    (void)thrd_join(tids[i], NULL);
+  }
+
+  int ret = atomic_load(&ctx.failed) ? -1 : 0;
+  if (ctx.users != NULL && report_missing(&ctx) != 0) {
+    ret = -1;
+  }
+  (void)fprintf(out, "summary\tfleet\t%zu hosts\t%zu users\t%zu findings\n",
+                ctx.hosts, ctx.used, ctx.findings);
+  *findings = ctx.findings;
+
+  mtx_destroy(&ctx.out_lock);
+  mtx_destroy(&ctx.table_lock);
+  passwd_buf_free(ops, &ctx.scratch);
+  ops->free(ctx.users);
+  ops->free(ctx.names);
+  return ret;
+}
@@ -0,0 +1,207 @@
+/**
+ * wait.c - Block until a user's ranges have been committed
+ *
+ * Container runtimes and session scripts that start right after a login
+ * need the user's ranges, but must not take the write upon themselves.
+ * --wait lets them block on the exact event instead of polling
+ * getsubids(1): the directories holding SUBUID_PATH and SUBGID_PATH are
+ * watched with inotify, and each time one of the databases is replaced
+ * the same check as --check-only runs again.
+ *
+ * Ranges can also come from an NSS subid provider or land without an
+ * event we can see, so the check runs at least every WAIT_RECHECK_MS.
+ * Without inotify that interval is all there is.
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+/* Longest pause between two checks, event or not */
+enum { WAIT_RECHECK_MS = 1000 };
+
+/* Events that can mean a database was written */
+#define WAIT_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE)
+
+/* Drained per read(2); holds many events of the longest name */
+enum { WAIT_BUF_SIZE = 4096 };
+
+/**
+ * struct wait_watch_t - inotify watches on the selected databases
+ * @fd: inotify descriptor, -1 without inotify
+ * @name: Base name of each watched database
+ * @count: Databases in @name
+ */
+typedef struct {
+  int fd;
+  const char *name[2];
+  size_t count;
+} wait_watch_t;
+
+/*
+ * Forward declarations for internal functions
+ *
+ * We can use nonnull on static functions because they can only be called
+ * from inside here and we're careful to check the pointers in our visible
+ * function(s).
+ */
+static void watch_database(wait_watch_t *watch, const char *path,
+                           bool debug) __attribute__((nonnull(1, 2)));
+static bool watch_fired(const wait_watch_t *watch)
+    __attribute__((nonnull(1))) __attribute__((warn_unused_result));
+
+/**
+ * watch_database - Watch the directory holding @path for its replacement
+ * @watch: Watches to extend, @watch->fd open
+ * @path: Database path
+ * @debug: Enable debug output
+ *
+ * Databases are replaced by rename(2), so the directory is watched and
+ * events are told apart by name. A database that cannot be watched is
+ * still found by the periodic check.
+ */
+static void watch_database(wait_watch_t *watch, const char *path,
+                           bool debug) {
+  char dir[PATH_MAX] = {0};
+  const char *slash = strrchr(path, '/');
+  if (slash == NULL || (size_t)(slash - path) >= sizeof(dir)) {
+    return;
+  }
+  (void)memcpy(dir, path, slash == path ? 1 : (size_t)(slash - path));
+
+  /* Both databases usually live in /etc: one watch, two names */
+  if (inotify_add_watch(watch->fd, dir, WAIT_MASK) < 0) {
+    if (debug) {
+      (void)fprintf(stderr, "%s: debug: cannot watch %s: %s\n", PROJECT_NAME,
+                    dir, strerror(errno));
+    }
+    return;
+  }
+  watch->name[watch->count++] = slash + 1;
+}
+
+/**
+ * watch_fired - Drain the queued events and look for a database among them
+ * @watch: Watches from wait_for_ranges()
+ *
+ * Return: true if one of the watched databases was written
+ */
+static bool watch_fired(const wait_watch_t *watch) {
+  char buf[WAIT_BUF_SIZE]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+  bool fired = false;
+
+  for (;;) {
+    ssize_t len = read(watch->fd, buf, sizeof(buf));
+    if (len <= 0) {
+      /* EAGAIN once drained; an overflow is treated like an event */
+      return fired;
+    }
+
+    for (char *ptr = buf; ptr < buf + len;) {
+      const struct inotify_event *ev = (const struct inotify_event *)ptr;
+      for (size_t i = 0; i < watch->count && !fired; i++) {
+        fired = (ev->mask & IN_Q_OVERFLOW) != 0 ||
+                (ev->len > 0 && strcmp(ev->name, watch->name[i]) == 0);
+      }
+      ptr += sizeof(*ev) + ev->len;
+    }
+  }
+}
+
+/**
+ * wait_for_ranges - Block until the user's ranges are in place
+ * @ops: Operations structure for system call abstraction
+ * @username: Resolved username
+ * @uid: Resolved UID for @username
+ * @config: Loaded configuration
+ * @opts: Runtime options (selects --subuid and/or --subgid)
+ * @timeout_ms: Give up after this long, 0 to check only once
+ *
+ * Nothing is written: some other run (the daemon, a
+ * static-subid@.service instance, a PAM session) has to do that. The
+ * watches are set up before the first check, so a commit between the two
+ * cannot be missed.
+ *
+ * Return: 0 once every requested range is in place, -1 on error or when
+ *         @timeout_ms ran out (errno ETIMEDOUT)
+ */
+int wait_for_ranges(const struct syscall_ops *ops, const char *username,
+                    uint32_t uid, const config_t *config,
+                    const options_t *opts, unsigned int timeout_ms) {
+  if (ops == NULL || username == NULL || config == NULL || opts == NULL) {
+    errno = EINVAL;
+    (void)fprintf(stderr, "%s: error: NULL parameter in wait_for_ranges\n",
+                  PROJECT_NAME);
+    return -1;
+  }
+
+  wait_watch_t watch = {.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)};
+  if (watch.fd >= 0) {
+    if (opts->do_subuid) {
+      watch_database(&watch, SUBUID_PATH, opts->debug);
+    }
+    if (opts->do_subgid) {
+      watch_database(&watch, SUBGID_PATH, opts->debug);
+    }
+  } else if (opts->debug) {
+    (void)fprintf(stderr,
+                  "%s: debug: inotify unavailable, checking every %d ms\n",
+                  PROJECT_NAME, WAIT_RECHECK_MS);
+  }
+
+  uint64_t deadline = stats_now() + (uint64_t)timeout_ms * 1000;
+  int ret = -1;
+  for (;;) {
+    int done = enroll_user_check(ops, username, uid, config, opts);
+    if (done != 0) {
+      ret = done == 1 ? 0 : -1;
+      break;
+    }
+
+    uint64_t now = stats_now();
+    if (now >= deadline) {
+      errno = ETIMEDOUT;
+      (void)fprintf(stderr,
+                    "%s: error: ranges of %s not in place after %u ms\n",
+                    PROJECT_NAME, username, timeout_ms);
+      break;
+    }
+
+    /* Sleep until a database is written or it is time to look anyway */
+    uint64_t left_ms = (deadline - now + 999) / 1000;
+    uint64_t recheck = stats_now() + (left_ms < WAIT_RECHECK_MS
+                                          ? left_ms
+                                          : WAIT_RECHECK_MS) *
+                                         1000;
+    for (now = stats_now(); now < recheck; now = stats_now()) {
+      struct pollfd pfd = {.fd = watch.fd, .events = POLLIN, .revents = 0};
+      int ready = poll(&pfd, watch.fd >= 0 ? 1 : 0,
+                       (int)((recheck - now + 999) / 1000));
+      if (ready > 0 && watch_fired(&watch)) {
+        if (opts->debug) {
+          (void)fprintf(stderr, "%s: debug: database written, checking %s\n",
+                        PROJECT_NAME, username);
+        }
+        break;
+      }
+    }
+  }
+
+  if (watch.fd >= 0) {
+    (void)close(watch.fd);
+  }
+  return ret;
+}
@@ -11,6 +11,7 @@ Source0:	%{url}/archive/%{version}/%{name}-%{version}.tar.gz
 BuildRequires:  redhat-rpm-config systemd-rpm-macros
 BuildRequires:  cmake >= 3.21
 BuildRequires:  gcc
+BuildRequires:  pam-devel
 BuildRequires: (rubygem-asciidoctor or asciidoc )
 
 Requires:	shadow-utils
@@ -65,23 +66,29 @@ Provides a set of user-scoped systemd services that automatically allow a non-ro
 %config(noreplace) %{_sysconfdir}/%{name}/%{name}.conf
 %dir %{_sysconfdir}/%{name}/%{name}.conf.d
 %attr(0755,root,root) %{_libexecdir}/%{name}
+%{_libdir}/libsubid_static_subid.so
+%{_libdir}/security/pam_static_subid.so
+%dir %{_sharedstatedir}/%{name}
 
 %files systemd
 %doc docs/README.systemd
 %{_unitdir}/static-subid@.service
+%{_unitdir}/static-subid.service
+%{_unitdir}/static-subid.socket
 
 %post systemd
-%systemd_post static-subid@.service
+%systemd_post static-subid@.service static-subid.socket
 
 %preun systemd
-%systemd_preun static-subid@.service
+%systemd_preun static-subid@.service static-subid.socket static-subid.service
 
 %postun systemd
-%systemd_postun_with_restart static-subid@.service
+%systemd_postun_with_restart static-subid@.service static-subid.service
 
 %files systemd-user-permit
 %doc docs/README.systemd
 %{_userunitdir}/setup-static-subid.service
+%{_userunitdir}/request-static-subid.service
 %{_datarootdir}/polkit-1/rules.d/50-static-subid.rules
 
 %post systemd-user-permit
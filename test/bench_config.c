@@ -0,0 +1,189 @@
+/**
+ * bench_config.c - Microbenchmark for the configuration parser
+ *
+ * Loads a synthetic 10k line login.defs (mostly comments and keys this
+ * project ignores, as on a real system) through load_configuration() with
+ * reads served from memory, and compares it with the previous approach: an
+ * fgets(3) loop over the same bytes with a strcmp(3) chain over the keys.
+ *
+ * Not part of ctest; run with `cmake --build <dir> --target bench` from a
+ * -DCMAKE_BUILD_TYPE=Release tree, the default build is unoptimised.
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "test_helpers/all.h"
+
+/* Shape of the synthetic file and number of timed passes */
+enum { BENCH_LINES = 10000, BENCH_ITERATIONS = 200, BENCH_FD = 100 };
+
+/* Synthetic login.defs and the read position within it */
+static char *bench_content = NULL;
+static size_t bench_size = 0;
+static size_t bench_offset = 0;
+
+/**
+ * bench_open - Only login.defs exists
+ */
+static int bench_open(const char *pathname, int flags, ...) {
+  (void)flags;
+  if (strcmp(pathname, LOGIN_DEFS_PATH) == 0) {
+    bench_offset = 0;
+    return BENCH_FD;
+  }
+  errno = ENOENT;
+  return -1;
+}
+
+/**
+ * bench_read - Serve the synthetic file from memory
+ */
+static ssize_t bench_read(int fd, void *buf, size_t count) {
+  (void)fd;
+  size_t remaining = bench_size - bench_offset;
+  size_t to_copy = remaining < count ? remaining : count;
+  memcpy(buf, bench_content + bench_offset, to_copy);
+  bench_offset += to_copy;
+  return (ssize_t)to_copy;
+}
+
+/**
+ * build_content - Generate BENCH_LINES of login.defs-like text
+ *
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int build_content(void) {
+  size_t cap = (size_t)BENCH_LINES * 80;
+  bench_content = malloc(cap);
+  if (bench_content == NULL) {
+    return -1;
+  }
+
+  static const char *const unrelated[] = {
+      "MAIL_DIR        /var/spool/mail", "PASS_MAX_DAYS   99999",
+      "UMASK           022",             "ENCRYPT_METHOD  SHA512",
+      "CREATE_HOME     yes",             "USERGROUPS_ENAB yes"};
+  for (unsigned int i = 0; i < BENCH_LINES; i++) {
+    int len = 0;
+    if (i % 4 == 0) {
+      len = snprintf(bench_content + bench_size, cap - bench_size,
+                     "# Synthetic comment line number %u for the parser\n", i);
+    } else if (i % 4 == 1) {
+      len = snprintf(bench_content + bench_size, cap - bench_size, "\n");
+    } else if (i % 100 == 2) {
+      len = snprintf(bench_content + bench_size, cap - bench_size,
+                     "SUB_UID_MIN\t%u\n", 100000 + i);
+    } else {
+      len = snprintf(bench_content + bench_size, cap - bench_size, "%s\n",
+                     unrelated[i % (sizeof(unrelated) / sizeof(unrelated[0]))]);
+    }
+    bench_size += (size_t)len;
+  }
+  return 0;
+}
+
+/**
+ * now_ns - Monotonic clock in nanoseconds
+ */
+static uint64_t now_ns(void) {
+  struct timespec ts = {0};
+  (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * UINT64_C(1000000000) + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * bench_fgets_baseline - Line-at-a-time stdio and a linear key search
+ * @config: Supplies the key names, as the old strcmp() chain did
+ *
+ * Return: Lines naming a known key, so the work is not optimised out
+ */
+static size_t bench_fgets_baseline(const config_t *config) {
+  const char *const names[] = {
+      config->key_uid_min,          config->key_uid_max,
+      config->subuid.key_min,       config->subuid.key_max,
+      config->subuid.key_count,     config->subgid.key_min,
+      config->subgid.key_max,       config->subgid.key_count,
+      config->key_skip_if_exists,   config->key_allow_subid_wrap,
+      config->key_skip_if_exact,    config->key_subid_backend,
+      config->key_subid_writer};
+  FILE *fp = fmemopen(bench_content, bench_size, "r");
+  size_t keys = 0;
+  if (fp == NULL) {
+    return 0;
+  }
+
+  char line[MAX_LINE_LEN] = {0};
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    char *clean = normalize_config_line(line);
+    char *value = strpbrk(clean, " \t");
+    if (value == NULL) {
+      continue;
+    }
+    *value = '\0';
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+      if (strcmp(clean, names[i]) == 0) {
+        keys++;
+        break;
+      }
+    }
+  }
+  (void)fclose(fp);
+  return keys;
+}
+
+int main(void) {
+  if (build_content() != 0) {
+    (void)fprintf(stderr, "bench_config: cannot allocate content\n");
+    return EXIT_FAILURE;
+  }
+
+  struct syscall_ops ops = syscall_ops_default;
+  ops.open = bench_open;
+  ops.read = bench_read;
+  ops.close = mock_close_any;
+  ops.fstat = mock_fstat_root_file;
+  ops.openat = mock_openat_enoent;
+
+  config_t config = {0};
+  uint64_t start = now_ns();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    if (load_configuration(&ops, &config, false) != 0) {
+      (void)fprintf(stderr, "bench_config: load_configuration failed\n");
+      (void)free(bench_content);
+      return EXIT_FAILURE;
+    }
+  }
+  uint64_t parser_ns = now_ns() - start;
+
+  size_t keys = 0;
+  start = now_ns();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    keys += bench_fgets_baseline(&config);
+  }
+  uint64_t baseline_ns = now_ns() - start;
+
+  uint64_t lines = (uint64_t)BENCH_LINES * BENCH_ITERATIONS;
+  (void)printf("login.defs: %d lines, %zu bytes, %d passes\n", BENCH_LINES,
+               bench_size, BENCH_ITERATIONS);
+  (void)printf("load_configuration: %8.1f ns/line (SUB_UID_MIN=%u)\n",
+               (double)parser_ns / (double)lines, config.subuid.min_val);
+  (void)printf("fgets baseline:     %8.1f ns/line (%zu known keys)\n",
+               (double)baseline_ns / (double)lines, keys / BENCH_ITERATIONS);
+
+  (void)free(bench_content);
+  return EXIT_SUCCESS;
+}
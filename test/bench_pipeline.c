@@ -0,0 +1,1141 @@
+/**
+ * bench_pipeline.c - End-to-end latency of the enrollment pipeline
+ *
+ * Times each phase main() runs for one user, through the same entry
+ * points: load_configuration(), resolve_user(), the existence check,
+ * calc_subid_range() and the write (enroll_user() with the existence check
+ * off). It reports p50/p99 wall time per phase, and batch throughput in
+ * users per second.
+ *
+ * Two setups are measured:
+ * - mock: every call goes through syscall_ops mocks, with optional latency
+ *   injected into getpwnam_r(3), posix_spawn(3) and read(2) (-P, -S, -R, in
+ *   microseconds) to model a slow NSS backend, helper startup or storage.
+ *   The existence check and the write spawn getsubids(1) and usermod(8).
+ * - real: syscall_ops_default under a throwaway root made with mkdtemp(3).
+ *   Absolute paths are redirected below it, so the configuration, drop-ins
+ *   and subuid/subgid files are real files read and rewritten with real
+ *   system calls (SUBID_BACKEND files, SUBID_WRITER files). Only what would
+ *   reach outside the root is replaced: lckpwdf(3) takes no lock, fchown(2)
+ *   keeps the owner, and files owned by the invoking user pass as root's.
+ *   resolve_user() asks the real NSS for "root".
+ *
+ * Batch throughput uses the mock setup with batch_run_stream(), for each
+ * size given to -u (default 1000, 10000 and 100000 users).
+ *
+ * With -b FILE the results are compared with a baseline written earlier by
+ * -w FILE, and the exit status is 1 when a p99 grew, or a throughput fell,
+ * by more than -t percent (default 20). CMake's BENCH_BASELINE and
+ * BENCH_THRESHOLD pass these for the bench target, so a regression fails
+ * the build.
+ *
+ * Not part of ctest; run with `cmake --build <dir> --target bench` from a
+ * -DCMAKE_BUILD_TYPE=Release tree, the default build is unoptimised.
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdalign.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "test_helpers/all.h"
+
+/* Passes per phase, drop-ins per setup and lines seeded per database */
+enum { BENCH_PASSES = 200, BENCH_DROPINS = 8, BENCH_SEED_USERS = 1000 };
+
+/* Largest batch size and number of sizes -u accepts */
+enum { BENCH_BATCH_MAX = 1000000, BENCH_BATCH_SIZES = 8 };
+
+/* First UID handed out to synthetic users */
+enum { BENCH_UID_BASE = 10000 };
+
+/* Mock descriptors, one per kind of file */
+enum {
+  BENCH_FD_LOGIN_DEFS = 100,
+  BENCH_FD_MAIN_CONFIG,
+  BENCH_FD_DROPIN_DIR,
+  BENCH_FD_DROPIN,
+  BENCH_FD_END
+};
+
+/* Results kept for the baseline comparison */
+enum { BENCH_RESULTS_MAX = 32 };
+
+/* Phases timed for one user, in pipeline order */
+enum {
+  PHASE_CONFIG,
+  PHASE_RESOLVE,
+  PHASE_EXISTS,
+  PHASE_CALC,
+  PHASE_WRITE,
+  PHASES
+};
+
+static const char *const phase_names[PHASES] = {
+    "config_load", "resolve_user", "exists_check", "range_calc", "write"};
+
+/* Shared by the setups: wide enough for BENCH_BATCH_MAX users */
+static const char *const BENCH_MAIN_CONFIG = "UID_MIN 10000\n"
+                                             "UID_MAX 2000000\n"
+                                             "SUB_UID_MIN 10000000\n"
+                                             "SUB_UID_MAX 4000000000\n"
+                                             "SUB_UID_COUNT 1000\n"
+                                             "SUB_GID_MIN 10000000\n"
+                                             "SUB_GID_MAX 4000000000\n"
+                                             "SUB_GID_COUNT 1000\n"
+                                             "SKIP_IF_EXISTS yes\n";
+
+static const char *const BENCH_DROPIN = "SUB_UID_COUNT 1000\n";
+
+/**
+ * struct bench_latency - Delays injected by the mock setup
+ * @getpwnam_us: Added to every getpwnam_r(3)
+ * @spawn_us: Added to every posix_spawn(3)
+ * @read_us: Added to every read(2)
+ */
+static struct {
+  unsigned int getpwnam_us;
+  unsigned int spawn_us;
+  unsigned int read_us;
+} latency = {0};
+
+/**
+ * struct bench_result - One measurement for the baseline
+ * @key: "<setup>.<metric>"
+ * @value: p99 in nanoseconds, or users per second for batch runs
+ * @higher_is_better: Throughput rather than latency
+ */
+typedef struct {
+  char key[64];
+  double value;
+  bool higher_is_better;
+} bench_result_t;
+
+static bench_result_t results[BENCH_RESULTS_MAX];
+static size_t result_count = 0;
+
+/* Synthetic login.defs served by the mock setup */
+static char *login_defs = NULL;
+static size_t login_defs_size = 0;
+
+/* Read position of each mock descriptor */
+static size_t mock_offset[BENCH_FD_END - BENCH_FD_LOGIN_DEFS];
+
+/* Next drop-in the mock directory lists */
+static size_t mock_dir_pos = 0;
+
+/* Throwaway root of the real setup */
+static char real_root[PATH_MAX];
+
+/* ============================================================================
+ * Timing
+ * ============================================================================
+ */
+
+/**
+ * now_ns - Monotonic clock in nanoseconds
+ */
+static uint64_t now_ns(void) {
+  struct timespec ts = {0};
+  (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * UINT64_C(1000000000) + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * delay_us - Sleep for an injected latency
+ * @us: Microseconds, 0 for none
+ */
+static void delay_us(unsigned int us) {
+  if (us == 0) {
+    return;
+  }
+  struct timespec ts = {.tv_sec = us / 1000000,
+                        .tv_nsec = (long)(us % 1000000) * 1000L};
+  while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+  }
+}
+
+/**
+ * compare_u64 - qsort(3) comparator for samples
+ */
+static int compare_u64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a;
+  uint64_t y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * percentile - Sample at @pct percent of sorted @samples
+ */
+static uint64_t percentile(const uint64_t *samples, size_t n,
+                           unsigned int pct) {
+  size_t idx = n * pct / 100;
+  return samples[idx < n ? idx : n - 1];
+}
+
+/**
+ * add_result - Record a measurement for the baseline
+ */
+static void add_result(const char *setup, const char *metric, double value,
+                       bool higher_is_better) {
+  if (result_count == BENCH_RESULTS_MAX) {
+    return;
+  }
+  bench_result_t *r = &results[result_count++];
+  (void)snprintf(r->key, sizeof(r->key), "%s.%s", setup, metric);
+  r->value = value;
+  r->higher_is_better = higher_is_better;
+}
+
+/**
+ * report_phase - Sort a phase's samples, print and record them
+ */
+static void report_phase(const char *setup, unsigned int phase,
+                         uint64_t *samples, size_t n) {
+  qsort(samples, n, sizeof(*samples), compare_u64);
+  uint64_t p50 = percentile(samples, n, 50);
+  uint64_t p99 = percentile(samples, n, 99);
+
+  (void)printf("%-5s %-13s p50 %10.1f us  p99 %10.1f us\n", setup,
+               phase_names[phase], (double)p50 / 1000.0,
+               (double)p99 / 1000.0);
+
+  char metric[40];
+  (void)snprintf(metric, sizeof(metric), "%s.p99_ns", phase_names[phase]);
+  add_result(setup, metric, (double)p99, false);
+}
+
+/* ============================================================================
+ * Mock Setup
+ * ============================================================================
+ */
+
+/**
+ * build_login_defs - Generate a login.defs like a distribution ships
+ *
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int build_login_defs(void) {
+  static const char *const lines[] = {
+      "# Synthetic /etc/login.defs for the pipeline benchmark",
+      "MAIL_DIR        /var/spool/mail", "PASS_MAX_DAYS   99999",
+      "UMASK           022", "ENCRYPT_METHOD  SHA512",
+      "UID_MIN 1000", "UID_MAX 60000", "SUB_UID_COUNT 65536",
+      "SUB_GID_COUNT 65536", "CREATE_HOME     yes"};
+  size_t cap = 64 * 1024;
+
+  login_defs = malloc(cap);
+  if (login_defs == NULL) {
+    return -1;
+  }
+  for (unsigned int i = 0; i < 300; i++) {
+    int len = snprintf(login_defs + login_defs_size, cap - login_defs_size,
+                       "%s\n", lines[i % (sizeof(lines) / sizeof(lines[0]))]);
+    login_defs_size += (size_t)len;
+  }
+  return 0;
+}
+
+/**
+ * mock_content - Content behind a mock descriptor
+ */
+static const char *mock_content(int fd, size_t *size) {
+  switch (fd) {
+  case BENCH_FD_LOGIN_DEFS:
+    *size = login_defs_size;
+    return login_defs;
+  case BENCH_FD_MAIN_CONFIG:
+    *size = strlen(BENCH_MAIN_CONFIG);
+    return BENCH_MAIN_CONFIG;
+  case BENCH_FD_DROPIN:
+    *size = strlen(BENCH_DROPIN);
+    return BENCH_DROPIN;
+  default:
+    *size = 0;
+    return NULL;
+  }
+}
+
+/**
+ * mock_open - login.defs and the main configuration exist
+ */
+static int mock_open(const char *pathname, int flags, ...) {
+  (void)flags;
+  int fd = -1;
+  if (strcmp(pathname, LOGIN_DEFS_PATH) == 0) {
+    fd = BENCH_FD_LOGIN_DEFS;
+  } else if (strcmp(pathname, CONFIG_FILE_PATH) == 0) {
+    fd = BENCH_FD_MAIN_CONFIG;
+  } else {
+    errno = ENOENT;
+    return -1;
+  }
+  mock_offset[fd - BENCH_FD_LOGIN_DEFS] = 0;
+  return fd;
+}
+
+/**
+ * mock_openat - The drop-in directory holds BENCH_DROPINS files
+ */
+static int mock_openat(int dirfd, const char *pathname, int flags, ...) {
+  (void)flags;
+  if (dirfd == AT_FDCWD && strcmp(pathname, CONFIG_DROPIN_DIR_PATH) == 0) {
+    mock_dir_pos = 0;
+    return BENCH_FD_DROPIN_DIR;
+  }
+  if (dirfd == BENCH_FD_DROPIN_DIR) {
+    mock_offset[BENCH_FD_DROPIN - BENCH_FD_LOGIN_DEFS] = 0;
+    return BENCH_FD_DROPIN;
+  }
+  errno = ENOENT;
+  return -1;
+}
+
+/**
+ * mock_getdents64 - List the drop-ins, one record per call
+ */
+static ssize_t mock_getdents64(int fd, void *dirp, size_t count) {
+  (void)fd;
+  if (mock_dir_pos == BENCH_DROPINS) {
+    return 0;
+  }
+
+  char name[32];
+  int len = snprintf(name, sizeof(name), "%02zu-bench.conf", mock_dir_pos);
+  size_t reclen = offsetof(struct dirent64, d_name) + (size_t)len + 1;
+  reclen = (reclen + alignof(struct dirent64) - 1) &
+           ~(alignof(struct dirent64) - 1);
+  if (reclen > count) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  struct dirent64 *entry = dirp;
+  memset(entry, 0, reclen);
+  entry->d_reclen = (unsigned short)reclen;
+  memcpy(entry->d_name, name, (size_t)len + 1);
+  mock_dir_pos++;
+  return (ssize_t)reclen;
+}
+
+/**
+ * mock_fstat - The drop-in directory and root-owned regular files
+ */
+static int mock_fstat(int fd, struct stat *statbuf) {
+  if (fd == BENCH_FD_DROPIN_DIR) {
+    return mock_fstat_root_dir(fd, statbuf);
+  }
+  return mock_fstat_root_file(fd, statbuf);
+}
+
+/**
+ * mock_read - Serve the mock file contents, after the injected latency
+ */
+static ssize_t mock_read(int fd, void *buf, size_t count) {
+  size_t size = 0;
+  const char *content = mock_content(fd, &size);
+  if (content == NULL) {
+    errno = EBADF;
+    return -1;
+  }
+
+  delay_us(latency.read_us);
+  size_t *offset = &mock_offset[fd - BENCH_FD_LOGIN_DEFS];
+  size_t to_copy = size - *offset < count ? size - *offset : count;
+  memcpy(buf, content + *offset, to_copy);
+  *offset += to_copy;
+  return (ssize_t)to_copy;
+}
+
+/**
+ * mock_fill_passwd - Fill @pwd for a synthetic user
+ */
+static int mock_fill_passwd(const char *name, uid_t uid, struct passwd *pwd,
+                            char *buf, size_t buflen,
+                            struct passwd **result) {
+  int len = snprintf(buf, buflen, "%s", name);
+  if (len < 0 || (size_t)len >= buflen) {
+    *result = NULL;
+    return ERANGE;
+  }
+  *pwd = (struct passwd){.pw_name = buf, .pw_uid = uid, .pw_gid = uid};
+  *result = pwd;
+  return 0;
+}
+
+/**
+ * mock_getpwnam_r - "benchN" is UID BENCH_UID_BASE + N
+ */
+static int mock_getpwnam_r(const char *name, struct passwd *pwd, char *buf,
+                           size_t buflen, struct passwd **result) {
+  unsigned long n = 0;
+  char *end = NULL;
+
+  delay_us(latency.getpwnam_us);
+  if (strncmp(name, "bench", 5) != 0 ||
+      (n = strtoul(name + 5, &end, 10), *end != '\0') ||
+      n > BENCH_BATCH_MAX) {
+    *result = NULL;
+    return 0;
+  }
+  return mock_fill_passwd(name, (uid_t)(BENCH_UID_BASE + n), pwd, buf,
+                          buflen, result);
+}
+
+/**
+ * mock_getpwuid_r - The synthetic user owning @uid
+ */
+static int mock_getpwuid_r(uid_t uid, struct passwd *pwd, char *buf,
+                           size_t buflen, struct passwd **result) {
+  char name[32];
+  if (uid < BENCH_UID_BASE || uid > BENCH_UID_BASE + BENCH_BATCH_MAX) {
+    *result = NULL;
+    return 0;
+  }
+  (void)snprintf(name, sizeof(name), "bench%u", uid - BENCH_UID_BASE);
+  return mock_fill_passwd(name, uid, pwd, buf, buflen, result);
+}
+
+/**
+ * mock_posix_spawn - Start nothing after the injected latency
+ *
+ * Odd PIDs are getsubids(1), which finds no ranges; even ones usermod(8).
+ */
+static int mock_posix_spawn(pid_t *restrict pid, const char *restrict path,
+                            const posix_spawn_file_actions_t *file_actions,
+                            const posix_spawnattr_t *restrict attrp,
+                            char *const argv[restrict],
+                            char *const envp[restrict]) {
+  static pid_t next = 1000;
+  (void)file_actions;
+  (void)attrp;
+  (void)argv;
+  (void)envp;
+
+  delay_us(latency.spawn_us);
+  next += 2;
+  *pid = next + (strcmp(path, GETSUBIDS_PATH) == 0 ? 1 : 0);
+  return 0;
+}
+
+/**
+ * mock_waitpid - getsubids(1) exits 1 (no ranges), usermod(8) exits 0
+ */
+static pid_t mock_waitpid(pid_t pid, int *wstatus, int options) {
+  (void)options;
+  *wstatus = (pid % 2 != 0 ? 1 : 0) << 8;
+  return pid;
+}
+
+/**
+ * make_mock_ops - Operations of the mock setup
+ */
+static struct syscall_ops make_mock_ops(void) {
+  struct syscall_ops ops = syscall_ops_default;
+  ops.open = mock_open;
+  ops.openat = mock_openat;
+  ops.getdents64 = mock_getdents64;
+  ops.close = mock_close_any;
+  ops.fstat = mock_fstat;
+  ops.read = mock_read;
+  ops.getpwnam_r = mock_getpwnam_r;
+  ops.getpwuid_r = mock_getpwuid_r;
+  ops.posix_spawn = mock_posix_spawn;
+  ops.waitpid = mock_waitpid;
+  return ops;
+}
+
+/* ============================================================================
+ * Real Setup
+ * ============================================================================
+ */
+
+/**
+ * rooted - Redirect an absolute path below the throwaway root
+ * @path: Path as the code under test names it
+ * @buf: Storage for the redirected path
+ * @size: Size of @buf
+ *
+ * Return: Path to pass to the real system call
+ */
+static const char *rooted(const char *path, char *buf, size_t size) {
+  if (path[0] != '/') {
+    return path;
+  }
+  int len = snprintf(buf, size, "%s%s", real_root, path);
+  if (len < 0 || (size_t)len >= size) {
+    return path;
+  }
+  return buf;
+}
+
+/**
+ * real_open - open(2) below the throwaway root
+ */
+static int real_open(const char *pathname, int flags, ...) {
+  char buf[PATH_MAX];
+  mode_t mode = 0;
+  if ((flags & (O_CREAT | O_TMPFILE)) != 0) {
+    va_list ap;
+    va_start(ap, flags);
+    mode = (mode_t)va_arg(ap, unsigned int);
+    va_end(ap);
+  }
+  return open(rooted(pathname, buf, sizeof(buf)), flags, mode);
+}
+
+/**
+ * real_openat - openat(2), absolute paths below the throwaway root
+ */
+static int real_openat(int dirfd, const char *pathname, int flags, ...) {
+  char buf[PATH_MAX];
+  mode_t mode = 0;
+  if ((flags & (O_CREAT | O_TMPFILE)) != 0) {
+    va_list ap;
+    va_start(ap, flags);
+    mode = (mode_t)va_arg(ap, unsigned int);
+    va_end(ap);
+  }
+  return openat(dirfd, rooted(pathname, buf, sizeof(buf)), flags, mode);
+}
+
+/**
+ * as_root - Files of the invoking user pass the root ownership checks
+ */
+static void as_root(struct stat *statbuf) {
+  if (statbuf->st_uid == geteuid()) {
+    statbuf->st_uid = 0;
+  }
+}
+
+/**
+ * real_stat - stat(2) below the throwaway root
+ */
+static int real_stat(const char *pathname, struct stat *statbuf) {
+  char buf[PATH_MAX];
+  int ret = stat(rooted(pathname, buf, sizeof(buf)), statbuf);
+  if (ret == 0) {
+    as_root(statbuf);
+  }
+  return ret;
+}
+
+/**
+ * real_lstat - lstat(2) below the throwaway root
+ */
+static int real_lstat(const char *pathname, struct stat *statbuf) {
+  char buf[PATH_MAX];
+  int ret = lstat(rooted(pathname, buf, sizeof(buf)), statbuf);
+  if (ret == 0) {
+    as_root(statbuf);
+  }
+  return ret;
+}
+
+/**
+ * real_fstat - fstat(2)
+ */
+static int real_fstat(int fd, struct stat *statbuf) {
+  int ret = fstat(fd, statbuf);
+  if (ret == 0) {
+    as_root(statbuf);
+  }
+  return ret;
+}
+
+/**
+ * real_rename - rename(2) below the throwaway root
+ */
+static int real_rename(const char *oldpath, const char *newpath) {
+  char oldbuf[PATH_MAX];
+  char newbuf[PATH_MAX];
+  return rename(rooted(oldpath, oldbuf, sizeof(oldbuf)),
+                rooted(newpath, newbuf, sizeof(newbuf)));
+}
+
+/**
+ * real_unlink - unlink(2) below the throwaway root
+ */
+static int real_unlink(const char *pathname) {
+  char buf[PATH_MAX];
+  return unlink(rooted(pathname, buf, sizeof(buf)));
+}
+
+/**
+ * real_mkdir - mkdir(2) below the throwaway root
+ */
+static int real_mkdir(const char *pathname, mode_t mode) {
+  char buf[PATH_MAX];
+  return mkdir(rooted(pathname, buf, sizeof(buf)), mode);
+}
+
+/**
+ * real_fchown - Keep the owner, the benchmark need not run as root
+ */
+static int real_fchown(int fd, uid_t owner, gid_t group) {
+  (void)owner;
+  (void)group;
+  return fchown(fd, (uid_t)-1, (gid_t)-1);
+}
+
+/**
+ * real_lckpwdf - Take no lock, /etc/.pwd.lock lies outside the root
+ */
+static int real_lckpwdf(void) { return 0; }
+
+/**
+ * make_real_ops - Operations of the real setup
+ */
+static struct syscall_ops make_real_ops(void) {
+  struct syscall_ops ops = syscall_ops_default;
+  ops.open = real_open;
+  ops.openat = real_openat;
+  ops.stat = real_stat;
+  ops.lstat = real_lstat;
+  ops.fstat = real_fstat;
+  ops.rename = real_rename;
+  ops.unlink = real_unlink;
+  ops.mkdir = real_mkdir;
+  ops.fchown = real_fchown;
+  ops.lckpwdf = real_lckpwdf;
+  ops.ulckpwdf = real_lckpwdf;
+  return ops;
+}
+
+/**
+ * make_parents - mkdir -p for the directory part of @path
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int make_parents(const char *path) {
+  char buf[PATH_MAX];
+  int len = snprintf(buf, sizeof(buf), "%s", path);
+  if (len < 0 || (size_t)len >= sizeof(buf)) {
+    return -1;
+  }
+  for (char *p = buf + strlen(real_root) + 1; *p != '\0'; p++) {
+    if (*p == '/') {
+      *p = '\0';
+      if (mkdir(buf, 0755) != 0 && errno != EEXIST) {
+        return -1;
+      }
+      *p = '/';
+    }
+  }
+  return 0;
+}
+
+/**
+ * write_rooted - Create a file below the throwaway root
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int write_rooted(const char *path, const char *content) {
+  char buf[PATH_MAX];
+  const char *target = rooted(path, buf, sizeof(buf));
+  if (make_parents(target) != 0) {
+    return -1;
+  }
+  FILE *fp = fopen(target, "w");
+  if (fp == NULL) {
+    return -1;
+  }
+  int ret = fputs(content, fp) < 0 ? -1 : 0;
+  return fclose(fp) != 0 ? -1 : ret;
+}
+
+/**
+ * seed_database - Fill a database with BENCH_SEED_USERS entries
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int seed_database(const char *path) {
+  char buf[PATH_MAX];
+  const char *target = rooted(path, buf, sizeof(buf));
+  if (make_parents(target) != 0) {
+    return -1;
+  }
+  FILE *fp = fopen(target, "w");
+  if (fp == NULL) {
+    return -1;
+  }
+  for (unsigned int i = 0; i < BENCH_SEED_USERS; i++) {
+    (void)fprintf(fp, "seed%u:%u:1000\n", i, 10000000U + i * 1000U);
+  }
+  return fclose(fp);
+}
+
+/**
+ * build_real_root - Create the throwaway root and its files
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int build_real_root(void) {
+  const char *tmp = getenv("TMPDIR");
+  int len = snprintf(real_root, sizeof(real_root), "%s/bench-pipeline.XXXXXX",
+                     tmp != NULL && tmp[0] != '\0' ? tmp : "/tmp");
+  if (len < 0 || (size_t)len >= sizeof(real_root) ||
+      mkdtemp(real_root) == NULL) {
+    real_root[0] = '\0';
+    return -1;
+  }
+
+  if (write_rooted(LOGIN_DEFS_PATH, login_defs) != 0 ||
+      write_rooted(CONFIG_FILE_PATH, BENCH_MAIN_CONFIG) != 0 ||
+      seed_database(SUBUID_PATH) != 0 || seed_database(SUBGID_PATH) != 0) {
+    return -1;
+  }
+  for (unsigned int i = 0; i < BENCH_DROPINS; i++) {
+    char path[PATH_MAX];
+    (void)snprintf(path, sizeof(path), "%s/%02u-bench.conf",
+                   CONFIG_DROPIN_DIR_PATH, i);
+    if (write_rooted(path, BENCH_DROPIN) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * remove_entry - nftw(3) callback deleting everything it visits
+ */
+static int remove_entry(const char *path, const struct stat *sb, int type,
+                        struct FTW *ftw) {
+  (void)sb;
+  (void)type;
+  (void)ftw;
+  return remove(path);
+}
+
+/**
+ * remove_real_root - Delete the throwaway root
+ */
+static void remove_real_root(void) {
+  if (real_root[0] != '\0') {
+    (void)nftw(real_root, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+  }
+}
+
+/* ============================================================================
+ * Phases
+ * ============================================================================
+ */
+
+/**
+ * run_phases - Time every phase of one enrollment @passes times
+ * @setup: "mock" or "real"
+ * @ops: Operations of the setup
+ * @resolve_arg: User resolve_user() is asked for
+ * @passes: Samples per phase
+ *
+ * Each pass enrolls a user of its own, so the write always has work to
+ * do and the real databases grow by one entry per pass, as on a system
+ * enrolling new users.
+ *
+ * Return: 0 on success, -1 if a phase failed
+ */
+static int run_phases(const char *setup, const struct syscall_ops *ops,
+                      const char *resolve_arg, size_t passes) {
+  uint64_t *samples = calloc(passes * PHASES, sizeof(*samples));
+  config_t config = {0};
+  options_t opts = {.do_subuid = true, .do_subgid = true};
+  bool real = strcmp(setup, "real") == 0;
+
+  if (samples == NULL) {
+    return -1;
+  }
+
+  for (size_t i = 0; i < passes; i++) {
+    uint64_t *sample = samples + i * PHASES;
+    char username[LOGIN_NAME_MAX] = {0};
+    char name[32];
+    uint32_t uid = 0;
+    uint32_t start = 0;
+
+    uint64_t t = now_ns();
+    if (load_configuration(ops, &config, false) != 0) {
+      (void)fprintf(stderr, "bench_pipeline: %s: config load failed\n",
+                    setup);
+      (void)free(samples);
+      return -1;
+    }
+    sample[PHASE_CONFIG] = now_ns() - t;
+
+    t = now_ns();
+    if (resolve_user(ops, resolve_arg, &uid, username, sizeof(username),
+                     config.resolve_timeout_ms, false) != 0) {
+      (void)fprintf(stderr, "bench_pipeline: %s: resolve_user failed\n",
+                    setup);
+      (void)free(samples);
+      return -1;
+    }
+    sample[PHASE_RESOLVE] = now_ns() - t;
+
+    /* Enroll a fresh user rather than the one resolved (root for real) */
+    uid = (uint32_t)(BENCH_UID_BASE + BENCH_SEED_USERS + i);
+    (void)snprintf(name, sizeof(name), "bench%u", uid - BENCH_UID_BASE);
+
+    t = now_ns();
+    int exists = real ? subid_db_check_exists(ops, name, uid, SUBUID, false)
+                      : check_subid_exists(ops, name, SUBUID, false);
+    sample[PHASE_EXISTS] = now_ns() - t;
+    if (exists != 0) {
+      (void)fprintf(stderr, "bench_pipeline: %s: existence check failed\n",
+                    setup);
+      (void)free(samples);
+      return -1;
+    }
+
+    t = now_ns();
+    if (calc_subid_range(uid, config.uid_min, &config.subuid,
+                         config.allow_subid_wrap, &start) != 0) {
+      (void)fprintf(stderr, "bench_pipeline: %s: range calc failed\n", setup);
+      (void)free(samples);
+      return -1;
+    }
+    sample[PHASE_CALC] = now_ns() - t;
+
+    /* Only the write: the existence check was timed on its own */
+    config.skip_if_exists = false;
+    config.subid_writer = real ? SUBID_WRITER_FILES : SUBID_WRITER_USERMOD;
+    t = now_ns();
+    if (enroll_user(ops, name, uid, &config, &opts) != 0) {
+      (void)fprintf(stderr, "bench_pipeline: %s: write failed\n", setup);
+      (void)free(samples);
+      return -1;
+    }
+    sample[PHASE_WRITE] = now_ns() - t;
+  }
+
+  /* Gather each phase's samples together for sorting */
+  uint64_t *column = calloc(passes, sizeof(*column));
+  if (column == NULL) {
+    (void)free(samples);
+    return -1;
+  }
+  for (unsigned int phase = 0; phase < PHASES; phase++) {
+    for (size_t i = 0; i < passes; i++) {
+      column[i] = samples[i * PHASES + phase];
+    }
+    report_phase(setup, phase, column, passes);
+  }
+
+  (void)free(column);
+  (void)free(samples);
+  return 0;
+}
+
+/**
+ * run_batch - Time batch_run_stream() over @users synthetic users
+ * @ops: Operations of the mock setup
+ * @users: Number of entries
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int run_batch(const struct syscall_ops *ops, size_t users) {
+  size_t cap = users * 16 + 1;
+  char *input = malloc(cap);
+  size_t len = 0;
+  config_t config = {0};
+  options_t opts = {.do_subuid = true, .do_subgid = true, .batch = true};
+  batch_stats_t stats = {0};
+
+  if (input == NULL) {
+    return -1;
+  }
+  for (size_t i = 0; i < users; i++) {
+    len += (size_t)snprintf(input + len, cap - len, "bench%zu\n", i);
+  }
+  FILE *fp = fmemopen(input, len, "r");
+  if (fp == NULL || load_configuration(ops, &config, false) != 0) {
+    if (fp != NULL) {
+      (void)fclose(fp);
+    }
+    (void)free(input);
+    return -1;
+  }
+
+  /* The per-entry status lines go to /dev/null, writing them is timed */
+  (void)fflush(stdout);
+  int saved_stdout = dup(STDOUT_FILENO);
+  int devnull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+  if (saved_stdout >= 0 && devnull >= 0) {
+    (void)dup2(devnull, STDOUT_FILENO);
+  }
+
+  /* As run_batch() in main.c does */
+  (void)spawn_ctx_install(ops, false);
+  uint64_t t = now_ns();
+  int ret = batch_run_stream(ops, &config, &opts, fp, &stats);
+  (void)fflush(stdout);
+  uint64_t elapsed = now_ns() - t;
+  spawn_ctx_uninstall(ops);
+
+  if (saved_stdout >= 0) {
+    (void)dup2(saved_stdout, STDOUT_FILENO);
+    (void)close(saved_stdout);
+  }
+  if (devnull >= 0) {
+    (void)close(devnull);
+  }
+  (void)fclose(fp);
+  (void)free(input);
+
+  if (ret != 0 || stats.failed != 0) {
+    (void)fprintf(stderr, "bench_pipeline: batch of %zu failed (%zu)\n",
+                  users, stats.failed);
+    return -1;
+  }
+
+  double per_sec = (double)users / ((double)elapsed / 1e9);
+  (void)printf("mock  batch %-7zu %12.0f users/s\n", users, per_sec);
+
+  char metric[40];
+  (void)snprintf(metric, sizeof(metric), "batch_%zu.users_per_s", users);
+  add_result("mock", metric, per_sec, true);
+  return 0;
+}
+
+/* ============================================================================
+ * Baseline
+ * ============================================================================
+ */
+
+/**
+ * write_baseline - Save the results for a later -b
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int write_baseline(const char *path) {
+  FILE *fp = fopen(path, "w");
+  if (fp == NULL) {
+    (void)fprintf(stderr, "bench_pipeline: cannot write %s: %s\n", path,
+                  strerror(errno));
+    return -1;
+  }
+  for (size_t i = 0; i < result_count; i++) {
+    (void)fprintf(fp, "%s %.0f\n", results[i].key, results[i].value);
+  }
+  return fclose(fp);
+}
+
+/**
+ * check_baseline - Compare the results with a saved baseline
+ * @path: File from -w
+ * @threshold: Allowed change in percent
+ *
+ * Metrics missing from either side are skipped.
+ *
+ * Return: Number of regressions, -1 if @path cannot be read
+ */
+static int check_baseline(const char *path, double threshold) {
+  FILE *fp = fopen(path, "r");
+  char key[64];
+  double base = 0;
+  int regressions = 0;
+
+  if (fp == NULL) {
+    (void)fprintf(stderr, "bench_pipeline: cannot read %s: %s\n", path,
+                  strerror(errno));
+    return -1;
+  }
+
+  double factor = 1.0 + threshold / 100.0;
+  while (fscanf(fp, "%63s %lf", key, &base) == 2) {
+    for (size_t i = 0; i < result_count; i++) {
+      const bench_result_t *r = &results[i];
+      if (strcmp(r->key, key) != 0 || base <= 0) {
+        continue;
+      }
+      bool worse = r->higher_is_better ? r->value * factor < base
+                                       : r->value > base * factor;
+      if (worse) {
+        (void)printf("REGRESSION %s: %.0f, baseline %.0f\n", key, r->value,
+                     base);
+        regressions++;
+      }
+    }
+  }
+
+  (void)fclose(fp);
+  return regressions;
+}
+
+/**
+ * parse_sizes - Parse the comma separated batch sizes of -u
+ *
+ * Return: Number of sizes, -1 on error
+ */
+static int parse_sizes(char *arg, size_t *sizes) {
+  int n = 0;
+  for (char *tok = strtok(arg, ","); tok != NULL; tok = strtok(NULL, ",")) {
+    char *end = NULL;
+    unsigned long v = strtoul(tok, &end, 10);
+    if (*end != '\0' || v == 0 || v > BENCH_BATCH_MAX ||
+        n == BENCH_BATCH_SIZES) {
+      return -1;
+    }
+    sizes[n++] = v;
+  }
+  return n;
+}
+
+/**
+ * parse_uint - Parse a non-negative option argument
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int parse_uint(const char *arg, unsigned int *out) {
+  char *end = NULL;
+  unsigned long v = strtoul(arg, &end, 10);
+  if (arg[0] == '\0' || *end != '\0' || v > UINT32_MAX) {
+    return -1;
+  }
+  *out = (unsigned int)v;
+  return 0;
+}
+
+/**
+ * usage - Print the options
+ */
+static void usage(FILE *out) {
+  (void)fprintf(
+      out,
+      "usage: bench_pipeline [-m mock|real|both] [-n passes] [-u sizes]\n"
+      "                      [-P us] [-S us] [-R us] [-b file] [-t pct]\n"
+      "                      [-w file]\n"
+      "  -m  setups to time (default both)\n"
+      "  -n  passes per phase (default %d)\n"
+      "  -u  comma separated batch sizes, 0 to skip (default "
+      "1000,10000,100000)\n"
+      "  -P  getpwnam_r latency, -S spawn latency, -R read latency\n"
+      "  -b  compare with a baseline, exit 1 on regression\n"
+      "  -t  allowed regression in percent (default 20)\n"
+      "  -w  write the results as a baseline\n",
+      BENCH_PASSES);
+}
+
+int main(int argc, char *argv[]) {
+  const char *setups = "both";
+  const char *baseline = NULL;
+  const char *write_to = NULL;
+  unsigned int passes = BENCH_PASSES;
+  unsigned int threshold = 20;
+  size_t sizes[BENCH_BATCH_SIZES] = {1000, 10000, 100000};
+  int nsizes = 3;
+  int opt = 0;
+
+  while ((opt = getopt(argc, argv, "m:n:u:P:S:R:b:t:w:h")) != -1) {
+    int bad = 0;
+    switch (opt) {
+    case 'm':
+      setups = optarg;
+      bad = strcmp(setups, "mock") != 0 && strcmp(setups, "real") != 0 &&
+            strcmp(setups, "both") != 0;
+      break;
+    case 'n':
+      bad = parse_uint(optarg, &passes) != 0 || passes == 0;
+      break;
+    case 'u':
+      nsizes = strcmp(optarg, "0") == 0 ? 0 : parse_sizes(optarg, sizes);
+      bad = nsizes < 0;
+      break;
+    case 'P':
+      bad = parse_uint(optarg, &latency.getpwnam_us);
+      break;
+    case 'S':
+      bad = parse_uint(optarg, &latency.spawn_us);
+      break;
+    case 'R':
+      bad = parse_uint(optarg, &latency.read_us);
+      break;
+    case 'b':
+      baseline = optarg[0] != '\0' ? optarg : NULL;
+      break;
+    case 't':
+      bad = parse_uint(optarg, &threshold);
+      break;
+    case 'w':
+      write_to = optarg;
+      break;
+    case 'h':
+      usage(stdout);
+      return EXIT_SUCCESS;
+    default:
+      bad = 1;
+      break;
+    }
+    if (bad) {
+      usage(stderr);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (build_login_defs() != 0) {
+    (void)fprintf(stderr, "bench_pipeline: cannot allocate login.defs\n");
+    return EXIT_FAILURE;
+  }
+
+  int ret = 0;
+  if (strcmp(setups, "real") != 0) {
+    struct syscall_ops ops = make_mock_ops();
+    (void)printf("mock latency: getpwnam_r %u us, spawn %u us, read %u us\n",
+                 latency.getpwnam_us, latency.spawn_us, latency.read_us);
+    ret = run_phases("mock", &ops, "bench0", passes);
+    for (int i = 0; ret == 0 && i < nsizes; i++) {
+      ret = run_batch(&ops, sizes[i]);
+    }
+  }
+
+  if (ret == 0 && strcmp(setups, "mock") != 0) {
+    struct syscall_ops ops = make_real_ops();
+    if (build_real_root() != 0) {
+      (void)fprintf(stderr, "bench_pipeline: cannot build %s: %s\n",
+                    real_root, strerror(errno));
+      ret = -1;
+    } else {
+      (void)printf("real root: %s\n", real_root);
+      ret = run_phases("real", &ops, "root", passes);
+    }
+    remove_real_root();
+  }
+
+  (void)free(login_defs);
+  if (ret != 0) {
+    return EXIT_FAILURE;
+  }
+
+  if (write_to != NULL && write_baseline(write_to) != 0) {
+    return EXIT_FAILURE;
+  }
+  if (baseline != NULL) {
+    int regressions = check_baseline(baseline, threshold);
+    if (regressions != 0) {
+      (void)fprintf(stderr, "bench_pipeline: %d regression%s past %u%%\n",
+                    regressions < 0 ? 0 : regressions,
+                    regressions == 1 ? "" : "s", threshold);
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,391 @@
+/**
+ * test_arena.c - Tests for the per-request bump allocator
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#include "test_framework.h"
+#include "test_helpers/all.h"
+
+/* Chunk size used by the tests, small enough to outgrow */
+enum { TEST_CHUNK = 1024 };
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================
+ */
+
+/**
+ * make_counting_ops - Ops whose calloc and free are counted
+ */
+static struct syscall_ops make_counting_ops(void) {
+  struct syscall_ops ops = syscall_ops_default;
+  ops.calloc = mock_calloc_counting;
+  ops.free = mock_free_counting;
+  mock_alloc_reset();
+  return ops;
+}
+
+/**
+ * all_zero - Check that @len bytes at @ptr are zero
+ */
+static bool all_zero(const unsigned char *ptr, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    if (ptr[i] != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * other_thread_alloc - Allocate through scoped ops on a thread of its own
+ * @arg: struct syscall_ops from arena_begin()
+ *
+ * Return: 1 if the memory came from the base operations and went back
+ *         to them
+ */
+static int other_thread_alloc(void *arg) {
+  const struct syscall_ops *scoped = arg;
+  int calls = mock_calloc_calls;
+  int frees = mock_free_calls;
+
+  char *buf = scoped->calloc(16, 1);
+  if (buf == NULL) {
+    return 0;
+  }
+  buf[0] = 'x';
+  scoped->free(buf);
+  return mock_calloc_calls == calls + 1 && mock_free_calls == frees + 1 ? 1
+                                                                        : 0;
+}
+
+/**
+ * other_thread_free - Free arena memory on a thread without an arena
+ * @arg: { struct syscall_ops *, void * } from arena_begin() and its arena
+ *
+ * Return: 1 if the arena memory was not handed to the base free()
+ */
+static int other_thread_free(void *arg) {
+  void **args = arg;
+  const struct syscall_ops *scoped = args[0];
+  int frees = mock_free_calls;
+
+  scoped->free(args[1]);
+  return mock_free_calls == frees ? 1 : 0;
+}
+
+/* ============================================================================
+ * Tests
+ * ============================================================================
+ */
+
+TEST(arena_null_params) {
+  struct syscall_ops ops = make_counting_ops();
+  struct syscall_ops scoped = {0};
+  arena_t arena = {0};
+
+  arena_init(NULL, &ops, 0);
+  arena_init(&arena, NULL, 0);
+  arena_begin(NULL, &ops, &scoped);
+  TEST_ASSERT_EQ(scoped.calloc, ops.calloc,
+                 "Without an arena the ops are copied as they are");
+  arena_begin(&arena, NULL, &scoped);
+  arena_begin(&arena, &ops, NULL);
+  arena_end(NULL);
+  arena_destroy(NULL);
+  arena_resume(NULL);
+  TEST_ASSERT_EQ(arena_suspend(), NULL, "No arena is active");
+  TEST_ASSERT_EQ(mock_calloc_calls, 0, "Nothing should be allocated");
+}
+
+TEST(arena_allocates_from_one_chunk) {
+  struct syscall_ops ops = make_counting_ops();
+  struct syscall_ops scoped;
+  arena_t arena;
+
+  arena_init(&arena, &ops, TEST_CHUNK);
+  TEST_ASSERT_EQ(mock_calloc_calls, 0, "Chunks wait for the first request");
+
+  arena_begin(&arena, &ops, &scoped);
+  unsigned char *a = scoped.calloc(3, 7);
+  unsigned char *b = scoped.calloc(1, 100);
+  unsigned char *c = scoped.calloc(0, 8);
+  TEST_ASSERT_NOT_EQ(a, NULL, "Should allocate");
+  TEST_ASSERT_NOT_EQ(b, NULL, "Should allocate");
+  TEST_ASSERT_NOT_EQ(c, NULL, "Zero bytes still gets a pointer");
+  TEST_ASSERT_NOT_EQ(a, b, "Allocations should not overlap");
+  TEST_ASSERT_NOT_EQ(b, c, "Allocations should not overlap");
+  TEST_ASSERT_EQ((uintptr_t)b % alignof(max_align_t), 0,
+                 "Should be aligned like calloc");
+  TEST_ASSERT_EQ(all_zero(b, 100), true, "Should be zeroed");
+  TEST_ASSERT_EQ(mock_calloc_calls, 1, "One chunk serves the request");
+
+  (void)memset(a, 0xff, 21);
+  scoped.free(a);
+  scoped.free(NULL);
+  TEST_ASSERT_EQ(mock_free_calls, 0, "Arena memory is not freed one by one");
+  arena_end(&arena);
+
+  arena_begin(&arena, &ops, &scoped);
+  unsigned char *again = scoped.calloc(3, 7);
+  TEST_ASSERT_EQ(again, a, "The next request starts over at the beginning");
+  TEST_ASSERT_EQ(all_zero(again, 21), true, "Reused memory is zeroed");
+  arena_end(&arena);
+  TEST_ASSERT_EQ(mock_calloc_calls, 1, "The chunk is kept between requests");
+
+  arena_destroy(&arena);
+  TEST_ASSERT_EQ(mock_free_calls, 1, "Destroy releases the chunk");
+}
+
+TEST(arena_outgrows_chunk) {
+  struct syscall_ops ops = make_counting_ops();
+  struct syscall_ops scoped;
+  arena_t arena;
+
+  arena_init(&arena, &ops, TEST_CHUNK);
+  arena_begin(&arena, &ops, &scoped);
+  for (int i = 0; i < 4; i++) {
+    TEST_ASSERT_NOT_EQ(scoped.calloc(1, TEST_CHUNK / 2), NULL,
+                       "Should allocate");
+  }
+  unsigned char *big = scoped.calloc(4, TEST_CHUNK);
+  TEST_ASSERT_NOT_EQ(big, NULL, "Large requests get a chunk of their own");
+  big[4 * TEST_CHUNK - 1] = 1;
+  arena_end(&arena);
+  int chunks = mock_calloc_calls;
+  TEST_ASSERT_EQ(chunks, 3, "Two regular chunks and a large one");
+
+  for (int round = 0; round < 3; round++) {
+    arena_begin(&arena, &ops, &scoped);
+    for (int i = 0; i < 4; i++) {
+      TEST_ASSERT_NOT_EQ(scoped.calloc(1, TEST_CHUNK / 2), NULL,
+                         "Should allocate");
+    }
+    TEST_ASSERT_NOT_EQ(scoped.calloc(4, TEST_CHUNK), NULL,
+                       "Should allocate");
+    arena_end(&arena);
+  }
+  TEST_ASSERT_EQ(mock_calloc_calls, chunks,
+                 "Repeating the request allocates nothing more");
+
+  arena_destroy(&arena);
+  TEST_ASSERT_EQ(mock_free_calls, chunks, "Destroy releases every chunk");
+
+  arena_begin(&arena, &ops, &scoped);
+  TEST_ASSERT_NOT_EQ(scoped.calloc(1, 8), NULL,
+                     "A destroyed arena can be used again");
+  arena_end(&arena);
+  arena_destroy(&arena);
+}
+
+TEST(arena_base_calloc_fails) {
+  struct syscall_ops ops = make_counting_ops();
+  struct syscall_ops scoped;
+  arena_t arena;
+
+  arena_init(&arena, &ops, TEST_CHUNK);
+  mock_calloc_budget = 1;
+  arena_begin(&arena, &ops, &scoped);
+  TEST_ASSERT_NOT_EQ(scoped.calloc(1, 8), NULL, "The first chunk is granted");
+  errno = 0;
+  TEST_ASSERT_EQ(scoped.calloc(2, TEST_CHUNK), NULL,
+                 "Should fail without another chunk");
+  TEST_ASSERT_EQ(errno, ENOMEM, "Should set the correct error code");
+  TEST_ASSERT_NOT_EQ(scoped.calloc(1, 8), NULL,
+                     "The first chunk still has room");
+  arena_end(&arena);
+  arena_destroy(&arena);
+
+  ops.calloc = mock_calloc_null;
+  arena_init(&arena, &ops, TEST_CHUNK);
+  arena_begin(&arena, &ops, &scoped);
+  TEST_ASSERT_EQ(scoped.calloc(1, 8), NULL, "Should fail without chunks");
+  arena_end(&arena);
+  arena_destroy(&arena);
+}
+
+TEST(arena_suspended_base_calloc_fails) {
+  struct syscall_ops ops = make_counting_ops();
+  struct syscall_ops scoped;
+  arena_t arena;
+
+  arena_init(&arena, &ops, TEST_CHUNK);
+  arena_begin(&arena, &ops, &scoped);
+  TEST_ASSERT_NOT_EQ(scoped.calloc(1, 8), NULL, "The first chunk is granted");
+
+  mock_calloc_budget = 0;
+  arena_t *suspended = arena_suspend();
+  TEST_ASSERT_EQ(scoped.calloc(1, 8), NULL,
+                 "Suspended allocations should use the failing base");
+  arena_resume(suspended);
+  TEST_ASSERT_NOT_EQ(scoped.calloc(1, 8), NULL,
+                     "The arena's chunk still has room");
+
+  arena_end(&arena);
+  arena_destroy(&arena);
+}
+
+TEST(arena_overflow) {
+  struct syscall_ops ops = make_counting_ops();
+  struct syscall_ops scoped;
+  arena_t arena;
+
+  arena_init(&arena, &ops, TEST_CHUNK);
+  arena_begin(&arena, &ops, &scoped);
+  errno = 0;
+  TEST_ASSERT_EQ(scoped.calloc(SIZE_MAX / 2, 4), NULL,
+                 "Should reject nmemb * size overflow");
+  TEST_ASSERT_EQ(errno, ENOMEM, "Should set the correct error code");
+  TEST_ASSERT_EQ(scoped.calloc(1, SIZE_MAX - 8), NULL,
+                 "Should reject sizes that cannot be rounded up");
+  TEST_ASSERT_EQ(mock_calloc_calls, 0, "Nothing should be allocated");
+  arena_end(&arena);
+  arena_destroy(&arena);
+}
+
+TEST(arena_free_passes_foreign_memory_on) {
+  struct syscall_ops ops = make_counting_ops();
+  struct syscall_ops scoped;
+  arena_t arena;
+
+  arena_init(&arena, &ops, TEST_CHUNK);
+  arena_begin(&arena, &ops, &scoped);
+  TEST_ASSERT_NOT_EQ(scoped.calloc(1, 8), NULL, "Should allocate");
+
+  /* Like a scandir(3) namelist: the C library's memory, not the arena's */
+  char *foreign = malloc(32);
+  TEST_ASSERT_NOT_EQ(foreign, NULL, "Should allocate");
+  scoped.free(foreign);
+
+  arena_end(&arena);
+  arena_destroy(&arena);
+}
+
+TEST(arena_suspend_resume) {
+  struct syscall_ops ops = make_counting_ops();
+  struct syscall_ops scoped;
+  arena_t arena;
+
+  arena_init(&arena, &ops, TEST_CHUNK);
+  arena_begin(&arena, &ops, &scoped);
+  TEST_ASSERT_NOT_EQ(scoped.calloc(1, 8), NULL, "Should allocate");
+
+  arena_t *suspended = arena_suspend();
+  TEST_ASSERT_EQ(suspended, &arena, "Should return the active arena");
+  char *kept = scoped.calloc(1, 64);
+  TEST_ASSERT_NOT_EQ(kept, NULL, "Should allocate outside the arena");
+  TEST_ASSERT_EQ(mock_calloc_calls, 2,
+                 "Suspended, the base allocates instead of the arena");
+  arena_resume(suspended);
+
+  arena_end(&arena);
+  kept[63] = 1;
+  scoped.free(kept);
+  TEST_ASSERT_EQ(mock_free_calls, 1, "Should go back to the base free");
+  arena_destroy(&arena);
+}
+
+TEST(arena_free_after_end_or_elsewhere) {
+  struct syscall_ops ops = make_counting_ops();
+  struct syscall_ops scoped;
+  arena_t arena;
+  thrd_t tid;
+  int result = 0;
+
+  arena_init(&arena, &ops, TEST_CHUNK);
+  arena_begin(&arena, &ops, &scoped);
+  char *first = scoped.calloc(1, 8);
+  char *second = scoped.calloc(1, 8);
+  TEST_ASSERT_NOT_EQ(first, NULL, "Should allocate");
+  TEST_ASSERT_NOT_EQ(second, NULL, "Should allocate");
+
+  void *args[2] = {&scoped, second};
+  TEST_ASSERT_EQ(thrd_create(&tid, other_thread_free, args), thrd_success,
+                 "Should start the thread");
+  TEST_ASSERT_EQ(thrd_join(tid, &result), thrd_success,
+                 "Should join the thread");
+  TEST_ASSERT_EQ(result, 1, "Another thread should recognise arena memory");
+
+  arena_end(&arena);
+  scoped.free(first);
+  TEST_ASSERT_EQ(mock_free_calls, 0,
+                 "Arena memory freed after arena_end() stays in the arena");
+  arena_destroy(&arena);
+  TEST_ASSERT_EQ(mock_free_calls, 1, "Destroy releases the chunk");
+}
+
+TEST(arena_other_threads_use_calloc) {
+  struct syscall_ops ops = make_counting_ops();
+  struct syscall_ops scoped;
+  arena_t arena;
+  thrd_t tid;
+  int result = 0;
+
+  arena_init(&arena, &ops, TEST_CHUNK);
+  arena_begin(&arena, &ops, &scoped);
+  TEST_ASSERT_EQ(thrd_create(&tid, other_thread_alloc, &scoped),
+                 thrd_success, "Should start the thread");
+  TEST_ASSERT_EQ(thrd_join(tid, &result), thrd_success,
+                 "Should join the thread");
+  TEST_ASSERT_EQ(result, 1,
+                 "Threads without an arena get memory from the base");
+  arena_end(&arena);
+  arena_destroy(&arena);
+}
+
+TEST(arena_nested) {
+  struct syscall_ops ops = make_counting_ops();
+  struct syscall_ops outer_ops;
+  struct syscall_ops inner_ops;
+  arena_t outer;
+  arena_t inner;
+
+  arena_init(&outer, &ops, TEST_CHUNK);
+  arena_init(&inner, &ops, TEST_CHUNK);
+  arena_begin(&outer, &ops, &outer_ops);
+  TEST_ASSERT_NOT_EQ(outer_ops.calloc(1, 8), NULL, "Should allocate");
+  arena_begin(&inner, &ops, &inner_ops);
+  TEST_ASSERT_NOT_EQ(inner_ops.calloc(1, 8), NULL, "Should allocate");
+  TEST_ASSERT_EQ(mock_calloc_calls, 2, "Each arena has its own chunk");
+  arena_end(&inner);
+
+  TEST_ASSERT_EQ(arena_suspend(), &outer, "The outer arena is active again");
+  arena_resume(&outer);
+  arena_end(&outer);
+  TEST_ASSERT_EQ(arena_suspend(), NULL, "No arena is active");
+
+  arena_destroy(&inner);
+  arena_destroy(&outer);
+}
+
+int main(int argc, char **argv) {
+  TEST_INIT(10, false, false); /* timeout, verbose, duration */
+
+  RUN_TEST(arena_null_params);
+  RUN_TEST(arena_allocates_from_one_chunk);
+  RUN_TEST(arena_outgrows_chunk);
+  RUN_TEST(arena_base_calloc_fails);
+  RUN_TEST(arena_suspended_base_calloc_fails);
+  RUN_TEST(arena_overflow);
+  RUN_TEST(arena_free_passes_foreign_memory_on);
+  RUN_TEST(arena_suspend_resume);
+  RUN_TEST(arena_free_after_end_or_elsewhere);
+  RUN_TEST(arena_other_threads_use_calloc);
+  RUN_TEST(arena_nested);
+
+  return TEST_EXECUTE();
+}
@@ -0,0 +1,340 @@
+/**
+ * test_audit.c - Tests for the subordinate ID database audit
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <pwd.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "test_framework.h"
+#include "test_helpers/all.h"
+
+/* ============================================================================
+ * Constants
+ * ============================================================================
+ */
+
+/* Fake descriptor handed out by mock_open_db */
+enum { MOCK_FD_DB = 300 };
+
+/* Entries in the generated large database, and the count of each */
+enum { LARGE_ENTRIES = 200000, LARGE_COUNT = 1000 };
+
+/* ============================================================================
+ * Mock Database and Passwd
+ * ============================================================================
+ */
+
+/* Content served for every database open */
+static const char *mock_db_content = "";
+
+/* Accounts returned by mock_getpwent, in order */
+static const struct passwd *mock_pwent_table = NULL;
+static size_t mock_pwent_count = 0;
+static size_t mock_pwent_pos = 0;
+
+/**
+ * mock_open_db - Hand out the fake database descriptor
+ */
+static int mock_open_db(const char *pathname, int flags, ...) {
+  (void)pathname;
+  (void)flags;
+  return MOCK_FD_DB;
+}
+
+/**
+ * mock_fdopen_db - Serve mock_db_content as a real stream
+ */
+static FILE *mock_fdopen_db(int fd, const char *mode) {
+  (void)fd;
+  (void)mode;
+  return fmemopen((void *)(uintptr_t)mock_db_content, strlen(mock_db_content),
+                  "r");
+}
+
+/**
+ * mock_setpwent - Rewind the mock passwd table
+ */
+static void mock_setpwent(void) { mock_pwent_pos = 0; }
+
+/**
+ * mock_getpwent - Return the next account from mock_pwent_table
+ */
+static struct passwd *mock_getpwent(void) {
+  if (mock_pwent_pos >= mock_pwent_count) {
+    errno = 0;
+    return NULL;
+  }
+  return (struct passwd *)(uintptr_t)&mock_pwent_table[mock_pwent_pos++];
+}
+
+/**
+ * mock_endpwent - Nothing to release
+ */
+static void mock_endpwent(void) {}
+
+/**
+ * make_audit_ops - Ops reading @content for any database path
+ * @content: Database contents
+ * @table: Accounts enumerated by getpwent
+ * @count: Number of accounts in @table
+ */
+static struct syscall_ops make_audit_ops(const char *content,
+                                         const struct passwd *table,
+                                         size_t count) {
+  struct syscall_ops ops = syscall_ops_default;
+
+  mock_db_content = content;
+  mock_pwent_table = table;
+  mock_pwent_count = count;
+  mock_pwent_pos = 0;
+  ops.open = mock_open_db;
+  ops.close = mock_close_any;
+  ops.fstat = mock_fstat_root_file;
+  ops.fdopen = mock_fdopen_db;
+  ops.setpwent = mock_setpwent;
+  ops.getpwent = mock_getpwent;
+  ops.endpwent = mock_endpwent;
+  ops.getpwnam_r = mock_getpwnam_r_not_found;
+  return ops;
+}
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================
+ */
+
+/**
+ * run_audit - Audit /etc/subuid only, capturing the report
+ * @ops: Operations structure
+ * @config: Configuration to audit against
+ * @findings: Set to the number of findings
+ *
+ * Return: Report text (caller frees), NULL if the audit failed
+ */
+static char *run_audit(const struct syscall_ops *ops, const config_t *config,
+                       size_t *findings) {
+  options_t opts = {.do_subuid = true};
+  char *report = NULL;
+  size_t size = 0;
+  FILE *out = open_memstream(&report, &size);
+  if (out == NULL) {
+    return NULL;
+  }
+
+  int ret = audit_run(ops, config, &opts, out, findings);
+  (void)fclose(out);
+  if (ret != 0) {
+    free(report);
+    return NULL;
+  }
+  return report;
+}
+
+/* ============================================================================
+ * Tests
+ * ============================================================================
+ */
+
+TEST(audit_null_params) {
+  config_t config = {0};
+  options_t opts = {.do_subuid = true};
+  size_t findings = 0;
+
+  config_factory(&config);
+  TEST_ASSERT_EQ(audit_run(NULL, &config, &opts, stdout, &findings), -1,
+                 "Should reject NULL ops");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(audit_run(&syscall_ops_default, &config, &opts, stdout,
+                           NULL),
+                 -1, "Should reject NULL findings");
+}
+
+TEST(audit_clean_database) {
+  config_t config = {0};
+  size_t findings = 99;
+
+  config_factory(&config);
+  struct syscall_ops ops =
+      make_audit_ops("# managed\n1000:100000:65536\n\n1001:165536:65536\n",
+                     NULL, 0);
+  char *report = run_audit(&ops, &config, &findings);
+
+  TEST_ASSERT_NOT_EQ(report, NULL, "Audit should complete");
+  TEST_ASSERT_EQ(findings, 0, "Should find nothing");
+  TEST_ASSERT_STR_EQ(report,
+                     "summary\t" SUBUID_PATH "\t2 entries\t0 findings\n",
+                     "Should only print the summary");
+  free(report);
+}
+
+TEST(audit_missing_database) {
+  config_t config = {0};
+  size_t findings = 99;
+
+  config_factory(&config);
+  struct syscall_ops ops = make_audit_ops("", NULL, 0);
+  ops.open = mock_open_enoent;
+  char *report = run_audit(&ops, &config, &findings);
+
+  TEST_ASSERT_NOT_EQ(report, NULL, "A missing database is not an error");
+  TEST_ASSERT_EQ(findings, 0, "Should find nothing");
+  TEST_ASSERT_NOT_EQ(strstr(report, "\t0 entries\t"), NULL,
+                     "Should report no entries");
+  free(report);
+}
+
+TEST(audit_overlap) {
+  config_t config = {0};
+  size_t findings = 0;
+
+  config_factory(&config);
+  config.uid_max = 1000;
+  struct syscall_ops ops =
+      make_audit_ops("1000:100000:65536\n"
+                     "5000:200000:100\n"
+                     "5001:165500:100\n"
+                     "5001:165550:100\n",
+                     NULL, 0);
+  char *report = run_audit(&ops, &config, &findings);
+
+  TEST_ASSERT_NOT_EQ(report, NULL, "Audit should complete");
+  TEST_ASSERT_EQ(findings, 1, "Same-owner overlap should not count");
+  TEST_ASSERT_NOT_EQ(strstr(report, "overlap\t" SUBUID_PATH
+                                    ":3\t5001:165500:100\tline 1 "
+                                    "1000:100000:65536\n"),
+                     NULL, "Should report the entry against the earlier one");
+  free(report);
+}
+
+TEST(audit_mismatch) {
+  config_t config = {0};
+  size_t findings = 0;
+
+  config_factory(&config);
+  struct syscall_ops ops =
+      make_audit_ops("1000:100000:65536\n1001:100000000:65536\n", NULL, 0);
+  char *report = run_audit(&ops, &config, &findings);
+
+  TEST_ASSERT_NOT_EQ(report, NULL, "Audit should complete");
+  TEST_ASSERT_EQ(findings, 1, "Should find one mismatch");
+  TEST_ASSERT_NOT_EQ(strstr(report, "mismatch\t" SUBUID_PATH
+                                    ":2\t1001:100000000:65536\tUID 1001 "
+                                    "expected 165536:65536\n"),
+                     NULL, "Should report the expected range");
+  free(report);
+}
+
+TEST(audit_uid_range) {
+  config_t config = {0};
+  size_t findings = 0;
+
+  config_factory(&config);
+  struct syscall_ops ops = make_audit_ops("70000:59000:2000\n", NULL, 0);
+  char *report = run_audit(&ops, &config, &findings);
+
+  TEST_ASSERT_NOT_EQ(report, NULL, "Audit should complete");
+  TEST_ASSERT_EQ(findings, 1, "Should find the intrusion");
+  TEST_ASSERT_NOT_EQ(strstr(report, "uid-range\t" SUBUID_PATH
+                                    ":1\t70000:59000:2000\tUID_MIN 1000 "
+                                    "UID_MAX 60000\n"),
+                     NULL, "Should report the UID range");
+  free(report);
+}
+
+TEST(audit_owner_names) {
+  config_t config = {0};
+  size_t findings = 0;
+  static char alice[] = "alice";
+  static char bob[] = "bob";
+  const struct passwd table[] = {
+      {.pw_name = bob, .pw_uid = 1001},
+      {.pw_name = alice, .pw_uid = 1000},
+  };
+
+  config_factory(&config);
+  struct syscall_ops ops = make_audit_ops("alice:100000:65536\n"
+                                          "bob:165536:65536\n"
+                                          "1000:120000:10\n"
+                                          "carol:900000000:10\n"
+                                          "not a line\n",
+                                          table, 2);
+  char *report = run_audit(&ops, &config, &findings);
+
+  TEST_ASSERT_NOT_EQ(report, NULL, "Audit should complete");
+  TEST_ASSERT_EQ(findings, 3, "Should find mismatch, unknown and malformed");
+  TEST_ASSERT_NOT_EQ(strstr(report, "malformed\t" SUBUID_PATH ":5\t-\t"),
+                     NULL, "Should report the malformed line");
+  TEST_ASSERT_NOT_EQ(strstr(report, "unknown-owner\t" SUBUID_PATH
+                                    ":4\tcarol:900000000:10\t"),
+                     NULL, "Should report the unknown owner");
+  TEST_ASSERT_NOT_EQ(strstr(report, "mismatch\t" SUBUID_PATH ":3\t"), NULL,
+                     "UID 1000 should only expect alice's range");
+  TEST_ASSERT_EQ(strstr(report, "overlap"), NULL,
+                 "alice and 1000 are the same owner");
+  free(report);
+}
+
+TEST(audit_large_database) {
+  config_t config = {0};
+  size_t findings = 0;
+  size_t size = (size_t)LARGE_ENTRIES * 32 + 64;
+  char *content = calloc(size, 1);
+  size_t len = 0;
+
+  TEST_ASSERT_NOT_EQ(content, NULL, "Should allocate the database");
+  config_factory(&config);
+  config.uid_max = 1000 + LARGE_ENTRIES;
+  config.subuid.min_val = 1000000;
+  config.subuid.count_val = LARGE_COUNT;
+
+  /* Written from the top down so the sort has work to do */
+  for (uint32_t i = LARGE_ENTRIES; i > 0; i--) {
+    uint32_t uid = 1000 + i - 1;
+    uint32_t start = config.subuid.min_val + (i - 1) * LARGE_COUNT;
+    len += (size_t)snprintf(content + len, size - len, "%u:%u:%u\n", uid,
+                            start, (uint32_t)LARGE_COUNT);
+  }
+  (void)snprintf(content + len, size - len, "root:%u:10\n",
+                 config.subuid.min_val + 5);
+
+  static char root[] = "root";
+  const struct passwd table[] = {{.pw_name = root, .pw_uid = 0}};
+  struct syscall_ops ops = make_audit_ops(content, table, 1);
+  char *report = run_audit(&ops, &config, &findings);
+
+  TEST_ASSERT_NOT_EQ(report, NULL, "Audit should complete");
+  TEST_ASSERT_EQ(findings, 1, "Should find only the injected overlap");
+  TEST_ASSERT_NOT_EQ(strstr(report, "overlap\t"), NULL,
+                     "Should report the overlap");
+  TEST_ASSERT_NOT_EQ(strstr(report, "\t200001 entries\t"), NULL,
+                     "Should count every entry");
+  free(report);
+  free(content);
+}
+
+int main(int argc, char **argv) {
+  TEST_INIT(10, false, false); /* timeout, verbose, duration */
+
+  RUN_TEST(audit_null_params);
+  RUN_TEST(audit_clean_database);
+  RUN_TEST(audit_missing_database);
+  RUN_TEST(audit_overlap);
+  RUN_TEST(audit_mismatch);
+  RUN_TEST(audit_uid_range);
+  RUN_TEST(audit_owner_names);
+  RUN_TEST(audit_large_database);
+
+  return TEST_EXECUTE();
+}
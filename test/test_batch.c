@@ -0,0 +1,631 @@
+/**
+ * test_batch.c - Tests for batch mode entry reading and processing
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <pwd.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test_framework.h"
+#include "test_helpers/all.h"
+
+/* ============================================================================
+ * Mock passwd Database
+ * ============================================================================
+ */
+
+/* Accounts returned by mock_getpwent, in order */
+static const struct passwd *mock_pwent_table = NULL;
+static size_t mock_pwent_count = 0;
+static size_t mock_pwent_pos = 0;
+
+/* errno reported by mock_getpwent once the table is exhausted */
+static int mock_pwent_end_errno = 0;
+
+/* Calls to setpwent/endpwent, to check the cursor is always released */
+static int mock_setpwent_calls = 0;
+static int mock_endpwent_calls = 0;
+
+/**
+ * mock_setpwent - Rewind the mock passwd table
+ */
+static void mock_setpwent(void) {
+  mock_setpwent_calls++;
+  mock_pwent_pos = 0;
+}
+
+/**
+ * mock_getpwent - Return the next account from mock_pwent_table
+ *
+ * Return: Next account, or NULL with errno = mock_pwent_end_errno
+ */
+static struct passwd *mock_getpwent(void) {
+  if (mock_pwent_pos >= mock_pwent_count) {
+    errno = mock_pwent_end_errno;
+    return NULL;
+  }
+  return (struct passwd *)(uintptr_t)&mock_pwent_table[mock_pwent_pos++];
+}
+
+/**
+ * mock_endpwent - Count cursor release
+ */
+static void mock_endpwent(void) { mock_endpwent_calls++; }
+
+/**
+ * mock_lckpwdf_eacces - Refuse the shadow lock
+ */
+static int mock_lckpwdf_eacces(void) {
+  errno = EACCES;
+  return -1;
+}
+
+/**
+ * make_pwent_ops - Ops enumerating @table through getpwent
+ * @table: Accounts to return
+ * @count: Number of accounts in @table
+ * @end_errno: errno to report at end of enumeration
+ */
+static struct syscall_ops make_pwent_ops(const struct passwd *table,
+                                         size_t count, int end_errno) {
+  struct syscall_ops ops = syscall_ops_default;
+
+  mock_pwent_table = table;
+  mock_pwent_count = count;
+  mock_pwent_pos = 0;
+  mock_pwent_end_errno = end_errno;
+  mock_setpwent_calls = 0;
+  mock_endpwent_calls = 0;
+
+  ops.setpwent = mock_setpwent;
+  ops.getpwent = mock_getpwent;
+  ops.endpwent = mock_endpwent;
+  return ops;
+}
+
+/**
+ * mock_getpwuid_r_standard_only - Name TEST_UID_STANDARD, nothing else
+ *
+ * Only touches the caller's storage, so it is safe from several threads.
+ */
+static int mock_getpwuid_r_standard_only(uid_t uid, struct passwd *pwd,
+                                         char *buf, size_t buflen,
+                                         struct passwd **result) {
+  if (uid != TEST_UID_STANDARD) {
+    *result = NULL;
+    return 0;
+  }
+  return mock_getpwuid_r_testuser(uid, pwd, buf, buflen, result);
+}
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================
+ */
+
+/**
+ * open_memory - Open a read-only stream over a fixed buffer
+ * @buf: Buffer contents (may contain embedded NULs)
+ * @len: Number of bytes in @buf
+ */
+static FILE *open_memory(const char *buf, size_t len) {
+  FILE *fp = fmemopen((void *)(uintptr_t)buf, len, "r");
+  TEST_ASSERT_NOT_EQ(fp, NULL, "Test setup: fmemopen failed");
+  return fp;
+}
+
+/**
+ * make_batch_ops - Ops resolving every username/UID to the test user
+ *
+ * Range assignment runs in noop mode with SKIP_IF_EXISTS off, so no
+ * helper is ever spawned.
+ */
+static struct syscall_ops make_batch_ops(void) {
+  struct syscall_ops ops = syscall_ops_default;
+  ops.getpwnam_r = mock_getpwnam_r_success;
+  ops.getpwuid_r = mock_getpwuid_r_testuser;
+  return ops;
+}
+
+/**
+ * make_batch_config - Default configuration without existence checks
+ */
+static config_t make_batch_config(void) {
+  config_t config = {0};
+  config_factory(&config);
+  config.skip_if_exists = false;
+  return config;
+}
+
+/**
+ * make_batch_opts - Batch options for both modes in noop mode
+ */
+static options_t make_batch_opts(void) {
+  options_t opts = {0};
+  opts.do_subuid = true;
+  opts.do_subgid = true;
+  opts.noop = true;
+  opts.batch = true;
+  return opts;
+}
+
+/* ============================================================================
+ * Tests - batch_read_entry
+ * ============================================================================
+ */
+
+TEST(batch_read_entry_null_params) {
+  char *line = NULL;
+  size_t cap = 0;
+
+  TEST_ASSERT_EQ(batch_read_entry(NULL, '\n', &line, &cap), NULL,
+                 "Should reject NULL stream");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(batch_read_entry(stdin, '\n', NULL, &cap), NULL,
+                 "Should reject NULL line");
+  TEST_ASSERT_EQ(batch_read_entry(stdin, '\n', &line, NULL), NULL,
+                 "Should reject NULL cap");
+}
+
+TEST(batch_read_entry_newline_separated) {
+  static const char input[] = "alice\n\n  bob \t\n# comment\n1000";
+  FILE *fp = open_memory(input, sizeof(input) - 1);
+  char *line = NULL;
+  size_t cap = 0;
+
+  TEST_ASSERT_STR_EQ(batch_read_entry(fp, '\n', &line, &cap), "alice",
+                     "Should read first entry");
+  TEST_ASSERT_STR_EQ(batch_read_entry(fp, '\n', &line, &cap), "bob",
+                     "Should skip blank lines and trim whitespace");
+  TEST_ASSERT_STR_EQ(batch_read_entry(fp, '\n', &line, &cap), "1000",
+                     "Should skip comments and read unterminated last line");
+  TEST_ASSERT_EQ(batch_read_entry(fp, '\n', &line, &cap), NULL,
+                 "Should return NULL at end of input");
+  TEST_ASSERT_EQ(ferror(fp), 0, "End of input is not an error");
+
+  free(line);
+  fclose(fp);
+}
+
+TEST(batch_read_entry_nul_separated) {
+  static const char input[] = "alice\0bob\0\0carol\0";
+  FILE *fp = open_memory(input, sizeof(input) - 1);
+  char *line = NULL;
+  size_t cap = 0;
+
+  TEST_ASSERT_STR_EQ(batch_read_entry(fp, '\0', &line, &cap), "alice",
+                     "Should split on NUL");
+  TEST_ASSERT_STR_EQ(batch_read_entry(fp, '\0', &line, &cap), "bob",
+                     "Should read second entry");
+  TEST_ASSERT_STR_EQ(batch_read_entry(fp, '\0', &line, &cap), "carol",
+                     "Should skip empty entries");
+  TEST_ASSERT_EQ(batch_read_entry(fp, '\0', &line, &cap), NULL,
+                 "Should return NULL at end of input");
+
+  free(line);
+  fclose(fp);
+}
+
+/* ============================================================================
+ * Tests - batch_run_args
+ * ============================================================================
+ */
+
+TEST(batch_run_args_null_params) {
+  config_t config = make_batch_config();
+  options_t opts = make_batch_opts();
+  batch_stats_t stats = {0};
+
+  TEST_ASSERT_EQ(batch_run_args(NULL, &config, &opts, &stats), -1,
+                 "Should reject NULL ops");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(batch_run_args(&syscall_ops_default, NULL, &opts, &stats),
+                 -1, "Should reject NULL config");
+  TEST_ASSERT_EQ(batch_run_args(&syscall_ops_default, &config, NULL, &stats),
+                 -1, "Should reject NULL opts");
+  TEST_ASSERT_EQ(batch_run_args(&syscall_ops_default, &config, &opts, NULL),
+                 -1, "Should reject NULL stats");
+}
+
+TEST(batch_run_args_all_ok) {
+  struct syscall_ops ops = make_batch_ops();
+  config_t config = make_batch_config();
+  options_t opts = make_batch_opts();
+  batch_stats_t stats = {0};
+  char user[] = "testuser";
+  char uid[] = "1000";
+  char *entries[] = {user, uid, NULL};
+
+  opts.user_args = entries;
+  opts.user_argc = 2;
+
+  TEST_ASSERT_EQ(batch_run_args(&ops, &config, &opts, &stats), 0,
+                 "Should succeed when every entry succeeds");
+  TEST_ASSERT_EQ(stats.total, 2, "Should count every entry");
+  TEST_ASSERT_EQ(stats.ok, 2, "Should count successes");
+  TEST_ASSERT_EQ(stats.failed, 0, "Should count no failures");
+}
+
+TEST(batch_run_args_failure_does_not_abort) {
+  struct syscall_ops ops = make_batch_ops();
+  config_t config = make_batch_config();
+  options_t opts = make_batch_opts();
+  batch_stats_t stats = {0};
+  char bad[] = "bad;user";
+  char user[] = "testuser";
+  char *entries[] = {bad, user, NULL};
+
+  opts.user_args = entries;
+  opts.user_argc = 2;
+
+  TEST_ASSERT_EQ(batch_run_args(&ops, &config, &opts, &stats), -1,
+                 "Should report failure when any entry fails");
+  TEST_ASSERT_EQ(stats.total, 2, "Should keep going after a failure");
+  TEST_ASSERT_EQ(stats.ok, 1, "Later entries should still succeed");
+  TEST_ASSERT_EQ(stats.failed, 1, "Should count the failed entry");
+}
+
+TEST(batch_run_args_calloc_fails) {
+  struct syscall_ops ops = make_batch_ops();
+  config_t config = make_batch_config();
+  options_t opts = make_batch_opts();
+  batch_stats_t stats = {0};
+
+  ops.calloc = mock_calloc_null;
+
+  TEST_ASSERT_EQ(batch_run_args(&ops, &config, &opts, &stats), -1,
+                 "Should fail when the username buffer cannot be allocated");
+  TEST_ASSERT_EQ(errno, ENOMEM, "Should set the correct error code");
+  TEST_ASSERT_EQ(stats.total, 0, "Should not process any entry");
+}
+
+TEST(batch_run_args_parallel) {
+  struct syscall_ops ops = make_batch_ops();
+  config_t config = make_batch_config();
+  options_t opts = make_batch_opts();
+  batch_stats_t stats = {0};
+  char user[] = "testuser";
+  char uid[] = "1000";
+  char unknown[] = "4242";
+  char bad[] = "bad;user";
+  char *entries[] = {user, uid, unknown, bad, user, NULL};
+
+  opts.user_args = entries;
+  opts.user_argc = 5;
+  opts.jobs = 4;
+  ops.getpwuid_r = mock_getpwuid_r_standard_only;
+
+  TEST_ASSERT_EQ(batch_run_args(&ops, &config, &opts, &stats), -1,
+                 "Should report the failed entries");
+  TEST_ASSERT_EQ(stats.total, 5, "Should count every entry");
+  TEST_ASSERT_EQ(stats.ok, 3, "Should count successes");
+  TEST_ASSERT_EQ(stats.failed, 2, "Unknown UID and bad name should fail");
+}
+
+TEST(batch_run_args_parallel_calloc_fails) {
+  struct syscall_ops ops = make_batch_ops();
+  config_t config = make_batch_config();
+  options_t opts = make_batch_opts();
+  batch_stats_t stats = {0};
+
+  ops.calloc = mock_calloc_null;
+  opts.jobs = 4;
+
+  TEST_ASSERT_EQ(batch_run_args(&ops, &config, &opts, &stats), -1,
+                 "Should fail when the username buffer cannot be allocated");
+  TEST_ASSERT_EQ(errno, ENOMEM, "Should set the correct error code");
+  TEST_ASSERT_EQ(stats.total, 0, "Should not process any entry");
+}
+
+/* ============================================================================
+ * Tests - batch_run_stream
+ * ============================================================================
+ */
+
+TEST(batch_run_stream_null_params) {
+  config_t config = make_batch_config();
+  options_t opts = make_batch_opts();
+  batch_stats_t stats = {0};
+
+  TEST_ASSERT_EQ(batch_run_stream(NULL, &config, &opts, stdin, &stats), -1,
+                 "Should reject NULL ops");
+  TEST_ASSERT_EQ(batch_run_stream(&syscall_ops_default, &config, &opts, NULL,
+                                  &stats),
+                 -1, "Should reject NULL stream");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+}
+
+TEST(batch_run_stream_mixed_results) {
+  static const char input[] = "testuser\nuser;bad\n\n1000\n";
+  struct syscall_ops ops = make_batch_ops();
+  config_t config = make_batch_config();
+  options_t opts = make_batch_opts();
+  batch_stats_t stats = {0};
+  FILE *fp = open_memory(input, sizeof(input) - 1);
+
+  TEST_ASSERT_EQ(batch_run_stream(&ops, &config, &opts, fp, &stats), -1,
+                 "Should report failure when any entry fails");
+  TEST_ASSERT_EQ(stats.total, 3, "Should skip blank lines");
+  TEST_ASSERT_EQ(stats.ok, 2, "Should count successes");
+  TEST_ASSERT_EQ(stats.failed, 1, "Should count failures");
+
+  fclose(fp);
+}
+
+TEST(batch_run_stream_parallel_windows) {
+  /* 2 jobs resolve windows of 32, so 40 entries take two windows */
+  char input[40 * sizeof("testuser\n")] = {0};
+  size_t len = 0;
+  for (int i = 0; i < 40; i++) {
+    const char *entry = i == 35 ? "4242\n" : i % 2 ? "1000\n" : "testuser\n";
+    size_t n = strlen(entry);
+    (void)memcpy(input + len, entry, n);
+    len += n;
+  }
+
+  struct syscall_ops ops = make_batch_ops();
+  config_t config = make_batch_config();
+  options_t opts = make_batch_opts();
+  batch_stats_t stats = {0};
+  opts.jobs = 2;
+  ops.getpwuid_r = mock_getpwuid_r_standard_only;
+
+  FILE *fp = open_memory(input, len);
+  TEST_ASSERT_EQ(batch_run_stream(&ops, &config, &opts, fp, &stats), -1,
+                 "Should report the failed entry");
+  (void)fclose(fp);
+
+  TEST_ASSERT_EQ(stats.total, 40, "Should count entries of both windows");
+  TEST_ASSERT_EQ(stats.ok, 39, "Should count successes");
+  TEST_ASSERT_EQ(stats.failed, 1, "Only the unknown UID should fail");
+}
+
+TEST(batch_run_stream_null_separated) {
+  static const char input[] = "testuser\0" "1000\0";
+  struct syscall_ops ops = make_batch_ops();
+  config_t config = make_batch_config();
+  options_t opts = make_batch_opts();
+  batch_stats_t stats = {0};
+  FILE *fp = open_memory(input, sizeof(input) - 1);
+
+  opts.null_sep = true;
+
+  TEST_ASSERT_EQ(batch_run_stream(&ops, &config, &opts, fp, &stats), 0,
+                 "Should succeed");
+  TEST_ASSERT_EQ(stats.total, 2, "Should split on NUL");
+
+  fclose(fp);
+}
+
+TEST(batch_run_stream_uid_out_of_range) {
+  static const char input[] = "testuser\n";
+  struct syscall_ops ops = make_batch_ops();
+  config_t config = make_batch_config();
+  options_t opts = make_batch_opts();
+  batch_stats_t stats = {0};
+  FILE *fp = open_memory(input, sizeof(input) - 1);
+
+  config.uid_min = 2000;
+
+  TEST_ASSERT_EQ(batch_run_stream(&ops, &config, &opts, fp, &stats), -1,
+                 "Should fail an ineligible user");
+  TEST_ASSERT_EQ(stats.failed, 1, "Should count the failure");
+
+  fclose(fp);
+}
+
+TEST(batch_run_stream_calloc_fails) {
+  struct syscall_ops ops = make_batch_ops();
+  config_t config = make_batch_config();
+  options_t opts = make_batch_opts();
+  batch_stats_t stats = {0};
+
+  ops.calloc = mock_calloc_null;
+
+  TEST_ASSERT_EQ(batch_run_stream(&ops, &config, &opts, stdin, &stats), -1,
+                 "Should fail when the username buffer cannot be allocated");
+  TEST_ASSERT_EQ(errno, ENOMEM, "Should set the correct error code");
+}
+
+/* ============================================================================
+ * Tests - batch_run_all_eligible
+ * ============================================================================
+ */
+
+TEST(batch_run_all_eligible_null_params) {
+  config_t config = make_batch_config();
+  options_t opts = make_batch_opts();
+  batch_stats_t stats = {0};
+
+  TEST_ASSERT_EQ(batch_run_all_eligible(NULL, &config, &opts, &stats), -1,
+                 "Should reject NULL ops");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(
+      batch_run_all_eligible(&syscall_ops_default, &config, &opts, NULL), -1,
+      "Should reject NULL stats");
+}
+
+TEST(batch_run_all_eligible_filters_uid_range) {
+  char root[] = "root";
+  char alice[] = "alice";
+  char bob[] = "bob";
+  char nobody[] = "nobody";
+  const struct passwd table[] = {
+      {.pw_name = root, .pw_uid = 0},
+      {.pw_name = alice, .pw_uid = 1000},
+      {.pw_name = bob, .pw_uid = 1001},
+      {.pw_name = nobody, .pw_uid = 65534},
+  };
+  struct syscall_ops ops = make_pwent_ops(table, 4, 0);
+  config_t config = make_batch_config();
+  options_t opts = make_batch_opts();
+  batch_stats_t stats = {0};
+
+  opts.all_eligible = true;
+  opts.debug = true;
+
+  TEST_ASSERT_EQ(batch_run_all_eligible(&ops, &config, &opts, &stats), 0,
+                 "Should succeed");
+  TEST_ASSERT_EQ(stats.total, 2, "Should only count eligible accounts");
+  TEST_ASSERT_EQ(stats.ok, 2, "Should enroll both eligible accounts");
+  TEST_ASSERT_EQ(mock_setpwent_calls, 1, "Should rewind the database once");
+  TEST_ASSERT_EQ(mock_endpwent_calls, 1, "Should release the cursor");
+}
+
+TEST(batch_run_all_eligible_bad_names) {
+  char bad[] = "bad;name";
+  char good[] = "carol";
+  char long_name[1024];
+  memset(long_name, 'a', sizeof(long_name) - 1);
+  long_name[sizeof(long_name) - 1] = '\0';
+  const struct passwd table[] = {
+      {.pw_name = bad, .pw_uid = 1001},
+      {.pw_name = long_name, .pw_uid = 1002},
+      {.pw_name = NULL, .pw_uid = 1003},
+      {.pw_name = good, .pw_uid = 1004},
+  };
+  struct syscall_ops ops = make_pwent_ops(table, 4, ENOENT);
+  config_t config = make_batch_config();
+  options_t opts = make_batch_opts();
+  batch_stats_t stats = {0};
+
+  TEST_ASSERT_EQ(batch_run_all_eligible(&ops, &config, &opts, &stats), -1,
+                 "Should report failure for unusable names");
+  TEST_ASSERT_EQ(stats.total, 4, "Should count every eligible account");
+  TEST_ASSERT_EQ(stats.failed, 3, "Should fail invalid, long and NULL names");
+  TEST_ASSERT_EQ(stats.ok, 1, "Should still enroll valid accounts");
+}
+
+TEST(batch_run_all_eligible_enumeration_error) {
+  char alice[] = "alice";
+  const struct passwd table[] = {
+      {.pw_name = alice, .pw_uid = 1000},
+  };
+  struct syscall_ops ops = make_pwent_ops(table, 1, EIO);
+  config_t config = make_batch_config();
+  options_t opts = make_batch_opts();
+  batch_stats_t stats = {0};
+
+  TEST_ASSERT_EQ(batch_run_all_eligible(&ops, &config, &opts, &stats), -1,
+                 "Should fail when enumeration ends with an error");
+  TEST_ASSERT_EQ(errno, EIO, "Should preserve the enumeration error");
+  TEST_ASSERT_EQ(stats.ok, 1, "Entries before the error are still enrolled");
+  TEST_ASSERT_EQ(mock_endpwent_calls, 1, "Should release the cursor");
+}
+
+TEST(batch_run_all_eligible_calloc_fails) {
+  struct syscall_ops ops = make_pwent_ops(NULL, 0, 0);
+  config_t config = make_batch_config();
+  options_t opts = make_batch_opts();
+  batch_stats_t stats = {0};
+
+  ops.calloc = mock_calloc_null;
+
+  TEST_ASSERT_EQ(batch_run_all_eligible(&ops, &config, &opts, &stats), -1,
+                 "Should fail when the username buffer cannot be allocated");
+  TEST_ASSERT_EQ(mock_setpwent_calls, 0, "Should not open the database");
+}
+
+/* ============================================================================
+ * Tests - Files writer
+ * ============================================================================
+ */
+
+TEST(batch_run_args_files_writer_commit_fails) {
+  struct syscall_ops ops = make_batch_ops();
+  config_t config = make_batch_config();
+  options_t opts = make_batch_opts();
+  batch_stats_t stats = {0};
+  char bad[] = "bad;user";
+  char user[] = "testuser";
+  char uid[] = "1000";
+  char *entries[] = {bad, user, uid, NULL};
+
+  config.subid_writer = SUBID_WRITER_FILES;
+  opts.noop = false;
+  opts.user_args = entries;
+  opts.user_argc = 3;
+  ops.lckpwdf = mock_lckpwdf_eacces;
+
+  TEST_ASSERT_EQ(batch_run_args(&ops, &config, &opts, &stats), -1,
+                 "Should fail when the queued ranges cannot be written");
+  TEST_ASSERT_EQ(stats.total, 3, "Should count every entry");
+  TEST_ASSERT_EQ(stats.ok, 0, "Unwritten entries are not ok");
+  TEST_ASSERT_EQ(stats.failed, 3, "Should move queued users to failed");
+}
+
+/* ============================================================================
+ * Tests - batch_print_summary
+ * ============================================================================
+ */
+
+TEST(batch_print_summary_format) {
+  batch_stats_t stats = {.total = 3, .ok = 2, .failed = 1};
+  char buf[256] = {0};
+  FILE *out = fmemopen(buf, sizeof(buf), "w");
+
+  TEST_ASSERT_NOT_EQ(out, NULL, "Test setup: fmemopen failed");
+  batch_print_summary(&stats, out);
+  batch_print_summary(NULL, out);
+  batch_print_summary(&stats, NULL);
+  fclose(out);
+
+  TEST_ASSERT_STR_EQ(buf,
+                     PROJECT_NAME ": batch: 3 processed, 2 ok, 1 failed\n",
+                     "Should print totals once");
+}
+
+/* ============================================================================
+ * Test Runner
+ * ============================================================================
+ */
+
+int main(int argc, char **argv) {
+  TEST_INIT(10, false, false); /* timeout, verbose, duration */
+
+  /* batch_read_entry */
+  RUN_TEST(batch_read_entry_null_params);
+  RUN_TEST(batch_read_entry_newline_separated);
+  RUN_TEST(batch_read_entry_nul_separated);
+
+  /* batch_run_args */
+  RUN_TEST(batch_run_args_null_params);
+  RUN_TEST(batch_run_args_all_ok);
+  RUN_TEST(batch_run_args_failure_does_not_abort);
+  RUN_TEST(batch_run_args_calloc_fails);
+  RUN_TEST(batch_run_args_parallel);
+  RUN_TEST(batch_run_args_parallel_calloc_fails);
+
+  /* batch_run_stream */
+  RUN_TEST(batch_run_stream_null_params);
+  RUN_TEST(batch_run_stream_mixed_results);
+  RUN_TEST(batch_run_stream_parallel_windows);
+  RUN_TEST(batch_run_stream_null_separated);
+  RUN_TEST(batch_run_stream_uid_out_of_range);
+  RUN_TEST(batch_run_stream_calloc_fails);
+
+  /* batch_run_all_eligible */
+  RUN_TEST(batch_run_all_eligible_null_params);
+  RUN_TEST(batch_run_all_eligible_filters_uid_range);
+  RUN_TEST(batch_run_all_eligible_bad_names);
+  RUN_TEST(batch_run_all_eligible_enumeration_error);
+  RUN_TEST(batch_run_all_eligible_calloc_fails);
+
+  /* Files writer */
+  RUN_TEST(batch_run_args_files_writer_commit_fails);
+
+  /* batch_print_summary */
+  RUN_TEST(batch_print_summary_format);
+
+  return TEST_EXECUTE();
+}
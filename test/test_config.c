@@ -10,7 +10,9 @@
 
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
+#include <stdalign.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
@@ -31,20 +33,15 @@ enum {
   MOCK_FD_MAIN_CONFIG = 101,
   MOCK_FD_DROPIN_01 = 102,
   MOCK_FD_DROPIN_02 = 103,
+  MOCK_FD_DROPIN_DIR = 104,
   MOCK_FD_CUSTOM = 42 /* Generic successful fd for custom content tests */
 };
 
-/* Mock FILE* pointer constants - distinct addresses for each source */
-#define MOCK_FILE_LOGIN_DEFS ((FILE *)0x1000)
-#define MOCK_FILE_MAIN_CONFIG ((FILE *)0x2000)
-#define MOCK_FILE_DROPIN_01 ((FILE *)0x3000)
-#define MOCK_FILE_DROPIN_02 ((FILE *)0x4000)
-#define MOCK_FILE_CUSTOM ((FILE *)0x5000)
-
 /* Test buffer and path size limits */
 enum {
   TEST_BUFFER_SIZE = 4096,
-  LONG_PATH_SIZE = 81920, /* Extremely long path for overflow testing */
+  LONG_NAME_SIZE = 5000, /* Drop-in name too long for PATH_MAX with dir */
+  MANY_DROPINS = 300,    /* Enough names to need several reads */
   OVERFLOW_CONFIG_SIZE = 256
 };
 
@@ -111,38 +108,28 @@ static const char *current_mock_content = NULL;
 static size_t current_mock_offset = 0;
 static const char *custom_content = NULL;
 
+/* Largest read() the mock satisfies at once, 0 for no limit */
+static size_t mock_read_limit = 0;
+
 /* ============================================================================
- * Mock Directory Entry Structures
+ * Mock Directory State
  * ============================================================================
  */
 
-/* Standard drop-in files */
-static struct dirent *mock_dirent_01 = NULL;
-static struct dirent **mock_namelist = NULL;
-
-/* Standard drop-in with two files */
-static struct dirent *mock_dirent_two_01 = NULL;
-static struct dirent *mock_dirent_two_02 = NULL;
-static struct dirent **mock_list_two = NULL;
-
-/* Security validation test scenarios */
-static struct dirent *mock_dirent_separator = NULL;
-static struct dirent **mock_list_separator = NULL;
-
-static struct dirent *mock_dirent_traversal = NULL;
-static struct dirent **mock_list_traversal = NULL;
-
-static struct dirent *mock_dirent_absolute = NULL;
-static struct dirent **mock_list_absolute = NULL;
+/* Entries the mock drop-in directory lists, NULL when it does not exist */
+static const char *const *mock_dir_names = NULL;
+static size_t mock_dir_count = 0;
 
-static struct dirent *mock_dirent_hidden = NULL;
-static struct dirent **mock_list_hidden = NULL;
+/* Next entry mock_getdents64 returns */
+static size_t mock_dir_pos = 0;
 
-static struct dirent *mock_dirent_dotdot = NULL;
-static struct dirent **mock_list_dotdot = NULL;
+/* fstat() of the drop-in directory descriptor */
+static int (*mock_dir_fstat)(int fd, struct stat *statbuf) = NULL;
 
-static struct dirent *mock_dirent_long = NULL;
-static struct dirent **mock_list_long = NULL;
+/* Drop-in names passed to mock_openat, in call order */
+static char mock_opened_last[TEST_BUFFER_SIZE];
+static size_t mock_opened_count = 0;
+static bool mock_opened_sorted = true;
 
 /* ============================================================================
  * Mock I/O State Management
@@ -170,69 +157,6 @@ static void set_mock_content(const char *content) {
   current_mock_offset = 0;
 }
 
-/* ============================================================================
- * Mock Scandir Helper - Reduces Code Duplication
- * ============================================================================
- */
-
-/**
- * create_single_dirent - Allocates and initializes a single directory entry
- * @name: Filename to store in d_name field
- *
- * Returns: Allocated dirent structure, or NULL on allocation failure
- *
- * Caller is responsible for freeing returned memory.
- */
-static struct dirent *create_single_dirent(const char *name) {
-  size_t name_len;
-  size_t alloc_size;
-  struct dirent *entry;
-
-  if (name == NULL) {
-    return NULL;
-  }
-
-  name_len = strlen(name);
-  alloc_size = sizeof(struct dirent) + name_len + 1;
-  entry = calloc(1, alloc_size);
-
-  if (entry != NULL) {
-    strcpy(entry->d_name, name);
-  }
-
-  return entry;
-}
-
-/**
- * create_dirent_list - Creates a directory entry list for scandir
- * @entries: Array of directory entries to include in list
- * @count: Number of entries in array
- *
- * Returns: Allocated array of pointers to directory entries
- *
- * Caller is responsible for freeing returned memory and entry structures.
- */
-static struct dirent **create_dirent_list(struct dirent **entries,
-                                          size_t count) {
-  struct dirent **list;
-  size_t i;
-
-  if (entries == NULL || count == 0) {
-    return NULL;
-  }
-
-  list = calloc(count, sizeof(struct dirent *));
-  if (list == NULL) {
-    return NULL;
-  }
-
-  for (i = 0; i < count; i++) {
-    list[i] = entries[i];
-  }
-
-  return list;
-}
-
 /* ============================================================================
  * Mock Functions - Basic File Operations
  * ============================================================================
@@ -303,14 +227,15 @@ static int mock_open_success(const char *pathname, int flags, ...) {
 }
 
 /**
- * mock_close - Validates fd range and returns success for mock fds
+ * mock_close - Validates fd range and resets mock file reading state
  * @fd: File descriptor to close
  *
  * Returns: 0 on success, -1 with errno=EBADF for invalid fd
  */
 static int mock_close(int fd) {
-  if ((fd >= MOCK_FD_LOGIN_DEFS && fd <= MOCK_FD_DROPIN_02) ||
+  if ((fd >= MOCK_FD_LOGIN_DEFS && fd <= MOCK_FD_DROPIN_DIR) ||
       fd == MOCK_FD_CUSTOM) {
+    reset_mock_io_state();
     return 0;
   }
   errno = EBADF;
@@ -318,320 +243,234 @@ static int mock_close(int fd) {
 }
 
 /**
- * mock_fdopen - Associates file descriptors with mock content
- * @fd: File descriptor from mock_open
- * @mode: File mode (unused)
- *
- * Returns distinct FILE* pointers for each configuration source.
+ * mock_content_for_fd - Content behind a mock file descriptor
+ * @fd: File descriptor from mock_open or mock_open_success
  *
- * Returns: Mock FILE pointer on success, NULL with errno=EBADF on failure
+ * Returns: Content string, NULL for an unknown fd
  */
-static FILE *mock_fdopen(int fd, const char *mode) {
-  (void)mode;
-
+static const char *mock_content_for_fd(int fd) {
   switch (fd) {
   case MOCK_FD_LOGIN_DEFS:
-    set_mock_content(MOCK_LOGIN_DEFS);
-    return MOCK_FILE_LOGIN_DEFS;
-
+    return MOCK_LOGIN_DEFS;
   case MOCK_FD_MAIN_CONFIG:
-    set_mock_content(MOCK_MAIN_CONFIG);
-    return MOCK_FILE_MAIN_CONFIG;
-
+    return MOCK_MAIN_CONFIG;
   case MOCK_FD_DROPIN_01:
-    set_mock_content(MOCK_DROPIN_01);
-    return MOCK_FILE_DROPIN_01;
-
+    return MOCK_DROPIN_01;
   case MOCK_FD_DROPIN_02:
-    set_mock_content(MOCK_DROPIN_02);
-    return MOCK_FILE_DROPIN_02;
-
+    return MOCK_DROPIN_02;
+  case MOCK_FD_CUSTOM:
+    return custom_content;
   default:
-    errno = EBADF;
     return NULL;
   }
 }
 
 /**
- * custom_fdopen - Injects dynamically provided test content
- * @fd: File descriptor (unused)
- * @mode: File mode (unused)
- *
- * Used by make_ops_with_content() for test-specific configuration.
- *
- * Returns: Mock FILE pointer
- */
-static FILE *custom_fdopen(int fd, const char *mode) {
-  (void)fd;
-  (void)mode;
-  set_mock_content(custom_content);
-  return MOCK_FILE_CUSTOM;
-}
-
-/**
- * mock_fgets - Simulates line-by-line file reading
- * @str: Buffer to store read line
- * @n: Maximum bytes to read including null terminator
- * @stream: FILE pointer (unused, state tracked globally)
+ * mock_read - Simulates reading a configuration file
+ * @fd: File descriptor from mock_open or mock_open_success
+ * @buf: Buffer to fill
+ * @count: Size of @buf
  *
- * Respects buffer limits and handles newline-delimited reading correctly.
- * Advances current_mock_offset to track position in content.
+ * The first read after a close selects the content for @fd. At most
+ * mock_read_limit bytes are returned per call when it is set, so callers
+ * see short reads. Advances current_mock_offset to track position.
  *
- * Returns: str on success, NULL at end of content
+ * Returns: Bytes copied, 0 at end of content, -1 with errno=EBADF for an
+ * unknown fd
  */
-static char *mock_fgets(char *str, int n, FILE *stream) {
-  size_t content_len;
-  size_t remaining;
-  size_t to_copy;
-  const char *src;
-  const char *newline;
-
-  (void)stream;
-
-  if (current_mock_content == NULL || n <= 0) {
-    return NULL;
-  }
-
-  content_len = strlen(current_mock_content);
-  if (current_mock_offset >= content_len) {
-    return NULL;
+static ssize_t mock_read(int fd, void *buf, size_t count) {
+  if (current_mock_content == NULL) {
+    const char *content = mock_content_for_fd(fd);
+    if (content == NULL) {
+      errno = EBADF;
+      return -1;
+    }
+    set_mock_content(content);
   }
 
-  remaining = content_len - current_mock_offset;
-  to_copy = (remaining < (size_t)(n - 1)) ? remaining : (size_t)(n - 1);
-
-  src = current_mock_content + current_mock_offset;
-  newline = memchr(src, '\n', to_copy);
-
-  if (newline != NULL) {
-    ptrdiff_t diff = newline - src + 1;
-    to_copy = (diff > 0) ? (size_t)diff : 0;
+  size_t remaining = strlen(current_mock_content) - current_mock_offset;
+  size_t to_copy = remaining < count ? remaining : count;
+  if (mock_read_limit != 0 && to_copy > mock_read_limit) {
+    to_copy = mock_read_limit;
   }
 
-  memcpy(str, src, to_copy);
-  str[to_copy] = '\0';
+  memcpy(buf, current_mock_content + current_mock_offset, to_copy);
   current_mock_offset += to_copy;
-
-  return str;
+  return (ssize_t)to_copy;
 }
 
 /**
- * mock_fclose - Resets mock file reading state
- * @stream: FILE pointer (unused)
+ * mock_read_eio - Fails every read with an I/O error
  *
- * Returns: Always 0
+ * Returns: -1 with errno=EIO
  */
-static int mock_fclose(FILE *stream) {
-  (void)stream;
-  reset_mock_io_state();
-  return 0;
+static ssize_t mock_read_eio(int fd, void *buf, size_t count) {
+  (void)fd;
+  (void)buf;
+  (void)count;
+  errno = EIO;
+  return -1;
 }
 
 /* ============================================================================
- * Mock Functions - Scandir Variants
+ * Mock Functions - Drop-in Directory
  * ============================================================================
  */
 
 /**
- * mock_scandir_with_dropin - Returns a valid drop-in configuration file
+ * mock_openat - Opens the mock drop-in directory and the files in it
+ * @dirfd: AT_FDCWD for the directory, MOCK_FD_DROPIN_DIR for its files
+ * @pathname: Directory path or file name
+ * @flags: Open flags (unused)
  *
- * Returns: 1 with allocated namelist containing two entries
- */
-static int mock_scandir_with_dropin(const char *dirp, struct dirent ***namelist,
-                                    int (*filter)(const struct dirent *),
-                                    int (*compar)(const struct dirent **,
-                                                  const struct dirent **)) {
-  struct dirent *entries[2];
-  (void)dirp;
-  (void)filter;
-  (void)compar;
-
-  mock_dirent_01 = create_single_dirent("01-override.conf");
-
-  entries[0] = mock_dirent_01;
-  mock_namelist = create_dirent_list(entries, 1);
-
-  *namelist = mock_namelist;
-  return 1;
-}
-
-/**
- * mock_scandir_two_files - Returns two valid drop-in configuration files
+ * The directory only exists once use_mock_dir() listed its entries. File
+ * names are recorded so tests can check the order they were opened in.
  *
- * Returns: 2 with allocated namelist containing two entries
+ * Returns: File descriptor on success, -1 with errno=ENOENT on failure
  */
-static int mock_scandir_two_files(const char *dirp, struct dirent ***namelist,
-                                  int (*filter)(const struct dirent *),
-                                  int (*compar)(const struct dirent **,
-                                                const struct dirent **)) {
-  struct dirent *entries[2];
-  (void)dirp;
-  (void)filter;
-  (void)compar;
-
-  mock_dirent_two_01 = create_single_dirent("01-override.conf");
-  mock_dirent_two_02 = create_single_dirent("02-override.conf");
-
-  entries[0] = mock_dirent_two_01;
-  entries[1] = mock_dirent_two_02;
-  mock_list_two = create_dirent_list(entries, 2);
+static int mock_openat(int dirfd, const char *pathname, int flags, ...) {
+  (void)flags;
 
-  *namelist = mock_list_two;
-  return 2;
-}
+  if (dirfd == AT_FDCWD) {
+    if (mock_dir_names != NULL &&
+        strcmp(pathname, CONFIG_DROPIN_DIR_PATH) == 0) {
+      mock_dir_pos = 0;
+      return MOCK_FD_DROPIN_DIR;
+    }
+    errno = ENOENT;
+    return -1;
+  }
+  if (dirfd != MOCK_FD_DROPIN_DIR) {
+    errno = EBADF;
+    return -1;
+  }
 
-/**
- * mock_scandir_path_separator - Returns filename with path separator
- *
- * Tests rejection of "invalid/name.conf".
- *
- * Returns: 1 with allocated namelist containing invalid entry
- */
-static int mock_scandir_path_separator(const char *dirp,
-                                       struct dirent ***namelist,
-                                       int (*filter)(const struct dirent *),
-                                       int (*compar)(const struct dirent **,
-                                                     const struct dirent **)) {
-  struct dirent *entries[1];
-  (void)dirp;
-  (void)filter;
-  (void)compar;
+  if (mock_opened_count > 0 && strcmp(mock_opened_last, pathname) >= 0) {
+    mock_opened_sorted = false;
+  }
+  (void)snprintf(mock_opened_last, sizeof(mock_opened_last), "%s", pathname);
+  mock_opened_count++;
 
-  mock_dirent_separator = create_single_dirent("invalid/name.conf");
-  entries[0] = mock_dirent_separator;
-  mock_list_separator = create_dirent_list(entries, 1);
+  if (strcmp(pathname, "01-override.conf") == 0) {
+    return MOCK_FD_DROPIN_01;
+  }
+  if (strcmp(pathname, "02-override.conf") == 0) {
+    return MOCK_FD_DROPIN_02;
+  }
 
-  *namelist = mock_list_separator;
-  return 1;
+  errno = ENOENT;
+  return -1;
 }
 
 /**
- * mock_scandir_path_traversal - Returns filename with path traversal
- *
- * Tests rejection of "../escape.conf".
+ * mock_openat_eacces - The drop-in directory cannot be opened
  *
- * Returns: 1 with allocated namelist containing traversal entry
+ * Returns: -1 with errno=EACCES
  */
-static int mock_scandir_path_traversal(const char *dirp,
-                                       struct dirent ***namelist,
-                                       int (*filter)(const struct dirent *),
-                                       int (*compar)(const struct dirent **,
-                                                     const struct dirent **)) {
-  struct dirent *entries[1];
-  (void)dirp;
-  (void)filter;
-  (void)compar;
-
-  mock_dirent_traversal = create_single_dirent("../escape.conf");
-  entries[0] = mock_dirent_traversal;
-  mock_list_traversal = create_dirent_list(entries, 1);
-
-  *namelist = mock_list_traversal;
-  return 1;
+static int mock_openat_eacces(int dirfd, const char *pathname, int flags,
+                              ...) {
+  (void)dirfd;
+  (void)pathname;
+  (void)flags;
+  errno = EACCES;
+  return -1;
 }
 
 /**
- * mock_scandir_absolute_path - Returns filename with absolute path
+ * mock_getdents64 - Lists mock_dir_names as getdents64(2) records
+ * @fd: Descriptor from mock_openat
+ * @dirp: Buffer to fill
+ * @count: Size of @dirp
  *
- * Tests rejection of "/etc/shadow.conf".
+ * Fills @dirp with as many whole records as fit, like the kernel.
  *
- * Returns: 1 with allocated namelist containing absolute path entry
+ * Returns: Bytes filled, 0 after the last entry, -1 with errno=EINVAL when
+ * not even one record fits
  */
-static int mock_scandir_absolute_path(const char *dirp,
-                                      struct dirent ***namelist,
-                                      int (*filter)(const struct dirent *),
-                                      int (*compar)(const struct dirent **,
-                                                    const struct dirent **)) {
-  struct dirent *entries[1];
-  (void)dirp;
-  (void)filter;
-  (void)compar;
+static ssize_t mock_getdents64(int fd, void *dirp, size_t count) {
+  size_t used = 0;
+
+  if (fd != MOCK_FD_DROPIN_DIR) {
+    errno = EBADF;
+    return -1;
+  }
 
-  mock_dirent_absolute = create_single_dirent("/etc/shadow.conf");
-  entries[0] = mock_dirent_absolute;
-  mock_list_absolute = create_dirent_list(entries, 1);
+  while (mock_dir_pos < mock_dir_count) {
+    const char *name = mock_dir_names[mock_dir_pos];
+    size_t reclen = offsetof(struct dirent64, d_name) + strlen(name) + 1;
+    reclen = (reclen + alignof(struct dirent64) - 1) &
+             ~(alignof(struct dirent64) - 1);
+    if (count - used < reclen) {
+      if (used == 0) {
+        errno = EINVAL;
+        return -1;
+      }
+      break;
+    }
+
+    struct dirent64 *entry = (void *)((unsigned char *)dirp + used);
+    memset(entry, 0, reclen);
+    entry->d_ino = mock_dir_pos + 1;
+    entry->d_reclen = (unsigned short)reclen;
+    entry->d_type = DT_REG;
+    strcpy(entry->d_name, name);
+    used += reclen;
+    mock_dir_pos++;
+  }
 
-  *namelist = mock_list_absolute;
-  return 1;
+  return (ssize_t)used;
 }
 
 /**
- * mock_scandir_hidden_file - Returns hidden file (dotfile)
- *
- * Tests rejection of ".hidden.conf".
+ * mock_getdents64_eperm - Reading the drop-in directory fails
  *
- * Returns: 1 with allocated namelist containing hidden file entry
+ * Returns: -1 with errno=EPERM
  */
-static int mock_scandir_hidden_file(const char *dirp, struct dirent ***namelist,
-                                    int (*filter)(const struct dirent *),
-                                    int (*compar)(const struct dirent **,
-                                                  const struct dirent **)) {
-  struct dirent *entries[1];
+static ssize_t mock_getdents64_eperm(int fd, void *dirp, size_t count) {
+  (void)fd;
   (void)dirp;
-  (void)filter;
-  (void)compar;
-
-  mock_dirent_hidden = create_single_dirent(".hidden.conf");
-  entries[0] = mock_dirent_hidden;
-  mock_list_hidden = create_dirent_list(entries, 1);
-
-  *namelist = mock_list_hidden;
-  return 1;
+  (void)count;
+  errno = EPERM;
+  return -1;
 }
 
 /**
- * mock_scandir_dotdot_prefix - Returns filename starting with ".."
+ * mock_fstat_dropin - fstat() for the drop-in directory and config files
+ * @fd: Descriptor to describe
+ * @statbuf: Filled with the mocked status
  *
- * Tests rejection of "..conf".
+ * The directory descriptor is described by mock_dir_fstat, every other
+ * descriptor is a root-owned regular file.
  *
- * Returns: 1 with allocated namelist containing dotdot entry
+ * Returns: Result of the selected mock
  */
-static int mock_scandir_dotdot_prefix(const char *dirp,
-                                      struct dirent ***namelist,
-                                      int (*filter)(const struct dirent *),
-                                      int (*compar)(const struct dirent **,
-                                                    const struct dirent **)) {
-  struct dirent *entries[1];
-  (void)dirp;
-  (void)filter;
-  (void)compar;
-
-  mock_dirent_dotdot = create_single_dirent("..conf");
-  entries[0] = mock_dirent_dotdot;
-  mock_list_dotdot = create_dirent_list(entries, 1);
-
-  *namelist = mock_list_dotdot;
-  return 1;
+static int mock_fstat_dropin(int fd, struct stat *statbuf) {
+  if (fd == MOCK_FD_DROPIN_DIR) {
+    return mock_dir_fstat(fd, statbuf);
+  }
+  return mock_fstat_root_file(fd, statbuf);
 }
 
-/**
- * mock_scandir_long_path - Returns extremely long filename
- *
- * Tests handling of paths exceeding PATH_MAX.
- *
- * Returns: 1 with allocated namelist containing very long entry
+/* ============================================================================
+ * Drop-in Directory Listings
+ * ============================================================================
  */
-static int mock_scandir_long_path(const char *dirp, struct dirent ***namelist,
-                                  int (*filter)(const struct dirent *),
-                                  int (*compar)(const struct dirent **,
-                                                const struct dirent **)) {
-  struct dirent *entries[1];
-  (void)dirp;
-  (void)filter;
-  (void)compar;
 
-  mock_dirent_long = calloc(1, sizeof(struct dirent) + LONG_PATH_SIZE);
-  if (mock_dirent_long != NULL) {
-    memset(mock_dirent_long->d_name, 'A', LONG_PATH_SIZE - 6);
-    strcpy(mock_dirent_long->d_name + (LONG_PATH_SIZE - 6), ".conf");
-  }
+static const char *const DIR_EMPTY[] = {".", ".."};
+static const char *const DIR_ONE_DROPIN[] = {".", "..", "01-override.conf"};
 
-  entries[0] = mock_dirent_long;
-  mock_list_long = create_dirent_list(entries, 1);
+/* Directory order is not name order */
+static const char *const DIR_TWO_DROPINS[] = {"02-override.conf", ".",
+                                              "01-override.conf", ".."};
 
-  *namelist = mock_list_long;
-  return 1;
-}
+static const char *const DIR_SEPARATOR[] = {".", "..", "invalid/name.conf"};
+static const char *const DIR_TRAVERSAL[] = {".", "..", "../escape.conf"};
+static const char *const DIR_ABSOLUTE[] = {".", "..", "/etc/shadow.conf"};
+static const char *const DIR_HIDDEN[] = {".", "..", ".hidden.conf"};
+static const char *const DIR_DOTDOT[] = {".", "..", "..conf"};
+
+/* Number of entries in a listing */
+#define DIR_LEN(names) (sizeof(names) / sizeof((names)[0]))
 
 /* ============================================================================
  * Fixture Helpers
@@ -641,7 +480,7 @@ static int mock_scandir_long_path(const char *dirp, struct dirent ***namelist,
 /**
  * make_default_ops - Creates standard syscall_ops with mock implementations
  *
- * Default configuration: all mocks enabled, scandir returns ENOENT.
+ * Default configuration: all mocks enabled, no drop-in directory.
  *
  * Returns: Initialized syscall_ops structure
  */
@@ -650,13 +489,35 @@ static struct syscall_ops make_default_ops(void) {
                             .close = mock_close,
                             .fstat = mock_fstat_root_file,
                             .stat = mock_stat_root_dir,
-                            .fdopen = mock_fdopen,
-                            .fgets = mock_fgets,
-                            .fclose = mock_fclose,
-                            .scandir = mock_scandir_enoent};
+                            .read = mock_read,
+                            .openat = mock_openat,
+                            .getdents64 = mock_getdents64,
+                            .calloc = calloc,
+                            .free = free};
+  mock_dir_names = NULL;
+  mock_dir_count = 0;
+  mock_opened_count = 0;
+  mock_opened_sorted = true;
   return ops;
 }
 
+/**
+ * use_mock_dir - Makes the drop-in directory exist with the given entries
+ * @ops: Operations to adjust
+ * @names: Entries in directory order, including "." and ".."
+ * @count: Number of entries
+ *
+ * The directory is root-owned and not world-writable until the test sets
+ * mock_dir_fstat to something else.
+ */
+static void use_mock_dir(struct syscall_ops *ops, const char *const *names,
+                         size_t count) {
+  mock_dir_names = names;
+  mock_dir_count = count;
+  mock_dir_fstat = mock_fstat_root_dir;
+  ops->fstat = mock_fstat_dropin;
+}
+
 /**
  * make_ops_with_content - Creates ops with custom test content
  * @content: Null-terminated configuration string
@@ -669,8 +530,6 @@ static struct syscall_ops make_ops_with_content(const char *content) {
   struct syscall_ops ops = make_default_ops();
   custom_content = content;
   ops.open = mock_open_success;
-  ops.close = mock_close_any;
-  ops.fdopen = custom_fdopen;
   return ops;
 }
 
@@ -892,16 +751,16 @@ TEST(safe_open_config_fstat_enoent) {
   TEST_ASSERT_EQ(config.uid_min, DEFAULT_UID_MIN, "Should keep defaults");
 }
 
-TEST(safe_open_config_fdopen_fails) {
+TEST(parse_config_read_fails) {
   config_t config = {0};
   struct syscall_ops ops = make_default_ops();
   int result;
 
-  ops.fdopen = mock_fdopen_null;
+  ops.read = mock_read_eio;
   config_factory(&config);
   result = load_configuration(&ops, &config, true);
 
-  TEST_ASSERT_EQ(result, 0, "Should handle fdopen failure");
+  TEST_ASSERT_EQ(result, 0, "Should handle read failure");
   TEST_ASSERT_EQ(config.uid_min, DEFAULT_UID_MIN, "Should keep defaults");
 }
 
@@ -988,7 +847,7 @@ TEST(load_configuration_override_config_in_dropin) {
   struct syscall_ops ops = make_default_ops();
   int result;
 
-  ops.scandir = mock_scandir_with_dropin;
+  use_mock_dir(&ops, DIR_ONE_DROPIN, DIR_LEN(DIR_ONE_DROPIN));
   config_factory(&config);
   result = load_configuration(&ops, &config, true);
 
@@ -1006,7 +865,7 @@ TEST(load_configuration_override_dropin_in_another_dropin) {
   struct syscall_ops ops = make_default_ops();
   int result;
 
-  ops.scandir = mock_scandir_two_files;
+  use_mock_dir(&ops, DIR_TWO_DROPINS, DIR_LEN(DIR_TWO_DROPINS));
   config_factory(&config);
   result = load_configuration(&ops, &config, true);
 
@@ -1067,6 +926,27 @@ TEST(parse_config_blank_lines) {
   TEST_ASSERT_EQ(config.uid_min, 4000, "Should parse value");
 }
 
+TEST(parse_config_counts_stats) {
+  const char *content = "# Comment\nUID_MIN 4000\nUID_MAX 5000";
+  config_t config = {0};
+  struct syscall_ops ops = make_ops_with_content(content);
+  stats_t stats = {0};
+
+  config_factory(&config);
+  stats_reset();
+  TEST_ASSERT_EQ(load_configuration(&ops, &config, false), 0,
+                 "Should load the configuration");
+  stats_snapshot(&stats);
+  stats_reset();
+
+  uint64_t files = stats.count[STATS_FILES];
+  TEST_ASSERT_NOT_EQ(files, 0, "Should count the files parsed");
+  TEST_ASSERT_EQ(stats.count[STATS_LINES], 3 * files,
+                 "Should count every line, the unterminated one too");
+  TEST_ASSERT_EQ(stats.count[STATS_BYTES], strlen(content) * files,
+                 "Should count the bytes read");
+}
+
 TEST(parse_config_key_only_no_value) {
   config_t config = {0};
   struct syscall_ops ops = make_ops_with_content("UID_MIN\nUID_MAX 5000\n");
@@ -1110,6 +990,78 @@ TEST(parse_config_long_lines) {
   TEST_ASSERT_EQ(config.uid_min, DEFAULT_UID_MIN, "Should keep defaults");
 }
 
+TEST(parse_config_overlong_line_skipped) {
+  config_t config = {0};
+  char content[TEST_BUFFER_SIZE + 64];
+  struct syscall_ops ops;
+
+  /* "UID_MIN 7" buried at the end of a 2000 byte line must not apply */
+  memset(content, 'X', 2000);
+  (void)snprintf(content + 2000, sizeof(content) - 2000,
+                 " UID_MIN 7\nUID_MAX 5000\n");
+  ops = make_ops_with_content(content);
+
+  config_factory(&config);
+  TEST_ASSERT_EQ(load_configuration(&ops, &config, true), 0,
+                 "Should load configuration");
+  TEST_ASSERT_EQ(config.uid_min, DEFAULT_UID_MIN,
+                 "Should skip the whole overlong line");
+  TEST_ASSERT_EQ(config.uid_max, 5000, "Should parse the following line");
+}
+
+TEST(parse_config_short_reads) {
+  config_t config = {0};
+  struct syscall_ops ops =
+      make_ops_with_content("UID_MIN 2500\nSUB_UID_MIN 150000\n"
+                            "SUB_GID_COUNT 8192\n");
+
+  /* Every line straddles at least one read() boundary */
+  mock_read_limit = 3;
+  config_factory(&config);
+  TEST_ASSERT_EQ(load_configuration(&ops, &config, true), 0,
+                 "Should load configuration");
+  TEST_ASSERT_EQ(config.uid_min, 2500, "Should join UID_MIN across reads");
+  TEST_ASSERT_EQ(config.subuid.min_val, 150000,
+                 "Should join SUB_UID_MIN across reads");
+  TEST_ASSERT_EQ(config.subgid.count_val, 8192,
+                 "Should join SUB_GID_COUNT across reads");
+}
+
+TEST(parse_config_last_line_without_newline) {
+  config_t config = {0};
+  struct syscall_ops ops =
+      make_ops_with_content("UID_MIN 2500\nUID_MAX 45000");
+
+  config_factory(&config);
+  TEST_ASSERT_EQ(load_configuration(&ops, &config, true), 0,
+                 "Should load configuration");
+  TEST_ASSERT_EQ(config.uid_max, 45000, "Should parse the unterminated line");
+}
+
+TEST(parse_config_large_file) {
+  config_t config = {0};
+  size_t size = 64 * 1024;
+  char *content = calloc(1, size);
+  size_t used = 0;
+
+  TEST_ASSERT_NOT_EQ(content, NULL, "Should allocate content");
+
+  /* Several read buffers worth, with the key changing throughout */
+  for (unsigned int i = 0; used + 64 < size; i++) {
+    int len = snprintf(content + used, size - used,
+                       "# comment line %u\nUID_MIN %u\n", i, 1000 + i);
+    used += (size_t)len;
+  }
+  (void)snprintf(content + used, size - used, "UID_MIN 4242\n");
+  struct syscall_ops ops = make_ops_with_content(content);
+
+  config_factory(&config);
+  TEST_ASSERT_EQ(load_configuration(&ops, &config, true), 0,
+                 "Should load configuration");
+  TEST_ASSERT_EQ(config.uid_min, 4242, "Last value should win");
+  free(content);
+}
+
 TEST(parse_config_key_with_long_value) {
   config_t config = {0};
   char long_content[1024];
@@ -1237,6 +1189,108 @@ TEST(apply_config_allow_subid_wrap_no) {
   TEST_ASSERT_EQ(config.allow_subid_wrap, false, "Should parse 'no' as false");
 }
 
+TEST(apply_config_subid_backend_values) {
+  config_t config = {0};
+  struct syscall_ops ops = make_ops_with_content("SUBID_BACKEND Files\n");
+  int result;
+
+  config_factory(&config);
+  TEST_ASSERT_EQ(config.subid_backend, SUBID_BACKEND_GETSUBIDS,
+                 "Default backend should be getsubids");
+
+  result = load_configuration(&ops, &config, true);
+  TEST_ASSERT_EQ(result, 0, "Should parse SUBID_BACKEND");
+  TEST_ASSERT_EQ(config.subid_backend, SUBID_BACKEND_FILES,
+                 "Should parse 'Files' case-insensitively");
+
+  ops = make_ops_with_content("SUBID_BACKEND files\nSUBID_BACKEND getsubids\n");
+  result = load_configuration(&ops, &config, true);
+  TEST_ASSERT_EQ(result, 0, "Should parse SUBID_BACKEND");
+  TEST_ASSERT_EQ(config.subid_backend, SUBID_BACKEND_GETSUBIDS,
+                 "Last value should win");
+}
+
+TEST(apply_config_subid_backend_invalid) {
+  config_t config = {0};
+  struct syscall_ops ops =
+      make_ops_with_content("SUBID_BACKEND files\nSUBID_BACKEND libsubid\n");
+  int result;
+
+  config_factory(&config);
+  result = load_configuration(&ops, &config, true);
+
+  TEST_ASSERT_EQ(result, 0, "Unknown backend is not fatal");
+  TEST_ASSERT_EQ(config.subid_backend, SUBID_BACKEND_FILES,
+                 "Unknown backend should keep the previous value");
+}
+
+TEST(apply_config_skip_if_exact) {
+  config_t config = {0};
+  struct syscall_ops ops = make_ops_with_content("SKIP_IF_EXACT yes\n");
+  int result;
+
+  config_factory(&config);
+  TEST_ASSERT_EQ(config.skip_if_exact, false, "Default should be off");
+
+  result = load_configuration(&ops, &config, true);
+  TEST_ASSERT_EQ(result, 0, "Should parse SKIP_IF_EXACT");
+  TEST_ASSERT_EQ(config.skip_if_exact, true, "Should parse 'yes' as true");
+}
+
+TEST(apply_config_resolve_timeout_ms) {
+  config_t config = {0};
+  struct syscall_ops ops = make_ops_with_content("RESOLVE_TIMEOUT_MS 2500\n");
+  int result;
+
+  config_factory(&config);
+  TEST_ASSERT_EQ(config.resolve_timeout_ms, 0, "Default should wait forever");
+
+  result = load_configuration(&ops, &config, true);
+  TEST_ASSERT_EQ(result, 0, "Should parse RESOLVE_TIMEOUT_MS");
+  TEST_ASSERT_EQ(config.resolve_timeout_ms, 2500, "Should keep the deadline");
+}
+
+TEST(apply_config_subid_writer_values) {
+  config_t config = {0};
+  struct syscall_ops ops = make_ops_with_content("SUBID_WRITER Files\n");
+  int result;
+
+  config_factory(&config);
+  TEST_ASSERT_EQ(config.subid_writer, SUBID_WRITER_USERMOD,
+                 "Default writer should be usermod");
+
+  result = load_configuration(&ops, &config, true);
+  TEST_ASSERT_EQ(result, 0, "Should parse SUBID_WRITER");
+  TEST_ASSERT_EQ(config.subid_writer, SUBID_WRITER_FILES,
+                 "Should parse 'Files' case-insensitively");
+
+  ops = make_ops_with_content("SUBID_WRITER files\nSUBID_WRITER usermod\n");
+  result = load_configuration(&ops, &config, true);
+  TEST_ASSERT_EQ(result, 0, "Should parse SUBID_WRITER");
+  TEST_ASSERT_EQ(config.subid_writer, SUBID_WRITER_USERMOD,
+                 "Last value should win");
+
+  ops = make_ops_with_content("SUBID_WRITER spool\n");
+  result = load_configuration(&ops, &config, true);
+  TEST_ASSERT_EQ(result, 0, "Should parse SUBID_WRITER");
+  TEST_ASSERT_EQ(config.subid_writer, SUBID_WRITER_SPOOL,
+                 "Should parse 'spool'");
+}
+
+TEST(apply_config_subid_writer_invalid) {
+  config_t config = {0};
+  struct syscall_ops ops =
+      make_ops_with_content("SUBID_WRITER files\nSUBID_WRITER useradd\n");
+  int result;
+
+  config_factory(&config);
+  result = load_configuration(&ops, &config, true);
+
+  TEST_ASSERT_EQ(result, 0, "Unknown writer is not fatal");
+  TEST_ASSERT_EQ(config.subid_writer, SUBID_WRITER_FILES,
+                 "Unknown writer should keep the previous value");
+}
+
 /* ============================================================================
  * Tests: Value Limits and Numeric Validation
  * ============================================================================
@@ -1361,6 +1415,99 @@ TEST(apply_config_subgid_min_invalid_value) {
                  "Should keep default on parse failure");
 }
 
+/* ============================================================================
+ * Tests: UID Bands
+ * ============================================================================
+ */
+
+TEST(apply_config_subid_bands) {
+  config_t config = {0};
+  struct syscall_ops ops = make_ops_with_content(
+      "SUB_UID_BANDS 50000-50999:1048576,2000-2099:262144\n");
+  int result;
+
+  config_factory(&config);
+  result = load_configuration(&ops, &config, true);
+
+  TEST_ASSERT_EQ(result, 0, "Should accept a band list");
+  TEST_ASSERT_EQ(config.subuid.band_count, 2, "Should store every band");
+  TEST_ASSERT_EQ(config.subuid.bands[0].uid_lo, 2000,
+                 "Should sort the bands by UID");
+  TEST_ASSERT_EQ(config.subuid.bands[0].count, 262144,
+                 "Should keep each count with its band");
+  TEST_ASSERT_EQ(config.subuid.bands[1].uid_hi, 50999,
+                 "Should keep the last UID of a band");
+  TEST_ASSERT_EQ(config.subuid.segment_count, 5,
+                 "Should build the segment table");
+  TEST_ASSERT_EQ(config.subuid.segments[2].offset,
+                 (1000ULL * DEFAULT_SUB_UID_COUNT) + (100ULL * 262144),
+                 "Segment offsets should be prefix sums");
+  TEST_ASSERT_EQ(config.subgid.band_count, 0,
+                 "Should leave the other type alone");
+  TEST_ASSERT_EQ(config.subgid.segment_count, 0,
+                 "No bands should need no table");
+}
+
+TEST(apply_config_subid_bands_none) {
+  config_t config = {0};
+  struct syscall_ops ops = make_ops_with_content(
+      "SUB_GID_BANDS 2000-2099:1000\nSUB_GID_BANDS none\n");
+  int result;
+
+  config_factory(&config);
+  result = load_configuration(&ops, &config, true);
+
+  TEST_ASSERT_EQ(result, 0, "Should accept none");
+  TEST_ASSERT_EQ(config.subgid.band_count, 0, "none should clear the bands");
+}
+
+TEST(apply_config_subid_bands_invalid) {
+  const char *const invalid[] = {
+      "SUB_UID_BANDS 2000:1000\n",         "SUB_UID_BANDS 2000-2099\n",
+      "SUB_UID_BANDS 2000-2099:abc\n",     "SUB_UID_BANDS 2000:1000-2099\n",
+      "SUB_UID_BANDS 2000-2099:1000,\n",   "SUB_UID_BANDS -2000-2099:1000\n",
+      "SUB_UID_BANDS 2000-2099:99999999\n"};
+  config_t config = {0};
+
+  for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+    struct syscall_ops ops = make_ops_with_content(invalid[i]);
+    config_factory(&config);
+    TEST_ASSERT_EQ(load_configuration(&ops, &config, true), 0,
+                   "Should ignore an invalid band list");
+    TEST_ASSERT_EQ(config.subuid.band_count, 0, "Should keep no bands");
+  }
+
+  /* One band more than SUBID_BANDS_MAX */
+  char many[TEST_BUFFER_SIZE] = "SUB_UID_BANDS ";
+  for (int i = 0; i <= SUBID_BANDS_MAX; i++) {
+    char band[32] = {0};
+    (void)snprintf(band, sizeof(band), "%s%d-%d:1000", i > 0 ? "," : "",
+                   2000 + (i * 10), 2000 + (i * 10) + 9);
+    (void)strcat(many, band);
+  }
+  (void)strcat(many, "\n");
+  struct syscall_ops ops = make_ops_with_content(many);
+  config_factory(&config);
+  TEST_ASSERT_EQ(load_configuration(&ops, &config, true), 0,
+                 "Should ignore too many bands");
+  TEST_ASSERT_EQ(config.subuid.band_count, 0, "Should keep no bands");
+}
+
+TEST(apply_config_subid_bands_rejected) {
+  const char *const rejected[] = {
+      "SUB_UID_BANDS 2000-2099:1000,2050-2199:1000\n",
+      "SUB_UID_BANDS 500-2099:1000\n", "SUB_GID_BANDS 59000-60001:1000\n"};
+  config_t config = {0};
+
+  for (size_t i = 0; i < sizeof(rejected) / sizeof(rejected[0]); i++) {
+    struct syscall_ops ops = make_ops_with_content(rejected[i]);
+    config_factory(&config);
+    TEST_ASSERT_EQ(load_configuration(&ops, &config, true), -1,
+                   "Ambiguous bands should fail the load");
+    TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  }
+}
+
 /* ============================================================================
  * Tests: Directory Processing
  * ============================================================================
@@ -1382,7 +1529,7 @@ TEST(load_from_dir_empty_directory_debug) {
   struct syscall_ops ops = make_default_ops();
   int result;
 
-  ops.scandir = mock_scandir_zero_files;
+  use_mock_dir(&ops, DIR_EMPTY, DIR_LEN(DIR_EMPTY));
   config_factory(&config);
   result = load_configuration(&ops, &config, true);
 
@@ -1391,38 +1538,148 @@ TEST(load_from_dir_empty_directory_debug) {
                  "Should load main config");
 }
 
-TEST(load_from_dir_scandir_fails_not_enoent) {
+TEST(load_from_dir_getdents_fails) {
   config_t config = {0};
   struct syscall_ops ops = make_default_ops();
   int result;
 
-  ops.scandir = mock_scandir_eperm;
+  use_mock_dir(&ops, DIR_ONE_DROPIN, DIR_LEN(DIR_ONE_DROPIN));
+  ops.getdents64 = mock_getdents64_eperm;
   config_factory(&config);
   result = load_configuration(&ops, &config, true);
 
-  TEST_ASSERT_EQ(result, -1, "Should fail on scandir EPERM");
+  TEST_ASSERT_EQ(result, -1, "Should fail when the directory cannot be read");
   TEST_ASSERT_EQ(errno, EPERM, "Should set the correct error code");
 }
 
+TEST(load_from_dir_open_fails) {
+  config_t config = {0};
+  struct syscall_ops ops = make_default_ops();
+  int result;
+
+  ops.openat = mock_openat_eacces;
+  config_factory(&config);
+  result = load_configuration(&ops, &config, true);
+
+  TEST_ASSERT_EQ(result, -1, "Should fail on open failure other than ENOENT");
+  TEST_ASSERT_EQ(errno, EACCES, "Should set the correct error code");
+}
+
 TEST(load_from_dir_validate_fails) {
   config_t config = {0};
   struct syscall_ops ops = make_default_ops();
   int result;
 
-  ops.stat = mock_stat_eperm;
+  use_mock_dir(&ops, DIR_ONE_DROPIN, DIR_LEN(DIR_ONE_DROPIN));
+  mock_dir_fstat = mock_fstat_eperm;
   config_factory(&config);
   result = load_configuration(&ops, &config, true);
 
-  TEST_ASSERT_EQ(result, -1, "Should fail on stat failure");
+  TEST_ASSERT_EQ(result, -1, "Should fail on fstat failure");
+  TEST_ASSERT_EQ(errno, EPERM, "Should set the correct error code");
+  TEST_ASSERT_EQ(mock_opened_count, 0, "Should not open any drop-in");
+}
+
+TEST(load_from_dir_rejects_non_root_dir) {
+  config_t config = {0};
+  struct syscall_ops ops = make_default_ops();
+  int result;
+
+  use_mock_dir(&ops, DIR_ONE_DROPIN, DIR_LEN(DIR_ONE_DROPIN));
+  mock_dir_fstat = mock_fstat_non_root_dir;
+  config_factory(&config);
+  result = load_configuration(&ops, &config, true);
+
+  TEST_ASSERT_EQ(result, -1, "Should reject a directory not owned by root");
+  TEST_ASSERT_EQ(errno, EPERM, "Should set the correct error code");
+  TEST_ASSERT_EQ(mock_opened_count, 0, "Should not open any drop-in");
+}
+
+TEST(load_from_dir_rejects_world_writable_dir) {
+  config_t config = {0};
+  struct syscall_ops ops = make_default_ops();
+  int result;
+
+  use_mock_dir(&ops, DIR_ONE_DROPIN, DIR_LEN(DIR_ONE_DROPIN));
+  mock_dir_fstat = mock_fstat_root_dir_world_write;
+  config_factory(&config);
+  result = load_configuration(&ops, &config, false);
+
+  TEST_ASSERT_EQ(result, -1, "Should reject a world-writable directory");
   TEST_ASSERT_EQ(errno, EPERM, "Should set the correct error code");
 }
 
+TEST(load_from_dir_rejects_non_directory) {
+  config_t config = {0};
+  struct syscall_ops ops = make_default_ops();
+  int result;
+
+  use_mock_dir(&ops, DIR_ONE_DROPIN, DIR_LEN(DIR_ONE_DROPIN));
+  mock_dir_fstat = mock_fstat_root_file;
+  config_factory(&config);
+  result = load_configuration(&ops, &config, true);
+
+  TEST_ASSERT_EQ(result, -1, "Should reject a path that is not a directory");
+  TEST_ASSERT_EQ(errno, ENOTDIR, "Should set the correct error code");
+}
+
+TEST(load_from_dir_calloc_fails) {
+  config_t config = {0};
+  struct syscall_ops ops = make_default_ops();
+  int result;
+
+  use_mock_dir(&ops, DIR_ONE_DROPIN, DIR_LEN(DIR_ONE_DROPIN));
+  ops.calloc = mock_calloc_null;
+  config_factory(&config);
+  result = load_configuration(&ops, &config, true);
+
+  TEST_ASSERT_EQ(result, -1, "Should fail without memory for the names");
+  TEST_ASSERT_EQ(errno, ENOMEM, "Should set the correct error code");
+}
+
+TEST(load_from_dir_many_files_sorted) {
+  config_t config = {0};
+  struct syscall_ops ops = make_default_ops();
+  static char names[MANY_DROPINS][32];
+  static const char *list[MANY_DROPINS];
+  int result;
+
+  /* Reverse order, and enough bytes to need several reads and growths */
+  for (size_t i = 0; i < MANY_DROPINS; i++) {
+    (void)snprintf(names[i], sizeof(names[i]), "%04zu-tenant.conf",
+                   MANY_DROPINS - i);
+    list[i] = names[i];
+  }
+  use_mock_dir(&ops, list, MANY_DROPINS);
+  config_factory(&config);
+  result = load_configuration(&ops, &config, false);
+
+  TEST_ASSERT_EQ(result, 0, "Should skip drop-ins that vanished");
+  TEST_ASSERT_EQ(mock_opened_count, MANY_DROPINS, "Should open every drop-in");
+  TEST_ASSERT_EQ(mock_opened_sorted, true, "Should open them in name order");
+}
+
+TEST(load_from_dir_dropin_fails_checks) {
+  config_t config = {0};
+  struct syscall_ops ops = make_default_ops();
+  int result;
+
+  use_mock_dir(&ops, DIR_ONE_DROPIN, DIR_LEN(DIR_ONE_DROPIN));
+  ops.fstat = mock_fstat_root_dir;
+  config_factory(&config);
+  result = load_configuration(&ops, &config, true);
+
+  TEST_ASSERT_EQ(result, 0, "Should skip a drop-in that is not a file");
+  TEST_ASSERT_EQ(config.uid_max, DEFAULT_UID_MAX,
+                 "Should not parse the rejected drop-in");
+}
+
 TEST(load_from_dir_process_files_non_debug) {
   config_t config = {0};
   struct syscall_ops ops = make_default_ops();
   int result;
 
-  ops.scandir = mock_scandir_two_files;
+  use_mock_dir(&ops, DIR_TWO_DROPINS, DIR_LEN(DIR_TWO_DROPINS));
   config_factory(&config);
   result = load_configuration(&ops, &config, false);
 
@@ -1431,10 +1688,6 @@ TEST(load_from_dir_process_files_non_debug) {
                  "Drop-in 02 should override 01");
   TEST_ASSERT_EQ(config.subuid.count_val, DROPIN_02_SUB_UID_COUNT,
                  "Drop-in 02 should override 01");
-
-  mock_dirent_two_01 = NULL;
-  mock_dirent_two_02 = NULL;
-  mock_list_two = NULL;
 }
 
 /* ============================================================================
@@ -1447,16 +1700,13 @@ TEST(load_from_dir_rejects_path_traversal) {
   struct syscall_ops ops = make_default_ops();
   int result;
 
-  ops.scandir = mock_scandir_path_traversal;
+  use_mock_dir(&ops, DIR_TRAVERSAL, DIR_LEN(DIR_TRAVERSAL));
   config_factory(&config);
   result = load_configuration(&ops, &config, true);
 
   TEST_ASSERT_EQ(result, 0, "Should skip path traversal");
   TEST_ASSERT_EQ(config.uid_min, MAIN_CONFIG_UID_MIN,
                  "Should load main config");
-
-  mock_dirent_traversal = NULL;
-  mock_list_traversal = NULL;
 }
 
 TEST(load_from_dir_rejects_path_separator_in_name) {
@@ -1464,16 +1714,13 @@ TEST(load_from_dir_rejects_path_separator_in_name) {
   struct syscall_ops ops = make_default_ops();
   int result;
 
-  ops.scandir = mock_scandir_path_separator;
+  use_mock_dir(&ops, DIR_SEPARATOR, DIR_LEN(DIR_SEPARATOR));
   config_factory(&config);
   result = load_configuration(&ops, &config, true);
 
   TEST_ASSERT_EQ(result, 0, "Should skip path with separator");
   TEST_ASSERT_EQ(config.uid_min, MAIN_CONFIG_UID_MIN,
                  "Should load main config");
-
-  mock_dirent_separator = NULL;
-  mock_list_separator = NULL;
 }
 
 TEST(load_from_dir_rejects_path_separator_nondebug) {
@@ -1481,16 +1728,13 @@ TEST(load_from_dir_rejects_path_separator_nondebug) {
   struct syscall_ops ops = make_default_ops();
   int result;
 
-  ops.scandir = mock_scandir_path_separator;
+  use_mock_dir(&ops, DIR_SEPARATOR, DIR_LEN(DIR_SEPARATOR));
   config_factory(&config);
   result = load_configuration(&ops, &config, false);
 
   TEST_ASSERT_EQ(result, 0, "Should skip path with separator silently");
   TEST_ASSERT_EQ(config.uid_min, MAIN_CONFIG_UID_MIN,
                  "Should load main config");
-
-  mock_dirent_separator = NULL;
-  mock_list_separator = NULL;
 }
 
 TEST(load_from_dir_rejects_absolute_path_in_name) {
@@ -1498,16 +1742,13 @@ TEST(load_from_dir_rejects_absolute_path_in_name) {
   struct syscall_ops ops = make_default_ops();
   int result;
 
-  ops.scandir = mock_scandir_absolute_path;
+  use_mock_dir(&ops, DIR_ABSOLUTE, DIR_LEN(DIR_ABSOLUTE));
   config_factory(&config);
   result = load_configuration(&ops, &config, true);
 
   TEST_ASSERT_EQ(result, 0, "Should skip absolute path");
   TEST_ASSERT_EQ(config.uid_min, MAIN_CONFIG_UID_MIN,
                  "Should load main config");
-
-  mock_dirent_absolute = NULL;
-  mock_list_absolute = NULL;
 }
 
 TEST(load_from_dir_rejects_hidden_files) {
@@ -1515,16 +1756,13 @@ TEST(load_from_dir_rejects_hidden_files) {
   struct syscall_ops ops = make_default_ops();
   int result;
 
-  ops.scandir = mock_scandir_hidden_file;
+  use_mock_dir(&ops, DIR_HIDDEN, DIR_LEN(DIR_HIDDEN));
   config_factory(&config);
   result = load_configuration(&ops, &config, true);
 
   TEST_ASSERT_EQ(result, 0, "Should skip hidden files");
   TEST_ASSERT_EQ(config.uid_min, MAIN_CONFIG_UID_MIN,
                  "Should load main config");
-
-  mock_dirent_hidden = NULL;
-  mock_list_hidden = NULL;
 }
 
 TEST(load_from_dir_rejects_dotdot_prefix_debug) {
@@ -1532,16 +1770,13 @@ TEST(load_from_dir_rejects_dotdot_prefix_debug) {
   struct syscall_ops ops = make_default_ops();
   int result;
 
-  ops.scandir = mock_scandir_dotdot_prefix;
+  use_mock_dir(&ops, DIR_DOTDOT, DIR_LEN(DIR_DOTDOT));
   config_factory(&config);
   result = load_configuration(&ops, &config, true);
 
   TEST_ASSERT_EQ(result, 0, "Should skip ..conf files");
   TEST_ASSERT_EQ(config.uid_min, MAIN_CONFIG_UID_MIN,
                  "Should load main config");
-
-  mock_dirent_dotdot = NULL;
-  mock_list_dotdot = NULL;
 }
 
 TEST(load_from_dir_rejects_dotdot_prefix_nondebug) {
@@ -1549,33 +1784,32 @@ TEST(load_from_dir_rejects_dotdot_prefix_nondebug) {
   struct syscall_ops ops = make_default_ops();
   int result;
 
-  ops.scandir = mock_scandir_dotdot_prefix;
+  use_mock_dir(&ops, DIR_DOTDOT, DIR_LEN(DIR_DOTDOT));
   config_factory(&config);
   result = load_configuration(&ops, &config, false);
 
   TEST_ASSERT_EQ(result, 0, "Should skip ..conf files silently");
   TEST_ASSERT_EQ(config.uid_min, MAIN_CONFIG_UID_MIN,
                  "Should load main config");
-
-  mock_dirent_dotdot = NULL;
-  mock_list_dotdot = NULL;
 }
 
 TEST(load_from_dir_path_too_long) {
   config_t config = {0};
   struct syscall_ops ops = make_default_ops();
+  static char long_name[LONG_NAME_SIZE];
+  static const char *list[] = {".", "..", long_name};
   int result;
 
-  ops.scandir = mock_scandir_long_path;
+  memset(long_name, 'A', LONG_NAME_SIZE - 6);
+  strcpy(long_name + (LONG_NAME_SIZE - 6), ".conf");
+  use_mock_dir(&ops, list, DIR_LEN(list));
   config_factory(&config);
   result = load_configuration(&ops, &config, true);
 
   TEST_ASSERT_EQ(result, 0, "Should skip too-long path");
   TEST_ASSERT_EQ(config.uid_min, MAIN_CONFIG_UID_MIN,
                  "Should load main config");
-
-  mock_dirent_long = NULL;
-  mock_list_long = NULL;
+  TEST_ASSERT_EQ(mock_opened_count, 0, "Should not open the drop-in");
 }
 
 /* ============================================================================
@@ -1613,6 +1847,27 @@ TEST(print_configuration_valid) {
   fclose(memfile);
 
   TEST_ASSERT_NOT_EQ(strstr(buffer, "UID_MIN"), NULL, "Should print UID_MIN");
+  TEST_ASSERT_NOT_EQ(strstr(buffer, "SUBID_BACKEND:\tgetsubids"), NULL,
+                     "Should print SUBID_BACKEND");
+  TEST_ASSERT_NOT_EQ(strstr(buffer, "SUB_UID_BANDS:\tnone"), NULL,
+                     "Should print no bands");
+
+  config.subgid.bands[0] = (subid_band_t){2000, 2099, 1000};
+  config.subgid.bands[1] = (subid_band_t){3000, 3000, 5000};
+  config.subgid.band_count = 2;
+  memfile = fmemopen(buffer, sizeof(buffer), "w");
+  print_configuration(&config, memfile, NULL);
+  fclose(memfile);
+  TEST_ASSERT_NOT_EQ(strstr(buffer, "SUB_GID_BANDS:\t2000-2099:1000,"
+                                    "3000-3000:5000\n"),
+                     NULL, "Should print the bands as configured");
+
+  config.subid_backend = SUBID_BACKEND_FILES;
+  memfile = fmemopen(buffer, sizeof(buffer), "w");
+  print_configuration(&config, memfile, NULL);
+  fclose(memfile);
+  TEST_ASSERT_NOT_EQ(strstr(buffer, "SUBID_BACKEND:\tfiles"), NULL,
+                     "Should print files backend");
 
   /* Should not crash on any of these */
 
@@ -1682,7 +1937,7 @@ int main(int argc, char **argv) {
   RUN_TEST(safe_open_config_open_fails_eacces);
   RUN_TEST(safe_open_config_fstat_eperm);
   RUN_TEST(safe_open_config_fstat_enoent);
-  RUN_TEST(safe_open_config_fdopen_fails);
+  RUN_TEST(parse_config_read_fails);
   RUN_TEST(safe_open_config_enoent_debug_mode);
   RUN_TEST(safe_open_config_enoent_nondebug);
 
@@ -1697,9 +1952,14 @@ int main(int argc, char **argv) {
   /* Parsing edge cases */
   RUN_TEST(load_configuration_comments_ignored);
   RUN_TEST(parse_config_blank_lines);
+  RUN_TEST(parse_config_counts_stats);
   RUN_TEST(parse_config_key_only_no_value);
   RUN_TEST(parse_config_key_only_no_value_nondebug);
   RUN_TEST(parse_config_long_lines);
+  RUN_TEST(parse_config_overlong_line_skipped);
+  RUN_TEST(parse_config_short_reads);
+  RUN_TEST(parse_config_last_line_without_newline);
+  RUN_TEST(parse_config_large_file);
   RUN_TEST(parse_config_key_with_long_value);
   RUN_TEST(parse_config_whitespace_only_value);
   RUN_TEST(parse_config_whitespace_complex_values);
@@ -1710,6 +1970,12 @@ int main(int argc, char **argv) {
   RUN_TEST(apply_config_bool_literal_values);
   RUN_TEST(apply_config_bool_numeric_values);
   RUN_TEST(apply_config_allow_subid_wrap_no);
+  RUN_TEST(apply_config_subid_backend_values);
+  RUN_TEST(apply_config_subid_backend_invalid);
+  RUN_TEST(apply_config_skip_if_exact);
+  RUN_TEST(apply_config_resolve_timeout_ms);
+  RUN_TEST(apply_config_subid_writer_values);
+  RUN_TEST(apply_config_subid_writer_invalid);
 
   /* Value limits and numeric validation */
   RUN_TEST(apply_config_count_exceeds_max);
@@ -1720,11 +1986,24 @@ int main(int argc, char **argv) {
   RUN_TEST(apply_config_subuid_count_invalid_value);
   RUN_TEST(apply_config_subgid_min_invalid_value);
 
+  /* UID bands */
+  RUN_TEST(apply_config_subid_bands);
+  RUN_TEST(apply_config_subid_bands_none);
+  RUN_TEST(apply_config_subid_bands_invalid);
+  RUN_TEST(apply_config_subid_bands_rejected);
+
   /* Directory processing */
   RUN_TEST(load_from_dir_empty);
   RUN_TEST(load_from_dir_empty_directory_debug);
-  RUN_TEST(load_from_dir_scandir_fails_not_enoent);
+  RUN_TEST(load_from_dir_getdents_fails);
+  RUN_TEST(load_from_dir_open_fails);
   RUN_TEST(load_from_dir_validate_fails);
+  RUN_TEST(load_from_dir_rejects_non_root_dir);
+  RUN_TEST(load_from_dir_rejects_world_writable_dir);
+  RUN_TEST(load_from_dir_rejects_non_directory);
+  RUN_TEST(load_from_dir_calloc_fails);
+  RUN_TEST(load_from_dir_many_files_sorted);
+  RUN_TEST(load_from_dir_dropin_fails_checks);
   RUN_TEST(load_from_dir_process_files_non_debug);
 
   /* Filename security validation */
@@ -0,0 +1,333 @@
+/**
+ * test_config_cache.c - Tests for the configuration snapshot cache
+ *
+ * Snapshots are written into a private temporary directory. Ownership is
+ * mocked through fstat() so the root-owned check can be exercised without
+ * running the tests as root.
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "test_framework.h"
+#include "test_helpers/all.h"
+
+/* ============================================================================
+ * Constants
+ * ============================================================================
+ */
+
+/* Size of the mkdtemp(3) path buffer and of the cache directory under it */
+enum { TMPDIR_SIZE = 64, CACHE_DIR_SIZE = TMPDIR_SIZE + 8 };
+
+/* Fingerprint the snapshots under test are keyed on */
+#define TEST_FINGERPRINT UINT64_C(0x0123456789abcdef)
+
+/* ============================================================================
+ * Global State
+ * ============================================================================
+ */
+
+/* Private directory holding the cache directory */
+static char tmpdir[TMPDIR_SIZE] = {0};
+
+/* Cache directory inside tmpdir, created by config_cache_store() */
+static char cache_dir[CACHE_DIR_SIZE] = {0};
+
+/* ============================================================================
+ * Mock Functions
+ * ============================================================================
+ */
+
+/**
+ * mock_mkdir_eacces - Fail to create the cache directory
+ */
+static int mock_mkdir_eacces(const char *pathname, mode_t mode) {
+  (void)pathname;
+  (void)mode;
+  errno = EACCES;
+  return -1;
+}
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================
+ */
+
+/**
+ * setup_tmpdir - Create the private directory and set cache_dir
+ */
+static int setup_tmpdir(void) {
+  (void)snprintf(tmpdir, sizeof(tmpdir), "/tmp/test_config_cache.XXXXXX");
+  if (mkdtemp(tmpdir) == NULL) {
+    return -1;
+  }
+  (void)snprintf(cache_dir, sizeof(cache_dir), "%s/cache", tmpdir);
+  return 0;
+}
+
+/**
+ * cache_file - Path of the snapshot inside cache_dir
+ */
+static const char *cache_file(void) {
+  static char path[PATH_MAX];
+  (void)snprintf(path, sizeof(path), "%s/config.cache", cache_dir);
+  return path;
+}
+
+/**
+ * cleanup_tmpdir - Remove the snapshot and both directories
+ */
+static void cleanup_tmpdir(void) {
+  (void)unlink(cache_file());
+  (void)rmdir(cache_dir);
+  (void)rmdir(tmpdir);
+}
+
+/**
+ * make_config - A configuration that differs from the defaults everywhere
+ */
+static config_t make_config(void) {
+  config_t config = {0};
+  config_factory(&config);
+  config.uid_min = 2000;
+  config.uid_max = 3000;
+  config.subuid.min_val = 200000;
+  config.subuid.max_val = 300000000;
+  config.subuid.count_val = 1000;
+  config.subgid.min_val = 400000;
+  config.subgid.max_val = 500000000;
+  config.subgid.count_val = 2000;
+  config.skip_if_exists = false;
+  config.allow_subid_wrap = true;
+  config.skip_if_exact = true;
+  config.subid_backend = SUBID_BACKEND_FILES;
+  config.subid_writer = SUBID_WRITER_FILES;
+  config.resolve_timeout_ms = 1500;
+  config.subuid.bands[0] = (subid_band_t){2500, 2599, 50000};
+  config.subuid.band_count = 1;
+  subid_segments_build(&config.subuid, config.uid_min);
+  return config;
+}
+
+/**
+ * root_ops - Default ops with every snapshot reported as owned by root
+ */
+static struct syscall_ops root_ops(void) {
+  struct syscall_ops ops = syscall_ops_default;
+  ops.fstat = mock_fstat_root_file;
+  return ops;
+}
+
+/* ============================================================================
+ * Tests
+ * ============================================================================
+ */
+
+TEST(config_cache_null_params) {
+  config_t config = make_config();
+
+  TEST_ASSERT_EQ(config_cache_store(NULL, "/run", TEST_FINGERPRINT, &config,
+                                    true),
+                 -1, "Should reject NULL ops");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(config_cache_load(NULL, "/run", TEST_FINGERPRINT, &config,
+                                   true),
+                 0, "NULL ops should be a miss");
+  TEST_ASSERT_EQ(config_cache_load(&syscall_ops_default, "/run",
+                                   TEST_FINGERPRINT, NULL, true),
+                 0, "NULL config should be a miss");
+}
+
+TEST(config_cache_round_trip) {
+  struct syscall_ops ops = root_ops();
+  config_t stored = make_config();
+  config_t loaded = {0};
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  TEST_ASSERT_EQ(config_cache_store(&ops, cache_dir, TEST_FINGERPRINT,
+                                    &stored, true),
+                 0, "Should write the snapshot");
+  TEST_ASSERT_EQ(config_cache_load(&ops, cache_dir, TEST_FINGERPRINT, &loaded,
+                                   true),
+                 1, "Current snapshot should be a hit");
+
+  TEST_ASSERT_EQ(loaded.uid_min, 2000, "Should restore UID_MIN");
+  TEST_ASSERT_EQ(loaded.uid_max, 3000, "Should restore UID_MAX");
+  TEST_ASSERT_EQ(loaded.subuid.min_val, 200000, "Should restore SUB_UID_MIN");
+  TEST_ASSERT_EQ(loaded.subuid.count_val, 1000,
+                 "Should restore SUB_UID_COUNT");
+  TEST_ASSERT_EQ(loaded.subgid.max_val, 500000000,
+                 "Should restore SUB_GID_MAX");
+  TEST_ASSERT_EQ(loaded.subgid.count_val, 2000,
+                 "Should restore SUB_GID_COUNT");
+  TEST_ASSERT_EQ(loaded.skip_if_exists, false, "Should restore booleans");
+  TEST_ASSERT_EQ(loaded.allow_subid_wrap, true, "Should restore booleans");
+  TEST_ASSERT_EQ(loaded.skip_if_exact, true, "Should restore booleans");
+  TEST_ASSERT_EQ(loaded.subid_backend, SUBID_BACKEND_FILES,
+                 "Should restore SUBID_BACKEND");
+  TEST_ASSERT_EQ(loaded.subid_writer, SUBID_WRITER_FILES,
+                 "Should restore SUBID_WRITER");
+  TEST_ASSERT_EQ(loaded.resolve_timeout_ms, 1500,
+                 "Should restore RESOLVE_TIMEOUT_MS");
+  TEST_ASSERT_EQ(loaded.subuid.band_count, 1, "Should restore SUB_UID_BANDS");
+  TEST_ASSERT_EQ(loaded.subuid.bands[0].count, 50000,
+                 "Should restore the band count");
+  TEST_ASSERT_EQ(loaded.subuid.segment_count, 3,
+                 "Should rebuild the segment table");
+  TEST_ASSERT_EQ(loaded.subuid.segments[2].offset,
+                 (500ULL * 1000) + (100ULL * 50000),
+                 "Should rebuild the offsets");
+  TEST_ASSERT_EQ(loaded.subgid.band_count, 0, "Should restore no bands");
+  TEST_ASSERT_STR_EQ(loaded.subuid.key_count, "SUB_UID_COUNT",
+                     "Key names should come from the factory");
+
+  cleanup_tmpdir();
+}
+
+TEST(config_cache_misses) {
+  struct syscall_ops ops = root_ops();
+  config_t stored = make_config();
+  config_t loaded = {0};
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  TEST_ASSERT_EQ(config_cache_load(&ops, cache_dir, TEST_FINGERPRINT, &loaded,
+                                   true),
+                 0, "Missing snapshot should be a miss");
+
+  TEST_ASSERT_EQ(config_cache_store(&ops, cache_dir, TEST_FINGERPRINT,
+                                    &stored, true),
+                 0, "Should write the snapshot");
+  TEST_ASSERT_EQ(config_cache_load(&ops, cache_dir, TEST_FINGERPRINT + 1,
+                                   &loaded, true),
+                 0, "Changed sources should be a miss");
+  TEST_ASSERT_EQ(loaded.uid_min, 0, "A miss should leave config untouched");
+
+  ops.fstat = mock_fstat_non_root_file;
+  TEST_ASSERT_EQ(config_cache_load(&ops, cache_dir, TEST_FINGERPRINT, &loaded,
+                                   true),
+                 0, "Snapshot not owned by root should be ignored");
+  ops.fstat = mock_fstat_root_file_world_write;
+  TEST_ASSERT_EQ(config_cache_load(&ops, cache_dir, TEST_FINGERPRINT, &loaded,
+                                   true),
+                 0, "World-writable snapshot should be ignored");
+
+  /* Bands load_configuration() would not have accepted */
+  ops = root_ops();
+  stored.subuid.bands[0].uid_hi = stored.uid_max + 1;
+  TEST_ASSERT_EQ(config_cache_store(&ops, cache_dir, TEST_FINGERPRINT,
+                                    &stored, true),
+                 0, "Should write the snapshot");
+  TEST_ASSERT_EQ(config_cache_load(&ops, cache_dir, TEST_FINGERPRINT, &loaded,
+                                   true),
+                 0, "Rejected bands should be a miss");
+  TEST_ASSERT_EQ(loaded.uid_min, 0, "A miss should leave config untouched");
+
+  cleanup_tmpdir();
+}
+
+TEST(config_cache_corrupt) {
+  struct syscall_ops ops = root_ops();
+  config_t stored = make_config();
+  config_t loaded = {0};
+  unsigned char byte = 0;
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  TEST_ASSERT_EQ(config_cache_store(&ops, cache_dir, TEST_FINGERPRINT,
+                                    &stored, true),
+                 0, "Should write the snapshot");
+
+  int fd = open(cache_file(), O_RDWR);
+  TEST_ASSERT_NOT_EQ(fd, -1, "Should open the snapshot");
+  TEST_ASSERT_EQ(pread(fd, &byte, 1, 16), 1, "Should read a value byte");
+  byte ^= 0xff;
+  TEST_ASSERT_EQ(pwrite(fd, &byte, 1, 16), 1, "Should flip a value byte");
+  TEST_ASSERT_EQ(close(fd), 0, "Should close the snapshot");
+
+  TEST_ASSERT_EQ(config_cache_load(&ops, cache_dir, TEST_FINGERPRINT, &loaded,
+                                   true),
+                 0, "Corrupt snapshot should fail its checksum");
+
+  TEST_ASSERT_EQ(truncate(cache_file(), 8), 0, "Should truncate the snapshot");
+  TEST_ASSERT_EQ(config_cache_load(&ops, cache_dir, TEST_FINGERPRINT, &loaded,
+                                   true),
+                 0, "Short snapshot should be a miss");
+
+  cleanup_tmpdir();
+}
+
+TEST(config_cache_store_own_temp_file) {
+  struct syscall_ops ops = root_ops();
+  config_t stored = make_config();
+  config_t loaded = {0};
+  char mine[PATH_MAX] = {0};
+  char theirs[PATH_MAX] = {0};
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  TEST_ASSERT_EQ(mkdir(cache_dir, 0755), 0, "Should create the cache dir");
+  (void)snprintf(mine, sizeof(mine), "%s.%ld.tmp", cache_file(),
+                 (long)getpid());
+  (void)snprintf(theirs, sizeof(theirs), "%s.%ld.tmp", cache_file(),
+                 (long)getpid() + 1);
+
+  /* Another writer half way through, and a leftover under our PID */
+  FILE *fp = fopen(theirs, "w");
+  TEST_ASSERT_NOT_EQ(fp, NULL, "Should create the other writer's file");
+  (void)fputs("partial", fp);
+  (void)fclose(fp);
+  fp = fopen(mine, "w");
+  TEST_ASSERT_NOT_EQ(fp, NULL, "Should create the leftover");
+  (void)fclose(fp);
+
+  TEST_ASSERT_EQ(config_cache_store(&ops, cache_dir, TEST_FINGERPRINT,
+                                    &stored, true),
+                 0, "Should store the snapshot");
+  TEST_ASSERT_EQ(config_cache_load(&ops, cache_dir, TEST_FINGERPRINT,
+                                   &loaded, true),
+                 1, "Snapshot should be a hit");
+  struct stat st = {0};
+  TEST_ASSERT_EQ(stat(theirs, &st), 0, "Other writer's file should stay");
+  TEST_ASSERT_EQ(st.st_size, 7, "Should leave the other writer's file alone");
+  TEST_ASSERT_EQ(access(mine, F_OK), -1, "Should replace the leftover");
+
+  (void)unlink(theirs);
+  cleanup_tmpdir();
+}
+
+TEST(config_cache_store_mkdir_fails) {
+  struct syscall_ops ops = root_ops();
+  config_t stored = make_config();
+
+  ops.mkdir = mock_mkdir_eacces;
+  TEST_ASSERT_EQ(config_cache_store(&ops, "/nonexistent/cache",
+                                    TEST_FINGERPRINT, &stored, true),
+                 -1, "Should fail without a cache directory");
+  TEST_ASSERT_EQ(errno, EACCES, "Should keep the mkdir error");
+}
+
+int main(int argc, char **argv) {
+  TEST_INIT(10, false, false); /* timeout, verbose, duration */
+
+  RUN_TEST(config_cache_null_params);
+  RUN_TEST(config_cache_round_trip);
+  RUN_TEST(config_cache_misses);
+  RUN_TEST(config_cache_corrupt);
+  RUN_TEST(config_cache_store_own_temp_file);
+  RUN_TEST(config_cache_store_mkdir_fails);
+
+  return TEST_EXECUTE();
+}
@@ -0,0 +1,231 @@
+/**
+ * test_config_watch.c - Tests for the configuration source watches
+ *
+ * A private temporary directory stands in for /etc: it holds login.defs,
+ * a config directory with the main file, and the drop-in directory below
+ * that. Real inotify events are generated by editing those files.
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "test_framework.h"
+#include "test_helpers/all.h"
+
+/* ============================================================================
+ * Constants
+ * ============================================================================
+ */
+
+/* Size of the mkdtemp(3) path buffer and of each level of paths below it */
+enum {
+  TMPDIR_SIZE = 64,
+  PATH_SIZE = TMPDIR_SIZE + 32,
+  SUBPATH_SIZE = PATH_SIZE + 32,
+  DROPIN_SIZE = SUBPATH_SIZE + 32
+};
+
+/* ============================================================================
+ * Global State
+ * ============================================================================
+ */
+
+static char tmpdir[TMPDIR_SIZE] = {0};
+static char login_defs[PATH_SIZE] = {0};
+static char config_dir[PATH_SIZE] = {0};
+static char config_file[SUBPATH_SIZE] = {0};
+static char dropin_dir[SUBPATH_SIZE] = {0};
+static char dropin_file[DROPIN_SIZE] = {0};
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================
+ */
+
+/**
+ * write_file - Replace @path with @content
+ */
+static int write_file(const char *path, const char *content) {
+  FILE *fp = fopen(path, "w");
+  if (fp == NULL) {
+    return -1;
+  }
+  (void)fputs(content, fp);
+  return fclose(fp);
+}
+
+/**
+ * setup_tree - Create the stand-in /etc with every source present
+ */
+static int setup_tree(void) {
+  (void)snprintf(tmpdir, sizeof(tmpdir), "/tmp/test_config_watch.XXXXXX");
+  if (mkdtemp(tmpdir) == NULL) {
+    return -1;
+  }
+  (void)snprintf(login_defs, sizeof(login_defs), "%s/login.defs", tmpdir);
+  (void)snprintf(config_dir, sizeof(config_dir), "%s/static-subid", tmpdir);
+  (void)snprintf(config_file, sizeof(config_file), "%s/static-subid.conf",
+                 config_dir);
+  (void)snprintf(dropin_dir, sizeof(dropin_dir), "%s/static-subid.conf.d",
+                 config_dir);
+  (void)snprintf(dropin_file, sizeof(dropin_file), "%s/10-site.conf",
+                 dropin_dir);
+
+  if (write_file(login_defs, "UID_MIN 1000\n") != 0 ||
+      mkdir(config_dir, 0755) != 0 ||
+      write_file(config_file, "SUB_UID_COUNT 65536\n") != 0 ||
+      mkdir(dropin_dir, 0755) != 0) {
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * cleanup_tree - Remove everything setup_tree() may have created
+ */
+static void cleanup_tree(void) {
+  (void)unlink(dropin_file);
+  (void)rmdir(dropin_dir);
+  (void)unlink(config_file);
+  (void)rmdir(config_dir);
+  (void)unlink(login_defs);
+  (void)snprintf(dropin_file, sizeof(dropin_file), "%s/unrelated", tmpdir);
+  (void)unlink(dropin_file);
+  (void)rmdir(tmpdir);
+}
+
+/* ============================================================================
+ * Tests
+ * ============================================================================
+ */
+
+TEST(config_watch_null_params) {
+  config_watch_t watch = {0};
+
+  TEST_ASSERT_EQ(config_watch_open(NULL, "/a/b", "/a/c", "/a/d", true), -1,
+                 "Should reject NULL watch");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(config_watch_open(&watch, NULL, "/a/c", "/a/d", true), -1,
+                 "Should reject NULL paths");
+  TEST_ASSERT_EQ(config_watch_fd(&watch), -1, "Should leave the set closed");
+  TEST_ASSERT_EQ(config_watch_changed(&watch, true), -1,
+                 "Should refuse to read a closed set");
+  TEST_ASSERT_EQ(config_watch_fd(NULL), -1, "Should handle NULL watch");
+  config_watch_close(&watch);
+  config_watch_close(NULL);
+}
+
+TEST(config_watch_missing_directory) {
+  config_watch_t watch = {0};
+
+  TEST_ASSERT_EQ(config_watch_open(&watch, "/nonexistent/login.defs",
+                                   "/nonexistent/a.conf", "/nonexistent/d",
+                                   true),
+                 -1, "Should fail when a source directory is missing");
+  TEST_ASSERT_EQ(config_watch_fd(&watch), -1, "Should close the set");
+}
+
+TEST(config_watch_detects_edits) {
+  config_watch_t watch = {0};
+
+  TEST_ASSERT_EQ(setup_tree(), 0, "Should create the test tree");
+  TEST_ASSERT_EQ(config_watch_open(&watch, login_defs, config_file,
+                                   dropin_dir, true),
+                 0, "Should watch every source");
+  TEST_ASSERT_NOT_EQ(config_watch_fd(&watch), -1, "Should have a descriptor");
+  TEST_ASSERT_EQ(config_watch_changed(&watch, true), 0,
+                 "Nothing should have changed yet");
+
+  TEST_ASSERT_EQ(write_file(config_file, "SUB_UID_COUNT 1000\n"), 0,
+                 "Should edit the main config");
+  TEST_ASSERT_EQ(config_watch_changed(&watch, true), 1,
+                 "Should see the main config change");
+  TEST_ASSERT_EQ(config_watch_changed(&watch, true), 0,
+                 "Events should be drained");
+
+  TEST_ASSERT_EQ(write_file(login_defs, "UID_MIN 2000\n"), 0,
+                 "Should edit login.defs");
+  TEST_ASSERT_EQ(config_watch_changed(&watch, true), 1,
+                 "Should see login.defs change");
+
+  TEST_ASSERT_EQ(write_file(dropin_file, "UID_MAX 5000\n"), 0,
+                 "Should add a drop-in");
+  TEST_ASSERT_EQ(config_watch_changed(&watch, true), 1,
+                 "Should see a new drop-in");
+
+  TEST_ASSERT_EQ(chmod(config_file, 0666), 0, "Should chmod the config");
+  TEST_ASSERT_EQ(config_watch_changed(&watch, true), 1,
+                 "Should see a permission change");
+
+  config_watch_close(&watch);
+  cleanup_tree();
+}
+
+TEST(config_watch_ignores_unrelated_files) {
+  config_watch_t watch = {0};
+  char unrelated[PATH_SIZE] = {0};
+
+  TEST_ASSERT_EQ(setup_tree(), 0, "Should create the test tree");
+  TEST_ASSERT_EQ(config_watch_open(&watch, login_defs, config_file,
+                                   dropin_dir, true),
+                 0, "Should watch every source");
+
+  (void)snprintf(unrelated, sizeof(unrelated), "%s/unrelated", tmpdir);
+  TEST_ASSERT_EQ(write_file(unrelated, "x\n"), 0,
+                 "Should write a file next to login.defs");
+  TEST_ASSERT_EQ(config_watch_changed(&watch, true), 0,
+                 "Should ignore other files in the same directory");
+
+  config_watch_close(&watch);
+  cleanup_tree();
+}
+
+TEST(config_watch_dropin_dir_recreated) {
+  config_watch_t watch = {0};
+
+  TEST_ASSERT_EQ(setup_tree(), 0, "Should create the test tree");
+  TEST_ASSERT_EQ(rmdir(dropin_dir), 0, "Should start without drop-ins");
+  TEST_ASSERT_EQ(config_watch_open(&watch, login_defs, config_file,
+                                   dropin_dir, true),
+                 0, "A missing drop-in directory should be fine");
+
+  TEST_ASSERT_EQ(mkdir(dropin_dir, 0755), 0, "Should create the drop-ins");
+  TEST_ASSERT_EQ(config_watch_changed(&watch, true), 1,
+                 "Should see the directory appear");
+
+  TEST_ASSERT_EQ(write_file(dropin_file, "UID_MAX 5000\n"), 0,
+                 "Should add a drop-in");
+  TEST_ASSERT_EQ(config_watch_changed(&watch, true), 1,
+                 "Should watch the new directory");
+
+  TEST_ASSERT_EQ(unlink(dropin_file), 0, "Should remove the drop-in");
+  TEST_ASSERT_EQ(rmdir(dropin_dir), 0, "Should remove the directory");
+  TEST_ASSERT_EQ(config_watch_changed(&watch, true), 1,
+                 "Should see the directory go away");
+
+  config_watch_close(&watch);
+  cleanup_tree();
+}
+
+int main(int argc, char **argv) {
+  TEST_INIT(10, false, false); /* timeout, verbose, duration */
+
+  RUN_TEST(config_watch_null_params);
+  RUN_TEST(config_watch_missing_directory);
+  RUN_TEST(config_watch_detects_edits);
+  RUN_TEST(config_watch_ignores_unrelated_files);
+  RUN_TEST(config_watch_dropin_dir_recreated);
+
+  return TEST_EXECUTE();
+}
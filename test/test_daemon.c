@@ -0,0 +1,599 @@
+/**
+ * test_daemon.c - Tests for the unix socket daemon
+ *
+ * Clients are simulated over socketpair(2). Peer credentials are mocked
+ * through getsockopt() so eligible and ineligible callers can be tested
+ * whatever UID runs the suite; spawning is mocked as in test_enroll.c.
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "test_framework.h"
+#include "test_helpers/all.h"
+
+/* ============================================================================
+ * Constants
+ * ============================================================================
+ */
+
+/* Size of the mkdtemp(3) path buffer and of the socket path under it */
+enum { TMPDIR_SIZE = 64, SOCKET_PATH_SIZE = TMPDIR_SIZE + 16 };
+
+/* PID handed back by the posix_spawn mock, and the waitpid status shift */
+enum { DEFAULT_MOCK_PID = 4242, EXIT_CODE_SHIFT = 8 };
+
+/* Scratch username buffer and reply buffer sizes */
+enum { USERNAME_SIZE = 256, REPLY_SIZE = 256 };
+
+/* ============================================================================
+ * Global State
+ * ============================================================================
+ */
+
+/* Private directory holding the socket */
+static char tmpdir[TMPDIR_SIZE] = {0};
+
+/* Socket path inside tmpdir */
+static char socket_path[SOCKET_PATH_SIZE] = {0};
+
+/* Exit code reported by mock_waitpid */
+static int mock_child_exit_code = 1;
+
+/* usermod(8) runs seen by mock_posix_spawn, which mock_waitpid lets pass */
+static int mock_usermod_calls = 0;
+static bool mock_last_usermod = false;
+
+/* ============================================================================
+ * Mock Functions
+ * ============================================================================
+ */
+
+/**
+ * mock_getsockopt_testuser - Report the peer as TEST_UID_STANDARD
+ */
+static int mock_getsockopt_testuser(int sockfd, int level, int optname,
+                                    void *restrict optval,
+                                    socklen_t *restrict optlen) {
+  (void)sockfd;
+  (void)level;
+  (void)optname;
+  struct ucred cred = {
+      .pid = getpid(), .uid = TEST_UID_STANDARD, .gid = TEST_GID_STANDARD};
+  memcpy(optval, &cred, sizeof(cred));
+  *optlen = sizeof(cred);
+  return 0;
+}
+
+/**
+ * mock_getsockopt_eperm - Fail to read the peer credentials
+ */
+static int mock_getsockopt_eperm(int sockfd, int level, int optname,
+                                 void *restrict optval,
+                                 socklen_t *restrict optlen) {
+  (void)sockfd;
+  (void)level;
+  (void)optname;
+  (void)optval;
+  (void)optlen;
+  errno = EPERM;
+  return -1;
+}
+
+/**
+ * mock_posix_spawn - Hand back a fixed PID without running anything
+ */
+static int mock_posix_spawn(pid_t *restrict pid, const char *restrict path,
+                            const posix_spawn_file_actions_t *file_actions,
+                            const posix_spawnattr_t *restrict attrp,
+                            char *const argv[restrict],
+                            char *const envp[restrict]) {
+  mock_last_usermod = strcmp(path, USERMOD_PATH) == 0;
+  if (mock_last_usermod) {
+    mock_usermod_calls++;
+  }
+  (void)file_actions;
+  (void)attrp;
+  (void)argv;
+  (void)envp;
+  *pid = DEFAULT_MOCK_PID;
+  return 0;
+}
+
+/**
+ * mock_waitpid - Report mock_child_exit_code as a normal exit, 0 for usermod
+ */
+static pid_t mock_waitpid(pid_t pid, int *wstatus, int options) {
+  (void)options;
+  *wstatus = (mock_last_usermod ? 0 : mock_child_exit_code) << EXIT_CODE_SHIFT;
+  return pid;
+}
+
+/**
+ * mock_stat_fixed - Report every path as the same unchanging root file
+ *
+ * Keeps a stamp current whatever the databases really hold, like an NSS
+ * provider or an edit that kept the file's timestamps.
+ */
+static int mock_stat_fixed(const char *pathname, struct stat *statbuf) {
+  (void)pathname;
+  *statbuf = (struct stat){0};
+  statbuf->st_mode = S_IFREG | 0644;
+  return 0;
+}
+
+/**
+ * mock_open_stamp_dir - Look for STAMP_DIR entries in tmpdir instead
+ */
+static int mock_open_stamp_dir(const char *pathname, int flags, ...) {
+  char path[PATH_MAX] = {0};
+  size_t len = strlen(STAMP_DIR);
+  if (strncmp(pathname, STAMP_DIR "/", len + 1) == 0) {
+    (void)snprintf(path, sizeof(path), "%s%s", tmpdir, pathname + len);
+    pathname = path;
+  }
+  return open(pathname, flags);
+}
+
+/**
+ * mock_mkdir_eacces - Keep stamp_write() out of the real STAMP_DIR
+ */
+static int mock_mkdir_eacces(const char *pathname, mode_t mode) {
+  (void)pathname;
+  (void)mode;
+  errno = EACCES;
+  return -1;
+}
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================
+ */
+
+/**
+ * make_client_ops - Peer is testuser, getsubids reports no ranges
+ */
+static struct syscall_ops make_client_ops(void) {
+  struct syscall_ops ops = syscall_ops_default;
+  ops.getsockopt = mock_getsockopt_testuser;
+  ops.getpwuid_r = mock_getpwuid_r_testuser;
+  ops.posix_spawn = mock_posix_spawn;
+  ops.waitpid = mock_waitpid;
+  mock_child_exit_code = 1;
+  mock_usermod_calls = 0;
+  mock_last_usermod = false;
+  return ops;
+}
+
+/**
+ * make_opts - Both modes in noop mode, so nothing is ever written
+ */
+static options_t make_opts(void) {
+  options_t opts = {0};
+  opts.do_subuid = true;
+  opts.do_subgid = true;
+  opts.noop = true;
+  opts.debug = true;
+  return opts;
+}
+
+/**
+ * serve_request_with - serve_request() with explicit options and fingerprint
+ * @ops: Operations for the daemon side
+ * @config: Configuration in use
+ * @opts: Runtime options for the daemon side
+ * @fingerprint: Fingerprint handed to daemon_handle_client(), or NULL
+ * @request: Bytes the client sends, or NULL to hang up without sending
+ * @reply: Receives the reply, empty if none was sent
+ *
+ * Return: daemon_handle_client() result
+ */
+static int serve_request_with(const struct syscall_ops *ops,
+                              const config_t *config, const options_t *opts,
+                              const uint64_t *fingerprint, const char *request,
+                              char reply[REPLY_SIZE]) {
+  int sv[2] = {-1, -1};
+  char username[USERNAME_SIZE] = {0};
+
+  memset(reply, 0, REPLY_SIZE);
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+    return -2;
+  }
+  if (request != NULL) {
+    (void)write(sv[0], request, strlen(request));
+  }
+  (void)shutdown(sv[0], SHUT_WR);
+
+  int ret = daemon_handle_client(ops, sv[1], config, opts, fingerprint,
+                                 username, sizeof(username));
+  (void)close(sv[1]);
+  (void)read(sv[0], reply, REPLY_SIZE - 1);
+  (void)close(sv[0]);
+  return ret;
+}
+
+/**
+ * serve_request - Send @request from one end of a socketpair, serve the other
+ * @ops: Operations for the daemon side
+ * @config: Configuration in use
+ * @request: Bytes the client sends, or NULL to hang up without sending
+ * @reply: Receives the reply, empty if none was sent
+ *
+ * Return: daemon_handle_client() result
+ */
+static int serve_request(const struct syscall_ops *ops, const config_t *config,
+                         const char *request, char reply[REPLY_SIZE]) {
+  options_t opts = make_opts();
+  return serve_request_with(ops, config, &opts, NULL, request, reply);
+}
+
+/**
+ * setup_tmpdir - Create the private directory and set socket_path
+ */
+static int setup_tmpdir(void) {
+  (void)snprintf(tmpdir, sizeof(tmpdir), "/tmp/test_daemon.XXXXXX");
+  if (mkdtemp(tmpdir) == NULL) {
+    return -1;
+  }
+  (void)snprintf(socket_path, sizeof(socket_path), "%s/daemon.sock", tmpdir);
+  return 0;
+}
+
+/**
+ * cleanup_tmpdir - Remove the socket and the directory
+ */
+static void cleanup_tmpdir(void) {
+  (void)unlink(socket_path);
+  (void)rmdir(tmpdir);
+}
+
+/* ============================================================================
+ * Tests
+ * ============================================================================
+ */
+
+TEST(daemon_null_params) {
+  config_t config = {0};
+  options_t opts = make_opts();
+  char username[USERNAME_SIZE] = {0};
+  bool activated = false;
+
+  config_factory(&config);
+
+  TEST_ASSERT_EQ(daemon_listen(NULL, &activated, true), -1,
+                 "Should reject NULL path");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(daemon_handle_client(NULL, 0, &config, &opts, NULL,
+                                      username, sizeof(username)),
+                 -1, "Should reject NULL ops");
+  TEST_ASSERT_EQ(daemon_serve(&syscall_ops_default, 0, NULL, &opts, NULL, 0),
+                 -1, "Should reject NULL config");
+  TEST_ASSERT_EQ(daemon_request(NULL, 1, true), -1, "Should reject NULL path");
+}
+
+TEST(daemon_handle_client_ok) {
+  struct syscall_ops ops = make_client_ops();
+  config_t config = {0};
+  char reply[REPLY_SIZE];
+
+  config_factory(&config);
+
+  TEST_ASSERT_EQ(serve_request(&ops, &config, "ensure\n", reply), 0,
+                 "Should enroll the peer");
+  TEST_ASSERT_STR_EQ(reply, "ok\n", "Should reply ok");
+}
+
+TEST(daemon_handle_client_ineligible) {
+  struct syscall_ops ops = make_client_ops();
+  config_t config = {0};
+  char reply[REPLY_SIZE];
+
+  config_factory(&config);
+  config.uid_min = TEST_UID_STANDARD + 1;
+
+  TEST_ASSERT_EQ(serve_request(&ops, &config, "ensure\n", reply), -1,
+                 "Should refuse a UID below UID_MIN");
+  TEST_ASSERT_EQ(strncmp(reply, "error ", 6), 0, "Should reply with an error");
+}
+
+TEST(daemon_handle_client_bad_requests) {
+  struct syscall_ops ops = make_client_ops();
+  config_t config = {0};
+  char reply[REPLY_SIZE];
+
+  config_factory(&config);
+
+  TEST_ASSERT_EQ(serve_request(&ops, &config, "gimme\n", reply), -1,
+                 "Should refuse an unknown request");
+  TEST_ASSERT_EQ(errno, EBADMSG, "Should set the correct error code");
+  TEST_ASSERT_EQ(strncmp(reply, "error ", 6), 0, "Should reply with an error");
+
+  TEST_ASSERT_EQ(serve_request(&ops, &config, "ensure", reply), -1,
+                 "Should refuse a request without a newline");
+  TEST_ASSERT_STR_EQ(reply, "", "Should not reply to a truncated request");
+
+  TEST_ASSERT_EQ(serve_request(&ops, &config, NULL, reply), -1,
+                 "Should handle a client hanging up");
+  TEST_ASSERT_STR_EQ(reply, "", "Should not reply to an empty request");
+}
+
+TEST(daemon_handle_client_peercred_fails) {
+  struct syscall_ops ops = make_client_ops();
+  config_t config = {0};
+  char reply[REPLY_SIZE];
+
+  config_factory(&config);
+  ops.getsockopt = mock_getsockopt_eperm;
+
+  TEST_ASSERT_EQ(serve_request(&ops, &config, "ensure\n", reply), -1,
+                 "Should refuse an unidentified peer");
+  TEST_ASSERT_EQ(errno, EPERM, "Should keep the getsockopt error");
+  TEST_ASSERT_EQ(strncmp(reply, "error ", 6), 0, "Should reply with an error");
+}
+
+TEST(daemon_handle_client_unknown_uid) {
+  struct syscall_ops ops = make_client_ops();
+  config_t config = {0};
+  char reply[REPLY_SIZE];
+
+  config_factory(&config);
+  ops.getpwuid_r = mock_getpwuid_r_null;
+
+  TEST_ASSERT_EQ(serve_request(&ops, &config, "ensure\n", reply), -1,
+                 "Should refuse a UID without an account");
+  TEST_ASSERT_EQ(strncmp(reply, "error ", 6), 0, "Should reply with an error");
+}
+
+TEST(daemon_handle_client_stale_stamp) {
+  struct syscall_ops ops = make_client_ops();
+  struct syscall_ops stamp_ops = syscall_ops_default;
+  config_t config = {0};
+  options_t opts = make_opts();
+  uint64_t fingerprint = UINT64_C(0x0123456789abcdef);
+  char reply[REPLY_SIZE];
+  char stamp[PATH_MAX] = {0};
+
+  /* A current stamp for the peer, but no range in the databases */
+  config_factory(&config);
+  opts.noop = false;
+  opts.stamp_cache = true;
+  stamp_ops.stat = mock_stat_fixed;
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  TEST_ASSERT_EQ(stamp_write(&stamp_ops, tmpdir, TEST_UID_STANDARD,
+                             "testuser", &config, &opts,
+                             fingerprint),
+                 0, "Should write the stamp");
+  ops.stat = mock_stat_fixed;
+  ops.open = mock_open_stamp_dir;
+  ops.mkdir = mock_mkdir_eacces;
+
+  TEST_ASSERT_EQ(serve_request_with(&ops, &config, &opts, &fingerprint,
+                                    "ensure\n", reply),
+                 0, "Should enroll the peer");
+  TEST_ASSERT_STR_EQ(reply, "ok\n", "Should reply ok");
+  TEST_ASSERT_EQ(mock_usermod_calls, 1,
+                 "Stamp should not stand in for the missing ranges");
+
+  (void)snprintf(stamp, sizeof(stamp), "%s/%u", tmpdir, TEST_UID_STANDARD);
+  (void)unlink(stamp);
+  cleanup_tmpdir();
+}
+
+TEST(daemon_listen_activated) {
+  bool activated = false;
+  int sv[2] = {-1, -1};
+  char pid[32] = {0};
+
+  TEST_ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0,
+                 "Should create a socket");
+  TEST_ASSERT_EQ(dup2(sv[0], 3), 3, "Should place the socket on fd 3");
+  (void)snprintf(pid, sizeof(pid), "%d", (int)getpid());
+  TEST_ASSERT_EQ(setenv("LISTEN_PID", pid, 1), 0, "Should set LISTEN_PID");
+  TEST_ASSERT_EQ(setenv("LISTEN_FDS", "1", 1), 0, "Should set LISTEN_FDS");
+
+  TEST_ASSERT_EQ(daemon_listen("/nonexistent/daemon.sock", &activated, true),
+                 3, "Should use the socket passed by systemd");
+  TEST_ASSERT_EQ(activated, true, "Should report socket activation");
+  TEST_ASSERT_EQ(getenv("LISTEN_FDS"), NULL,
+                 "Should not pass LISTEN_FDS on to helpers");
+}
+
+TEST(daemon_listen_not_activated) {
+  bool activated = true;
+
+  TEST_ASSERT_EQ(setenv("LISTEN_PID", "1", 1), 0, "Should set LISTEN_PID");
+  TEST_ASSERT_EQ(setenv("LISTEN_FDS", "1", 1), 0, "Should set LISTEN_FDS");
+
+  TEST_ASSERT_EQ(daemon_listen("/nonexistent/daemon.sock", &activated, true),
+                 -1, "Should ignore sockets meant for another process");
+  TEST_ASSERT_EQ(activated, false, "Should not report socket activation");
+  TEST_ASSERT_EQ(daemon_request("/nonexistent/daemon.sock", 1, true), -1,
+                 "Should fail without a daemon");
+}
+
+TEST(daemon_request_round_trip) {
+  bool activated = true;
+  int status = 0;
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  int fd = daemon_listen(socket_path, &activated, true);
+  TEST_ASSERT_NOT_EQ(fd, -1, "Should listen on the socket");
+  TEST_ASSERT_EQ(activated, false, "Should bind the socket itself");
+
+  pid_t pid = fork();
+  TEST_ASSERT_NOT_EQ(pid, -1, "Should fork the daemon");
+  if (pid == 0) {
+    struct syscall_ops ops = make_client_ops();
+    config_t config = {0};
+    options_t opts = make_opts();
+    uint64_t fingerprint = 0;
+
+    /* Current fingerprint, so the test configuration is never reloaded */
+    config_factory(&config);
+    const uint64_t *fp =
+        stamp_fingerprint(&ops, &fingerprint, false) == 0 ? &fingerprint
+                                                          : NULL;
+    _exit(daemon_serve(&ops, fd, &config, &opts, fp, 1000) == 0 ? 0 : 1);
+  }
+
+  TEST_ASSERT_EQ(daemon_request(socket_path, WAIT_TIMEOUT_DEFAULT_SEC, true),
+                 0, "Daemon should confirm the ranges");
+  TEST_ASSERT_EQ(waitpid(pid, &status, 0), pid, "Should reap the daemon");
+  TEST_ASSERT_EQ(WIFEXITED(status) && WEXITSTATUS(status) == 0, true,
+                 "Daemon should exit cleanly when idle");
+
+  (void)close(fd);
+  cleanup_tmpdir();
+}
+
+TEST(daemon_request_stale_stamp) {
+  bool activated = true;
+  int status = 0;
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  int fd = daemon_listen(socket_path, &activated, true);
+  TEST_ASSERT_NOT_EQ(fd, -1, "Should listen on the socket");
+
+  pid_t pid = fork();
+  TEST_ASSERT_NOT_EQ(pid, -1, "Should fork the daemon");
+  if (pid == 0) {
+    struct syscall_ops ops = make_client_ops();
+    struct syscall_ops stamp_ops = syscall_ops_default;
+    config_t config = {0};
+    options_t opts = make_opts();
+    uint64_t fingerprint = 0;
+
+    /* What --request finds missing, the daemon's stamp still vouches for */
+    config_factory(&config);
+    opts.noop = false;
+    opts.stamp_cache = true;
+    stamp_ops.stat = mock_stat_fixed;
+    ops.stat = mock_stat_fixed;
+    ops.open = mock_open_stamp_dir;
+    ops.mkdir = mock_mkdir_eacces;
+    if (stamp_fingerprint(&ops, &fingerprint, false) != 0 ||
+        stamp_write(&stamp_ops, tmpdir, TEST_UID_STANDARD, "testuser",
+                    &config, &opts, fingerprint) != 0) {
+      _exit(2);
+    }
+    int ret = daemon_serve(&ops, fd, &config, &opts, &fingerprint, 1000);
+    _exit(ret == 0 && mock_usermod_calls == 1 ? 0 : 1);
+  }
+
+  TEST_ASSERT_EQ(daemon_request(socket_path, WAIT_TIMEOUT_DEFAULT_SEC, true),
+                 0, "Daemon should confirm the ranges");
+  TEST_ASSERT_EQ(waitpid(pid, &status, 0), pid, "Should reap the daemon");
+  TEST_ASSERT_EQ(WIFEXITED(status) && WEXITSTATUS(status) == 0, true,
+                 "Daemon should have written the missing ranges");
+
+  char stamp[PATH_MAX] = {0};
+  (void)snprintf(stamp, sizeof(stamp), "%s/%u", tmpdir, TEST_UID_STANDARD);
+  (void)unlink(stamp);
+  (void)close(fd);
+  cleanup_tmpdir();
+}
+
+TEST(daemon_request_timeout) {
+  bool activated = true;
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  int fd = daemon_listen(socket_path, &activated, true);
+  TEST_ASSERT_NOT_EQ(fd, -1, "Should listen on the socket");
+
+  /* Nobody accepts: the request sits in the backlog like a busy daemon's */
+  TEST_ASSERT_EQ(daemon_request(socket_path, 0, true), 0,
+                 "Should return once the request is queued");
+  TEST_ASSERT_EQ(daemon_request(socket_path, 1, true), -1,
+                 "Should give up after the timeout");
+  TEST_ASSERT_EQ(errno, ETIMEDOUT, "Should set the correct error code");
+
+  (void)close(fd);
+  cleanup_tmpdir();
+}
+
+TEST(daemon_slow_client_dropped) {
+  bool activated = true;
+  int status = 0;
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  int fd = daemon_listen(socket_path, &activated, true);
+  TEST_ASSERT_NOT_EQ(fd, -1, "Should listen on the socket");
+
+  pid_t pid = fork();
+  TEST_ASSERT_NOT_EQ(pid, -1, "Should fork the daemon");
+  if (pid == 0) {
+    struct syscall_ops ops = make_client_ops();
+    config_t config = {0};
+    options_t opts = make_opts();
+    uint64_t fingerprint = 0;
+
+    config_factory(&config);
+    const uint64_t *fp =
+        stamp_fingerprint(&ops, &fingerprint, false) == 0 ? &fingerprint
+                                                          : NULL;
+    _exit(daemon_serve(&ops, fd, &config, &opts, fp, 1000) == 0 ? 0 : 1);
+  }
+
+  /* Connects first and never finishes its request */
+  int slow = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  (void)snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socket_path);
+  TEST_ASSERT_EQ(connect(slow, (const struct sockaddr *)&addr, sizeof(addr)),
+                 0, "Slow client should connect");
+  TEST_ASSERT_EQ(write(slow, "ens", 3), 3, "Slow client sends a little");
+
+  uint64_t started = stats_now();
+  TEST_ASSERT_EQ(daemon_request(socket_path, 4, true), 0,
+                 "Second client should still be served");
+  TEST_ASSERT_EQ(stats_now() - started < 3 * 1000000, true,
+                 "Slow client should only hold it up until its deadline");
+
+  char reply[REPLY_SIZE] = {0};
+  TEST_ASSERT_EQ(read(slow, reply, sizeof(reply)), 0,
+                 "Slow client should be dropped without a reply");
+  (void)close(slow);
+
+  TEST_ASSERT_EQ(waitpid(pid, &status, 0), pid, "Should reap the daemon");
+  TEST_ASSERT_EQ(WIFEXITED(status) && WEXITSTATUS(status) == 0, true,
+                 "Daemon should exit cleanly when idle");
+
+  (void)close(fd);
+  cleanup_tmpdir();
+}
+
+int main(int argc, char **argv) {
+  TEST_INIT(10, false, false); /* timeout, verbose, duration */
+
+  RUN_TEST(daemon_null_params);
+  RUN_TEST(daemon_handle_client_ok);
+  RUN_TEST(daemon_handle_client_ineligible);
+  RUN_TEST(daemon_handle_client_bad_requests);
+  RUN_TEST(daemon_handle_client_peercred_fails);
+  RUN_TEST(daemon_handle_client_unknown_uid);
+  RUN_TEST(daemon_handle_client_stale_stamp);
+  RUN_TEST(daemon_listen_activated);
+  RUN_TEST(daemon_listen_not_activated);
+  RUN_TEST(daemon_request_round_trip);
+  RUN_TEST(daemon_request_stale_stamp);
+  RUN_TEST(daemon_request_timeout);
+  RUN_TEST(daemon_slow_client_dropped);
+
+  return TEST_EXECUTE();
+}
@@ -0,0 +1,773 @@
+/**
+ * test_enroll.c - Tests for the per-user enrollment pipeline
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <spawn.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "test_framework.h"
+#include "test_helpers/all.h"
+
+/* ============================================================================
+ * Constants
+ * ============================================================================
+ */
+
+/* Default mock PID assigned to spawned child processes */
+enum { DEFAULT_MOCK_PID = 4242 };
+
+/* WEXITSTATUS macro equivalent - extract exit code from status */
+enum { EXIT_CODE_SHIFT = 8 };
+
+/* UIDs relative to the default configuration */
+enum {
+  ELIGIBLE_UID = 1000,     /* == default UID_MIN */
+  BELOW_MIN_UID = 999,     /* One below default UID_MIN */
+  OVERLAPPING_UID = 100000 /* == default SUB_UID_MIN */
+};
+
+/* ============================================================================
+ * Global State
+ * ============================================================================
+ */
+
+/* Exit code reported by mock_waitpid for the most recent child */
+static int mock_child_exit_code = 0;
+
+/* Number of posix_spawn calls seen; tests assert on helper usage */
+static int spawn_count = 0;
+
+/* Times mock_stat_index_dir() was asked about SUBID_INDEX_DIR */
+static int index_dir_stats = 0;
+
+/* ============================================================================
+ * Mock Functions
+ * ============================================================================
+ */
+
+/**
+ * mock_posix_spawn - Count spawns and hand back a fixed PID
+ */
+static int mock_posix_spawn(pid_t *restrict pid, const char *restrict path,
+                            const posix_spawn_file_actions_t *file_actions,
+                            const posix_spawnattr_t *restrict attrp,
+                            char *const argv[restrict],
+                            char *const envp[restrict]) {
+  (void)path;
+  (void)file_actions;
+  (void)attrp;
+  (void)argv;
+  (void)envp;
+
+  spawn_count++;
+  *pid = DEFAULT_MOCK_PID;
+  return 0;
+}
+
+/**
+ * mock_waitpid - Report mock_child_exit_code as a normal exit
+ */
+static pid_t mock_waitpid(pid_t pid, int *wstatus, int options) {
+  (void)options;
+  *wstatus = mock_child_exit_code << EXIT_CODE_SHIFT;
+  return pid;
+}
+
+/**
+ * mock_stat_index_dir - Count index refreshes, with SUBID_INDEX_DIR missing
+ */
+static int mock_stat_index_dir(const char *pathname, struct stat *statbuf) {
+  if (strcmp(pathname, SUBID_INDEX_DIR) == 0) {
+    index_dir_stats++;
+    errno = ENOENT;
+    return -1;
+  }
+  return stat(pathname, statbuf);
+}
+
+/**
+ * mock_open_subid_db - Pretend every database exists
+ */
+static int mock_open_subid_db(const char *pathname, int flags, ...) {
+  (void)pathname;
+  (void)flags;
+  return 0;
+}
+
+/**
+ * mock_fdopen_subid_db - Serve a database that assigns testuser a range
+ */
+static FILE *mock_fdopen_subid_db(int fd, const char *mode) {
+  static const char content[] = "testuser:100000:65536\n";
+  (void)fd;
+  (void)mode;
+  return fmemopen((void *)(uintptr_t)content, sizeof(content) - 1, "r");
+}
+
+/**
+ * mock_fdopen_subid_db_other - Serve a database with a foreign range
+ */
+static FILE *mock_fdopen_subid_db_other(int fd, const char *mode) {
+  static const char content[] = "testuser:500000:65536\n";
+  (void)fd;
+  (void)mode;
+  return fmemopen((void *)(uintptr_t)content, sizeof(content) - 1, "r");
+}
+
+/**
+ * mock_fdopen_subid_db_many - Serve foreign ranges before the calculated one
+ *
+ * More than enroll.c compares without allocating, so the match is only
+ * found by looking at every range.
+ */
+static FILE *mock_fdopen_subid_db_many(int fd, const char *mode) {
+  static char content[1024];
+  size_t len = 0;
+  (void)fd;
+  (void)mode;
+  for (int i = 0; i < 20; i++) {
+    len += (size_t)snprintf(content + len, sizeof(content) - len,
+                            "testuser:%d:65536\n", 500000 + (i * 65536));
+  }
+  len += (size_t)snprintf(content + len, sizeof(content) - len,
+                          "testuser:100000:65536\n");
+  return fmemopen(content, len, "r");
+}
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================
+ */
+
+/**
+ * make_spawn_ops - Ops with spawn/wait mocked, real file_actions helpers
+ */
+static struct syscall_ops make_spawn_ops(int exit_code) {
+  struct syscall_ops ops = syscall_ops_default;
+
+  mock_child_exit_code = exit_code;
+  spawn_count = 0;
+  ops.posix_spawn = mock_posix_spawn;
+  ops.waitpid = mock_waitpid;
+  return ops;
+}
+
+/**
+ * make_opts - Options for both modes with the given noop setting
+ */
+static options_t make_opts(bool noop) {
+  options_t opts = {0};
+  opts.do_subuid = true;
+  opts.do_subgid = true;
+  opts.noop = noop;
+  opts.debug = true;
+  return opts;
+}
+
+/* ============================================================================
+ * Tests - Input Validation
+ * ============================================================================
+ */
+
+TEST(enroll_user_null_params) {
+  config_t config = {0};
+  options_t opts = make_opts(true);
+
+  config_factory(&config);
+
+  TEST_ASSERT_EQ(
+      enroll_user(NULL, "testuser", ELIGIBLE_UID, &config, &opts), -1,
+      "Should reject NULL ops");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(enroll_user(&syscall_ops_default, NULL, ELIGIBLE_UID,
+                             &config, &opts),
+                 -1, "Should reject NULL username");
+  TEST_ASSERT_EQ(enroll_user(&syscall_ops_default, "testuser", ELIGIBLE_UID,
+                             NULL, &opts),
+                 -1, "Should reject NULL config");
+  TEST_ASSERT_EQ(enroll_user(&syscall_ops_default, "testuser", ELIGIBLE_UID,
+                             &config, NULL),
+                 -1, "Should reject NULL opts");
+}
+
+TEST(enroll_user_uid_below_min) {
+  config_t config = {0};
+  options_t opts = make_opts(true);
+
+  config_factory(&config);
+
+  TEST_ASSERT_EQ(enroll_user(&syscall_ops_default, "testuser", BELOW_MIN_UID,
+                             &config, &opts),
+                 -1, "Should reject UID below UID_MIN");
+  TEST_ASSERT_EQ(errno, ERANGE, "Should set the correct error code");
+}
+
+TEST(enroll_user_uid_overlaps_subids) {
+  config_t config = {0};
+  options_t opts = make_opts(true);
+
+  config_factory(&config);
+  config.uid_max = OVERLAPPING_UID;
+
+  TEST_ASSERT_EQ(enroll_user(&syscall_ops_default, "testuser",
+                             OVERLAPPING_UID, &config, &opts),
+                 -1, "Should reject UID inside the subordinate range");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+}
+
+/* ============================================================================
+ * Tests - Normal Operation
+ * ============================================================================
+ */
+
+TEST(enroll_user_noop_both_modes) {
+  struct syscall_ops ops = make_spawn_ops(1); /* getsubids: not found */
+  config_t config = {0};
+  options_t opts = make_opts(true);
+
+  config_factory(&config);
+
+  TEST_ASSERT_EQ(enroll_user(&ops, "testuser", ELIGIBLE_UID, &config, &opts),
+                 0, "Should succeed in noop mode");
+  TEST_ASSERT_EQ(spawn_count, 2,
+                 "Should only spawn the existence checks in noop mode");
+}
+
+TEST(enroll_user_skips_existing) {
+  struct syscall_ops ops = make_spawn_ops(0); /* getsubids: exists */
+  config_t config = {0};
+  options_t opts = make_opts(false);
+
+  config_factory(&config);
+
+  TEST_ASSERT_EQ(enroll_user(&ops, "testuser", ELIGIBLE_UID, &config, &opts),
+                 0, "Should succeed when ranges already exist");
+  TEST_ASSERT_EQ(spawn_count, 2,
+                 "Should spawn one check per mode and no usermod");
+}
+
+TEST(enroll_user_check_error) {
+  struct syscall_ops ops = make_spawn_ops(2); /* getsubids: error */
+  config_t config = {0};
+  options_t opts = make_opts(false);
+
+  config_factory(&config);
+
+  TEST_ASSERT_EQ(enroll_user(&ops, "testuser", ELIGIBLE_UID, &config, &opts),
+                 -1, "Should fail when the existence check fails");
+  TEST_ASSERT_EQ(spawn_count, 1, "Should stop after the first failure");
+}
+
+TEST(enroll_user_assigns_without_skip) {
+  struct syscall_ops ops = make_spawn_ops(0); /* usermod: success */
+  config_t config = {0};
+  options_t opts = make_opts(false);
+
+  config_factory(&config);
+  config.skip_if_exists = false;
+
+  TEST_ASSERT_EQ(enroll_user(&ops, "testuser", ELIGIBLE_UID, &config, &opts),
+                 0, "Should assign both ranges");
+  TEST_ASSERT_EQ(spawn_count, 1,
+                 "Should assign both ranges with a single usermod");
+}
+
+TEST(enroll_user_usermod_refreshes_index) {
+  struct syscall_ops ops = make_spawn_ops(0); /* usermod: success */
+  config_t config = {0};
+  options_t opts = make_opts(false);
+
+  config_factory(&config);
+  config.skip_if_exists = false;
+  ops.stat = mock_stat_index_dir;
+  index_dir_stats = 0;
+
+  TEST_ASSERT_EQ(enroll_user(&ops, "testuser", ELIGIBLE_UID, &config, &opts),
+                 0, "Should assign both ranges");
+  TEST_ASSERT_EQ(index_dir_stats, 2, "Should refresh both indexes");
+
+  opts.noop = true;
+  index_dir_stats = 0;
+  TEST_ASSERT_EQ(enroll_user(&ops, "testuser", ELIGIBLE_UID, &config, &opts),
+                 0, "Should pretend to assign both ranges");
+  TEST_ASSERT_EQ(index_dir_stats, 0, "Should not refresh without a write");
+}
+
+TEST(enroll_user_calc_error) {
+  struct syscall_ops ops = make_spawn_ops(0);
+  config_t config = {0};
+  options_t opts = make_opts(false);
+
+  config_factory(&config);
+  config.skip_if_exists = false;
+  config.subuid.count_val = 0;
+
+  TEST_ASSERT_EQ(enroll_user(&ops, "testuser", ELIGIBLE_UID, &config, &opts),
+                 -1, "Should fail when the range cannot be calculated");
+  TEST_ASSERT_EQ(spawn_count, 0, "Should not spawn usermod");
+}
+
+TEST(enroll_user_calc_error_writes_nothing) {
+  struct syscall_ops ops = make_spawn_ops(0);
+  config_t config = {0};
+  options_t opts = make_opts(false);
+
+  config_factory(&config);
+  config.skip_if_exists = false;
+  config.subgid.count_val = 0;
+
+  TEST_ASSERT_EQ(enroll_user(&ops, "testuser", ELIGIBLE_UID, &config, &opts),
+                 -1, "Should fail when the subgid range cannot be calculated");
+  TEST_ASSERT_EQ(spawn_count, 0,
+                 "Should not assign the subuid range on its own");
+}
+
+TEST(enroll_user_usermod_fails) {
+  struct syscall_ops ops = make_spawn_ops(1); /* usermod: failure */
+  config_t config = {0};
+  options_t opts = make_opts(false);
+
+  config_factory(&config);
+  config.skip_if_exists = false;
+  opts.do_subuid = false;
+
+  TEST_ASSERT_EQ(enroll_user(&ops, "testuser", ELIGIBLE_UID, &config, &opts),
+                 -1, "Should fail when usermod fails");
+}
+
+/* ============================================================================
+ * Tests - Files Backend
+ * ============================================================================
+ */
+
+TEST(enroll_user_files_backend_exists) {
+  struct syscall_ops ops = make_spawn_ops(1);
+  config_t config = {0};
+  options_t opts = make_opts(false);
+
+  config_factory(&config);
+  config.subid_backend = SUBID_BACKEND_FILES;
+  ops.open = mock_open_subid_db;
+  ops.fstat = mock_fstat_root_file;
+  ops.fdopen = mock_fdopen_subid_db;
+
+  TEST_ASSERT_EQ(enroll_user(&ops, "testuser", ELIGIBLE_UID, &config, &opts),
+                 0, "Should skip users found in the databases");
+  TEST_ASSERT_EQ(spawn_count, 0, "Should not spawn getsubids or usermod");
+}
+
+TEST(enroll_user_files_backend_missing_db) {
+  struct syscall_ops ops = make_spawn_ops(0); /* usermod: success */
+  config_t config = {0};
+  options_t opts = make_opts(false);
+
+  config_factory(&config);
+  config.subid_backend = SUBID_BACKEND_FILES;
+  ops.open = mock_open_enoent;
+
+  TEST_ASSERT_EQ(enroll_user(&ops, "testuser", ELIGIBLE_UID, &config, &opts),
+                 0, "Should assign when the databases do not exist");
+  TEST_ASSERT_EQ(spawn_count, 1, "Should only spawn usermod, once");
+}
+
+TEST(enroll_user_files_backend_falls_back) {
+  struct syscall_ops ops = make_spawn_ops(0); /* getsubids: exists */
+  config_t config = {0};
+  options_t opts = make_opts(false);
+
+  config_factory(&config);
+  config.subid_backend = SUBID_BACKEND_FILES;
+  ops.open = mock_open_eacces;
+
+  TEST_ASSERT_EQ(enroll_user(&ops, "testuser", ELIGIBLE_UID, &config, &opts),
+                 0, "Should fall back to getsubids on read errors");
+  TEST_ASSERT_EQ(spawn_count, 2, "Should spawn getsubids once per mode");
+}
+
+/* ============================================================================
+ * Tests - SKIP_IF_EXACT
+ * ============================================================================
+ */
+
+TEST(enroll_user_exact_match_skips) {
+  struct syscall_ops ops = make_spawn_ops(0);
+  config_t config = {0};
+  options_t opts = make_opts(false);
+
+  config_factory(&config);
+  config.skip_if_exact = true;
+  ops.open = mock_open_subid_db;
+  ops.fstat = mock_fstat_root_file;
+  ops.fdopen = mock_fdopen_subid_db;
+
+  TEST_ASSERT_EQ(enroll_user(&ops, "testuser", ELIGIBLE_UID, &config, &opts),
+                 0, "Should succeed when the calculated ranges are present");
+  TEST_ASSERT_EQ(spawn_count, 0, "Should not spawn getsubids or usermod");
+}
+
+TEST(enroll_user_exact_match_after_many) {
+  struct syscall_ops ops = make_spawn_ops(0);
+  config_t config = {0};
+  options_t opts = make_opts(false);
+
+  config_factory(&config);
+  config.skip_if_exact = true;
+  ops.open = mock_open_subid_db;
+  ops.fstat = mock_fstat_root_file;
+  ops.fdopen = mock_fdopen_subid_db_many;
+
+  TEST_ASSERT_EQ(enroll_user(&ops, "testuser", ELIGIBLE_UID, &config, &opts),
+                 0, "Should find the calculated range past the first ones");
+  TEST_ASSERT_EQ(spawn_count, 0, "Should not spawn getsubids or usermod");
+
+  ops.calloc = mock_calloc_null;
+  TEST_ASSERT_EQ(enroll_user(&ops, "testuser", ELIGIBLE_UID, &config, &opts),
+                 -1, "Should fail without room for every range");
+  TEST_ASSERT_EQ(errno, ENOMEM, "Should set the correct error code");
+  TEST_ASSERT_EQ(spawn_count, 0, "Should not spawn usermod");
+}
+
+TEST(enroll_user_exact_mismatch_fails) {
+  struct syscall_ops ops = make_spawn_ops(0);
+  config_t config = {0};
+  options_t opts = make_opts(false);
+
+  config_factory(&config);
+  config.skip_if_exact = true;
+  ops.open = mock_open_subid_db;
+  ops.fstat = mock_fstat_root_file;
+  ops.fdopen = mock_fdopen_subid_db_other;
+
+  TEST_ASSERT_EQ(enroll_user(&ops, "testuser", ELIGIBLE_UID, &config, &opts),
+                 -1, "Should refuse to add a second range");
+  TEST_ASSERT_EQ(errno, EEXIST, "Should set the correct error code");
+  TEST_ASSERT_EQ(spawn_count, 0, "Should not spawn usermod");
+}
+
+TEST(enroll_user_exact_none_assigns) {
+  struct syscall_ops ops = make_spawn_ops(0);
+  config_t config = {0};
+  options_t opts = make_opts(false);
+
+  config_factory(&config);
+  config.skip_if_exact = true;
+  ops.open = mock_open_enoent;
+
+  TEST_ASSERT_EQ(enroll_user(&ops, "testuser", ELIGIBLE_UID, &config, &opts),
+                 0, "Should assign when the user has no ranges");
+  TEST_ASSERT_EQ(spawn_count, 1, "Should spawn only usermod");
+}
+
+TEST(enroll_user_exact_read_error) {
+  struct syscall_ops ops = make_spawn_ops(0);
+  config_t config = {0};
+  options_t opts = make_opts(false);
+
+  config_factory(&config);
+  config.skip_if_exact = true;
+  ops.open = mock_open_eacces;
+
+  TEST_ASSERT_EQ(enroll_user(&ops, "testuser", ELIGIBLE_UID, &config, &opts),
+                 -1, "Should fail when the databases cannot be read");
+  TEST_ASSERT_EQ(spawn_count, 0, "Should not spawn anything");
+}
+
+/* ============================================================================
+ * Tests - enroll_user_check
+ * ============================================================================
+ */
+
+TEST(enroll_user_check_null_params) {
+  config_t config = {0};
+  options_t opts = make_opts(false);
+
+  TEST_ASSERT_EQ(enroll_user_check(NULL, "testuser", ELIGIBLE_UID, &config,
+                                   &opts),
+                 -1, "Should reject NULL ops");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(enroll_user_check(&syscall_ops_default, NULL, ELIGIBLE_UID,
+                                   &config, &opts),
+                 -1, "Should reject NULL username");
+}
+
+TEST(enroll_user_check_present) {
+  struct syscall_ops ops = make_spawn_ops(0);
+  config_t config = {0};
+  options_t opts = make_opts(false);
+
+  config_factory(&config);
+  ops.open = mock_open_subid_db;
+  ops.fstat = mock_fstat_root_file;
+  ops.fdopen = mock_fdopen_subid_db;
+
+  TEST_ASSERT_EQ(enroll_user_check(&ops, "testuser", ELIGIBLE_UID, &config,
+                                   &opts),
+                 1, "Calculated ranges present should need nothing");
+  TEST_ASSERT_EQ(spawn_count, 0, "Should not spawn anything");
+}
+
+TEST(enroll_user_check_missing) {
+  struct syscall_ops ops = make_spawn_ops(0);
+  config_t config = {0};
+  options_t opts = make_opts(false);
+
+  config_factory(&config);
+  ops.open = mock_open_enoent;
+
+  TEST_ASSERT_EQ(enroll_user_check(&ops, "testuser", ELIGIBLE_UID, &config,
+                                   &opts),
+                 0, "No ranges should need work");
+  TEST_ASSERT_EQ(spawn_count, 0, "Should not spawn anything");
+}
+
+TEST(enroll_user_check_other_range) {
+  struct syscall_ops ops = make_spawn_ops(0);
+  config_t config = {0};
+  options_t opts = make_opts(false);
+
+  config_factory(&config);
+  ops.open = mock_open_subid_db;
+  ops.fstat = mock_fstat_root_file;
+  ops.fdopen = mock_fdopen_subid_db_other;
+
+  config.skip_if_exists = true;
+  TEST_ASSERT_EQ(enroll_user_check(&ops, "testuser", ELIGIBLE_UID, &config,
+                                   &opts),
+                 1, "SKIP_IF_EXISTS should accept any existing range");
+
+  config.skip_if_exists = false;
+  TEST_ASSERT_EQ(enroll_user_check(&ops, "testuser", ELIGIBLE_UID, &config,
+                                   &opts),
+                 0, "Without skipping the calculated range is still needed");
+
+  config.skip_if_exact = true;
+  TEST_ASSERT_EQ(enroll_user_check(&ops, "testuser", ELIGIBLE_UID, &config,
+                                   &opts),
+                 -1, "SKIP_IF_EXACT should report the mismatch");
+  TEST_ASSERT_EQ(errno, EEXIST, "Should set the correct error code");
+  TEST_ASSERT_EQ(spawn_count, 0, "Should not spawn anything");
+}
+
+TEST(enroll_user_check_errors) {
+  struct syscall_ops ops = make_spawn_ops(0);
+  config_t config = {0};
+  options_t opts = make_opts(false);
+
+  config_factory(&config);
+  ops.open = mock_open_eacces;
+
+  TEST_ASSERT_EQ(enroll_user_check(&ops, "testuser", ELIGIBLE_UID, &config,
+                                   &opts),
+                 -1, "Unreadable databases should be an error");
+  TEST_ASSERT_EQ(enroll_user_check(&ops, "testuser", BELOW_MIN_UID,
+                                   &config, &opts),
+                 -1, "Ineligible UID should be an error");
+  TEST_ASSERT_EQ(spawn_count, 0, "Should not fall back to getsubids");
+}
+
+/* ============================================================================
+ * Tests - Files Writer
+ * ============================================================================
+ */
+
+TEST(enroll_user_files_writer_noop) {
+  struct syscall_ops ops = make_spawn_ops(0);
+  config_t config = {0};
+  options_t opts = make_opts(true);
+
+  config_factory(&config);
+  config.skip_if_exists = false;
+  config.subid_writer = SUBID_WRITER_FILES;
+
+  TEST_ASSERT_EQ(enroll_user(&ops, "testuser", ELIGIBLE_UID, &config, &opts),
+                 0, "Should succeed in noop mode");
+  TEST_ASSERT_EQ(spawn_count, 0, "Should not spawn usermod");
+}
+
+TEST(enroll_user_deferred_queues) {
+  struct syscall_ops ops = make_spawn_ops(0);
+  config_t config = {0};
+  options_t opts = make_opts(false);
+  subid_txn_t txn = {0};
+
+  config_factory(&config);
+  config.skip_if_exists = false;
+  config.subid_writer = SUBID_WRITER_FILES;
+
+  TEST_ASSERT_EQ(enroll_user_deferred(&ops, "testuser", ELIGIBLE_UID, &config,
+                                      &opts, &txn),
+                 0, "Should queue both ranges");
+  TEST_ASSERT_EQ(spawn_count, 0, "Should not spawn usermod");
+  TEST_ASSERT_EQ(txn.subuid.len, 1, "Should queue one subuid range");
+  TEST_ASSERT_EQ(txn.subgid.len, 1, "Should queue one subgid range");
+  TEST_ASSERT_EQ(txn.users, 1, "Should count the user once");
+  TEST_ASSERT_STR_EQ(txn.subuid.entries[0].owner, "testuser",
+                     "Should queue under the username");
+  TEST_ASSERT_EQ(txn.subuid.entries[0].start, config.subuid.min_val,
+                 "Should queue the calculated start");
+  subid_txn_free(&ops, &txn);
+}
+
+TEST(enroll_user_deferred_rolls_back) {
+  struct syscall_ops ops = make_spawn_ops(0);
+  config_t config = {0};
+  options_t opts = make_opts(false);
+  subid_txn_t txn = {0};
+
+  config_factory(&config);
+  config.skip_if_exists = false;
+  config.subid_writer = SUBID_WRITER_FILES;
+  config.subgid.count_val = 0;
+
+  TEST_ASSERT_EQ(enroll_user_deferred(&ops, "testuser", ELIGIBLE_UID, &config,
+                                      &opts, &txn),
+                 -1, "Should fail when the subgid range cannot be calculated");
+  TEST_ASSERT_EQ(txn.subuid.len, 0, "Should drop the queued subuid range");
+  TEST_ASSERT_EQ(txn.users, 0, "Should not count the failed user");
+  subid_txn_free(&ops, &txn);
+}
+
+/* ============================================================================
+ * Tests - enroll_session
+ * ============================================================================
+ */
+
+TEST(enroll_session_null_params) {
+  config_t config = {0};
+  options_t opts = make_opts(false);
+
+  config_factory(&config);
+  TEST_ASSERT_EQ(enroll_session(&syscall_ops_default, NULL, &config, &opts),
+                 -1, "Should reject NULL user");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+}
+
+TEST(enroll_session_present_spawns_nothing) {
+  struct syscall_ops ops = make_spawn_ops(0);
+  config_t config = {0};
+  options_t opts = make_opts(false);
+
+  config_factory(&config);
+  ops.getpwnam_r = mock_getpwnam_r_success;
+  ops.open = mock_open_subid_db;
+  ops.fstat = mock_fstat_root_file;
+  ops.fdopen = mock_fdopen_subid_db;
+
+  TEST_ASSERT_EQ(enroll_session(&ops, "testuser", &config, &opts), 0,
+                 "Ranges already in place should be success");
+  TEST_ASSERT_EQ(spawn_count, 0, "Fast path should not spawn anything");
+}
+
+TEST(enroll_session_assigns_missing) {
+  struct syscall_ops ops = make_spawn_ops(0);
+  config_t config = {0};
+  options_t opts = make_opts(false);
+
+  config_factory(&config);
+  config.skip_if_exists = false;
+  ops.getpwnam_r = mock_getpwnam_r_success;
+  ops.open = mock_open_enoent;
+
+  TEST_ASSERT_EQ(enroll_session(&ops, "testuser", &config, &opts), 0,
+                 "Should assign the missing ranges");
+  TEST_ASSERT_EQ(spawn_count, 1, "Should run usermod once for both modes");
+}
+
+TEST(enroll_session_not_eligible) {
+  struct syscall_ops ops = make_spawn_ops(0);
+  config_t config = {0};
+  options_t opts = make_opts(false);
+
+  config_factory(&config);
+  config.uid_min = 2000;
+  ops.getpwnam_r = mock_getpwnam_r_success;
+
+  TEST_ASSERT_EQ(enroll_session(&ops, "testuser", &config, &opts), 1,
+                 "UIDs outside the range should be skipped");
+  TEST_ASSERT_EQ(spawn_count, 0, "Should not spawn anything");
+}
+
+TEST(enroll_session_errors) {
+  struct syscall_ops ops = make_spawn_ops(0);
+  config_t config = {0};
+  options_t opts = make_opts(false);
+
+  config_factory(&config);
+  ops.getpwnam_r = mock_getpwnam_r_not_found;
+  TEST_ASSERT_EQ(enroll_session(&ops, "ghost", &config, &opts), -1,
+                 "Unknown users should fail");
+
+  ops.calloc = mock_calloc_null;
+  TEST_ASSERT_EQ(enroll_session(&ops, "testuser", &config, &opts), -1,
+                 "Should fail when memory runs out");
+  TEST_ASSERT_EQ(errno, ENOMEM, "Should set the correct error code");
+}
+
+/* ============================================================================
+ * Test Runner
+ * ============================================================================
+ */
+
+int main(int argc, char **argv) {
+  TEST_INIT(10, false, false); /* timeout, verbose, duration */
+
+  /* enroll_user: Input validation */
+  RUN_TEST(enroll_user_null_params);
+  RUN_TEST(enroll_user_uid_below_min);
+  RUN_TEST(enroll_user_uid_overlaps_subids);
+
+  /* enroll_user: Normal operation */
+  RUN_TEST(enroll_user_noop_both_modes);
+  RUN_TEST(enroll_user_skips_existing);
+  RUN_TEST(enroll_user_check_error);
+  RUN_TEST(enroll_user_assigns_without_skip);
+  RUN_TEST(enroll_user_usermod_refreshes_index);
+  RUN_TEST(enroll_user_calc_error);
+  RUN_TEST(enroll_user_calc_error_writes_nothing);
+  RUN_TEST(enroll_user_usermod_fails);
+
+  /* enroll_user: Files backend */
+  RUN_TEST(enroll_user_files_backend_exists);
+  RUN_TEST(enroll_user_files_backend_missing_db);
+  RUN_TEST(enroll_user_files_backend_falls_back);
+
+  /* enroll_user: SKIP_IF_EXACT */
+  RUN_TEST(enroll_user_exact_match_skips);
+  RUN_TEST(enroll_user_exact_match_after_many);
+  RUN_TEST(enroll_user_exact_mismatch_fails);
+  RUN_TEST(enroll_user_exact_none_assigns);
+  RUN_TEST(enroll_user_exact_read_error);
+
+  /* enroll_user_check */
+  RUN_TEST(enroll_user_check_null_params);
+  RUN_TEST(enroll_user_check_present);
+  RUN_TEST(enroll_user_check_missing);
+  RUN_TEST(enroll_user_check_other_range);
+  RUN_TEST(enroll_user_check_errors);
+
+  /* enroll_user: Files writer */
+  RUN_TEST(enroll_user_files_writer_noop);
+  RUN_TEST(enroll_user_deferred_queues);
+  RUN_TEST(enroll_user_deferred_rolls_back);
+
+  /* enroll_session */
+  RUN_TEST(enroll_session_null_params);
+  RUN_TEST(enroll_session_present_spawns_nothing);
+  RUN_TEST(enroll_session_assigns_missing);
+  RUN_TEST(enroll_session_not_eligible);
+  RUN_TEST(enroll_session_errors);
+
+  return TEST_EXECUTE();
+}
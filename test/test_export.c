@@ -0,0 +1,479 @@
+/**
+ * test_export.c - Tests for the subuid/subgid table export
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <pwd.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "test_framework.h"
+#include "test_helpers/all.h"
+
+/* ============================================================================
+ * Constants
+ * ============================================================================
+ */
+
+/* Fake descriptor handed out by mock_open_tmp */
+enum { MOCK_FD_TMP = 310 };
+
+/* Accounts in the generated large passwd database */
+enum { LARGE_USERS = 60000 };
+
+/* ============================================================================
+ * Mock Passwd and Output
+ * ============================================================================
+ */
+
+/* Accounts served by the passwd mocks, in getpwent order */
+static const struct passwd *mock_pwent_table = NULL;
+static size_t mock_pwent_count = 0;
+static size_t mock_pwent_pos = 0;
+
+/* Everything written, whichever descriptor it went to */
+static char *mock_written = NULL;
+static size_t mock_written_len = 0;
+static size_t mock_write_calls = 0;
+static int mock_write_fd = -1;
+
+/* Paths seen by open, rename and unlink */
+static char mock_open_path[256] = {0};
+static char mock_rename_from[256] = {0};
+static char mock_rename_to[256] = {0};
+static char mock_unlink_path[256] = {0};
+static mode_t mock_fchmod_mode = 0;
+static int mock_fsync_calls = 0;
+
+/**
+ * mock_setpwent - Rewind the mock passwd table
+ */
+static void mock_setpwent(void) { mock_pwent_pos = 0; }
+
+/**
+ * mock_getpwent - Return the next account from mock_pwent_table
+ */
+static struct passwd *mock_getpwent(void) {
+  if (mock_pwent_pos >= mock_pwent_count) {
+    errno = 0;
+    return NULL;
+  }
+  return (struct passwd *)(uintptr_t)&mock_pwent_table[mock_pwent_pos++];
+}
+
+/**
+ * mock_endpwent - Nothing to release
+ */
+static void mock_endpwent(void) {}
+
+/**
+ * mock_getpwuid_r_table - Find @uid in mock_pwent_table
+ */
+static int mock_getpwuid_r_table(uid_t uid, struct passwd *pwd, char *buf,
+                                 size_t buflen, struct passwd **result) {
+  (void)buf;
+  (void)buflen;
+  *result = NULL;
+  for (size_t i = 0; i < mock_pwent_count; i++) {
+    if (mock_pwent_table[i].pw_uid == uid) {
+      *pwd = mock_pwent_table[i];
+      *result = pwd;
+      break;
+    }
+  }
+  return 0;
+}
+
+/**
+ * mock_getpwnam_r_table - Find @name in mock_pwent_table
+ */
+static int mock_getpwnam_r_table(const char *name, struct passwd *pwd,
+                                 char *buf, size_t buflen,
+                                 struct passwd **result) {
+  *result = NULL;
+  for (size_t i = 0; i < mock_pwent_count; i++) {
+    if (strcmp(mock_pwent_table[i].pw_name, name) == 0) {
+      (void)snprintf(buf, buflen, "%s", name);
+      *pwd = mock_pwent_table[i];
+      pwd->pw_name = buf;
+      *result = pwd;
+      break;
+    }
+  }
+  return 0;
+}
+
+/**
+ * mock_write_capture - Append every write to mock_written
+ */
+static ssize_t mock_write_capture(int fd, const void *buf, size_t count) {
+  char *grown = realloc(mock_written, mock_written_len + count + 1);
+  if (grown == NULL) {
+    errno = ENOMEM;
+    return -1;
+  }
+  mock_written = grown;
+  memcpy(mock_written + mock_written_len, buf, count);
+  mock_written_len += count;
+  mock_written[mock_written_len] = '\0';
+  mock_write_calls++;
+  mock_write_fd = fd;
+  return (ssize_t)count;
+}
+
+/**
+ * mock_write_short - Write at most 7 bytes per call, after one EINTR
+ */
+static ssize_t mock_write_short(int fd, const void *buf, size_t count) {
+  if (mock_write_calls++ == 0) {
+    errno = EINTR;
+    return -1;
+  }
+  mock_write_calls--;
+  return mock_write_capture(fd, buf, count < 7 ? count : 7);
+}
+
+/**
+ * mock_write_eio - Fail every write
+ */
+static ssize_t mock_write_eio(int fd, const void *buf, size_t count) {
+  (void)fd;
+  (void)buf;
+  (void)count;
+  errno = EIO;
+  return -1;
+}
+
+/**
+ * mock_open_tmp - Record the path and hand out the fake descriptor
+ */
+static int mock_open_tmp(const char *pathname, int flags, ...) {
+  (void)flags;
+  (void)snprintf(mock_open_path, sizeof(mock_open_path), "%s", pathname);
+  return MOCK_FD_TMP;
+}
+
+/**
+ * mock_fchmod_record - Record the mode
+ */
+static int mock_fchmod_record(int fd, mode_t mode) {
+  (void)fd;
+  mock_fchmod_mode = mode;
+  return 0;
+}
+
+/**
+ * mock_fsync_count - Count the calls
+ */
+static int mock_fsync_count(int fd) {
+  (void)fd;
+  mock_fsync_calls++;
+  return 0;
+}
+
+/**
+ * mock_rename_record - Record both paths
+ */
+static int mock_rename_record(const char *oldpath, const char *newpath) {
+  (void)snprintf(mock_rename_from, sizeof(mock_rename_from), "%s", oldpath);
+  (void)snprintf(mock_rename_to, sizeof(mock_rename_to), "%s", newpath);
+  return 0;
+}
+
+/**
+ * mock_unlink_record - Record the path
+ */
+static int mock_unlink_record(const char *pathname) {
+  (void)snprintf(mock_unlink_path, sizeof(mock_unlink_path), "%s", pathname);
+  return 0;
+}
+
+/**
+ * make_export_ops - Ops serving @table and capturing all output
+ * @table: Accounts known to the passwd mocks
+ * @count: Number of accounts in @table
+ */
+static struct syscall_ops make_export_ops(const struct passwd *table,
+                                          size_t count) {
+  struct syscall_ops ops = syscall_ops_default;
+
+  mock_pwent_table = table;
+  mock_pwent_count = count;
+  mock_pwent_pos = 0;
+  free(mock_written);
+  mock_written = NULL;
+  mock_written_len = 0;
+  mock_write_calls = 0;
+  mock_write_fd = -1;
+  mock_open_path[0] = '\0';
+  mock_rename_from[0] = '\0';
+  mock_rename_to[0] = '\0';
+  mock_unlink_path[0] = '\0';
+  mock_fchmod_mode = 0;
+  mock_fsync_calls = 0;
+
+  ops.setpwent = mock_setpwent;
+  ops.getpwent = mock_getpwent;
+  ops.endpwent = mock_endpwent;
+  ops.getpwuid_r = mock_getpwuid_r_table;
+  ops.getpwnam_r = mock_getpwnam_r_table;
+  ops.write = mock_write_capture;
+  ops.open = mock_open_tmp;
+  ops.close = mock_close_any;
+  ops.fchmod = mock_fchmod_record;
+  ops.fsync = mock_fsync_count;
+  ops.rename = mock_rename_record;
+  ops.unlink = mock_unlink_record;
+  return ops;
+}
+
+/* Names of the small passwd table, writable as struct passwd wants */
+static char root[] = "root";
+static char alice[] = "alice";
+static char bob[] = "bob";
+static char carol[] = "carol";
+static char dave[] = "dave";
+static char nobody[] = "nobody";
+
+/* A small passwd database, deliberately not in UID order */
+static const struct passwd small_table[] = {
+    {.pw_name = root, .pw_uid = 0},      {.pw_name = carol, .pw_uid = 1002},
+    {.pw_name = alice, .pw_uid = 1000},  {.pw_name = nobody, .pw_uid = 65534},
+    {.pw_name = dave, .pw_uid = 1005},   {.pw_name = bob, .pw_uid = 1001},
+};
+
+/* What the default configuration gives alice, bob, carol and dave */
+#define LINE_ALICE "alice:100000:65536\n"
+#define LINE_BOB "bob:165536:65536\n"
+#define LINE_CAROL "carol:231072:65536\n"
+#define LINE_DAVE "dave:427680:65536\n"
+
+/* ============================================================================
+ * Tests
+ * ============================================================================
+ */
+
+TEST(export_run_null_params) {
+  config_t config = {0};
+  options_t opts = {.do_subuid = true, .export_path = "-"};
+
+  config_factory(&config);
+  TEST_ASSERT_EQ(export_run(NULL, &config, &opts, NULL), -1,
+                 "Should reject NULL ops");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  opts.export_path = NULL;
+  TEST_ASSERT_EQ(export_run(&syscall_ops_default, &config, &opts, NULL), -1,
+                 "Should reject a missing --export");
+}
+
+TEST(export_all_eligible) {
+  config_t config = {0};
+  options_t opts = {.do_subuid = true, .export_path = "-"};
+
+  config_factory(&config);
+  struct syscall_ops ops = make_export_ops(small_table, 6);
+
+  TEST_ASSERT_EQ(export_run(&ops, &config, &opts, NULL), 0, "Should export");
+  TEST_ASSERT_EQ(mock_write_fd, STDOUT_FILENO, "Should write to stdout");
+  TEST_ASSERT_STR_EQ(mock_written, LINE_ALICE LINE_BOB LINE_CAROL LINE_DAVE,
+                     "Should list eligible users in UID order");
+  TEST_ASSERT_EQ(mock_write_calls, 1, "Should write the table at once");
+}
+
+TEST(export_subgid_args) {
+  config_t config = {0};
+  char uid_dave[] = "1005";
+  char name_alice[] = "alice";
+  char name_bob[] = "bob";
+  char uid_alice[] = "1000";
+  char *args[] = {uid_dave, name_alice, name_bob, uid_alice, NULL};
+  options_t opts = {.do_subgid = true,
+                    .export_path = "-",
+                    .user_args = args,
+                    .user_argc = 4};
+
+  config_factory(&config);
+  config.subgid.count_val = 10;
+  struct syscall_ops ops = make_export_ops(small_table, 6);
+
+  TEST_ASSERT_EQ(export_run(&ops, &config, &opts, NULL), 0, "Should export");
+  TEST_ASSERT_STR_EQ(mock_written,
+                     "alice:100000:10\n"
+                     "bob:100010:10\n"
+                     "dave:100050:10\n",
+                     "Should sort, drop the duplicate and use the GID ranges");
+}
+
+TEST(export_stream) {
+  config_t config = {0};
+  options_t opts = {.do_subuid = true, .export_path = "-"};
+  const char *input = "# list\ncarol\n\n1000\n";
+
+  config_factory(&config);
+  struct syscall_ops ops = make_export_ops(small_table, 6);
+  FILE *in = fmemopen((void *)(uintptr_t)input, strlen(input), "r");
+  TEST_ASSERT_NOT_EQ(in, NULL, "Should open the input");
+
+  TEST_ASSERT_EQ(export_run(&ops, &config, &opts, in), 0, "Should export");
+  TEST_ASSERT_STR_EQ(mock_written, LINE_ALICE LINE_CAROL,
+                     "Should skip comments and blank lines");
+  (void)fclose(in);
+}
+
+TEST(export_failure_writes_nothing) {
+  config_t config = {0};
+  char name_alice[] = "alice";
+  char name_ghost[] = "ghost";
+  char name_root[] = "root";
+  char *args[] = {name_alice, name_ghost, name_root, NULL};
+  options_t opts = {.do_subuid = true,
+                    .export_path = "/etc/subuid",
+                    .user_args = args,
+                    .user_argc = 3};
+
+  config_factory(&config);
+  struct syscall_ops ops = make_export_ops(small_table, 6);
+
+  TEST_ASSERT_EQ(export_run(&ops, &config, &opts, NULL), -1,
+                 "Unknown and ineligible users should fail the export");
+  TEST_ASSERT_EQ(mock_written_len, 0, "Should write nothing");
+  TEST_ASSERT_STR_EQ(mock_open_path, "", "Should not create the file");
+}
+
+TEST(export_file_is_renamed_into_place) {
+  config_t config = {0};
+  options_t opts = {.do_subuid = true, .export_path = "/srv/image/subuid"};
+  char tmppath[64] = {0};
+
+  config_factory(&config);
+  struct syscall_ops ops = make_export_ops(small_table, 6);
+  (void)snprintf(tmppath, sizeof(tmppath), "/srv/image/subuid.%ld+",
+                 (long)getpid());
+
+  TEST_ASSERT_EQ(export_run(&ops, &config, &opts, NULL), 0, "Should export");
+  TEST_ASSERT_STR_EQ(mock_open_path, tmppath, "Should write a temporary");
+  TEST_ASSERT_EQ(mock_write_fd, MOCK_FD_TMP, "Should write the temporary");
+  TEST_ASSERT_EQ(mock_fchmod_mode, 0644, "Should be world readable");
+  TEST_ASSERT_EQ(mock_fsync_calls, 1, "Should flush before the rename");
+  TEST_ASSERT_STR_EQ(mock_rename_from, tmppath, "Should rename the temporary");
+  TEST_ASSERT_STR_EQ(mock_rename_to, "/srv/image/subuid",
+                     "Should rename onto the target");
+  TEST_ASSERT_STR_EQ(mock_written, LINE_ALICE LINE_BOB LINE_CAROL LINE_DAVE,
+                     "Should write the whole table");
+}
+
+TEST(export_file_write_error) {
+  config_t config = {0};
+  options_t opts = {.do_subuid = true, .export_path = "/srv/image/subuid"};
+
+  config_factory(&config);
+  struct syscall_ops ops = make_export_ops(small_table, 6);
+  ops.write = mock_write_eio;
+
+  TEST_ASSERT_EQ(export_run(&ops, &config, &opts, NULL), -1,
+                 "Should fail on a write error");
+  TEST_ASSERT_STR_EQ(mock_rename_to, "", "Should not rename");
+  TEST_ASSERT_STR_EQ(mock_unlink_path, mock_open_path,
+                     "Should remove the temporary");
+}
+
+TEST(export_short_writes) {
+  config_t config = {0};
+  options_t opts = {.do_subuid = true, .export_path = "-"};
+
+  config_factory(&config);
+  struct syscall_ops ops = make_export_ops(small_table, 6);
+  ops.write = mock_write_short;
+
+  TEST_ASSERT_EQ(export_run(&ops, &config, &opts, NULL), 0,
+                 "Should retry EINTR and short writes");
+  TEST_ASSERT_STR_EQ(mock_written, LINE_ALICE LINE_BOB LINE_CAROL LINE_DAVE,
+                     "Should write everything once");
+}
+
+TEST(export_range_failure) {
+  config_t config = {0};
+  options_t opts = {.do_subuid = true, .export_path = "-"};
+
+  config_factory(&config);
+  config.subuid.max_val = config.subuid.min_val + 2 * 65536 - 1;
+  struct syscall_ops ops = make_export_ops(small_table, 6);
+
+  TEST_ASSERT_EQ(export_run(&ops, &config, &opts, NULL), -1,
+                 "carol and dave do not fit");
+  TEST_ASSERT_EQ(mock_written_len, 0, "Should write nothing");
+}
+
+TEST(export_large_table) {
+  config_t config = {0};
+  options_t opts = {.do_subuid = true, .export_path = "-"};
+  struct passwd *table = calloc(LARGE_USERS, sizeof(*table));
+  char *names = calloc(LARGE_USERS, 16);
+
+  TEST_ASSERT_NOT_EQ(table, NULL, "Should allocate the table");
+  TEST_ASSERT_NOT_EQ(names, NULL, "Should allocate the names");
+  config_factory(&config);
+  config.uid_max = 1000 + LARGE_USERS;
+  config.subuid.min_val = 1000000;
+  config.subuid.count_val = 1000;
+
+  /* Top down, with a hole every 100 UIDs, so there are many bands to sort */
+  size_t n = 0;
+  for (uint32_t i = LARGE_USERS; i > 0; i--) {
+    uint32_t uid = 1000 + i - 1;
+    if (uid % 100 == 50) {
+      continue;
+    }
+    (void)snprintf(names + n * 16, 16, "u%u", uid);
+    table[n] = (struct passwd){.pw_name = names + n * 16, .pw_uid = uid};
+    n++;
+  }
+
+  struct syscall_ops ops = make_export_ops(table, n);
+  TEST_ASSERT_EQ(export_run(&ops, &config, &opts, NULL), 0, "Should export");
+
+  size_t lines = 0;
+  for (size_t i = 0; i < mock_written_len; i++) {
+    lines += mock_written[i] == '\n';
+  }
+  TEST_ASSERT_EQ(lines, n, "Should write one line per user");
+  TEST_ASSERT_EQ(strncmp(mock_written, "u1000:1000000:1000\nu1001:", 25), 0,
+                 "Should start with the lowest UID");
+  TEST_ASSERT_NOT_EQ(strstr(mock_written, "\nu60999:60999000:1000\n"), NULL,
+                     "Should calculate the last range");
+  TEST_ASSERT_EQ(strstr(mock_written, "\nu1050:"), NULL,
+                 "Should leave out missing UIDs");
+  TEST_ASSERT_NOT_EQ(mock_write_calls, 1,
+                     "Should flush the buffer as it fills");
+  free(names);
+  free(table);
+}
+
+int main(int argc, char **argv) {
+  TEST_INIT(10, false, false); /* timeout, verbose, duration */
+
+  RUN_TEST(export_run_null_params);
+  RUN_TEST(export_all_eligible);
+  RUN_TEST(export_subgid_args);
+  RUN_TEST(export_stream);
+  RUN_TEST(export_failure_writes_nothing);
+  RUN_TEST(export_file_is_renamed_into_place);
+  RUN_TEST(export_file_write_error);
+  RUN_TEST(export_short_writes);
+  RUN_TEST(export_range_failure);
+  RUN_TEST(export_large_table);
+
+  free(mock_written);
+  return TEST_EXECUTE();
+}
@@ -13,9 +13,11 @@
 #define TEST_HELPER_MOCK_ALLOC_H
 
 #include <stddef.h>
+#include <stdlib.h>
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-function"
+#pragma GCC diagnostic ignored "-Wunused-variable"
 
 /* ============================================================================
  * Mock Implementations
@@ -38,5 +40,60 @@ static void *mock_calloc_null(size_t nmemb, size_t size) {
   return NULL;
 }
 
+/* ============================================================================
+ * Counting Allocator
+ *
+ * Backs an arena (or any ops) with calloc/free while counting the calls,
+ * and fails allocations once mock_calloc_budget runs out.
+ * ============================================================================
+ */
+
+/* Allocations mock_calloc_counting has handed out */
+static int mock_calloc_calls = 0;
+
+/* Non-NULL pointers mock_free_counting has released */
+static int mock_free_calls = 0;
+
+/* Allocations allowed before mock_calloc_counting fails, -1 for no limit */
+static int mock_calloc_budget = -1;
+
+/**
+ * mock_alloc_reset - Zero the counters and lift the budget
+ */
+static void mock_alloc_reset(void) {
+  mock_calloc_calls = 0;
+  mock_free_calls = 0;
+  mock_calloc_budget = -1;
+}
+
+/**
+ * mock_calloc_counting - calloc that counts calls and honours a budget
+ * @nmemb: Number of elements
+ * @size: Size of each element
+ *
+ * Return: calloc(3) memory, NULL once mock_calloc_budget reaches 0
+ */
+static void *mock_calloc_counting(size_t nmemb, size_t size) {
+  if (mock_calloc_budget == 0) {
+    return NULL;
+  }
+  if (mock_calloc_budget > 0) {
+    mock_calloc_budget--;
+  }
+  mock_calloc_calls++;
+  return calloc(nmemb, size);
+}
+
+/**
+ * mock_free_counting - free that counts the pointers released
+ * @ptr: Memory from mock_calloc_counting(), may be NULL
+ */
+static void mock_free_counting(void *ptr) {
+  if (ptr != NULL) {
+    mock_free_calls++;
+  }
+  free(ptr);
+}
+
 #pragma GCC diagnostic pop
 #endif /* TEST_HELPER_MOCK_ALLOC_H */
@@ -185,5 +185,29 @@ static int mock_scandir_zero_files(const char *dirp, struct dirent ***namelist,
   return 0;
 }
 
+/* ============================================================================
+ * openat() Mock Implementations
+ * ============================================================================
+ */
+
+/**
+ * mock_openat_enoent - Mock openat that fails with ENOENT
+ * @dirfd: Directory descriptor (ignored)
+ * @pathname: Path to open (ignored)
+ * @flags: Open flags (ignored)
+ *
+ * Simulates a missing drop-in directory.
+ *
+ * Return: -1 with errno set to ENOENT
+ */
+static int mock_openat_enoent(int dirfd, const char *pathname, int flags,
+                              ...) {
+  (void)dirfd;
+  (void)pathname;
+  (void)flags;
+  errno = ENOENT;
+  return -1;
+}
+
 #pragma GCC diagnostic pop
 #endif /* TEST_HELPER_MOCK_FILE_H */
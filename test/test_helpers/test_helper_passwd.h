@@ -1,16 +1,17 @@
 /**
  * test_helper_passwd.h - Password database mock functions
  *
- * Provides mock implementations of getpwuid() and getpwnam_r() for testing
- * user resolution without requiring actual system users.
+ * Provides mock implementations of getpwuid_r() and getpwnam_r() for
+ * testing user resolution without requiring actual system users.
  *
  * Mock variants available:
- * - mock_getpwuid_null: User not found (returns NULL)
- * - mock_getpwuid_testuser: Standard test user (testuser, UID 1000, GID 1000)
- * - mock_getpwuid_root: Root user (root, UID 0, GID 0)
- * - mock_getpwuid_longname: Very long username (255 chars, for buffer overflow
- * testing)
- * - mock_getpwuid_null_pwname: Malformed entry with NULL pw_name
+ * - mock_getpwuid_r_null: User not found (sets *result = NULL)
+ * - mock_getpwuid_r_testuser: Standard test user (testuser, UID 1000,
+ * GID 1000)
+ * - mock_getpwuid_r_root: Root user (root, UID 0, GID 0)
+ * - mock_getpwuid_r_longname: Very long username (255 chars, for buffer
+ * overflow testing)
+ * - mock_getpwuid_r_null_pwname: Malformed entry with NULL pw_name
  * - mock_getpwnam_r_success: Successful lookup
  * - mock_getpwnam_r_not_found: User not found (sets *result = NULL)
  * - mock_getpwnam_r_error: System error (returns EIO)
@@ -23,10 +24,11 @@
  *   #include "test_helper_all.h"
  *
  *   struct syscall_ops ops = syscall_ops_default;
- *   ops.getpwuid = mock_getpwuid_testuser;
+ *   ops.getpwuid_r = mock_getpwuid_r_testuser;
  *   ops.getpwnam_r = mock_getpwnam_r_not_found;
  *
- *   result = resolve_user(&ops, "testuser", &uid, username, bufsize, true);
+ *   result = resolve_user(&ops, "testuser", &uid, username, bufsize, 0,
+ *                         true);
  */
 
 #ifndef TEST_HELPER_PASSWD_H
@@ -52,118 +54,146 @@
 #define TEST_GID_ROOT 0               /* Root user GID */
 #define TEST_GID_STANDARD 1000        /* Standard test user GID */
 
-/* ============================================================================
- * Global Mock Storage - Password Database Simulation
- * ============================================================================
- */
-
-/*
- * Static storage for mock passwd structures.
- * These are reused across different mock functions to avoid repeated
- * allocations. They are safe because tests run sequentially.
- */
-static struct passwd mock_pwd_storage = {0};
-static char mock_pw_name_storage[MOCK_USERNAME_BUFFER_SIZE] = {0};
-
 /* ============================================================================
  * Helper Functions
  * ============================================================================
  */
 
 /**
- * setup_mock_user - Helper to configure mock passwd structure
+ * fill_mock_user - Helper to fill the caller's passwd storage
+ * @pwd: Output passwd structure
+ * @buf: Buffer for string storage
+ * @buflen: Size of buffer
  * @username: Username to set
  * @uid: User ID to set
  * @gid: Group ID to set
+ * @result: Output pointer to passwd structure
  *
  * Centralizes mock passwd setup to reduce code duplication across
- * different getpwuid mock variants.
+ * different getpwuid_r mock variants. Only the caller's storage is
+ * touched, so the mocks are safe from several threads.
  *
- * Return: Pointer to static passwd structure
+ * Return: 0, or ERANGE when @username does not fit in @buf
  */
-static struct passwd *setup_mock_user(const char *username, uid_t uid,
-                                      gid_t gid) {
-  snprintf(mock_pw_name_storage, sizeof(mock_pw_name_storage), "%s", username);
-  mock_pwd_storage.pw_name = mock_pw_name_storage;
-  mock_pwd_storage.pw_uid = uid;
-  mock_pwd_storage.pw_gid = gid;
-
-  return &mock_pwd_storage;
+static int fill_mock_user(struct passwd *pwd, char *buf, size_t buflen,
+                          const char *username, uid_t uid, gid_t gid,
+                          struct passwd **result) {
+  *result = NULL;
+  if (strlen(username) >= buflen) {
+    return ERANGE;
+  }
+
+  snprintf(buf, buflen, "%s", username);
+  pwd->pw_name = buf;
+  pwd->pw_uid = uid;
+  pwd->pw_gid = gid;
+
+  *result = pwd;
+  return 0;
 }
 
 /* ============================================================================
- * getpwuid() Mock Implementations
+ * getpwuid_r() Mock Implementations
  * ============================================================================
  */
 
 /**
- * mock_getpwuid_null - Mock getpwuid that returns NULL (user not found)
+ * mock_getpwuid_r_null - Mock getpwuid_r that finds no user
  * @uid: User ID to look up (ignored)
+ * @pwd: Output passwd structure (ignored)
+ * @buf: Buffer for string storage (ignored)
+ * @buflen: Size of buffer (ignored)
+ * @result: Output pointer to passwd structure
  *
  * Simulates user not found in password database.
  *
- * Return: NULL
+ * Return: 0 with *result set to NULL
  */
-static struct passwd *mock_getpwuid_null(uid_t uid) {
+static int mock_getpwuid_r_null(uid_t uid, struct passwd *pwd, char *buf,
+                                size_t buflen, struct passwd **result) {
   (void)uid;
-  return NULL;
+  (void)pwd;
+  (void)buf;
+  (void)buflen;
+
+  *result = NULL;
+  return 0;
 }
 
 /**
- * mock_getpwuid_testuser - Mock getpwuid that returns a standard test user
+ * mock_getpwuid_r_testuser - Mock getpwuid_r that returns a standard user
  * @uid: User ID to look up (ignored)
+ * @pwd: Output passwd structure
+ * @buf: Buffer for string storage
+ * @buflen: Size of buffer
+ * @result: Output pointer to passwd structure
  *
  * Returns a test user with:
  * - Username: "testuser"
  * - UID: 1000
  * - GID: 1000
  *
- * Return: Pointer to static passwd structure
+ * Return: 0 on success
  */
-static struct passwd *mock_getpwuid_testuser(uid_t uid) {
+static int mock_getpwuid_r_testuser(uid_t uid, struct passwd *pwd, char *buf,
+                                    size_t buflen, struct passwd **result) {
   (void)uid;
-  return setup_mock_user("testuser", TEST_UID_STANDARD, TEST_GID_STANDARD);
+  return fill_mock_user(pwd, buf, buflen, "testuser", TEST_UID_STANDARD,
+                        TEST_GID_STANDARD, result);
 }
 
 /**
- * mock_getpwuid_root - Mock getpwuid that returns root user
+ * mock_getpwuid_r_root - Mock getpwuid_r that returns root user
  * @uid: User ID to look up (ignored)
+ * @pwd: Output passwd structure
+ * @buf: Buffer for string storage
+ * @buflen: Size of buffer
+ * @result: Output pointer to passwd structure
  *
  * Returns root user information for testing privileged user handling.
  *
- * Return: Pointer to static passwd structure with root user
+ * Return: 0 on success
  */
-static struct passwd *mock_getpwuid_root(uid_t uid) {
+static int mock_getpwuid_r_root(uid_t uid, struct passwd *pwd, char *buf,
+                                size_t buflen, struct passwd **result) {
   (void)uid;
-  return setup_mock_user("root", TEST_UID_ROOT, TEST_GID_ROOT);
+  return fill_mock_user(pwd, buf, buflen, "root", TEST_UID_ROOT,
+                        TEST_GID_ROOT, result);
 }
 
 /**
- * mock_getpwuid_longname - Mock getpwuid that returns a very long username
+ * mock_getpwuid_r_longname - Mock getpwuid_r that returns a very long name
  * @uid: User ID to look up (ignored)
+ * @pwd: Output passwd structure
+ * @buf: Buffer for string storage
+ * @buflen: Size of buffer
+ * @result: Output pointer to passwd structure
  *
- * Returns a user with username that fills the entire buffer (255 chars +
- * null). Used to test buffer overflow handling.
+ * Returns a user with a 255 character username. Used to test buffer
+ * overflow handling.
  *
- * Return: Pointer to static passwd structure with max-length username
+ * Return: 0 on success
  */
-static struct passwd *mock_getpwuid_longname(uid_t uid) {
+static int mock_getpwuid_r_longname(uid_t uid, struct passwd *pwd, char *buf,
+                                    size_t buflen, struct passwd **result) {
   (void)uid;
 
   /* Create a username that's too long to fit in most buffers */
-  memset(mock_pw_name_storage, 'a', sizeof(mock_pw_name_storage) - 1);
-  mock_pw_name_storage[sizeof(mock_pw_name_storage) - 1] = '\0';
-
-  mock_pwd_storage.pw_name = mock_pw_name_storage;
-  mock_pwd_storage.pw_uid = TEST_UID_STANDARD;
-  mock_pwd_storage.pw_gid = TEST_GID_STANDARD;
+  char longname[MOCK_USERNAME_BUFFER_SIZE];
+  memset(longname, 'a', sizeof(longname) - 1);
+  longname[sizeof(longname) - 1] = '\0';
 
-  return &mock_pwd_storage;
+  return fill_mock_user(pwd, buf, buflen, longname, TEST_UID_STANDARD,
+                        TEST_GID_STANDARD, result);
 }
 
 /**
- * mock_getpwuid_null_pwname - Mock getpwuid with NULL pw_name (malformed)
+ * mock_getpwuid_r_null_pwname - Mock getpwuid_r with NULL pw_name
  * @uid: User ID to look up (ignored)
+ * @pwd: Output passwd structure
+ * @buf: Buffer for string storage (ignored)
+ * @buflen: Size of buffer (ignored)
+ * @result: Output pointer to passwd structure
  *
  * Simulates corrupted password database or NSS module bug that returns
  * a passwd struct but with NULL pw_name field. This tests defensive handling
@@ -172,17 +202,22 @@ static struct passwd *mock_getpwuid_longname(uid_t uid) {
  * Critical for long-lived systems where data corruption or NSS bugs may
  * occur. Code must handle gracefully rather than dereferencing NULL.
  *
- * Return: Pointer to passwd structure with NULL pw_name
+ * Return: 0 (success) with pwd->pw_name = NULL
  */
-static struct passwd *mock_getpwuid_null_pwname(uid_t uid) {
+static int mock_getpwuid_r_null_pwname(uid_t uid, struct passwd *pwd,
+                                       char *buf, size_t buflen,
+                                       struct passwd **result) {
   (void)uid;
+  (void)buf;
+  (void)buflen;
 
   /* Set valid UID but NULL pw_name to simulate corruption */
-  mock_pwd_storage.pw_name = NULL;
-  mock_pwd_storage.pw_uid = TEST_UID_STANDARD;
-  mock_pwd_storage.pw_gid = TEST_GID_STANDARD;
+  pwd->pw_name = NULL;
+  pwd->pw_uid = TEST_UID_STANDARD;
+  pwd->pw_gid = TEST_GID_STANDARD;
 
-  return &mock_pwd_storage;
+  *result = pwd;
+  return 0;
 }
 
 /* ============================================================================
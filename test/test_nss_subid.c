@@ -0,0 +1,205 @@
+/**
+ * test_nss_subid.c - Tests for the calculated subid provider lookups
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <pwd.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test_framework.h"
+#include "test_helpers/all.h"
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================
+ */
+
+/**
+ * make_nss_ops - Ops resolving every name to testuser (UID 1000)
+ */
+static struct syscall_ops make_nss_ops(void) {
+  struct syscall_ops ops = syscall_ops_default;
+  ops.getpwnam_r = mock_getpwnam_r_success;
+  ops.getpwuid_r = mock_getpwuid_r_testuser;
+  return ops;
+}
+
+/* ============================================================================
+ * Tests
+ * ============================================================================
+ */
+
+TEST(nss_subid_null_params) {
+  struct syscall_ops ops = make_nss_ops();
+  config_t config = {0};
+  subid_range_t range = {0};
+  size_t found = 0;
+  bool result = false;
+  uint32_t *uids = NULL;
+
+  config_factory(&config);
+  TEST_ASSERT_EQ(nss_subid_range(NULL, &config, "testuser", false, &range,
+                                 &found),
+                 -1, "Should reject NULL ops");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(nss_subid_has_range(&ops, &config, "testuser", 0, 1, false,
+                                     NULL),
+                 -1, "Should reject NULL result");
+  TEST_ASSERT_EQ(nss_subid_owners(&ops, NULL, 0, false, &uids, &found), -1,
+                 "Should reject NULL config");
+  TEST_ASSERT_EQ(result, false, "Should leave result alone");
+}
+
+TEST(nss_subid_range_by_name) {
+  struct syscall_ops ops = make_nss_ops();
+  config_t config = {0};
+  subid_range_t range = {0};
+  size_t found = 0;
+
+  config_factory(&config);
+  config.subgid.count_val = 1000;
+  TEST_ASSERT_EQ(nss_subid_range(&ops, &config, "testuser", false, &range,
+                                 &found),
+                 0, "Should calculate the range");
+  TEST_ASSERT_EQ(found, 1, "testuser is eligible");
+  TEST_ASSERT_EQ(range.start, 100000, "Should start at SUB_UID_MIN");
+  TEST_ASSERT_EQ(range.count, 65536, "Should use SUB_UID_COUNT");
+
+  TEST_ASSERT_EQ(nss_subid_range(&ops, &config, "testuser", true, &range,
+                                 &found),
+                 0, "Should calculate the GID range");
+  TEST_ASSERT_EQ(range.count, 1000, "Should use SUB_GID_COUNT");
+}
+
+TEST(nss_subid_range_not_eligible) {
+  struct syscall_ops ops = make_nss_ops();
+  config_t config = {0};
+  subid_range_t range = {0};
+  size_t found = 1;
+
+  config_factory(&config);
+  ops.getpwuid_r = mock_getpwuid_r_root;
+  TEST_ASSERT_EQ(nss_subid_range(&ops, &config, "0", false, &range, &found),
+                 0, "An existing user outside the UID range is no error");
+  TEST_ASSERT_EQ(found, 0, "root has no range");
+}
+
+TEST(nss_subid_range_unknown_user) {
+  struct syscall_ops ops = make_nss_ops();
+  config_t config = {0};
+  subid_range_t range = {0};
+  size_t found = 1;
+
+  config_factory(&config);
+  ops.getpwnam_r = mock_getpwnam_r_not_found;
+  TEST_ASSERT_EQ(nss_subid_range(&ops, &config, "ghost", false, &range,
+                                 &found),
+                 -1, "Should fail for an unknown user");
+  TEST_ASSERT_EQ(errno, ENOENT, "Should report the user as unknown");
+  TEST_ASSERT_EQ(found, 0, "Should find nothing");
+}
+
+TEST(nss_subid_has_range_bounds) {
+  struct syscall_ops ops = make_nss_ops();
+  config_t config = {0};
+  bool result = false;
+
+  config_factory(&config);
+  TEST_ASSERT_EQ(nss_subid_has_range(&ops, &config, "testuser", 100000, 65536,
+                                     false, &result),
+                 0, "Should answer");
+  TEST_ASSERT_EQ(result, true, "The whole range is allowed");
+
+  TEST_ASSERT_EQ(nss_subid_has_range(&ops, &config, "testuser", 165535, 1,
+                                     false, &result),
+                 0, "Should answer");
+  TEST_ASSERT_EQ(result, true, "The last ID is allowed");
+
+  TEST_ASSERT_EQ(nss_subid_has_range(&ops, &config, "testuser", 165535, 2,
+                                     false, &result),
+                 0, "Should answer");
+  TEST_ASSERT_EQ(result, false, "Running past the end is not allowed");
+
+  TEST_ASSERT_EQ(nss_subid_has_range(&ops, &config, "testuser", 99999, 2,
+                                     false, &result),
+                 0, "Should answer");
+  TEST_ASSERT_EQ(result, false, "Starting before the range is not allowed");
+
+  TEST_ASSERT_EQ(nss_subid_has_range(&ops, &config, "testuser", 100000,
+                                     UINT64_MAX, false, &result),
+                 0, "Should answer");
+  TEST_ASSERT_EQ(result, false, "A huge count must not wrap around");
+}
+
+TEST(nss_subid_owners_strict) {
+  struct syscall_ops ops = make_nss_ops();
+  config_t config = {0};
+  uint32_t *uids = NULL;
+  size_t found = 0;
+
+  config_factory(&config);
+  TEST_ASSERT_EQ(nss_subid_owners(&ops, &config, 165540, false, &uids,
+                                  &found),
+                 0, "Should answer");
+  TEST_ASSERT_EQ(found, 1, "Strict ranges have one owner");
+  TEST_ASSERT_NOT_EQ(uids, NULL, "Should return the list");
+  TEST_ASSERT_EQ(uids[0], 1001, "Should find UID 1001");
+  free(uids);
+
+  TEST_ASSERT_EQ(nss_subid_owners(&ops, &config, 5, false, &uids, &found), 0,
+                 "Should answer");
+  TEST_ASSERT_EQ(found, 0, "IDs below SUB_UID_MIN have no owner");
+  TEST_ASSERT_EQ(uids, NULL, "Should return no list");
+
+  TEST_ASSERT_EQ(nss_subid_owners(&ops, &config, (uint64_t)UINT32_MAX + 1,
+                                  false, &uids, &found),
+                 0, "Should answer");
+  TEST_ASSERT_EQ(found, 0, "IDs beyond 32 bits have no owner");
+}
+
+TEST(nss_subid_owners_wrap_uncut) {
+  struct syscall_ops ops = make_nss_ops();
+  config_t config = {0};
+  uint32_t *uids = NULL;
+  size_t found = 0;
+
+  config_factory(&config);
+  config.allow_subid_wrap = true;
+  config.subuid.min_val = 100000;
+  config.subuid.max_val = 100999;
+  config.subuid.count_val = 100;
+
+  TEST_ASSERT_EQ(nss_subid_owners(&ops, &config, 100005, false, &uids,
+                                  &found),
+                 0, "Should answer");
+  TEST_ASSERT_EQ(found, (60000 - 1000) / 10 + 1,
+                 "Every tenth UID wraps onto the ID");
+  TEST_ASSERT_NOT_EQ(uids, NULL, "Should return the list");
+  TEST_ASSERT_EQ(uids[0], 1000, "Should start with UID_MIN");
+  TEST_ASSERT_EQ(uids[found - 1], 60000, "Should end with UID_MAX");
+  free(uids);
+}
+
+int main(int argc, char **argv) {
+  TEST_INIT(10, false, false); /* timeout, verbose, duration */
+
+  RUN_TEST(nss_subid_null_params);
+  RUN_TEST(nss_subid_range_by_name);
+  RUN_TEST(nss_subid_range_not_eligible);
+  RUN_TEST(nss_subid_range_unknown_user);
+  RUN_TEST(nss_subid_has_range_bounds);
+  RUN_TEST(nss_subid_owners_strict);
+  RUN_TEST(nss_subid_owners_wrap_uncut);
+
+  return TEST_EXECUTE();
+}
@@ -0,0 +1,230 @@
+/**
+ * test_owner.c - Tests for the subordinate ID reverse lookup
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <pwd.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test_framework.h"
+#include "test_helpers/all.h"
+
+/* ============================================================================
+ * Mock Passwd
+ * ============================================================================
+ */
+
+/* Calls to mock_getpwuid_r_counted, to check the name cache */
+static int mock_getpwuid_calls = 0;
+
+/**
+ * mock_getpwuid_r_counted - Name UIDs 1000 and 1001, nothing else
+ */
+static int mock_getpwuid_r_counted(uid_t uid, struct passwd *pwd, char *buf,
+                                   size_t buflen, struct passwd **result) {
+  mock_getpwuid_calls++;
+  *result = NULL;
+  if (uid != 1000 && uid != 1001) {
+    return 0;
+  }
+
+  (void)snprintf(buf, buflen, "%s", uid == 1000 ? "alice" : "bob");
+  *pwd = (struct passwd){.pw_name = buf, .pw_uid = uid};
+  *result = pwd;
+  return 0;
+}
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================
+ */
+
+/* SUB_UID_BANDS entry run_owner() configures, none while count is 0 */
+static subid_band_t owner_band = {0};
+
+/**
+ * run_owner - Run owner_run() on @input, capturing the output
+ * @owner_of: Value of --owner-of
+ * @input: Text served as the input stream
+ * @ret: Set to the owner_run() result
+ *
+ * Return: Output text (caller frees), NULL if a stream could not be set up
+ */
+static char *run_owner(const char *owner_of, const char *input, int *ret) {
+  struct syscall_ops ops = syscall_ops_default;
+  config_t config = {0};
+  options_t opts = {.do_subuid = true, .owner_of = owner_of};
+  char *output = NULL;
+  size_t size = 0;
+
+  config_factory(&config);
+  if (owner_band.count != 0) {
+    config.subuid.bands[0] = owner_band;
+    config.subuid.band_count = 1;
+    subid_segments_build(&config.subuid, config.uid_min);
+  }
+  ops.getpwuid_r = mock_getpwuid_r_counted;
+  mock_getpwuid_calls = 0;
+
+  FILE *in = fmemopen((void *)(uintptr_t)input, strlen(input), "r");
+  if (in == NULL) {
+    return NULL;
+  }
+  FILE *out = open_memstream(&output, &size);
+  if (out == NULL) {
+    (void)fclose(in);
+    return NULL;
+  }
+
+  *ret = owner_run(&ops, &config, &opts, in, out);
+  (void)fclose(out);
+  (void)fclose(in);
+  return output;
+}
+
+/* ============================================================================
+ * Tests
+ * ============================================================================
+ */
+
+TEST(owner_run_null_params) {
+  config_t config = {0};
+  options_t opts = {.do_subuid = true};
+
+  config_factory(&config);
+  TEST_ASSERT_EQ(owner_run(NULL, &config, &opts, stdin, stdout), -1,
+                 "Should reject NULL ops");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(owner_run(&syscall_ops_default, &config, &opts, stdin,
+                           stdout),
+                 -1, "Should reject a missing --owner-of");
+}
+
+TEST(owner_run_single_id) {
+  int ret = -1;
+  char *output = run_owner("165540", "", &ret);
+
+  TEST_ASSERT_NOT_EQ(output, NULL, "Should run");
+  TEST_ASSERT_EQ(ret, 0, "The ID has an owner");
+  TEST_ASSERT_STR_EQ(output, "165540\t1001\tbob\n",
+                     "Should print the ID, UID and name");
+  free(output);
+}
+
+TEST(owner_run_unowned) {
+  int ret = -1;
+  char *output = run_owner("5", "", &ret);
+
+  TEST_ASSERT_NOT_EQ(output, NULL, "Should run");
+  TEST_ASSERT_EQ(ret, 1, "The ID has no owner");
+  TEST_ASSERT_STR_EQ(output, "5\t-\t-\n", "Should print placeholders");
+  free(output);
+
+  output = run_owner("231072", "", &ret);
+  TEST_ASSERT_EQ(ret, 0, "The ID is calculated for UID 1002");
+  TEST_ASSERT_STR_EQ(output, "231072\t1002\t-\n",
+                     "A UID without an account has no name");
+  free(output);
+}
+
+TEST(owner_run_invalid_id) {
+  int ret = 0;
+  char *output = run_owner("12ab", "", &ret);
+
+  TEST_ASSERT_EQ(ret, -1, "Should reject a non-numeric ID");
+  TEST_ASSERT_STR_EQ(output, "", "Should print nothing");
+  free(output);
+}
+
+TEST(owner_run_stream_caches_names) {
+  int ret = -1;
+  char *output =
+      run_owner("-",
+                "100000\n100001\n# comment\n\n165536\n100002\n"
+                "231072\n231073\nnope\n170000\n",
+                &ret);
+
+  TEST_ASSERT_NOT_EQ(output, NULL, "Should run");
+  TEST_ASSERT_EQ(ret, -1, "A bad entry should fail the run");
+  TEST_ASSERT_STR_EQ(output,
+                     "100000\t1000\talice\n"
+                     "100001\t1000\talice\n"
+                     "165536\t1001\tbob\n"
+                     "100002\t1000\talice\n"
+                     "231072\t1002\t-\n"
+                     "231073\t1002\t-\n"
+                     "170000\t1001\tbob\n",
+                     "Should print one line per ID and skip the bad one");
+  TEST_ASSERT_EQ(mock_getpwuid_calls, 3,
+                 "Should ask NSS once per UID, missing accounts included");
+  free(output);
+}
+
+TEST(owner_run_stream_many_uids) {
+  size_t size = 4096 * 16;
+  char *input = calloc(size, 1);
+  size_t len = 0;
+  int ret = -1;
+
+  TEST_ASSERT_NOT_EQ(input, NULL, "Should allocate the input");
+
+  /* Enough distinct UIDs to grow the cache a few times, each seen twice */
+  for (uint32_t round = 0; round < 2; round++) {
+    for (uint32_t i = 0; i < 1000; i++) {
+      len += (size_t)snprintf(input + len, size - len, "%u\n",
+                              100000 + i * 65536);
+    }
+  }
+
+  char *output = run_owner("-", input, &ret);
+  TEST_ASSERT_NOT_EQ(output, NULL, "Should run");
+  TEST_ASSERT_EQ(ret, 0, "Every ID has an owner");
+  TEST_ASSERT_EQ(mock_getpwuid_calls, 1000, "Should look up each UID once");
+  TEST_ASSERT_NOT_EQ(strstr(output, "100000\t1000\talice\n"), NULL,
+                     "Should keep names across growth");
+  free(output);
+  free(input);
+}
+
+TEST(owner_run_bands) {
+  int ret = -1;
+
+  /* UID 1000 gets 1000000 IDs, 100000-1099999, and pushes 1001 along */
+  owner_band = (subid_band_t){.uid_lo = 1000, .uid_hi = 1000, .count = 1000000};
+  char *output = run_owner("-", "165540\n1099999\n1100000\n1165536\n", &ret);
+  owner_band = (subid_band_t){0};
+
+  TEST_ASSERT_NOT_EQ(output, NULL, "Should run");
+  TEST_ASSERT_EQ(ret, 0, "Every ID has an owner");
+  TEST_ASSERT_STR_EQ(output,
+                     "165540\t1000\talice\n"
+                     "1099999\t1000\talice\n"
+                     "1100000\t1001\tbob\n"
+                     "1165536\t1002\t-\n",
+                     "Should invert the banded layout");
+  free(output);
+}
+
+int main(int argc, char **argv) {
+  TEST_INIT(10, false, false); /* timeout, verbose, duration */
+
+  RUN_TEST(owner_run_null_params);
+  RUN_TEST(owner_run_single_id);
+  RUN_TEST(owner_run_unowned);
+  RUN_TEST(owner_run_invalid_id);
+  RUN_TEST(owner_run_stream_caches_names);
+  RUN_TEST(owner_run_stream_many_uids);
+  RUN_TEST(owner_run_bands);
+
+  return TEST_EXECUTE();
+}
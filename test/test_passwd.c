@@ -0,0 +1,360 @@
+/**
+ * test_passwd.c - Tests for passwd lookups with a deadline
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <pwd.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "test_framework.h"
+#include "test_helpers/all.h"
+
+/* Deadline used by the timed tests, in milliseconds */
+#define TEST_TIMEOUT_MS 20
+
+/* How long the stalled mock keeps the helper busy, in milliseconds */
+#define TEST_STALL_MS 300
+
+/* Deadline of the lookups that fill every helper slot, in milliseconds */
+#define TEST_SHORT_TIMEOUT_MS 1
+
+/* How long to wait for released helpers to finish, in milliseconds */
+#define TEST_DRAIN_MS 5000
+
+/* ============================================================================
+ * Mock passwd Database
+ * ============================================================================
+ */
+
+/**
+ * mock_getpwuid_r_erange - Demand a buffer of at least 64 KiB
+ */
+static int mock_getpwuid_r_erange(uid_t uid, struct passwd *pwd, char *buf,
+                                  size_t buflen, struct passwd **result) {
+  if (buflen < 64 * 1024) {
+    *result = NULL;
+    return ERANGE;
+  }
+  return mock_getpwuid_r_testuser(uid, pwd, buf, buflen, result);
+}
+
+/**
+ * mock_getpwuid_r_erange_always - No buffer is ever big enough
+ */
+static int mock_getpwuid_r_erange_always(uid_t uid, struct passwd *pwd,
+                                         char *buf, size_t buflen,
+                                         struct passwd **result) {
+  (void)uid;
+  (void)pwd;
+  (void)buf;
+  (void)buflen;
+  *result = NULL;
+  return ERANGE;
+}
+
+/**
+ * mock_getpwnam_r_stalled - A backend that answers long after the deadline
+ */
+static int mock_getpwnam_r_stalled(const char *name, struct passwd *pwd,
+                                   char *buf, size_t buflen,
+                                   struct passwd **result) {
+  struct timespec stall = {.tv_nsec = TEST_STALL_MS * 1000000L};
+  (void)nanosleep(&stall, NULL);
+  return mock_getpwnam_r_success(name, pwd, buf, buflen, result);
+}
+
+/* Holds mock_getpwnam_r_gated() lookups while set */
+static atomic_bool gate_closed = false;
+
+/* Lookups that reached mock_getpwnam_r_gated() */
+static atomic_int gated_calls = 0;
+
+/**
+ * mock_getpwnam_r_gated - A backend that hangs until gate_closed is cleared
+ */
+static int mock_getpwnam_r_gated(const char *name, struct passwd *pwd,
+                                 char *buf, size_t buflen,
+                                 struct passwd **result) {
+  struct timespec pause = {.tv_nsec = 1000000L};
+  (void)atomic_fetch_add(&gated_calls, 1);
+  while (atomic_load(&gate_closed)) {
+    (void)nanosleep(&pause, NULL);
+  }
+  return mock_getpwnam_r_success(name, pwd, buf, buflen, result);
+}
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================
+ */
+
+/**
+ * elapsed_ms - Milliseconds since @start
+ */
+static long elapsed_ms(const struct timespec *start) {
+  struct timespec now = {0};
+  (void)timespec_get(&now, TIME_UTC);
+  return (now.tv_sec - start->tv_sec) * 1000L +
+         (now.tv_nsec - start->tv_nsec) / 1000000L;
+}
+
+/* ============================================================================
+ * Tests
+ * ============================================================================
+ */
+
+TEST(passwd_lookup_null_params) {
+  struct syscall_ops ops = syscall_ops_default;
+  passwd_buf_t scratch = {0};
+  uint32_t uid = 0;
+  const char *name = NULL;
+
+  TEST_ASSERT_EQ(passwd_lookup(NULL, "testuser", 0, 0, &scratch, &uid, &name),
+                 -1, "Should reject NULL ops");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(passwd_lookup(&ops, "testuser", 0, 0, NULL, &uid, &name), -1,
+                 "Should reject NULL scratch");
+  TEST_ASSERT_EQ(passwd_lookup(&ops, "testuser", 0, 0, &scratch, NULL, &name),
+                 -1, "Should reject NULL uid_out");
+  TEST_ASSERT_EQ(passwd_lookup(&ops, "testuser", 0, 0, &scratch, &uid, NULL),
+                 -1, "Should reject NULL name_out");
+
+  passwd_buf_free(&ops, NULL);
+  passwd_buf_free(NULL, &scratch);
+}
+
+TEST(passwd_lookup_by_name) {
+  struct syscall_ops ops = syscall_ops_default;
+  passwd_buf_t scratch = {0};
+  uint32_t uid = 0;
+  const char *name = NULL;
+
+  ops.getpwnam_r = mock_getpwnam_r_success;
+  TEST_ASSERT_EQ(passwd_lookup(&ops, "testuser", 0, 0, &scratch, &uid, &name),
+                 0, "Should find the user");
+  TEST_ASSERT_EQ(uid, TEST_UID_STANDARD, "Should return the UID");
+  TEST_ASSERT_STR_EQ(name, "testuser", "Should return the name");
+  TEST_ASSERT_NOT_EQ(scratch.buf, NULL, "Should keep the buffer for reuse");
+
+  passwd_buf_free(&ops, &scratch);
+  TEST_ASSERT_EQ(scratch.buf, NULL, "Should zero the buffer");
+  TEST_ASSERT_EQ(scratch.size, 0, "Should zero the size");
+}
+
+TEST(passwd_lookup_by_uid) {
+  struct syscall_ops ops = syscall_ops_default;
+  passwd_buf_t scratch = {0};
+  uint32_t uid = 0;
+  const char *name = NULL;
+
+  ops.getpwuid_r = mock_getpwuid_r_root;
+  TEST_ASSERT_EQ(passwd_lookup(&ops, NULL, 0, 0, &scratch, &uid, &name), 0,
+                 "Should find the UID");
+  TEST_ASSERT_EQ(uid, TEST_UID_ROOT, "Should return the UID");
+  TEST_ASSERT_STR_EQ(name, "root", "Should return the name");
+
+  passwd_buf_free(&ops, &scratch);
+}
+
+TEST(passwd_lookup_not_found) {
+  struct syscall_ops ops = syscall_ops_default;
+  passwd_buf_t scratch = {0};
+  uint32_t uid = 0;
+  const char *name = NULL;
+
+  ops.getpwnam_r = mock_getpwnam_r_not_found;
+  ops.getpwuid_r = mock_getpwuid_r_null;
+  TEST_ASSERT_EQ(passwd_lookup(&ops, "ghost", 0, 0, &scratch, &uid, &name), -1,
+                 "Unknown name is an error");
+  TEST_ASSERT_EQ(errno, ENOENT, "Should set the correct error code");
+  TEST_ASSERT_EQ(passwd_lookup(&ops, NULL, 4242, 0, &scratch, &uid, &name),
+                 -1, "Unknown UID is an error");
+  TEST_ASSERT_EQ(errno, ENOENT, "Should set the correct error code");
+  TEST_ASSERT_EQ(name, NULL, "Should not return a name");
+
+  passwd_buf_free(&ops, &scratch);
+}
+
+TEST(passwd_lookup_null_pwname) {
+  struct syscall_ops ops = syscall_ops_default;
+  passwd_buf_t scratch = {0};
+  uint32_t uid = 0;
+  const char *name = NULL;
+
+  ops.getpwuid_r = mock_getpwuid_r_null_pwname;
+  TEST_ASSERT_EQ(passwd_lookup(&ops, NULL, 1000, 0, &scratch, &uid, &name),
+                 -1, "Should reject an entry without a name");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+
+  passwd_buf_free(&ops, &scratch);
+}
+
+TEST(passwd_lookup_grows_buffer) {
+  struct syscall_ops ops = syscall_ops_default;
+  passwd_buf_t scratch = {0};
+  uint32_t uid = 0;
+  const char *name = NULL;
+
+  ops.getpwuid_r = mock_getpwuid_r_erange;
+  TEST_ASSERT_EQ(passwd_lookup(&ops, NULL, 1000, 0, &scratch, &uid, &name), 0,
+                 "ERANGE should grow the buffer");
+  TEST_ASSERT_STR_EQ(name, "testuser", "Should return the name");
+  TEST_ASSERT_EQ(scratch.size >= 64 * 1024, true,
+                 "Should keep the grown buffer");
+
+  passwd_buf_free(&ops, &scratch);
+}
+
+TEST(passwd_lookup_erange_gives_up) {
+  struct syscall_ops ops = syscall_ops_default;
+  passwd_buf_t scratch = {0};
+  uint32_t uid = 0;
+  const char *name = NULL;
+
+  ops.getpwuid_r = mock_getpwuid_r_erange_always;
+  TEST_ASSERT_EQ(passwd_lookup(&ops, NULL, 1000, 0, &scratch, &uid, &name),
+                 -1, "Should stop growing eventually");
+  TEST_ASSERT_EQ(errno, ERANGE, "Should report ERANGE");
+
+  passwd_buf_free(&ops, &scratch);
+}
+
+TEST(passwd_lookup_calloc_fails) {
+  struct syscall_ops ops = syscall_ops_default;
+  passwd_buf_t scratch = {0};
+  uint32_t uid = 0;
+  const char *name = NULL;
+
+  ops.getpwnam_r = mock_getpwnam_r_success;
+  ops.calloc = mock_calloc_null;
+  TEST_ASSERT_EQ(passwd_lookup(&ops, "testuser", 0, 0, &scratch, &uid, &name),
+                 -1, "Should fail without a buffer");
+  TEST_ASSERT_EQ(errno, ENOMEM, "Should set the correct error code");
+  TEST_ASSERT_EQ(passwd_lookup(&ops, "testuser", 0, TEST_TIMEOUT_MS, &scratch,
+                               &uid, &name),
+                 -1, "Should fail without a job");
+  TEST_ASSERT_EQ(errno, ENOMEM, "Should set the correct error code");
+}
+
+TEST(passwd_lookup_timed_success) {
+  struct syscall_ops ops = syscall_ops_default;
+  passwd_buf_t scratch = {0};
+  uint32_t uid = 0;
+  const char *name = NULL;
+
+  ops.getpwnam_r = mock_getpwnam_r_success;
+  ops.getpwuid_r = mock_getpwuid_r_root;
+  TEST_ASSERT_EQ(passwd_lookup(&ops, "testuser", 0, 1000, &scratch, &uid,
+                               &name),
+                 0, "A prompt answer meets the deadline");
+  TEST_ASSERT_EQ(uid, TEST_UID_STANDARD, "Should return the UID");
+  TEST_ASSERT_STR_EQ(name, "testuser", "Should copy the name back");
+  TEST_ASSERT_EQ(passwd_lookup(&ops, NULL, 0, 1000, &scratch, &uid, &name), 0,
+                 "Should reuse the buffer");
+  TEST_ASSERT_STR_EQ(name, "root", "Should copy the name back");
+
+  passwd_buf_free(&ops, &scratch);
+}
+
+TEST(passwd_lookup_timed_error) {
+  struct syscall_ops ops = syscall_ops_default;
+  passwd_buf_t scratch = {0};
+  uint32_t uid = 0;
+  const char *name = NULL;
+
+  ops.getpwnam_r = mock_getpwnam_r_error;
+  TEST_ASSERT_EQ(passwd_lookup(&ops, "testuser", 0, 1000, &scratch, &uid,
+                               &name),
+                 -1, "Should pass the helper's failure on");
+  TEST_ASSERT_EQ(errno, EIO, "Should keep the lookup error");
+
+  passwd_buf_free(&ops, &scratch);
+}
+
+TEST(passwd_lookup_timeout) {
+  struct syscall_ops ops = syscall_ops_default;
+  passwd_buf_t scratch = {0};
+  uint32_t uid = 0;
+  const char *name = NULL;
+  struct timespec start = {0};
+
+  ops.getpwnam_r = mock_getpwnam_r_stalled;
+  (void)timespec_get(&start, TIME_UTC);
+  TEST_ASSERT_EQ(passwd_lookup(&ops, "testuser", 0, TEST_TIMEOUT_MS, &scratch,
+                               &uid, &name),
+                 -1, "A stalled backend misses the deadline");
+  TEST_ASSERT_EQ(errno, ETIMEDOUT, "Should set the correct error code");
+  TEST_ASSERT_EQ(elapsed_ms(&start) < TEST_STALL_MS, true,
+                 "Should not wait for the stalled lookup");
+  TEST_ASSERT_EQ(name, NULL, "Should not return a name");
+
+  passwd_buf_free(&ops, &scratch);
+}
+
+TEST(passwd_lookup_helpers_capped) {
+  struct syscall_ops ops = syscall_ops_default;
+  passwd_buf_t scratch = {0};
+  uint32_t uid = 0;
+  const char *name = NULL;
+  struct timespec start = {0};
+  int timed_out = 0;
+
+  /* One lookup more than there are helper slots, all stuck in NSS */
+  atomic_store(&gate_closed, true);
+  atomic_store(&gated_calls, 0);
+  ops.getpwnam_r = mock_getpwnam_r_gated;
+  for (int i = 0; i <= PASSWD_HELPERS_MAX; i++) {
+    if (passwd_lookup(&ops, "testuser", 0, TEST_SHORT_TIMEOUT_MS, &scratch,
+                      &uid, &name) == -1 &&
+        errno == ETIMEDOUT) {
+      timed_out++;
+    }
+  }
+  TEST_ASSERT_EQ(timed_out, PASSWD_HELPERS_MAX + 1,
+                 "Every lookup should time out");
+
+  atomic_store(&gate_closed, false);
+  ops.getpwnam_r = mock_getpwnam_r_success;
+  (void)timespec_get(&start, TIME_UTC);
+  int ret = -1;
+  while (ret != 0 && elapsed_ms(&start) < TEST_DRAIN_MS) {
+    ret = passwd_lookup(&ops, "testuser", 0, TEST_TIMEOUT_MS, &scratch, &uid,
+                        &name);
+  }
+  TEST_ASSERT_EQ(ret, 0, "Released helpers should free their slots");
+  TEST_ASSERT_EQ(atomic_load(&gated_calls) <= PASSWD_HELPERS_MAX, true,
+                 "No helper should start once every slot is taken");
+
+  passwd_buf_free(&ops, &scratch);
+}
+
+int main(int argc, char **argv) {
+  TEST_INIT(10, false, false); /* timeout, verbose, duration */
+
+  RUN_TEST(passwd_lookup_null_params);
+  RUN_TEST(passwd_lookup_by_name);
+  RUN_TEST(passwd_lookup_by_uid);
+  RUN_TEST(passwd_lookup_not_found);
+  RUN_TEST(passwd_lookup_null_pwname);
+  RUN_TEST(passwd_lookup_grows_buffer);
+  RUN_TEST(passwd_lookup_erange_gives_up);
+  RUN_TEST(passwd_lookup_calloc_fails);
+  RUN_TEST(passwd_lookup_timed_success);
+  RUN_TEST(passwd_lookup_timed_error);
+  RUN_TEST(passwd_lookup_timeout);
+  RUN_TEST(passwd_lookup_helpers_capped);
+
+  return TEST_EXECUTE();
+}
@@ -11,6 +11,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "test_framework.h"
 
@@ -463,6 +464,505 @@ TEST(calc_subid_range_single_id_range) {
   TEST_ASSERT_EQ(errno, ERANGE, "Should set the correct error code");
 }
 
+/* ============================================================================
+ * Tests - Reverse Lookup
+ * ============================================================================
+ */
+
+TEST(calc_subid_owner_null_params) {
+  config_t config = {0};
+  size_t found = 0;
+  uint32_t uid = 0;
+
+  config_factory(&config);
+  TEST_ASSERT_EQ(calc_subid_owner(DEFAULT_MIN_VAL, TEST_UID_MIN, 60000, NULL,
+                                  false, &uid, 1, &found),
+                 -1, "Should reject NULL config");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(calc_subid_owner(DEFAULT_MIN_VAL, TEST_UID_MIN, 60000,
+                                  &config.subuid, false, &uid, 1, NULL),
+                 -1, "Should reject NULL found");
+}
+
+TEST(calc_subid_owner_strict) {
+  config_t config = {0};
+  size_t found = 0;
+  uint32_t uid = 0;
+
+  config_factory(&config);
+
+  TEST_ASSERT_EQ(calc_subid_owner(FIRST_USER_START, TEST_UID_MIN, 60000,
+                                  &config.subuid, false, &uid, 1, &found),
+                 0, "Should invert the first range");
+  TEST_ASSERT_EQ(found, 1, "Should find one owner");
+  TEST_ASSERT_EQ(uid, TEST_UID_FIRST, "Start belongs to the first user");
+
+  TEST_ASSERT_EQ(calc_subid_owner(SECOND_USER_START - 1, TEST_UID_MIN, 60000,
+                                  &config.subuid, false, &uid, 1, &found),
+                 0, "Should invert the last ID of a range");
+  TEST_ASSERT_EQ(uid, TEST_UID_FIRST, "Last ID belongs to the first user");
+
+  TEST_ASSERT_EQ(calc_subid_owner(THIRD_USER_START + 5, TEST_UID_MIN, 60000,
+                                  &config.subuid, false, &uid, 1, &found),
+                 0, "Should invert a later range");
+  TEST_ASSERT_EQ(uid, TEST_UID_THIRD, "ID belongs to the third user");
+
+  /* The same answer calc_subid_range() gives, for an arbitrary UID */
+  uint32_t start = 0;
+  TEST_ASSERT_EQ(calc_subid_range(DETERMINISTIC_UID, TEST_UID_MIN,
+                                  &config.subuid, false, &start),
+                 0, "Should calculate the range");
+  TEST_ASSERT_EQ(calc_subid_owner(start + DEFAULT_COUNT_VAL - 1, TEST_UID_MIN,
+                                  60000, &config.subuid, false, &uid, 1,
+                                  &found),
+                 0, "Should invert the calculated range");
+  TEST_ASSERT_EQ(uid, DETERMINISTIC_UID, "Should round-trip the UID");
+}
+
+TEST(calc_subid_owner_strict_unowned) {
+  config_t config = {0};
+  size_t found = 99;
+  uint32_t uid = 0;
+
+  config_factory(&config);
+
+  TEST_ASSERT_EQ(calc_subid_owner(DEFAULT_MIN_VAL - 1, TEST_UID_MIN, 60000,
+                                  &config.subuid, false, &uid, 1, &found),
+                 0, "Below min_val is not an error");
+  TEST_ASSERT_EQ(found, 0, "Below min_val has no owner");
+
+  TEST_ASSERT_EQ(calc_subid_owner(SECOND_USER_START, TEST_UID_MIN,
+                                  TEST_UID_FIRST, &config.subuid, false, &uid,
+                                  1, &found),
+                 0, "Past uid_max is not an error");
+  TEST_ASSERT_EQ(found, 0, "A UID past uid_max owns nothing");
+
+  /* With max_val 199999 and 10000 per user the tenth range is the last */
+  setup_custom_config(&config, DEFAULT_MIN_VAL, BOUNDARY_TEST_MAX_VAL,
+                      MEDIUM_COUNT);
+  TEST_ASSERT_EQ(calc_subid_owner(BOUNDARY_TEST_MAX_VAL, TEST_UID_MIN, 60000,
+                                  &config.subuid, false, &uid, 1, &found),
+                 0, "Should invert the last ID");
+  TEST_ASSERT_EQ(uid, TEST_UID_TENTH, "Last ID belongs to the tenth user");
+  setup_custom_config(&config, DEFAULT_MIN_VAL, BOUNDARY_TEST_MAX_VAL - 1,
+                      MEDIUM_COUNT);
+  TEST_ASSERT_EQ(calc_subid_owner(BOUNDARY_TEST_MAX_VAL - 1, TEST_UID_MIN,
+                                  60000, &config.subuid, false, &uid, 1,
+                                  &found),
+                 0, "A partial last range is not an error");
+  TEST_ASSERT_EQ(found, 0, "A range that does not fit owns nothing");
+}
+
+TEST(calc_subid_owner_wrap_matches_forward) {
+  config_t config = {0};
+  uint32_t starts[TEST_UID_TENTH - TEST_UID_MIN + 1] = {0};
+  uint32_t uids[8] = {0};
+  size_t found = 0;
+  size_t users = sizeof(starts) / sizeof(starts[0]);
+
+  setup_custom_config(&config, SMALL_RANGE_MIN, SMALL_RANGE_MAX,
+                      SMALL_RANGE_COUNT);
+  for (size_t i = 0; i < users; i++) {
+    TEST_ASSERT_EQ(calc_subid_range(TEST_UID_MIN + (uint32_t)i, TEST_UID_MIN,
+                                    &config.subuid, true, &starts[i]),
+                   0, "Should calculate every range");
+  }
+
+  /* Every ID, including those past max_val, against a brute-force scan */
+  for (uint32_t id = SMALL_RANGE_MIN - 10;
+       id < SMALL_RANGE_MAX + SMALL_RANGE_COUNT + 10; id++) {
+    TEST_ASSERT_EQ(calc_subid_owner(id, TEST_UID_MIN, TEST_UID_TENTH,
+                                    &config.subuid, true, uids, 8, &found),
+                   0, "Should list every candidate");
+
+    size_t expected = 0;
+    for (size_t i = 0; i < users; i++) {
+      if (id >= starts[i] && id - starts[i] < SMALL_RANGE_COUNT) {
+        if (expected >= found || uids[expected] != TEST_UID_MIN + i) {
+          TEST_ASSERT_EQ(uids[expected], TEST_UID_MIN + i,
+                         "Candidates should match the forward formula");
+        }
+        expected++;
+      }
+    }
+    if (expected != found) {
+      TEST_ASSERT_EQ(found, expected, "Should find exactly the owners");
+    }
+  }
+}
+
+TEST(calc_subid_owner_wrap_truncated) {
+  config_t config = {0};
+  uint32_t uids[2] = {0};
+  size_t found = 0;
+
+  setup_custom_config(&config, SMALL_RANGE_MIN, SMALL_RANGE_MAX,
+                      SMALL_RANGE_COUNT);
+
+  /* Offset 2500 is in the ranges of offsets 0, 4 and 7 (see WRAP_USER_*) */
+  TEST_ASSERT_EQ(calc_subid_owner(SMALL_RANGE_MIN + 2500, TEST_UID_MIN,
+                                  TEST_UID_TENTH, &config.subuid, true, uids,
+                                  2, &found),
+                 1, "Should report more candidates than fit");
+  TEST_ASSERT_EQ(found, 2, "Should fill the output");
+  TEST_ASSERT_EQ(uids[0], TEST_UID_FIRST, "First lap belongs to UID 1000");
+  TEST_ASSERT_EQ(uids[1], TEST_UID_MIN + 4, "Second lap belongs to UID 1004");
+}
+
+/* ============================================================================
+ * Tests - Batch Calculation
+ * ============================================================================
+ */
+
+/**
+ * batch_matches_scalar - Compare the batch and scalar results for a band
+ * @uid_first: First UID of the band
+ * @n: Number of UIDs
+ * @range: Subordinate ID range configuration
+ * @allow_wrap: Whether to allow wrap-around allocation
+ *
+ * Return: Number of UIDs whose start differs, or -1 if a call failed
+ */
+static long batch_matches_scalar(uint32_t uid_first, size_t n,
+                                 const subid_config_t *range,
+                                 bool allow_wrap) {
+  uint32_t *starts = calloc(n, sizeof(*starts));
+  long mismatches = 0;
+
+  if (starts == NULL || calc_subid_range_batch(uid_first, n, TEST_UID_MIN,
+                                               range, allow_wrap,
+                                               starts) != 0) {
+    free(starts);
+    return -1;
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    uint32_t start = 0;
+    if (calc_subid_range(uid_first + (uint32_t)i, TEST_UID_MIN, range,
+                         allow_wrap, &start) != 0) {
+      free(starts);
+      return -1;
+    }
+    if (start != starts[i]) {
+      mismatches++;
+    }
+  }
+
+  free(starts);
+  return mismatches;
+}
+
+TEST(calc_subid_range_batch_null_params) {
+  config_t config = {0};
+  uint32_t start = 0;
+
+  config_factory(&config);
+  TEST_ASSERT_EQ(calc_subid_range_batch(TEST_UID_MIN, 1, TEST_UID_MIN, NULL,
+                                        false, &start),
+                 -1, "Should reject NULL config");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(calc_subid_range_batch(TEST_UID_MIN, 1, TEST_UID_MIN,
+                                        &config.subuid, false, NULL),
+                 -1, "Should reject NULL output");
+  TEST_ASSERT_EQ(calc_subid_range_batch(TEST_UID_MIN, 0, TEST_UID_MIN,
+                                        &config.subuid, false, &start),
+                 0, "An empty band is not an error");
+}
+
+TEST(calc_subid_range_batch_strict_matches_scalar) {
+  config_t config = {0};
+
+  /* Every UID the default configuration can serve: 600000000 / 65536 */
+  config_factory(&config);
+  TEST_ASSERT_EQ(batch_matches_scalar(TEST_UID_MIN, 9155, &config.subuid,
+                                      false),
+                 0, "Default band should match the scalar function");
+
+  TEST_ASSERT_EQ(batch_matches_scalar(TEST_UID_MIN, 9156, &config.subuid,
+                                      false),
+                 -1, "One more UID should not fit");
+
+  /* A band that does not start at uid_min, ending on the last fit */
+  setup_custom_config(&config, DEFAULT_MIN_VAL, BOUNDARY_TEST_MAX_VAL,
+                      MEDIUM_COUNT);
+  TEST_ASSERT_EQ(batch_matches_scalar(TEST_UID_THIRD, 8, &config.subuid,
+                                      false),
+                 0, "Offset band should match the scalar function");
+}
+
+TEST(calc_subid_range_batch_wrap_matches_scalar) {
+  config_t config = {0};
+
+  /* Several laps of a small ring */
+  setup_custom_config(&config, SMALL_RANGE_MIN, SMALL_RANGE_MAX,
+                      SMALL_RANGE_COUNT);
+  TEST_ASSERT_EQ(batch_matches_scalar(TEST_UID_MIN, 50000, &config.subuid,
+                                      true),
+                 0, "Wrapped band should match the scalar function");
+  TEST_ASSERT_EQ(batch_matches_scalar(DETERMINISTIC_UID, 1000,
+                                      &config.subuid, true),
+                 0, "Offset wrapped band should match");
+
+  /* count == space: every user gets the whole ring */
+  setup_custom_config(&config, SMALL_RANGE_MIN, SMALL_RANGE_MAX,
+                      SMALL_RANGE_MAX - SMALL_RANGE_MIN + 1);
+  TEST_ASSERT_EQ(batch_matches_scalar(TEST_UID_MIN, 100, &config.subuid,
+                                      true),
+                 0, "A full-ring count should match");
+
+  /* The default space with a large UID band, as in the wrap tests */
+  config_factory(&config);
+  TEST_ASSERT_EQ(batch_matches_scalar(TEST_UID_MIN, LARGE_UID, &config.subuid,
+                                      true),
+                 0, "Default wrapped band should match");
+}
+
+TEST(calc_subid_range_batch_strict_overflow) {
+  config_t config = {0};
+  uint32_t starts[11] = {0};
+
+  /* Ten users fit, the eleventh does not */
+  setup_custom_config(&config, DEFAULT_MIN_VAL, BOUNDARY_TEST_MAX_VAL,
+                      MEDIUM_COUNT);
+  TEST_ASSERT_EQ(calc_subid_range_batch(TEST_UID_MIN, 11, TEST_UID_MIN,
+                                        &config.subuid, false, starts),
+                 -1, "Should reject a band the last UID overflows");
+  TEST_ASSERT_EQ(errno, ERANGE, "Should set the correct error code");
+  TEST_ASSERT_EQ(starts[0], 0, "Should leave the output untouched");
+
+  TEST_ASSERT_EQ(calc_subid_range_batch(TEST_UID_BELOW_MIN, 2, TEST_UID_MIN,
+                                        &config.subuid, false, starts),
+                 -1, "Should reject a band starting below uid_min");
+
+  TEST_ASSERT_EQ(calc_subid_range_batch(UINT32_MAX_VAL, 2, TEST_UID_MIN,
+                                        &config.subuid, true, starts),
+                 -1, "Should reject a band past the UID space");
+  TEST_ASSERT_EQ(errno, ERANGE, "Should set the correct error code");
+}
+
+/* ============================================================================
+ * Tests - Count Bands
+ * ============================================================================
+ */
+
+/**
+ * setup_bands - Give UIDs [@uid_lo, @uid_hi] @count IDs each
+ * @config: Configuration set up by setup_custom_config() or config_factory()
+ * @uid_lo: First UID of the band
+ * @uid_hi: Last UID of the band
+ * @count: IDs per user in the band
+ *
+ * Bands are appended in the order given and the segment table rebuilt,
+ * as load_configuration() does once the bands are checked.
+ */
+static void setup_bands(config_t *config, uint32_t uid_lo, uint32_t uid_hi,
+                        uint32_t count) {
+  config->subuid.bands[config->subuid.band_count++] =
+      (subid_band_t){.uid_lo = uid_lo, .uid_hi = uid_hi, .count = count};
+  subid_segments_build(&config->subuid, TEST_UID_MIN);
+}
+
+/**
+ * owners_match_forward - Check calc_subid_owner() against every range
+ * @config: Configuration with bands
+ * @uid_max: Last UID to consider
+ * @allow_wrap: Whether to allow wrap-around allocation
+ *
+ * Every ID from just below min_val to well past max_val is looked up and
+ * compared with a brute-force scan of the ranges calc_subid_range()
+ * gives UIDs [TEST_UID_MIN, @uid_max].
+ *
+ * Return: Number of IDs whose owners differ, or -1 if a call failed
+ */
+static long owners_match_forward(const config_t *config, uint32_t uid_max,
+                                 bool allow_wrap) {
+  const subid_config_t *range = &config->subuid;
+  size_t users = uid_max - TEST_UID_MIN + 1;
+  uint32_t *starts = calloc(users, sizeof(*starts));
+  bool *fits = calloc(users, sizeof(*fits));
+  uint32_t uids[16] = {0};
+  long mismatches = 0;
+
+  if (starts == NULL || fits == NULL) {
+    free(starts);
+    free(fits);
+    return -1;
+  }
+  for (size_t i = 0; i < users; i++) {
+    fits[i] = calc_subid_range(TEST_UID_MIN + (uint32_t)i, TEST_UID_MIN,
+                               range, allow_wrap, &starts[i]) == 0;
+  }
+
+  for (uint32_t id = range->min_val - 10; id < range->max_val + 10000;
+       id++) {
+    size_t found = 0;
+    if (calc_subid_owner(id, TEST_UID_MIN, uid_max, range, allow_wrap, uids,
+                         16, &found) != 0) {
+      mismatches = -1;
+      break;
+    }
+
+    size_t expected = 0;
+    for (size_t i = 0; i < users; i++) {
+      uint32_t count = calc_subid_count(TEST_UID_MIN + (uint32_t)i, range);
+      if (fits[i] && id >= starts[i] && id - starts[i] < count) {
+        if (expected >= found || uids[expected] != TEST_UID_MIN + i) {
+          mismatches++;
+        }
+        expected++;
+      }
+    }
+    if (expected != found) {
+      mismatches++;
+    }
+  }
+
+  free(starts);
+  free(fits);
+  return mismatches;
+}
+
+TEST(calc_subid_range_bands_layout) {
+  config_t config = {0};
+  subid_config_t *range = &config.subuid;
+
+  /* Two big accounts after five regular ones */
+  config_factory(&config);
+  setup_bands(&config, TEST_UID_MIN + 5, TEST_UID_MIN + 6, 1048576);
+  TEST_ASSERT_EQ(range->segment_count, 3, "Gap, band and tail");
+
+  calc_and_assert(TEST_UID_FIRST, TEST_UID_MIN, range, false, 0,
+                  FIRST_USER_START, "UIDs before the band are unchanged");
+  calc_and_assert(TEST_UID_MIN + 4, TEST_UID_MIN, range, false, 0,
+                  DEFAULT_MIN_VAL + (4 * DEFAULT_COUNT_VAL),
+                  "Last UID before the band is unchanged");
+  calc_and_assert(TEST_UID_MIN + 5, TEST_UID_MIN, range, false, 0,
+                  DEFAULT_MIN_VAL + (5 * DEFAULT_COUNT_VAL),
+                  "Band starts where the gap ends");
+  calc_and_assert(TEST_UID_MIN + 6, TEST_UID_MIN, range, false, 0,
+                  DEFAULT_MIN_VAL + (5 * DEFAULT_COUNT_VAL) + 1048576,
+                  "Band UIDs are a band count apart");
+  calc_and_assert(TEST_UID_MIN + 8, TEST_UID_MIN, range, false, 0,
+                  DEFAULT_MIN_VAL + (6 * DEFAULT_COUNT_VAL) + (2 * 1048576),
+                  "Tail continues past the band");
+
+  TEST_ASSERT_EQ(calc_subid_count(TEST_UID_MIN + 4, range), DEFAULT_COUNT_VAL,
+                 "Gap keeps count_val");
+  TEST_ASSERT_EQ(calc_subid_count(TEST_UID_MIN + 5, range), 1048576,
+                 "Band has its own count");
+  TEST_ASSERT_EQ(calc_subid_count(TEST_UID_MIN + 8, range), DEFAULT_COUNT_VAL,
+                 "Tail keeps count_val");
+  TEST_ASSERT_EQ(calc_subid_count(TEST_UID_MIN, NULL), 0,
+                 "NULL config has no count");
+
+  /* A band at uid_min needs no gap in front of it */
+  config_factory(&config);
+  setup_bands(&config, TEST_UID_MIN, TEST_UID_MIN, SMALL_COUNT);
+  TEST_ASSERT_EQ(range->segment_count, 2, "Band and tail");
+  calc_and_assert(TEST_UID_SECOND, TEST_UID_MIN, range, false, 0,
+                  DEFAULT_MIN_VAL + SMALL_COUNT, "Tail follows the band");
+  calc_and_assert(TEST_UID_BELOW_MIN, TEST_UID_MIN, range, false, -1,
+                  ERROR_SENTINEL, "UIDs below the table are rejected");
+
+  /* Nothing follows a band ending at the last UID */
+  config_factory(&config);
+  setup_bands(&config, TEST_UID_THIRD, UINT32_MAX_VAL, SMALL_COUNT);
+  TEST_ASSERT_EQ(range->segment_count, 2, "Gap and band, no tail");
+
+  /* No bands, no table */
+  range->band_count = 0;
+  subid_segments_build(range, TEST_UID_MIN);
+  TEST_ASSERT_EQ(range->segment_count, 0, "Should clear the table");
+  subid_segments_build(NULL, TEST_UID_MIN);
+}
+
+TEST(calc_subid_range_bands_exceed_max) {
+  config_t config = {0};
+
+  /* 100000-199999 holds ten 10000 ranges, a 50000 band takes five */
+  setup_custom_config(&config, DEFAULT_MIN_VAL, BOUNDARY_TEST_MAX_VAL,
+                      MEDIUM_COUNT);
+  setup_bands(&config, TEST_UID_THIRD, TEST_UID_THIRD, 50000);
+  calc_and_assert(TEST_UID_MIN + 5, TEST_UID_MIN, &config.subuid, false, 0,
+                  BOUNDARY_TEST_MAX_VAL + 1 - MEDIUM_COUNT,
+                  "Last range that fits");
+  calc_and_assert(TEST_UID_MIN + 6, TEST_UID_MIN, &config.subuid, false, -1,
+                  ERROR_SENTINEL, "Band pushes later UIDs out");
+  TEST_ASSERT_EQ(errno, ERANGE, "Should set the correct error code");
+
+  /* Wrap mode folds the same layout onto the ring */
+  calc_and_assert(TEST_UID_MIN + 6, TEST_UID_MIN, &config.subuid, true, 0,
+                  DEFAULT_MIN_VAL, "Wraps to the start of the ring");
+}
+
+TEST(calc_subid_owner_bands) {
+  config_t config = {0};
+
+  setup_custom_config(&config, SMALL_RANGE_MIN, SMALL_RANGE_MAX, 300);
+  setup_bands(&config, TEST_UID_THIRD, TEST_UID_THIRD + 1, 1000);
+  setup_bands(&config, TEST_UID_MIN + 10, TEST_UID_MIN + 10, 2500);
+  TEST_ASSERT_EQ(owners_match_forward(&config, TEST_UID_MIN + 30, false), 0,
+                 "Strict owners should match the forward formula");
+  TEST_ASSERT_EQ(owners_match_forward(&config, TEST_UID_MIN + 30, true), 0,
+                 "Wrapped owners should match the forward formula");
+
+  /* uid_max inside a band */
+  TEST_ASSERT_EQ(owners_match_forward(&config, TEST_UID_THIRD, false), 0,
+                 "Should stop at uid_max inside a band");
+}
+
+TEST(calc_subid_owner_bands_wrap_large) {
+  config_t config = {0};
+  uint32_t uids[16] = {0};
+  size_t found = 0;
+
+  /* A band filling the whole ring laps it once per band user */
+  setup_custom_config(&config, SMALL_RANGE_MIN, SMALL_RANGE_MAX, 300);
+  setup_bands(&config, TEST_UID_THIRD, TEST_UID_THIRD + 1, 10000);
+  TEST_ASSERT_EQ(owners_match_forward(&config, TEST_UID_MIN + 30, true), 0,
+                 "Wrapped owners inside a ring-sized band should match");
+  TEST_ASSERT_EQ(calc_subid_owner(SMALL_RANGE_MIN + 5000, TEST_UID_MIN,
+                                  TEST_UID_MIN + 30, &config.subuid, true,
+                                  uids, 16, &found),
+                 0, "Should invert an ID inside the band");
+  TEST_ASSERT_EQ(found > 0, true, "Should find owners");
+
+  /* A band too large for the ring has no ranges to invert */
+  config.subuid.bands[0].count = 10001;
+  subid_segments_build(&config.subuid, TEST_UID_MIN);
+  TEST_ASSERT_EQ(calc_subid_owner(SMALL_RANGE_MIN + 5000, TEST_UID_MIN,
+                                  TEST_UID_MIN + 30, &config.subuid, true,
+                                  uids, 16, &found),
+                 -1, "Should reject a band larger than the space");
+  TEST_ASSERT_EQ(errno, ERANGE, "Should set the correct error code");
+}
+
+TEST(calc_subid_range_batch_bands) {
+  config_t config = {0};
+  uint32_t starts[25] = {0};
+
+  setup_custom_config(&config, SMALL_RANGE_MIN, SMALL_RANGE_MAX, 300);
+  setup_bands(&config, TEST_UID_THIRD, TEST_UID_THIRD + 1, 1000);
+  setup_bands(&config, TEST_UID_MIN + 10, TEST_UID_MIN + 10, 2500);
+
+  TEST_ASSERT_EQ(batch_matches_scalar(TEST_UID_MIN, 15, &config.subuid,
+                                      false),
+                 0, "Band across segments should match the scalar function");
+  TEST_ASSERT_EQ(batch_matches_scalar(TEST_UID_THIRD + 1, 9, &config.subuid,
+                                      false),
+                 0, "Band starting inside a segment should match");
+  TEST_ASSERT_EQ(batch_matches_scalar(TEST_UID_MIN, 5000, &config.subuid,
+                                      true),
+                 0, "Wrapped band across segments should match");
+
+  /* UID 1010 ends at offset 6900, so ten more 300 ranges fit */
+  TEST_ASSERT_EQ(calc_subid_range_batch(TEST_UID_MIN, 25, TEST_UID_MIN,
+                                        &config.subuid, false, starts),
+                 -1, "Should reject a band the last UID overflows");
+  TEST_ASSERT_EQ(errno, ERANGE, "Should set the correct error code");
+  TEST_ASSERT_EQ(starts[0], 0, "Should leave the output untouched");
+}
+
 /* ============================================================================
  * Test Runner
  * ============================================================================
@@ -502,6 +1002,26 @@ int main(int argc, char **argv) {
   RUN_TEST(calc_subid_range_max_values);
   RUN_TEST(calc_subid_range_single_id_range);
 
+  /* Reverse lookup */
+  RUN_TEST(calc_subid_owner_null_params);
+  RUN_TEST(calc_subid_owner_strict);
+  RUN_TEST(calc_subid_owner_strict_unowned);
+  RUN_TEST(calc_subid_owner_wrap_matches_forward);
+  RUN_TEST(calc_subid_owner_wrap_truncated);
+
+  /* Batch calculation */
+  RUN_TEST(calc_subid_range_batch_null_params);
+  RUN_TEST(calc_subid_range_batch_strict_matches_scalar);
+  RUN_TEST(calc_subid_range_batch_wrap_matches_scalar);
+  RUN_TEST(calc_subid_range_batch_strict_overflow);
+
+  /* Count bands */
+  RUN_TEST(calc_subid_range_bands_layout);
+  RUN_TEST(calc_subid_range_bands_exceed_max);
+  RUN_TEST(calc_subid_owner_bands);
+  RUN_TEST(calc_subid_owner_bands_wrap_large);
+  RUN_TEST(calc_subid_range_batch_bands);
+
   result = TEST_EXECUTE();
   return result;
 }
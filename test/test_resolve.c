@@ -0,0 +1,287 @@
+/**
+ * test_resolve.c - Tests for the parallel batch resolver
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <pwd.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test_framework.h"
+#include "test_helpers/all.h"
+
+/* Username buffer size used by every test */
+#define TEST_USERNAME_SIZE 64
+
+/* Slots resolved by the larger tests */
+#define TEST_SLOTS 100
+
+/* ============================================================================
+ * Mock passwd Database
+ * ============================================================================
+ */
+
+/* Lookups seen by the mocks, from any thread */
+static atomic_int mock_lookups = 0;
+
+/**
+ * mock_getpwnam_r_uid_from_name - Resolve "userN" to UID N
+ *
+ * Anything else is not found. Only touches the caller's storage.
+ */
+static int mock_getpwnam_r_uid_from_name(const char *name, struct passwd *pwd,
+                                         char *buf, size_t buflen,
+                                         struct passwd **result) {
+  atomic_fetch_add(&mock_lookups, 1);
+  *result = NULL;
+
+  uint32_t uid = 0;
+  if (strncmp(name, "user", 4) != 0 ||
+      parse_uint32_strict(name + 4, &uid) != 0) {
+    return 0;
+  }
+
+  (void)snprintf(buf, buflen, "%s", name);
+  pwd->pw_name = buf;
+  pwd->pw_uid = uid;
+  *result = pwd;
+  return 0;
+}
+
+/**
+ * mock_getpwuid_r_name_from_uid - Resolve UID N to "userN"
+ *
+ * UIDs from 9000 upwards are not found.
+ */
+static int mock_getpwuid_r_name_from_uid(uid_t uid, struct passwd *pwd,
+                                         char *buf, size_t buflen,
+                                         struct passwd **result) {
+  atomic_fetch_add(&mock_lookups, 1);
+  *result = NULL;
+  if (uid >= 9000) {
+    return 0;
+  }
+
+  (void)snprintf(buf, buflen, "user%u", (unsigned int)uid);
+  pwd->pw_name = buf;
+  pwd->pw_uid = uid;
+  *result = pwd;
+  return 0;
+}
+
+/**
+ * mock_getpwuid_r_erange - Demand a buffer of at least 64 KiB
+ */
+static int mock_getpwuid_r_erange(uid_t uid, struct passwd *pwd, char *buf,
+                                  size_t buflen, struct passwd **result) {
+  if (buflen < 64 * 1024) {
+    *result = NULL;
+    return ERANGE;
+  }
+  return mock_getpwuid_r_name_from_uid(uid, pwd, buf, buflen, result);
+}
+
+/**
+ * mock_getpwuid_r_eio - Every lookup fails with EIO
+ */
+static int mock_getpwuid_r_eio(uid_t uid, struct passwd *pwd, char *buf,
+                               size_t buflen, struct passwd **result) {
+  (void)uid;
+  (void)pwd;
+  (void)buf;
+  (void)buflen;
+  *result = NULL;
+  return EIO;
+}
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================
+ */
+
+/**
+ * make_resolve_ops - Ops backed by the userN mocks
+ */
+static struct syscall_ops make_resolve_ops(void) {
+  struct syscall_ops ops = syscall_ops_default;
+  ops.getpwnam_r = mock_getpwnam_r_uid_from_name;
+  ops.getpwuid_r = mock_getpwuid_r_name_from_uid;
+  return ops;
+}
+
+/**
+ * make_slots - Point @count slots at @entries and their own name buffers
+ */
+static void make_slots(resolve_slot_t *slots, const char *const *entries,
+                       size_t count, char (*names)[TEST_USERNAME_SIZE]) {
+  for (size_t i = 0; i < count; i++) {
+    slots[i] = (resolve_slot_t){.entry = entries[i], .username = names[i]};
+  }
+}
+
+/* ============================================================================
+ * Tests
+ * ============================================================================
+ */
+
+TEST(resolve_pool_null_params) {
+  struct syscall_ops ops = make_resolve_ops();
+  resolve_slot_t slot = {0};
+
+  TEST_ASSERT_EQ(resolve_pool_run(NULL, &slot, 1, 1, TEST_USERNAME_SIZE, 0), -1,
+                 "Should reject NULL ops");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(resolve_pool_run(&ops, NULL, 1, 1, TEST_USERNAME_SIZE, 0), -1,
+                 "Should reject NULL slots");
+  TEST_ASSERT_EQ(resolve_pool_run(&ops, &slot, 1, 1, 0, 0), -1,
+                 "Should reject an empty username buffer");
+  TEST_ASSERT_EQ(resolve_pool_run(&ops, NULL, 0, 4, TEST_USERNAME_SIZE, 0), 0,
+                 "Nothing to resolve is no error");
+}
+
+TEST(resolve_pool_names_and_uids) {
+  struct syscall_ops ops = make_resolve_ops();
+  static const char *const entries[] = {"user1234", "2000", "9001", "ghost",
+                                        "bad;name"};
+  char names[5][TEST_USERNAME_SIZE] = {{0}};
+  resolve_slot_t slots[5];
+
+  make_slots(slots, entries, 5, names);
+  TEST_ASSERT_EQ(resolve_pool_run(&ops, slots, 5, 3, TEST_USERNAME_SIZE, 0), 0,
+                 "Should run");
+
+  TEST_ASSERT_EQ(slots[0].error, 0, "Should resolve the name");
+  TEST_ASSERT_EQ(slots[0].uid, 1234, "Should find the UID");
+  TEST_ASSERT_STR_EQ(slots[0].username, "user1234", "Should keep the name");
+  TEST_ASSERT_EQ(slots[1].error, 0, "Should resolve the UID");
+  TEST_ASSERT_EQ(slots[1].uid, 2000, "Should keep the UID");
+  TEST_ASSERT_STR_EQ(slots[1].username, "user2000", "Should find the name");
+  TEST_ASSERT_EQ(slots[2].error, ENOENT, "Unknown UID is not found");
+  TEST_ASSERT_EQ(slots[3].error, ENOENT, "Unknown name is not found");
+  TEST_ASSERT_EQ(slots[4].error, EINVAL, "Invalid name is rejected");
+}
+
+TEST(resolve_pool_invalid_name_skips_nss) {
+  struct syscall_ops ops = make_resolve_ops();
+  static const char *const entries[] = {"bad;name", "../etc", "-dash"};
+  char names[3][TEST_USERNAME_SIZE] = {{0}};
+  resolve_slot_t slots[3];
+
+  atomic_store(&mock_lookups, 0);
+  make_slots(slots, entries, 3, names);
+  TEST_ASSERT_EQ(resolve_pool_run(&ops, slots, 3, 2, TEST_USERNAME_SIZE, 0), 0,
+                 "Should run");
+  TEST_ASSERT_EQ(atomic_load(&mock_lookups), 0,
+                 "Invalid names must never reach NSS");
+  for (size_t i = 0; i < 3; i++) {
+    TEST_ASSERT_EQ(slots[i].error, EINVAL, "Invalid name is rejected");
+  }
+}
+
+TEST(resolve_pool_every_slot_once) {
+  struct syscall_ops ops = make_resolve_ops();
+  static char entry_storage[TEST_SLOTS][16];
+  const char *entries[TEST_SLOTS];
+  char names[TEST_SLOTS][TEST_USERNAME_SIZE] = {{0}};
+  resolve_slot_t slots[TEST_SLOTS];
+
+  for (size_t i = 0; i < TEST_SLOTS; i++) {
+    (void)snprintf(entry_storage[i], sizeof(entry_storage[i]), "%zu",
+                   1000 + i);
+    entries[i] = entry_storage[i];
+  }
+
+  atomic_store(&mock_lookups, 0);
+  make_slots(slots, entries, TEST_SLOTS, names);
+  TEST_ASSERT_EQ(resolve_pool_run(&ops, slots, TEST_SLOTS, 8,
+                                  TEST_USERNAME_SIZE, 0),
+                 0, "Should run");
+  TEST_ASSERT_EQ(atomic_load(&mock_lookups), TEST_SLOTS,
+                 "Every slot is resolved exactly once");
+  for (size_t i = 0; i < TEST_SLOTS; i++) {
+    char expect[TEST_USERNAME_SIZE];
+    (void)snprintf(expect, sizeof(expect), "user%zu", 1000 + i);
+    TEST_ASSERT_EQ(slots[i].error, 0, "Should resolve");
+    TEST_ASSERT_EQ(slots[i].uid, 1000 + i, "Results stay in their slot");
+    TEST_ASSERT_STR_EQ(slots[i].username, expect, "Names stay in their slot");
+  }
+}
+
+TEST(resolve_pool_grows_buffer) {
+  struct syscall_ops ops = make_resolve_ops();
+  static const char *const entries[] = {"1500", "1501"};
+  char names[2][TEST_USERNAME_SIZE] = {{0}};
+  resolve_slot_t slots[2];
+
+  ops.getpwuid_r = mock_getpwuid_r_erange;
+  make_slots(slots, entries, 2, names);
+  TEST_ASSERT_EQ(resolve_pool_run(&ops, slots, 2, 1, TEST_USERNAME_SIZE, 0), 0,
+                 "Should run");
+  TEST_ASSERT_EQ(slots[0].error, 0, "ERANGE should grow the buffer");
+  TEST_ASSERT_STR_EQ(slots[0].username, "user1500", "Should find the name");
+  TEST_ASSERT_EQ(slots[1].error, 0, "The grown buffer is reused");
+}
+
+TEST(resolve_pool_lookup_error) {
+  struct syscall_ops ops = make_resolve_ops();
+  static const char *const entries[] = {"1500"};
+  char names[1][TEST_USERNAME_SIZE] = {{0}};
+  resolve_slot_t slots[1];
+
+  ops.getpwuid_r = mock_getpwuid_r_eio;
+  make_slots(slots, entries, 1, names);
+  TEST_ASSERT_EQ(resolve_pool_run(&ops, slots, 1, 4, TEST_USERNAME_SIZE, 0), 0,
+                 "Should run");
+  TEST_ASSERT_EQ(slots[0].error, EIO, "Should keep the lookup error");
+}
+
+TEST(resolve_pool_name_too_long) {
+  struct syscall_ops ops = make_resolve_ops();
+  static const char *const entries[] = {"1500"};
+  char names[1][TEST_USERNAME_SIZE] = {{0}};
+  resolve_slot_t slots[1];
+
+  make_slots(slots, entries, 1, names);
+  TEST_ASSERT_EQ(resolve_pool_run(&ops, slots, 1, 1, 4, 0), 0, "Should run");
+  TEST_ASSERT_EQ(slots[0].error, ENAMETOOLONG,
+                 "Should refuse a name that does not fit");
+}
+
+TEST(resolve_pool_calloc_fails) {
+  struct syscall_ops ops = make_resolve_ops();
+  static const char *const entries[] = {"1500", "user7"};
+  char names[2][TEST_USERNAME_SIZE] = {{0}};
+  resolve_slot_t slots[2];
+
+  ops.calloc = mock_calloc_null;
+  make_slots(slots, entries, 2, names);
+  TEST_ASSERT_EQ(resolve_pool_run(&ops, slots, 2, 2, TEST_USERNAME_SIZE, 0), 0,
+                 "Should run");
+  TEST_ASSERT_EQ(slots[0].error, ENOMEM, "Should settle every slot");
+  TEST_ASSERT_EQ(slots[1].error, ENOMEM, "Should settle every slot");
+}
+
+int main(int argc, char **argv) {
+  TEST_INIT(10, false, false); /* timeout, verbose, duration */
+
+  RUN_TEST(resolve_pool_null_params);
+  RUN_TEST(resolve_pool_names_and_uids);
+  RUN_TEST(resolve_pool_invalid_name_skips_nss);
+  RUN_TEST(resolve_pool_every_slot_once);
+  RUN_TEST(resolve_pool_grows_buffer);
+  RUN_TEST(resolve_pool_lookup_error);
+  RUN_TEST(resolve_pool_name_too_long);
+  RUN_TEST(resolve_pool_calloc_fails);
+
+  return TEST_EXECUTE();
+}
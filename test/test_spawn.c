@@ -0,0 +1,372 @@
+/**
+ * test_spawn.c - Tests for the reusable helper spawn context
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <spawn.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test_framework.h"
+#include "test_helpers/all.h"
+
+/* PID reported by mock_posix_spawn */
+enum { MOCK_SPAWN_PID = 4321 };
+
+/* ============================================================================
+ * Mock Process Management
+ * ============================================================================
+ */
+
+/* Calls seen by the mocks */
+static int mock_init_calls = 0;
+static int mock_addopen_calls = 0;
+static int mock_spawn_calls = 0;
+
+/* What the last mock_posix_spawn call was handed */
+static const posix_spawn_file_actions_t *mock_spawn_actions = NULL;
+static const posix_spawnattr_t *mock_spawn_attr = NULL;
+static char *const *mock_spawn_envp = NULL;
+
+/* errno mock_posix_spawn fails with, 0 to succeed */
+static int mock_spawn_errno = 0;
+
+/**
+ * reset_mocks - Forget every call seen so far
+ */
+static void reset_mocks(void) {
+  mock_init_calls = 0;
+  mock_addopen_calls = 0;
+  mock_spawn_calls = 0;
+  mock_spawn_actions = NULL;
+  mock_spawn_attr = NULL;
+  mock_spawn_envp = NULL;
+  mock_spawn_errno = 0;
+}
+
+/**
+ * mock_file_actions_init - Count the file action sets prepared
+ */
+static int mock_file_actions_init(posix_spawn_file_actions_t *file_actions) {
+  mock_init_calls++;
+  return posix_spawn_file_actions_init(file_actions);
+}
+
+/**
+ * mock_file_actions_init_fails - No file actions can be prepared
+ */
+static int
+mock_file_actions_init_fails(posix_spawn_file_actions_t *file_actions) {
+  (void)file_actions;
+  return ENOMEM;
+}
+
+/**
+ * mock_file_actions_addopen - Count the redirections added
+ */
+static int
+mock_file_actions_addopen(posix_spawn_file_actions_t *restrict file_actions,
+                          int fd, const char *restrict path, int oflag,
+                          mode_t mode) {
+  mock_addopen_calls++;
+  return posix_spawn_file_actions_addopen(file_actions, fd, path, oflag,
+                                          mode);
+}
+
+/**
+ * mock_file_actions_addopen_fails - Every redirection fails
+ */
+static int mock_file_actions_addopen_fails(
+    posix_spawn_file_actions_t *restrict file_actions, int fd,
+    const char *restrict path, int oflag, mode_t mode) {
+  (void)file_actions;
+  (void)fd;
+  (void)path;
+  (void)oflag;
+  (void)mode;
+  return EINVAL;
+}
+
+/**
+ * mock_spawnattr_init_fails - Spawn attributes are unavailable
+ */
+static int mock_spawnattr_init_fails(posix_spawnattr_t *attr) {
+  (void)attr;
+  return ENOMEM;
+}
+
+/**
+ * mock_posix_spawn - Record what the helper would have been started with
+ */
+static int mock_posix_spawn(pid_t *restrict pid, const char *restrict path,
+                            const posix_spawn_file_actions_t *file_actions,
+                            const posix_spawnattr_t *restrict attrp,
+                            char *const argv[restrict],
+                            char *const envp[restrict]) {
+  (void)path;
+  (void)argv;
+
+  mock_spawn_calls++;
+  mock_spawn_actions = file_actions;
+  mock_spawn_attr = attrp;
+  mock_spawn_envp = envp;
+  if (mock_spawn_errno != 0) {
+    return mock_spawn_errno;
+  }
+
+  *pid = MOCK_SPAWN_PID;
+  return 0;
+}
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================
+ */
+
+/**
+ * make_spawn_ops - Ops counting file actions and never spawning
+ */
+static struct syscall_ops make_spawn_ops(void) {
+  struct syscall_ops ops = syscall_ops_default;
+  ops.posix_spawn_file_actions_init = mock_file_actions_init;
+  ops.posix_spawn_file_actions_addopen = mock_file_actions_addopen;
+  ops.posix_spawn = mock_posix_spawn;
+  reset_mocks();
+  return ops;
+}
+
+/**
+ * envp_has_key - Check whether @envp holds a KEY=... entry
+ */
+static bool envp_has_key(char *const *envp, const char *key) {
+  size_t klen = strlen(key);
+  for (size_t i = 0; envp != NULL && envp[i] != NULL; i++) {
+    if (strncmp(envp[i], key, klen) == 0 && envp[i][klen] == '=') {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Argument vector handed to every spawn_helper() call */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wcast-qual"
+static char *const test_argv[] = {(char *)"getsubids", (char *)"testuser",
+                                  NULL};
+#pragma GCC diagnostic pop
+
+/* ============================================================================
+ * Tests
+ * ============================================================================
+ */
+
+TEST(spawn_ctx_null_params) {
+  struct syscall_ops ops = make_spawn_ops();
+  spawn_ctx_t ctx = {0};
+  pid_t pid = 0;
+
+  TEST_ASSERT_EQ(spawn_ctx_init(NULL, &ctx), -1, "Should reject NULL ops");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(spawn_ctx_init(&ops, NULL), -1, "Should reject NULL ctx");
+  TEST_ASSERT_EQ(spawn_ctx_acquire(&ops, NULL), NULL,
+                 "Should reject NULL storage");
+  TEST_ASSERT_EQ(spawn_helper(&ops, NULL, "/bin/true", test_argv, true, &pid),
+                 -1, "Should reject NULL ctx");
+  TEST_ASSERT_EQ(spawn_ctx_install(NULL, false), -1, "Should reject NULL ops");
+
+  spawn_ctx_destroy(NULL, &ctx);
+  spawn_ctx_destroy(&ops, NULL);
+  spawn_ctx_uninstall(NULL);
+  spawn_ctx_release(&ops, NULL, &ctx);
+}
+
+TEST(spawn_ctx_environment_sanitized) {
+  struct syscall_ops ops = make_spawn_ops();
+  spawn_ctx_t ctx = {0};
+
+  setenv("LANG", "en_US.UTF-8", 1);
+  setenv("LD_PRELOAD", "/tmp/evil.so", 1);
+  TEST_ASSERT_EQ(spawn_ctx_init(&ops, &ctx), 0, "Should build the context");
+  unsetenv("LD_PRELOAD");
+
+  TEST_ASSERT_EQ(envp_has_key(ctx.envp, "LANG"), true,
+                 "Allowlisted variables are passed on");
+  TEST_ASSERT_EQ(envp_has_key(ctx.envp, "LD_PRELOAD"), false,
+                 "Anything else is dropped");
+  TEST_ASSERT_EQ(envp_has_key(ctx.envp, "PATH"), false,
+                 "Anything else is dropped");
+
+  spawn_ctx_destroy(&ops, &ctx);
+  TEST_ASSERT_EQ(ctx.envp, NULL, "Should zero the context");
+}
+
+TEST(spawn_ctx_calloc_fails) {
+  struct syscall_ops ops = make_spawn_ops();
+  spawn_ctx_t ctx = {0};
+
+  ops.calloc = mock_calloc_null;
+  TEST_ASSERT_EQ(spawn_ctx_init(&ops, &ctx), -1,
+                 "Should fail without an environment");
+  TEST_ASSERT_EQ(errno, ENOMEM, "Should set the correct error code");
+}
+
+TEST(spawn_helper_prepares_actions_once) {
+  struct syscall_ops ops = make_spawn_ops();
+  spawn_ctx_t ctx = {0};
+  pid_t pid = 0;
+
+  TEST_ASSERT_EQ(spawn_ctx_init(&ops, &ctx), 0, "Should build the context");
+  TEST_ASSERT_EQ(mock_init_calls, 0, "File actions wait for first use");
+
+  for (int i = 0; i < 5; i++) {
+    TEST_ASSERT_EQ(spawn_helper(&ops, &ctx, "/bin/true", test_argv, true,
+                                &pid),
+                   0, "Should spawn");
+  }
+  TEST_ASSERT_EQ(pid, MOCK_SPAWN_PID, "Should return the PID");
+  TEST_ASSERT_EQ(mock_init_calls, 1, "Quiet actions are prepared once");
+  TEST_ASSERT_EQ(mock_addopen_calls, 3, "stdin, stdout and stderr");
+  TEST_ASSERT_EQ(mock_spawn_actions, &ctx.quiet, "Should use quiet actions");
+  TEST_ASSERT_EQ(mock_spawn_envp, ctx.envp, "Should reuse the environment");
+#ifdef POSIX_SPAWN_USEVFORK
+  TEST_ASSERT_EQ(mock_spawn_attr, &ctx.attr, "Should pass the attributes");
+#endif
+
+  TEST_ASSERT_EQ(spawn_helper(&ops, &ctx, "/bin/true", test_argv, false,
+                              &pid),
+                 0, "Should spawn");
+  TEST_ASSERT_EQ(mock_init_calls, 2, "stdin-only actions are separate");
+  TEST_ASSERT_EQ(mock_addopen_calls, 4, "Only stdin is redirected");
+  TEST_ASSERT_EQ(mock_spawn_actions, &ctx.stdin_only,
+                 "Should use stdin-only actions");
+
+  spawn_ctx_destroy(&ops, &ctx);
+}
+
+TEST(spawn_helper_actions_fail) {
+  struct syscall_ops ops = make_spawn_ops();
+  spawn_ctx_t ctx = {0};
+  pid_t pid = 0;
+
+  TEST_ASSERT_EQ(spawn_ctx_init(&ops, &ctx), 0, "Should build the context");
+  ops.posix_spawn_file_actions_init = mock_file_actions_init_fails;
+  TEST_ASSERT_EQ(spawn_helper(&ops, &ctx, "/bin/true", test_argv, true, &pid),
+                 -1, "Should fail without file actions");
+  TEST_ASSERT_EQ(errno, ENOMEM, "Should keep the error");
+
+  ops.posix_spawn_file_actions_init = mock_file_actions_init;
+  ops.posix_spawn_file_actions_addopen = mock_file_actions_addopen_fails;
+  TEST_ASSERT_EQ(spawn_helper(&ops, &ctx, "/bin/true", test_argv, false,
+                              &pid),
+                 -1, "Should fail without the redirection");
+  TEST_ASSERT_EQ(ctx.have_stdin_only, false, "Should not keep broken actions");
+  TEST_ASSERT_EQ(mock_spawn_calls, 0, "Should never spawn");
+
+  spawn_ctx_destroy(&ops, &ctx);
+}
+
+TEST(spawn_helper_spawn_fails) {
+  struct syscall_ops ops = make_spawn_ops();
+  spawn_ctx_t ctx = {0};
+  pid_t pid = 0;
+
+  TEST_ASSERT_EQ(spawn_ctx_init(&ops, &ctx), 0, "Should build the context");
+  mock_spawn_errno = ENOENT;
+  TEST_ASSERT_EQ(spawn_helper(&ops, &ctx, "/bin/true", test_argv, true, &pid),
+                 -1, "Should report the failed spawn");
+  TEST_ASSERT_EQ(errno, ENOENT, "Should keep the error");
+
+  spawn_ctx_destroy(&ops, &ctx);
+}
+
+TEST(spawn_ctx_without_attributes) {
+  struct syscall_ops ops = make_spawn_ops();
+  spawn_ctx_t ctx = {0};
+  pid_t pid = 0;
+
+  ops.posix_spawnattr_init = mock_spawnattr_init_fails;
+  TEST_ASSERT_EQ(spawn_ctx_init(&ops, &ctx), 0,
+                 "Attributes are only a hint");
+  TEST_ASSERT_EQ(spawn_helper(&ops, &ctx, "/bin/true", test_argv, true, &pid),
+                 0, "Should spawn");
+  TEST_ASSERT_EQ(mock_spawn_attr, NULL, "Should use the default attributes");
+
+  spawn_ctx_destroy(&ops, &ctx);
+}
+
+TEST(spawn_ctx_acquire_local) {
+  struct syscall_ops ops = make_spawn_ops();
+  spawn_ctx_t local = {0};
+
+  spawn_ctx_t *ctx = spawn_ctx_acquire(&ops, &local);
+  TEST_ASSERT_EQ(ctx, &local, "Without an installed context use our own");
+  TEST_ASSERT_NOT_EQ(local.envp, NULL, "Should be initialised");
+
+  spawn_ctx_release(&ops, ctx, &local);
+  TEST_ASSERT_EQ(local.envp, NULL, "Our own context is released");
+}
+
+TEST(spawn_ctx_install_shared) {
+  struct syscall_ops ops = make_spawn_ops();
+  spawn_ctx_t local = {0};
+  pid_t pid = 0;
+
+  TEST_ASSERT_EQ(spawn_ctx_install(&ops, true), 0, "Should install");
+  TEST_ASSERT_EQ(mock_init_calls, 2, "Both action sets are prepared");
+  TEST_ASSERT_EQ(spawn_ctx_install(&ops, true), 0, "Installing twice is fine");
+  TEST_ASSERT_EQ(mock_init_calls, 2, "Nothing is prepared again");
+
+  for (int i = 0; i < 3; i++) {
+    spawn_ctx_t *ctx = spawn_ctx_acquire(&ops, &local);
+    TEST_ASSERT_NOT_EQ(ctx, NULL, "Should find a context");
+    TEST_ASSERT_NOT_EQ(ctx, &local, "Should share the installed context");
+    TEST_ASSERT_EQ(spawn_helper(&ops, ctx, "/bin/true", test_argv, i % 2 == 0,
+                                &pid),
+                   0, "Should spawn");
+    spawn_ctx_release(&ops, ctx, &local);
+  }
+  TEST_ASSERT_EQ(mock_init_calls, 2, "Helpers reuse the prepared actions");
+  TEST_ASSERT_EQ(mock_addopen_calls, 4, "Helpers reuse the prepared actions");
+
+  spawn_ctx_uninstall(&ops);
+  TEST_ASSERT_EQ(spawn_ctx_acquire(&ops, &local), &local,
+                 "Uninstalled, callers build their own again");
+  spawn_ctx_release(&ops, &local, &local);
+}
+
+TEST(spawn_ctx_install_fails) {
+  struct syscall_ops ops = make_spawn_ops();
+  spawn_ctx_t local = {0};
+
+  ops.posix_spawn_file_actions_addopen = mock_file_actions_addopen_fails;
+  TEST_ASSERT_EQ(spawn_ctx_install(&ops, true), -1,
+                 "Should report the failure");
+  TEST_ASSERT_EQ(spawn_ctx_acquire(&ops, &local), &local,
+                 "Nothing should be installed");
+  spawn_ctx_release(&ops, &local, &local);
+}
+
+int main(int argc, char **argv) {
+  TEST_INIT(10, false, false); /* timeout, verbose, duration */
+
+  RUN_TEST(spawn_ctx_null_params);
+  RUN_TEST(spawn_ctx_environment_sanitized);
+  RUN_TEST(spawn_ctx_calloc_fails);
+  RUN_TEST(spawn_helper_prepares_actions_once);
+  RUN_TEST(spawn_helper_actions_fail);
+  RUN_TEST(spawn_helper_spawn_fails);
+  RUN_TEST(spawn_ctx_without_attributes);
+  RUN_TEST(spawn_ctx_acquire_local);
+  RUN_TEST(spawn_ctx_install_shared);
+  RUN_TEST(spawn_ctx_install_fails);
+
+  return TEST_EXECUTE();
+}
@@ -0,0 +1,554 @@
+/**
+ * test_spool.c - Tests for the group commit spool
+ *
+ * The spool and the databases live in a private temporary directory. The
+ * other runs taking part in a group commit are simulated: their requests
+ * are written by hand, and the run that flushes ours is a mocked flock()
+ * that answers our request while we "wait" for the lock.
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "test_framework.h"
+#include "test_helpers/all.h"
+
+/* ============================================================================
+ * Constants
+ * ============================================================================
+ */
+
+/* Room for the database contents read back by the tests */
+enum { READ_BUF_SIZE = 4096 };
+
+/* Size of the mkdtemp(3) path buffer and of the spool paths below it */
+enum {
+  TMPDIR_SIZE = 64,
+  RUN_DIR_SIZE = TMPDIR_SIZE + 16,
+  SPOOL_DIR_SIZE = RUN_DIR_SIZE + 16
+};
+
+/* PID of a simulated concurrent run */
+enum { OTHER_PID = 4242 };
+
+/* ============================================================================
+ * Global State
+ * ============================================================================
+ */
+
+/* Private directory standing in for /etc */
+static char tmpdir[TMPDIR_SIZE] = {0};
+
+/* Stand-in for STAMP_DIR inside tmpdir, and the spool below it */
+static char run_dir[RUN_DIR_SIZE] = {0};
+static char spool_dir[SPOOL_DIR_SIZE] = {0};
+
+/* Number of lckpwdf calls seen */
+static int lckpwdf_calls = 0;
+
+/* Suffix the mocked flock() renames our request to, or NULL */
+static const char *answer_suffix = NULL;
+
+/* ============================================================================
+ * Mock Functions
+ * ============================================================================
+ */
+
+/**
+ * mock_lckpwdf_success - Count the call and pretend the lock was taken
+ */
+static int mock_lckpwdf_success(void) {
+  lckpwdf_calls++;
+  return 0;
+}
+
+/**
+ * mock_lckpwdf_eacces - Fail like an unprivileged caller would
+ */
+static int mock_lckpwdf_eacces(void) {
+  lckpwdf_calls++;
+  errno = EACCES;
+  return -1;
+}
+
+/**
+ * mock_ulckpwdf_success - Pretend the lock was released
+ */
+static int mock_ulckpwdf_success(void) { return 0; }
+
+/**
+ * mock_kill_alive - Report every process as running
+ */
+static int mock_kill_alive(pid_t pid, int sig) {
+  (void)pid;
+  (void)sig;
+  return 0;
+}
+
+/**
+ * mock_kill_esrch - Report every process as gone
+ */
+static int mock_kill_esrch(pid_t pid, int sig) {
+  (void)pid;
+  (void)sig;
+  errno = ESRCH;
+  return -1;
+}
+
+/**
+ * mock_flock_answered - Lock, after another run has answered our request
+ */
+static int mock_flock_answered(int fd, int operation) {
+  (void)fd;
+  (void)operation;
+  if (answer_suffix != NULL) {
+    char from[PATH_MAX] = {0};
+    char to[PATH_MAX] = {0};
+    (void)snprintf(from, sizeof(from), "%s/%ld.req", spool_dir,
+                   (long)getpid());
+    (void)snprintf(to, sizeof(to), "%s/%ld%s", spool_dir, (long)getpid(),
+                   answer_suffix);
+    (void)rename(from, to);
+  }
+  return 0;
+}
+
+/**
+ * redirect_path - Move database paths into tmpdir, keep everything else
+ */
+static void redirect_path(const char *path, char *out, size_t size) {
+  size_t uid_len = strlen(SUBUID_PATH);
+  size_t gid_len = strlen(SUBGID_PATH);
+  if (strncmp(path, SUBUID_PATH, uid_len) == 0 ||
+      strncmp(path, SUBGID_PATH, gid_len) == 0) {
+    const char *base = strrchr(path, '/');
+    (void)snprintf(out, size, "%s/%s", tmpdir, base + 1);
+    return;
+  }
+  (void)snprintf(out, size, "%s", path);
+}
+
+/**
+ * mock_open_redirect - open() with database paths moved into tmpdir
+ */
+static int mock_open_redirect(const char *pathname, int flags, ...) {
+  mode_t mode = 0;
+  if ((flags & O_CREAT) != 0) {
+    va_list ap;
+    va_start(ap, flags);
+    mode = (mode_t)va_arg(ap, int);
+    va_end(ap);
+  }
+
+  /* The directory fsync after rename */
+  if ((flags & O_DIRECTORY) != 0) {
+    return open(tmpdir, flags);
+  }
+
+  char path[PATH_MAX] = {0};
+  redirect_path(pathname, path, sizeof(path));
+  return open(path, flags, mode);
+}
+
+/**
+ * mock_unlink_redirect - unlink() with database paths moved into tmpdir
+ */
+static int mock_unlink_redirect(const char *pathname) {
+  char path[PATH_MAX] = {0};
+  redirect_path(pathname, path, sizeof(path));
+  return unlink(path);
+}
+
+/**
+ * mock_rename_redirect - rename() with database paths moved into tmpdir
+ */
+static int mock_rename_redirect(const char *oldpath, const char *newpath) {
+  char from[PATH_MAX] = {0};
+  char to[PATH_MAX] = {0};
+  redirect_path(oldpath, from, sizeof(from));
+  redirect_path(newpath, to, sizeof(to));
+  return rename(from, to);
+}
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================
+ */
+
+/**
+ * remove_tree - Remove a directory holding only files and directories
+ */
+static void remove_tree(const char *path) {
+  DIR *dir = opendir(path);
+  if (dir == NULL) {
+    (void)unlink(path);
+    return;
+  }
+
+  const struct dirent *entry = NULL;
+  while ((entry = readdir(dir)) != NULL) {
+    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+      continue;
+    }
+    char child[PATH_MAX] = {0};
+    (void)snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+    remove_tree(child);
+  }
+  (void)closedir(dir);
+  (void)rmdir(path);
+}
+
+/**
+ * setup_tmpdir - Create the private directory and the spool paths
+ */
+static int setup_tmpdir(void) {
+  (void)snprintf(tmpdir, sizeof(tmpdir), "/tmp/test_spool.XXXXXX");
+  if (mkdtemp(tmpdir) == NULL) {
+    return -1;
+  }
+  (void)snprintf(run_dir, sizeof(run_dir), "%s/run", tmpdir);
+  (void)snprintf(spool_dir, sizeof(spool_dir), "%s/spool", run_dir);
+  answer_suffix = NULL;
+  return 0;
+}
+
+/**
+ * make_spool - Create the spool directory ahead of the commit
+ */
+static int make_spool(void) {
+  if (mkdir(run_dir, 0755) != 0) {
+    return -1;
+  }
+  return mkdir(spool_dir, 0700);
+}
+
+/**
+ * spool_file - Path of a request file for @pid
+ */
+static void spool_file(long pid, const char *suffix, char *out, size_t size) {
+  (void)snprintf(out, size, "%s/%ld%s", spool_dir, pid, suffix);
+}
+
+/**
+ * file_exists - Check whether a path exists
+ */
+static bool file_exists(const char *path) {
+  struct stat st;
+  return lstat(path, &st) == 0;
+}
+
+/**
+ * write_file - Replace a file's contents
+ */
+static int write_file(const char *path, const char *content) {
+  FILE *fp = fopen(path, "w");
+  if (fp == NULL) {
+    return -1;
+  }
+  (void)fputs(content, fp);
+  return fclose(fp);
+}
+
+/**
+ * read_db - Read a whole redirected database into a static buffer
+ */
+static const char *read_db(const char *db) {
+  static char buf[READ_BUF_SIZE];
+  char path[PATH_MAX] = {0};
+  redirect_path(db, path, sizeof(path));
+
+  FILE *fp = fopen(path, "r");
+  if (fp == NULL) {
+    return NULL;
+  }
+  size_t len = fread(buf, 1, sizeof(buf) - 1, fp);
+  buf[len] = '\0';
+  (void)fclose(fp);
+  return buf;
+}
+
+/**
+ * make_spool_ops - File operations redirected, shadow lock mocked
+ */
+static struct syscall_ops make_spool_ops(void) {
+  struct syscall_ops ops = syscall_ops_default;
+
+  lckpwdf_calls = 0;
+  ops.lckpwdf = mock_lckpwdf_success;
+  ops.ulckpwdf = mock_ulckpwdf_success;
+  ops.open = mock_open_redirect;
+  ops.unlink = mock_unlink_redirect;
+  ops.rename = mock_rename_redirect;
+  ops.kill = mock_kill_alive;
+  return ops;
+}
+
+/**
+ * queue_alice - Queue the subuid and subgid ranges of one user
+ */
+static int queue_alice(const struct syscall_ops *ops, subid_txn_t *txn) {
+  if (subid_txn_add(ops, txn, SUBUID, "alice", 100000, 65536) != 0 ||
+      subid_txn_add(ops, txn, SUBGID, "alice", 100000, 65536) != 0) {
+    return -1;
+  }
+  txn->users = 1;
+  return 0;
+}
+
+/* ============================================================================
+ * Tests
+ * ============================================================================
+ */
+
+TEST(spool_commit_null_params) {
+  struct syscall_ops ops = make_spool_ops();
+  subid_txn_t txn = {0};
+
+  TEST_ASSERT_EQ(subid_spool_commit(NULL, "/tmp", &txn, true), -1,
+                 "Should reject NULL ops");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(subid_spool_commit(&ops, NULL, &txn, true), -1,
+                 "Should reject NULL dir");
+  TEST_ASSERT_EQ(subid_spool_commit(&ops, "/tmp", NULL, true), -1,
+                 "Should reject NULL txn");
+}
+
+TEST(spool_commit_empty) {
+  struct syscall_ops ops = make_spool_ops();
+  subid_txn_t txn = {0};
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  TEST_ASSERT_EQ(subid_spool_commit(&ops, run_dir, &txn, true), 0,
+                 "Empty commit should succeed");
+  TEST_ASSERT_EQ(lckpwdf_calls, 0, "Should not take the shadow lock");
+  TEST_ASSERT_EQ(file_exists(run_dir), false, "Should not create the spool");
+  remove_tree(tmpdir);
+}
+
+TEST(spool_commit_alone) {
+  struct syscall_ops ops = make_spool_ops();
+  subid_txn_t txn = {0};
+  char path[PATH_MAX] = {0};
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  TEST_ASSERT_EQ(queue_alice(&ops, &txn), 0, "Should queue the ranges");
+
+  TEST_ASSERT_EQ(subid_spool_commit(&ops, run_dir, &txn, true), 0,
+                 "Should write our own request");
+  TEST_ASSERT_EQ(lckpwdf_calls, 1, "Should take the shadow lock once");
+  TEST_ASSERT_EQ(txn.subuid.len + txn.subgid.len, 0,
+                 "Commit should release the entries");
+  TEST_ASSERT_STR_EQ(read_db(SUBUID_PATH), "alice:100000:65536\n",
+                     "subuid should hold the entry");
+  TEST_ASSERT_STR_EQ(read_db(SUBGID_PATH), "alice:100000:65536\n",
+                     "subgid should hold the entry");
+
+  spool_file((long)getpid(), ".req", path, sizeof(path));
+  TEST_ASSERT_EQ(file_exists(path), false, "Should remove our request");
+  spool_file((long)getpid(), ".done", path, sizeof(path));
+  TEST_ASSERT_EQ(file_exists(path), false, "Should not answer ourselves");
+
+  struct stat st = {0};
+  TEST_ASSERT_EQ(lstat(spool_dir, &st), 0, "Should create the spool");
+  TEST_ASSERT_EQ(st.st_mode & 07777, 0700, "Spool should be private");
+
+  remove_tree(tmpdir);
+}
+
+TEST(spool_commit_flushes_others) {
+  struct syscall_ops ops = make_spool_ops();
+  subid_txn_t txn = {0};
+  char path[PATH_MAX] = {0};
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  TEST_ASSERT_EQ(make_spool(), 0, "Should create the spool");
+  spool_file(OTHER_PID, ".req", path, sizeof(path));
+  TEST_ASSERT_EQ(write_file(path, "u:bob:165536:65536\ng:bob:165536:65536\n"),
+                 0, "Should queue another run's request");
+  TEST_ASSERT_EQ(queue_alice(&ops, &txn), 0, "Should queue the ranges");
+
+  TEST_ASSERT_EQ(subid_spool_commit(&ops, run_dir, &txn, true), 0,
+                 "Should write every pending request");
+  TEST_ASSERT_EQ(lckpwdf_calls, 1, "Should write both in one commit");
+  /* Requests are flushed in name order, which depends on our PID */
+  const char *db = read_db(SUBUID_PATH);
+  TEST_ASSERT_EQ(db != NULL && strlen(db) == 36, true,
+                 "subuid should hold two entries");
+  TEST_ASSERT_EQ(strstr(db, "bob:165536:65536\n") != NULL, true,
+                 "subuid should hold the other run's entry");
+  TEST_ASSERT_EQ(strstr(db, "alice:100000:65536\n") != NULL, true,
+                 "subuid should hold our entry");
+  db = read_db(SUBGID_PATH);
+  TEST_ASSERT_EQ(db != NULL && strstr(db, "alice:100000:65536\n") != NULL,
+                 true, "subgid should hold our entry");
+
+  TEST_ASSERT_EQ(file_exists(path), false, "Should consume the request");
+  spool_file(OTHER_PID, ".done", path, sizeof(path));
+  TEST_ASSERT_EQ(file_exists(path), true, "Should answer the other run");
+
+  remove_tree(tmpdir);
+}
+
+TEST(spool_commit_discards_stale) {
+  struct syscall_ops ops = make_spool_ops();
+  subid_txn_t txn = {0};
+  char path[PATH_MAX] = {0};
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  TEST_ASSERT_EQ(make_spool(), 0, "Should create the spool");
+  spool_file(OTHER_PID, ".req", path, sizeof(path));
+  TEST_ASSERT_EQ(write_file(path, "u:bob:165536:65536\n"), 0,
+                 "Should queue a dead run's request");
+  ops.kill = mock_kill_esrch;
+  TEST_ASSERT_EQ(queue_alice(&ops, &txn), 0, "Should queue the ranges");
+
+  TEST_ASSERT_EQ(subid_spool_commit(&ops, run_dir, &txn, true), 0,
+                 "Should write our own request");
+  TEST_ASSERT_STR_EQ(read_db(SUBUID_PATH), "alice:100000:65536\n",
+                     "Should skip the dead run's ranges");
+  TEST_ASSERT_EQ(file_exists(path), false, "Should remove the stale request");
+  spool_file(OTHER_PID, ".done", path, sizeof(path));
+  TEST_ASSERT_EQ(file_exists(path), false, "Should not answer it");
+
+  remove_tree(tmpdir);
+}
+
+TEST(spool_commit_damaged_request) {
+  struct syscall_ops ops = make_spool_ops();
+  subid_txn_t txn = {0};
+  char path[PATH_MAX] = {0};
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  TEST_ASSERT_EQ(make_spool(), 0, "Should create the spool");
+  spool_file(OTHER_PID, ".req", path, sizeof(path));
+  TEST_ASSERT_EQ(write_file(path, "u:bob:165536:65536\nx:bob:1:1\n"), 0,
+                 "Should queue a damaged request");
+  TEST_ASSERT_EQ(queue_alice(&ops, &txn), 0, "Should queue the ranges");
+
+  TEST_ASSERT_EQ(subid_spool_commit(&ops, run_dir, &txn, true), 0,
+                 "A damaged request should not hold up ours");
+  TEST_ASSERT_STR_EQ(read_db(SUBUID_PATH), "alice:100000:65536\n",
+                     "Should add nothing from the damaged request");
+  spool_file(OTHER_PID, ".fail", path, sizeof(path));
+  TEST_ASSERT_EQ(file_exists(path), true, "Should fail the damaged request");
+
+  remove_tree(tmpdir);
+}
+
+TEST(spool_commit_answered_by_other) {
+  struct syscall_ops ops = make_spool_ops();
+  subid_txn_t txn = {0};
+  char path[PATH_MAX] = {0};
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  ops.flock = mock_flock_answered;
+  answer_suffix = ".done";
+  TEST_ASSERT_EQ(queue_alice(&ops, &txn), 0, "Should queue the ranges");
+
+  TEST_ASSERT_EQ(subid_spool_commit(&ops, run_dir, &txn, true), 0,
+                 "Should succeed on the other run's answer");
+  TEST_ASSERT_EQ(lckpwdf_calls, 0, "Should not write anything itself");
+  TEST_ASSERT_EQ(txn.subuid.len + txn.subgid.len, 0,
+                 "Commit should release the entries");
+  spool_file((long)getpid(), ".done", path, sizeof(path));
+  TEST_ASSERT_EQ(file_exists(path), false, "Should consume the answer");
+
+  remove_tree(tmpdir);
+}
+
+TEST(spool_commit_failed_by_other) {
+  struct syscall_ops ops = make_spool_ops();
+  subid_txn_t txn = {0};
+  char path[PATH_MAX] = {0};
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  ops.flock = mock_flock_answered;
+  answer_suffix = ".fail";
+  TEST_ASSERT_EQ(queue_alice(&ops, &txn), 0, "Should queue the ranges");
+
+  TEST_ASSERT_EQ(subid_spool_commit(&ops, run_dir, &txn, true), -1,
+                 "Should fail on the other run's answer");
+  TEST_ASSERT_EQ(errno, EIO, "Should report an I/O error");
+  TEST_ASSERT_EQ(txn.subuid.len, 1, "Failed commit should keep the entries");
+  spool_file((long)getpid(), ".fail", path, sizeof(path));
+  TEST_ASSERT_EQ(file_exists(path), false, "Should consume the answer");
+
+  subid_txn_free(&ops, &txn);
+  remove_tree(tmpdir);
+}
+
+TEST(spool_commit_write_fails_everyone) {
+  struct syscall_ops ops = make_spool_ops();
+  subid_txn_t txn = {0};
+  char path[PATH_MAX] = {0};
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  TEST_ASSERT_EQ(make_spool(), 0, "Should create the spool");
+  spool_file(OTHER_PID, ".req", path, sizeof(path));
+  TEST_ASSERT_EQ(write_file(path, "u:bob:165536:65536\n"), 0,
+                 "Should queue another run's request");
+  ops.lckpwdf = mock_lckpwdf_eacces;
+  TEST_ASSERT_EQ(queue_alice(&ops, &txn), 0, "Should queue the ranges");
+
+  TEST_ASSERT_EQ(subid_spool_commit(&ops, run_dir, &txn, true), -1,
+                 "Should fail without the shadow lock");
+  TEST_ASSERT_EQ(errno, EACCES, "Should keep the lckpwdf error");
+  spool_file(OTHER_PID, ".fail", path, sizeof(path));
+  TEST_ASSERT_EQ(file_exists(path), true, "Should fail the other run too");
+  spool_file((long)getpid(), ".req", path, sizeof(path));
+  TEST_ASSERT_EQ(file_exists(path), false, "Should remove our request");
+
+  subid_txn_free(&ops, &txn);
+  remove_tree(tmpdir);
+}
+
+TEST(spool_commit_falls_back) {
+  struct syscall_ops ops = make_spool_ops();
+  subid_txn_t txn = {0};
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  TEST_ASSERT_EQ(write_file(run_dir, "not a directory\n"), 0,
+                 "Should block the spool directory");
+  TEST_ASSERT_EQ(queue_alice(&ops, &txn), 0, "Should queue the ranges");
+
+  TEST_ASSERT_EQ(subid_spool_commit(&ops, run_dir, &txn, true), 0,
+                 "Should write directly");
+  TEST_ASSERT_EQ(lckpwdf_calls, 1, "Should take the shadow lock once");
+  TEST_ASSERT_STR_EQ(read_db(SUBUID_PATH), "alice:100000:65536\n",
+                     "subuid should hold the entry");
+
+  remove_tree(tmpdir);
+}
+
+int main(int argc, char **argv) {
+  TEST_INIT(10, false, false); /* timeout, verbose, duration */
+
+  RUN_TEST(spool_commit_null_params);
+  RUN_TEST(spool_commit_empty);
+  RUN_TEST(spool_commit_alone);
+  RUN_TEST(spool_commit_flushes_others);
+  RUN_TEST(spool_commit_discards_stale);
+  RUN_TEST(spool_commit_damaged_request);
+  RUN_TEST(spool_commit_answered_by_other);
+  RUN_TEST(spool_commit_failed_by_other);
+  RUN_TEST(spool_commit_write_fails_everyone);
+  RUN_TEST(spool_commit_falls_back);
+
+  return TEST_EXECUTE();
+}
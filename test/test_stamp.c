@@ -0,0 +1,444 @@
+/**
+ * test_stamp.c - Tests for the per-UID stamp cache
+ *
+ * Stamps are written into and checked against a private temporary
+ * directory; the configuration sources are mocked through stat() and
+ * scandir() so the fingerprint does not depend on the build host.
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "test_framework.h"
+#include "test_helpers/all.h"
+
+/* ============================================================================
+ * Constants
+ * ============================================================================
+ */
+
+/* Room for a stamp read back by the tests */
+enum { READ_BUF_SIZE = 512 };
+
+/* Size of the mkdtemp(3) path buffer and of the stamp directory under it */
+enum { TMPDIR_SIZE = 64, STAMP_DIR_SIZE = TMPDIR_SIZE + 8 };
+
+/* UID and fingerprint used for the stamps under test */
+enum { TEST_UID = 1000 };
+#define TEST_FINGERPRINT UINT64_C(0x0123456789abcdef)
+
+/* ============================================================================
+ * Global State
+ * ============================================================================
+ */
+
+/* Private directory holding the stamp directory */
+static char tmpdir[TMPDIR_SIZE] = {0};
+
+/* Stamp directory inside tmpdir, created by stamp_write() */
+static char stamp_dir[STAMP_DIR_SIZE] = {0};
+
+/* Modification time reported by mock_stat_mtime() */
+static time_t mock_mtime = 0;
+
+/* ============================================================================
+ * Mock Functions
+ * ============================================================================
+ */
+
+/**
+ * mock_stat_mtime - Report every source as a root file with mock_mtime
+ */
+static int mock_stat_mtime(const char *pathname, struct stat *statbuf) {
+  (void)pathname;
+  *statbuf = (struct stat){0};
+  statbuf->st_mode = S_IFREG | 0644;
+  statbuf->st_mtim.tv_sec = mock_mtime;
+  return 0;
+}
+
+/**
+ * mock_mkdir_eacces - Fail to create the stamp directory
+ */
+static int mock_mkdir_eacces(const char *pathname, mode_t mode) {
+  (void)pathname;
+  (void)mode;
+  errno = EACCES;
+  return -1;
+}
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================
+ */
+
+/**
+ * setup_tmpdir - Create the private directory and set stamp_dir
+ */
+static int setup_tmpdir(void) {
+  (void)snprintf(tmpdir, sizeof(tmpdir), "/tmp/test_stamp.XXXXXX");
+  if (mkdtemp(tmpdir) == NULL) {
+    return -1;
+  }
+  (void)snprintf(stamp_dir, sizeof(stamp_dir), "%s/stamps", tmpdir);
+  return 0;
+}
+
+/**
+ * stamp_file - Path of the stamp for TEST_UID
+ */
+static const char *stamp_file(void) {
+  static char path[PATH_MAX];
+  (void)snprintf(path, sizeof(path), "%s/%u", stamp_dir, TEST_UID);
+  return path;
+}
+
+/**
+ * cleanup_tmpdir - Remove the stamp and both directories
+ */
+static void cleanup_tmpdir(void) {
+  (void)unlink(stamp_file());
+  (void)rmdir(stamp_dir);
+  (void)rmdir(tmpdir);
+}
+
+/**
+ * read_file - Read a whole file into a static buffer
+ */
+static const char *read_file(const char *path) {
+  static char buf[READ_BUF_SIZE];
+  FILE *fp = fopen(path, "r");
+  if (fp == NULL) {
+    return NULL;
+  }
+  size_t len = fread(buf, 1, sizeof(buf) - 1, fp);
+  buf[len] = '\0';
+  (void)fclose(fp);
+  return buf;
+}
+
+/**
+ * read_stamp - Read the stamp for TEST_UID with its database field as "-"
+ *
+ * The database fingerprint depends on the host's SUBUID_PATH and
+ * SUBGID_PATH, the rest of the line does not.
+ */
+static const char *read_stamp(void) {
+  static char buf[READ_BUF_SIZE];
+  const char *line = read_file(stamp_file());
+  if (line == NULL) {
+    return NULL;
+  }
+  /* Version and configuration fingerprint, then the database field */
+  const char *databases = strchr(line, ' ');
+  databases = databases != NULL ? strchr(databases + 1, ' ') : NULL;
+  const char *rest = databases != NULL ? strchr(databases + 1, ' ') : NULL;
+  if (rest == NULL) {
+    return line;
+  }
+  (void)snprintf(buf, sizeof(buf), "%.*s -%s", (int)(databases - line), line,
+                 rest);
+  return buf;
+}
+
+/**
+ * make_opts - Options requesting both modes
+ */
+static options_t make_opts(void) {
+  options_t opts = {0};
+  opts.do_subuid = true;
+  opts.do_subgid = true;
+  opts.debug = true;
+  return opts;
+}
+
+/**
+ * write_test_stamp - Write the stamp for TEST_UID with default config
+ */
+static int write_test_stamp(const options_t *opts) {
+  config_t config = {0};
+  config_factory(&config);
+  return stamp_write(&syscall_ops_default, stamp_dir, TEST_UID, "testuser",
+                     &config, opts, TEST_FINGERPRINT);
+}
+
+/* ============================================================================
+ * Tests - stamp_fingerprint
+ * ============================================================================
+ */
+
+TEST(stamp_fingerprint_null_params) {
+  uint64_t fp = 0;
+
+  TEST_ASSERT_EQ(stamp_fingerprint(NULL, &fp, true), -1,
+                 "Should reject NULL ops");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(stamp_fingerprint(&syscall_ops_default, NULL, true), -1,
+                 "Should reject NULL fingerprint");
+}
+
+TEST(stamp_fingerprint_missing_sources) {
+  struct syscall_ops ops = syscall_ops_default;
+  uint64_t first = 0;
+  uint64_t second = 0;
+
+  ops.stat = mock_stat_enoent;
+  ops.scandir = mock_scandir_enoent;
+
+  TEST_ASSERT_EQ(stamp_fingerprint(&ops, &first, true), 0,
+                 "Missing sources should still fingerprint");
+  TEST_ASSERT_EQ(stamp_fingerprint(&ops, &second, true), 0,
+                 "Second fingerprint should succeed");
+  TEST_ASSERT_EQ(first, second, "Fingerprint should be stable");
+}
+
+TEST(stamp_fingerprint_tracks_changes) {
+  struct syscall_ops ops = syscall_ops_default;
+  uint64_t missing = 0;
+  uint64_t before = 0;
+  uint64_t after = 0;
+
+  ops.scandir = mock_scandir_enoent;
+  ops.stat = mock_stat_enoent;
+  TEST_ASSERT_EQ(stamp_fingerprint(&ops, &missing, true), 0,
+                 "Missing sources should fingerprint");
+
+  ops.stat = mock_stat_mtime;
+  mock_mtime = 1000;
+  TEST_ASSERT_EQ(stamp_fingerprint(&ops, &before, true), 0,
+                 "Present sources should fingerprint");
+  mock_mtime = 1001;
+  TEST_ASSERT_EQ(stamp_fingerprint(&ops, &after, true), 0,
+                 "Touched sources should fingerprint");
+
+  TEST_ASSERT_NOT_EQ(missing, before, "Creating a source should change it");
+  TEST_ASSERT_NOT_EQ(before, after, "Touching a source should change it");
+}
+
+TEST(stamp_fingerprint_errors) {
+  struct syscall_ops ops = syscall_ops_default;
+  uint64_t fp = 0;
+
+  ops.stat = mock_stat_eperm;
+  ops.scandir = mock_scandir_enoent;
+  TEST_ASSERT_EQ(stamp_fingerprint(&ops, &fp, true), -1,
+                 "Unreadable source should disable the cache");
+
+  ops.stat = mock_stat_enoent;
+  ops.scandir = mock_scandir_eperm;
+  TEST_ASSERT_EQ(stamp_fingerprint(&ops, &fp, true), -1,
+                 "Unreadable drop-in directory should disable the cache");
+}
+
+/* ============================================================================
+ * Tests - stamp_write / stamp_check
+ * ============================================================================
+ */
+
+TEST(stamp_write_null_params) {
+  config_t config = {0};
+  options_t opts = make_opts();
+
+  TEST_ASSERT_EQ(stamp_write(NULL, "/run", TEST_UID, "testuser", &config,
+                             &opts, TEST_FINGERPRINT),
+                 -1, "Should reject NULL ops");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(stamp_write(&syscall_ops_default, "/run", TEST_UID, NULL,
+                             &config, &opts, TEST_FINGERPRINT),
+                 -1, "Should reject NULL username");
+  TEST_ASSERT_EQ(stamp_check(NULL, "/run", TEST_UID, "testuser", &opts,
+                             TEST_FINGERPRINT),
+                 0, "NULL ops should be a miss");
+}
+
+TEST(stamp_write_then_check) {
+  options_t opts = make_opts();
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  TEST_ASSERT_EQ(write_test_stamp(&opts), 0, "Should write the stamp");
+  TEST_ASSERT_STR_EQ(read_stamp(),
+                     "v2 0123456789abcdef - 3 testuser 100000:65536 "
+                     "100000:65536\n",
+                     "Stamp should record the key and ranges");
+  TEST_ASSERT_EQ(stamp_check(&syscall_ops_default, stamp_dir, TEST_UID,
+                             "testuser", &opts, TEST_FINGERPRINT),
+                 1, "Fresh stamp should be a hit");
+
+  TEST_ASSERT_EQ(write_test_stamp(&opts), 0, "Should replace the stamp");
+  TEST_ASSERT_EQ(stamp_check(&syscall_ops_default, stamp_dir, TEST_UID,
+                             "testuser", &opts, TEST_FINGERPRINT),
+                 1, "Replaced stamp should be a hit");
+
+  cleanup_tmpdir();
+}
+
+TEST(stamp_write_single_mode) {
+  options_t opts = make_opts();
+
+  opts.do_subgid = false;
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  TEST_ASSERT_EQ(write_test_stamp(&opts), 0, "Should write the stamp");
+  TEST_ASSERT_STR_EQ(read_stamp(),
+                     "v2 0123456789abcdef - 1 testuser 100000:65536 -\n",
+                     "Unrequested mode should be recorded as '-'");
+
+  cleanup_tmpdir();
+}
+
+TEST(stamp_check_misses) {
+  options_t opts = make_opts();
+  options_t subuid_only = make_opts();
+
+  subuid_only.do_subgid = false;
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  TEST_ASSERT_EQ(stamp_check(&syscall_ops_default, stamp_dir, TEST_UID,
+                             "testuser", &opts, TEST_FINGERPRINT),
+                 0, "Missing stamp should be a miss");
+
+  TEST_ASSERT_EQ(write_test_stamp(&opts), 0, "Should write the stamp");
+  TEST_ASSERT_EQ(stamp_check(&syscall_ops_default, stamp_dir, TEST_UID,
+                             "testuser", &opts, TEST_FINGERPRINT + 1),
+                 0, "Changed configuration should be a miss");
+  TEST_ASSERT_EQ(stamp_check(&syscall_ops_default, stamp_dir, TEST_UID,
+                             "testuser", &subuid_only, TEST_FINGERPRINT),
+                 0, "Changed modes should be a miss");
+  TEST_ASSERT_EQ(stamp_check(&syscall_ops_default, stamp_dir, TEST_UID,
+                             "testuser2", &opts, TEST_FINGERPRINT),
+                 0, "Renamed user should be a miss");
+  TEST_ASSERT_EQ(stamp_check(&syscall_ops_default, stamp_dir, TEST_UID + 1,
+                             "testuser", &opts, TEST_FINGERPRINT),
+                 0, "Other UID should be a miss");
+
+  cleanup_tmpdir();
+}
+
+TEST(stamp_check_databases_changed) {
+  struct syscall_ops ops = syscall_ops_default;
+  options_t opts = make_opts();
+  config_t config = {0};
+
+  config_factory(&config);
+  ops.stat = mock_stat_mtime;
+  mock_mtime = 1000;
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  TEST_ASSERT_EQ(stamp_write(&ops, stamp_dir, TEST_UID, "testuser", &config,
+                             &opts, TEST_FINGERPRINT),
+                 0, "Should write the stamp");
+  TEST_ASSERT_EQ(stamp_check(&ops, stamp_dir, TEST_UID, "testuser", &opts,
+                             TEST_FINGERPRINT),
+                 1, "Untouched databases should be a hit");
+
+  /* Another tool rewrote /etc/subuid or /etc/subgid */
+  mock_mtime = 1001;
+  TEST_ASSERT_EQ(stamp_check(&ops, stamp_dir, TEST_UID, "testuser", &opts,
+                             TEST_FINGERPRINT),
+                 0, "Rewritten databases should be a miss");
+
+  ops.stat = mock_stat_eperm;
+  TEST_ASSERT_EQ(stamp_check(&ops, stamp_dir, TEST_UID, "testuser", &opts,
+                             TEST_FINGERPRINT),
+                 0, "Unreadable databases should be a miss");
+  TEST_ASSERT_EQ(stamp_write(&ops, stamp_dir, TEST_UID, "testuser", &config,
+                             &opts, TEST_FINGERPRINT),
+                 -1, "Unreadable databases should not be stamped");
+
+  cleanup_tmpdir();
+}
+
+TEST(stamp_check_untrusted) {
+  options_t opts = make_opts();
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  TEST_ASSERT_EQ(write_test_stamp(&opts), 0, "Should write the stamp");
+  TEST_ASSERT_EQ(chmod(stamp_file(), 0666), 0, "Should loosen the mode");
+  TEST_ASSERT_EQ(stamp_check(&syscall_ops_default, stamp_dir, TEST_UID,
+                             "testuser", &opts, TEST_FINGERPRINT),
+                 0, "World-writable stamp should be ignored");
+
+  cleanup_tmpdir();
+}
+
+TEST(stamp_write_own_temp_file) {
+  options_t opts = make_opts();
+  char mine[PATH_MAX] = {0};
+  char theirs[PATH_MAX] = {0};
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  TEST_ASSERT_EQ(mkdir(stamp_dir, 0755), 0, "Should create the stamp dir");
+  (void)snprintf(mine, sizeof(mine), "%s/.%u.%ld.tmp", stamp_dir, TEST_UID,
+                 (long)getpid());
+  (void)snprintf(theirs, sizeof(theirs), "%s/.%u.%ld.tmp", stamp_dir,
+                 TEST_UID, (long)getpid() + 1);
+
+  /* Another writer half way through, and a leftover under our PID */
+  FILE *fp = fopen(theirs, "w");
+  TEST_ASSERT_NOT_EQ(fp, NULL, "Should create the other writer's file");
+  (void)fputs("v1 partial", fp);
+  (void)fclose(fp);
+  fp = fopen(mine, "w");
+  TEST_ASSERT_NOT_EQ(fp, NULL, "Should create the leftover");
+  (void)fclose(fp);
+
+  TEST_ASSERT_EQ(write_test_stamp(&opts), 0, "Should write the stamp");
+  TEST_ASSERT_EQ(stamp_check(&syscall_ops_default, stamp_dir, TEST_UID,
+                             "testuser", &opts, TEST_FINGERPRINT),
+                 1, "Stamp should be a hit");
+  TEST_ASSERT_STR_EQ(read_file(theirs), "v1 partial",
+                     "Should leave the other writer's file alone");
+  TEST_ASSERT_EQ(access(mine, F_OK), -1, "Should replace the leftover");
+
+  (void)unlink(theirs);
+  cleanup_tmpdir();
+}
+
+TEST(stamp_write_mkdir_fails) {
+  struct syscall_ops ops = syscall_ops_default;
+  config_t config = {0};
+  options_t opts = make_opts();
+
+  config_factory(&config);
+  ops.mkdir = mock_mkdir_eacces;
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  TEST_ASSERT_EQ(stamp_write(&ops, stamp_dir, TEST_UID, "testuser", &config,
+                             &opts, TEST_FINGERPRINT),
+                 -1, "Should fail without a stamp directory");
+  TEST_ASSERT_EQ(errno, EACCES, "Should keep the mkdir error");
+
+  cleanup_tmpdir();
+}
+
+int main(int argc, char **argv) {
+  TEST_INIT(10, false, false); /* timeout, verbose, duration */
+
+  /* stamp_fingerprint */
+  RUN_TEST(stamp_fingerprint_null_params);
+  RUN_TEST(stamp_fingerprint_missing_sources);
+  RUN_TEST(stamp_fingerprint_tracks_changes);
+  RUN_TEST(stamp_fingerprint_errors);
+
+  /* stamp_write / stamp_check */
+  RUN_TEST(stamp_write_null_params);
+  RUN_TEST(stamp_write_then_check);
+  RUN_TEST(stamp_write_single_mode);
+  RUN_TEST(stamp_check_misses);
+  RUN_TEST(stamp_check_databases_changed);
+  RUN_TEST(stamp_check_untrusted);
+  RUN_TEST(stamp_write_own_temp_file);
+  RUN_TEST(stamp_write_mkdir_fails);
+
+  return TEST_EXECUTE();
+}
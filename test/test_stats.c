@@ -0,0 +1,269 @@
+/**
+ * test_stats.c - Tests for --stats timings, counters and reports
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "test_framework.h"
+#include "test_helpers/all.h"
+
+/* Largest datagram the journal tests expect to receive */
+#define TEST_ENTRY_MAX 4096
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================
+ */
+
+/**
+ * fixed_stats - Totals with a distinct value in every slot
+ */
+static stats_t fixed_stats(void) {
+  stats_t stats = {0};
+  for (size_t i = 0; i < STATS_PHASES; i++) {
+    stats.usec[i] = 100 + i;
+  }
+  for (size_t i = 0; i < STATS_COUNTERS; i++) {
+    stats.count[i] = 10 + i;
+  }
+  return stats;
+}
+
+/**
+ * bind_journal - Bind a datagram socket standing in for journald
+ * @dir: Set to a fresh directory holding the socket
+ * @path: Set to the socket path
+ *
+ * Return: Bound socket, -1 on error
+ */
+static int bind_journal(char dir[static 32], char path[static 64]) {
+  (void)strcpy(dir, "/tmp/test_stats.XXXXXX");
+  if (mkdtemp(dir) == NULL) {
+    return -1;
+  }
+  (void)snprintf(path, 64, "%s/journal", dir);
+
+  int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  (void)snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+  if (fd < 0 ||
+      bind(fd, (const struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    return -1;
+  }
+  return fd;
+}
+
+/**
+ * unbind_journal - Remove what bind_journal() created
+ */
+static void unbind_journal(int fd, const char *dir, const char *path) {
+  (void)close(fd);
+  (void)unlink(path);
+  (void)rmdir(dir);
+}
+
+/* ============================================================================
+ * Tests
+ * ============================================================================
+ */
+
+TEST(stats_counters) {
+  stats_t stats = {0};
+
+  stats_reset();
+  stats_count(STATS_SPAWNS, 1);
+  stats_count(STATS_SPAWNS, 2);
+  stats_count(STATS_BYTES, 4096);
+  stats_count(STATS_COUNTERS, 1);
+  stats_snapshot(&stats);
+  TEST_ASSERT_EQ(stats.count[STATS_SPAWNS], 3, "Should add up the spawns");
+  TEST_ASSERT_EQ(stats.count[STATS_BYTES], 4096, "Should add up the bytes");
+  TEST_ASSERT_EQ(stats.count[STATS_FILES], 0, "Should leave the rest alone");
+
+  stats_reset();
+  stats_snapshot(&stats);
+  TEST_ASSERT_EQ(stats.count[STATS_SPAWNS], 0, "Should reset the counters");
+  stats_snapshot(NULL);
+}
+
+TEST(stats_phases) {
+  stats_t stats = {0};
+
+  stats_reset();
+  uint64_t started = stats_now();
+  usleep(2000);
+  stats_phase_add(STATS_RESOLVE, started);
+  stats_phase_add(STATS_CHECK, stats_now() + 1000000);
+  stats_phase_add(STATS_PHASES, started);
+  stats_snapshot(&stats);
+  TEST_ASSERT_EQ(stats.usec[STATS_RESOLVE] >= 2000, true,
+                 "Should charge the time spent");
+  TEST_ASSERT_EQ(stats.usec[STATS_CHECK], 0,
+                 "A start in the future charges nothing");
+
+  stats_reset();
+  stats_snapshot(&stats);
+  TEST_ASSERT_EQ(stats.usec[STATS_RESOLVE], 0, "Should reset the phases");
+}
+
+TEST(stats_parse_formats) {
+  unsigned int formats = 0;
+
+  TEST_ASSERT_EQ(stats_parse_formats(NULL, &formats), 0,
+                 "No argument is allowed");
+  TEST_ASSERT_EQ(formats, STATS_FORMAT_JSON, "Should default to JSON");
+  TEST_ASSERT_EQ(stats_parse_formats("journal", &formats), 0,
+                 "Should accept journal");
+  TEST_ASSERT_EQ(formats, STATS_FORMAT_JOURNAL, "Should select the journal");
+  TEST_ASSERT_EQ(stats_parse_formats("journal,json", &formats), 0,
+                 "Should accept a list");
+  TEST_ASSERT_EQ(formats, STATS_FORMAT_JSON | STATS_FORMAT_JOURNAL,
+                 "Should select both");
+
+  TEST_ASSERT_EQ(stats_parse_formats("xml", &formats), -1,
+                 "Should reject unknown formats");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(stats_parse_formats("", &formats), -1,
+                 "Should reject an empty format");
+  TEST_ASSERT_EQ(stats_parse_formats("json,", &formats), -1,
+                 "Should reject a trailing comma");
+  TEST_ASSERT_EQ(stats_parse_formats("jsonl", &formats), -1,
+                 "Should not match a prefix");
+  TEST_ASSERT_EQ(stats_parse_formats("json", NULL), -1,
+                 "Should reject NULL formats");
+}
+
+TEST(stats_print_json) {
+  stats_t stats = fixed_stats();
+  char buf[1024] = {0};
+
+  FILE *out = fmemopen(buf, sizeof(buf), "w");
+  TEST_ASSERT_NOT_EQ(out, NULL, "Test setup: fmemopen failed");
+  TEST_ASSERT_EQ(stats_print_json(&stats, "testuser", 0, out), 0,
+                 "Should print the object");
+  (void)fclose(out);
+  TEST_ASSERT_STR_EQ(buf,
+                     "{\"user\":\"testuser\",\"status\":0,"
+                     "\"config_usec\":100,\"resolve_usec\":101,"
+                     "\"check_usec\":102,\"write_usec\":103,"
+                     "\"lock_usec\":104,\"total_usec\":105,"
+                     "\"spawns\":10,\"files_parsed\":11,"
+                     "\"lines_parsed\":12,\"bytes_read\":13}\n",
+                     "Should print every field on one line");
+
+  (void)memset(buf, 0, sizeof(buf));
+  out = fmemopen(buf, sizeof(buf), "w");
+  TEST_ASSERT_NOT_EQ(out, NULL, "Test setup: fmemopen failed");
+  TEST_ASSERT_EQ(stats_print_json(&stats, "a\"b\\\n", 3, out), 0,
+                 "Should print the object");
+  (void)fclose(out);
+  const char *escaped = "{\"user\":\"a\\\"b\\\\\\u000a\",\"status\":3,";
+  TEST_ASSERT_EQ(strncmp(buf, escaped, strlen(escaped)), 0,
+                 "Should escape the username");
+
+  (void)memset(buf, 0, sizeof(buf));
+  out = fmemopen(buf, sizeof(buf), "w");
+  TEST_ASSERT_NOT_EQ(out, NULL, "Test setup: fmemopen failed");
+  TEST_ASSERT_EQ(stats_print_json(&stats, "", 1, out), 0,
+                 "Should print the object");
+  (void)fclose(out);
+  TEST_ASSERT_EQ(strncmp(buf, "{\"status\":1,", strlen("{\"status\":1,")), 0,
+                 "Should leave out an unresolved user");
+
+  TEST_ASSERT_EQ(stats_print_json(NULL, "testuser", 0, stdout), -1,
+                 "Should reject NULL stats");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(stats_print_json(&stats, "testuser", 0, NULL), -1,
+                 "Should reject NULL stream");
+}
+
+TEST(stats_send_journal) {
+  stats_t stats = fixed_stats();
+  char dir[32] = {0};
+  char path[64] = {0};
+  char entry[TEST_ENTRY_MAX] = {0};
+
+  int fd = bind_journal(dir, path);
+  TEST_ASSERT_NOT_EQ(fd, -1, "Test setup: cannot bind journal socket");
+
+  TEST_ASSERT_EQ(stats_send_journal(path, &stats, "testuser", 0), 0,
+                 "Should send the entry");
+  ssize_t len = recv(fd, entry, sizeof(entry) - 1, 0);
+  TEST_ASSERT_EQ(len > 0, true, "Should receive one datagram");
+  TEST_ASSERT_EQ(strncmp(entry, "MESSAGE=static-subid: testuser: status 0 ",
+                         strlen("MESSAGE=static-subid: testuser: status 0 ")),
+                 0, "Should start with a message");
+  TEST_ASSERT_NOT_EQ(strstr(entry, "\nSYSLOG_IDENTIFIER=static-subid\n"),
+                     NULL, "Should carry the identifier");
+  TEST_ASSERT_NOT_EQ(strstr(entry, "\nSTATIC_SUBID_USER=testuser\n"), NULL,
+                     "Should carry the user");
+  TEST_ASSERT_NOT_EQ(strstr(entry, "\nSTATIC_SUBID_RESOLVE_USEC=101\n"), NULL,
+                     "Should carry the resolve time");
+  TEST_ASSERT_NOT_EQ(strstr(entry, "\nSTATIC_SUBID_TOTAL_USEC=105\n"), NULL,
+                     "Should carry the total time");
+  TEST_ASSERT_NOT_EQ(strstr(entry, "\nSTATIC_SUBID_BYTES_READ=13\n"), NULL,
+                     "Should carry the counters");
+  TEST_ASSERT_EQ(entry[len - 1], '\n', "Every field ends with a newline");
+
+  (void)memset(entry, 0, sizeof(entry));
+  TEST_ASSERT_EQ(stats_send_journal(path, &stats, "bad\nname", 1), 0,
+                 "Should send the entry");
+  len = recv(fd, entry, sizeof(entry) - 1, 0);
+  TEST_ASSERT_EQ(len > 0, true, "Should receive one datagram");
+  TEST_ASSERT_EQ(strstr(entry, "bad"), NULL,
+                 "Should leave out a name with a newline");
+  TEST_ASSERT_NOT_EQ(strstr(entry, "\nSTATIC_SUBID_STATUS=1\n"), NULL,
+                     "Should carry the status");
+
+  unbind_journal(fd, dir, path);
+
+  TEST_ASSERT_EQ(stats_send_journal(path, &stats, "testuser", 0), -1,
+                 "Should fail without a journal");
+  TEST_ASSERT_EQ(stats_send_journal(NULL, NULL, "testuser", 0), -1,
+                 "Should reject NULL stats");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+
+  char long_path[200] = {0};
+  (void)memset(long_path, 'x', sizeof(long_path) - 1);
+  TEST_ASSERT_EQ(stats_send_journal(long_path, &stats, "testuser", 0), -1,
+                 "Should reject an overlong path");
+  TEST_ASSERT_EQ(errno, ENAMETOOLONG, "Should set the correct error code");
+
+  char long_name[3000] = {0};
+  (void)memset(long_name, 'x', sizeof(long_name) - 1);
+  TEST_ASSERT_EQ(stats_send_journal(path, &stats, long_name, 0), -1,
+                 "Should reject an entry that does not fit");
+  TEST_ASSERT_EQ(errno, EMSGSIZE, "Should set the correct error code");
+}
+
+TEST(stats_report_nothing) {
+  /* Without a format nothing is printed or sent */
+  stats_report(0, "testuser", 0);
+}
+
+int main(int argc, char **argv) {
+  TEST_INIT(10, false, false); /* timeout, verbose, duration */
+
+  RUN_TEST(stats_counters);
+  RUN_TEST(stats_phases);
+  RUN_TEST(stats_parse_formats);
+  RUN_TEST(stats_print_json);
+  RUN_TEST(stats_send_journal);
+  RUN_TEST(stats_report_nothing);
+
+  return TEST_EXECUTE();
+}
@@ -44,7 +44,8 @@ enum {
 enum {
   GETSUBIDS_SUBUID_ARGC = 2, /* getsubids <username> */
   GETSUBIDS_SUBGID_ARGC = 3, /* getsubids -g <username> */
-  USERMOD_ARGC = 4           /* usermod <flag> <range> <username> */
+  USERMOD_ARGC = 4,          /* usermod <flag> <range> <username> */
+  USERMOD_BOTH_ARGC = 6      /* usermod <flag> <range> <flag> <range> <user> */
 };
 
 /* File action control constants */
@@ -379,6 +380,97 @@ static pid_t mock_waitpid(pid_t pid, int *wstatus, int options) {
   return pid;
 }
 
+/* ============================================================================
+ * Concurrent Spawn Mocks
+ *
+ * check_subid_exists_many() keeps several children running at once, so
+ * these mocks hand out a PID per spawn and answer waitpid() per child.
+ * The answer depends on the username: "has*" exists, "err*" is an error,
+ * anything else has no ranges; "nospawn*" cannot be spawned at all.
+ * ============================================================================
+ */
+
+/* Most children check_subid_exists_many() tests spawn */
+enum { MANY_MAX_SPAWNS = 16 };
+
+/* Username of each child, indexed by PID - DEFAULT_MOCK_PID */
+static const char *many_users[MANY_MAX_SPAWNS];
+static int many_spawned = 0;
+static int many_running = 0;
+static int many_peak = 0;
+
+/**
+ * mock_posix_spawn_many - Start a child, tracking how many are running
+ */
+static int mock_posix_spawn_many(pid_t *restrict pid,
+                                 const char *restrict path,
+                                 const posix_spawn_file_actions_t *file_actions,
+                                 const posix_spawnattr_t *restrict attrp,
+                                 char *const argv[restrict],
+                                 char *const envp[restrict]) {
+  (void)path;
+  (void)file_actions;
+  (void)attrp;
+  (void)envp;
+
+  const char *username = NULL;
+  for (size_t i = 0; argv[i] != NULL; i++) {
+    username = argv[i];
+  }
+  if (strncmp(username, "nospawn", 7) == 0 ||
+      many_spawned >= MANY_MAX_SPAWNS) {
+    return EAGAIN;
+  }
+
+  many_users[many_spawned] = username;
+  *pid = DEFAULT_MOCK_PID + many_spawned;
+  many_spawned++;
+  many_running++;
+  if (many_running > many_peak) {
+    many_peak = many_running;
+  }
+  return 0;
+}
+
+/**
+ * mock_waitpid_many - Reap a child from mock_posix_spawn_many()
+ */
+static pid_t mock_waitpid_many(pid_t pid, int *wstatus, int options) {
+  (void)options;
+
+  int idx = pid - DEFAULT_MOCK_PID;
+  if (idx < 0 || idx >= many_spawned || many_users[idx] == NULL) {
+    errno = ECHILD;
+    return -1;
+  }
+
+  const char *username = many_users[idx];
+  many_users[idx] = NULL;
+  many_running--;
+
+  int code = strncmp(username, "has", 3) == 0   ? GETSUBIDS_EXIT_EXISTS
+             : strncmp(username, "err", 3) == 0 ? GETSUBIDS_EXIT_ERROR
+                                                : GETSUBIDS_EXIT_NOT_FOUND;
+  *wstatus = code << EXIT_CODE_SHIFT;
+  return pid;
+}
+
+/**
+ * make_many_spawn_ops - Ops for check_subid_exists_many() tests
+ */
+static struct syscall_ops make_many_spawn_ops(void) {
+  struct syscall_ops ops = syscall_ops_default;
+
+  ops.posix_spawn = mock_posix_spawn_many;
+  ops.waitpid = mock_waitpid_many;
+  (void)memset(many_users, 0, sizeof(many_users));
+  many_spawned = 0;
+  many_running = 0;
+  many_peak = 0;
+
+  return ops;
+}
+
 /* ============================================================================
  * Fixture Builders
  *
@@ -818,6 +910,76 @@ TEST(check_subid_exists_unexpected_exit_code) {
   TEST_ASSERT_EQ(result, -1, "Should fail on unexpected exit code");
 }
 
+/* ============================================================================
+ * Tests - check_subid_exists_many
+ * ============================================================================
+ */
+
+TEST(check_subid_exists_many_null_params) {
+  struct syscall_ops ops = make_many_spawn_ops();
+  const char *users[] = {"hasuser"};
+  int results[] = {5};
+
+  check_subid_exists_many(NULL, users, 1, SUBUID, 4, results);
+  TEST_ASSERT_EQ(results[0], -1, "NULL ops leaves the answer unknown");
+  results[0] = 5;
+  check_subid_exists_many(&ops, NULL, 1, SUBUID, 4, results);
+  TEST_ASSERT_EQ(results[0], -1, "NULL usernames leaves it unknown");
+  results[0] = 5;
+  check_subid_exists_many(&ops, users, 1, (subid_mode_t)99, 4, results);
+  TEST_ASSERT_EQ(results[0], -1, "Invalid mode leaves it unknown");
+  check_subid_exists_many(&ops, users, 1, SUBUID, 4, NULL);
+  TEST_ASSERT_EQ(many_spawned, 0, "Should never spawn");
+}
+
+TEST(check_subid_exists_many_results) {
+  struct syscall_ops ops = make_many_spawn_ops();
+  const char *users[] = {"hasone", "noone", NULL, "errone", "hastwo"};
+  int results[5] = {0};
+
+  check_subid_exists_many(&ops, users, 5, SUBGID, 2, results);
+
+  TEST_ASSERT_EQ(results[0], 1, "Ranges exist");
+  TEST_ASSERT_EQ(results[1], 0, "No ranges");
+  TEST_ASSERT_EQ(results[2], -1, "Skipped entries stay unknown");
+  TEST_ASSERT_EQ(results[3], -1, "Errors are unknown");
+  TEST_ASSERT_EQ(results[4], 1, "Ranges exist");
+  TEST_ASSERT_EQ(many_spawned, 4, "One child per user");
+  TEST_ASSERT_EQ(many_running, 0, "Every child is reaped");
+}
+
+TEST(check_subid_exists_many_in_flight_limit) {
+  struct syscall_ops ops = make_many_spawn_ops();
+  const char *users[] = {"has0", "no1", "has2", "no3", "has4",
+                         "no5",  "has6", "no7", "has8"};
+  int results[9] = {0};
+
+  check_subid_exists_many(&ops, users, 9, SUBUID, 3, results);
+  TEST_ASSERT_EQ(many_peak, 3, "At most three children at a time");
+  for (int i = 0; i < 9; i++) {
+    TEST_ASSERT_EQ(results[i], i % 2 == 0 ? 1 : 0,
+                   "Answers land on their own user");
+  }
+
+  ops = make_many_spawn_ops();
+  check_subid_exists_many(&ops, users, 9, SUBUID, 0, results);
+  TEST_ASSERT_EQ(many_peak, 1, "Zero means one at a time");
+  TEST_ASSERT_EQ(results[8], 1, "Answers land on their own user");
+}
+
+TEST(check_subid_exists_many_spawn_fails) {
+  struct syscall_ops ops = make_many_spawn_ops();
+  const char *users[] = {"hasone", "nospawn", "noone"};
+  int results[3] = {0};
+
+  check_subid_exists_many(&ops, users, 3, SUBUID, 2, results);
+
+  TEST_ASSERT_EQ(results[0], 1, "Ranges exist");
+  TEST_ASSERT_EQ(results[1], -1, "Unspawned is unknown");
+  TEST_ASSERT_EQ(results[2], 0, "No ranges");
+  TEST_ASSERT_EQ(many_running, 0, "Every child is reaped");
+}
+
 /* ============================================================================
  * Tests - set_subid_range: Input Validation
  * ============================================================================
@@ -1052,6 +1214,64 @@ TEST(set_subid_range_range_formatting) {
                      "Large range should format correctly");
 }
 
+/* ============================================================================
+ * Tests - set_subid_ranges: Combined Assignment
+ * ============================================================================
+ */
+
+TEST(set_subid_ranges_both_args_correct) {
+  struct syscall_ops ops;
+  const subid_range_t subuid = {.start = 100000, .count = 65536};
+  const subid_range_t subgid = {.start = 200000, .count = 4096};
+  int result;
+
+  current_fixture = make_fixture_process_exits(USERMOD_EXIT_SUCCESS);
+  ops = make_default_spawn_ops();
+  result = set_subid_ranges(&ops, "alice", &subuid, &subgid, false, true);
+
+  TEST_ASSERT_EQ(result, 0, "Should succeed");
+  TEST_ASSERT_EQ(captured_argv_count, USERMOD_BOTH_ARGC,
+                 "Should pass both ranges to one usermod");
+  TEST_ASSERT_STR_EQ(captured_argv[1], "--add-subuids",
+                     "argv[1] should be --add-subuids");
+  TEST_ASSERT_STR_EQ(captured_argv[2], "100000-165535",
+                     "argv[2] should be the subuid range");
+  TEST_ASSERT_STR_EQ(captured_argv[3], "--add-subgids",
+                     "argv[3] should be --add-subgids");
+  TEST_ASSERT_STR_EQ(captured_argv[4], "200000-204095",
+                     "argv[4] should be the subgid range");
+  TEST_ASSERT_STR_EQ(captured_argv[5], "alice", "argv[5] should be username");
+}
+
+TEST(set_subid_ranges_invalid_ranges) {
+  struct syscall_ops ops;
+  const subid_range_t good = {.start = 100000, .count = 65536};
+  const subid_range_t empty = {.start = 100000, .count = 0};
+
+  current_fixture = make_fixture_process_exits(USERMOD_EXIT_SUCCESS);
+  ops = make_default_spawn_ops();
+
+  TEST_ASSERT_EQ(set_subid_ranges(&ops, "alice", NULL, NULL, false, true), -1,
+                 "Should reject a call with nothing to assign");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(set_subid_ranges(&ops, "alice", &good, &empty, false, true),
+                 -1, "Should reject the call if either range is invalid");
+  TEST_ASSERT_EQ(captured_argv == NULL, true, "Should not spawn usermod");
+}
+
+TEST(set_subid_ranges_noop) {
+  struct syscall_ops ops;
+  const subid_range_t subuid = {.start = 100000, .count = 65536};
+  const subid_range_t subgid = {.start = 100000, .count = 65536};
+
+  current_fixture = make_fixture_process_exits(USERMOD_EXIT_SUCCESS);
+  ops = make_default_spawn_ops();
+
+  TEST_ASSERT_EQ(set_subid_ranges(&ops, "alice", &subuid, &subgid, true, true),
+                 0, "Should succeed in noop mode");
+  TEST_ASSERT_EQ(captured_argv == NULL, true, "Should not spawn usermod");
+}
+
 /* ============================================================================
  * Tests - set_subid_range: System Call Failures
  * ============================================================================
@@ -1300,6 +1520,10 @@ int main(int argc, char **argv) {
   RUN_TEST(check_subid_exists_waitpid_fails);
   RUN_TEST(check_subid_exists_abnormal_exit);
   RUN_TEST(check_subid_exists_unexpected_exit_code);
+  RUN_TEST(check_subid_exists_many_null_params);
+  RUN_TEST(check_subid_exists_many_results);
+  RUN_TEST(check_subid_exists_many_in_flight_limit);
+  RUN_TEST(check_subid_exists_many_spawn_fails);
 
   /* set_subid_range: Input validation */
   RUN_TEST(set_subid_range_null_ops);
@@ -1322,6 +1546,11 @@ int main(int argc, char **argv) {
   RUN_TEST(set_subid_range_subgid_args_correct);
   RUN_TEST(set_subid_range_range_formatting);
 
+  /* set_subid_ranges: Combined assignment */
+  RUN_TEST(set_subid_ranges_both_args_correct);
+  RUN_TEST(set_subid_ranges_invalid_ranges);
+  RUN_TEST(set_subid_ranges_noop);
+
   /* set_subid_range: System call failures */
   RUN_TEST(set_subid_range_init_fails);
   RUN_TEST(set_subid_range_addopen_fails);
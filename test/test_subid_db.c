@@ -0,0 +1,337 @@
+/**
+ * test_subid_db.c - Tests for in-process subuid/subgid database access
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "test_framework.h"
+#include "test_helpers/all.h"
+
+/* ============================================================================
+ * Constants
+ * ============================================================================
+ */
+
+/* Fake descriptor handed out by mock_open_db */
+enum { MOCK_FD_DB = 300 };
+
+/* UID for the test user (matches TEST_UID_STANDARD) */
+enum { DB_TEST_UID = 1000 };
+
+/* ============================================================================
+ * Mock Database
+ * ============================================================================
+ */
+
+/* Content served for every database open */
+static const char *mock_db_content = "";
+
+/**
+ * mock_open_db - Hand out the fake database descriptor
+ */
+static int mock_open_db(const char *pathname, int flags, ...) {
+  (void)pathname;
+  (void)flags;
+  return MOCK_FD_DB;
+}
+
+/**
+ * mock_fdopen_db - Serve mock_db_content as a real stream
+ */
+static FILE *mock_fdopen_db(int fd, const char *mode) {
+  (void)fd;
+  (void)mode;
+  return fmemopen((void *)(uintptr_t)mock_db_content, strlen(mock_db_content),
+                  "r");
+}
+
+/**
+ * make_db_ops - Ops reading @content for any database path
+ * @content: Database contents
+ */
+static struct syscall_ops make_db_ops(const char *content) {
+  struct syscall_ops ops = syscall_ops_default;
+
+  mock_db_content = content;
+  ops.open = mock_open_db;
+  ops.close = mock_close_any;
+  ops.fstat = mock_fstat_root_file;
+  ops.fdopen = mock_fdopen_db;
+  return ops;
+}
+
+/* ============================================================================
+ * Tests - subid_db_path
+ * ============================================================================
+ */
+
+TEST(subid_db_path_modes) {
+  TEST_ASSERT_STR_EQ(subid_db_path(SUBUID), SUBUID_PATH,
+                     "SUBUID should map to SUBUID_PATH");
+  TEST_ASSERT_STR_EQ(subid_db_path(SUBGID), SUBGID_PATH,
+                     "SUBGID should map to SUBGID_PATH");
+  TEST_ASSERT_EQ(subid_db_path((subid_mode_t)99), NULL,
+                 "Invalid mode should map to NULL");
+}
+
+/* ============================================================================
+ * Tests - subid_db_parse_line
+ * ============================================================================
+ */
+
+TEST(subid_db_parse_line_valid) {
+  char line[] = "alice:100000:65536\n";
+  const char *owner = NULL;
+  uint32_t start = 0;
+  uint32_t count = 0;
+
+  TEST_ASSERT_EQ(subid_db_parse_line(line, &owner, &start, &count), 0,
+                 "Should parse a valid entry");
+  TEST_ASSERT_STR_EQ(owner, "alice", "Should extract owner");
+  TEST_ASSERT_EQ(start, 100000, "Should extract start");
+  TEST_ASSERT_EQ(count, 65536, "Should extract count");
+}
+
+TEST(subid_db_parse_line_blank) {
+  char blank[] = "   \n";
+  char comment[] = "# alice:1:1\n";
+  const char *owner = NULL;
+  uint32_t start = 0;
+  uint32_t count = 0;
+
+  TEST_ASSERT_EQ(subid_db_parse_line(blank, &owner, &start, &count), 1,
+                 "Blank line should report 1");
+  TEST_ASSERT_EQ(subid_db_parse_line(comment, &owner, &start, &count), 1,
+                 "Comment line should report 1");
+}
+
+TEST(subid_db_parse_line_malformed) {
+  char no_colon[] = "alice\n";
+  char one_colon[] = "alice:100000\n";
+  char empty_owner[] = ":100000:65536\n";
+  char bad_start[] = "alice:abc:65536\n";
+  char bad_count[] = "alice:100000:-1\n";
+  char extra[] = "alice:100000:65536:1\n";
+  const char *owner = NULL;
+  uint32_t start = 0;
+  uint32_t count = 0;
+
+  TEST_ASSERT_EQ(subid_db_parse_line(no_colon, &owner, &start, &count), -1,
+                 "Should reject missing separators");
+  TEST_ASSERT_EQ(subid_db_parse_line(one_colon, &owner, &start, &count), -1,
+                 "Should reject missing count");
+  TEST_ASSERT_EQ(subid_db_parse_line(empty_owner, &owner, &start, &count), -1,
+                 "Should reject empty owner");
+  TEST_ASSERT_EQ(subid_db_parse_line(bad_start, &owner, &start, &count), -1,
+                 "Should reject non-numeric start");
+  TEST_ASSERT_EQ(subid_db_parse_line(bad_count, &owner, &start, &count), -1,
+                 "Should reject signed count");
+  TEST_ASSERT_EQ(subid_db_parse_line(extra, &owner, &start, &count), -1,
+                 "Should reject extra fields");
+  TEST_ASSERT_EQ(subid_db_parse_line(NULL, &owner, &start, &count), -1,
+                 "Should reject NULL line");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+}
+
+/* ============================================================================
+ * Tests - subid_db_lookup
+ * ============================================================================
+ */
+
+TEST(subid_db_lookup_null_params) {
+  size_t found = 0;
+
+  TEST_ASSERT_EQ(subid_db_lookup(NULL, "/x", "alice", 1, NULL, 0, &found,
+                                 false),
+                 -1, "Should reject NULL ops");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(subid_db_lookup(&syscall_ops_default, "/x", "alice", 1, NULL,
+                                 1, &found, false),
+                 -1, "Should reject NULL ranges with non-zero max");
+  TEST_ASSERT_EQ(subid_db_lookup(&syscall_ops_default, "/x", "alice", 1, NULL,
+                                 0, NULL, false),
+                 -1, "Should reject NULL found");
+}
+
+TEST(subid_db_lookup_by_name_and_uid) {
+  struct syscall_ops ops = make_db_ops("bob:165536:65536\n"
+                                       "testuser:100000:65536\n"
+                                       "garbage line\n"
+                                       "1000:300000:10\n"
+                                       "10000:400000:10\n");
+  subid_range_t ranges[4] = {0};
+  size_t found = 0;
+
+  TEST_ASSERT_EQ(subid_db_lookup(&ops, SUBUID_PATH, "testuser", DB_TEST_UID,
+                                 ranges, 4, &found, true),
+                 0, "Should succeed");
+  TEST_ASSERT_EQ(found, 2, "Should match by name and by UID only");
+  TEST_ASSERT_EQ(ranges[0].start, 100000, "First match by name");
+  TEST_ASSERT_EQ(ranges[1].start, 300000, "Second match by UID");
+  TEST_ASSERT_EQ(ranges[1].count, 10, "Should keep the count");
+}
+
+TEST(subid_db_lookup_counts_past_capacity) {
+  struct syscall_ops ops = make_db_ops("testuser:1:1\ntestuser:2:1\n"
+                                       "testuser:3:1\n");
+  subid_range_t ranges[1] = {0};
+  size_t found = 0;
+
+  TEST_ASSERT_EQ(subid_db_lookup(&ops, SUBUID_PATH, "testuser", DB_TEST_UID,
+                                 ranges, 1, &found, false),
+                 0, "Should succeed");
+  TEST_ASSERT_EQ(found, 3, "Should count every match");
+  TEST_ASSERT_EQ(ranges[0].start, 1, "Should store the first match");
+}
+
+TEST(subid_db_lookup_skips_overlong_lines) {
+  static char content[MAX_LINE_LEN * 3];
+  size_t pos = 0;
+
+  /* An overlong line that would match if it were truncated */
+  pos += (size_t)snprintf(content, sizeof(content), "testuser:1:1");
+  memset(content + pos, ' ', MAX_LINE_LEN * 2);
+  pos += MAX_LINE_LEN * 2;
+  (void)snprintf(content + pos, sizeof(content) - pos,
+                 "\nother:2:2\ntestuser:5:5\n");
+
+  struct syscall_ops ops = make_db_ops(content);
+  subid_range_t ranges[2] = {0};
+  size_t found = 0;
+
+  TEST_ASSERT_EQ(subid_db_lookup(&ops, SUBUID_PATH, "testuser", DB_TEST_UID,
+                                 ranges, 2, &found, true),
+                 0, "Should succeed");
+  TEST_ASSERT_EQ(found, 1, "Should skip the overlong line entirely");
+  TEST_ASSERT_EQ(ranges[0].start, 5, "Should find the following entry");
+}
+
+TEST(subid_db_lookup_missing_file) {
+  struct syscall_ops ops = syscall_ops_default;
+  size_t found = 1;
+
+  ops.open = mock_open_enoent;
+
+  TEST_ASSERT_EQ(subid_db_lookup(&ops, SUBUID_PATH, "testuser", DB_TEST_UID,
+                                 NULL, 0, &found, true),
+                 0, "Missing database is not an error");
+  TEST_ASSERT_EQ(found, 0, "Missing database holds no ranges");
+}
+
+TEST(subid_db_lookup_open_error) {
+  struct syscall_ops ops = syscall_ops_default;
+  size_t found = 0;
+
+  ops.open = mock_open_eacces;
+
+  TEST_ASSERT_EQ(subid_db_lookup(&ops, SUBUID_PATH, "testuser", DB_TEST_UID,
+                                 NULL, 0, &found, false),
+                 -1, "Should fail when the database cannot be opened");
+  TEST_ASSERT_EQ(errno, EACCES, "Should preserve the open error");
+}
+
+TEST(subid_db_lookup_fstat_error) {
+  struct syscall_ops ops = make_db_ops("");
+  size_t found = 0;
+
+  ops.fstat = mock_fstat_eio;
+
+  TEST_ASSERT_EQ(subid_db_lookup(&ops, SUBUID_PATH, "testuser", DB_TEST_UID,
+                                 NULL, 0, &found, false),
+                 -1, "Should fail when fstat fails");
+  TEST_ASSERT_EQ(errno, EIO, "Should preserve the fstat error");
+}
+
+TEST(subid_db_lookup_not_regular) {
+  struct syscall_ops ops = make_db_ops("");
+  size_t found = 0;
+
+  ops.fstat = mock_fstat_root_dir;
+
+  TEST_ASSERT_EQ(subid_db_lookup(&ops, SUBUID_PATH, "testuser", DB_TEST_UID,
+                                 NULL, 0, &found, false),
+                 -1, "Should reject a directory");
+  TEST_ASSERT_EQ(errno, EBADF, "Should set the correct error code");
+}
+
+TEST(subid_db_lookup_fdopen_error) {
+  struct syscall_ops ops = make_db_ops("");
+  size_t found = 0;
+
+  ops.fdopen = mock_fdopen_null;
+
+  TEST_ASSERT_EQ(subid_db_lookup(&ops, SUBUID_PATH, "testuser", DB_TEST_UID,
+                                 NULL, 0, &found, false),
+                 -1, "Should fail when fdopen fails");
+}
+
+/* ============================================================================
+ * Tests - subid_db_check_exists
+ * ============================================================================
+ */
+
+TEST(subid_db_check_exists_results) {
+  struct syscall_ops ops = make_db_ops("testuser:100000:65536\n");
+
+  TEST_ASSERT_EQ(subid_db_check_exists(&ops, "testuser", DB_TEST_UID, SUBUID,
+                                       true),
+                 1, "Should report an existing range");
+  TEST_ASSERT_EQ(subid_db_check_exists(&ops, "other", 2000, SUBGID, false), 0,
+                 "Should report no range for another user");
+}
+
+TEST(subid_db_check_exists_errors) {
+  struct syscall_ops ops = make_db_ops("");
+
+  TEST_ASSERT_EQ(subid_db_check_exists(&ops, "testuser", DB_TEST_UID,
+                                       (subid_mode_t)99, false),
+                 -1, "Should reject an invalid mode");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(subid_db_check_exists(&ops, NULL, DB_TEST_UID, SUBUID, true),
+                 -1, "Should reject NULL username");
+}
+
+/* ============================================================================
+ * Test Runner
+ * ============================================================================
+ */
+
+int main(int argc, char **argv) {
+  TEST_INIT(10, false, false); /* timeout, verbose, duration */
+
+  /* subid_db_path */
+  RUN_TEST(subid_db_path_modes);
+
+  /* subid_db_parse_line */
+  RUN_TEST(subid_db_parse_line_valid);
+  RUN_TEST(subid_db_parse_line_blank);
+  RUN_TEST(subid_db_parse_line_malformed);
+
+  /* subid_db_lookup */
+  RUN_TEST(subid_db_lookup_null_params);
+  RUN_TEST(subid_db_lookup_by_name_and_uid);
+  RUN_TEST(subid_db_lookup_counts_past_capacity);
+  RUN_TEST(subid_db_lookup_skips_overlong_lines);
+  RUN_TEST(subid_db_lookup_missing_file);
+  RUN_TEST(subid_db_lookup_open_error);
+  RUN_TEST(subid_db_lookup_fstat_error);
+  RUN_TEST(subid_db_lookup_not_regular);
+  RUN_TEST(subid_db_lookup_fdopen_error);
+
+  /* subid_db_check_exists */
+  RUN_TEST(subid_db_check_exists_results);
+  RUN_TEST(subid_db_check_exists_errors);
+
+  return TEST_EXECUTE();
+}
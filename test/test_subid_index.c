@@ -0,0 +1,360 @@
+/**
+ * test_subid_index.c - Tests for the binary subuid/subgid index
+ *
+ * Databases and indexes are written into a private temporary directory.
+ * Ownership is mocked through fstat() so the root-owned check can be
+ * exercised without running the tests as root; every other attribute
+ * comes from the real files, since freshness depends on them.
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "test_framework.h"
+#include "test_helpers/all.h"
+
+/* ============================================================================
+ * Constants
+ * ============================================================================
+ */
+
+/* Size of the mkdtemp(3) path buffer */
+enum { TMPDIR_SIZE = 64 };
+
+/* UID for the test user (matches TEST_UID_STANDARD) */
+enum { INDEX_TEST_UID = 1000 };
+
+/* ============================================================================
+ * Global State
+ * ============================================================================
+ */
+
+/* Private directory holding the database and its index */
+static char tmpdir[TMPDIR_SIZE] = {0};
+
+/* ============================================================================
+ * Mock Functions
+ * ============================================================================
+ */
+
+/**
+ * mock_fstat_as_root - Real fstat() with the file reported as root's
+ */
+static int mock_fstat_as_root(int fd, struct stat *statbuf) {
+  int ret = fstat(fd, statbuf);
+  statbuf->st_uid = 0;
+  return ret;
+}
+
+/**
+ * mock_mmap_enomem - Fail every mapping
+ */
+static void *mock_mmap_enomem(void *addr, size_t length, int prot, int flags,
+                              int fd, off_t offset) {
+  (void)addr;
+  (void)length;
+  (void)prot;
+  (void)flags;
+  (void)fd;
+  (void)offset;
+  errno = ENOMEM;
+  return MAP_FAILED;
+}
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================
+ */
+
+/**
+ * setup_tmpdir - Create the private directory
+ */
+static int setup_tmpdir(void) {
+  (void)snprintf(tmpdir, sizeof(tmpdir), "/tmp/test_subid_index.XXXXXX");
+  return mkdtemp(tmpdir) != NULL ? 0 : -1;
+}
+
+/**
+ * db_file - Path of the test database inside tmpdir
+ */
+static const char *db_file(void) {
+  static char path[PATH_MAX];
+  (void)snprintf(path, sizeof(path), "%s/subuid", tmpdir);
+  return path;
+}
+
+/**
+ * index_file - Path of the index of db_file()
+ */
+static const char *index_file(void) {
+  static char path[PATH_MAX];
+  (void)snprintf(path, sizeof(path), "%s/subuid.index", tmpdir);
+  return path;
+}
+
+/**
+ * write_db - Replace the test database
+ * @content: New contents
+ */
+static int write_db(const char *content) {
+  FILE *fp = fopen(db_file(), "w");
+  if (fp == NULL) {
+    return -1;
+  }
+  size_t len = strlen(content);
+  size_t written = fwrite(content, 1, len, fp);
+  return fclose(fp) == 0 && written == len ? 0 : -1;
+}
+
+/**
+ * cleanup_tmpdir - Remove the database, the index and the directory
+ */
+static void cleanup_tmpdir(void) {
+  (void)unlink(db_file());
+  (void)unlink(index_file());
+  (void)rmdir(tmpdir);
+}
+
+/**
+ * root_ops - Default ops with every file reported as owned by root
+ */
+static struct syscall_ops root_ops(void) {
+  struct syscall_ops ops = syscall_ops_default;
+  ops.fstat = mock_fstat_as_root;
+  return ops;
+}
+
+/**
+ * build_index - Write @content as the database and index it
+ * @ops: Operations to build with
+ * @content: Database contents
+ */
+static int build_index(const struct syscall_ops *ops, const char *content) {
+  if (setup_tmpdir() != 0 || write_db(content) != 0) {
+    return -1;
+  }
+  return subid_index_refresh(ops, tmpdir, db_file(), true);
+}
+
+/* ============================================================================
+ * Tests
+ * ============================================================================
+ */
+
+TEST(subid_index_null_params) {
+  struct syscall_ops ops = root_ops();
+  subid_index_t index = {0};
+  size_t found = 0;
+
+  TEST_ASSERT_EQ(subid_index_refresh(NULL, "/tmp", "/etc/subuid", true), -1,
+                 "Should reject NULL ops");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(subid_index_open(&ops, NULL, "/etc/subuid", &index, true), 0,
+                 "NULL dir should not open an index");
+  TEST_ASSERT_EQ(subid_index_lookup(&index, "testuser", INDEX_TEST_UID, NULL,
+                                    0, &found),
+                 -1, "Should reject an unopened index");
+  subid_index_close(&ops, NULL);
+  subid_index_close(&ops, &index);
+}
+
+TEST(subid_index_lookup_matches_scan) {
+  struct syscall_ops ops = root_ops();
+  subid_index_t index = {0};
+  subid_range_t ranges[4] = {0};
+  size_t found = 0;
+
+  TEST_ASSERT_EQ(build_index(&ops, "other:500000:65536\n"
+                                   "testuser:300000:100\n"
+                                   "1000:100000:65536\n"
+                                   "not a line\n"
+                                   "testuser:200000:65536\n"),
+                 0, "Should build the index");
+  TEST_ASSERT_EQ(subid_index_open(&ops, tmpdir, db_file(), &index, true), 1,
+                 "Fresh index should open");
+
+  TEST_ASSERT_EQ(subid_index_lookup(&index, "testuser", INDEX_TEST_UID, ranges,
+                                    4, &found),
+                 0, "Should look the user up");
+  TEST_ASSERT_EQ(found, 3, "Should match by name and by UID");
+  TEST_ASSERT_EQ(ranges[0].start, 300000, "Should keep file order");
+  TEST_ASSERT_EQ(ranges[1].start, 100000, "UID entry is second in the file");
+  TEST_ASSERT_EQ(ranges[2].start, 200000, "Should keep file order");
+  TEST_ASSERT_EQ(ranges[2].count, 65536, "Should return the count");
+
+  TEST_ASSERT_EQ(subid_index_lookup(&index, "testuser", INDEX_TEST_UID, ranges,
+                                    1, &found),
+                 0, "Should look the user up");
+  TEST_ASSERT_EQ(found, 3, "Should count past the capacity");
+
+  TEST_ASSERT_EQ(subid_index_lookup(&index, "nobody", 4242, NULL, 0, &found),
+                 0, "Should look the user up");
+  TEST_ASSERT_EQ(found, 0, "Unknown users have no ranges");
+
+  subid_index_close(&ops, &index);
+  TEST_ASSERT_EQ(index.map, NULL, "Close should reset the index");
+  cleanup_tmpdir();
+}
+
+TEST(subid_index_stale_after_edit) {
+  struct syscall_ops ops = root_ops();
+  subid_index_t index = {0};
+
+  TEST_ASSERT_EQ(build_index(&ops, "testuser:100000:65536\n"), 0,
+                 "Should build the index");
+  TEST_ASSERT_EQ(write_db("testuser:100000:65536\nother:200000:65536\n"), 0,
+                 "Should edit the database");
+  TEST_ASSERT_EQ(subid_index_open(&ops, tmpdir, db_file(), &index, true), 0,
+                 "Edited database should make the index stale");
+
+  TEST_ASSERT_EQ(subid_index_refresh(&ops, tmpdir, db_file(), true), 0,
+                 "Should rebuild the index");
+  TEST_ASSERT_EQ(subid_index_open(&ops, tmpdir, db_file(), &index, true), 1,
+                 "Rebuilt index should open");
+
+  subid_range_t ranges[1] = {0};
+  size_t found = 0;
+  TEST_ASSERT_EQ(subid_index_lookup(&index, "other", 4242, ranges, 1, &found),
+                 0, "Should look the new owner up");
+  TEST_ASSERT_EQ(found, 1, "Rebuilt index should hold the new entry");
+  TEST_ASSERT_EQ(ranges[0].start, 200000, "Should find the new range");
+
+  subid_index_close(&ops, &index);
+  cleanup_tmpdir();
+}
+
+TEST(subid_index_rejects_damage) {
+  struct syscall_ops ops = root_ops();
+  subid_index_t index = {0};
+
+  TEST_ASSERT_EQ(build_index(&ops, "testuser:100000:65536\n"), 0,
+                 "Should build the index");
+
+  /* Flip the magic; the database itself is untouched and still current */
+  int fd = open(index_file(), O_WRONLY);
+  TEST_ASSERT_NOT_EQ(fd, -1, "Should open the index");
+  TEST_ASSERT_EQ(pwrite(fd, "X", 1, 0), 1, "Should damage the index");
+  TEST_ASSERT_EQ(close(fd), 0, "Should close the index");
+  TEST_ASSERT_EQ(subid_index_open(&ops, tmpdir, db_file(), &index, true), 0,
+                 "Damaged index should not open");
+
+  /* A truncated index must not be read past its end */
+  TEST_ASSERT_EQ(unlink(index_file()), 0, "Should remove the index");
+  TEST_ASSERT_EQ(subid_index_refresh(&ops, tmpdir, db_file(), true), 0,
+                 "Should rebuild the index");
+  TEST_ASSERT_EQ(truncate(index_file(), 100), 0, "Should truncate the index");
+  TEST_ASSERT_EQ(subid_index_open(&ops, tmpdir, db_file(), &index, true), 0,
+                 "Truncated index should not open");
+
+  cleanup_tmpdir();
+}
+
+TEST(subid_index_rejects_untrusted) {
+  struct syscall_ops ops = root_ops();
+  subid_index_t index = {0};
+
+  TEST_ASSERT_EQ(build_index(&ops, "testuser:100000:65536\n"), 0,
+                 "Should build the index");
+
+  ops.fstat = mock_fstat_root_file_world_write;
+  TEST_ASSERT_EQ(subid_index_open(&ops, tmpdir, db_file(), &index, true), 0,
+                 "World-writable index should not open");
+
+  ops = root_ops();
+  ops.mmap = mock_mmap_enomem;
+  TEST_ASSERT_EQ(subid_index_open(&ops, tmpdir, db_file(), &index, true), 0,
+                 "Unmappable index should not open");
+  TEST_ASSERT_EQ(index.map, NULL, "Should leave the index unmapped");
+
+  cleanup_tmpdir();
+}
+
+TEST(subid_index_refresh_needs_dir) {
+  struct syscall_ops ops = root_ops();
+  char missing[TMPDIR_SIZE + 16] = {0};
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  TEST_ASSERT_EQ(write_db("testuser:100000:65536\n"), 0,
+                 "Should write the database");
+  (void)snprintf(missing, sizeof(missing), "%s/missing", tmpdir);
+
+  TEST_ASSERT_EQ(subid_index_refresh(&ops, missing, db_file(), true), 0,
+                 "A missing index directory is not an error");
+  TEST_ASSERT_EQ(access(missing, F_OK), -1, "Should not create the directory");
+
+  TEST_ASSERT_EQ(unlink(db_file()), 0, "Should remove the database");
+  TEST_ASSERT_EQ(subid_index_refresh(&ops, tmpdir, db_file(), true), -1,
+                 "A missing database cannot be indexed");
+  TEST_ASSERT_EQ(access(index_file(), F_OK), -1, "Should write no index");
+
+  cleanup_tmpdir();
+}
+
+TEST(subid_index_empty_database) {
+  struct syscall_ops ops = root_ops();
+  subid_index_t index = {0};
+  size_t found = 1;
+
+  TEST_ASSERT_EQ(build_index(&ops, "# no entries\n"), 0,
+                 "Should build the index");
+  TEST_ASSERT_EQ(subid_index_open(&ops, tmpdir, db_file(), &index, true), 1,
+                 "Empty index should open");
+  TEST_ASSERT_EQ(subid_index_lookup(&index, "testuser", INDEX_TEST_UID, NULL,
+                                    0, &found),
+                 0, "Should look the user up");
+  TEST_ASSERT_EQ(found, 0, "Empty index holds no ranges");
+
+  subid_index_close(&ops, &index);
+  cleanup_tmpdir();
+}
+
+TEST(subid_index_refresh_alloc_failure) {
+  struct syscall_ops ops = root_ops();
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  TEST_ASSERT_EQ(write_db("testuser:100000:65536\n"), 0,
+                 "Should write the database");
+
+  ops.calloc = mock_calloc_null;
+  TEST_ASSERT_EQ(subid_index_refresh(&ops, tmpdir, db_file(), true), -1,
+                 "Should fail when memory runs out");
+  TEST_ASSERT_EQ(errno, ENOMEM, "Should set the correct error code");
+  TEST_ASSERT_EQ(access(index_file(), F_OK), -1, "Should write no index");
+
+  cleanup_tmpdir();
+}
+
+/* ============================================================================
+ * Test Runner
+ * ============================================================================
+ */
+
+int main(int argc, char **argv) {
+  TEST_INIT(10, false, false); /* timeout, verbose, duration */
+
+  RUN_TEST(subid_index_null_params);
+  RUN_TEST(subid_index_lookup_matches_scan);
+  RUN_TEST(subid_index_stale_after_edit);
+  RUN_TEST(subid_index_rejects_damage);
+  RUN_TEST(subid_index_rejects_untrusted);
+  RUN_TEST(subid_index_refresh_needs_dir);
+  RUN_TEST(subid_index_empty_database);
+  RUN_TEST(subid_index_refresh_alloc_failure);
+
+  return TEST_EXECUTE();
+}
@@ -0,0 +1,680 @@
+/**
+ * test_subid_write.c - Tests for the native subuid/subgid writer
+ *
+ * The rewrite is exercised against real files in a private temporary
+ * directory, since atomic replacement is the behaviour under test. Only
+ * the shadow lock and individual failures are mocked.
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "test_framework.h"
+#include "test_helpers/all.h"
+
+/* ============================================================================
+ * Constants
+ * ============================================================================
+ */
+
+/* Room for the database contents read back by the tests */
+enum { READ_BUF_SIZE = 4096 };
+
+/* Entries queued by the growth test (more than one initial allocation) */
+enum { MANY_ENTRIES = 40 };
+
+/* Size of the mkdtemp(3) path buffer */
+enum { TMPDIR_SIZE = 64 };
+
+/* A PID the mocked kill() reports as not running */
+#define STALE_PID_STR "4242"
+
+/* ============================================================================
+ * Global State
+ * ============================================================================
+ */
+
+/* Private directory standing in for /etc */
+static char tmpdir[TMPDIR_SIZE] = {0};
+
+/* Database path inside tmpdir */
+static char db_path[PATH_MAX] = {0};
+
+/* Number of lckpwdf/ulckpwdf calls seen */
+static int lckpwdf_calls = 0;
+static int ulckpwdf_calls = 0;
+
+/* ============================================================================
+ * Mock Functions
+ * ============================================================================
+ */
+
+/**
+ * mock_kill_esrch - Report every process as gone
+ */
+static int mock_kill_esrch(pid_t pid, int sig) {
+  (void)pid;
+  (void)sig;
+  errno = ESRCH;
+  return -1;
+}
+
+/**
+ * mock_lckpwdf_success - Count the call and pretend the lock was taken
+ */
+static int mock_lckpwdf_success(void) {
+  lckpwdf_calls++;
+  return 0;
+}
+
+/**
+ * mock_ulckpwdf_success - Count the call
+ */
+static int mock_ulckpwdf_success(void) {
+  ulckpwdf_calls++;
+  return 0;
+}
+
+/**
+ * mock_lckpwdf_eacces - Fail like an unprivileged caller would
+ */
+static int mock_lckpwdf_eacces(void) {
+  lckpwdf_calls++;
+  errno = EACCES;
+  return -1;
+}
+
+/**
+ * mock_rename_eio - Fail the final rename
+ */
+static int mock_rename_eio(const char *oldpath, const char *newpath) {
+  (void)oldpath;
+  (void)newpath;
+  errno = EIO;
+  return -1;
+}
+
+/**
+ * mock_fsync_eio - Fail every fsync
+ */
+static int mock_fsync_eio(int fd) {
+  (void)fd;
+  errno = EIO;
+  return -1;
+}
+
+/**
+ * redirect_path - Map a database path into tmpdir by its basename
+ */
+static void redirect_path(const char *path, char *out, size_t size) {
+  const char *base = strrchr(path, '/');
+  (void)snprintf(out, size, "%s/%s", tmpdir, base != NULL ? base + 1 : path);
+}
+
+/**
+ * mock_open_redirect - open() with database paths moved into tmpdir
+ */
+static int mock_open_redirect(const char *pathname, int flags, ...) {
+  mode_t mode = 0;
+  if ((flags & O_CREAT) != 0) {
+    va_list ap;
+    va_start(ap, flags);
+    mode = (mode_t)va_arg(ap, int);
+    va_end(ap);
+  }
+
+  /* The directory fsync after rename */
+  if ((flags & O_DIRECTORY) != 0) {
+    return open(tmpdir, flags);
+  }
+
+  char path[PATH_MAX] = {0};
+  redirect_path(pathname, path, sizeof(path));
+  return open(path, flags, mode);
+}
+
+/**
+ * mock_unlink_redirect - unlink() with database paths moved into tmpdir
+ */
+static int mock_unlink_redirect(const char *pathname) {
+  char path[PATH_MAX] = {0};
+  redirect_path(pathname, path, sizeof(path));
+  return unlink(path);
+}
+
+/**
+ * mock_rename_redirect - rename() with database paths moved into tmpdir
+ */
+static int mock_rename_redirect(const char *oldpath, const char *newpath) {
+  char from[PATH_MAX] = {0};
+  char to[PATH_MAX] = {0};
+  redirect_path(oldpath, from, sizeof(from));
+  redirect_path(newpath, to, sizeof(to));
+  return rename(from, to);
+}
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================
+ */
+
+/**
+ * setup_tmpdir - Create the private directory and set db_path
+ */
+static int setup_tmpdir(void) {
+  (void)snprintf(tmpdir, sizeof(tmpdir), "/tmp/test_subid_write.XXXXXX");
+  if (mkdtemp(tmpdir) == NULL) {
+    return -1;
+  }
+  (void)snprintf(db_path, sizeof(db_path), "%s/subuid", tmpdir);
+  return 0;
+}
+
+/**
+ * cleanup_tmpdir - Remove the private directory and everything in it
+ */
+static void cleanup_tmpdir(void) {
+  DIR *dir = opendir(tmpdir);
+  if (dir == NULL) {
+    return;
+  }
+
+  const struct dirent *entry = NULL;
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+    char path[PATH_MAX] = {0};
+    (void)snprintf(path, sizeof(path), "%s/%s", tmpdir, entry->d_name);
+    (void)unlink(path);
+  }
+  (void)closedir(dir);
+  (void)rmdir(tmpdir);
+}
+
+/**
+ * sibling_path - db_path with a suffix appended
+ */
+static void sibling_path(const char *suffix, char *out, size_t size) {
+  (void)snprintf(out, size, "%s%s", db_path, suffix);
+}
+
+/**
+ * file_exists - Check whether a path exists
+ */
+static bool file_exists(const char *path) {
+  struct stat st;
+  return lstat(path, &st) == 0;
+}
+
+/**
+ * write_file - Replace a file's contents
+ */
+static int write_file(const char *path, const char *content) {
+  FILE *fp = fopen(path, "w");
+  if (fp == NULL) {
+    return -1;
+  }
+  (void)fputs(content, fp);
+  return fclose(fp);
+}
+
+/**
+ * read_file - Read a whole file into a static buffer
+ */
+static const char *read_file(const char *path) {
+  static char buf[READ_BUF_SIZE];
+  FILE *fp = fopen(path, "r");
+  if (fp == NULL) {
+    return NULL;
+  }
+  size_t len = fread(buf, 1, sizeof(buf) - 1, fp);
+  buf[len] = '\0';
+  (void)fclose(fp);
+  return buf;
+}
+
+/**
+ * make_write_ops - Default ops with the shadow lock mocked
+ */
+static struct syscall_ops make_write_ops(void) {
+  struct syscall_ops ops = syscall_ops_default;
+
+  lckpwdf_calls = 0;
+  ulckpwdf_calls = 0;
+  ops.lckpwdf = mock_lckpwdf_success;
+  ops.ulckpwdf = mock_ulckpwdf_success;
+  return ops;
+}
+
+/* ============================================================================
+ * Tests - subid_db_lock / subid_db_unlock
+ * ============================================================================
+ */
+
+TEST(subid_db_lock_null_params) {
+  TEST_ASSERT_EQ(subid_db_lock(NULL, "/etc/subuid", true), -1,
+                 "Should reject NULL ops");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(subid_db_lock(&syscall_ops_default, NULL, true), -1,
+                 "Should reject NULL path");
+}
+
+TEST(subid_db_lock_acquire_release) {
+  char lock[PATH_MAX] = {0};
+  char pid_str[32] = {0};
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  sibling_path(".lock", lock, sizeof(lock));
+  (void)snprintf(pid_str, sizeof(pid_str), "%ld", (long)getpid());
+
+  TEST_ASSERT_EQ(subid_db_lock(&syscall_ops_default, db_path, true), 0,
+                 "Should take a free lock");
+  TEST_ASSERT_STR_EQ(read_file(lock), pid_str,
+                     "Lock file should hold our PID");
+
+  TEST_ASSERT_EQ(subid_db_lock(&syscall_ops_default, db_path, true), -1,
+                 "Should refuse a lock held by a live process");
+  TEST_ASSERT_EQ(errno, EBUSY, "Should set the correct error code");
+
+  subid_db_unlock(&syscall_ops_default, db_path, true);
+  TEST_ASSERT_EQ(file_exists(lock), false, "Unlock should remove the lock");
+
+  cleanup_tmpdir();
+}
+
+TEST(subid_db_lock_stale) {
+  struct syscall_ops ops = syscall_ops_default;
+  char lock[PATH_MAX] = {0};
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  sibling_path(".lock", lock, sizeof(lock));
+  TEST_ASSERT_EQ(write_file(lock, STALE_PID_STR), 0, "Should plant a lock");
+  ops.kill = mock_kill_esrch;
+
+  TEST_ASSERT_EQ(subid_db_lock(&ops, db_path, true), 0,
+                 "Should take over a lock whose owner is gone");
+  TEST_ASSERT_NOT_EQ(strcmp(read_file(lock), STALE_PID_STR), 0,
+                     "Lock file should now hold our PID");
+
+  cleanup_tmpdir();
+}
+
+TEST(subid_db_lock_unreadable_is_held) {
+  struct syscall_ops ops = syscall_ops_default;
+  char lock[PATH_MAX] = {0};
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  sibling_path(".lock", lock, sizeof(lock));
+  TEST_ASSERT_EQ(write_file(lock, "not-a-pid"), 0, "Should plant a lock");
+  ops.kill = mock_kill_esrch;
+
+  TEST_ASSERT_EQ(subid_db_lock(&ops, db_path, true), -1,
+                 "Should not remove a lock it cannot interpret");
+  TEST_ASSERT_EQ(errno, EBUSY, "Should set the correct error code");
+  TEST_ASSERT_STR_EQ(read_file(lock), "not-a-pid",
+                     "Lock file should be left alone");
+
+  cleanup_tmpdir();
+}
+
+TEST(subid_db_lock_open_error) {
+  struct syscall_ops ops = syscall_ops_default;
+  ops.open = mock_open_eacces;
+
+  TEST_ASSERT_EQ(subid_db_lock(&ops, "/etc/subuid", true), -1,
+                 "Should fail when the lock cannot be created");
+  TEST_ASSERT_EQ(errno, EACCES, "Should keep the open error");
+}
+
+/* ============================================================================
+ * Tests - subid_db_rewrite
+ * ============================================================================
+ */
+
+TEST(subid_db_rewrite_null_params) {
+  TEST_ASSERT_EQ(subid_db_rewrite(NULL, "/etc/subuid", NULL, 0, true), -1,
+                 "Should reject NULL ops");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(
+      subid_db_rewrite(&syscall_ops_default, "/etc/subuid", NULL, 1, true),
+      -1, "Should reject NULL entries with a count");
+  TEST_ASSERT_EQ(
+      subid_db_rewrite(&syscall_ops_default, "/etc/subuid", NULL, 0, true), 0,
+      "Nothing to write is a no-op");
+}
+
+TEST(subid_db_rewrite_creates_missing) {
+  char owner[] = "alice";
+  subid_entry_t entries[] = {{owner, 100000, 65536}};
+  struct stat st;
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+
+  TEST_ASSERT_EQ(
+      subid_db_rewrite(&syscall_ops_default, db_path, entries, 1, true), 0,
+      "Should create the database");
+  TEST_ASSERT_STR_EQ(read_file(db_path), "alice:100000:65536\n",
+                     "Should hold the new entry");
+  TEST_ASSERT_EQ(stat(db_path, &st), 0, "Database should exist");
+  TEST_ASSERT_EQ(st.st_mode & 07777, 0644, "Should use the shadow-utils mode");
+
+  cleanup_tmpdir();
+}
+
+TEST(subid_db_rewrite_appends_verbatim) {
+  char owner[] = "alice";
+  subid_entry_t entries[] = {{owner, 100000, 65536}};
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  TEST_ASSERT_EQ(write_file(db_path, "# local\nbob:165536:65536\ngarbage\n"),
+                 0, "Should seed the database");
+
+  TEST_ASSERT_EQ(
+      subid_db_rewrite(&syscall_ops_default, db_path, entries, 1, true), 0,
+      "Should append");
+  TEST_ASSERT_STR_EQ(read_file(db_path),
+                     "# local\nbob:165536:65536\ngarbage\n"
+                     "alice:100000:65536\n",
+                     "Existing lines should be kept byte for byte");
+
+  cleanup_tmpdir();
+}
+
+TEST(subid_db_rewrite_missing_newline) {
+  char owner[] = "alice";
+  subid_entry_t entries[] = {{owner, 100000, 65536}};
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  TEST_ASSERT_EQ(write_file(db_path, "bob:165536:65536"), 0,
+                 "Should seed the database");
+
+  TEST_ASSERT_EQ(
+      subid_db_rewrite(&syscall_ops_default, db_path, entries, 1, true), 0,
+      "Should append");
+  TEST_ASSERT_STR_EQ(read_file(db_path),
+                     "bob:165536:65536\nalice:100000:65536\n",
+                     "Should terminate the last line before appending");
+
+  cleanup_tmpdir();
+}
+
+TEST(subid_db_rewrite_skips_present) {
+  char alice[] = "alice";
+  char bob[] = "bob";
+  subid_entry_t entries[] = {{alice, 100000, 65536},
+                             {bob, 165536, 65536},
+                             {bob, 165536, 65536}};
+  struct stat before;
+  struct stat after;
+  char tmp[PATH_MAX] = {0};
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  sibling_path("+", tmp, sizeof(tmp));
+  TEST_ASSERT_EQ(write_file(db_path, "alice:100000:65536\n"), 0,
+                 "Should seed the database");
+  TEST_ASSERT_EQ(stat(db_path, &before), 0, "Database should exist");
+
+  TEST_ASSERT_EQ(
+      subid_db_rewrite(&syscall_ops_default, db_path, entries, 3, true), 0,
+      "Should succeed");
+  TEST_ASSERT_STR_EQ(read_file(db_path),
+                     "alice:100000:65536\nbob:165536:65536\n",
+                     "Should add bob once and not repeat alice");
+
+  TEST_ASSERT_EQ(stat(db_path, &before), 0, "Database should exist");
+  TEST_ASSERT_EQ(
+      subid_db_rewrite(&syscall_ops_default, db_path, entries, 3, true), 0,
+      "Should succeed when everything is present");
+  TEST_ASSERT_EQ(stat(db_path, &after), 0, "Database should exist");
+  TEST_ASSERT_EQ(before.st_ino, after.st_ino,
+                 "Should not replace the file when nothing changes");
+  TEST_ASSERT_EQ(file_exists(tmp), false, "Should not leave <db>+ behind");
+
+  cleanup_tmpdir();
+}
+
+TEST(subid_db_rewrite_keeps_mode) {
+  char owner[] = "alice";
+  subid_entry_t entries[] = {{owner, 100000, 65536}};
+  struct stat st;
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  TEST_ASSERT_EQ(write_file(db_path, ""), 0, "Should seed the database");
+  TEST_ASSERT_EQ(chmod(db_path, 0600), 0, "Should restrict the database");
+
+  TEST_ASSERT_EQ(
+      subid_db_rewrite(&syscall_ops_default, db_path, entries, 1, true), 0,
+      "Should append");
+  TEST_ASSERT_EQ(stat(db_path, &st), 0, "Database should exist");
+  TEST_ASSERT_EQ(st.st_mode & 07777, 0600, "Should keep the original mode");
+
+  cleanup_tmpdir();
+}
+
+TEST(subid_db_rewrite_rename_fails) {
+  struct syscall_ops ops = syscall_ops_default;
+  char owner[] = "alice";
+  subid_entry_t entries[] = {{owner, 100000, 65536}};
+  char tmp[PATH_MAX] = {0};
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  sibling_path("+", tmp, sizeof(tmp));
+  TEST_ASSERT_EQ(write_file(db_path, "bob:165536:65536\n"), 0,
+                 "Should seed the database");
+  ops.rename = mock_rename_eio;
+
+  TEST_ASSERT_EQ(subid_db_rewrite(&ops, db_path, entries, 1, true), -1,
+                 "Should fail when the rename fails");
+  TEST_ASSERT_EQ(errno, EIO, "Should keep the rename error");
+  TEST_ASSERT_STR_EQ(read_file(db_path), "bob:165536:65536\n",
+                     "Database should be unchanged");
+  TEST_ASSERT_EQ(file_exists(tmp), false, "Should remove <db>+");
+
+  cleanup_tmpdir();
+}
+
+TEST(subid_db_rewrite_fsync_fails) {
+  struct syscall_ops ops = syscall_ops_default;
+  char owner[] = "alice";
+  subid_entry_t entries[] = {{owner, 100000, 65536}};
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  ops.fsync = mock_fsync_eio;
+
+  TEST_ASSERT_EQ(subid_db_rewrite(&ops, db_path, entries, 1, true), -1,
+                 "Should not install data that may not be on disk");
+  TEST_ASSERT_EQ(file_exists(db_path), false, "Database should not appear");
+
+  cleanup_tmpdir();
+}
+
+TEST(subid_db_rewrite_open_error) {
+  struct syscall_ops ops = syscall_ops_default;
+  char owner[] = "alice";
+  subid_entry_t entries[] = {{owner, 100000, 65536}};
+  ops.open = mock_open_eacces;
+
+  TEST_ASSERT_EQ(subid_db_rewrite(&ops, "/etc/subuid", entries, 1, true), -1,
+                 "Should fail when the database cannot be read");
+  TEST_ASSERT_EQ(errno, EACCES, "Should keep the open error");
+}
+
+TEST(subid_db_rewrite_calloc_fails) {
+  struct syscall_ops ops = syscall_ops_default;
+  char owner[] = "alice";
+  subid_entry_t entries[] = {{owner, 100000, 65536}};
+  ops.calloc = mock_calloc_null;
+
+  TEST_ASSERT_EQ(subid_db_rewrite(&ops, "/etc/subuid", entries, 1, true), -1,
+                 "Should fail on allocation failure");
+  TEST_ASSERT_EQ(errno, ENOMEM, "Should set the correct error code");
+}
+
+/* ============================================================================
+ * Tests - subid_txn_*
+ * ============================================================================
+ */
+
+TEST(subid_txn_add_grows) {
+  struct syscall_ops ops = syscall_ops_default;
+  subid_txn_t txn = {0};
+  char owner[] = "alice";
+
+  ops.calloc = mock_calloc_counting;
+  ops.free = mock_free_counting;
+  mock_alloc_reset();
+  for (uint32_t i = 0; i < MANY_ENTRIES; i++) {
+    TEST_ASSERT_EQ(subid_txn_add(&ops, &txn, SUBGID, owner, i, 1), 0,
+                   "Should queue the entry");
+  }
+  owner[0] = 'A';
+
+  TEST_ASSERT_EQ(txn.subgid.len, MANY_ENTRIES, "Should keep every entry");
+  TEST_ASSERT_EQ(txn.subuid.len, 0, "Should use the list for the mode");
+  TEST_ASSERT_EQ(txn.subgid.entries[MANY_ENTRIES - 1].start,
+                 MANY_ENTRIES - 1, "Should keep entries in order");
+  TEST_ASSERT_STR_EQ(txn.subgid.entries[0].owner, "alice",
+                     "Should copy the owner");
+
+  subid_txn_truncate(&ops, &txn, 0, 1);
+  TEST_ASSERT_EQ(txn.subgid.len, 1, "Truncate should drop later entries");
+  TEST_ASSERT_EQ(mock_calloc_calls - mock_free_calls, 2,
+                 "Truncate should free through ops, keeping the array");
+
+  subid_txn_free(&ops, &txn);
+  TEST_ASSERT_EQ(txn.subgid.entries == NULL, true, "Free should reset");
+  TEST_ASSERT_EQ(mock_calloc_calls - mock_free_calls, 0,
+                 "Free should release through ops");
+}
+
+TEST(subid_txn_add_errors) {
+  struct syscall_ops ops = syscall_ops_default;
+  subid_txn_t txn = {0};
+
+  TEST_ASSERT_EQ(subid_txn_add(&ops, NULL, SUBUID, "alice", 1, 1), -1,
+                 "Should reject NULL txn");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(subid_txn_add(&ops, &txn, (subid_mode_t)99, "alice", 1, 1),
+                 -1, "Should reject an invalid mode");
+
+  ops.calloc = mock_calloc_null;
+  TEST_ASSERT_EQ(subid_txn_add(&ops, &txn, SUBUID, "alice", 1, 1), -1,
+                 "Should fail on allocation failure");
+  TEST_ASSERT_EQ(errno, ENOMEM, "Should set the correct error code");
+}
+
+TEST(subid_txn_commit_empty) {
+  struct syscall_ops ops = make_write_ops();
+  subid_txn_t txn = {0};
+
+  TEST_ASSERT_EQ(subid_txn_commit(&ops, &txn, true), 0,
+                 "Empty commit should succeed");
+  TEST_ASSERT_EQ(lckpwdf_calls, 0, "Should not take the shadow lock");
+  TEST_ASSERT_EQ(subid_txn_commit(NULL, &txn, true), -1,
+                 "Should reject NULL ops");
+}
+
+TEST(subid_txn_commit_lckpwdf_fails) {
+  struct syscall_ops ops = make_write_ops();
+  subid_txn_t txn = {0};
+  ops.lckpwdf = mock_lckpwdf_eacces;
+
+  TEST_ASSERT_EQ(subid_txn_add(&ops, &txn, SUBUID, "alice", 100000, 65536), 0,
+                 "Should queue the entry");
+  TEST_ASSERT_EQ(subid_txn_commit(&ops, &txn, true), -1,
+                 "Should fail without the shadow lock");
+  TEST_ASSERT_EQ(errno, EACCES, "Should keep the lckpwdf error");
+  TEST_ASSERT_EQ(ulckpwdf_calls, 0, "Should not unlock what it never locked");
+  TEST_ASSERT_EQ(txn.subuid.len, 1, "Failed commit should keep the entries");
+  subid_txn_free(&ops, &txn);
+}
+
+TEST(subid_txn_commit_writes_both) {
+  struct syscall_ops ops = make_write_ops();
+  subid_txn_t txn = {0};
+  char path[PATH_MAX] = {0};
+
+  TEST_ASSERT_EQ(setup_tmpdir(), 0, "Should create the test directory");
+  ops.open = mock_open_redirect;
+  ops.unlink = mock_unlink_redirect;
+  ops.rename = mock_rename_redirect;
+
+  TEST_ASSERT_EQ(subid_txn_add(&ops, &txn, SUBUID, "alice", 100000, 65536), 0,
+                 "Should queue the subuid entry");
+  TEST_ASSERT_EQ(subid_txn_add(&ops, &txn, SUBGID, "alice", 100000, 65536), 0,
+                 "Should queue the subgid entry");
+  txn.users = 1;
+
+  TEST_ASSERT_EQ(subid_txn_commit(&ops, &txn, true), 0,
+                 "Should write both databases");
+  TEST_ASSERT_EQ(lckpwdf_calls, 1, "Should take the shadow lock once");
+  TEST_ASSERT_EQ(ulckpwdf_calls, 1, "Should release the shadow lock");
+  TEST_ASSERT_EQ(txn.subuid.len + txn.subgid.len, 0,
+                 "Commit should release the entries");
+  TEST_ASSERT_EQ(txn.users, 0, "Commit should reset the user count");
+
+  redirect_path(SUBUID_PATH, path, sizeof(path));
+  TEST_ASSERT_STR_EQ(read_file(path), "alice:100000:65536\n",
+                     "subuid should hold the entry");
+  redirect_path(SUBGID_PATH ".lock", path, sizeof(path));
+  TEST_ASSERT_EQ(file_exists(path), false, "Should release the file lock");
+  redirect_path(SUBGID_PATH, path, sizeof(path));
+  TEST_ASSERT_STR_EQ(read_file(path), "alice:100000:65536\n",
+                     "subgid should hold the entry");
+
+  cleanup_tmpdir();
+}
+
+/* ============================================================================
+ * Test Runner
+ * ============================================================================
+ */
+
+int main(int argc, char **argv) {
+  TEST_INIT(10, false, false); /* timeout, verbose, duration */
+
+  /* subid_db_lock / subid_db_unlock */
+  RUN_TEST(subid_db_lock_null_params);
+  RUN_TEST(subid_db_lock_acquire_release);
+  RUN_TEST(subid_db_lock_stale);
+  RUN_TEST(subid_db_lock_unreadable_is_held);
+  RUN_TEST(subid_db_lock_open_error);
+
+  /* subid_db_rewrite */
+  RUN_TEST(subid_db_rewrite_null_params);
+  RUN_TEST(subid_db_rewrite_creates_missing);
+  RUN_TEST(subid_db_rewrite_appends_verbatim);
+  RUN_TEST(subid_db_rewrite_missing_newline);
+  RUN_TEST(subid_db_rewrite_skips_present);
+  RUN_TEST(subid_db_rewrite_keeps_mode);
+  RUN_TEST(subid_db_rewrite_rename_fails);
+  RUN_TEST(subid_db_rewrite_fsync_fails);
+  RUN_TEST(subid_db_rewrite_open_error);
+  RUN_TEST(subid_db_rewrite_calloc_fails);
+
+  /* subid_txn_* */
+  RUN_TEST(subid_txn_add_grows);
+  RUN_TEST(subid_txn_add_errors);
+  RUN_TEST(subid_txn_commit_empty);
+  RUN_TEST(subid_txn_commit_lckpwdf_fails);
+  RUN_TEST(subid_txn_commit_writes_both);
+
+  return TEST_EXECUTE();
+}
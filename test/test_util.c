@@ -111,7 +111,8 @@ static void test_resolve_user(struct syscall_ops *ops, const char *user_arg,
     TEST_ASSERT_NOT_EQ(username, NULL, "Test setup: buffer allocation failed");
   }
 
-  result = resolve_user(ops, user_arg, &uid, username, username_bufsize, debug);
+  result = resolve_user(ops, user_arg, &uid, username, username_bufsize, 0,
+                        debug);
 
   TEST_ASSERT_EQ(result, expected_ret, desc);
 
@@ -291,6 +292,14 @@ TEST(filter_short_name) {
                        "Should reject 5-char name (len == 5, not > 5)");
 }
 
+TEST(filter_conf_name_direct) {
+  TEST_ASSERT_EQ(filter_conf_name(NULL), FILTER_REJECT, "Should reject NULL");
+  TEST_ASSERT_EQ(filter_conf_name("10-site.conf"), FILTER_ACCEPT,
+                 "Should accept a .conf name");
+  TEST_ASSERT_EQ(filter_conf_name(".10-site.conf"), FILTER_REJECT,
+                 "Should reject a hidden name");
+}
+
 /* ============================================================================
  * Tests - User Resolution: Input Validation
  * ============================================================================
@@ -302,32 +311,33 @@ TEST(resolve_user_null_arguments) {
   char username[STANDARD_USERNAME_BUFFER];
 
   errno = 0;
-  TEST_ASSERT_EQ(
-      resolve_user(NULL, "testuser", &uid, username, sizeof(username), true),
-      -1, "Should reject NULL ops");
+  TEST_ASSERT_EQ(resolve_user(NULL, "testuser", &uid, username,
+                              sizeof(username), 0, true),
+                 -1, "Should reject NULL ops");
   TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
 
   errno = 0;
-  TEST_ASSERT_EQ(
-      resolve_user(&test_ops, NULL, &uid, username, sizeof(username), true), -1,
-      "Should reject NULL user_arg");
+  TEST_ASSERT_EQ(resolve_user(&test_ops, NULL, &uid, username,
+                              sizeof(username), 0, true),
+                 -1, "Should reject NULL user_arg");
   TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
 
   errno = 0;
   TEST_ASSERT_EQ(resolve_user(&test_ops, "testuser", NULL, username,
-                              sizeof(username), true),
+                              sizeof(username), 0, true),
                  -1, "Should reject NULL uid pointer");
   TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
 
   errno = 0;
-  TEST_ASSERT_EQ(
-      resolve_user(&test_ops, "testuser", &uid, NULL, sizeof(username), true),
-      -1, "Should reject NULL username pointer");
+  TEST_ASSERT_EQ(resolve_user(&test_ops, "testuser", &uid, NULL,
+                              sizeof(username), 0, true),
+                 -1, "Should reject NULL username pointer");
   TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
 
   errno = 0;
-  TEST_ASSERT_EQ(resolve_user(&test_ops, "testuser", NULL, username, 0, true),
-                 -1, "Should reject size 0");
+  TEST_ASSERT_EQ(
+      resolve_user(&test_ops, "testuser", NULL, username, 0, 0, true), -1,
+      "Should reject size 0");
   TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
 }
 
@@ -352,8 +362,8 @@ TEST(resolve_user_arg_too_long) {
   memset(long_arg, 'a', sizeof(long_arg) - 1);
   long_arg[sizeof(long_arg) - 1] = '\0';
 
-  result =
-      resolve_user(&test_ops, long_arg, &uid, username, sizeof(username), true);
+  result = resolve_user(&test_ops, long_arg, &uid, username, sizeof(username),
+                        0, true);
   TEST_ASSERT_EQ(result, -1, "Should reject very long user argument");
   TEST_ASSERT_EQ(errno, ENAMETOOLONG, "Should set the correct error code");
 }
@@ -365,7 +375,7 @@ TEST(resolve_user_uid_overflow) {
   int result;
 
   result = resolve_user(&test_ops, "4294967296", &uid, username,
-                        sizeof(username), true);
+                        sizeof(username), 0, true);
   TEST_ASSERT_EQ(result, -1, "Should reject UID overflow");
   TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
 }
@@ -388,7 +398,7 @@ TEST(resolve_user_username_invalid) {
 
   FOR_EACH_INVALID_USERNAME(
       TEST_ASSERT_EQ(resolve_user(&test_ops, case_ptr->input, &uid, username,
-                                  sizeof(username), true),
+                                  sizeof(username), 0, true),
                      -1, case_ptr->reason););
 }
 
@@ -401,7 +411,7 @@ TEST(resolve_user_username_valid) {
 
   FOR_EACH_VALID_USERNAME(
       TEST_ASSERT_EQ(resolve_user(&test_ops, case_ptr->input, &uid, username,
-                                  sizeof(username), true),
+                                  sizeof(username), 0, true),
                      0, case_ptr->reason););
 }
 
@@ -413,7 +423,7 @@ TEST(resolve_user_username_valid) {
 TEST(resolve_user_by_uid_non_debug) {
   struct syscall_ops test_ops = syscall_ops_default;
 
-  test_ops.getpwuid = mock_getpwuid_testuser;
+  test_ops.getpwuid_r = mock_getpwuid_r_testuser;
 
   test_resolve_user(&test_ops, "1000", 0, TEST_UID_STANDARD, "testuser",
                     STANDARD_USERNAME_BUFFER, false,
@@ -423,7 +433,7 @@ TEST(resolve_user_by_uid_non_debug) {
 TEST(resolve_user_by_uid_success) {
   struct syscall_ops test_ops = syscall_ops_default;
 
-  test_ops.getpwuid = mock_getpwuid_testuser;
+  test_ops.getpwuid_r = mock_getpwuid_r_testuser;
 
   test_resolve_user(&test_ops, "1000", 0, TEST_UID_STANDARD, "testuser",
                     STANDARD_USERNAME_BUFFER, true, "Should succeed");
@@ -432,7 +442,7 @@ TEST(resolve_user_by_uid_success) {
 TEST(resolve_user_by_uid_not_found) {
   struct syscall_ops test_ops = syscall_ops_default;
 
-  test_ops.getpwuid = mock_getpwuid_null;
+  test_ops.getpwuid_r = mock_getpwuid_r_null;
 
   test_resolve_user(&test_ops, "9999", -1, 0, NULL, STANDARD_USERNAME_BUFFER,
                     true, "Should fail when user not found");
@@ -442,7 +452,7 @@ TEST(resolve_user_by_uid_not_found) {
 TEST(resolve_user_by_uid_null_pwname) {
   struct syscall_ops test_ops = syscall_ops_default;
 
-  test_ops.getpwuid = mock_getpwuid_null_pwname;
+  test_ops.getpwuid_r = mock_getpwuid_r_null_pwname;
 
   test_resolve_user(&test_ops, "1000", -1, 0, NULL, STANDARD_USERNAME_BUFFER,
                     true, "Should reject NULL pw_name in passwd struct");
@@ -452,7 +462,7 @@ TEST(resolve_user_by_uid_null_pwname) {
 TEST(resolve_user_by_uid_root) {
   struct syscall_ops test_ops = syscall_ops_default;
 
-  test_ops.getpwuid = mock_getpwuid_root;
+  test_ops.getpwuid_r = mock_getpwuid_r_root;
 
   test_resolve_user(&test_ops, "0", 0, TEST_UID_ROOT, "root",
                     STANDARD_USERNAME_BUFFER, true,
@@ -462,7 +472,7 @@ TEST(resolve_user_by_uid_root) {
 TEST(resolve_user_uid_leading_zeros) {
   struct syscall_ops test_ops = syscall_ops_default;
 
-  test_ops.getpwuid = mock_getpwuid_testuser;
+  test_ops.getpwuid_r = mock_getpwuid_r_testuser;
 
   test_resolve_user(&test_ops, "0001000", 0, TEST_UID_STANDARD, "testuser",
                     STANDARD_USERNAME_BUFFER, true,
@@ -472,7 +482,7 @@ TEST(resolve_user_uid_leading_zeros) {
 TEST(resolve_user_by_uid_username_too_long) {
   struct syscall_ops test_ops = syscall_ops_default;
 
-  test_ops.getpwuid = mock_getpwuid_longname;
+  test_ops.getpwuid_r = mock_getpwuid_r_longname;
 
   test_resolve_user(&test_ops, "1000", -1, 0, NULL, TINY_USERNAME_BUFFER, true,
                     "Should fail when username too long");
@@ -535,7 +545,7 @@ TEST(resolve_user_calloc_fails) {
   test_ops.calloc = mock_calloc_null;
 
   result = resolve_user(&test_ops, "testuser", &uid, username, sizeof(username),
-                        true);
+                        0, true);
 
   TEST_ASSERT_EQ(result, -1, "Should fail on allocation failure");
   TEST_ASSERT_EQ(errno, ENOMEM, "Should set the correct error code");
@@ -544,7 +554,7 @@ TEST(resolve_user_calloc_fails) {
 TEST(resolve_user_max_uid) {
   struct syscall_ops test_ops = syscall_ops_default;
 
-  test_ops.getpwuid = mock_getpwuid_testuser;
+  test_ops.getpwuid_r = mock_getpwuid_r_testuser;
 
   test_resolve_user(&test_ops, "4294967295", 0, UINT32_MAX_VAL, NULL,
                     STANDARD_USERNAME_BUFFER, true,
@@ -561,6 +571,28 @@ TEST(resolve_user_username_copy_exact_size) {
                     "Should succeed with exact-fit buffer");
 }
 
+/* ============================================================================
+ * Tests: FNV-1a Hashing
+ * ============================================================================
+ */
+
+TEST(hash_fnv1a_known_vectors) {
+  TEST_ASSERT_EQ(hash_fnv1a("", 0, FNV1A_64_INIT), FNV1A_64_INIT,
+                 "Empty input should return the seed");
+  TEST_ASSERT_EQ(hash_fnv1a("a", 1, FNV1A_64_INIT),
+                 UINT64_C(0xaf63dc4c8601ec8c), "Should match FNV-1a 64 'a'");
+  TEST_ASSERT_EQ(hash_fnv1a("foobar", 6, FNV1A_64_INIT),
+                 UINT64_C(0x85944171f73967e8),
+                 "Should match FNV-1a 64 'foobar'");
+}
+
+TEST(hash_fnv1a_chains) {
+  uint64_t whole = hash_fnv1a("foobar", 6, FNV1A_64_INIT);
+  uint64_t split = hash_fnv1a("bar", 3, hash_fnv1a("foo", 3, FNV1A_64_INIT));
+
+  TEST_ASSERT_EQ(whole, split, "Hashing in pieces should match one pass");
+}
+
 /* ============================================================================
  * Test Runner
  * ============================================================================
@@ -594,6 +626,7 @@ int main(int argc, char **argv) {
   RUN_TEST(filter_valid_conf_files);
   RUN_TEST(filter_hidden_conf_file);
   RUN_TEST(filter_short_name);
+  RUN_TEST(filter_conf_name_direct);
 
   /* User resolution: Input validation */
   RUN_TEST(resolve_user_null_arguments);
@@ -622,6 +655,10 @@ int main(int argc, char **argv) {
   RUN_TEST(resolve_user_max_uid);
   RUN_TEST(resolve_user_username_copy_exact_size);
 
+  /* FNV-1a hashing */
+  RUN_TEST(hash_fnv1a_known_vectors);
+  RUN_TEST(hash_fnv1a_chains);
+
   result = TEST_EXECUTE();
   return result;
 }
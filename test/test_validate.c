@@ -262,6 +262,36 @@ TEST(validate_config_dir_symlink_stat_eperm) {
   TEST_ASSERT_EQ(errno, EPERM, "Should set the correct error code");
 }
 
+TEST(validate_config_dir_fd_null_params) {
+  struct syscall_ops test_ops = syscall_ops_default;
+
+  TEST_ASSERT_EQ(validate_config_dir_fd(NULL, 0, "/etc"), -1,
+                 "Should reject NULL ops");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(validate_config_dir_fd(&test_ops, 0, NULL), -1,
+                 "Should reject NULL directory");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+}
+
+TEST(validate_config_dir_fd_checks_descriptor) {
+  struct syscall_ops test_ops = syscall_ops_default;
+
+  test_ops.stat = mock_stat_root_file;
+  test_ops.fstat = mock_fstat_root_dir;
+  TEST_ASSERT_EQ(validate_config_dir_fd(&test_ops, 0, CONFIG_DROPIN_DIR_PATH),
+                 0, "Should only look at the descriptor");
+
+  test_ops.fstat = mock_fstat_non_root_dir;
+  TEST_ASSERT_EQ(validate_config_dir_fd(&test_ops, 0, CONFIG_DROPIN_DIR_PATH),
+                 -1, "Should reject a directory not owned by root");
+  TEST_ASSERT_EQ(errno, EPERM, "Should set the correct error code");
+
+  test_ops.fstat = mock_fstat_eio;
+  TEST_ASSERT_EQ(validate_config_dir_fd(&test_ops, 0, CONFIG_DROPIN_DIR_PATH),
+                 -1, "Should fail when fstat fails");
+  TEST_ASSERT_EQ(errno, EIO, "Should keep the fstat error");
+}
+
 /* ============================================================================
  * Tests - Username Validation
  * ============================================================================
@@ -575,6 +605,105 @@ TEST(validate_uid_subid_overlap_no_overlap) {
                  "Should accept UID above subordinate range");
 }
 
+/* ============================================================================
+ * Tests - UID Bands
+ * ============================================================================
+ */
+
+/**
+ * add_band - Append a band to the subuid bands of @config
+ */
+static void add_band(config_t *config, uint32_t uid_lo, uint32_t uid_hi,
+                     uint32_t count) {
+  config->subuid.bands[config->subuid.band_count++] =
+      (subid_band_t){.uid_lo = uid_lo, .uid_hi = uid_hi, .count = count};
+}
+
+TEST(validate_subid_bands_null) {
+  config_t config = {0};
+  config_factory(&config);
+
+  TEST_ASSERT_EQ(validate_subid_bands(NULL, &config.subuid), -1,
+                 "Should reject NULL config");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(validate_subid_bands(&config, NULL), -1,
+                 "Should reject NULL subid_cfg");
+}
+
+TEST(validate_subid_bands_valid) {
+  config_t config = {0};
+  config_factory(&config);
+
+  TEST_ASSERT_EQ(validate_subid_bands(&config, &config.subuid), 0,
+                 "No bands are valid");
+
+  add_band(&config, TEST_UID_MIN, TEST_UID_MIN, 1);
+  add_band(&config, TEST_UID_MIN + 1, TEST_UID_MID_RANGE, 1048576);
+  add_band(&config, TEST_UID_MAX, TEST_UID_MAX, SUBID_MAX - SUBID_MIN + 1);
+  TEST_ASSERT_EQ(validate_subid_bands(&config, &config.subuid), 0,
+                 "Adjacent bands at both ends of the UID range are valid");
+}
+
+TEST(validate_subid_bands_overlap) {
+  config_t config = {0};
+  config_factory(&config);
+
+  add_band(&config, TEST_UID_MIN, TEST_UID_MID_RANGE, 1000);
+  add_band(&config, TEST_UID_MID_RANGE, TEST_UID_MAX, 1000);
+  TEST_ASSERT_EQ(validate_subid_bands(&config, &config.subuid), -1,
+                 "Should reject bands sharing a UID");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+}
+
+TEST(validate_subid_bands_outside) {
+  config_t config = {0};
+  config_factory(&config);
+
+  add_band(&config, TEST_UID_BELOW_MIN, TEST_UID_MIN, 1000);
+  TEST_ASSERT_EQ(validate_subid_bands(&config, &config.subuid), -1,
+                 "Should reject a band starting below UID_MIN");
+
+  config.subuid.bands[0] = (subid_band_t){
+      .uid_lo = TEST_UID_MAX, .uid_hi = TEST_UID_ABOVE_MAX, .count = 1000};
+  TEST_ASSERT_EQ(validate_subid_bands(&config, &config.subuid), -1,
+                 "Should reject a band ending past UID_MAX");
+
+  config.subuid.bands[0] = (subid_band_t){
+      .uid_lo = TEST_UID_MAX, .uid_hi = TEST_UID_MIN, .count = 1000};
+  TEST_ASSERT_EQ(validate_subid_bands(&config, &config.subuid), -1,
+                 "Should reject a reversed band");
+}
+
+TEST(validate_subid_bands_count) {
+  config_t config = {0};
+  config_factory(&config);
+
+  add_band(&config, TEST_UID_MIN, TEST_UID_MIN, 0);
+  TEST_ASSERT_EQ(validate_subid_bands(&config, &config.subuid), -1,
+                 "Should reject a zero count");
+
+  config.subuid.bands[0].count = SUBID_MAX - SUBID_MIN + 2;
+  TEST_ASSERT_EQ(validate_subid_bands(&config, &config.subuid), -1,
+                 "Should reject a count larger than the space");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+}
+
+TEST(validate_subid_bands_reversed_space) {
+  config_t config = {0};
+  config_factory(&config);
+
+  add_band(&config, TEST_UID_MIN, TEST_UID_MIN, 1000);
+  config.subuid.min_val = SUBID_MAX;
+  config.subuid.max_val = SUBID_MIN;
+  TEST_ASSERT_EQ(validate_subid_bands(&config, &config.subuid), -1,
+                 "Should reject SUB_UID_MAX below SUB_UID_MIN");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+
+  config.subuid.band_count = 0;
+  TEST_ASSERT_EQ(validate_subid_bands(&config, &config.subuid), 0,
+                 "Without bands there is nothing to check");
+}
+
 /* ============================================================================
  * Test Runner
  * ============================================================================
@@ -612,6 +741,8 @@ int main(int argc, char **argv) {
   RUN_TEST(validate_config_dir_symlink_to_file);
   RUN_TEST(validate_config_dir_broken_symlink);
   RUN_TEST(validate_config_dir_symlink_stat_eperm);
+  RUN_TEST(validate_config_dir_fd_null_params);
+  RUN_TEST(validate_config_dir_fd_checks_descriptor);
 
   /* Username validation */
   RUN_TEST(validate_username_null);
@@ -648,6 +779,14 @@ int main(int argc, char **argv) {
   RUN_TEST(validate_uid_subid_overlap_overlaps);
   RUN_TEST(validate_uid_subid_overlap_no_overlap);
 
+  /* UID bands */
+  RUN_TEST(validate_subid_bands_null);
+  RUN_TEST(validate_subid_bands_valid);
+  RUN_TEST(validate_subid_bands_overlap);
+  RUN_TEST(validate_subid_bands_outside);
+  RUN_TEST(validate_subid_bands_count);
+  RUN_TEST(validate_subid_bands_reversed_space);
+
   result = TEST_EXECUTE();
   return result;
 }
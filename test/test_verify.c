@@ -0,0 +1,475 @@
+/**
+ * test_verify.c - Tests for the fleet consistency check over subid dumps
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <pwd.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "test_framework.h"
+#include "test_helpers/all.h"
+
+/* ============================================================================
+ * Constants
+ * ============================================================================
+ */
+
+/* Descriptor of mock input i is MOCK_FD_BASE + i */
+enum { MOCK_FD_BASE = 400 };
+
+/* Most inputs a test serves */
+enum { MOCK_INPUTS_MAX = 32 };
+
+/* Room for a crafted tar archive */
+enum { TAR_ARCHIVE_MAX = 8192 };
+
+/* ============================================================================
+ * Mock Inputs and Passwd
+ * ============================================================================
+ */
+
+/**
+ * struct mock_input_t - Content served for one input path
+ * @path: Path verify_run() opens
+ * @data: Content, may hold NUL bytes
+ * @len: Bytes of @data
+ * @pos: Bytes already read
+ */
+typedef struct {
+  const char *path;
+  const char *data;
+  size_t len;
+  size_t pos;
+} mock_input_t;
+
+static mock_input_t mock_inputs[MOCK_INPUTS_MAX];
+static size_t mock_input_count = 0;
+
+/* Most bytes one read returns, to split lines across reads */
+static size_t mock_read_chunk = SIZE_MAX;
+
+/**
+ * mock_open_input - Open the mock input registered for @pathname
+ */
+static int mock_open_input(const char *pathname, int flags, ...) {
+  (void)flags;
+  for (size_t i = 0; i < mock_input_count; i++) {
+    if (strcmp(mock_inputs[i].path, pathname) == 0) {
+      mock_inputs[i].pos = 0;
+      return MOCK_FD_BASE + (int)i;
+    }
+  }
+  errno = ENOENT;
+  return -1;
+}
+
+/**
+ * mock_read_input - Serve the next bytes of a mock input
+ *
+ * Every input is read by one thread only, so no locking is needed.
+ */
+static ssize_t mock_read_input(int fd, void *buf, size_t count) {
+  if (fd < MOCK_FD_BASE || (size_t)(fd - MOCK_FD_BASE) >= mock_input_count) {
+    errno = EBADF;
+    return -1;
+  }
+
+  mock_input_t *input = &mock_inputs[fd - MOCK_FD_BASE];
+  size_t n = input->len - input->pos;
+  if (n > count) {
+    n = count;
+  }
+  if (n > mock_read_chunk) {
+    n = mock_read_chunk;
+  }
+  memcpy(buf, input->data + input->pos, n);
+  input->pos += n;
+  return (ssize_t)n;
+}
+
+/**
+ * mock_getpwnam_r_fleet - alice is UID 1001, bob UID 1002, nobody else
+ */
+static int mock_getpwnam_r_fleet(const char *name, struct passwd *pwd,
+                                 char *buf, size_t buflen,
+                                 struct passwd **result) {
+  if (strcmp(name, "alice") == 0) {
+    return fill_mock_user(pwd, buf, buflen, name, 1001, 1001, result);
+  }
+  if (strcmp(name, "bob") == 0) {
+    return fill_mock_user(pwd, buf, buflen, name, 1002, 1002, result);
+  }
+  *result = NULL;
+  return 0;
+}
+
+/**
+ * add_input - Register @len bytes of @data as the content of @path
+ */
+static void add_input(const char *path, const char *data, size_t len) {
+  mock_inputs[mock_input_count++] = (mock_input_t){
+      .path = path,
+      .data = data,
+      .len = len,
+  };
+}
+
+/**
+ * make_verify_ops - Ops serving the registered inputs
+ */
+static struct syscall_ops make_verify_ops(void) {
+  struct syscall_ops ops = syscall_ops_default;
+  ops.open = mock_open_input;
+  ops.read = mock_read_input;
+  ops.close = mock_close_any;
+  ops.getpwnam_r = mock_getpwnam_r_fleet;
+  return ops;
+}
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================
+ */
+
+/**
+ * reset_inputs - Forget every registered input
+ */
+static void reset_inputs(void) {
+  mock_input_count = 0;
+  mock_read_chunk = SIZE_MAX;
+}
+
+/**
+ * tar_member - Append one member to a tar archive under construction
+ * @archive: Archive buffer
+ * @len: Bytes of @archive used, advanced past the member
+ * @name: Member name
+ * @type: tar type flag
+ * @data: Member content
+ *
+ * Only the fields verify.c reads are filled in.
+ */
+static void tar_member(char *archive, size_t *len, const char *name,
+                       char type, const char *data) {
+  char *header = archive + *len;
+  size_t size = strlen(data);
+
+  (void)memset(header, 0, 512);
+  (void)snprintf(header, 100, "%s", name);
+  (void)snprintf(header + 124, 12, "%011o", (unsigned int)size);
+  header[156] = type;
+  memcpy(header + 257, "ustar", 6);
+  memcpy(header + 263, "00", 2);
+  memcpy(header + 512, data, size);
+  *len += 512 + (size + 511) / 512 * 512;
+}
+
+/**
+ * run_verify - Verify the given inputs as subuid dumps, capturing the report
+ * @ops: Operations structure
+ * @config: Configuration to verify against
+ * @inputs: Input paths, NULL for stdin
+ * @count: Number of @inputs
+ * @jobs: Inputs read in parallel
+ * @findings: Set to the number of findings
+ * @ret: Set to what verify_run() returned
+ *
+ * Return: Report text (caller frees), NULL if it could not be captured
+ */
+static char *run_verify(const struct syscall_ops *ops, const config_t *config,
+                        char *const *inputs, int count, unsigned int jobs,
+                        size_t *findings, int *ret) {
+  options_t opts = {
+      .do_subuid = true,
+      .jobs = jobs,
+      .user_args = inputs,
+      .user_argc = count,
+  };
+  char *report = NULL;
+  size_t size = 0;
+  FILE *out = open_memstream(&report, &size);
+  if (out == NULL) {
+    return NULL;
+  }
+
+  *ret = verify_run(ops, config, &opts, out, findings);
+  (void)fclose(out);
+  return report;
+}
+
+/* ============================================================================
+ * Tests
+ * ============================================================================
+ */
+
+TEST(verify_null_params) {
+  config_t config = {0};
+  options_t opts = {.do_subuid = true};
+  size_t findings = 0;
+
+  config_factory(&config);
+  TEST_ASSERT_EQ(verify_run(NULL, &config, &opts, stdout, &findings), -1,
+                 "Should reject NULL ops");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(verify_run(&syscall_ops_default, &config, &opts, stdout,
+                            NULL),
+                 -1, "Should reject NULL findings");
+
+  opts.do_subgid = true;
+  TEST_ASSERT_EQ(verify_run(&syscall_ops_default, &config, &opts, stdout,
+                            &findings),
+                 -1, "Should take only one kind of ID");
+}
+
+TEST(verify_clean_stream) {
+  config_t config = {0};
+  size_t findings = 99;
+  int ret = -1;
+  static char path[] = "dumps.txt";
+  char *const inputs[] = {path};
+  static const char stream[] = "==> node1 <==\n"
+                               "# managed\n"
+                               "alice:165536:65536\n"
+                               "bob:231072:65536\n"
+                               "\n"
+                               "==> node2 <==\n"
+                               "bob:231072:65536\n"
+                               "alice:165536:65536\n";
+
+  config_factory(&config);
+  reset_inputs();
+  add_input(path, stream, strlen(stream));
+  mock_read_chunk = 5;
+  struct syscall_ops ops = make_verify_ops();
+  char *report = run_verify(&ops, &config, inputs, 1, 1, &findings, &ret);
+
+  TEST_ASSERT_NOT_EQ(report, NULL, "Test setup: cannot capture report");
+  TEST_ASSERT_EQ(ret, 0, "Verify should complete");
+  TEST_ASSERT_EQ(findings, 0, "Should find nothing");
+  TEST_ASSERT_STR_EQ(report,
+                     "summary\tnode1\t2 entries\t0 findings\n"
+                     "summary\tnode2\t2 entries\t0 findings\n"
+                     "summary\tfleet\t2 hosts\t2 users\t0 findings\n",
+                     "Should only print the summaries");
+  free(report);
+}
+
+TEST(verify_findings) {
+  config_t config = {0};
+  size_t findings = 0;
+  int ret = -1;
+  static char path[] = "dumps.txt";
+  char *const inputs[] = {path};
+  static const char stream[] = "==> node1 <==\n"
+                               "alice:165536:65536\n"
+                               "bob:231072:65536\n"
+                               "==> node2 <==\n"
+                               "alice:100000000:65536\n"
+                               "mallory:165600:100\n"
+                               "not a line\n"
+                               "==> node3 <==\n"
+                               "bob:231072:65536\n";
+
+  config_factory(&config);
+  reset_inputs();
+  add_input(path, stream, strlen(stream));
+  struct syscall_ops ops = make_verify_ops();
+  char *report = run_verify(&ops, &config, inputs, 1, 1, &findings, &ret);
+
+  TEST_ASSERT_NOT_EQ(report, NULL, "Test setup: cannot capture report");
+  TEST_ASSERT_EQ(ret, 0, "Verify should complete");
+  TEST_ASSERT_EQ(findings, 6, "Should find six problems");
+  TEST_ASSERT_NOT_EQ(strstr(report, "mismatch\tnode2:1\t"
+                                    "alice:100000000:65536\tUID 1001 "
+                                    "expected 165536:65536\n"),
+                     NULL, "Should report the diverging range");
+  TEST_ASSERT_NOT_EQ(strstr(report, "unknown-owner\tnode2:2\t"
+                                    "mallory:165600:100\tno such user\n"),
+                     NULL, "Should report the unknown owner");
+  TEST_ASSERT_NOT_EQ(strstr(report, "malformed\tnode2:3\t-\t"
+                                    "unparseable entry\n"),
+                     NULL, "Should report the malformed line");
+  TEST_ASSERT_NOT_EQ(strstr(report, "summary\tnode2\t2 entries\t"
+                                    "3 findings\n"),
+                     NULL, "Should count the host's findings");
+  TEST_ASSERT_NOT_EQ(strstr(report, "missing\t-\talice\tabsent from 1 of "
+                                    "3 hosts\n"
+                                    "missing\t-\tbob\tabsent from 1 of 3 "
+                                    "hosts\n"
+                                    "missing\t-\tmallory\tabsent from 2 of "
+                                    "3 hosts\n"),
+                     NULL, "Should report missing users by name");
+  TEST_ASSERT_NOT_EQ(strstr(report, "summary\tfleet\t3 hosts\t3 users\t"
+                                    "6 findings\n"),
+                     NULL, "Should print the fleet summary");
+  free(report);
+}
+
+TEST(verify_overlap) {
+  config_t config = {0};
+  size_t findings = 0;
+  int ret = -1;
+  static char path[] = "node1";
+  char *const inputs[] = {path};
+  static const char dump[] = "alice:165536:65536\n"
+                             "1001:165536:65536\n"
+                             "1002:200000:65536\n";
+
+  config_factory(&config);
+  reset_inputs();
+  add_input(path, dump, strlen(dump));
+  struct syscall_ops ops = make_verify_ops();
+  char *report = run_verify(&ops, &config, inputs, 1, 1, &findings, &ret);
+
+  TEST_ASSERT_NOT_EQ(report, NULL, "Test setup: cannot capture report");
+  TEST_ASSERT_EQ(ret, 0, "Verify should complete");
+  TEST_ASSERT_NOT_EQ(strstr(report, "overlap\tnode1:3\t1002:200000:65536\t"
+                                    "line 1 alice:165536:65536\n"),
+                     NULL, "Should report the overlap with another UID");
+  TEST_ASSERT_EQ(strstr(report, "overlap\tnode1:2"), NULL,
+                 "The same UID under two names is not an overlap");
+  TEST_ASSERT_NOT_EQ(strstr(report, "summary\tfleet\t1 hosts\t3 users\t"), NULL,
+                     "A plain dump is one host named after its path");
+  free(report);
+}
+
+TEST(verify_tar_archive) {
+  config_t config = {0};
+  size_t findings = 0;
+  int ret = -1;
+  static char path[] = "fleet.tar";
+  char *const inputs[] = {path};
+  static char archive[TAR_ARCHIVE_MAX];
+  size_t len = 0;
+
+  (void)memset(archive, 0, sizeof(archive));
+  tar_member(archive, &len, "./", '5', "");
+  tar_member(archive, &len, "./node1", '0', "alice:165536:65536\n");
+  tar_member(archive, &len, "././@LongLink", 'L', "node2.example.org");
+  tar_member(archive, &len, "ignored", '0',
+             "alice:165536:65536\nbob:231072:65536");
+  len += 1024; /* End-of-archive blocks */
+
+  config_factory(&config);
+  reset_inputs();
+  add_input(path, archive, len);
+  mock_read_chunk = 700;
+  struct syscall_ops ops = make_verify_ops();
+  char *report = run_verify(&ops, &config, inputs, 1, 1, &findings, &ret);
+
+  TEST_ASSERT_NOT_EQ(report, NULL, "Test setup: cannot capture report");
+  TEST_ASSERT_EQ(ret, 0, "Verify should complete");
+  TEST_ASSERT_EQ(findings, 1, "Only bob is missing");
+  TEST_ASSERT_STR_EQ(report,
+                     "summary\tnode1\t1 entries\t0 findings\n"
+                     "summary\tnode2.example.org\t2 entries\t0 findings\n"
+                     "missing\t-\tbob\tabsent from 1 of 2 hosts\n"
+                     "summary\tfleet\t2 hosts\t2 users\t1 findings\n",
+                     "Should take the hosts from the member names");
+  free(report);
+}
+
+TEST(verify_truncated_tar) {
+  config_t config = {0};
+  size_t findings = 0;
+  int ret = 0;
+  static char path[] = "fleet.tar";
+  char *const inputs[] = {path};
+  static char archive[TAR_ARCHIVE_MAX];
+  size_t len = 0;
+
+  (void)memset(archive, 0, sizeof(archive));
+  tar_member(archive, &len, "node1", '0', "alice:165536:65536\n");
+
+  config_factory(&config);
+  reset_inputs();
+  add_input(path, archive, len - 100);
+  struct syscall_ops ops = make_verify_ops();
+  char *report = run_verify(&ops, &config, inputs, 1, 1, &findings, &ret);
+
+  TEST_ASSERT_NOT_EQ(report, NULL, "Test setup: cannot capture report");
+  TEST_ASSERT_EQ(ret, -1, "A truncated archive is an error");
+  free(report);
+}
+
+TEST(verify_parallel_inputs) {
+  config_t config = {0};
+  size_t findings = 0;
+  int ret = -1;
+  static char names[MOCK_INPUTS_MAX][16];
+  char *inputs[MOCK_INPUTS_MAX] = {0};
+  static const char dump[] = "alice:165536:65536\nbob:231072:65536\n";
+  static const char partial[] = "alice:165536:65536\n";
+
+  config_factory(&config);
+  reset_inputs();
+  for (size_t i = 0; i < MOCK_INPUTS_MAX; i++) {
+    (void)snprintf(names[i], sizeof(names[i]), "node%zu", i);
+    inputs[i] = names[i];
+    const char *content = i == 7 ? partial : dump;
+    add_input(names[i], content, strlen(content));
+  }
+  mock_read_chunk = 9;
+  struct syscall_ops ops = make_verify_ops();
+  char *report = run_verify(&ops, &config, inputs, MOCK_INPUTS_MAX, 8,
+                            &findings, &ret);
+
+  TEST_ASSERT_NOT_EQ(report, NULL, "Test setup: cannot capture report");
+  TEST_ASSERT_EQ(ret, 0, "Verify should complete");
+  TEST_ASSERT_EQ(findings, 1, "Only node7 lacks bob");
+  TEST_ASSERT_NOT_EQ(strstr(report, "summary\tnode7\t1 entries\t"
+                                    "0 findings\n"),
+                     NULL, "Should check every host");
+  TEST_ASSERT_NOT_EQ(strstr(report, "missing\t-\tbob\tabsent from 1 of "
+                                    "32 hosts\n"),
+                     NULL, "Should count hosts across threads");
+  free(report);
+}
+
+TEST(verify_unreadable_input) {
+  config_t config = {0};
+  size_t findings = 0;
+  int ret = 0;
+  static char present[] = "node1";
+  static char absent[] = "node2";
+  char *const inputs[] = {absent, present};
+  static const char dump[] = "alice:165536:65536\n";
+
+  config_factory(&config);
+  reset_inputs();
+  add_input(present, dump, strlen(dump));
+  struct syscall_ops ops = make_verify_ops();
+  char *report = run_verify(&ops, &config, inputs, 2, 1, &findings, &ret);
+
+  TEST_ASSERT_NOT_EQ(report, NULL, "Test setup: cannot capture report");
+  TEST_ASSERT_EQ(ret, -1, "An unreadable input fails the run");
+  TEST_ASSERT_NOT_EQ(strstr(report, "summary\tnode1\t1 entries\t"), NULL,
+                     "Should still check the other inputs");
+  free(report);
+}
+
+int main(int argc, char **argv) {
+  TEST_INIT(10, false, false); /* timeout, verbose, duration */
+
+  RUN_TEST(verify_null_params);
+  RUN_TEST(verify_clean_stream);
+  RUN_TEST(verify_findings);
+  RUN_TEST(verify_overlap);
+  RUN_TEST(verify_tar_archive);
+  RUN_TEST(verify_truncated_tar);
+  RUN_TEST(verify_parallel_inputs);
+  RUN_TEST(verify_unreadable_input);
+
+  return TEST_EXECUTE();
+}
@@ -0,0 +1,160 @@
+/**
+ * test_wait.c - Tests for waiting on another run to commit the ranges
+ */
+
+/* clang-format off */
+#include "autoconf.h"
+#include "static-subid.h"
+#include "syscall_ops.h"
+/* clang-format on */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "test_framework.h"
+#include "test_helpers/all.h"
+
+/* ============================================================================
+ * Constants
+ * ============================================================================
+ */
+
+/* == default UID_MIN, its ranges start at the default SUB_UID_MIN */
+enum { ELIGIBLE_UID = 1000 };
+
+/* ============================================================================
+ * Mock Functions
+ * ============================================================================
+ */
+
+/* Database opens that fail with ENOENT before the ranges "appear" */
+static int mock_missing_opens = 0;
+
+/**
+ * mock_open_later - No database until mock_missing_opens is used up
+ */
+static int mock_open_later(const char *pathname, int flags, ...) {
+  (void)pathname;
+  (void)flags;
+  if (mock_missing_opens > 0) {
+    mock_missing_opens--;
+    errno = ENOENT;
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * mock_fdopen_subid_db - Serve a database that assigns testuser a range
+ */
+static FILE *mock_fdopen_subid_db(int fd, const char *mode) {
+  static const char content[] = "testuser:100000:65536\n";
+  (void)fd;
+  (void)mode;
+  return fmemopen((void *)(uintptr_t)content, sizeof(content) - 1, "r");
+}
+
+/**
+ * make_wait_ops - Ops whose databases show up after @missing opens
+ */
+static struct syscall_ops make_wait_ops(int missing) {
+  struct syscall_ops ops = syscall_ops_default;
+
+  mock_missing_opens = missing;
+  ops.open = mock_open_later;
+  ops.close = mock_close_any;
+  ops.fstat = mock_fstat_root_file;
+  ops.fdopen = mock_fdopen_subid_db;
+  return ops;
+}
+
+/* ============================================================================
+ * Tests
+ * ============================================================================
+ */
+
+TEST(wait_null_params) {
+  config_t config = {0};
+  options_t opts = {.do_subuid = true};
+
+  config_factory(&config);
+  TEST_ASSERT_EQ(wait_for_ranges(NULL, "testuser", ELIGIBLE_UID, &config,
+                                 &opts, 0),
+                 -1, "Should reject NULL ops");
+  TEST_ASSERT_EQ(errno, EINVAL, "Should set the correct error code");
+  TEST_ASSERT_EQ(wait_for_ranges(&syscall_ops_default, NULL, ELIGIBLE_UID,
+                                 &config, &opts, 0),
+                 -1, "Should reject NULL username");
+}
+
+TEST(wait_already_in_place) {
+  config_t config = {0};
+  options_t opts = {.do_subuid = true, .do_subgid = true, .debug = true};
+
+  config_factory(&config);
+  struct syscall_ops ops = make_wait_ops(0);
+  TEST_ASSERT_EQ(wait_for_ranges(&ops, "testuser", ELIGIBLE_UID, &config,
+                                 &opts, 0),
+                 0, "Ranges in place should return at once");
+}
+
+TEST(wait_times_out) {
+  config_t config = {0};
+  options_t opts = {.do_subuid = true, .debug = true};
+
+  config_factory(&config);
+  struct syscall_ops ops = make_wait_ops(1000);
+  uint64_t started = stats_now();
+  TEST_ASSERT_EQ(wait_for_ranges(&ops, "testuser", ELIGIBLE_UID, &config,
+                                 &opts, 200),
+                 -1, "Should give up without the ranges");
+  TEST_ASSERT_EQ(errno, ETIMEDOUT, "Should set the correct error code");
+  TEST_ASSERT_EQ(stats_now() - started >= 200 * 1000, true,
+                 "Should wait out the timeout");
+
+  ops = make_wait_ops(1);
+  TEST_ASSERT_EQ(wait_for_ranges(&ops, "testuser", ELIGIBLE_UID, &config,
+                                 &opts, 0),
+                 -1, "No timeout only checks once");
+  TEST_ASSERT_EQ(errno, ETIMEDOUT, "Should set the correct error code");
+}
+
+TEST(wait_until_committed) {
+  config_t config = {0};
+  options_t opts = {.do_subuid = true, .debug = true};
+
+  config_factory(&config);
+  struct syscall_ops ops = make_wait_ops(1);
+  TEST_ASSERT_EQ(wait_for_ranges(&ops, "testuser", ELIGIBLE_UID, &config,
+                                 &opts, 5000),
+                 0, "Should return once the ranges show up");
+  TEST_ASSERT_EQ(mock_missing_opens, 0, "Should have checked again");
+}
+
+TEST(wait_check_error) {
+  config_t config = {0};
+  options_t opts = {.do_subuid = true};
+
+  config_factory(&config);
+  struct syscall_ops ops = make_wait_ops(0);
+  ops.open = mock_open_eacces;
+  TEST_ASSERT_EQ(wait_for_ranges(&ops, "testuser", ELIGIBLE_UID, &config,
+                                 &opts, 5000),
+                 -1, "A failing check should end the wait");
+  TEST_ASSERT_NOT_EQ(errno, ETIMEDOUT, "Should not report a timeout");
+}
+
+int main(int argc, char **argv) {
+  TEST_INIT(10, false, false); /* timeout, verbose, duration */
+
+  RUN_TEST(wait_null_params);
+  RUN_TEST(wait_already_in_place);
+  RUN_TEST(wait_times_out);
+  RUN_TEST(wait_until_committed);
+  RUN_TEST(wait_check_error);
+
+  return TEST_EXECUTE();
+}